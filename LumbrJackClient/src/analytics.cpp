@@ -0,0 +1,560 @@
+#include "analytics.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <thread>
+
+#if defined(_M_X64) || defined(__SSE2__)
+#define ANALYTICS_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace analytics {
+
+    // Chunks per thread and batch, so threads that finish early take over the remaining chunks.
+    static constexpr size_t CHUNKS_PER_THREAD = 4;
+    // Largest chunk of a batch. Bounds the events held at a time.
+    static constexpr size_t MAX_CHUNK_SIZE = 0x400000;
+    // Heatmap cells are indexed with single precision floats, which are exact up to 2^24.
+    static constexpr uint64_t MAX_CELLS = 0x1000000;
+    static constexpr uint32_t MAX_BINS = 0x100000;
+    static constexpr uint64_t NO_TIME = UINT64_MAX;
+    // Flag of key releases, same value as KEY_BREAK of KEYBOARD_INPUT_DATA.
+    static constexpr uint16_t KEY_FLAG_BREAK = 0x1;
+
+    // Mapping of click positions to heatmap cells.
+    struct Grid {
+        int32_t minX;
+        int32_t minY;
+        int32_t maxX;
+        int32_t maxY;
+        float scaleX;
+        float scaleY;
+        float maxColumn;
+        float maxRow;
+        float width;
+    };
+
+    // Partial results of a thread.
+    struct Partial {
+        std::vector<uint64_t> heatmap;
+        uint64_t outside;
+        uint64_t keys;
+        uint64_t clicks;
+        std::vector<uint64_t> keyIntervals;
+        std::vector<uint64_t> clickIntervals;
+        std::vector<uint64_t> keyRates;
+        std::vector<uint64_t> clickRates;
+        // Values of a chunk collected for binning. Kept to reuse their memory.
+        std::vector<int32_t> xs;
+        std::vector<int32_t> ys;
+        std::vector<float> keyValues;
+        std::vector<float> clickValues;
+    };
+
+    // Events of a rate window.
+    struct WindowCount {
+        uint64_t window;
+        uint64_t count;
+    };
+
+    // Key presses or clicks at the start and the end of a chunk. Intervals and windows that continue in the neighbouring chunks
+    // are only complete once the chunks are merged in capture order.
+    struct Boundary {
+        bool hasEvents;
+        bool hasMultipleWindows;
+        uint64_t firstTime;
+        uint64_t lastTime;
+        WindowCount firstWindow;
+        WindowCount lastWindow;
+    };
+
+    struct ChunkState {
+        parser::ChunkResult result;
+        Boundary keys;
+        Boundary clicks;
+    };
+
+    // Merge state of key presses or clicks carried from chunk to chunk.
+    struct Carry {
+        uint64_t lastTime;
+        bool hasWindow;
+        WindowCount window;
+    };
+
+    static bool isValid(const Options* pOptions);
+    static void initGrid(const Options* pOptions, Grid* pGrid);
+    static void initHistogram(Histogram* pHistogram, double binWidth, uint32_t binCount);
+    static void initPartial(Partial* pPartial, const Options* pOptions);
+    static void binChunk(ChunkState* pState, const Options* pOptions, const Grid* pGrid, bool hasTimes, Partial* pPartial);
+    static void addTime(Boundary* pBoundary, uint64_t time, uint64_t window, float msPerTick, std::vector<float>* pValues, std::vector<uint64_t>* pRates);
+    static void mergeBoundary(const Boundary* pBoundary, float msPerTick, Carry* pCarry, Histogram* pIntervals, Histogram* pRates);
+    static void binValues(const float* values, size_t count, float scale, std::vector<uint64_t>* pBins);
+    static void binPositions(const int32_t* xs, const int32_t* ys, size_t count, const Grid* pGrid, uint64_t* cells, uint64_t* pOutside);
+    static void addRate(uint64_t count, std::vector<uint64_t>* pBins);
+    static void addPartial(const std::vector<uint64_t>& partial, Histogram* pHistogram);
+    static void writeHistogram(const char* name, const Histogram* pHistogram, std::ostream& out);
+
+    void getDefaultOptions(Options* pOptions) {
+        pOptions->width = 256;
+        pOptions->height = 256;
+        pOptions->minX = 0;
+        pOptions->minY = 0;
+        pOptions->maxX = 0xFFFF;
+        pOptions->maxY = 0xFFFF;
+        pOptions->binWidth = 10.0;
+        pOptions->binCount = 200;
+        pOptions->window = RECORD_TIME_RESOLUTION;
+        pOptions->threads = 0;
+
+        return;
+    }
+
+
+    bool analyze(const char* path, const Options* pOptions, Report* pReport) {
+        const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        if (!isValid(pOptions)) {
+
+            return false;
+        }
+
+        parser::Capture capture{};
+
+        if (!parser::open(&capture, path)) {
+
+            return false;
+        }
+
+        unsigned int threads = pOptions->threads ? pOptions->threads : std::max(std::thread::hardware_concurrency(), 1u);
+        const size_t batchSize = static_cast<size_t>(threads) * CHUNKS_PER_THREAD;
+        std::vector<parser::Chunk> chunks;
+        parser::split(&capture, std::max(batchSize, capture.file.size / MAX_CHUNK_SIZE + 1), &chunks);
+        threads = static_cast<unsigned int>(std::min<size_t>(threads, chunks.size()));
+
+        Grid grid{};
+        initGrid(pOptions, &grid);
+        std::vector<Partial> partials(threads);
+
+        for (Partial& partial : partials) {
+            initPartial(&partial, pOptions);
+        }
+
+        *pReport = Report{};
+        pReport->fmt = capture.fmt;
+        pReport->width = pOptions->width;
+        pReport->height = pOptions->height;
+        pReport->hasTimes = capture.fmt == parser::BINARY;
+        initHistogram(&pReport->keyIntervals, pOptions->binWidth, pOptions->binCount);
+        initHistogram(&pReport->clickIntervals, pOptions->binWidth, pOptions->binCount);
+        initHistogram(&pReport->keyRates, 1.0, pOptions->binCount);
+        initHistogram(&pReport->clickRates, 1.0, pOptions->binCount);
+
+        const float msPerTick = 1000.0f / RECORD_TIME_RESOLUTION;
+        std::vector<ChunkState> states(std::min(batchSize, chunks.size()));
+        uint64_t time = capture.header.startTime;
+        Carry keyCarry{ NO_TIME, false, {} };
+        Carry clickCarry{ NO_TIME, false, {} };
+
+        for (size_t batchBegin = 0; batchBegin < chunks.size(); batchBegin += batchSize) {
+            const size_t count = std::min(batchSize, chunks.size() - batchBegin);
+
+            parser::runParallel(threads, count, [&](size_t i, unsigned int) {
+                parser::parseChunk(&capture, &chunks[batchBegin + i], &states[i].result);
+            });
+
+            // the deltas of a chunk continue the time of the previous one
+            for (size_t i = 0; i < count; i++) {
+                parser::resolveTimes(&capture, &time, &states[i].result);
+                pReport->events += states[i].result.events.size();
+                pReport->invalidCount += states[i].result.invalidCount;
+            }
+
+            parser::runParallel(threads, count, [&](size_t i, unsigned int thread) {
+                binChunk(&states[i], pOptions, &grid, pReport->hasTimes, &partials[thread]);
+            });
+
+            for (size_t i = 0; i < count; i++) {
+                mergeBoundary(&states[i].keys, msPerTick, &keyCarry, &pReport->keyIntervals, &pReport->keyRates);
+                mergeBoundary(&states[i].clicks, msPerTick, &clickCarry, &pReport->clickIntervals, &pReport->clickRates);
+            }
+
+        }
+
+        // the last windows are complete at the end of the capture
+        if (keyCarry.hasWindow) {
+            addRate(keyCarry.window.count, &pReport->keyRates.bins);
+            pReport->keyRates.count++;
+        }
+
+        if (clickCarry.hasWindow) {
+            addRate(clickCarry.window.count, &pReport->clickRates.bins);
+            pReport->clickRates.count++;
+        }
+
+        pReport->heatmap.assign(static_cast<size_t>(pOptions->width) * pOptions->height, 0);
+
+        for (const Partial& partial : partials) {
+
+            for (size_t i = 0; i < pReport->heatmap.size(); i++) {
+                pReport->heatmap[i] += partial.heatmap[i];
+            }
+
+            pReport->outside += partial.outside;
+            pReport->keys += partial.keys;
+            pReport->clicks += partial.clicks;
+            addPartial(partial.keyIntervals, &pReport->keyIntervals);
+            addPartial(partial.clickIntervals, &pReport->clickIntervals);
+            addPartial(partial.keyRates, &pReport->keyRates);
+            addPartial(partial.clickRates, &pReport->clickRates);
+        }
+
+        pReport->size = capture.file.size;
+        pReport->threads = threads;
+        parser::close(&capture);
+        pReport->seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        return true;
+    }
+
+
+    void writeHeatmapCsv(const Report* pReport, std::ostream& out) {
+
+        for (uint32_t row = 0; row < pReport->height; row++) {
+            const uint64_t* const cells = &pReport->heatmap[static_cast<size_t>(row) * pReport->width];
+
+            for (uint32_t column = 0; column < pReport->width; column++) {
+                out << (column ? "," : "") << cells[column];
+            }
+
+            out << '\n';
+        }
+
+        return;
+    }
+
+
+    void writeHeatmapPgm(const Report* pReport, std::ostream& out) {
+        const uint64_t maxCount = pReport->heatmap.empty() ? 0 : *std::max_element(pReport->heatmap.begin(), pReport->heatmap.end());
+        const double scale = maxCount ? 255.0 / std::log1p(static_cast<double>(maxCount)) : 0.0;
+        std::vector<uint8_t> pixels(pReport->heatmap.size());
+
+        for (size_t i = 0; i < pixels.size(); i++) {
+            pixels[i] = static_cast<uint8_t>(std::log1p(static_cast<double>(pReport->heatmap[i])) * scale + 0.5);
+        }
+
+        out << "P5\n" << pReport->width << ' ' << pReport->height << "\n255\n";
+        out.write(reinterpret_cast<const char*>(pixels.data()), static_cast<std::streamsize>(pixels.size()));
+
+        return;
+    }
+
+
+    void writeHistogramsCsv(const Report* pReport, std::ostream& out) {
+        out << "histogram,from,to,count\n";
+        writeHistogram("key_interval_ms", &pReport->keyIntervals, out);
+        writeHistogram("click_interval_ms", &pReport->clickIntervals, out);
+        writeHistogram("keys_per_window", &pReport->keyRates, out);
+        writeHistogram("clicks_per_window", &pReport->clickRates, out);
+
+        return;
+    }
+
+
+    static bool isValid(const Options* pOptions) {
+
+        if (!pOptions->width || !pOptions->height || static_cast<uint64_t>(pOptions->width) * pOptions->height > MAX_CELLS) return false;
+
+        // the extent of the bounds has to fit into 32 bits for the vector implementation
+        const int64_t extentX = static_cast<int64_t>(pOptions->maxX) - pOptions->minX;
+        const int64_t extentY = static_cast<int64_t>(pOptions->maxY) - pOptions->minY;
+
+        if (extentX < 0 || extentY < 0 || extentX >= INT32_MAX || extentY >= INT32_MAX) return false;
+
+        return pOptions->binWidth > 0.0 && pOptions->binCount >= 2 && pOptions->binCount <= MAX_BINS && pOptions->window;
+    }
+
+
+    static void initGrid(const Options* pOptions, Grid* pGrid) {
+        pGrid->minX = pOptions->minX;
+        pGrid->minY = pOptions->minY;
+        pGrid->maxX = pOptions->maxX;
+        pGrid->maxY = pOptions->maxY;
+        pGrid->scaleX = static_cast<float>(static_cast<double>(pOptions->width) / (static_cast<double>(pOptions->maxX) - pOptions->minX + 1.0));
+        pGrid->scaleY = static_cast<float>(static_cast<double>(pOptions->height) / (static_cast<double>(pOptions->maxY) - pOptions->minY + 1.0));
+        pGrid->maxColumn = static_cast<float>(pOptions->width - 1);
+        pGrid->maxRow = static_cast<float>(pOptions->height - 1);
+        pGrid->width = static_cast<float>(pOptions->width);
+
+        return;
+    }
+
+
+    static void initHistogram(Histogram* pHistogram, double binWidth, uint32_t binCount) {
+        pHistogram->binWidth = binWidth;
+        pHistogram->bins.assign(binCount, 0);
+        pHistogram->count = 0;
+
+        return;
+    }
+
+
+    static void initPartial(Partial* pPartial, const Options* pOptions) {
+        pPartial->heatmap.assign(static_cast<size_t>(pOptions->width) * pOptions->height, 0);
+        pPartial->outside = 0;
+        pPartial->keys = 0;
+        pPartial->clicks = 0;
+        pPartial->keyIntervals.assign(pOptions->binCount, 0);
+        pPartial->clickIntervals.assign(pOptions->binCount, 0);
+        pPartial->keyRates.assign(pOptions->binCount, 0);
+        pPartial->clickRates.assign(pOptions->binCount, 0);
+
+        return;
+    }
+
+
+    // Collects the click positions and the intervals of a chunk and bins them into the partial results of the thread.
+    static void binChunk(ChunkState* pState, const Options* pOptions, const Grid* pGrid, bool hasTimes, Partial* pPartial) {
+        pState->keys = Boundary{};
+        pState->clicks = Boundary{};
+        pPartial->xs.clear();
+        pPartial->ys.clear();
+        pPartial->keyValues.clear();
+        pPartial->clickValues.clear();
+        const float msPerTick = 1000.0f / RECORD_TIME_RESOLUTION;
+
+        for (const parser::Event& event : pState->result.events) {
+
+            if (event.type == parser::BUTTON) {
+                pPartial->xs.push_back(event.x);
+                pPartial->ys.push_back(event.y);
+
+                if (hasTimes) {
+                    addTime(&pState->clicks, event.time, pOptions->window, msPerTick, &pPartial->clickValues, &pPartial->clickRates);
+                }
+
+            }
+            else if (event.type == parser::KEY && !(event.flags & KEY_FLAG_BREAK)) {
+                pPartial->keys++;
+
+                if (hasTimes) {
+                    addTime(&pState->keys, event.time, pOptions->window, msPerTick, &pPartial->keyValues, &pPartial->keyRates);
+                }
+
+            }
+
+        }
+
+        pPartial->clicks += pPartial->xs.size();
+        binPositions(pPartial->xs.data(), pPartial->ys.data(), pPartial->xs.size(), pGrid, pPartial->heatmap.data(), &pPartial->outside);
+        const float scale = static_cast<float>(1.0 / pOptions->binWidth);
+        binValues(pPartial->keyValues.data(), pPartial->keyValues.size(), scale, &pPartial->keyIntervals);
+        binValues(pPartial->clickValues.data(), pPartial->clickValues.size(), scale, &pPartial->clickIntervals);
+
+        return;
+    }
+
+
+    // Adds the interval to the previous event of a chunk and counts the event in its window.
+    // Only windows between the first and the last window of a chunk are complete.
+    static void addTime(Boundary* pBoundary, uint64_t time, uint64_t window, float msPerTick, std::vector<float>* pValues, std::vector<uint64_t>* pRates) {
+        const uint64_t windowIndex = time / window;
+
+        if (!pBoundary->hasEvents) {
+            pBoundary->hasEvents = true;
+            pBoundary->firstTime = time;
+            pBoundary->lastTime = time;
+            pBoundary->firstWindow = WindowCount{ windowIndex, 1 };
+            pBoundary->lastWindow = pBoundary->firstWindow;
+
+            return;
+        }
+
+        // entries of the driver queues are not strictly ordered by time
+        const uint64_t interval = time > pBoundary->lastTime ? time - pBoundary->lastTime : 0;
+        pValues->push_back(static_cast<float>(interval) * msPerTick);
+        pBoundary->lastTime = time;
+
+        if (windowIndex == pBoundary->lastWindow.window) {
+            pBoundary->lastWindow.count++;
+
+            if (!pBoundary->hasMultipleWindows) {
+                pBoundary->firstWindow.count++;
+            }
+
+            return;
+        }
+
+        if (pBoundary->hasMultipleWindows) {
+            addRate(pBoundary->lastWindow.count, pRates);
+        }
+
+        pBoundary->hasMultipleWindows = true;
+        pBoundary->lastWindow = WindowCount{ windowIndex, 1 };
+
+        return;
+    }
+
+
+    // Adds the interval and the window that span from the previous chunks to a chunk.
+    static void mergeBoundary(const Boundary* pBoundary, float msPerTick, Carry* pCarry, Histogram* pIntervals, Histogram* pRates) {
+
+        if (!pBoundary->hasEvents) return;
+
+        if (pCarry->lastTime != NO_TIME) {
+            const uint64_t interval = pBoundary->firstTime > pCarry->lastTime ? pBoundary->firstTime - pCarry->lastTime : 0;
+            const float value = static_cast<float>(interval) * msPerTick;
+            binValues(&value, 1, static_cast<float>(1.0 / pIntervals->binWidth), &pIntervals->bins);
+            pIntervals->count++;
+        }
+
+        pCarry->lastTime = pBoundary->lastTime;
+
+        if (pCarry->hasWindow && pCarry->window.window == pBoundary->firstWindow.window) {
+            pCarry->window.count += pBoundary->firstWindow.count;
+        }
+        else {
+
+            if (pCarry->hasWindow) {
+                addRate(pCarry->window.count, &pRates->bins);
+                pRates->count++;
+            }
+
+            pCarry->hasWindow = true;
+            pCarry->window = pBoundary->firstWindow;
+        }
+
+        if (pBoundary->hasMultipleWindows) {
+            addRate(pCarry->window.count, &pRates->bins);
+            pRates->count++;
+            pCarry->window = pBoundary->lastWindow;
+        }
+
+        return;
+    }
+
+
+    // Four bin indices are computed at a time. The values are expected to be non-negative.
+    static void binValues(const float* values, size_t count, float scale, std::vector<uint64_t>* pBins) {
+        uint64_t* const bins = pBins->data();
+        const float maxBin = static_cast<float>(pBins->size() - 1);
+        size_t i = 0;
+
+#ifdef ANALYTICS_SSE2
+        const __m128 scales = _mm_set1_ps(scale);
+        const __m128 maxBins = _mm_set1_ps(maxBin);
+
+        for (; i + 4 <= count; i += 4) {
+            // clamped before the conversion, which would overflow for large values
+            const __m128 scaled = _mm_min_ps(_mm_mul_ps(_mm_loadu_ps(values + i), scales), maxBins);
+            alignas(16) int32_t indices[4];
+            _mm_store_si128(reinterpret_cast<__m128i*>(indices), _mm_cvttps_epi32(scaled));
+            bins[indices[0]]++;
+            bins[indices[1]]++;
+            bins[indices[2]]++;
+            bins[indices[3]]++;
+        }
+#endif
+
+        for (; i < count; i++) {
+            bins[static_cast<int32_t>(std::min(values[i] * scale, maxBin))]++;
+        }
+
+        return;
+    }
+
+
+    // Four positions are binned at a time. The cell index is computed with floats, which is exact for up to MAX_CELLS cells.
+    static void binPositions(const int32_t* xs, const int32_t* ys, size_t count, const Grid* pGrid, uint64_t* cells, uint64_t* pOutside) {
+        size_t i = 0;
+
+#ifdef ANALYTICS_SSE2
+        const __m128i minX = _mm_set1_epi32(pGrid->minX);
+        const __m128i minY = _mm_set1_epi32(pGrid->minY);
+        const __m128i maxX = _mm_set1_epi32(pGrid->maxX);
+        const __m128i maxY = _mm_set1_epi32(pGrid->maxY);
+        const __m128 scaleX = _mm_set1_ps(pGrid->scaleX);
+        const __m128 scaleY = _mm_set1_ps(pGrid->scaleY);
+        const __m128 maxColumn = _mm_set1_ps(pGrid->maxColumn);
+        const __m128 maxRow = _mm_set1_ps(pGrid->maxRow);
+        const __m128 width = _mm_set1_ps(pGrid->width);
+
+        for (; i + 4 <= count; i += 4) {
+            const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(xs + i));
+            const __m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ys + i));
+            const __m128i outsideX = _mm_or_si128(_mm_cmplt_epi32(x, minX), _mm_cmpgt_epi32(x, maxX));
+            const __m128i outsideY = _mm_or_si128(_mm_cmplt_epi32(y, minY), _mm_cmpgt_epi32(y, maxY));
+            const int outsideMask = _mm_movemask_ps(_mm_castsi128_ps(_mm_or_si128(outsideX, outsideY)));
+            // truncated to whole columns and rows before the cell index is computed
+            const __m128 column = _mm_cvtepi32_ps(_mm_cvttps_epi32(_mm_min_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_sub_epi32(x, minX)), scaleX), maxColumn)));
+            const __m128 row = _mm_cvtepi32_ps(_mm_cvttps_epi32(_mm_min_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_sub_epi32(y, minY)), scaleY), maxRow)));
+            alignas(16) int32_t indices[4];
+            _mm_store_si128(reinterpret_cast<__m128i*>(indices), _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(row, width), column)));
+
+            for (int lane = 0; lane < 4; lane++) {
+
+                if (outsideMask & 1 << lane) {
+                    (*pOutside)++;
+                }
+                else {
+                    cells[indices[lane]]++;
+                }
+
+            }
+
+        }
+#endif
+
+        for (; i < count; i++) {
+
+            if (xs[i] < pGrid->minX || xs[i] > pGrid->maxX || ys[i] < pGrid->minY || ys[i] > pGrid->maxY) {
+                (*pOutside)++;
+
+                continue;
+            }
+
+            const float column = static_cast<float>(static_cast<int32_t>(std::min(static_cast<float>(xs[i] - pGrid->minX) * pGrid->scaleX, pGrid->maxColumn)));
+            const float row = static_cast<float>(static_cast<int32_t>(std::min(static_cast<float>(ys[i] - pGrid->minY) * pGrid->scaleY, pGrid->maxRow)));
+            cells[static_cast<int32_t>(row * pGrid->width + column)]++;
+        }
+
+        return;
+    }
+
+
+    // Windows with more events than bins are counted in the last bin.
+    static void addRate(uint64_t count, std::vector<uint64_t>* pBins) {
+        (*pBins)[std::min<uint64_t>(count, pBins->size() - 1)]++;
+
+        return;
+    }
+
+
+    static void addPartial(const std::vector<uint64_t>& partial, Histogram* pHistogram) {
+
+        for (size_t i = 0; i < partial.size(); i++) {
+            pHistogram->bins[i] += partial[i];
+            pHistogram->count += partial[i];
+        }
+
+        return;
+    }
+
+
+    // Writes one line per bin. The last bin has no upper bound.
+    static void writeHistogram(const char* name, const Histogram* pHistogram, std::ostream& out) {
+
+        for (size_t i = 0; i < pHistogram->bins.size(); i++) {
+            out << name << ',' << static_cast<double>(i) * pHistogram->binWidth << ',';
+
+            if (i + 1 < pHistogram->bins.size()) {
+                out << static_cast<double>(i + 1) * pHistogram->binWidth;
+            }
+
+            out << ',' << pHistogram->bins[i] << '\n';
+        }
+
+        return;
+    }
+
+}
\ No newline at end of file
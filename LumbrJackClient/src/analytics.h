@@ -0,0 +1,125 @@
+#pragma once
+#include "parser.h"
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+// Click heatmaps and key and click timing histograms of captures.
+// Computed in a single pass over the capture: chunks are parsed and binned on all cores into partial results per thread,
+// which are merged at the end. Only a bounded number of chunks is held at a time, so memory does not grow with the capture.
+// Only the file mapping of the parser depends on the platform, so captures can be analyzed on any platform.
+namespace analytics {
+
+	// Options of the analysis.
+	struct Options {
+		// Cells of the heatmap.
+		uint32_t width;
+		uint32_t height;
+		// Click positions covered by the heatmap, inclusive. Clicks outside are counted but not binned.
+		int32_t minX;
+		int32_t minY;
+		int32_t maxX;
+		int32_t maxY;
+		// Milliseconds per bin of the interval histograms.
+		double binWidth;
+		// Bins of the interval and rate histograms. The last bin also counts all larger values.
+		uint32_t binCount;
+		// Ticks of RECORD_TIME_RESOLUTION per window of the rate histograms.
+		uint64_t window;
+		// Number of threads. Zero for one per core.
+		unsigned int threads;
+	};
+
+	// Histogram with bins of equal width starting at zero.
+	struct Histogram {
+		double binWidth;
+		std::vector<uint64_t> bins;
+		uint64_t count;
+	};
+
+	// Results of the analysis.
+	struct Report {
+		parser::format fmt;
+		// Clicks per cell, row by row from minY to maxY.
+		std::vector<uint64_t> heatmap;
+		uint32_t width;
+		uint32_t height;
+		// Clicks outside of the heatmap.
+		uint64_t outside;
+		uint64_t keys;
+		uint64_t clicks;
+		uint64_t events;
+		uint64_t invalidCount;
+		// Set if the capture contains times, otherwise the histograms are empty.
+		bool hasTimes;
+		// Milliseconds between consecutive key presses and consecutive clicks.
+		Histogram keyIntervals;
+		Histogram clickIntervals;
+		// Key presses and clicks per window. Windows without any are not counted.
+		Histogram keyRates;
+		Histogram clickRates;
+		uint64_t size;
+		unsigned int threads;
+		double seconds;
+	};
+
+	// Gets the default options: a 256 by 256 heatmap of the absolute coordinates of Windows (0 to 65535),
+	// 200 bins of 10 milliseconds and windows of one second.
+	//
+	// Parameters:
+	//
+	// [out] pOptions:
+	// Contains the default options on return.
+	void getDefaultOptions(Options* pOptions);
+
+	// Analyzes a capture.
+	//
+	// Parameters:
+	//
+	// [in] path:
+	// Path of the capture. Text logs and binary log files are supported, see parser.h.
+	//
+	// [in] pOptions:
+	// Options of the analysis.
+	//
+	// [out] pReport:
+	// Contains the results on return.
+	//
+	// Return:
+	// True on success, false if the options are invalid or the capture could not be parsed.
+	bool analyze(const char* path, const Options* pOptions, Report* pReport);
+
+	// Writes the heatmap as comma separated values, one line per row.
+	//
+	// Parameters:
+	//
+	// [in] pReport:
+	// Results of an analysis.
+	//
+	// [out] out:
+	// Stream the values are written to.
+	void writeHeatmapCsv(const Report* pReport, std::ostream& out);
+
+	// Writes the heatmap as binary 8 bit PGM image. Counts are scaled logarithmically, so single clicks stay visible next to hot spots.
+	//
+	// Parameters:
+	//
+	// [in] pReport:
+	// Results of an analysis.
+	//
+	// [out] out:
+	// Binary stream the image is written to.
+	void writeHeatmapPgm(const Report* pReport, std::ostream& out);
+
+	// Writes all histograms as comma separated values with a header line.
+	//
+	// Parameters:
+	//
+	// [in] pReport:
+	// Results of an analysis.
+	//
+	// [out] out:
+	// Stream the values are written to.
+	void writeHistogramsCsv(const Report* pReport, std::ostream& out);
+
+}
\ No newline at end of file
@@ -0,0 +1,570 @@
+#include "columns.h"
+#include "decompress.h"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <thread>
+
+namespace columns {
+
+    // Chunks of the capture per thread and batch.
+    static constexpr size_t CHUNKS_PER_THREAD = 4;
+    // Largest chunk of the capture parsed at once. Bounds the events held at a time.
+    static constexpr size_t MAX_CAPTURE_CHUNK_SIZE = 0x400000;
+    // Bytes per value of the columns.
+    static constexpr size_t columnWidths[MAX_COLUMN] = {
+        sizeof(uint64_t), sizeof(uint8_t), sizeof(uint16_t), sizeof(uint16_t), sizeof(int32_t), sizeof(int32_t), sizeof(uint16_t), sizeof(uint64_t)
+    };
+    static const char* const columnNames[MAX_COLUMN] = { "time", "type", "code", "flags", "x", "y", "source", "seq" };
+    static constexpr uint32_t ALL_TYPES = (1u << parser::MAX_EVENT_TYPE) - 1;
+
+    // Column blocks of a chunk before they are written. Offsets of the entry are relative to the data.
+    struct EncodedChunk {
+        ChunkEntry entry;
+        std::vector<uint8_t> data;
+    };
+
+    static void encodeChunk(const parser::Event* events, size_t count, EncodedChunk* pChunk);
+    static int64_t getValue(const parser::Event* pEvent, column col);
+    static bool isValid(const FileHeader* pHeader, const ChunkEntry* entries, size_t size);
+    static bool canMatch(const ChunkEntry* pEntry, const Filter* pFilter);
+    static bool decodeColumn(const uint8_t* data, const ChunkEntry* pEntry, column col, int64_t* values);
+    static void filterChunk(const int64_t* const* values, size_t count, const Filter* pFilter, uint32_t filterMask, uint8_t* matches);
+    static void appendNumber(std::string* pLine, int64_t value, bool isSigned);
+
+    void getDefaultFilter(Filter* pFilter) {
+        pFilter->typeMask = ALL_TYPES;
+        pFilter->fromTime = 0;
+        pFilter->toTime = UINT64_MAX;
+        pFilter->minX = INT32_MIN;
+        pFilter->minY = INT32_MIN;
+        pFilter->maxX = INT32_MAX;
+        pFilter->maxY = INT32_MAX;
+
+        return;
+    }
+
+
+    bool parseColumns(const std::string& names, uint32_t* pMask) {
+        *pMask = 0;
+        size_t begin = 0;
+
+        while (begin <= names.size()) {
+            const size_t end = std::min(names.find(',', begin), names.size());
+            const std::string name = names.substr(begin, end - begin);
+            const char* const* const pName = std::find(columnNames, columnNames + MAX_COLUMN, name);
+
+            if (pName == columnNames + MAX_COLUMN) return false;
+
+            *pMask |= 1u << (pName - columnNames);
+            begin = end + 1;
+        }
+
+        return true;
+    }
+
+
+    bool parseTypes(const std::string& names, uint32_t* pMask) {
+        *pMask = 0;
+        size_t begin = 0;
+
+        while (begin <= names.size()) {
+            const size_t end = std::min(names.find(',', begin), names.size());
+            std::string name = names.substr(begin, end - begin);
+            std::transform(name.begin(), name.end(), name.begin(), [](char c) { return static_cast<char>(toupper(static_cast<unsigned char>(c))); });
+            uint8_t type = 0;
+
+            while (type < parser::MAX_EVENT_TYPE && name != parser::getTypeName(static_cast<parser::eventType>(type))) {
+                type++;
+            }
+
+            if (type == parser::MAX_EVENT_TYPE) return false;
+
+            *pMask |= 1u << type;
+            begin = end + 1;
+        }
+
+        return true;
+    }
+
+
+    bool exportFile(const char* inPath, const char* outPath, unsigned int threads, ExportStats* pStats) {
+        const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        parser::Capture capture{};
+
+        if (!parser::open(&capture, inPath)) {
+
+            return false;
+        }
+
+        std::ofstream file(outPath, std::ios::binary | std::ios::trunc);
+
+        if (!file) {
+            parser::close(&capture);
+
+            return false;
+        }
+
+        if (!threads) {
+            threads = std::max(std::thread::hardware_concurrency(), 1u);
+        }
+
+        const size_t batchSize = static_cast<size_t>(threads) * CHUNKS_PER_THREAD;
+        std::vector<parser::Chunk> captureChunks;
+        parser::split(&capture, std::max(batchSize, capture.file.size / MAX_CAPTURE_CHUNK_SIZE + 1), &captureChunks);
+
+        FileHeader header{};
+        header.magic = COLUMN_MAGIC;
+        header.version = COLUMN_VERSION;
+        header.headerSize = sizeof(FileHeader);
+        header.columnCount = MAX_COLUMN;
+        header.chunkEvents = CHUNK_EVENTS;
+        header.sourceFormat = capture.fmt;
+        // rewritten with the counts once all chunks are written
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+        std::vector<parser::ChunkResult> results(std::min(batchSize, captureChunks.size()));
+        std::vector<EncodedChunk> encoded;
+        std::vector<ChunkEntry> directory;
+        // events that do not fill a chunk yet
+        std::vector<parser::Event> pending;
+        uint64_t time = capture.header.startTime;
+        uint64_t offset = sizeof(FileHeader);
+
+        for (size_t batchBegin = 0; batchBegin < captureChunks.size(); batchBegin += batchSize) {
+            const size_t count = std::min(batchSize, captureChunks.size() - batchBegin);
+            const bool isLast = batchBegin + count == captureChunks.size();
+
+            parser::runParallel(threads, count, [&](size_t i, unsigned int) {
+                parser::parseChunk(&capture, &captureChunks[batchBegin + i], &results[i]);
+            });
+
+            for (size_t i = 0; i < count; i++) {
+                parser::resolveTimes(&capture, &time, &results[i]);
+                pending.insert(pending.end(), results[i].events.begin(), results[i].events.end());
+            }
+
+            // the last chunk of the file may be partial
+            const size_t chunkCount = isLast ? (pending.size() + CHUNK_EVENTS - 1) / CHUNK_EVENTS : pending.size() / CHUNK_EVENTS;
+            encoded.resize(std::max(encoded.size(), chunkCount));
+
+            parser::runParallel(threads, chunkCount, [&](size_t i, unsigned int) {
+                const size_t first = i * CHUNK_EVENTS;
+                encodeChunk(&pending[first], std::min<size_t>(CHUNK_EVENTS, pending.size() - first), &encoded[i]);
+            });
+
+            for (size_t i = 0; i < chunkCount; i++) {
+                ChunkEntry entry = encoded[i].entry;
+
+                for (ColumnEntry& columnEntry : entry.columns) {
+                    columnEntry.offset += offset;
+                }
+
+                file.write(reinterpret_cast<const char*>(encoded[i].data.data()), static_cast<std::streamsize>(encoded[i].data.size()));
+                offset += encoded[i].data.size();
+                header.eventCount += entry.eventCount;
+                directory.push_back(entry);
+            }
+
+            pending.erase(pending.begin(), pending.begin() + static_cast<ptrdiff_t>(std::min(pending.size(), chunkCount * CHUNK_EVENTS)));
+        }
+
+        header.chunkCount = directory.size();
+        header.directoryOffset = offset;
+        file.write(reinterpret_cast<const char*>(directory.data()), static_cast<std::streamsize>(directory.size() * sizeof(ChunkEntry)));
+        file.seekp(0, std::ios::beg);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        const bool isWritten = static_cast<bool>(file);
+        file.close();
+
+        pStats->eventCount = header.eventCount;
+        pStats->chunkCount = header.chunkCount;
+        pStats->inputSize = capture.file.size;
+        pStats->outputSize = offset + directory.size() * sizeof(ChunkEntry);
+        pStats->threads = static_cast<unsigned int>(std::min<size_t>(threads, captureChunks.size()));
+        parser::close(&capture);
+        pStats->seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        return isWritten;
+    }
+
+
+    bool scan(const char* path, const Filter* pFilter, uint32_t columnMask, std::ostream& out, ScanStats* pStats) {
+        const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        *pStats = ScanStats{};
+        parser::MappedFile file{};
+
+        if (!parser::map(&file, path)) {
+
+            return false;
+        }
+
+        FileHeader header{};
+
+        if (file.size >= sizeof(header)) {
+            memcpy(&header, file.data, sizeof(header));
+        }
+
+        const ChunkEntry* const entries = reinterpret_cast<const ChunkEntry*>(file.data + header.directoryOffset);
+
+        if (file.size < sizeof(header) || !isValid(&header, entries, file.size)) {
+            parser::unmap(&file);
+
+            return false;
+        }
+
+        // columns only decoded for the filter
+        uint32_t filterMask = 0;
+
+        if (pFilter->typeMask != ALL_TYPES) {
+            filterMask |= 1u << TYPE;
+        }
+
+        if (pFilter->fromTime || pFilter->toTime != UINT64_MAX) {
+            filterMask |= 1u << TIME;
+        }
+
+        if (pFilter->minX != INT32_MIN || pFilter->maxX != INT32_MAX) {
+            filterMask |= 1u << X;
+        }
+
+        if (pFilter->minY != INT32_MIN || pFilter->maxY != INT32_MAX) {
+            filterMask |= 1u << Y;
+        }
+
+        if (columnMask) {
+            std::string line;
+
+            for (uint32_t col = 0; col < MAX_COLUMN; col++) {
+
+                if (columnMask & 1u << col) {
+                    line += line.empty() ? "" : ",";
+                    line += columnNames[col];
+                }
+
+            }
+
+            out << line << '\n';
+        }
+
+        std::vector<int64_t> columnValues(static_cast<size_t>(MAX_COLUMN) * CHUNK_EVENTS);
+        const int64_t* values[MAX_COLUMN]{};
+        std::vector<uint8_t> matches(CHUNK_EVENTS);
+        std::string lines;
+        bool isCorrupt = false;
+        pStats->chunkCount = header.chunkCount;
+
+        for (uint64_t chunk = 0; chunk < header.chunkCount && !isCorrupt; chunk++) {
+            ChunkEntry entry{};
+            memcpy(&entry, &entries[chunk], sizeof(entry));
+
+            if (!canMatch(&entry, pFilter)) {
+                pStats->skippedCount++;
+
+                continue;
+            }
+
+            for (uint32_t col = 0; col < MAX_COLUMN; col++) {
+
+                if (!((columnMask | filterMask) & 1u << col)) continue;
+
+                int64_t* const columnData = &columnValues[static_cast<size_t>(col) * CHUNK_EVENTS];
+
+                if (!decodeColumn(file.data, &entry, static_cast<column>(col), columnData)) {
+                    isCorrupt = true;
+                    break;
+                }
+
+                values[col] = columnData;
+                pStats->readSize += entry.columns[col].compressedSize;
+            }
+
+            if (isCorrupt) break;
+
+            filterChunk(values, entry.eventCount, pFilter, filterMask, matches.data());
+            lines.clear();
+
+            for (uint32_t i = 0; i < entry.eventCount; i++) {
+
+                if (!matches[i]) continue;
+
+                pStats->matchCount++;
+
+                if (!columnMask) continue;
+
+                bool isFirst = true;
+
+                for (uint32_t col = 0; col < MAX_COLUMN; col++) {
+
+                    if (!(columnMask & 1u << col)) continue;
+
+                    if (!isFirst) {
+                        lines += ',';
+                    }
+
+                    if (col == TYPE) {
+                        lines += parser::getTypeName(static_cast<parser::eventType>(values[col][i]));
+                    }
+                    else {
+                        appendNumber(&lines, values[col][i], col != TIME && col != SEQ);
+                    }
+
+                    isFirst = false;
+                }
+
+                lines += '\n';
+            }
+
+            out.write(lines.data(), static_cast<std::streamsize>(lines.size()));
+        }
+
+        parser::unmap(&file);
+        pStats->seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        return !isCorrupt;
+    }
+
+
+    // Times and sequence numbers are stored as differences to the previous event, which are small for input in capture order.
+    // Values are split into byte planes before compression, so the mostly zero upper bytes form long runs.
+    static void encodeChunk(const parser::Event* events, size_t count, EncodedChunk* pChunk) {
+        std::vector<uint8_t> planes(LZ_BLOCK_SIZE);
+        std::vector<uint8_t> compressed(LZ_MAX_COMPRESSED_SIZE(LZ_BLOCK_SIZE));
+        std::vector<uint16_t> hashTable(LZ_HASH_TABLE_SIZE / sizeof(uint16_t));
+        pChunk->entry = ChunkEntry{};
+        pChunk->entry.eventCount = static_cast<uint32_t>(count);
+        pChunk->data.clear();
+
+        for (uint32_t col = 0; col < MAX_COLUMN; col++) {
+            ColumnEntry* const pColumnEntry = &pChunk->entry.columns[col];
+            const size_t width = columnWidths[col];
+            int64_t min = INT64_MAX;
+            int64_t max = INT64_MIN;
+            int64_t previous = 0;
+
+            for (size_t i = 0; i < count; i++) {
+                const int64_t value = getValue(&events[i], static_cast<column>(col));
+                min = std::min(min, value);
+                max = std::max(max, value);
+                // wraps for times that go back and for sequence numbers of interleaved sources
+                const uint64_t stored = col == TIME || col == SEQ ? static_cast<uint64_t>(value) - static_cast<uint64_t>(previous) : static_cast<uint64_t>(value);
+                previous = value;
+
+                for (size_t byte = 0; byte < width; byte++) {
+                    planes[byte * count + i] = static_cast<uint8_t>(stored >> byte * 8);
+                }
+
+            }
+
+            const size_t size = width * count;
+            const size_t compressedSize = lzCompress(planes.data(), size, compressed.data(), compressed.size(), hashTable.data());
+            const bool isCompressed = compressedSize && compressedSize < size;
+            const uint8_t* const block = isCompressed ? compressed.data() : planes.data();
+            pColumnEntry->offset = pChunk->data.size();
+            pColumnEntry->compressedSize = static_cast<uint32_t>(isCompressed ? compressedSize : size);
+            pColumnEntry->size = static_cast<uint32_t>(size);
+            pColumnEntry->min = count ? min : 0;
+            pColumnEntry->max = count ? max : 0;
+            pChunk->data.insert(pChunk->data.end(), block, block + pColumnEntry->compressedSize);
+        }
+
+        return;
+    }
+
+
+    static int64_t getValue(const parser::Event* pEvent, column col) {
+
+        switch (col) {
+        case TIME:
+            return static_cast<int64_t>(pEvent->time);
+        case TYPE:
+            return pEvent->type;
+        case CODE:
+            return pEvent->code;
+        case FLAGS:
+            return pEvent->flags;
+        case X:
+            return pEvent->x;
+        case Y:
+            return pEvent->y;
+        case SOURCE:
+            return pEvent->source;
+        case SEQ:
+            return static_cast<int64_t>(pEvent->sequence);
+        default:
+            return 0;
+        }
+
+    }
+
+
+    static bool isValid(const FileHeader* pHeader, const ChunkEntry* entries, size_t size) {
+
+        if (pHeader->magic != COLUMN_MAGIC || pHeader->version != COLUMN_VERSION || pHeader->headerSize < sizeof(FileHeader)
+            || pHeader->columnCount != MAX_COLUMN || pHeader->chunkEvents != CHUNK_EVENTS || pHeader->directoryOffset > size
+            || pHeader->chunkCount > (size - pHeader->directoryOffset) / sizeof(ChunkEntry)) {
+
+            return false;
+        }
+
+        for (uint64_t chunk = 0; chunk < pHeader->chunkCount; chunk++) {
+            ChunkEntry entry{};
+            memcpy(&entry, &entries[chunk], sizeof(entry));
+
+            if (entry.eventCount > CHUNK_EVENTS || entry.columns[TYPE].min < 0 || entry.columns[TYPE].max >= parser::MAX_EVENT_TYPE) return false;
+
+            for (uint32_t col = 0; col < MAX_COLUMN; col++) {
+                const ColumnEntry* const pColumnEntry = &entry.columns[col];
+
+                if (pColumnEntry->size != entry.eventCount * columnWidths[col] || pColumnEntry->compressedSize > pColumnEntry->size
+                    || pColumnEntry->offset > pHeader->directoryOffset || pColumnEntry->compressedSize > pHeader->directoryOffset - pColumnEntry->offset) {
+
+                    return false;
+                }
+
+            }
+
+        }
+
+        return true;
+    }
+
+
+    // A chunk can only contain matching events if the ranges of its columns overlap the ranges of the filter.
+    static bool canMatch(const ChunkEntry* pEntry, const Filter* pFilter) {
+        const ColumnEntry* const columns = pEntry->columns;
+
+        if (!pEntry->eventCount) return false;
+
+        // types from the minimum to the maximum of the chunk
+        const uint64_t typeRange = (2ull << columns[TYPE].max) - (1ull << columns[TYPE].min);
+
+        if (!(typeRange & pFilter->typeMask)) return false;
+
+        if (static_cast<uint64_t>(columns[TIME].max) < pFilter->fromTime || static_cast<uint64_t>(columns[TIME].min) > pFilter->toTime) return false;
+
+        if (columns[X].max < pFilter->minX || columns[X].min > pFilter->maxX) return false;
+
+        return columns[Y].max >= pFilter->minY && columns[Y].min <= pFilter->maxY;
+    }
+
+
+    static bool decodeColumn(const uint8_t* data, const ChunkEntry* pEntry, column col, int64_t* values) {
+        const ColumnEntry* const pColumnEntry = &pEntry->columns[col];
+        const size_t count = pEntry->eventCount;
+        const size_t width = columnWidths[col];
+        uint8_t planes[LZ_BLOCK_SIZE];
+        const uint8_t* const block = data + pColumnEntry->offset;
+
+        if (pColumnEntry->compressedSize == pColumnEntry->size) {
+            memcpy(planes, block, pColumnEntry->size);
+        }
+        else if (!decompress::decompressBlock(block, pColumnEntry->compressedSize, planes, pColumnEntry->size)) {
+
+            return false;
+        }
+
+        for (size_t i = 0; i < count; i++) {
+            uint64_t stored = 0;
+
+            for (size_t byte = 0; byte < width; byte++) {
+                stored |= static_cast<uint64_t>(planes[byte * count + i]) << byte * 8;
+            }
+
+            values[i] = static_cast<int64_t>(stored);
+        }
+
+        if (col == TYPE) {
+
+            for (size_t i = 0; i < count; i++) {
+
+                if (values[i] >= parser::MAX_EVENT_TYPE) return false;
+
+            }
+
+        }
+        else if (col == X || col == Y) {
+
+            for (size_t i = 0; i < count; i++) {
+                values[i] = static_cast<int32_t>(values[i]);
+            }
+
+        }
+        else if (col == TIME || col == SEQ) {
+
+            for (size_t i = 1; i < count; i++) {
+                values[i] = static_cast<int64_t>(static_cast<uint64_t>(values[i]) + static_cast<uint64_t>(values[i - 1]));
+            }
+
+        }
+
+        return true;
+    }
+
+
+    // Evaluates the conditions column by column over the whole chunk.
+    static void filterChunk(const int64_t* const* values, size_t count, const Filter* pFilter, uint32_t filterMask, uint8_t* matches) {
+        memset(matches, 1, count);
+
+        if (filterMask & 1u << TYPE) {
+
+            for (size_t i = 0; i < count; i++) {
+                matches[i] &= static_cast<uint8_t>(pFilter->typeMask >> values[TYPE][i] & 1);
+            }
+
+        }
+
+        if (filterMask & 1u << TIME) {
+            const int64_t* const times = values[TIME];
+
+            for (size_t i = 0; i < count; i++) {
+                matches[i] &= static_cast<uint64_t>(times[i]) >= pFilter->fromTime && static_cast<uint64_t>(times[i]) <= pFilter->toTime;
+            }
+
+        }
+
+        if (filterMask & 1u << X) {
+
+            for (size_t i = 0; i < count; i++) {
+                matches[i] &= values[X][i] >= pFilter->minX && values[X][i] <= pFilter->maxX;
+            }
+
+        }
+
+        if (filterMask & 1u << Y) {
+
+            for (size_t i = 0; i < count; i++) {
+                matches[i] &= values[Y][i] >= pFilter->minY && values[Y][i] <= pFilter->maxY;
+            }
+
+        }
+
+        return;
+    }
+
+
+    // Times and sequence numbers are unsigned 64 bit values.
+    static void appendNumber(std::string* pLine, int64_t value, bool isSigned) {
+        char digits[0x20];
+        size_t length = 0;
+        const bool isNegative = isSigned && value < 0;
+        uint64_t magnitude = isNegative ? 0 - static_cast<uint64_t>(value) : static_cast<uint64_t>(value);
+
+        do {
+            digits[length++] = static_cast<char>('0' + magnitude % 10);
+            magnitude /= 10;
+        } while (magnitude);
+
+        if (isNegative) {
+            digits[length++] = '-';
+        }
+
+        std::reverse(digits, digits + length);
+        pLine->append(digits, length);
+
+        return;
+    }
+
+}
\ No newline at end of file
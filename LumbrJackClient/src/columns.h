@@ -0,0 +1,169 @@
+#pragma once
+#include "../../LumbrJackDriver/src/lz.h"
+#include "parser.h"
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+// Columnar export of captures for analytical queries.
+// Events are stored in chunks of CHUNK_EVENTS events with one compressed block per column and chunk.
+// The directory at the end of the file holds the minimum and maximum of every column of every chunk,
+// so a scan only decompresses the columns it needs and skips chunks that can not match.
+// Only the file mapping of the parser depends on the platform, so captures can be exported and scanned on any platform.
+namespace columns {
+
+	// Magic of columnar files: "LJCL".
+	constexpr uint32_t COLUMN_MAGIC = 0x4C434A4C;
+	constexpr uint16_t COLUMN_VERSION = 2;
+	// Events per chunk. The largest column of a chunk fits into a single block of the compressor (see lz.h).
+	constexpr uint32_t CHUNK_EVENTS = LZ_BLOCK_SIZE / sizeof(uint64_t);
+
+	// Columns in file order. SOURCE and SEQ are the source ID and the sequence number of the events (see parser::Event), zero if the capture has none.
+	enum column { TIME = 0, TYPE, CODE, FLAGS, X, Y, SOURCE, SEQ, MAX_COLUMN };
+
+	// Header of a columnar file. Followed by the column blocks and the directory.
+	struct FileHeader {
+		uint32_t magic;
+		uint16_t version;
+		uint16_t headerSize;
+		uint32_t columnCount;
+		uint32_t chunkEvents;
+		uint64_t eventCount;
+		uint64_t chunkCount;
+		// Offset of the chunk entries.
+		uint64_t directoryOffset;
+		// Format of the exported capture, see parser::format.
+		uint32_t sourceFormat;
+		uint32_t reserved;
+	};
+
+	// Block of a column of a chunk. Blocks with equal sizes are stored uncompressed.
+	struct ColumnEntry {
+		uint64_t offset;
+		uint32_t compressedSize;
+		uint32_t size;
+		int64_t min;
+		int64_t max;
+	};
+
+	struct ChunkEntry {
+		uint32_t eventCount;
+		uint32_t reserved;
+		ColumnEntry columns[MAX_COLUMN];
+	};
+
+	// Conditions of a scan. Events have to match all of them.
+	struct Filter {
+		// Bit per parser::eventType.
+		uint32_t typeMask;
+		// Ticks since the start of the log file, inclusive.
+		uint64_t fromTime;
+		uint64_t toTime;
+		// Region of x and y, inclusive.
+		int32_t minX;
+		int32_t minY;
+		int32_t maxX;
+		int32_t maxY;
+	};
+
+	// Statistics of an export.
+	struct ExportStats {
+		uint64_t eventCount;
+		uint64_t chunkCount;
+		uint64_t inputSize;
+		uint64_t outputSize;
+		unsigned int threads;
+		double seconds;
+	};
+
+	// Statistics of a scan.
+	struct ScanStats {
+		uint64_t chunkCount;
+		// Chunks skipped by their minimum and maximum.
+		uint64_t skippedCount;
+		uint64_t matchCount;
+		// Compressed bytes of the columns read.
+		uint64_t readSize;
+		double seconds;
+	};
+
+	// Gets a filter that matches all events.
+	//
+	// Parameters:
+	//
+	// [out] pFilter:
+	// Contains the filter on return.
+	void getDefaultFilter(Filter* pFilter);
+
+	// Parses a comma separated list of column names, e.g. "time,x,y".
+	//
+	// Parameters:
+	//
+	// [in] names:
+	// Column names in lower case.
+	//
+	// [out] pMask:
+	// Contains a bit per column on return.
+	//
+	// Return:
+	// True on success, false if a name is unknown.
+	bool parseColumns(const std::string& names, uint32_t* pMask);
+
+	// Parses a comma separated list of event type names, e.g. "button,wheel".
+	//
+	// Parameters:
+	//
+	// [in] names:
+	// Names of parser::getTypeName in any case.
+	//
+	// [out] pMask:
+	// Contains a bit per event type on return.
+	//
+	// Return:
+	// True on success, false if a name is unknown.
+	bool parseTypes(const std::string& names, uint32_t* pMask);
+
+	// Converts a capture to a columnar file. The capture is parsed on multiple threads and the chunks are compressed in parallel.
+	//
+	// Parameters:
+	//
+	// [in] inPath:
+	// Path of the capture. Text logs and binary log files are supported, see parser.h.
+	//
+	// [in] outPath:
+	// Path of the columnar file. Overwritten if it exists.
+	//
+	// [in] threads:
+	// Number of threads. Zero for one per core.
+	//
+	// [out] pStats:
+	// Contains the statistics of the export on return.
+	//
+	// Return:
+	// True on success, false if the capture could not be parsed or the file could not be written.
+	bool exportFile(const char* inPath, const char* outPath, unsigned int threads, ExportStats* pStats);
+
+	// Scans a columnar file and writes the matching events as comma separated values with a header line.
+	//
+	// Parameters:
+	//
+	// [in] path:
+	// Path of the columnar file.
+	//
+	// [in] pFilter:
+	// Conditions of the scan.
+	//
+	// [in] columnMask:
+	// Bit per column to write. Zero to only count the matching events.
+	//
+	// [out] out:
+	// Stream the values are written to.
+	//
+	// [out] pStats:
+	// Contains the statistics of the scan on return.
+	//
+	// Return:
+	// True on success, false if the file is invalid or corrupt.
+	bool scan(const char* path, const Filter* pFilter, uint32_t columnMask, std::ostream& out, ScanStats* pStats);
+
+}
\ No newline at end of file
@@ -0,0 +1,978 @@
+#include "commands.h"
+#include "decoder.h"
+#include "decompress.h"
+#include "timeindex.h"
+#include "gaps.h"
+#include "parser.h"
+#include "analytics.h"
+#include "columns.h"
+#include "merge.h"
+#include "follow.h"
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <thread>
+
+namespace commands {
+
+    static int decode(int argc, char* argv[]);
+    static int decompressLog(int argc, char* argv[]);
+    static int decodeKeys(int argc, char* argv[]);
+    static int indexLog(int argc, char* argv[]);
+    static int extractRange(int argc, char* argv[]);
+    static int checkGaps(int argc, char* argv[]);
+    static int parseCapture(int argc, char* argv[]);
+    static int writeHeatmap(int argc, char* argv[]);
+    static int writeHistograms(int argc, char* argv[]);
+    static int exportColumns(int argc, char* argv[]);
+    static int queryColumns(int argc, char* argv[]);
+    static int mergeCaptures(int argc, char* argv[]);
+    static int followLogs(int argc, char* argv[]);
+    static bool parseAnalyticsOption(const std::string& option, analytics::Options* pOptions, bool* pIsValid);
+    static void printAnalyticsSummary(const analytics::Report* pReport, std::ostream& out);
+    static bool parseSeconds(const std::string& value, uint64_t* pTicks);
+    static bool parseNumber(const std::string& value, uint64_t* pNumber);
+    static bool parseInteger(const std::string& value, int32_t* pNumber);
+    static bool parseKeyOption(const std::string& option, uint8_t* key, bool* pHasKey);
+
+    struct Command {
+        const char* name;
+        int (*function)(int argc, char* argv[]);
+    };
+
+    static const Command commandTable[] = {
+        { "decode", decode },
+        { "decompress", decompressLog },
+        { "keys", decodeKeys },
+        { "index", indexLog },
+        { "extract", extractRange },
+        { "gaps", checkGaps },
+        { "parse", parseCapture },
+        { "heatmap", writeHeatmap },
+        { "histogram", writeHistograms },
+        { "export", exportColumns },
+        { "query", queryColumns },
+        { "merge", mergeCaptures },
+        { "follow", followLogs }
+    };
+
+    bool isCommand(const std::string& name) {
+
+        for (const Command& command : commandTable) {
+
+            if (name == command.name) return true;
+
+        }
+
+        return false;
+    }
+
+
+    int run(int argc, char* argv[]) {
+
+        for (const Command& command : commandTable) {
+
+            if (std::string(argv[0]) == command.name) {
+
+                return command.function(argc - 1, argv + 1);
+            }
+
+        }
+
+        std::cout << "Unknown command: " << argv[0] << std::endl;
+
+        return 1;
+    }
+
+
+    // Decodes a binary log file to the console: decode <file> [--csv] [--key=<key file>]
+    static int decode(int argc, char* argv[]) {
+        decoder::format fmt = decoder::format::TEXT;
+        uint8_t key[CIPHER_KEY_SIZE]{};
+        bool hasKey = false;
+
+        if (argc < 1) {
+            std::cout << "Please specify the location of the binary log file." << std::endl;
+
+            return 1;
+        }
+
+        for (int i = 1; i < argc; i++) {
+            const std::string option = argv[i];
+
+            if (option == "--csv") {
+                fmt = decoder::format::CSV;
+            }
+            else if (!parseKeyOption(option, key, &hasKey)) {
+
+                return 1;
+            }
+
+        }
+
+        if (!decoder::decodeFile(argv[0], hasKey ? key : nullptr, fmt, std::cout)) {
+            std::cout << "Failed to decode " << argv[0] << "." << std::endl;
+
+            return 1;
+        }
+
+        return 0;
+    }
+
+
+    // Decompresses and decrypts a log file: decompress <file> <output file> [--key=<key file>]
+    static int decompressLog(int argc, char* argv[]) {
+        uint8_t key[CIPHER_KEY_SIZE]{};
+        bool hasKey = false;
+
+        if (argc < 2) {
+            std::cout << "Please specify the location of the compressed log file and the output file." << std::endl;
+
+            return 1;
+        }
+
+        for (int i = 2; i < argc; i++) {
+
+            if (!parseKeyOption(argv[i], key, &hasKey)) {
+
+                return 1;
+            }
+
+        }
+
+        if (!decompress::decompressFile(argv[0], argv[1], hasKey ? key : nullptr)) {
+            std::cout << "Failed to decompress " << argv[0] << "." << std::endl;
+
+            return 1;
+        }
+
+        return 0;
+    }
+
+
+    // Translates the keys of a raw keyboard log or a binary log file to text: keys <file> [--layout=<layout>] [--num-lock] [--key=<key file>]
+    static int decodeKeys(int argc, char* argv[]) {
+        keymap::layout lay = keymap::layout::US;
+        keymap::State state{};
+        uint8_t key[CIPHER_KEY_SIZE]{};
+        bool hasKey = false;
+
+        if (argc < 1) {
+            std::cout << "Please specify the location of the raw keyboard log or binary log file." << std::endl;
+
+            return 1;
+        }
+
+        for (int i = 1; i < argc; i++) {
+            const std::string option = argv[i];
+
+            if (option.compare(0, 9, "--layout=") == 0) {
+
+                if (!keymap::parseLayout(option.substr(9), &lay)) {
+                    std::cout << "Unknown layout: " << option.substr(9) << std::endl;
+
+                    return 1;
+                }
+
+            }
+            else if (option == "--num-lock") {
+                state.modifiers |= keymap::MOD_NUM_LOCK;
+            }
+            else if (!parseKeyOption(option, key, &hasKey)) {
+
+                return 1;
+            }
+
+        }
+
+        if (!decoder::decodeKeys(argv[0], hasKey ? key : nullptr, lay, &state, std::cout)) {
+            std::cout << std::endl << "Failed to decode " << argv[0] << "." << std::endl;
+
+            return 1;
+        }
+
+        return 0;
+    }
+
+
+    // Writes the sidecar index of a binary log file: index <file> [--key=<key file>]
+    static int indexLog(int argc, char* argv[]) {
+        uint8_t key[CIPHER_KEY_SIZE]{};
+        bool hasKey = false;
+
+        if (argc < 1) {
+            std::cout << "Please specify the location of the binary log file." << std::endl;
+
+            return 1;
+        }
+
+        for (int i = 1; i < argc; i++) {
+
+            if (!parseKeyOption(argv[i], key, &hasKey)) {
+
+                return 1;
+            }
+
+        }
+
+        timeindex::Header header{};
+
+        if (!timeindex::build(argv[0], hasKey ? key : nullptr, &header)) {
+            std::cout << "Failed to index " << argv[0] << "." << std::endl;
+
+            return 1;
+        }
+
+        std::cout << "Indexed " << header.recordCount << " records with " << header.entryCount << " entries to " << timeindex::getIndexPath(argv[0]) << "." << std::endl;
+
+        return 0;
+    }
+
+
+    // Decodes the records of a binary log file within a time or record range:
+    // extract <file> [--from=<seconds>] [--to=<seconds>] [--first-record=<ordinal>] [--last-record=<ordinal>] [--csv] [--key=<key file>]
+    static int extractRange(int argc, char* argv[]) {
+        timeindex::Range range{ 0, UINT64_MAX, 0, UINT64_MAX };
+        decoder::format fmt = decoder::format::TEXT;
+        uint8_t key[CIPHER_KEY_SIZE]{};
+        bool hasKey = false;
+
+        if (argc < 1) {
+            std::cout << "Please specify the location of the binary log file." << std::endl;
+
+            return 1;
+        }
+
+        for (int i = 1; i < argc; i++) {
+            const std::string option = argv[i];
+            bool isValid = true;
+
+            if (option.compare(0, 7, "--from=") == 0) {
+                isValid = parseSeconds(option.substr(7), &range.fromTime);
+            }
+            else if (option.compare(0, 5, "--to=") == 0) {
+                isValid = parseSeconds(option.substr(5), &range.toTime);
+            }
+            else if (option.compare(0, 15, "--first-record=") == 0) {
+                isValid = parseNumber(option.substr(15), &range.firstRecord);
+            }
+            else if (option.compare(0, 14, "--last-record=") == 0) {
+                isValid = parseNumber(option.substr(14), &range.lastRecord);
+            }
+            else if (option == "--csv") {
+                fmt = decoder::format::CSV;
+            }
+            else if (!parseKeyOption(option, key, &hasKey)) {
+
+                return 1;
+            }
+
+            if (!isValid) {
+                std::cout << "Invalid value: " << option << std::endl;
+
+                return 1;
+            }
+
+        }
+
+        if (!timeindex::extract(argv[0], hasKey ? key : nullptr, &range, fmt, std::cout)) {
+            std::cout << "Failed to decode " << argv[0] << "." << std::endl;
+
+            return 1;
+        }
+
+        return 0;
+    }
+
+
+    // Reports the input lost between the devices and a log file by the sequence numbers of the sources: gaps <file> [--key=<key file>]
+    // Every gap is written as a line, followed by the lost input and the loss rate per source.
+    static int checkGaps(int argc, char* argv[]) {
+        uint8_t key[CIPHER_KEY_SIZE]{};
+        bool hasKey = false;
+
+        if (argc < 1) {
+            std::cout << "Please specify the location of the log file." << std::endl;
+
+            return 1;
+        }
+
+        for (int i = 1; i < argc; i++) {
+
+            if (!parseKeyOption(argv[i], key, &hasKey)) {
+
+                return 1;
+            }
+
+        }
+
+        gaps::Report report{};
+
+        if (!gaps::check(argv[0], hasKey ? key : nullptr, std::cout, &report)) {
+            std::cout << "Failed to check " << argv[0] << ". The file may be corrupt or encrypted." << std::endl;
+
+            return 1;
+        }
+
+        if (!report.hasSequences) {
+            std::cout << argv[0] << " contains no sequence numbers. Binary log files of version 1 and text logs of older drivers can not be checked." << std::endl;
+
+            return 1;
+        }
+
+        for (const std::pair<const uint16_t, gaps::SourceReport>& source : report.sources) {
+            const gaps::SourceReport* const pSourceReport = &source.second;
+            std::cout << "SRC:" << source.first << " records: " << pSourceReport->recordCount << " lost: " << pSourceReport->lostCount << " in "
+                << pSourceReport->gapCount << " gaps (" << gaps::getLossRate(pSourceReport->lostCount, pSourceReport->recordCount) * 100.0 << " %)";
+
+            if (pSourceReport->reorderedCount) {
+                std::cout << " reordered: " << pSourceReport->reorderedCount;
+            }
+
+            if (pSourceReport->restartCount) {
+                std::cout << " restarted: " << pSourceReport->restartCount;
+            }
+
+            std::cout << std::endl;
+        }
+
+        std::cout << "Records: " << report.recordCount << " Lost: " << report.lostCount << " Gaps: " << report.gapCount << " Loss rate: "
+            << gaps::getLossRate(report.lostCount, report.recordCount) * 100.0 << " %" << std::endl;
+
+        return 0;
+    }
+
+
+    // Parses a capture on all cores and prints the event counts and the throughput: parse <file> [--threads=<count>] [--csv]
+    // With --csv the events are written to the console and the summary to the error stream.
+    static int parseCapture(int argc, char* argv[]) {
+        uint64_t threads = 0;
+        bool isCsv = false;
+
+        if (argc < 1) {
+            std::cout << "Please specify the location of the log file." << std::endl;
+
+            return 1;
+        }
+
+        for (int i = 1; i < argc; i++) {
+            const std::string option = argv[i];
+
+            if (option.compare(0, 10, "--threads=") == 0) {
+
+                if (!parseNumber(option.substr(10), &threads) || !threads || threads > 0x400) {
+                    std::cout << "Invalid value: " << option << std::endl;
+
+                    return 1;
+                }
+
+            }
+            else if (option == "--csv") {
+                isCsv = true;
+            }
+            else {
+                std::cout << "Unknown option: " << option << std::endl;
+
+                return 1;
+            }
+
+        }
+
+        parser::Result result{};
+
+        if (!parser::parseFile(argv[0], static_cast<unsigned int>(threads), &result)) {
+            std::cout << "Failed to parse " << argv[0] << ". Compressed or encrypted log files have to be decompressed first." << std::endl;
+
+            return 1;
+        }
+
+        std::ostream& summary = isCsv ? std::cerr : std::cout;
+
+        if (isCsv) {
+            std::cout << "time,type,source,code,flags,x,y,hold,repeat\n";
+
+            for (const parser::Event& event : result.events) {
+                std::cout << event.time << ',' << parser::getTypeName(event.type) << ',' << event.source << ',' << event.code << ',' << event.flags << ','
+                    << event.x << ',' << event.y << ',' << event.holdTime << ',' << event.repeatCount << '\n';
+            }
+
+        }
+
+        uint64_t typeCounts[parser::MAX_EVENT_TYPE]{};
+
+        for (const parser::Event& event : result.events) {
+            typeCounts[event.type]++;
+        }
+
+        for (uint8_t type = 0; type < parser::MAX_EVENT_TYPE; type++) {
+
+            if (typeCounts[type]) {
+                summary << parser::getTypeName(static_cast<parser::eventType>(type)) << ": " << typeCounts[type] << std::endl;
+            }
+
+        }
+
+        const double megabytes = static_cast<double>(result.size) / 1000000.0;
+        summary << "Events: " << result.events.size() << " Invalid: " << result.invalidCount << std::endl;
+        summary << "Parsed " << megabytes << " MB with " << result.threads << " threads in " << result.seconds << " s ("
+            << (result.seconds > 0.0 ? megabytes / result.seconds : 0.0) << " MB/s)." << std::endl;
+
+        return 0;
+    }
+
+
+
+    // Bins the click positions of a capture into a heatmap:
+    // heatmap <file> [--size=<width>x<height>] [--bounds=<min x>,<min y>,<max x>,<max y>] [--pgm=<image file>] [--threads=<count>]
+    // The heatmap is written to the console as comma separated values and the summary to the error stream unless an image is written.
+    static int writeHeatmap(int argc, char* argv[]) {
+        analytics::Options options{};
+        analytics::getDefaultOptions(&options);
+        std::string imagePath;
+
+        if (argc < 1) {
+            std::cout << "Please specify the location of the log file." << std::endl;
+
+            return 1;
+        }
+
+        for (int i = 1; i < argc; i++) {
+            const std::string option = argv[i];
+            bool isValid = true;
+
+            if (option.compare(0, 7, "--size=") == 0) {
+                const std::string value = option.substr(7);
+                const size_t separator = value.find('x');
+                uint64_t width = 0;
+                uint64_t height = 0;
+                isValid = separator != std::string::npos && parseNumber(value.substr(0, separator), &width) && parseNumber(value.substr(separator + 1), &height)
+                    && width <= UINT32_MAX && height <= UINT32_MAX;
+                options.width = static_cast<uint32_t>(width);
+                options.height = static_cast<uint32_t>(height);
+            }
+            else if (option.compare(0, 9, "--bounds=") == 0) {
+                std::string value = option.substr(9);
+                int32_t* const bounds[] = { &options.minX, &options.minY, &options.maxX, &options.maxY };
+
+                for (int32_t* pBound : bounds) {
+                    const size_t separator = value.find(',');
+                    isValid = isValid && parseInteger(value.substr(0, separator), pBound);
+                    value = separator == std::string::npos ? "" : value.substr(separator + 1);
+                }
+
+            }
+            else if (option.compare(0, 6, "--pgm=") == 0) {
+                imagePath = option.substr(6);
+            }
+            else if (!parseAnalyticsOption(option, &options, &isValid)) {
+
+                return 1;
+            }
+
+            if (!isValid) {
+                std::cout << "Invalid value: " << option << std::endl;
+
+                return 1;
+            }
+
+        }
+
+        analytics::Report report{};
+
+        if (!analytics::analyze(argv[0], &options, &report)) {
+            std::cout << "Failed to analyze " << argv[0] << ". The heatmap may have at most 16777216 cells and non-empty bounds." << std::endl;
+
+            return 1;
+        }
+
+        if (imagePath.empty()) {
+            analytics::writeHeatmapCsv(&report, std::cout);
+            printAnalyticsSummary(&report, std::cerr);
+
+            return 0;
+        }
+
+        std::ofstream image(imagePath, std::ios::binary | std::ios::trunc);
+        analytics::writeHeatmapPgm(&report, image);
+
+        if (!image) {
+            std::cout << "Failed to write " << imagePath << "." << std::endl;
+
+            return 1;
+        }
+
+        printAnalyticsSummary(&report, std::cout);
+
+        return 0;
+    }
+
+
+    // Writes the interval and rate histograms of the key presses and clicks of a binary log file:
+    // histogram <file> [--bin=<milliseconds>] [--bins=<count>] [--window=<seconds>] [--threads=<count>]
+    // The histograms are written to the console as comma separated values and the summary to the error stream.
+    static int writeHistograms(int argc, char* argv[]) {
+        analytics::Options options{};
+        analytics::getDefaultOptions(&options);
+
+        if (argc < 1) {
+            std::cout << "Please specify the location of the binary log file." << std::endl;
+
+            return 1;
+        }
+
+        for (int i = 1; i < argc; i++) {
+            const std::string option = argv[i];
+            bool isValid = true;
+
+            if (option.compare(0, 6, "--bin=") == 0) {
+                uint64_t ticks = 0;
+                // parsed like seconds, so fractions of milliseconds are allowed
+                isValid = parseSeconds(option.substr(6), &ticks) && ticks;
+                options.binWidth = static_cast<double>(ticks) / RECORD_TIME_RESOLUTION;
+            }
+            else if (option.compare(0, 7, "--bins=") == 0) {
+                uint64_t bins = 0;
+                isValid = parseNumber(option.substr(7), &bins) && bins <= UINT32_MAX;
+                options.binCount = static_cast<uint32_t>(bins);
+            }
+            else if (option.compare(0, 9, "--window=") == 0) {
+                isValid = parseSeconds(option.substr(9), &options.window) && options.window;
+            }
+            else if (!parseAnalyticsOption(option, &options, &isValid)) {
+
+                return 1;
+            }
+
+            if (!isValid) {
+                std::cout << "Invalid value: " << option << std::endl;
+
+                return 1;
+            }
+
+        }
+
+        analytics::Report report{};
+
+        if (!analytics::analyze(argv[0], &options, &report)) {
+            std::cout << "Failed to analyze " << argv[0] << ". The histograms may have 2 to 1048576 bins." << std::endl;
+
+            return 1;
+        }
+
+        if (!report.hasTimes) {
+            std::cout << argv[0] << " contains no times. Histograms need a binary log file." << std::endl;
+
+            return 1;
+        }
+
+        analytics::writeHistogramsCsv(&report, std::cout);
+        printAnalyticsSummary(&report, std::cerr);
+
+        return 0;
+    }
+
+
+    // Converts a capture to a columnar file for queries: export <capture> <columnar file> [--threads=<count>]
+    static int exportColumns(int argc, char* argv[]) {
+        uint64_t threads = 0;
+
+        if (argc < 2) {
+            std::cout << "Please specify the location of the capture and the columnar file." << std::endl;
+
+            return 1;
+        }
+
+        for (int i = 2; i < argc; i++) {
+            const std::string option = argv[i];
+
+            if (option.compare(0, 10, "--threads=") != 0) {
+                std::cout << "Unknown option: " << option << std::endl;
+
+                return 1;
+            }
+
+            if (!parseNumber(option.substr(10), &threads) || !threads || threads > 0x400) {
+                std::cout << "Invalid value: " << option << std::endl;
+
+                return 1;
+            }
+
+        }
+
+        columns::ExportStats stats{};
+
+        if (!columns::exportFile(argv[0], argv[1], static_cast<unsigned int>(threads), &stats)) {
+            std::cout << "Failed to export " << argv[0] << " to " << argv[1] << ". Compressed or encrypted log files have to be decompressed first." << std::endl;
+
+            return 1;
+        }
+
+        const double megabytes = static_cast<double>(stats.inputSize) / 1000000.0;
+        std::cout << "Events: " << stats.eventCount << " Chunks: " << stats.chunkCount << std::endl;
+        std::cout << "Exported " << megabytes << " MB to " << static_cast<double>(stats.outputSize) / 1000000.0 << " MB (ratio "
+            << (stats.outputSize ? static_cast<double>(stats.inputSize) / static_cast<double>(stats.outputSize) : 0.0) << ") with " << stats.threads
+            << " threads in " << stats.seconds << " s (" << (stats.seconds > 0.0 ? megabytes / stats.seconds : 0.0) << " MB/s)." << std::endl;
+
+        return 0;
+    }
+
+
+    // Scans a columnar file for the events that match all conditions:
+    // query <columnar file> [--types=<type>,...] [--from=<seconds>] [--to=<seconds>] [--region=<min x>,<min y>,<max x>,<max y>] [--columns=<column>,...] [--count]
+    // The matching events are written to the console as comma separated values and the summary to the error stream.
+    static int queryColumns(int argc, char* argv[]) {
+        columns::Filter filter{};
+        columns::getDefaultFilter(&filter);
+        uint32_t columnMask = 0;
+        columns::parseColumns("time,type,code,flags,x,y,source,seq", &columnMask);
+
+        if (argc < 1) {
+            std::cout << "Please specify the location of the columnar file." << std::endl;
+
+            return 1;
+        }
+
+        for (int i = 1; i < argc; i++) {
+            const std::string option = argv[i];
+            bool isValid = true;
+
+            if (option.compare(0, 8, "--types=") == 0) {
+                isValid = columns::parseTypes(option.substr(8), &filter.typeMask);
+            }
+            else if (option.compare(0, 7, "--from=") == 0) {
+                isValid = parseSeconds(option.substr(7), &filter.fromTime);
+            }
+            else if (option.compare(0, 5, "--to=") == 0) {
+                isValid = parseSeconds(option.substr(5), &filter.toTime);
+            }
+            else if (option.compare(0, 9, "--region=") == 0) {
+                std::string value = option.substr(9);
+                int32_t* const bounds[] = { &filter.minX, &filter.minY, &filter.maxX, &filter.maxY };
+
+                for (int32_t* pBound : bounds) {
+                    const size_t separator = value.find(',');
+                    isValid = isValid && parseInteger(value.substr(0, separator), pBound);
+                    value = separator == std::string::npos ? "" : value.substr(separator + 1);
+                }
+
+            }
+            else if (option.compare(0, 10, "--columns=") == 0) {
+                isValid = columns::parseColumns(option.substr(10), &columnMask);
+            }
+            else if (option == "--count") {
+                columnMask = 0;
+            }
+            else {
+                std::cout << "Unknown option: " << option << std::endl;
+
+                return 1;
+            }
+
+            if (!isValid) {
+                std::cout << "Invalid value: " << option << std::endl;
+
+                return 1;
+            }
+
+        }
+
+        columns::ScanStats stats{};
+
+        if (!columns::scan(argv[0], &filter, columnMask, std::cout, &stats)) {
+            std::cout.flush();
+            std::cerr << "Failed to scan " << argv[0] << ". The file is no columnar file or corrupt." << std::endl;
+
+            return 1;
+        }
+
+        std::cout.flush();
+        std::cerr << "Matches: " << stats.matchCount << " Chunks: " << stats.chunkCount << " Skipped: " << stats.skippedCount << std::endl;
+        std::cerr << "Read " << static_cast<double>(stats.readSize) / 1000000.0 << " MB of columns in " << stats.seconds << " s." << std::endl;
+
+        return 0;
+    }
+
+
+    // Merges binary log files of many machines and sessions onto a single timeline:
+    // merge <file>... [--list=<file with one path per line>] [--threads=<count>] [--memory=<megabytes>]
+    // The events are written to the console as comma separated values in time order and the summary to the error stream.
+    static int mergeCaptures(int argc, char* argv[]) {
+        merge::Options options{};
+        merge::getDefaultOptions(&options);
+        std::vector<std::string> paths;
+
+        for (int i = 0; i < argc; i++) {
+            const std::string option = argv[i];
+            bool isValid = true;
+
+            if (option.compare(0, 2, "--") != 0) {
+                paths.push_back(option);
+            }
+            else if (option.compare(0, 7, "--list=") == 0) {
+                std::ifstream list(option.substr(7));
+                std::string path;
+
+                while (std::getline(list, path)) {
+
+                    // lists written on Windows end their lines with a carriage return
+                    if (!path.empty() && path.back() == '\r') {
+                        path.pop_back();
+                    }
+
+                    if (!path.empty()) {
+                        paths.push_back(path);
+                    }
+
+                }
+
+                isValid = list.eof();
+            }
+            else if (option.compare(0, 10, "--threads=") == 0) {
+                uint64_t threads = 0;
+                isValid = parseNumber(option.substr(10), &threads) && threads && threads <= 0x400;
+                options.threads = static_cast<unsigned int>(threads);
+            }
+            else if (option.compare(0, 9, "--memory=") == 0) {
+                uint64_t megabytes = 0;
+                isValid = parseNumber(option.substr(9), &megabytes) && megabytes && megabytes <= 0x100000;
+                options.memoryLimit = static_cast<size_t>(megabytes * 1000000);
+            }
+            else {
+                std::cout << "Unknown option: " << option << std::endl;
+
+                return 1;
+            }
+
+            if (!isValid) {
+                std::cout << "Invalid value: " << option << std::endl;
+
+                return 1;
+            }
+
+        }
+
+        if (paths.empty()) {
+            std::cout << "Please specify the locations of the binary log files." << std::endl;
+
+            return 1;
+        }
+
+        merge::Result result{};
+
+        if (!merge::mergeFiles(paths, &options, std::cout, &result)) {
+            std::cout << "Failed to merge " << result.failedPath << ". Only binary log files can be merged, compressed or encrypted log files have to be decompressed first." << std::endl;
+
+            return 1;
+        }
+
+        const double megabytes = static_cast<double>(result.size) / 1000000.0;
+        std::cerr << "Inputs: " << paths.size() << " Events: " << result.eventCount << " Invalid: " << result.invalidCount << std::endl;
+        std::cerr << "Merged " << megabytes << " MB in chunks of " << result.chunkSize / 1024 << " KB with " << result.threads << " threads in " << result.seconds << " s ("
+            << (result.seconds > 0.0 ? megabytes / result.seconds : 0.0) << " MB/s)." << std::endl;
+
+        return 0;
+    }
+
+
+    // Follows logs that are still written and writes the events appended to them: follow <file>... [--interval=<ms>] [--once] [--reset]
+    // The events are written to the console as comma separated values with the index of their file, notes and the summary to the error stream.
+    // The checkpoint of every file is saved after its events are written, so a stopped follower continues where it stopped.
+    static int followLogs(int argc, char* argv[]) {
+        std::vector<std::string> paths;
+        uint64_t interval = 250;
+        bool isOnce = false;
+        bool isReset = false;
+
+        for (int i = 0; i < argc; i++) {
+            const std::string option = argv[i];
+
+            if (option.compare(0, 2, "--") != 0) {
+                paths.push_back(option);
+            }
+            else if (option.compare(0, 11, "--interval=") == 0) {
+
+                if (!parseNumber(option.substr(11), &interval) || !interval || interval > 3600000) {
+                    std::cout << "Invalid value: " << option << std::endl;
+
+                    return 1;
+                }
+
+            }
+            else if (option == "--once") {
+                isOnce = true;
+            }
+            else if (option == "--reset") {
+                isReset = true;
+            }
+            else {
+                std::cout << "Unknown option: " << option << std::endl;
+
+                return 1;
+            }
+
+        }
+
+        if (paths.empty()) {
+            std::cout << "Please specify the locations of the log files." << std::endl;
+
+            return 1;
+        }
+
+        std::vector<follow::Follower> followers(paths.size());
+        std::vector<uint64_t> eventCounts(paths.size());
+
+        for (size_t i = 0; i < paths.size(); i++) {
+            follow::open(&followers[i], paths[i].c_str(), isReset);
+        }
+
+        std::cout << "time,input,type,source,code,flags,x,y,hold,repeat\n";
+        follow::Update update{};
+        bool isValid = true;
+
+        while (isValid) {
+
+            for (size_t i = 0; i < followers.size() && isValid; i++) {
+                follow::Follower* const pFollower = &followers[i];
+
+                if (!follow::hasChanged(pFollower)) continue;
+
+                if (!follow::update(pFollower, &update)) {
+                    std::cerr << "Failed to follow " << paths[i] << ". " << follow::getFailureMessage(pFollower) << "." << std::endl;
+                    isValid = false;
+
+                    break;
+                }
+
+                if (update.isReset) {
+                    std::cerr << paths[i] << " was rotated or truncated and is followed from its beginning." << std::endl;
+                }
+
+                for (const parser::Event& event : update.events) {
+                    std::cout << event.time << ',' << i << ',' << parser::getTypeName(event.type) << ',' << event.source << ',' << event.code << ',' << event.flags << ','
+                        << event.x << ',' << event.y << ',' << event.holdTime << ',' << event.repeatCount << '\n';
+                }
+
+                // events of an update are written before its checkpoint, so none are lost if the follower is stopped in between
+                std::cout.flush();
+                eventCounts[i] += update.events.size();
+
+                if (!follow::save(pFollower)) {
+                    std::cerr << "Failed to save the checkpoint " << pFollower->checkpointPath << ". " << follow::getFailureMessage(pFollower) << "." << std::endl;
+                    isValid = false;
+                }
+
+            }
+
+            if (isOnce) break;
+
+            std::this_thread::sleep_for(std::chrono::milliseconds(interval));
+        }
+
+        for (size_t i = 0; i < followers.size(); i++) {
+            const follow::Checkpoint* const pCheckpoint = &followers[i].checkpoint;
+            std::cerr << paths[i] << ": New events: " << eventCounts[i] << " Events: " << pCheckpoint->eventCount << " Invalid: " << pCheckpoint->invalidCount
+                << " Offset: " << pCheckpoint->offset << " Resets: " << pCheckpoint->resetCount << std::endl;
+            follow::close(&followers[i]);
+        }
+
+        return isValid ? 0 : 1;
+    }
+
+
+    // Parses seconds since the start of a log file to ticks of RECORD_TIME_RESOLUTION.
+    static bool parseSeconds(const std::string& value, uint64_t* pTicks) {
+
+        if (value.empty() || value.find_first_not_of("1234567890.") != std::string::npos || value.find('.') != value.rfind('.') || value == ".") {
+
+            return false;
+        }
+
+        *pTicks = static_cast<uint64_t>(std::stod(value) * RECORD_TIME_RESOLUTION + 0.5);
+
+        return true;
+    }
+
+
+    static bool parseNumber(const std::string& value, uint64_t* pNumber) {
+
+        if (value.empty() || value.find_first_not_of("1234567890") != std::string::npos) {
+
+            return false;
+        }
+
+        *pNumber = std::stoull(value);
+
+        return true;
+    }
+
+
+    static bool parseInteger(const std::string& value, int32_t* pNumber) {
+        const bool isNegative = !value.empty() && value[0] == '-';
+        uint64_t number = 0;
+
+        if (!parseNumber(isNegative ? value.substr(1) : value, &number) || number > (isNegative ? 0x80000000ull : INT32_MAX)) {
+
+            return false;
+        }
+
+        *pNumber = static_cast<int32_t>(isNegative ? 0 - static_cast<int64_t>(number) : static_cast<int64_t>(number));
+
+        return true;
+    }
+
+
+    // Parses the options shared by the analytics commands. Prints unknown options.
+    static bool parseAnalyticsOption(const std::string& option, analytics::Options* pOptions, bool* pIsValid) {
+
+        if (option.compare(0, 10, "--threads=") != 0) {
+            std::cout << "Unknown option: " << option << std::endl;
+
+            return false;
+        }
+
+        uint64_t threads = 0;
+        *pIsValid = parseNumber(option.substr(10), &threads) && threads && threads <= 0x400;
+        pOptions->threads = static_cast<unsigned int>(threads);
+
+        return true;
+    }
+
+
+    static void printAnalyticsSummary(const analytics::Report* pReport, std::ostream& out) {
+        const double megabytes = static_cast<double>(pReport->size) / 1000000.0;
+        out << "Keys: " << pReport->keys << " Clicks: " << pReport->clicks << " Outside of the heatmap: " << pReport->outside << std::endl;
+        out << "Events: " << pReport->events << " Invalid: " << pReport->invalidCount << std::endl;
+        out << "Analyzed " << megabytes << " MB with " << pReport->threads << " threads in " << pReport->seconds << " s ("
+            << (pReport->seconds > 0.0 ? megabytes / pReport->seconds : 0.0) << " MB/s)." << std::endl;
+
+        return;
+    }
+
+
+    // Parses --key=<key file> and reads the key. Also verifies the decryption with the known answer tests.
+    static bool parseKeyOption(const std::string& option, uint8_t* key, bool* pHasKey) {
+
+        if (option.compare(0, 6, "--key=") != 0) {
+            std::cout << "Unknown option: " << option << std::endl;
+
+            return false;
+        }
+
+        if (!decompress::readKeyFile(option.substr(6).c_str(), key)) {
+            std::cout << "Failed to read key from " << option.substr(6) << "." << std::endl;
+
+            return false;
+        }
+
+        if (!gcm::selfTest()) {
+            std::cout << "AES-GCM self test failed." << std::endl;
+
+            return false;
+        }
+
+        *pHasKey = true;
+
+        return true;
+    }
+
+}
\ No newline at end of file
@@ -0,0 +1,33 @@
+#pragma once
+#include <string>
+
+// Commands that work on log files and neither need the driver nor Windows.
+// Run by the client as "LumbrJackClient.exe <command> ..." and by the log tools (tools.cpp) on other platforms.
+namespace commands {
+
+	// Checks if a command line argument is the name of a command.
+	//
+	// Parameters:
+	//
+	// [in] name:
+	// First argument of the command line.
+	//
+	// Return:
+	// True if it is a command, false otherwise.
+	bool isCommand(const std::string& name);
+
+	// Runs a command.
+	//
+	// Parameters:
+	//
+	// [in] argc:
+	// Number of arguments including the name of the command.
+	//
+	// [in] argv:
+	// Name of the command followed by its arguments.
+	//
+	// Return:
+	// Exit code of the process. Zero on success.
+	int run(int argc, char* argv[]);
+
+}
\ No newline at end of file
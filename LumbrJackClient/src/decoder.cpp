@@ -0,0 +1,267 @@
+#include "decoder.h"
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+
+namespace decoder {
+
+    const char* const csvHeader = "time,type,source,unit,flags,code,repeat,hold,buttons,data,x,y,sequence";
+
+    // Number of scan codes translated at once.
+    static constexpr size_t KEYS_BLOCK_SIZE = 0x100000;
+
+    static bool readBlock(Reader* pReader);
+    static bool decodeRecordKeys(const char* path, const uint8_t* key, keymap::layout lay, keymap::State* pState, std::ostream& out);
+    static void writeKeys(keymap::layout lay, keymap::State* pState, const std::vector<uint8_t>& codes, std::string* pText, std::ostream& out);
+
+    bool open(Reader* pReader, const char* path, const uint8_t* key) {
+
+        if (!decompress::open(&pReader->stream, path, key)) {
+
+            return false;
+        }
+
+        RecordFileHeader* const pHeader = &pReader->header;
+
+        if (decompress::read(&pReader->stream, pHeader, sizeof(RecordFileHeader)) != sizeof(RecordFileHeader)) {
+
+            return false;
+        }
+
+        if (pHeader->magic != RECORD_MAGIC || !RECORD_IS_SUPPORTED(pHeader) || pHeader->headerSize < sizeof(RecordFileHeader) || !pHeader->timeResolution) {
+
+            return false;
+        }
+
+        // skip header fields of newer minor revisions
+        for (size_t i = sizeof(RecordFileHeader); i < pHeader->headerSize; i++) {
+            uint8_t skipped = 0;
+
+            if (!decompress::read(&pReader->stream, &skipped, sizeof(skipped))) {
+
+                return false;
+            }
+
+        }
+
+        pReader->time = pHeader->startTime;
+        pReader->count = 0;
+        pReader->index = 0;
+
+        return true;
+    }
+
+
+    bool next(Reader* pReader, const InputRecord** ppRecord, uint64_t* pTime) {
+
+        while (pReader->index < pReader->count || readBlock(pReader)) {
+            const InputRecord* const pRecord = &pReader->block[pReader->index++];
+
+            if (pRecord->type == RECORD_TYPE_TIME) {
+                pReader->time = pRecord->time.time;
+
+                continue;
+            }
+
+            pReader->time += pRecord->timeDelta;
+
+            if (pRecord->type != RECORD_TYPE_KBD && pRecord->type != RECORD_TYPE_MOU) continue;
+
+            *ppRecord = pRecord;
+            *pTime = pReader->time;
+
+            return true;
+        }
+
+        return false;
+    }
+
+
+    bool seek(Reader* pReader, const decompress::Position* pPosition, uint64_t time) {
+        pReader->time = time;
+        pReader->count = 0;
+        pReader->index = 0;
+
+        return decompress::seek(&pReader->stream, pPosition);
+    }
+
+
+    std::string formatRecord(const InputRecord* pRecord, uint64_t time, format fmt) {
+        std::ostringstream stream;
+
+        if (fmt == CSV) {
+            stream << time << ',';
+        }
+        else {
+            stream << std::setw(8) << time / RECORD_TIME_RESOLUTION << '.' << std::setfill('0') << std::setw(7) << time % RECORD_TIME_RESOLUTION << std::setfill(' ') << ' ';
+        }
+
+        if (pRecord->type == RECORD_TYPE_KBD) {
+            const KbdRecord* const pKbd = &pRecord->kbd;
+
+            if (fmt == CSV) {
+                stream << "K," << pRecord->source << ',' << pKbd->unitId << ',' << pKbd->flags << ',' << pKbd->makeCode << ','
+                    << pKbd->repeatCount << ',' << pKbd->holdTime << ",,,,," << pRecord->sequence;
+            }
+            else {
+                stream << "K SRC:" << pRecord->source << " SEQ:" << pRecord->sequence << " UNIT:" << pKbd->unitId << std::hex << " CODE:0x" << pKbd->makeCode
+                    << " FLAGS:0x" << pKbd->flags << std::dec;
+
+                if (pKbd->flags & RECORD_KBD_PAIRED || pKbd->repeatCount || pKbd->holdTime) {
+                    stream << " HOLD:" << pKbd->holdTime << " REPEAT:" << pKbd->repeatCount;
+                }
+
+            }
+
+        }
+        else {
+            const MouRecord* const pMou = &pRecord->mou;
+            // wheel rotations are signed
+            const int16_t data = static_cast<int16_t>(pMou->buttonData);
+
+            if (fmt == CSV) {
+                stream << "M," << pRecord->source << ',' << pMou->unitId << ',' << pMou->flags << ",,,," << pMou->buttonFlags << ','
+                    << data << ',' << pMou->lastX << ',' << pMou->lastY << ',' << pRecord->sequence;
+            }
+            else {
+                stream << "M SRC:" << pRecord->source << " SEQ:" << pRecord->sequence << " UNIT:" << pMou->unitId << std::hex << " FLAGS:0x" << pMou->flags
+                    << " BUTTONS:0x" << pMou->buttonFlags << std::dec << " DATA:" << data << " X:" << pMou->lastX << " Y:" << pMou->lastY;
+            }
+
+        }
+
+        return stream.str();
+    }
+
+
+    bool decodeFile(const char* path, const uint8_t* key, format fmt, std::ostream& out) {
+        // the record block is too large for the stack
+        Reader* const pReader = new Reader();
+
+        if (!open(pReader, path, key)) {
+            delete pReader;
+
+            return false;
+        }
+
+        if (fmt == CSV) {
+            out << csvHeader << '\n';
+        }
+
+        const InputRecord* pRecord = nullptr;
+        uint64_t time = 0;
+
+        while (next(pReader, &pRecord, &time)) {
+            // input captured before the file was opened is logged at the start time
+            const uint64_t relTime = time > pReader->header.startTime ? time - pReader->header.startTime : 0;
+            out << formatRecord(pRecord, relTime, fmt) << '\n';
+        }
+
+        // records before a corrupt block are still written
+        const bool isValid = !pReader->stream.isCorrupt;
+        delete pReader;
+
+        return isValid;
+    }
+
+
+    bool decodeKeys(const char* path, const uint8_t* key, keymap::layout lay, keymap::State* pState, std::ostream& out) {
+        decompress::Stream stream;
+
+        if (!decompress::open(&stream, path, key)) {
+
+            return false;
+        }
+
+        uint32_t magic = 0;
+        const size_t magicSize = decompress::read(&stream, &magic, sizeof(magic));
+
+        if (magicSize == sizeof(magic) && magic == RECORD_MAGIC) {
+
+            return decodeRecordKeys(path, key, lay, pState, out);
+        }
+
+        // the bytes read for the magic are the first scan codes of a raw log
+        const uint8_t* const magicBytes = reinterpret_cast<const uint8_t*>(&magic);
+        std::vector<uint8_t> codes(magicBytes, magicBytes + magicSize);
+        std::string text;
+
+        while (!codes.empty()) {
+            writeKeys(lay, pState, codes, &text, out);
+            codes.resize(KEYS_BLOCK_SIZE);
+            codes.resize(decompress::read(&stream, codes.data(), codes.size()));
+        }
+
+        // keys before a corrupt block are still written
+        return !stream.isCorrupt;
+    }
+
+
+    static bool readBlock(Reader* pReader) {
+        const size_t recordSize = pReader->header.recordSize;
+        uint8_t* const data = reinterpret_cast<uint8_t*>(pReader->block);
+        // a truncated record at the end of the file is ignored
+        pReader->count = decompress::read(&pReader->stream, data, sizeof(pReader->block) / sizeof(InputRecord) * recordSize) / recordSize;
+        pReader->index = 0;
+
+        // records of version 1 are moved to their place from the back, so none is overwritten before it is moved
+        for (size_t i = pReader->count; recordSize < sizeof(InputRecord) && i > 0; i--) {
+            memmove(&pReader->block[i - 1], data + (i - 1) * recordSize, recordSize);
+            pReader->block[i - 1].sequence = 0;
+        }
+
+        return pReader->count != 0;
+    }
+
+
+
+    // Collects the scan codes of the keyboard records of a binary log file and translates them block by block.
+    static bool decodeRecordKeys(const char* path, const uint8_t* key, keymap::layout lay, keymap::State* pState, std::ostream& out) {
+        // the record block is too large for the stack
+        Reader* const pReader = new Reader();
+
+        if (!open(pReader, path, key)) {
+            delete pReader;
+
+            return false;
+        }
+
+        std::vector<uint8_t> codes;
+        codes.reserve(KEYS_BLOCK_SIZE);
+        std::string text;
+        const InputRecord* pRecord = nullptr;
+        uint64_t time = 0;
+
+        while (next(pReader, &pRecord, &time)) {
+
+            if (pRecord->type != RECORD_TYPE_KBD) continue;
+
+            uint8_t recordCodes[4]{};
+            const size_t count = keymap::fromRecord(&pRecord->kbd, recordCodes);
+            codes.insert(codes.end(), recordCodes, recordCodes + count);
+
+            if (codes.size() + sizeof(recordCodes) > KEYS_BLOCK_SIZE) {
+                writeKeys(lay, pState, codes, &text, out);
+                codes.clear();
+            }
+
+        }
+
+        writeKeys(lay, pState, codes, &text, out);
+        const bool isValid = !pReader->stream.isCorrupt;
+        delete pReader;
+
+        return isValid;
+    }
+
+
+    static void writeKeys(keymap::layout lay, keymap::State* pState, const std::vector<uint8_t>& codes, std::string* pText, std::ostream& out) {
+        pText->clear();
+        keymap::translate(lay, pState, codes.data(), codes.size(), pText, keymap::getBestImplementation());
+        out.write(pText->data(), static_cast<std::streamsize>(pText->size()));
+
+        return;
+    }
+
+}
\ No newline at end of file
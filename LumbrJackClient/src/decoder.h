@@ -0,0 +1,141 @@
+#pragma once
+#include "../../LumbrJackDriver/src/record.h"
+#include "decompress.h"
+#include "keymap.h"
+#include <ostream>
+#include <string>
+
+// Decodes binary log files of the driver.
+// Does not depend on Windows headers, so log files can be decoded on any platform.
+namespace decoder {
+
+	// Output formats of decoded records.
+	enum format { TEXT = 0, CSV };
+
+	// Header line of CSV output.
+	extern const char* const csvHeader;
+
+	// Streaming reader of a binary log file. Records are read in blocks.
+	// Compressed and encrypted log files are decompressed and decrypted while reading.
+	struct Reader {
+		decompress::Stream stream;
+		RecordFileHeader header;
+		// Absolute interrupt time of the last record returned.
+		uint64_t time;
+		InputRecord block[0x100];
+		size_t count;
+		size_t index;
+	};
+
+	// Opens a binary log file and validates its header.
+	//
+	// Parameters:
+	//
+	// [out] pReader:
+	// Reader to initialize.
+	//
+	// [in] path:
+	// Path of the log file.
+	//
+	// [in] key:
+	// Key of CIPHER_KEY_SIZE bytes for encrypted files. Can be nullptr for files that are not encrypted.
+	//
+	// Return:
+	// True on success, false on failure or an unsupported file.
+	bool open(Reader* pReader, const char* path, const uint8_t* key);
+
+	// Reads the next keyboard or mouse record. Time records are applied to the time of the reader and not returned.
+	//
+	// Parameters:
+	//
+	// [in/out] pReader:
+	// Opened reader.
+	//
+	// [out] ppRecord:
+	// Pointer to the record. Valid until the next call.
+	//
+	// [out] pTime:
+	// Absolute interrupt time of the record.
+	//
+	// Return:
+	// True if a record was read, false at the end of the file.
+	bool next(Reader* pReader, const InputRecord** ppRecord, uint64_t* pTime);
+
+	// Continues reading records at a position of the stream of a reader.
+	//
+	// Parameters:
+	//
+	// [in/out] pReader:
+	// Opened reader.
+	//
+	// [in] pPosition:
+	// Position of a record as returned by decompress::tell.
+	//
+	// [in] time:
+	// Absolute interrupt time of the record before the position.
+	//
+	// Return:
+	// True on success, false if the position is invalid.
+	bool seek(Reader* pReader, const decompress::Position* pPosition, uint64_t time);
+
+	// Formats a record as a line of text without a line break.
+	//
+	// Parameters:
+	//
+	// [in] pRecord:
+	// Keyboard or mouse record.
+	//
+	// [in] time:
+	// Ticks since the start of the log file.
+	//
+	// [in] fmt:
+	// Output format.
+	//
+	// Return:
+	// The formatted record.
+	std::string formatRecord(const InputRecord* pRecord, uint64_t time, format fmt);
+
+	// Decodes all records of a binary log file and writes them line by line.
+	//
+	// Parameters:
+	//
+	// [in] path:
+	// Path of the log file.
+	//
+	// [in] key:
+	// Key of CIPHER_KEY_SIZE bytes for encrypted files. Can be nullptr for files that are not encrypted.
+	//
+	// [in] fmt:
+	// Output format. CSV output starts with a header line.
+	//
+	// [out] out:
+	// Stream the lines are written to.
+	//
+	// Return:
+	// True on success, false if the file could not be opened, is invalid or contains a corrupt block.
+	bool decodeFile(const char* path, const uint8_t* key, format fmt, std::ostream& out);
+
+	// Translates the keys of a raw keyboard log (see LOG_FLAG_RAW) or the keyboard records of a binary log file to text.
+	//
+	// Parameters:
+	//
+	// [in] path:
+	// Path of the log file.
+	//
+	// [in] key:
+	// Key of CIPHER_KEY_SIZE bytes for encrypted files. Can be nullptr for files that are not encrypted.
+	//
+	// [in] lay:
+	// Keyboard layout the keys were typed with.
+	//
+	// [in/out] pState:
+	// Modifier state at the start of the log file. Contains the state at the end of the file on return.
+	//
+	// [out] out:
+	// Stream the UTF-8 text is written to.
+	//
+	// Return:
+	// True on success, false if the file could not be opened, is invalid or contains a corrupt block.
+	bool decodeKeys(const char* path, const uint8_t* key, keymap::layout lay, keymap::State* pState, std::ostream& out);
+
+}
\ No newline at end of file
@@ -0,0 +1,372 @@
+#include "decompress.h"
+#include <algorithm>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+#include <string>
+
+namespace decompress {
+
+    static bool readBlock(Stream* pStream);
+    static bool readLength(const uint8_t** pIp, const uint8_t* ipEnd, size_t* pLength);
+
+    bool open(Stream* pStream, const char* path, const uint8_t* key) {
+        pStream->file.open(path, std::ios::binary);
+
+        if (!pStream->file) {
+
+            return false;
+        }
+
+        pStream->isCompressed = false;
+        pStream->isEncrypted = false;
+        pStream->isCorrupt = false;
+        pStream->isFinal = false;
+        pStream->blockIndex = 0;
+        pStream->blockOffset = 0;
+        pStream->block.clear();
+        pStream->pos = 0;
+
+        uint32_t magic = 0;
+
+        if (pStream->file.read(reinterpret_cast<char*>(&magic), sizeof(magic)) && magic == LZ_FILE_MAGIC) {
+            pStream->isCompressed = true;
+
+            return true;
+        }
+
+        if (pStream->file && magic == CIPHER_FILE_MAGIC) {
+            pStream->cipherHeader.magic = magic;
+            const size_t remaining = sizeof(CipherFileHeader) - sizeof(magic);
+
+            if (!key || !pStream->file.read(reinterpret_cast<char*>(&pStream->cipherHeader) + sizeof(magic), remaining)) {
+
+                return false;
+            }
+
+            pStream->isCompressed = (pStream->cipherHeader.flags & CIPHER_FLAG_COMPRESSED) != 0;
+            pStream->isEncrypted = true;
+            gcm::init(&pStream->cipher, key, true);
+
+            return true;
+        }
+
+        // plain files are read from the start
+        pStream->file.clear();
+        pStream->file.seekg(0, std::ios::beg);
+
+        return static_cast<bool>(pStream->file);
+    }
+
+
+    size_t read(Stream* pStream, void* buffer, size_t size) {
+
+        if (!pStream->isCompressed && !pStream->isEncrypted) {
+            pStream->file.read(static_cast<char*>(buffer), size);
+
+            return static_cast<size_t>(pStream->file.gcount());
+        }
+
+        uint8_t* pOut = static_cast<uint8_t*>(buffer);
+        size_t total = 0;
+
+        while (total < size) {
+
+            if (pStream->pos == pStream->block.size() && !readBlock(pStream)) break;
+
+            const size_t chunkSize = std::min(size - total, pStream->block.size() - pStream->pos);
+            memcpy(pOut + total, pStream->block.data() + pStream->pos, chunkSize);
+            pStream->pos += chunkSize;
+            total += chunkSize;
+        }
+
+        return total;
+    }
+
+
+    void tell(Stream* pStream, Position* pPosition) {
+
+        // a consumed block continues with the next one
+        if (pStream->isCompressed || pStream->isEncrypted) {
+
+            if (pStream->pos < pStream->block.size()) {
+                pPosition->fileOffset = pStream->blockOffset;
+                pPosition->blockIndex = pStream->blockIndex - 1;
+                pPosition->blockOffset = static_cast<uint32_t>(pStream->pos);
+
+                return;
+            }
+
+            pPosition->fileOffset = static_cast<uint64_t>(pStream->file.tellg());
+            pPosition->blockIndex = pStream->blockIndex;
+            pPosition->blockOffset = 0;
+
+            return;
+        }
+
+        pPosition->fileOffset = static_cast<uint64_t>(pStream->file.tellg());
+        pPosition->blockIndex = 0;
+        pPosition->blockOffset = 0;
+
+        return;
+    }
+
+
+    bool seek(Stream* pStream, const Position* pPosition) {
+        pStream->file.clear();
+        pStream->file.seekg(static_cast<std::streamoff>(pPosition->fileOffset), std::ios::beg);
+
+        if (!pStream->file) {
+
+            return false;
+        }
+
+        if (!pStream->isCompressed && !pStream->isEncrypted) {
+
+            return true;
+        }
+
+        pStream->isCorrupt = false;
+        pStream->isFinal = false;
+        pStream->blockIndex = pPosition->blockIndex;
+        pStream->block.clear();
+        pStream->pos = 0;
+
+        if (!pPosition->blockOffset) {
+
+            return true;
+        }
+
+        if (!readBlock(pStream) || pPosition->blockOffset > pStream->block.size()) {
+
+            return false;
+        }
+
+        pStream->pos = pPosition->blockOffset;
+
+        return true;
+    }
+
+
+    bool decompressBlock(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstSize) {
+        const uint8_t* ip = src;
+        const uint8_t* const ipEnd = src + srcSize;
+        uint8_t* op = dst;
+        uint8_t* const opEnd = dst + dstSize;
+
+        while (ip < ipEnd) {
+            const uint8_t token = *ip++;
+            size_t literalLength = token >> 4;
+
+            if (literalLength == 0xF && !readLength(&ip, ipEnd, &literalLength)) {
+
+                return false;
+            }
+
+            if (literalLength > static_cast<size_t>(ipEnd - ip) || literalLength > static_cast<size_t>(opEnd - op)) {
+
+                return false;
+            }
+
+            memcpy(op, ip, literalLength);
+            ip += literalLength;
+            op += literalLength;
+
+            // the last sequence only has literals
+            if (ip == ipEnd) break;
+
+            if (ipEnd - ip < 2) {
+
+                return false;
+            }
+
+            const size_t offset = ip[0] | ip[1] << 8;
+            ip += 2;
+            size_t matchLength = token & 0xF;
+
+            if (matchLength == 0xF && !readLength(&ip, ipEnd, &matchLength)) {
+
+                return false;
+            }
+
+            matchLength += 4;
+
+            if (!offset || offset > static_cast<size_t>(op - dst) || matchLength > static_cast<size_t>(opEnd - op)) {
+
+                return false;
+            }
+
+            const uint8_t* ref = op - offset;
+
+            if (offset >= matchLength) {
+                memcpy(op, ref, matchLength);
+                op += matchLength;
+            }
+            else {
+
+                // overlapping matches repeat the last offset bytes
+                while (matchLength--) {
+                    *op++ = *ref++;
+                }
+
+            }
+
+        }
+
+        return op == opEnd;
+    }
+
+
+    bool decompressFile(const char* inPath, const char* outPath, const uint8_t* key) {
+        Stream stream;
+
+        if (!open(&stream, inPath, key)) {
+
+            return false;
+        }
+
+        std::ofstream out(outPath, std::ios::binary | std::ios::trunc);
+
+        if (!out) {
+
+            return false;
+        }
+
+        std::vector<char> buffer(LZ_BLOCK_SIZE);
+        size_t size = 0;
+
+        while ((size = read(&stream, buffer.data(), buffer.size())) != 0) {
+            out.write(buffer.data(), size);
+        }
+
+        return !stream.isCorrupt && static_cast<bool>(out);
+    }
+
+
+    bool readKeyFile(const char* path, uint8_t* key) {
+        std::ifstream file(path);
+        std::string hex;
+
+        if (!(file >> hex) || hex.length() != 2 * CIPHER_KEY_SIZE || hex.find_first_not_of("0123456789abcdefABCDEF") != std::string::npos) {
+
+            return false;
+        }
+
+        for (size_t i = 0; i < CIPHER_KEY_SIZE; i++) {
+            key[i] = static_cast<uint8_t>(std::stoul(hex.substr(2 * i, 2), nullptr, 0x10));
+        }
+
+        return true;
+    }
+
+
+    bool writeKeyFile(const char* path, const uint8_t* key) {
+        std::ofstream file(path, std::ios::trunc);
+        std::ostringstream stream;
+
+        for (size_t i = 0; i < CIPHER_KEY_SIZE; i++) {
+            stream << std::hex << std::setw(2) << std::setfill('0') << static_cast<unsigned int>(key[i]);
+        }
+
+        file << stream.str() << '\n';
+
+        return static_cast<bool>(file);
+    }
+
+
+    // Reads and decompresses the next block. Sets isCorrupt for truncated or invalid blocks.
+    static bool readBlock(Stream* pStream) {
+        LzBlockHeader header{};
+        pStream->block.clear();
+        pStream->pos = 0;
+        pStream->blockOffset = static_cast<uint64_t>(pStream->file.tellg());
+
+        if (pStream->isCorrupt) {
+
+            return false;
+        }
+
+        if (!pStream->file.read(reinterpret_cast<char*>(&header), sizeof(header))) {
+            // the final block is authenticated, so an encrypted file without it was truncated
+            pStream->isCorrupt = pStream->isEncrypted && !pStream->isFinal;
+
+            return false;
+        }
+
+        const uint32_t blockIndex = pStream->blockIndex++;
+        const bool isFinal = (header.uncompressedSize & LZ_BLOCK_FINAL) != 0;
+        const uint32_t uncompressedSize = header.uncompressedSize & ~LZ_BLOCK_FINAL;
+
+        // only the final block can be empty and nothing follows it
+        if (pStream->isFinal || (!uncompressedSize && !isFinal) || uncompressedSize > LZ_BLOCK_SIZE || header.compressedSize > LZ_MAX_COMPRESSED_SIZE(LZ_BLOCK_SIZE)) {
+            pStream->isCorrupt = true;
+
+            return false;
+        }
+
+        // encrypted blocks are followed by their tag
+        const size_t tagSize = pStream->isEncrypted ? CIPHER_TAG_SIZE : 0;
+        pStream->compressed.resize(header.compressedSize + tagSize);
+
+        if (!pStream->file.read(reinterpret_cast<char*>(pStream->compressed.data()), pStream->compressed.size())) {
+            pStream->isCorrupt = true;
+
+            return false;
+        }
+
+        if (pStream->isEncrypted) {
+            uint8_t nonce[CIPHER_NONCE_SIZE]{};
+            memcpy(nonce, &pStream->cipherHeader.noncePrefix, sizeof(pStream->cipherHeader.noncePrefix));
+            memcpy(nonce + sizeof(pStream->cipherHeader.noncePrefix), &blockIndex, sizeof(blockIndex));
+            // the file header is authenticated with every block, so its flags can not be changed
+            uint8_t authData[sizeof(CipherFileHeader) + sizeof(LzBlockHeader)];
+            memcpy(authData, &pStream->cipherHeader, sizeof(CipherFileHeader));
+            memcpy(authData + sizeof(CipherFileHeader), &header, sizeof(LzBlockHeader));
+            uint8_t* const data = pStream->compressed.data();
+
+            if (!gcm::decrypt(&pStream->cipher, nonce, authData, sizeof(authData), data, data, header.compressedSize, data + header.compressedSize)) {
+                pStream->isCorrupt = true;
+
+                return false;
+            }
+
+            pStream->compressed.resize(header.compressedSize);
+        }
+
+        pStream->block.resize(uncompressedSize);
+
+        if (header.compressedSize == uncompressedSize || !pStream->isCompressed) {
+            pStream->block.swap(pStream->compressed);
+        }
+        else if (!decompressBlock(pStream->compressed.data(), header.compressedSize, pStream->block.data(), uncompressedSize)) {
+            pStream->block.clear();
+            pStream->isCorrupt = true;
+
+            return false;
+        }
+
+        pStream->isFinal = isFinal;
+
+        return true;
+    }
+
+
+    // Reads the remainder of a length that did not fit into the four bits of the token.
+    static bool readLength(const uint8_t** pIp, const uint8_t* ipEnd, size_t* pLength) {
+        uint8_t value = 0;
+
+        do {
+
+            if (*pIp == ipEnd) {
+
+                return false;
+            }
+
+            value = *(*pIp)++;
+            *pLength += value;
+        } while (value == 0xFF);
+
+        return true;
+    }
+
+}
\ No newline at end of file
@@ -0,0 +1,167 @@
+#pragma once
+#include "../../LumbrJackDriver/src/lz.h"
+#include "../../LumbrJackDriver/src/cipher.h"
+#include "gcm.h"
+#include <fstream>
+#include <vector>
+
+// Streaming decompression and decryption of log files compressed (see lz.h) or encrypted (see cipher.h) by the driver.
+// Does not depend on Windows headers, so log files can be decompressed on any platform.
+namespace decompress {
+
+	// Input stream of a log file. Plain files are read as they are.
+	struct Stream {
+		std::ifstream file;
+		bool isCompressed;
+		bool isEncrypted;
+		// Set if a block is truncated, corrupt or fails authentication. Reading stops at the block.
+		// Also set for encrypted files that end without a final block and for blocks after the final block.
+		bool isCorrupt;
+		// Set once the block with LZ_BLOCK_FINAL was read.
+		bool isFinal;
+		CipherFileHeader cipherHeader;
+		// Index of the next block.
+		uint32_t blockIndex;
+		// Offset of the current block in the file.
+		uint64_t blockOffset;
+		gcm::Context cipher;
+		std::vector<uint8_t> block;
+		std::vector<uint8_t> compressed;
+		size_t pos;
+	};
+
+	// Position in a log file reading can be continued from.
+	struct Position {
+		// Offset of a block in the file for compressed or encrypted files, offset of the data for plain files.
+		uint64_t fileOffset;
+		// Index of the block. Part of the nonce of encrypted blocks.
+		uint32_t blockIndex;
+		// Offset in the decompressed block.
+		uint32_t blockOffset;
+	};
+
+	// Opens a log file and detects if it is compressed or encrypted.
+	//
+	// Parameters:
+	//
+	// [out] pStream:
+	// Stream to initialize.
+	//
+	// [in] path:
+	// Path of the log file.
+	//
+	// [in] key:
+	// Key of CIPHER_KEY_SIZE bytes for encrypted files. Can be nullptr for files that are not encrypted.
+	//
+	// Return:
+	// True on success, false if the file could not be opened or is encrypted and no key was passed.
+	bool open(Stream* pStream, const char* path, const uint8_t* key);
+
+	// Reads decompressed data of a log file.
+	//
+	// Parameters:
+	//
+	// [in/out] pStream:
+	// Opened stream.
+	//
+	// [out] buffer:
+	// Buffer that receives the data.
+	//
+	// [in] size:
+	// Number of bytes to read.
+	//
+	// Return:
+	// Number of bytes read. Less than size at the end of the file or at a corrupt block.
+	size_t read(Stream* pStream, void* buffer, size_t size);
+
+	// Gets the position of the next byte read from a stream.
+	//
+	// Parameters:
+	//
+	// [in/out] pStream:
+	// Opened stream.
+	//
+	// [out] pPosition:
+	// Contains the position on return.
+	void tell(Stream* pStream, Position* pPosition);
+
+	// Continues reading a stream at a position returned by tell. Only the block at the position is read.
+	//
+	// Parameters:
+	//
+	// [in/out] pStream:
+	// Opened stream.
+	//
+	// [in] pPosition:
+	// Position to continue at.
+	//
+	// Return:
+	// True on success, false if the position is beyond the end of the file or its block is corrupt.
+	bool seek(Stream* pStream, const Position* pPosition);
+
+	// Decompresses a block in the LZ4 block format.
+	//
+	// Parameters:
+	//
+	// [in] src:
+	// Compressed data.
+	//
+	// [in] srcSize:
+	// Size of the compressed data.
+	//
+	// [out] dst:
+	// Buffer that receives the decompressed data.
+	//
+	// [in] dstSize:
+	// Expected size of the decompressed data.
+	//
+	// Return:
+	// True if the block decompressed to exactly dstSize bytes, false if it is corrupt.
+	bool decompressBlock(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstSize);
+
+	// Decompresses a log file to another file.
+	//
+	// Parameters:
+	//
+	// [in] inPath:
+	// Path of the compressed log file.
+	//
+	// [in] outPath:
+	// Path of the decompressed file. Overwritten if it exists.
+	//
+	// [in] key:
+	// Key of CIPHER_KEY_SIZE bytes for encrypted files. Can be nullptr for files that are not encrypted.
+	//
+	// Return:
+	// True on success, false on failure or a corrupt file.
+	bool decompressFile(const char* inPath, const char* outPath, const uint8_t* key);
+
+	// Reads a key from a file of hexadecimal digits.
+	//
+	// Parameters:
+	//
+	// [in] path:
+	// Path of the key file.
+	//
+	// [out] key:
+	// Buffer of CIPHER_KEY_SIZE bytes that receives the key.
+	//
+	// Return:
+	// True on success, false if the file could not be read or does not contain a key.
+	bool readKeyFile(const char* path, uint8_t* key);
+
+	// Writes a key as hexadecimal digits to a file.
+	//
+	// Parameters:
+	//
+	// [in] path:
+	// Path of the key file. Overwritten if it exists.
+	//
+	// [in] key:
+	// Key of CIPHER_KEY_SIZE bytes.
+	//
+	// Return:
+	// True on success, false on failure.
+	bool writeKeyFile(const char* path, const uint8_t* key);
+
+}
\ No newline at end of file
@@ -0,0 +1,554 @@
+#include "follow.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <fstream>
+#include <system_error>
+
+#ifdef _WIN32
+// std::min and std::max are used
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace follow {
+
+    // Appended data is read and parsed in blocks of this size, so catching up with a large file does not load it at once.
+    static constexpr size_t BLOCK_SIZE = 0x400000;
+    // Bytes the parser detects the format of text logs in.
+    static constexpr size_t DETECT_SIZE = 0x100;
+    static constexpr intptr_t NO_FILE = -1;
+
+    struct FileInfo {
+        uint64_t volumeId;
+        uint64_t fileId;
+        uint64_t size;
+    };
+
+    static bool fail(Follower* pFollower, failure reason, int systemError);
+    static int getSystemError();
+    static bool readAppended(Follower* pFollower, Update* pUpdate);
+    static bool checkFingerprint(Follower* pFollower, uint64_t size);
+    static bool detect(Follower* pFollower, size_t size, size_t* pDataOffset, bool* pIsDetected);
+    static void reset(Checkpoint* pCheckpoint);
+    static uint64_t hash(const uint8_t* data, size_t size);
+    static bool openFile(const char* path, intptr_t* pFile, bool* pIsMissing);
+    static void closeFile(intptr_t file);
+    static bool getFileInfo(intptr_t file, FileInfo* pInfo);
+    static bool getPathInfo(const char* path, FileInfo* pInfo);
+    static bool readFile(intptr_t file, uint64_t offset, uint8_t* buffer, size_t size, size_t* pReadSize);
+
+    std::string getCheckpointPath(const char* path) {
+
+        return std::string(path) + ".ckpt";
+    }
+
+
+    void open(Follower* pFollower, const char* path, bool isReset) {
+        pFollower->path = path;
+        pFollower->checkpointPath = getCheckpointPath(path);
+        pFollower->file = NO_FILE;
+        pFollower->size = 0;
+        pFollower->buffer.clear();
+        pFollower->lastFailure = NO_FAILURE;
+        pFollower->systemError = 0;
+        Checkpoint* const pCheckpoint = &pFollower->checkpoint;
+        *pCheckpoint = Checkpoint{};
+        bool isValid = false;
+
+        if (!isReset) {
+            std::ifstream file(pFollower->checkpointPath, std::ios::binary);
+            isValid = file.read(reinterpret_cast<char*>(pCheckpoint), sizeof(Checkpoint)) && pCheckpoint->magic == CHECKPOINT_MAGIC
+                && pCheckpoint->version == CHECKPOINT_VERSION && pCheckpoint->headerSize == sizeof(Checkpoint) && pCheckpoint->fmt <= parser::BINARY
+                && pCheckpoint->fingerprintSize <= FINGERPRINT_SIZE;
+        }
+
+        // a missing or invalid checkpoint starts at the beginning of the file
+        if (!isValid) {
+            *pCheckpoint = Checkpoint{};
+            pCheckpoint->magic = CHECKPOINT_MAGIC;
+            pCheckpoint->version = CHECKPOINT_VERSION;
+            pCheckpoint->headerSize = sizeof(Checkpoint);
+        }
+
+        return;
+    }
+
+
+    void close(Follower* pFollower) {
+
+        if (pFollower->file != NO_FILE) {
+            closeFile(pFollower->file);
+            pFollower->file = NO_FILE;
+        }
+
+        std::vector<uint8_t>().swap(pFollower->buffer);
+
+        return;
+    }
+
+
+    bool hasChanged(const Follower* pFollower) {
+        FileInfo info{};
+
+        // a deleted or renamed file may still have data that was not read
+        if (!getPathInfo(pFollower->path.c_str(), &info)) return pFollower->file != NO_FILE;
+
+        if (pFollower->file == NO_FILE) return true;
+
+        const Checkpoint* const pCheckpoint = &pFollower->checkpoint;
+
+        return info.volumeId != pCheckpoint->volumeId || info.fileId != pCheckpoint->fileId || info.size != pFollower->size;
+    }
+
+
+    bool update(Follower* pFollower, Update* pUpdate) {
+        pUpdate->events.clear();
+        pUpdate->invalidCount = 0;
+        pUpdate->size = 0;
+        pUpdate->isReset = false;
+        pFollower->lastFailure = NO_FAILURE;
+        pFollower->systemError = 0;
+        Checkpoint* const pCheckpoint = &pFollower->checkpoint;
+        FileInfo info{};
+
+        if (pFollower->file != NO_FILE) {
+            const bool exists = getPathInfo(pFollower->path.c_str(), &info);
+
+            // the open file was rotated, so it is read to its end before the file of the path is followed
+            if (!exists || info.volumeId != pCheckpoint->volumeId || info.fileId != pCheckpoint->fileId) {
+
+                if (!readAppended(pFollower, pUpdate)) {
+
+                    return false;
+                }
+
+                closeFile(pFollower->file);
+                pFollower->file = NO_FILE;
+                pFollower->size = 0;
+                reset(pCheckpoint);
+                pUpdate->isReset = true;
+            }
+
+        }
+
+        if (pFollower->file == NO_FILE) {
+
+            bool isMissing = false;
+
+            if (!openFile(pFollower->path.c_str(), &pFollower->file, &isMissing)) {
+
+                // the file is not created yet
+                if (isMissing) return true;
+
+                return fail(pFollower, OPEN_FAILED, getSystemError());
+            }
+
+            if (!getFileInfo(pFollower->file, &info)) {
+                const int systemError = getSystemError();
+                closeFile(pFollower->file);
+                pFollower->file = NO_FILE;
+
+                return fail(pFollower, STAT_FAILED, systemError);
+            }
+
+            // the file of the checkpoint was rotated while it was not followed, its remaining data can not be found anymore
+            if (info.volumeId != pCheckpoint->volumeId || info.fileId != pCheckpoint->fileId) {
+
+                if (pCheckpoint->offset) {
+                    reset(pCheckpoint);
+                    pUpdate->isReset = true;
+                }
+
+                pCheckpoint->volumeId = info.volumeId;
+                pCheckpoint->fileId = info.fileId;
+            }
+
+        }
+
+        return readAppended(pFollower, pUpdate);
+    }
+
+
+    bool save(Follower* pFollower) {
+        const std::string tempPath = pFollower->checkpointPath + ".tmp";
+        pFollower->lastFailure = NO_FAILURE;
+        pFollower->systemError = 0;
+        errno = 0;
+
+        {
+            std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+
+            // the streams keep errno of the failed call
+            if (!file.write(reinterpret_cast<const char*>(&pFollower->checkpoint), sizeof(Checkpoint))) {
+
+                return fail(pFollower, SAVE_FAILED, errno);
+            }
+
+        }
+
+#ifdef _WIN32
+        if (!MoveFileExA(tempPath.c_str(), pFollower->checkpointPath.c_str(), MOVEFILE_REPLACE_EXISTING)) {
+
+            return fail(pFollower, SAVE_FAILED, static_cast<int>(GetLastError()));
+        }
+#else
+        if (std::rename(tempPath.c_str(), pFollower->checkpointPath.c_str()) != 0) {
+
+            return fail(pFollower, SAVE_FAILED, errno);
+        }
+#endif
+
+        return true;
+    }
+
+
+    std::string getFailureMessage(const Follower* pFollower) {
+        static const char* const messages[] = {
+            "No failure",
+            "The file could not be opened",
+            "The size of the file could not be read",
+            "The file could not be read",
+            "The file is compressed or encrypted, such log files can not be followed",
+            "The checkpoint could not be written",
+        };
+        std::string message = messages[pFollower->lastFailure];
+
+        if (pFollower->systemError) {
+            message += ": " + std::system_category().message(pFollower->systemError) + " (" + std::to_string(pFollower->systemError) + ")";
+        }
+
+        return message;
+    }
+
+
+    // Stores the reason of a failed update or save. Always returns false.
+    static bool fail(Follower* pFollower, failure reason, int systemError) {
+        pFollower->lastFailure = reason;
+        pFollower->systemError = systemError;
+
+        return false;
+    }
+
+
+    // Returns errno or GetLastError of the last failed call of the platform.
+    static int getSystemError() {
+#ifdef _WIN32
+        return static_cast<int>(GetLastError());
+#else
+        return errno;
+#endif
+    }
+
+
+    // Parses the data of the open file from the offset of the checkpoint to the last complete record or line.
+    static bool readAppended(Follower* pFollower, Update* pUpdate) {
+        Checkpoint* const pCheckpoint = &pFollower->checkpoint;
+        FileInfo info{};
+
+        if (!getFileInfo(pFollower->file, &info)) {
+
+            return fail(pFollower, STAT_FAILED, getSystemError());
+        }
+
+        pFollower->size = info.size;
+
+        // the file was truncated or overwritten in place
+        if (info.size < pCheckpoint->offset || !checkFingerprint(pFollower, info.size)) {
+            reset(pCheckpoint);
+            pUpdate->isReset = true;
+
+            // the fingerprint is empty after the reset, so only reading can fail
+            if (!checkFingerprint(pFollower, info.size)) {
+
+                return fail(pFollower, READ_FAILED, getSystemError());
+            }
+
+        }
+
+        parser::ChunkResult result{};
+
+        while (pCheckpoint->offset < info.size) {
+            const size_t size = static_cast<size_t>(std::min<uint64_t>(info.size - pCheckpoint->offset, BLOCK_SIZE));
+            pFollower->buffer.resize(size);
+            size_t readSize = 0;
+
+            if (!readFile(pFollower->file, pCheckpoint->offset, pFollower->buffer.data(), size, &readSize)) {
+
+                return fail(pFollower, READ_FAILED, getSystemError());
+            }
+
+            // the file was truncated since its size was read
+            if (!readSize) break;
+
+            size_t begin = 0;
+
+            if (pCheckpoint->fmt == parser::UNKNOWN) {
+                bool isDetected = false;
+
+                // the header of binary log files is skipped
+                if (!detect(pFollower, readSize, &begin, &isDetected)) {
+
+                    return fail(pFollower, UNSUPPORTED_FORMAT, 0);
+                }
+
+                if (!isDetected) break;
+
+            }
+
+            parser::Capture capture{};
+            capture.file.data = pFollower->buffer.data();
+            capture.file.size = readSize;
+            capture.fmt = static_cast<parser::format>(pCheckpoint->fmt);
+            capture.header = pCheckpoint->header;
+            const size_t end = parser::findEnd(&capture, begin, readSize);
+
+            if (end == begin) {
+
+                // a line longer than a block is never completed
+                if (readSize < BLOCK_SIZE) {
+                    pCheckpoint->offset += begin;
+
+                    break;
+                }
+
+                pCheckpoint->offset += readSize;
+                pCheckpoint->invalidCount++;
+                pUpdate->invalidCount++;
+                pUpdate->size += readSize;
+
+                continue;
+            }
+
+            const parser::Chunk chunk = { begin, end };
+            parser::parseChunk(&capture, &chunk, &result);
+            parser::resolveTimes(&capture, &pCheckpoint->time, &result);
+            pUpdate->events.insert(pUpdate->events.end(), result.events.begin(), result.events.end());
+            pUpdate->invalidCount += result.invalidCount;
+            pUpdate->size += end;
+            pCheckpoint->eventCount += result.events.size();
+            pCheckpoint->invalidCount += result.invalidCount;
+            pCheckpoint->offset += end;
+        }
+
+        return true;
+    }
+
+
+    // Compares the first bytes of the file with the fingerprint of the checkpoint and extends the fingerprint to the bytes written since.
+    // Returns false if the file was overwritten with different data or could not be read.
+    static bool checkFingerprint(Follower* pFollower, uint64_t size) {
+        Checkpoint* const pCheckpoint = &pFollower->checkpoint;
+        uint8_t data[FINGERPRINT_SIZE];
+        size_t readSize = 0;
+
+        if (!readFile(pFollower->file, 0, data, static_cast<size_t>(std::min<uint64_t>(size, FINGERPRINT_SIZE)), &readSize) || readSize < pCheckpoint->fingerprintSize) {
+
+            return false;
+        }
+
+        if (pCheckpoint->fingerprintSize && hash(data, pCheckpoint->fingerprintSize) != pCheckpoint->fingerprint) {
+
+            return false;
+        }
+
+        pCheckpoint->fingerprint = hash(data, readSize);
+        pCheckpoint->fingerprintSize = static_cast<uint32_t>(readSize);
+
+        return true;
+    }
+
+
+    // Detects the format of a file from the first block at its beginning. Files with too little data to tell their format are detected by a later update.
+    static bool detect(Follower* pFollower, size_t size, size_t* pDataOffset, bool* pIsDetected) {
+        Checkpoint* const pCheckpoint = &pFollower->checkpoint;
+        const parser::MappedFile file = { pFollower->buffer.data(), size };
+        RecordFileHeader header{};
+        const parser::format fmt = parser::detectFormat(&file, &header, pDataOffset);
+        *pIsDetected = false;
+
+        if (fmt == parser::UNKNOWN) {
+
+            // the header of a binary log file may not be written completely
+            return size < sizeof(RecordFileHeader);
+        }
+
+        // plain keyboard logs contain no upper case characters, so this is the beginning of a line without its source ID
+        if (fmt == parser::KEY_STREAM && size < DETECT_SIZE) {
+            const uint8_t* const end = file.data + size;
+
+            if (std::find_if(file.data, end, [](uint8_t c) { return c >= 'A' && c <= 'Z'; }) != end) return true;
+
+        }
+
+        pCheckpoint->fmt = fmt;
+        pCheckpoint->header = header;
+        pCheckpoint->time = header.startTime;
+        *pIsDetected = true;
+
+        return true;
+    }
+
+
+    // Restarts the checkpoint at the beginning of the file. The identity of the file and the counts are kept.
+    static void reset(Checkpoint* pCheckpoint) {
+        pCheckpoint->offset = 0;
+        pCheckpoint->fingerprint = 0;
+        pCheckpoint->fingerprintSize = 0;
+        pCheckpoint->fmt = parser::UNKNOWN;
+        pCheckpoint->header = RecordFileHeader{};
+        pCheckpoint->time = 0;
+        pCheckpoint->resetCount++;
+
+        return;
+    }
+
+
+    static uint64_t hash(const uint8_t* data, size_t size) {
+        uint64_t value = 0xCBF29CE484222325;
+
+        for (size_t i = 0; i < size; i++) {
+            value = (value ^ data[i]) * 0x100000001B3;
+        }
+
+        return value;
+    }
+
+
+    static bool openFile(const char* path, intptr_t* pFile, bool* pIsMissing) {
+#ifdef _WIN32
+        // the writer keeps the file open, and a follower does not prevent rotating the file
+        const HANDLE hFile = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+
+        if (hFile == INVALID_HANDLE_VALUE) {
+            *pIsMissing = GetLastError() == ERROR_FILE_NOT_FOUND || GetLastError() == ERROR_PATH_NOT_FOUND;
+
+            return false;
+        }
+
+        *pFile = reinterpret_cast<intptr_t>(hFile);
+#else
+        const int fd = ::open(path, O_RDONLY);
+
+        if (fd < 0) {
+            *pIsMissing = errno == ENOENT;
+
+            return false;
+        }
+
+        *pFile = fd;
+#endif
+
+        return true;
+    }
+
+
+    static void closeFile(intptr_t file) {
+#ifdef _WIN32
+        CloseHandle(reinterpret_cast<HANDLE>(file));
+#else
+        ::close(static_cast<int>(file));
+#endif
+
+        return;
+    }
+
+
+    static bool getFileInfo(intptr_t file, FileInfo* pInfo) {
+#ifdef _WIN32
+        BY_HANDLE_FILE_INFORMATION fileInfo{};
+
+        if (!GetFileInformationByHandle(reinterpret_cast<HANDLE>(file), &fileInfo)) {
+
+            return false;
+        }
+
+        pInfo->volumeId = fileInfo.dwVolumeSerialNumber;
+        pInfo->fileId = static_cast<uint64_t>(fileInfo.nFileIndexHigh) << 32 | fileInfo.nFileIndexLow;
+        pInfo->size = static_cast<uint64_t>(fileInfo.nFileSizeHigh) << 32 | fileInfo.nFileSizeLow;
+#else
+        struct stat fileStat {};
+
+        if (fstat(static_cast<int>(file), &fileStat) != 0) {
+
+            return false;
+        }
+
+        pInfo->volumeId = static_cast<uint64_t>(fileStat.st_dev);
+        pInfo->fileId = static_cast<uint64_t>(fileStat.st_ino);
+        pInfo->size = static_cast<uint64_t>(fileStat.st_size);
+#endif
+
+        return true;
+    }
+
+
+    static bool getPathInfo(const char* path, FileInfo* pInfo) {
+#ifdef _WIN32
+        // opening without access rights only reads the metadata
+        const HANDLE hFile = CreateFileA(path, 0, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+
+        if (hFile == INVALID_HANDLE_VALUE) {
+
+            return false;
+        }
+
+        const bool isValid = getFileInfo(reinterpret_cast<intptr_t>(hFile), pInfo);
+        CloseHandle(hFile);
+
+        return isValid;
+#else
+        struct stat fileStat {};
+
+        if (stat(path, &fileStat) != 0) {
+
+            return false;
+        }
+
+        pInfo->volumeId = static_cast<uint64_t>(fileStat.st_dev);
+        pInfo->fileId = static_cast<uint64_t>(fileStat.st_ino);
+        pInfo->size = static_cast<uint64_t>(fileStat.st_size);
+
+        return true;
+#endif
+    }
+
+
+    static bool readFile(intptr_t file, uint64_t offset, uint8_t* buffer, size_t size, size_t* pReadSize) {
+        *pReadSize = 0;
+
+        while (*pReadSize < size) {
+#ifdef _WIN32
+            OVERLAPPED overlapped{};
+            const uint64_t position = offset + *pReadSize;
+            overlapped.Offset = static_cast<DWORD>(position);
+            overlapped.OffsetHigh = static_cast<DWORD>(position >> 32);
+            DWORD readSize = 0;
+            const DWORD requestSize = static_cast<DWORD>(std::min<size_t>(size - *pReadSize, 0x40000000));
+
+            if (!ReadFile(reinterpret_cast<HANDLE>(file), buffer + *pReadSize, requestSize, &readSize, &overlapped)) {
+
+                return GetLastError() == ERROR_HANDLE_EOF;
+            }
+#else
+            const ssize_t readSize = pread(static_cast<int>(file), buffer + *pReadSize, size - *pReadSize, static_cast<off_t>(offset + *pReadSize));
+
+            if (readSize < 0) {
+
+                return false;
+            }
+#endif
+
+            if (!readSize) break;
+
+            *pReadSize += static_cast<size_t>(readSize);
+        }
+
+        return true;
+    }
+
+}
\ No newline at end of file
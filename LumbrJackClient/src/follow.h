@@ -0,0 +1,157 @@
+#pragma once
+#include "parser.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Incremental follow mode for logs that are still written, e.g. "C:\kbd.log" and "C:\mou.log".
+// Every followed file has a checkpoint with the offset of the data processed so far and the state needed to continue parsing there,
+// so every update only reads and parses the data appended since the last one, also across runs of the client.
+// Rotated, truncated and overwritten files are detected by the identity of the file and a fingerprint of its first bytes and followed from the start.
+// Only the file access depends on the platform, so logs can be followed on any platform.
+namespace follow {
+
+	// Magic of checkpoint files: "LJCK".
+	constexpr uint32_t CHECKPOINT_MAGIC = 0x4B434A4C;
+	constexpr uint16_t CHECKPOINT_VERSION = 1;
+	// Bytes at the beginning of a file covered by the fingerprint.
+	constexpr uint32_t FINGERPRINT_SIZE = 0x40;
+
+	// Checkpoint of a followed file. Stored as it is in the checkpoint file.
+	struct Checkpoint {
+		uint32_t magic;
+		uint16_t version;
+		uint16_t headerSize;
+		// Identity of the file: device and inode or volume serial number and file index.
+		uint64_t volumeId;
+		uint64_t fileId;
+		// Bytes of the file processed so far. Always at a record or line boundary.
+		uint64_t offset;
+		// FNV-1a hash of the first fingerprintSize bytes of the file. Detects files that were overwritten with new data.
+		uint64_t fingerprint;
+		uint32_t fingerprintSize;
+		// parser::format of the file. UNKNOWN until the file contains enough data to detect it.
+		uint32_t fmt;
+		// Header of binary log files.
+		RecordFileHeader header;
+		// Absolute interrupt time at the offset, continued by the deltas of the next records.
+		uint64_t time;
+		// Events and invalid lines or records of all updates.
+		uint64_t eventCount;
+		uint64_t invalidCount;
+		// Rotations and truncations of the file while it was followed.
+		uint64_t resetCount;
+	};
+
+	// Reasons of failed updates and saves.
+	enum failure { NO_FAILURE = 0, OPEN_FAILED, STAT_FAILED, READ_FAILED, UNSUPPORTED_FORMAT, SAVE_FAILED };
+
+	// Followed file.
+	struct Follower {
+		std::string path;
+		std::string checkpointPath;
+		Checkpoint checkpoint;
+		// Handle or descriptor of the open file, -1 if the file is not open.
+		intptr_t file;
+		// Size of the file at the last update.
+		uint64_t size;
+		std::vector<uint8_t> buffer;
+		// Reason of the last failed update or save.
+		failure lastFailure;
+		// errno or GetLastError of the last failure, zero if the failure has no system error.
+		int systemError;
+	};
+
+	// Events of an update.
+	struct Update {
+		std::vector<parser::Event> events;
+		// Lines or records that could not be parsed.
+		uint64_t invalidCount;
+		// Bytes read and parsed.
+		uint64_t size;
+		// True if the file was rotated or truncated. The events of the old file come first, followed by the events of the new one.
+		bool isReset;
+	};
+
+	// Gets the path of the checkpoint of a file.
+	//
+	// Parameters:
+	//
+	// [in] path:
+	// Path of the followed file.
+	//
+	// Return:
+	// Path of the checkpoint file.
+	std::string getCheckpointPath(const char* path);
+
+	// Starts following a file. The file does not need to exist yet.
+	//
+	// Parameters:
+	//
+	// [out] pFollower:
+	// Follower to initialize. Has to be closed with close.
+	//
+	// [in] path:
+	// Path of the followed file.
+	//
+	// [in] isReset:
+	// True to ignore the checkpoint of the file and to start at its beginning.
+	void open(Follower* pFollower, const char* path, bool isReset);
+
+	// Stops following a file. The checkpoint is not saved.
+	//
+	// Parameters:
+	//
+	// [in/out] pFollower:
+	// Opened follower.
+	void close(Follower* pFollower);
+
+	// Checks if a file has grown, shrunk or was replaced since the last update without reading it.
+	//
+	// Parameters:
+	//
+	// [in] pFollower:
+	// Opened follower.
+	//
+	// Return:
+	// True if the file has to be updated.
+	bool hasChanged(const Follower* pFollower);
+
+	// Parses the complete records or lines appended to a file since the last update and advances the checkpoint past them.
+	// Partial records or lines at the end of the file are parsed by a later update. A rotated file is read to its end before the new file is opened.
+	//
+	// Parameters:
+	//
+	// [in/out] pFollower:
+	// Opened follower.
+	//
+	// [out] pUpdate:
+	// Contains the events of the appended data on return. Times are relative to the start of the log file.
+	//
+	// Return:
+	// True on success, false if the file could not be read or is compressed or encrypted. The reason is stored in the follower.
+	bool update(Follower* pFollower, Update* pUpdate);
+
+	// Writes the checkpoint of a file. The checkpoint file is replaced at once, so it is never left partially written.
+	//
+	// Parameters:
+	//
+	// [in/out] pFollower:
+	// Opened follower.
+	//
+	// Return:
+	// True on success, false if the checkpoint file could not be written. The reason is stored in the follower.
+	bool save(Follower* pFollower);
+
+	// Describes the last failed update or save of a follower, including the message of the system error.
+	//
+	// Parameters:
+	//
+	// [in] pFollower:
+	// Opened follower.
+	//
+	// Return:
+	// Description of the failure, e.g. "The file could not be read: Is a directory (21)".
+	std::string getFailureMessage(const Follower* pFollower);
+
+}
\ No newline at end of file
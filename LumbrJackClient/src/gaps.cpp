@@ -0,0 +1,170 @@
+#include "gaps.h"
+#include <iomanip>
+#include <vector>
+
+namespace gaps {
+
+    // Bytes of a text log parsed at once.
+    constexpr size_t TEXT_CHUNK_SIZE = 0x100000;
+
+    // State of a source while the log file is read.
+    struct SourceState {
+        SourceReport report;
+        uint64_t nextSequence;
+    };
+
+    static bool checkRecords(const char* path, const uint8_t* key, std::ostream& out, Report* pReport, std::vector<SourceState>* pStates);
+    static void checkLines(const parser::Capture* pCapture, std::ostream& out, Report* pReport, std::vector<SourceState>* pStates);
+    static void addSequence(SourceState* pState, uint16_t source, uint64_t sequence, const uint64_t* pTime, std::ostream& out, Report* pReport);
+    static void writeGap(uint16_t source, uint64_t firstSequence, uint64_t count, uint64_t record, const uint64_t* pTime, std::ostream& out);
+
+    bool check(const char* path, const uint8_t* key, std::ostream& out, Report* pReport) {
+        *pReport = Report{};
+        // one state per possible source ID, so records are counted without a lookup
+        std::vector<SourceState> states(0x10000);
+        bool isValid = true;
+        parser::Capture capture{};
+        // compressed and encrypted files are not detected by the parser and always contain binary records
+        const bool isOpen = parser::open(&capture, path);
+
+        if (isOpen && capture.fmt != parser::BINARY) {
+            checkLines(&capture, out, pReport, &states);
+        }
+        else {
+            isValid = checkRecords(path, key, out, pReport, &states);
+        }
+
+        if (isOpen) {
+            parser::close(&capture);
+        }
+
+        for (size_t source = 0; source < states.size(); source++) {
+            const SourceReport* const pSourceReport = &states[source].report;
+
+            if (!pSourceReport->recordCount) continue;
+
+            pReport->sources[static_cast<uint16_t>(source)] = *pSourceReport;
+            pReport->lostCount += pSourceReport->lostCount;
+            pReport->gapCount += pSourceReport->gapCount;
+        }
+
+        return isValid;
+    }
+
+
+    double getLossRate(uint64_t lostCount, uint64_t recordCount) {
+
+        if (!lostCount) {
+
+            return 0.0;
+        }
+
+        return static_cast<double>(lostCount) / static_cast<double>(lostCount + recordCount);
+    }
+
+
+    static bool checkRecords(const char* path, const uint8_t* key, std::ostream& out, Report* pReport, std::vector<SourceState>* pStates) {
+        // the record block is too large for the stack
+        decoder::Reader* const pReader = new decoder::Reader();
+
+        if (!decoder::open(pReader, path, key)) {
+            delete pReader;
+
+            return false;
+        }
+
+        pReport->hasSequences = pReader->header.version > 1;
+        const uint64_t startTime = pReader->header.startTime;
+        const InputRecord* pRecord = nullptr;
+        uint64_t time = 0;
+
+        while (decoder::next(pReader, &pRecord, &time)) {
+            const uint64_t relativeTime = time > startTime ? time - startTime : 0;
+            addSequence(&(*pStates)[pRecord->source], pRecord->source, pRecord->sequence, &relativeTime, out, pReport);
+        }
+
+        const bool isValid = !pReader->stream.isCorrupt;
+        delete pReader;
+
+        return isValid;
+    }
+
+
+    // All lines of a mouse entry have the sequence number of the entry, so only the first one counts as a record.
+    // Lines without a sequence number, e.g. of older drivers, are not checked.
+    static void checkLines(const parser::Capture* pCapture, std::ostream& out, Report* pReport, std::vector<SourceState>* pStates) {
+        std::vector<parser::Chunk> chunks;
+        parser::split(pCapture, pCapture->file.size / TEXT_CHUNK_SIZE + 1, &chunks);
+        parser::ChunkResult chunkResult{};
+        // the previous line, also across chunks
+        parser::Event last{};
+
+        for (const parser::Chunk& chunk : chunks) {
+            parser::parseChunk(pCapture, &chunk, &chunkResult);
+
+            for (const parser::Event& event : chunkResult.events) {
+                const bool isSameInput = last.hasSequence && event.source == last.source && event.sequence == last.sequence;
+                last = event;
+
+                if (!event.hasSequence || isSameInput) continue;
+
+                pReport->hasSequences = true;
+                addSequence(&(*pStates)[event.source], event.source, event.sequence, nullptr, out, pReport);
+            }
+
+        }
+
+        return;
+    }
+
+
+    static void addSequence(SourceState* pState, uint16_t source, uint64_t sequence, const uint64_t* pTime, std::ostream& out, Report* pReport) {
+        SourceReport* const pSourceReport = &pState->report;
+
+        if (sequence > pState->nextSequence) {
+            writeGap(source, pState->nextSequence, sequence - pState->nextSequence, pReport->recordCount, pTime, out);
+            pSourceReport->lostCount += sequence - pState->nextSequence;
+            pSourceReport->gapCount++;
+        }
+        else if (sequence < pState->nextSequence) {
+
+            if (sequence) {
+                pSourceReport->reorderedCount++;
+            }
+            else {
+                pSourceReport->restartCount++;
+            }
+
+        }
+
+        // reordered records do not move the expected sequence number back
+        if (sequence >= pState->nextSequence || !sequence) {
+            pState->nextSequence = sequence + 1;
+        }
+
+        pSourceReport->recordCount++;
+        pReport->recordCount++;
+
+        return;
+    }
+
+
+    static void writeGap(uint16_t source, uint64_t firstSequence, uint64_t count, uint64_t record, const uint64_t* pTime, std::ostream& out) {
+        out << "SRC:" << source << " lost " << count << " (sequence " << firstSequence;
+
+        if (count > 1) {
+            out << " to " << firstSequence + count - 1;
+        }
+
+        out << ") before record " << record;
+
+        if (pTime) {
+            out << " at " << *pTime / RECORD_TIME_RESOLUTION << '.' << std::setfill('0') << std::setw(7) << *pTime % RECORD_TIME_RESOLUTION << std::setfill(' ') << " s";
+        }
+
+        out << '\n';
+
+        return;
+    }
+
+}
\ No newline at end of file
@@ -0,0 +1,75 @@
+#pragma once
+#include "decoder.h"
+#include "parser.h"
+#include <cstdint>
+#include <map>
+#include <ostream>
+
+// Loss detection in binary log files and text logs by the sequence numbers of the sources (see record.h).
+// Every source numbers its logged input from zero, so a jump in the sequence numbers of a source is input that was lost
+// in the driver or on the way to the file. Text logs number the input that has lines (see the LineSequences of format.h), records of text logs are such input.
+// The log file is read in a single streaming pass.
+// Does not depend on Windows headers, so log files can be checked on any platform.
+namespace gaps {
+
+	// Lost input of a source.
+	struct SourceReport {
+		// Records of the source in the log file.
+		uint64_t recordCount;
+		// Sequence numbers missing in the log file.
+		uint64_t lostCount;
+		uint64_t gapCount;
+		// Records with a sequence number below the expected one, e.g. records written twice.
+		uint64_t reorderedCount;
+		// Times the sequence numbers started over at zero, e.g. in files of several logging sessions. Devices that get the ID of a removed one continue its sequence.
+		uint32_t restartCount;
+	};
+
+	// Result of a check.
+	struct Report {
+		// Sources with records by their ID.
+		std::map<uint16_t, SourceReport> sources;
+		// Keyboard and mouse records of the log file.
+		uint64_t recordCount;
+		uint64_t lostCount;
+		uint64_t gapCount;
+		// False for binary log files of version 1 and text logs without "SEQ:", which contain no sequence numbers.
+		bool hasSequences;
+	};
+
+	// Checks the sequence numbers of all sources of a log file and writes a line per gap.
+	// A line contains the source, the missing sequence numbers and the number of the record after the gap, followed by its time in binary log files.
+	//
+	// Parameters:
+	//
+	// [in] path:
+	// Path of the log file.
+	//
+	// [in] key:
+	// Key of CIPHER_KEY_SIZE bytes for encrypted files. Can be nullptr for files that are not encrypted.
+	//
+	// [out] out:
+	// Stream the gaps are written to.
+	//
+	// [out] pReport:
+	// Contains the lost input per source on return.
+	//
+	// Return:
+	// True on success, false if the file could not be opened, is invalid or contains a corrupt block.
+	bool check(const char* path, const uint8_t* key, std::ostream& out, Report* pReport);
+
+	// Gets the share of lost input.
+	//
+	// Parameters:
+	//
+	// [in] lostCount:
+	// Lost input.
+	//
+	// [in] recordCount:
+	// Logged input.
+	//
+	// Return:
+	// Lost input per input that should have been logged, from zero to one.
+	double getLossRate(uint64_t lostCount, uint64_t recordCount);
+
+}
\ No newline at end of file
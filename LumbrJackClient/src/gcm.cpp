@@ -0,0 +1,674 @@
+#include "gcm.h"
+#include <cstring>
+#include <string>
+#include <vector>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define GCM_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define GCM_TARGET
+#else
+#include <cpuid.h>
+#define GCM_TARGET __attribute__((target("aes,pclmul,ssse3")))
+#endif
+#endif
+
+namespace gcm {
+
+    // Tables of the table based AES. Computed once instead of being spelled out.
+    struct Tables {
+        uint8_t sbox[0x100];
+        uint32_t te[4][0x100];
+    };
+
+    // Known answer tests of the GCM specification for 256 bit keys (test cases 13 to 16).
+    struct TestVector {
+        const char* key;
+        const char* nonce;
+        const char* plain;
+        const char* aad;
+        const char* cipher;
+        const char* tag;
+    };
+
+    static const TestVector testVectors[]{
+        {
+            "0000000000000000000000000000000000000000000000000000000000000000", "000000000000000000000000",
+            "", "", "", "530f8afbc74536b9a963b4f1c4cb738b"
+        },
+        {
+            "0000000000000000000000000000000000000000000000000000000000000000", "000000000000000000000000",
+            "00000000000000000000000000000000", "", "cea7403d4d606b6e074ec5d3baf39d18", "d0d1c8a799996bf0265b98b5d48ab919"
+        },
+        {
+            "feffe9928665731c6d6a8f9467308308feffe9928665731c6d6a8f9467308308", "cafebabefacedbaddecaf888",
+            "d9313225f88406e5a55909c5aff5269a86a7a9531534f7da2e4c303d8a318a721c3c0c95956809532fcf0e2449a6b525b16aedf5aa0de657ba637b391aafd255",
+            "",
+            "522dc1f099567d07f47f37a32a84427d643a8cdcbfe5c0c97598a2bd2555d1aa8cb08e48590dbb3da7b08b1056828838c5f61e6393ba7a0abcc9f662898015ad",
+            "b094dac5d93471bdec1a502270e3cc6c"
+        },
+        {
+            "feffe9928665731c6d6a8f9467308308feffe9928665731c6d6a8f9467308308", "cafebabefacedbaddecaf888",
+            "d9313225f88406e5a55909c5aff5269a86a7a9531534f7da2e4c303d8a318a721c3c0c95956809532fcf0e2449a6b525b16aedf5aa0de657ba637b39",
+            "feedfacedeadbeeffeedfacedeadbeefabaddad2",
+            "522dc1f099567d07f47f37a32a84427d643a8cdcbfe5c0c97598a2bd2555d1aa8cb08e48590dbb3da7b08b1056828838c5f61e6393ba7a0abcc9f662",
+            "76fc6ece0f4e1768cddf8853bb2d551b"
+        }
+    };
+
+    // Reduction constants of the table based GHASH.
+    static const uint64_t last4[0x10]{
+        0x0000, 0x1c20, 0x3840, 0x2460, 0x7080, 0x6ca0, 0x48c0, 0x54e0,
+        0xe100, 0xfd20, 0xd940, 0xc560, 0x9180, 0x8da0, 0xa9c0, 0xb5e0
+    };
+
+    static const Tables* getTables();
+    static void encryptBlock(const Context* pContext, const uint8_t* in, uint8_t* out);
+    static void ctr(const Context* pContext, const uint8_t* nonce, const uint8_t* in, uint8_t* out, size_t size);
+    static void computeTag(const Context* pContext, const uint8_t* nonce, const uint8_t* aad, size_t aadSize, const uint8_t* cipher, size_t size, uint8_t* tag);
+    static void ghash(const Context* pContext, uint8_t* y, const uint8_t* data, size_t size);
+    static void multiplyH(const Context* pContext, uint8_t* x);
+    static uint32_t load32(const uint8_t* p);
+    static void store32(uint8_t* p, uint32_t value);
+    static std::vector<uint8_t> fromHex(const char* hex);
+    static bool testVector(const TestVector* pVector, bool isAccelerated);
+    static bool compareImplementations();
+
+#ifdef GCM_X86
+    GCM_TARGET static void ctrAccelerated(const Context* pContext, const uint8_t* nonce, const uint8_t* in, uint8_t* out, size_t size);
+    GCM_TARGET static void ghashAccelerated(const Context* pContext, uint8_t* y, const uint8_t* data, size_t size);
+#endif
+
+    bool isAccelerationSupported() {
+#ifdef GCM_X86
+        unsigned int ecx = 0;
+#ifdef _MSC_VER
+        int info[4]{};
+        __cpuid(info, 1);
+        ecx = static_cast<unsigned int>(info[2]);
+#else
+        unsigned int eax = 0, ebx = 0, edx = 0;
+
+        if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+
+            return false;
+        }
+#endif
+        // PCLMULQDQ, SSSE3 and AES-NI
+        const unsigned int required = 1u << 1 | 1u << 9 | 1u << 25;
+
+        return (ecx & required) == required;
+#else
+
+        return false;
+#endif
+    }
+
+
+    void init(Context* pContext, const uint8_t* key, bool isAccelerated) {
+        const Tables* const pTables = getTables();
+        uint32_t* const rk = pContext->roundKeys;
+
+        for (int i = 0; i < 8; i++) {
+            rk[i] = load32(key + 4 * i);
+        }
+
+        uint8_t rcon = 1;
+
+        for (int i = 8; i < 60; i++) {
+            uint32_t temp = rk[i - 1];
+
+            if (i % 8 == 0) {
+                temp = temp << 8 | temp >> 24;
+                temp = static_cast<uint32_t>(pTables->sbox[temp >> 24]) << 24 | static_cast<uint32_t>(pTables->sbox[temp >> 16 & 0xFF]) << 16
+                    | static_cast<uint32_t>(pTables->sbox[temp >> 8 & 0xFF]) << 8 | pTables->sbox[temp & 0xFF];
+                temp ^= static_cast<uint32_t>(rcon) << 24;
+                rcon = static_cast<uint8_t>(rcon << 1 ^ (rcon & 0x80 ? 0x1B : 0));
+            }
+            else if (i % 8 == 4) {
+                temp = static_cast<uint32_t>(pTables->sbox[temp >> 24]) << 24 | static_cast<uint32_t>(pTables->sbox[temp >> 16 & 0xFF]) << 16
+                    | static_cast<uint32_t>(pTables->sbox[temp >> 8 & 0xFF]) << 8 | pTables->sbox[temp & 0xFF];
+            }
+
+            rk[i] = rk[i - 8] ^ temp;
+        }
+
+        pContext->isAccelerated = isAccelerated && isAccelerationSupported();
+
+        const uint8_t zero[0x10]{};
+        encryptBlock(pContext, zero, pContext->h);
+
+        // tables of the multiples of the hash subkey for the 4 bit GHASH
+        uint64_t vh = static_cast<uint64_t>(load32(pContext->h)) << 32 | load32(pContext->h + 4);
+        uint64_t vl = static_cast<uint64_t>(load32(pContext->h + 8)) << 32 | load32(pContext->h + 12);
+        pContext->hl[0] = 0;
+        pContext->hh[0] = 0;
+        pContext->hl[8] = vl;
+        pContext->hh[8] = vh;
+
+        for (int i = 4; i > 0; i >>= 1) {
+            const uint64_t t = (vl & 1) * 0xE1000000u;
+            vl = vh << 63 | vl >> 1;
+            vh = vh >> 1 ^ t << 32;
+            pContext->hl[i] = vl;
+            pContext->hh[i] = vh;
+        }
+
+        for (int i = 2; i <= 8; i *= 2) {
+
+            for (int j = 1; j < i; j++) {
+                pContext->hh[i + j] = pContext->hh[i] ^ pContext->hh[j];
+                pContext->hl[i + j] = pContext->hl[i] ^ pContext->hl[j];
+            }
+
+        }
+
+        return;
+    }
+
+
+    void encrypt(const Context* pContext, const uint8_t* nonce, const uint8_t* aad, size_t aadSize, const uint8_t* in, uint8_t* out, size_t size, uint8_t* tag) {
+        ctr(pContext, nonce, in, out, size);
+        computeTag(pContext, nonce, aad, aadSize, out, size, tag);
+
+        return;
+    }
+
+
+    bool decrypt(const Context* pContext, const uint8_t* nonce, const uint8_t* aad, size_t aadSize, const uint8_t* in, uint8_t* out, size_t size, const uint8_t* tag) {
+        uint8_t expectedTag[0x10]{};
+        computeTag(pContext, nonce, aad, aadSize, in, size, expectedTag);
+
+        // constant time comparison
+        uint8_t diff = 0;
+
+        for (int i = 0; i < 0x10; i++) {
+            diff |= expectedTag[i] ^ tag[i];
+        }
+
+        if (diff) {
+            memset(out, 0, size);
+
+            return false;
+        }
+
+        ctr(pContext, nonce, in, out, size);
+
+        return true;
+    }
+
+
+    bool selfTest() {
+        const bool isAccelerated = isAccelerationSupported();
+
+        for (const TestVector& vector : testVectors) {
+
+            if (!testVector(&vector, false)) {
+
+                return false;
+            }
+
+            if (isAccelerated && !testVector(&vector, true)) {
+
+                return false;
+            }
+
+        }
+
+        return !isAccelerated || compareImplementations();
+    }
+
+
+    static const Tables* getTables() {
+        static const Tables tables = [] {
+            Tables t{};
+            uint8_t powers[0x100]{};
+            uint8_t logs[0x100]{};
+            uint8_t x = 1;
+
+            // powers of the generator 3 of the multiplicative group of GF(2^8)
+            for (int i = 0; i < 0xFF; i++) {
+                powers[i] = x;
+                logs[x] = static_cast<uint8_t>(i);
+                x ^= static_cast<uint8_t>(x << 1 ^ (x & 0x80 ? 0x1B : 0));
+            }
+
+            for (int i = 0; i < 0x100; i++) {
+                const uint8_t inverse = i ? powers[(0xFF - logs[i]) % 0xFF] : 0;
+                uint8_t s = inverse;
+
+                // affine transformation
+                for (int j = 1; j < 5; j++) {
+                    s ^= static_cast<uint8_t>(inverse << j | inverse >> (8 - j));
+                }
+
+                s ^= 0x63;
+                t.sbox[i] = s;
+                const uint8_t s2 = static_cast<uint8_t>(s << 1 ^ (s & 0x80 ? 0x1B : 0));
+                const uint32_t word = static_cast<uint32_t>(s2) << 24 | static_cast<uint32_t>(s) << 16 | static_cast<uint32_t>(s) << 8 | static_cast<uint8_t>(s2 ^ s);
+
+                for (int j = 0; j < 4; j++) {
+                    t.te[j][i] = j ? word >> 8 * j | word << (32 - 8 * j) : word;
+                }
+
+            }
+
+            return t;
+        }();
+
+        return &tables;
+    }
+
+
+    static void encryptBlock(const Context* pContext, const uint8_t* in, uint8_t* out) {
+        const Tables* const pTables = getTables();
+        const uint32_t* rk = pContext->roundKeys;
+        const uint32_t(*te)[0x100] = pTables->te;
+        uint32_t s0 = load32(in) ^ rk[0];
+        uint32_t s1 = load32(in + 4) ^ rk[1];
+        uint32_t s2 = load32(in + 8) ^ rk[2];
+        uint32_t s3 = load32(in + 12) ^ rk[3];
+
+        for (int round = 1; round < 14; round++) {
+            rk += 4;
+            const uint32_t t0 = te[0][s0 >> 24] ^ te[1][s1 >> 16 & 0xFF] ^ te[2][s2 >> 8 & 0xFF] ^ te[3][s3 & 0xFF] ^ rk[0];
+            const uint32_t t1 = te[0][s1 >> 24] ^ te[1][s2 >> 16 & 0xFF] ^ te[2][s3 >> 8 & 0xFF] ^ te[3][s0 & 0xFF] ^ rk[1];
+            const uint32_t t2 = te[0][s2 >> 24] ^ te[1][s3 >> 16 & 0xFF] ^ te[2][s0 >> 8 & 0xFF] ^ te[3][s1 & 0xFF] ^ rk[2];
+            const uint32_t t3 = te[0][s3 >> 24] ^ te[1][s0 >> 16 & 0xFF] ^ te[2][s1 >> 8 & 0xFF] ^ te[3][s2 & 0xFF] ^ rk[3];
+            s0 = t0;
+            s1 = t1;
+            s2 = t2;
+            s3 = t3;
+        }
+
+        rk += 4;
+        const uint8_t* const sbox = pTables->sbox;
+        store32(out, (static_cast<uint32_t>(sbox[s0 >> 24]) << 24 | static_cast<uint32_t>(sbox[s1 >> 16 & 0xFF]) << 16 | static_cast<uint32_t>(sbox[s2 >> 8 & 0xFF]) << 8 | sbox[s3 & 0xFF]) ^ rk[0]);
+        store32(out + 4, (static_cast<uint32_t>(sbox[s1 >> 24]) << 24 | static_cast<uint32_t>(sbox[s2 >> 16 & 0xFF]) << 16 | static_cast<uint32_t>(sbox[s3 >> 8 & 0xFF]) << 8 | sbox[s0 & 0xFF]) ^ rk[1]);
+        store32(out + 8, (static_cast<uint32_t>(sbox[s2 >> 24]) << 24 | static_cast<uint32_t>(sbox[s3 >> 16 & 0xFF]) << 16 | static_cast<uint32_t>(sbox[s0 >> 8 & 0xFF]) << 8 | sbox[s1 & 0xFF]) ^ rk[2]);
+        store32(out + 12, (static_cast<uint32_t>(sbox[s3 >> 24]) << 24 | static_cast<uint32_t>(sbox[s0 >> 16 & 0xFF]) << 16 | static_cast<uint32_t>(sbox[s1 >> 8 & 0xFF]) << 8 | sbox[s2 & 0xFF]) ^ rk[3]);
+
+        return;
+    }
+
+
+    // Encrypts or decrypts data in counter mode starting with the counter block after the pre-counter block.
+    static void ctr(const Context* pContext, const uint8_t* nonce, const uint8_t* in, uint8_t* out, size_t size) {
+#ifdef GCM_X86
+        if (pContext->isAccelerated) {
+            ctrAccelerated(pContext, nonce, in, out, size);
+
+            return;
+        }
+#endif
+        uint8_t counterBlock[0x10]{};
+        uint8_t keyStream[0x10]{};
+        memcpy(counterBlock, nonce, 0xC);
+        uint32_t counter = 2;
+
+        for (size_t offset = 0; offset < size; offset += 0x10) {
+            store32(counterBlock + 0xC, counter++);
+            encryptBlock(pContext, counterBlock, keyStream);
+            const size_t blockSize = size - offset < 0x10 ? size - offset : 0x10;
+
+            for (size_t i = 0; i < blockSize; i++) {
+                out[offset + i] = in[offset + i] ^ keyStream[i];
+            }
+
+        }
+
+        return;
+    }
+
+
+    static void computeTag(const Context* pContext, const uint8_t* nonce, const uint8_t* aad, size_t aadSize, const uint8_t* cipher, size_t size, uint8_t* tag) {
+        uint8_t y[0x10]{};
+        ghash(pContext, y, aad, aadSize);
+        ghash(pContext, y, cipher, size);
+
+        // bit lengths of the additional data and the cipher text
+        uint8_t lengths[0x10]{};
+        const uint64_t aadBits = static_cast<uint64_t>(aadSize) * 8;
+        const uint64_t cipherBits = static_cast<uint64_t>(size) * 8;
+        store32(lengths, static_cast<uint32_t>(aadBits >> 32));
+        store32(lengths + 4, static_cast<uint32_t>(aadBits));
+        store32(lengths + 8, static_cast<uint32_t>(cipherBits >> 32));
+        store32(lengths + 12, static_cast<uint32_t>(cipherBits));
+        ghash(pContext, y, lengths, sizeof(lengths));
+
+        uint8_t preCounterBlock[0x10]{};
+        memcpy(preCounterBlock, nonce, 0xC);
+        preCounterBlock[0xF] = 1;
+        encryptBlock(pContext, preCounterBlock, tag);
+
+        for (int i = 0; i < 0x10; i++) {
+            tag[i] ^= y[i];
+        }
+
+        return;
+    }
+
+
+    // Hashes data into y. The last partial block is padded with zeros.
+    static void ghash(const Context* pContext, uint8_t* y, const uint8_t* data, size_t size) {
+#ifdef GCM_X86
+        if (pContext->isAccelerated) {
+            ghashAccelerated(pContext, y, data, size);
+
+            return;
+        }
+#endif
+        for (size_t offset = 0; offset < size; offset += 0x10) {
+            const size_t blockSize = size - offset < 0x10 ? size - offset : 0x10;
+
+            for (size_t i = 0; i < blockSize; i++) {
+                y[i] ^= data[offset + i];
+            }
+
+            multiplyH(pContext, y);
+        }
+
+        return;
+    }
+
+
+    // Multiplies x by the hash subkey with 4 bit tables.
+    static void multiplyH(const Context* pContext, uint8_t* x) {
+        uint8_t lo = x[0xF] & 0xF;
+        uint64_t zh = pContext->hh[lo];
+        uint64_t zl = pContext->hl[lo];
+
+        for (int i = 0xF; i >= 0; i--) {
+            lo = x[i] & 0xF;
+            const uint8_t hi = x[i] >> 4 & 0xF;
+            uint8_t rem = 0;
+
+            if (i != 0xF) {
+                rem = static_cast<uint8_t>(zl & 0xF);
+                zl = zh << 60 | zl >> 4;
+                zh = zh >> 4 ^ last4[rem] << 48;
+                zh ^= pContext->hh[lo];
+                zl ^= pContext->hl[lo];
+            }
+
+            rem = static_cast<uint8_t>(zl & 0xF);
+            zl = zh << 60 | zl >> 4;
+            zh = zh >> 4 ^ last4[rem] << 48;
+            zh ^= pContext->hh[hi];
+            zl ^= pContext->hl[hi];
+        }
+
+        store32(x, static_cast<uint32_t>(zh >> 32));
+        store32(x + 4, static_cast<uint32_t>(zh));
+        store32(x + 8, static_cast<uint32_t>(zl >> 32));
+        store32(x + 12, static_cast<uint32_t>(zl));
+
+        return;
+    }
+
+
+    static uint32_t load32(const uint8_t* p) {
+
+        return static_cast<uint32_t>(p[0]) << 24 | static_cast<uint32_t>(p[1]) << 16 | static_cast<uint32_t>(p[2]) << 8 | p[3];
+    }
+
+
+    static void store32(uint8_t* p, uint32_t value) {
+        p[0] = static_cast<uint8_t>(value >> 24);
+        p[1] = static_cast<uint8_t>(value >> 16);
+        p[2] = static_cast<uint8_t>(value >> 8);
+        p[3] = static_cast<uint8_t>(value);
+
+        return;
+    }
+
+
+    static std::vector<uint8_t> fromHex(const char* hex) {
+        std::vector<uint8_t> bytes;
+
+        for (size_t i = 0; hex[i] && hex[i + 1]; i += 2) {
+            bytes.push_back(static_cast<uint8_t>(std::stoul(std::string(hex + i, 2), nullptr, 0x10)));
+        }
+
+        return bytes;
+    }
+
+
+    static bool testVector(const TestVector* pVector, bool isAccelerated) {
+        const std::vector<uint8_t> key = fromHex(pVector->key);
+        const std::vector<uint8_t> nonce = fromHex(pVector->nonce);
+        const std::vector<uint8_t> plain = fromHex(pVector->plain);
+        const std::vector<uint8_t> aad = fromHex(pVector->aad);
+        const std::vector<uint8_t> cipher = fromHex(pVector->cipher);
+        const std::vector<uint8_t> tag = fromHex(pVector->tag);
+
+        Context context{};
+        init(&context, key.data(), isAccelerated);
+
+        std::vector<uint8_t> out(plain.size());
+        uint8_t outTag[0x10]{};
+        encrypt(&context, nonce.data(), aad.data(), aad.size(), plain.data(), out.data(), plain.size(), outTag);
+
+        if (out != cipher || memcmp(outTag, tag.data(), sizeof(outTag))) {
+
+            return false;
+        }
+
+        if (!decrypt(&context, nonce.data(), aad.data(), aad.size(), cipher.data(), out.data(), cipher.size(), tag.data()) || out != plain) {
+
+            return false;
+        }
+
+        // a modified tag has to be rejected
+        outTag[0] ^= 1;
+
+        return !decrypt(&context, nonce.data(), aad.data(), aad.size(), cipher.data(), out.data(), cipher.size(), outTag);
+    }
+
+
+    // Encrypts data of every length up to a few blocks with both implementations, so tails and the parallel path are covered.
+    static bool compareImplementations() {
+        uint8_t key[0x20]{};
+        uint8_t nonce[0xC]{};
+        std::vector<uint8_t> data(0x123);
+
+        for (size_t i = 0; i < sizeof(key); i++) {
+            key[i] = static_cast<uint8_t>(i * 7 + 1);
+        }
+
+        for (size_t i = 0; i < data.size(); i++) {
+            data[i] = static_cast<uint8_t>(i * 13 + 5);
+        }
+
+        Context software{};
+        Context accelerated{};
+        init(&software, key, false);
+        init(&accelerated, key, true);
+        std::vector<uint8_t> softwareOut(data.size());
+        std::vector<uint8_t> acceleratedOut(data.size());
+
+        for (size_t size = 0; size <= data.size(); size++) {
+            uint8_t softwareTag[0x10]{};
+            uint8_t acceleratedTag[0x10]{};
+            nonce[0] = static_cast<uint8_t>(size);
+            const size_t aadSize = size % 0x15;
+            encrypt(&software, nonce, data.data(), aadSize, data.data(), softwareOut.data(), size, softwareTag);
+            encrypt(&accelerated, nonce, data.data(), aadSize, data.data(), acceleratedOut.data(), size, acceleratedTag);
+
+            if (memcmp(softwareOut.data(), acceleratedOut.data(), size) || memcmp(softwareTag, acceleratedTag, sizeof(softwareTag))) {
+
+                return false;
+            }
+
+        }
+
+        return true;
+    }
+
+#ifdef GCM_X86
+
+    // Multiplies two byte reflected elements of GF(2^128) (Intel carry-less multiplication white paper).
+    GCM_TARGET static __m128i gfmul(__m128i a, __m128i b) {
+        __m128i t3 = _mm_clmulepi64_si128(a, b, 0x00);
+        __m128i t4 = _mm_clmulepi64_si128(a, b, 0x10);
+        __m128i t5 = _mm_clmulepi64_si128(a, b, 0x01);
+        __m128i t6 = _mm_clmulepi64_si128(a, b, 0x11);
+
+        t4 = _mm_xor_si128(t4, t5);
+        t5 = _mm_slli_si128(t4, 8);
+        t4 = _mm_srli_si128(t4, 8);
+        t3 = _mm_xor_si128(t3, t5);
+        t6 = _mm_xor_si128(t6, t4);
+
+        // shift the product left by one bit, since the operands are reflected
+        __m128i t7 = _mm_srli_epi32(t3, 31);
+        __m128i t8 = _mm_srli_epi32(t6, 31);
+        t3 = _mm_slli_epi32(t3, 1);
+        t6 = _mm_slli_epi32(t6, 1);
+        __m128i t9 = _mm_srli_si128(t7, 12);
+        t8 = _mm_slli_si128(t8, 4);
+        t7 = _mm_slli_si128(t7, 4);
+        t3 = _mm_or_si128(t3, t7);
+        t6 = _mm_or_si128(t6, t8);
+        t6 = _mm_or_si128(t6, t9);
+
+        // reduce modulo x^128 + x^7 + x^2 + x + 1
+        t7 = _mm_slli_epi32(t3, 31);
+        t8 = _mm_slli_epi32(t3, 30);
+        t9 = _mm_slli_epi32(t3, 25);
+        t7 = _mm_xor_si128(t7, t8);
+        t7 = _mm_xor_si128(t7, t9);
+        t8 = _mm_srli_si128(t7, 4);
+        t7 = _mm_slli_si128(t7, 12);
+        t3 = _mm_xor_si128(t3, t7);
+
+        __m128i t2 = _mm_srli_epi32(t3, 1);
+        t4 = _mm_srli_epi32(t3, 2);
+        t5 = _mm_srli_epi32(t3, 7);
+        t2 = _mm_xor_si128(t2, t4);
+        t2 = _mm_xor_si128(t2, t5);
+        t2 = _mm_xor_si128(t2, t8);
+        t3 = _mm_xor_si128(t3, t2);
+
+        return _mm_xor_si128(t6, t3);
+    }
+
+
+    GCM_TARGET static void loadRoundKeys(const Context* pContext, __m128i* roundKeys) {
+        uint8_t bytes[0x10]{};
+
+        for (int round = 0; round < 15; round++) {
+
+            for (int i = 0; i < 4; i++) {
+                store32(bytes + 4 * i, pContext->roundKeys[4 * round + i]);
+            }
+
+            roundKeys[round] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes));
+        }
+
+        return;
+    }
+
+
+    // Encrypts four counter blocks at once, so the latency of the AES instructions overlaps.
+    GCM_TARGET static void ctrAccelerated(const Context* pContext, const uint8_t* nonce, const uint8_t* in, uint8_t* out, size_t size) {
+        __m128i roundKeys[15];
+        loadRoundKeys(pContext, roundKeys);
+        uint8_t counterBlocks[4][0x10]{};
+
+        for (int i = 0; i < 4; i++) {
+            memcpy(counterBlocks[i], nonce, 0xC);
+        }
+
+        uint32_t counter = 2;
+        size_t offset = 0;
+
+        while (offset < size) {
+            __m128i blocks[4];
+
+            for (int i = 0; i < 4; i++) {
+                store32(counterBlocks[i] + 0xC, counter + i);
+                blocks[i] = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(counterBlocks[i])), roundKeys[0]);
+            }
+
+            counter += 4;
+
+            for (int round = 1; round < 14; round++) {
+
+                for (int i = 0; i < 4; i++) {
+                    blocks[i] = _mm_aesenc_si128(blocks[i], roundKeys[round]);
+                }
+
+            }
+
+            for (int i = 0; i < 4 && offset < size; i++) {
+                const __m128i keyStream = _mm_aesenclast_si128(blocks[i], roundKeys[14]);
+
+                if (size - offset >= 0x10) {
+                    const __m128i data = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + offset));
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + offset), _mm_xor_si128(data, keyStream));
+                    offset += 0x10;
+                }
+                else {
+                    uint8_t bytes[0x10]{};
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(bytes), keyStream);
+
+                    for (size_t j = 0; offset < size; j++, offset++) {
+                        out[offset] = in[offset] ^ bytes[j];
+                    }
+
+                }
+
+            }
+
+        }
+
+        return;
+    }
+
+
+    GCM_TARGET static void ghashAccelerated(const Context* pContext, uint8_t* y, const uint8_t* data, size_t size) {
+        const __m128i reverse = _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+        const __m128i h = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pContext->h)), reverse);
+        __m128i x = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(y)), reverse);
+        size_t offset = 0;
+
+        if (size >= 0x40) {
+            // four independent multiplications by the powers of the hash subkey instead of a serial chain
+            const __m128i h2 = gfmul(h, h);
+            const __m128i h3 = gfmul(h2, h);
+            const __m128i h4 = gfmul(h3, h);
+
+            for (; size - offset >= 0x40; offset += 0x40) {
+                const __m128i* const pBlocks = reinterpret_cast<const __m128i*>(data + offset);
+                const __m128i b0 = _mm_xor_si128(x, _mm_shuffle_epi8(_mm_loadu_si128(pBlocks), reverse));
+                const __m128i b1 = _mm_shuffle_epi8(_mm_loadu_si128(pBlocks + 1), reverse);
+                const __m128i b2 = _mm_shuffle_epi8(_mm_loadu_si128(pBlocks + 2), reverse);
+                const __m128i b3 = _mm_shuffle_epi8(_mm_loadu_si128(pBlocks + 3), reverse);
+                x = _mm_xor_si128(_mm_xor_si128(gfmul(b0, h4), gfmul(b1, h3)), _mm_xor_si128(gfmul(b2, h2), gfmul(b3, h)));
+            }
+
+        }
+
+        for (; size - offset >= 0x10; offset += 0x10) {
+            const __m128i block = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + offset)), reverse);
+            x = gfmul(_mm_xor_si128(x, block), h);
+        }
+
+        if (offset < size) {
+            uint8_t bytes[0x10]{};
+            memcpy(bytes, data + offset, size - offset);
+            const __m128i block = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes)), reverse);
+            x = gfmul(_mm_xor_si128(x, block), h);
+        }
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(y), _mm_shuffle_epi8(x, reverse));
+
+        return;
+    }
+
+#endif
+
+}
\ No newline at end of file
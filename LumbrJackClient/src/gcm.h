@@ -0,0 +1,108 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// AES-256-GCM for decrypting log files encrypted by the driver (see cipher.h).
+// Uses AES-NI and PCLMULQDQ if the processor supports them and a table based implementation otherwise.
+// Does not depend on Windows headers, so log files can be decrypted on any platform.
+namespace gcm {
+
+	// Expanded key and hash subkey of a session.
+	struct Context {
+		uint32_t roundKeys[60];
+		uint8_t h[0x10];
+		// Multiples of the hash subkey for the table based GHASH.
+		uint64_t hl[0x10];
+		uint64_t hh[0x10];
+		bool isAccelerated;
+	};
+
+	// Checks if the processor supports AES-NI, PCLMULQDQ and SSSE3.
+	//
+	// Return:
+	// True if the accelerated implementation can be used.
+	bool isAccelerationSupported();
+
+	// Expands a key.
+	//
+	// Parameters:
+	//
+	// [out] pContext:
+	// Context to initialize.
+	//
+	// [in] key:
+	// AES-256 key of 32 bytes.
+	//
+	// [in] isAccelerated:
+	// Selects the accelerated implementation. Ignored if the processor does not support it.
+	void init(Context* pContext, const uint8_t* key, bool isAccelerated);
+
+	// Encrypts data and computes its authentication tag.
+	//
+	// Parameters:
+	//
+	// [in] pContext:
+	// Initialized context.
+	//
+	// [in] nonce:
+	// Nonce of 12 bytes.
+	//
+	// [in] aad:
+	// Additional data that is authenticated but not encrypted.
+	//
+	// [in] aadSize:
+	// Size of the additional data.
+	//
+	// [in] in:
+	// Data to encrypt.
+	//
+	// [out] out:
+	// Buffer that receives the encrypted data. Can be equal to in.
+	//
+	// [in] size:
+	// Size of the data.
+	//
+	// [out] tag:
+	// Buffer that receives the tag of 16 bytes.
+	void encrypt(const Context* pContext, const uint8_t* nonce, const uint8_t* aad, size_t aadSize, const uint8_t* in, uint8_t* out, size_t size, uint8_t* tag);
+
+	// Verifies the authentication tag of data and decrypts it.
+	//
+	// Parameters:
+	//
+	// [in] pContext:
+	// Initialized context.
+	//
+	// [in] nonce:
+	// Nonce of 12 bytes.
+	//
+	// [in] aad:
+	// Additional data that is authenticated but not encrypted.
+	//
+	// [in] aadSize:
+	// Size of the additional data.
+	//
+	// [in] in:
+	// Data to decrypt.
+	//
+	// [out] out:
+	// Buffer that receives the decrypted data. Can be equal to in. Zeroed if the tag does not match.
+	//
+	// [in] size:
+	// Size of the data.
+	//
+	// [in] tag:
+	// Expected tag of 16 bytes.
+	//
+	// Return:
+	// True if the tag matches, false otherwise.
+	bool decrypt(const Context* pContext, const uint8_t* nonce, const uint8_t* aad, size_t aadSize, const uint8_t* in, uint8_t* out, size_t size, const uint8_t* tag);
+
+	// Runs known answer tests of the GCM specification with every implementation the processor supports
+	// and compares the implementations on data of varying length.
+	//
+	// Return:
+	// True if all tests passed, false otherwise.
+	bool selfTest();
+
+}
\ No newline at end of file
@@ -2,6 +2,7 @@
 #include <unordered_map>
 #include <string>
 #include <iostream>
+#include <iomanip>
 
 namespace io {
     
@@ -14,11 +15,20 @@ namespace io {
     { action::LOG_STATE, "Get loggin state"},
     { action::LOG_START, "Start logging"},
     { action::LOG_STOP, "Stop logging"},
+    { action::LIST_SOURCES, "List sources"},
+    { action::TOGGLE_SOURCE, "Enable/disable source"},
+    { action::READ_TRACE, "Read trace"},
+    { action::INJECT_INPUT, "Inject test input"},
     { action::EXIT, "Exit"}
     };
 
 
     static std::string getActionString(action act, bool isSelected);
+    static bool isOption(const std::string& option, const std::string& name);
+    static bool parseOptionValue(const std::string& option, const std::string& name, ULONG* pValue);
+    static bool parseKeys(const std::string& strKeys, FilterConfig* pFilterConfig);
+    static bool parseButtons(const std::string& strButtons, USHORT* pButtonMask);
+    static bool parseTraceCategories(const std::string& strCategories, ULONG* pCategories);
 
     void printMenu(action select, DWORD driverState) {
 
@@ -59,6 +69,156 @@ namespace io {
     }
 
 
+    void printSources(const SourceList* pSourceList) {
+
+        for (ULONG i = 0; i < pSourceList->count && i < MAX_SOURCES; i++) {
+            const SourceInfo* const pSourceInfo = &pSourceList->sources[i];
+            const char* strType = "Injected";
+
+            if (pSourceInfo->type == FILE_DEVICE_KEYBOARD) {
+                strType = "Keyboard";
+            }
+            else if (pSourceInfo->type == FILE_DEVICE_MOUSE) {
+                strType = "Mouse";
+            }
+
+            const char* const strState = pSourceInfo->isEnabled ? "enabled" : "disabled";
+
+            std::cout << std::setw(4) << pSourceInfo->id << "  " << strType << " (" << strState << ") ";
+            std::wcout << pSourceInfo->name << std::endl;
+        }
+
+        if (!pSourceList->count) {
+            std::cout << "No sources." << std::endl;
+        }
+
+        std::cout << std::endl;
+
+        return;
+    }
+
+
+    bool selectSource(USHORT* pId) {
+        std::cout << "Source ID: ";
+        std::string strInput;
+        std::getline(std::cin, strInput);
+
+        if (strInput == "" || strInput.length() > 4 || strInput.find_first_not_of("1234567890") != std::string::npos) {
+
+            return false;
+        }
+
+        *pId = static_cast<USHORT>(std::stoul(strInput));
+
+        return true;
+    }
+
+
+    bool parseOptions(int argc, char* argv[], options* pOptions) {
+        *pOptions = options{};
+        LogConfig* const pLogConfig = &pOptions->logConfig;
+        FilterConfig* const pFilterConfig = &pOptions->filterConfig;
+        TraceConfig* const pTraceConfig = &pOptions->traceConfig;
+        InjectConfig* const pInjectConfig = &pOptions->injectConfig;
+        // errors are traced by default
+        pTraceConfig->level = TRACE_ERROR;
+        pTraceConfig->categories = TRACE_CAT_ALL;
+        // a short burst of both input types as fast as possible by default
+        pInjectConfig->kbdCount = 10000;
+        pInjectConfig->mouCount = 10000;
+
+        for (int i = 0; i < argc; i++) {
+            const std::string option = argv[i];
+            bool isValid = true;
+
+            if (option == "--unified") {
+                pLogConfig->flags |= LOG_FLAG_UNIFIED;
+            }
+            else if (option == "--binary") {
+                pLogConfig->flags |= LOG_FLAG_BINARY;
+            }
+            else if (option == "--compress") {
+                pLogConfig->flags |= LOG_FLAG_COMPRESS;
+            }
+            else if (option == "--raw") {
+                pLogConfig->flags |= LOG_FLAG_RAW;
+            }
+            else if (option.compare(0, 10, "--encrypt=") == 0 && option.length() > 10) {
+                pLogConfig->flags |= LOG_FLAG_ENCRYPT;
+                pOptions->keyPath = option.substr(10);
+            }
+            else if (option == "--compact") {
+                pLogConfig->flags |= LOG_FLAG_COMPACT;
+            }
+            else if (isOption(option, "--aggregate")) {
+                pLogConfig->flags |= LOG_FLAG_AGGREGATE;
+                isValid = parseOptionValue(option, "--aggregate", &pLogConfig->aggregateInterval);
+            }
+            else if (isOption(option, "--motion")) {
+                pLogConfig->flags |= LOG_FLAG_MOTION;
+                isValid = parseOptionValue(option, "--motion", &pLogConfig->motionRate);
+            }
+            else if (option.compare(0, 7, "--keys=") == 0) {
+                pFilterConfig->flags |= FILTER_FLAG_SCAN_CODES;
+                isValid = parseKeys(option.substr(7), pFilterConfig);
+            }
+            else if (option == "--no-make") {
+                pFilterConfig->flags |= FILTER_FLAG_NO_MAKE;
+            }
+            else if (option == "--no-break") {
+                pFilterConfig->flags |= FILTER_FLAG_NO_BREAK;
+            }
+            else if (option.compare(0, 10, "--buttons=") == 0) {
+                pFilterConfig->flags |= FILTER_FLAG_BUTTONS;
+                isValid = parseButtons(option.substr(10), &pFilterConfig->buttonMask);
+            }
+            else if (option == "--no-movement") {
+                pFilterConfig->flags |= FILTER_FLAG_NO_MOVEMENT;
+            }
+            else if (isOption(option, "--kbd-rate")) {
+                isValid = option.length() > 10 && parseOptionValue(option, "--kbd-rate", &pFilterConfig->kbdRate);
+            }
+            else if (isOption(option, "--mou-rate")) {
+                isValid = option.length() > 10 && parseOptionValue(option, "--mou-rate", &pFilterConfig->mouRate);
+            }
+            else if (isOption(option, "--trace")) {
+                pTraceConfig->level = TRACE_VERBOSE;
+                isValid = parseOptionValue(option, "--trace", &pTraceConfig->level) && pTraceConfig->level < TRACE_LEVEL_MAX;
+            }
+            else if (option.compare(0, 19, "--trace-categories=") == 0) {
+                pTraceConfig->categories = 0;
+                isValid = parseTraceCategories(option.substr(19), &pTraceConfig->categories);
+            }
+            else if (isOption(option, "--inject-kbd")) {
+                isValid = option.length() > 12 && parseOptionValue(option, "--inject-kbd", &pInjectConfig->kbdCount);
+            }
+            else if (isOption(option, "--inject-mou")) {
+                isValid = option.length() > 12 && parseOptionValue(option, "--inject-mou", &pInjectConfig->mouCount);
+            }
+            else if (isOption(option, "--inject-rate")) {
+                isValid = option.length() > 13 && parseOptionValue(option, "--inject-rate", &pInjectConfig->rate);
+            }
+            else if (isOption(option, "--inject-batch")) {
+                isValid = option.length() > 14 && parseOptionValue(option, "--inject-batch", &pInjectConfig->batch) && pInjectConfig->batch <= INJECT_MAX_BATCH;
+            }
+            else {
+                std::cout << "Unknown option: " << option << std::endl;
+
+                return false;
+            }
+
+            if (!isValid) {
+                std::cout << "Invalid value: " << option << std::endl;
+
+                return false;
+            }
+
+        }
+
+        return true;
+    }
+
+
     static std::string getActionString(action act, bool isSelected) {
         std::string strNum = std::to_string(act);
         std::string preSpace(4 - strNum.length(), ' ');
@@ -72,4 +232,131 @@ namespace io {
         return actionString;
     }
 
+
+    static bool isOption(const std::string& option, const std::string& name) {
+
+        return option.compare(0, name.length(), name) == 0 && (option.length() == name.length() || option[name.length()] == '=');
+    }
+
+
+    static bool parseOptionValue(const std::string& option, const std::string& name, ULONG* pValue) {
+
+        // the value is optional: "--name" or "--name=1234"
+        if (option.length() == name.length()) return true;
+
+        const std::string strValue = option.substr(name.length() + 1);
+
+        if (strValue == "" || strValue.find_first_not_of("1234567890") != std::string::npos) return false;
+
+        *pValue = std::stoul(strValue);
+
+        return true;
+    }
+
+
+    static bool parseKeys(const std::string& strKeys, FilterConfig* pFilterConfig) {
+        size_t pos = 0;
+
+        // comma separated list of make codes and inclusive ranges: "16-25,30"
+        while (pos <= strKeys.length()) {
+            size_t end = strKeys.find(',', pos);
+
+            if (end == std::string::npos) {
+                end = strKeys.length();
+            }
+
+            const std::string strKey = strKeys.substr(pos, end - pos);
+            const size_t dash = strKey.find('-');
+            const std::string strFirst = strKey.substr(0, dash);
+            const std::string strLast = dash == std::string::npos ? strFirst : strKey.substr(dash + 1);
+
+            if (strFirst == "" || strLast == "" || (strFirst + strLast).find_first_not_of("1234567890") != std::string::npos) return false;
+
+            const unsigned long first = std::stoul(strFirst);
+            const unsigned long last = std::stoul(strLast);
+
+            if (first > last || last >= sizeof(pFilterConfig->scanCodeSet) * 8) return false;
+
+            if (first == last) {
+                pFilterConfig->scanCodeSet[first / 8] |= static_cast<UCHAR>(1 << first % 8);
+            }
+            else {
+
+                if (pFilterConfig->rangeCount == FILTER_MAX_RANGES) return false;
+
+                pFilterConfig->ranges[pFilterConfig->rangeCount].first = static_cast<USHORT>(first);
+                pFilterConfig->ranges[pFilterConfig->rangeCount].last = static_cast<USHORT>(last);
+                pFilterConfig->rangeCount++;
+            }
+
+            pos = end + 1;
+        }
+
+        return true;
+    }
+
+
+    static bool parseButtons(const std::string& strButtons, USHORT* pButtonMask) {
+        // down and up flags of the buttons as in ntddmou.h
+        static const std::unordered_map<std::string, USHORT> buttonFlags{
+        { "left", 0x0001 | 0x0002 },
+        { "right", 0x0004 | 0x0008 },
+        { "middle", 0x0010 | 0x0020 },
+        { "x1", 0x0040 | 0x0080 },
+        { "x2", 0x0100 | 0x0200 },
+        { "wheel", 0x0400 },
+        { "hwheel", 0x0800 }
+        };
+
+        size_t pos = 0;
+
+        // comma separated list of buttons: "left,wheel"
+        while (pos <= strButtons.length()) {
+            size_t end = strButtons.find(',', pos);
+
+            if (end == std::string::npos) {
+                end = strButtons.length();
+            }
+
+            const auto iter = buttonFlags.find(strButtons.substr(pos, end - pos));
+
+            if (iter == buttonFlags.end()) return false;
+
+            *pButtonMask |= iter->second;
+            pos = end + 1;
+        }
+
+        return true;
+    }
+
+
+    static bool parseTraceCategories(const std::string& strCategories, ULONG* pCategories) {
+        static const std::unordered_map<std::string, ULONG> categoryFlags{
+        { "kbd", TRACE_CAT_KBD },
+        { "mou", TRACE_CAT_MOU },
+        { "queue", TRACE_CAT_QUEUE },
+        { "device", TRACE_CAT_DEVICE }
+        };
+
+        size_t pos = 0;
+
+        // comma separated list of categories: "kbd,queue"
+        while (pos <= strCategories.length()) {
+            size_t end = strCategories.find(',', pos);
+
+            if (end == std::string::npos) {
+                end = strCategories.length();
+            }
+
+            const auto iter = categoryFlags.find(strCategories.substr(pos, end - pos));
+
+            if (iter == categoryFlags.end()) return false;
+
+            *pCategories |= iter->second;
+            pos = end + 1;
+        }
+
+        return true;
+    }
+
 }
\ No newline at end of file
@@ -1,11 +1,24 @@
 #pragma once
+#include "..\..\LumbrJackDriver\src\ioctl.h"
 #include <Windows.h>
+#include <string>
 
 // Handles console output and user input.
 namespace io {
 
 	// Options for user selection.
-	enum action { EXIT = 0, INSTALL, START, STOP, UNINSTALL, LOG_STATE, LOG_START, LOG_STOP, MAX_ACTION };
+	enum action { EXIT = 0, INSTALL, START, STOP, UNINSTALL, LOG_STATE, LOG_START, LOG_STOP, LIST_SOURCES, TOGGLE_SOURCE, READ_TRACE, INJECT_INPUT, MAX_ACTION };
+
+	// Configurations sent to the driver when logging is started.
+	struct options {
+		LogConfig logConfig;
+		FilterConfig filterConfig;
+		TraceConfig traceConfig;
+		// Synthetic input injected into the running session by the menu entry "Inject test input".
+		InjectConfig injectConfig;
+		// File the key of an encrypted session is saved to.
+		std::string keyPath;
+	};
 
 	// Prints the menu.
 	// 
@@ -25,5 +38,41 @@ namespace io {
 	// [in/out] pAction:
 	// Action currently selected. Only overwritten for valid user input. For invalid input it keeps its value.
 	void selectAction(action* pAction);
+
+	// Prints the input sources of the driver.
+	// 
+	// Parameters:
+	// 
+	// [in] pSourceList:
+	// Sources to print.
+	void printSources(const SourceList* pSourceList);
+
+	// Lets the user select an input source.
+	// 
+	// Parameters:
+	// 
+	// [out] pId:
+	// Contains the ID of the selected source on return.
+	//
+	// Return:
+	// True for valid user input, false otherwise.
+	bool selectSource(USHORT* pId);
+
+	// Parses the options passed on the command line.
+	// 
+	// Parameters:
+	// 
+	// [in] argc:
+	// Number of options.
+	// 
+	// [in] argv:
+	// Array of options.
+	// 
+	// [out] pOptions:
+	// Contains the logging, filter, trace and injection configurations on return.
+	//
+	// Return:
+	// True on succcess, false if an option is unknown.
+	bool parseOptions(int argc, char* argv[], options* pOptions);
 }
 
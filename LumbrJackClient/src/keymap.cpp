@@ -0,0 +1,646 @@
+#include "keymap.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define KEYMAP_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define KEYMAP_TARGET_SSSE3
+#define KEYMAP_TARGET_AVX2
+#else
+#define KEYMAP_TARGET_SSSE3 __attribute__((target("ssse3")))
+#define KEYMAP_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+namespace keymap {
+
+    // Flags of keyboard records. Same values as the flags of KEYBOARD_INPUT_DATA.
+    constexpr uint16_t KEY_FLAG_BREAK = 0x1;
+    constexpr uint16_t KEY_FLAG_E0 = 0x2;
+    constexpr uint16_t KEY_FLAG_E1 = 0x4;
+
+    // Number of scan codes of the main block, up to and including the space bar.
+    constexpr size_t MAIN_KEYS = 0x3A;
+    // Scan code of the additional key next to the left shift key of ISO keyboards.
+    constexpr uint8_t ISO_KEY = 0x56;
+    // Scan codes of the numeric keypad from 7 to the decimal separator.
+    constexpr uint8_t NUMPAD_FIRST = 0x47;
+    constexpr uint8_t NUMPAD_LAST = 0x53;
+    // Levels of a layout: unshifted, shifted and AltGr.
+    constexpr size_t LEVELS = 3;
+    // Fast tables for every combination of shift, caps lock and AltGr and one for control or alt being held.
+    constexpr size_t FAST_TABLES = 9;
+    constexpr size_t SUPPRESSED_TABLE = 8;
+    // Value in the fast tables for scan codes the vector implementations can not translate.
+    constexpr uint8_t COMPLEX = 0xFF;
+    // Bytes beyond the last character the vector implementations may store.
+    constexpr size_t OUTPUT_SLACK = 8;
+
+    // Characters of a layout. The rows are indexed by scan code and contain MAIN_KEYS characters each.
+    struct LayoutDefinition {
+        const char16_t* base;
+        const char16_t* shift;
+        // Null for layouts without AltGr, on which the right alt key is a plain alt key.
+        const char16_t* altGr;
+        char16_t iso[LEVELS];
+        char16_t numpadDecimal;
+    };
+
+    // Lookup tables of a layout. Generated at compile time from its definition.
+    struct Tables {
+        char16_t chars[LEVELS][0x80];
+        // Keys caps lock applies to.
+        bool isCapsKey[0x80];
+        bool hasAltGr;
+        char16_t numpad[NUMPAD_LAST - NUMPAD_FIRST + 1];
+        // Characters below 0x80 per fast table and scan code, zero for keys without character or COMPLEX.
+        alignas(0x20) uint8_t fast[FAST_TABLES][0x80];
+    };
+
+    // Shuffle masks that move the bytes selected by an 8 bit mask to the front.
+    struct CompactTables {
+        uint8_t shuffle[0x100][8];
+        uint8_t count[0x100];
+    };
+
+    // Dead keys of the german layout are treated as plain characters.
+    static constexpr LayoutDefinition definitions[MAX_LAYOUT] = {
+        // US
+        {
+            u"\0\x1B" u"1234567890-=" u"\b\t" u"qwertyuiop[]" u"\n\0" u"asdfghjkl;'`" u"\0\\" u"zxcvbnm,./" u"\0*\0 ",
+            u"\0\x1B" u"!@#$%^&*()_+" u"\b\t" u"QWERTYUIOP{}" u"\n\0" u"ASDFGHJKL:\"~" u"\0|" u"ZXCVBNM<>?" u"\0*\0 ",
+            nullptr,
+            { u'\\', u'|', 0 },
+            u'.'
+        },
+        // UK
+        {
+            u"\0\x1B" u"1234567890-=" u"\b\t" u"qwertyuiop[]" u"\n\0" u"asdfghjkl;'`" u"\0#" u"zxcvbnm,./" u"\0*\0 ",
+            u"\0\x1B" u"!\"\u00A3$%^&*()_+" u"\b\t" u"QWERTYUIOP{}" u"\n\0" u"ASDFGHJKL:@\u00AC" u"\0~" u"ZXCVBNM<>?" u"\0*\0 ",
+            u"\0\0" u"\0\0\0\u20AC\0\0\0\0\0\0\0\0" u"\0\0" u"\0\0\0\0\0\0\0\0\0\0\0\0" u"\0\0" u"\0\0\0\0\0\0\0\0\0\0\0\u00A6" u"\0\0" u"\0\0\0\0\0\0\0\0\0\0" u"\0\0\0\0",
+            { u'\\', u'|', 0 },
+            u'.'
+        },
+        // DE
+        {
+            u"\0\x1B" u"1234567890\u00DF\u00B4" u"\b\t" u"qwertzuiop\u00FC+" u"\n\0" u"asdfghjkl\u00F6\u00E4^" u"\0#" u"yxcvbnm,.-" u"\0*\0 ",
+            u"\0\x1B" u"!\"\u00A7$%&/()=?`" u"\b\t" u"QWERTZUIOP\u00DC*" u"\n\0" u"ASDFGHJKL\u00D6\u00C4\u00B0" u"\0'" u"YXCVBNM;:_" u"\0*\0 ",
+            u"\0\0" u"\0\u00B2\u00B3\0\0\0{[]}\\\0" u"\0\0" u"@\0\u20AC\0\0\0\0\0\0\0\0~" u"\0\0" u"\0\0\0\0\0\0\0\0\0\0\0\0" u"\0\0" u"\0\0\0\0\0\0\u00B5\0\0\0" u"\0\0\0\0",
+            { u'<', u'>', u'|' },
+            u','
+        }
+    };
+
+    static constexpr bool isModifierKey(size_t key) {
+
+        return key == 0x1D || key == 0x2A || key == 0x36 || key == 0x38;
+    }
+
+
+    // Lock keys, modifiers and the numeric keypad change or depend on the modifier state.
+    static constexpr bool isComplexKey(size_t key) {
+
+        return isModifierKey(key) || key == 0x3A || key == 0x45 || (key >= NUMPAD_FIRST && key <= NUMPAD_LAST);
+    }
+
+
+    // Letters are keys whose shifted character is the upper case of the unshifted one.
+    static constexpr bool isLetter(char16_t base, char16_t shift) {
+
+        return ((base >= u'a' && base <= u'z') || (base >= 0xE0 && base <= 0xFE && base != 0xF7)) && shift == base - 0x20;
+    }
+
+
+    static constexpr Tables buildTables(const LayoutDefinition& definition) {
+        Tables tables{};
+
+        for (size_t key = 0; key < MAIN_KEYS; key++) {
+            tables.chars[0][key] = definition.base[key];
+            tables.chars[1][key] = definition.shift[key];
+            tables.chars[2][key] = definition.altGr ? definition.altGr[key] : 0;
+            tables.isCapsKey[key] = isLetter(definition.base[key], definition.shift[key]);
+        }
+
+        for (size_t level = 0; level < LEVELS; level++) {
+            tables.chars[level][ISO_KEY] = definition.iso[level];
+        }
+
+        tables.hasAltGr = definition.altGr != nullptr;
+        const char16_t numpad[] = u"789-456+1230";
+
+        for (size_t i = 0; i < sizeof(numpad) / sizeof(numpad[0]) - 1; i++) {
+            tables.numpad[i] = numpad[i];
+        }
+
+        tables.numpad[NUMPAD_LAST - NUMPAD_FIRST] = definition.numpadDecimal;
+
+        for (size_t table = 0; table < FAST_TABLES; table++) {
+            const bool isShift = (table & 1) != 0;
+            const bool isCapsLock = (table & 2) != 0;
+            const bool isAltGr = (table & 4) != 0;
+
+            for (size_t key = 0; key < 0x80; key++) {
+
+                if (isComplexKey(key)) {
+                    tables.fast[table][key] = COMPLEX;
+
+                    continue;
+                }
+
+                if (table == SUPPRESSED_TABLE) continue;
+
+                const size_t level = isAltGr ? 2 : isShift != (isCapsLock && tables.isCapsKey[key]) ? 1 : 0;
+                const char16_t ch = tables.chars[level][key];
+                tables.fast[table][key] = ch < 0x80 ? static_cast<uint8_t>(ch) : COMPLEX;
+            }
+
+        }
+
+        return tables;
+    }
+
+
+    static constexpr CompactTables buildCompactTables() {
+        CompactTables compactTables{};
+
+        for (size_t mask = 0; mask < 0x100; mask++) {
+            uint8_t count = 0;
+
+            for (uint8_t bit = 0; bit < 8; bit++) {
+
+                if (mask >> bit & 1) {
+                    compactTables.shuffle[mask][count++] = bit;
+                }
+
+            }
+
+            for (uint8_t i = count; i < 8; i++) {
+                compactTables.shuffle[mask][i] = 0x80;
+            }
+
+            compactTables.count[mask] = count;
+        }
+
+        return compactTables;
+    }
+
+
+    static constexpr Tables tables[MAX_LAYOUT] = { buildTables(definitions[US]), buildTables(definitions[UK]), buildTables(definitions[DE]) };
+    static constexpr CompactTables compactTables = buildCompactTables();
+
+    // Breaks of modifiers and prefixes. Breaks of other keys translate to nothing.
+    static constexpr uint8_t complexCodes[] = { 0x9D, 0xAA, 0xB6, 0xB8, 0xE0, 0xE1 };
+
+    static char* translateCode(const Tables* pTables, State* pState, uint8_t code, char* out);
+    static size_t getFastTable(const Tables* pTables, const State* pState);
+    static char* writeUtf8(char16_t ch, char* out);
+
+#ifdef KEYMAP_X86
+    KEYMAP_TARGET_SSSE3 static char* translateSsse3(const Tables* pTables, State* pState, const uint8_t* in, size_t size, char* out);
+    KEYMAP_TARGET_AVX2 static char* translateAvx2(const Tables* pTables, State* pState, const uint8_t* in, size_t size, char* out);
+    KEYMAP_TARGET_SSSE3 static char* compact(__m128i chars, uint32_t mask, char* out);
+    static uint32_t countTrailingZeros(uint32_t value);
+#endif
+
+    bool parseLayout(const std::string& name, layout* pLayout) {
+
+        if (name == "us") {
+            *pLayout = layout::US;
+        }
+        else if (name == "uk") {
+            *pLayout = layout::UK;
+        }
+        else if (name == "de") {
+            *pLayout = layout::DE;
+        }
+        else {
+
+            return false;
+        }
+
+        return true;
+    }
+
+
+    implementation getBestImplementation() {
+#ifdef KEYMAP_X86
+#ifdef _MSC_VER
+        int info[4]{};
+        __cpuid(info, 0);
+        const int maxLeaf = info[0];
+        __cpuid(info, 1);
+        const unsigned int ecx = static_cast<unsigned int>(info[2]);
+
+        if (!(ecx & 1u << 9)) {
+
+            return implementation::SCALAR;
+        }
+
+        // AVX2 also requires the operating system to save the upper halves of the registers
+        if (maxLeaf >= 7 && ecx & 1u << 27 && ecx & 1u << 28 && (_xgetbv(0) & 6) == 6) {
+            __cpuidex(info, 7, 0);
+
+            if (info[1] & 1 << 5) {
+
+                return implementation::AVX2;
+            }
+
+        }
+
+        return implementation::SSSE3;
+#else
+        __builtin_cpu_init();
+
+        if (__builtin_cpu_supports("avx2")) {
+
+            return implementation::AVX2;
+        }
+
+        if (__builtin_cpu_supports("ssse3")) {
+
+            return implementation::SSSE3;
+        }
+
+        return implementation::SCALAR;
+#endif
+#else
+
+        return implementation::SCALAR;
+#endif
+    }
+
+
+    void translate(layout lay, State* pState, const uint8_t* in, size_t size, std::string* pOut, implementation impl) {
+        const Tables* const pTables = &tables[lay];
+        const implementation best = getBestImplementation();
+        const size_t offset = pOut->size();
+        // every scan code results in at most three bytes
+        pOut->resize(offset + size * 3 + OUTPUT_SLACK);
+        char* const begin = &(*pOut)[0];
+        char* out = begin + offset;
+
+        if (impl > best) {
+            impl = best;
+        }
+
+        switch (impl) {
+#ifdef KEYMAP_X86
+        case implementation::AVX2:
+            out = translateAvx2(pTables, pState, in, size, out);
+            break;
+        case implementation::SSSE3:
+            out = translateSsse3(pTables, pState, in, size, out);
+            break;
+#endif
+        default:
+
+            for (size_t i = 0; i < size; i++) {
+                out = translateCode(pTables, pState, in[i], out);
+            }
+
+            break;
+        }
+
+        pOut->resize(static_cast<size_t>(out - begin));
+
+        return;
+    }
+
+
+    size_t fromRecord(const KbdRecord* pRecord, uint8_t* out) {
+
+        if (pRecord->makeCode > 0x7F) {
+
+            return 0;
+        }
+
+        const uint8_t prefix = pRecord->flags & KEY_FLAG_E0 ? 0xE0 : pRecord->flags & KEY_FLAG_E1 ? 0xE1 : 0;
+        const uint8_t code = static_cast<uint8_t>(pRecord->makeCode);
+        size_t size = 0;
+
+        if (prefix) {
+            out[size++] = prefix;
+        }
+
+        out[size++] = code | (pRecord->flags & KEY_FLAG_BREAK ? 0x80 : 0);
+
+        // pairs of older drivers are only marked by their hold time
+        const bool isPaired = pRecord->flags & RECORD_KBD_PAIRED || (pRecord->holdTime && !(pRecord->flags & KEY_FLAG_BREAK));
+
+        if (isPaired) {
+
+            if (prefix) {
+                out[size++] = prefix;
+            }
+
+            out[size++] = code | 0x80;
+        }
+
+        return size;
+    }
+
+
+    // Updates the state with a scan code and writes the character of the key if it has one.
+    static char* translateCode(const Tables* pTables, State* pState, uint8_t code, char* out) {
+
+        if (pState->skip) {
+            pState->skip--;
+
+            return out;
+        }
+
+        if (code == 0xE0) {
+            pState->prefix = code;
+
+            return out;
+        }
+
+        // pause is the only E1 key and is sent as E1 1D 45 or E1 9D C5
+        if (code == 0xE1) {
+            pState->prefix = 0;
+            pState->skip = 2;
+
+            return out;
+        }
+
+        const bool isE0 = pState->prefix != 0;
+        const bool isBreak = (code & 0x80) != 0;
+        const uint8_t key = code & 0x7F;
+        pState->prefix = 0;
+        uint8_t modifier = 0;
+
+        switch (key) {
+        case 0x1D:
+            modifier = isE0 ? MOD_RCTRL : MOD_LCTRL;
+            break;
+        case 0x38:
+            modifier = isE0 ? MOD_RALT : MOD_LALT;
+            break;
+        case 0x2A:
+            // E0 2A and E0 36 are sent around navigation keys to fake a shift state and are ignored
+            modifier = isE0 ? 0 : MOD_LSHIFT;
+            break;
+        case 0x36:
+            modifier = isE0 ? 0 : MOD_RSHIFT;
+            break;
+        default:
+            break;
+        }
+
+        if (modifier) {
+
+            if (isBreak) {
+                pState->modifiers &= ~modifier;
+            }
+            else {
+                pState->modifiers |= modifier;
+            }
+
+            return out;
+        }
+
+        if (isBreak || isModifierKey(key)) {
+
+            return out;
+        }
+
+        if (!isE0 && key == 0x3A) {
+            pState->modifiers ^= MOD_CAPS_LOCK;
+
+            return out;
+        }
+
+        if (!isE0 && key == 0x45) {
+            pState->modifiers ^= MOD_NUM_LOCK;
+
+            return out;
+        }
+
+        if (getFastTable(pTables, pState) == SUPPRESSED_TABLE) {
+
+            return out;
+        }
+
+        char16_t ch = 0;
+
+        if (isE0) {
+            // keypad enter and divide, all other E0 keys are navigation keys without character
+            ch = key == 0x1C ? u'\n' : key == 0x35 ? u'/' : 0;
+        }
+        else if (key >= NUMPAD_FIRST && key <= NUMPAD_LAST) {
+
+            // minus and plus do not depend on num lock, the other keys are navigation keys without num lock
+            if (pState->modifiers & MOD_NUM_LOCK || key == 0x4A || key == 0x4E) {
+                ch = pTables->numpad[key - NUMPAD_FIRST];
+            }
+
+        }
+        else {
+            const uint8_t modifiers = pState->modifiers;
+            const bool isShift = (modifiers & (MOD_LSHIFT | MOD_RSHIFT)) != 0;
+            const bool isCapsLock = (modifiers & MOD_CAPS_LOCK) != 0;
+            const bool isAltGr = pTables->hasAltGr && modifiers & MOD_RALT;
+            const size_t level = isAltGr ? 2 : isShift != (isCapsLock && pTables->isCapsKey[key]) ? 1 : 0;
+            ch = pTables->chars[level][key];
+        }
+
+        return writeUtf8(ch, out);
+    }
+
+
+    // Selects the fast table for the modifier state. Returns FAST_TABLES if the next scan code completes a prefixed key.
+    static size_t getFastTable(const Tables* pTables, const State* pState) {
+
+        if (pState->prefix || pState->skip) {
+
+            return FAST_TABLES;
+        }
+
+        const uint8_t modifiers = pState->modifiers;
+        const bool isAltGr = pTables->hasAltGr && modifiers & MOD_RALT;
+
+        // shortcuts do not result in characters, control is ignored together with AltGr
+        if (!isAltGr && modifiers & (MOD_LCTRL | MOD_RCTRL | MOD_LALT | MOD_RALT)) {
+
+            return SUPPRESSED_TABLE;
+        }
+
+        return (modifiers & (MOD_LSHIFT | MOD_RSHIFT) ? 1 : 0) | (modifiers & MOD_CAPS_LOCK ? 2 : 0) | (isAltGr ? 4 : 0);
+    }
+
+
+    static char* writeUtf8(char16_t ch, char* out) {
+
+        if (!ch) {
+
+            return out;
+        }
+
+        if (ch < 0x80) {
+            *out++ = static_cast<char>(ch);
+        }
+        else if (ch < 0x800) {
+            *out++ = static_cast<char>(0xC0 | ch >> 6);
+            *out++ = static_cast<char>(0x80 | (ch & 0x3F));
+        }
+        else {
+            *out++ = static_cast<char>(0xE0 | ch >> 12);
+            *out++ = static_cast<char>(0x80 | (ch >> 6 & 0x3F));
+            *out++ = static_cast<char>(0x80 | (ch & 0x3F));
+        }
+
+        return out;
+    }
+
+#ifdef KEYMAP_X86
+
+    // Translates 16 scan codes per iteration as long as the modifier state does not change.
+    // Every scan code is looked up in the eight 16 byte groups of the fast table with a shuffle each,
+    // the lookup of the group matching the upper half of the scan code is kept. Breaks look up zero.
+    // The characters before the first complex scan code are compacted to the output and the complex scan code is translated by the scalar implementation.
+    KEYMAP_TARGET_SSSE3 static char* translateSsse3(const Tables* pTables, State* pState, const uint8_t* in, size_t size, char* out) {
+        const __m128i lowNibble = _mm_set1_epi8(0x0F);
+        const __m128i complexValue = _mm_set1_epi8(static_cast<char>(COMPLEX));
+        size_t i = 0;
+
+        while (i + 0x10 <= size) {
+            const size_t table = getFastTable(pTables, pState);
+
+            if (table == FAST_TABLES) {
+                out = translateCode(pTables, pState, in[i], out);
+                i++;
+
+                continue;
+            }
+
+            const uint8_t* const fast = pTables->fast[table];
+            const __m128i codes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+            const __m128i groups = _mm_and_si128(_mm_srli_epi16(codes, 4), lowNibble);
+            __m128i chars = _mm_setzero_si128();
+
+            for (int group = 0; group < 8; group++) {
+                const __m128i lookup = _mm_shuffle_epi8(_mm_load_si128(reinterpret_cast<const __m128i*>(fast + group * 0x10)), codes);
+                chars = _mm_or_si128(chars, _mm_and_si128(_mm_cmpeq_epi8(groups, _mm_set1_epi8(static_cast<char>(group))), lookup));
+            }
+
+            __m128i isComplex = _mm_cmpeq_epi8(chars, complexValue);
+
+            for (uint8_t complexCode : complexCodes) {
+                isComplex = _mm_or_si128(isComplex, _mm_cmpeq_epi8(codes, _mm_set1_epi8(static_cast<char>(complexCode))));
+            }
+
+            const uint32_t complexMask = static_cast<uint32_t>(_mm_movemask_epi8(isComplex));
+            const uint32_t charMask = ~static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(chars, _mm_setzero_si128()))) & 0xFFFF;
+            const uint32_t count = complexMask ? countTrailingZeros(complexMask) : 0x10;
+            out = compact(chars, charMask & ((1u << count) - 1), out);
+            i += count;
+
+            if (count < 0x10) {
+                out = translateCode(pTables, pState, in[i], out);
+                i++;
+            }
+
+        }
+
+        for (; i < size; i++) {
+            out = translateCode(pTables, pState, in[i], out);
+        }
+
+        return out;
+    }
+
+
+    // Same as translateSsse3 with 32 scan codes per iteration.
+    KEYMAP_TARGET_AVX2 static char* translateAvx2(const Tables* pTables, State* pState, const uint8_t* in, size_t size, char* out) {
+        const __m256i lowNibble = _mm256_set1_epi8(0x0F);
+        const __m256i complexValue = _mm256_set1_epi8(static_cast<char>(COMPLEX));
+        size_t i = 0;
+
+        while (i + 0x20 <= size) {
+            const size_t table = getFastTable(pTables, pState);
+
+            if (table == FAST_TABLES) {
+                out = translateCode(pTables, pState, in[i], out);
+                i++;
+
+                continue;
+            }
+
+            const uint8_t* const fast = pTables->fast[table];
+            const __m256i codes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i));
+            const __m256i groups = _mm256_and_si256(_mm256_srli_epi16(codes, 4), lowNibble);
+            __m256i chars = _mm256_setzero_si256();
+
+            for (int group = 0; group < 8; group++) {
+                // the shuffle looks up each 128 bit lane separately, so both lanes get the group
+                const __m256i groupTable = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(fast + group * 0x10)));
+                const __m256i lookup = _mm256_shuffle_epi8(groupTable, codes);
+                chars = _mm256_or_si256(chars, _mm256_and_si256(_mm256_cmpeq_epi8(groups, _mm256_set1_epi8(static_cast<char>(group))), lookup));
+            }
+
+            __m256i isComplex = _mm256_cmpeq_epi8(chars, complexValue);
+
+            for (uint8_t complexCode : complexCodes) {
+                isComplex = _mm256_or_si256(isComplex, _mm256_cmpeq_epi8(codes, _mm256_set1_epi8(static_cast<char>(complexCode))));
+            }
+
+            const uint32_t complexMask = static_cast<uint32_t>(_mm256_movemask_epi8(isComplex));
+            uint32_t charMask = ~static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(chars, _mm256_setzero_si256())));
+            const uint32_t count = complexMask ? countTrailingZeros(complexMask) : 0x20;
+
+            if (count < 0x20) {
+                charMask &= (1u << count) - 1;
+            }
+
+            out = compact(_mm256_castsi256_si128(chars), charMask & 0xFFFF, out);
+            out = compact(_mm256_extracti128_si256(chars, 1), charMask >> 0x10, out);
+            i += count;
+
+            if (count < 0x20) {
+                out = translateCode(pTables, pState, in[i], out);
+                i++;
+            }
+
+        }
+
+        for (; i < size; i++) {
+            out = translateCode(pTables, pState, in[i], out);
+        }
+
+        return out;
+    }
+
+
+    // Writes the bytes selected by a 16 bit mask in order. Stores up to OUTPUT_SLACK bytes beyond the last byte written.
+    KEYMAP_TARGET_SSSE3 static char* compact(__m128i chars, uint32_t mask, char* out) {
+
+        // both halves are stored unconditionally, branches on the mask are hard to predict
+        const uint32_t low = mask & 0xFF;
+        const uint32_t high = mask >> 8;
+        const __m128i lowShuffle = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(compactTables.shuffle[low]));
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(out), _mm_shuffle_epi8(chars, lowShuffle));
+        out += compactTables.count[low];
+        const __m128i highShuffle = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(compactTables.shuffle[high]));
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(out), _mm_shuffle_epi8(_mm_srli_si128(chars, 8), highShuffle));
+        out += compactTables.count[high];
+
+        return out;
+    }
+
+
+    static uint32_t countTrailingZeros(uint32_t value) {
+#ifdef _MSC_VER
+        unsigned long index = 0;
+        _BitScanForward(&index, value);
+
+        return index;
+#else
+
+        return static_cast<uint32_t>(__builtin_ctz(value));
+#endif
+    }
+
+#endif
+
+}
\ No newline at end of file
@@ -0,0 +1,99 @@
+#pragma once
+#include "../../LumbrJackDriver/src/record.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Decodes raw keyboard captures (scan code set 1 bytes, see LOG_FLAG_RAW) to UTF-8 text with a selectable keyboard layout.
+// Tracks shift, caps lock, AltGr, control, alt and num lock and handles E0 and E1 prefixed keys.
+// Runs of keys that do not change the modifier state are translated 16 or 32 bytes at a time with SSSE3 or AVX2 shuffle lookups.
+// Does not depend on Windows headers, so captures can be decoded on any platform.
+namespace keymap {
+
+	// Supported keyboard layouts.
+	enum layout { US = 0, UK, DE, MAX_LAYOUT };
+
+	// Implementations of the translation.
+	enum implementation { SCALAR = 0, SSSE3, AVX2 };
+
+	// Bits of the modifier state.
+	enum modifier : uint8_t {
+		MOD_LSHIFT = 0x1,
+		MOD_RSHIFT = 0x2,
+		MOD_LCTRL = 0x4,
+		MOD_RCTRL = 0x8,
+		MOD_LALT = 0x10,
+		// AltGr on layouts that have it.
+		MOD_RALT = 0x20,
+		MOD_CAPS_LOCK = 0x40,
+		MOD_NUM_LOCK = 0x80
+	};
+
+	// Modifier and prefix state carried from one call to the next. Zero initialized for the start of a capture.
+	struct State {
+		uint8_t modifiers;
+		// Pending E0 prefix.
+		uint8_t prefix;
+		// Bytes of an E1 sequence still to skip.
+		uint8_t skip;
+	};
+
+	// Parses the name of a layout: "us", "uk" or "de".
+	//
+	// Parameters:
+	//
+	// [in] name:
+	// Name of the layout.
+	//
+	// [out] pLayout:
+	// Contains the layout on return.
+	//
+	// Return:
+	// True on success, false if the layout is unknown.
+	bool parseLayout(const std::string& name, layout* pLayout);
+
+	// Checks which implementation the processor supports.
+	//
+	// Return:
+	// The fastest implementation the processor supports.
+	implementation getBestImplementation();
+
+	// Translates scan codes to text.
+	//
+	// Parameters:
+	//
+	// [in] lay:
+	// Keyboard layout.
+	//
+	// [in/out] pState:
+	// Modifier state before the first scan code. Contains the state after the last scan code on return.
+	//
+	// [in] in:
+	// Scan code set 1 bytes.
+	//
+	// [in] size:
+	// Number of bytes.
+	//
+	// [out] pOut:
+	// The UTF-8 text of the keys is appended to it.
+	//
+	// [in] impl:
+	// Implementation to use. Falls back to a slower one if the processor does not support it.
+	void translate(layout lay, State* pState, const uint8_t* in, size_t size, std::string* pOut, implementation impl);
+
+	// Converts a keyboard record of a binary log file to scan code set 1 bytes.
+	// Compacted keystrokes (records with RECORD_KBD_PAIRED) are converted to a make directly followed by its break.
+	//
+	// Parameters:
+	//
+	// [in] pRecord:
+	// Keyboard record.
+	//
+	// [out] out:
+	// Buffer of at least four bytes that receives the scan codes.
+	//
+	// Return:
+	// Number of bytes written.
+	size_t fromRecord(const KbdRecord* pRecord, uint8_t* out);
+
+}
\ No newline at end of file
@@ -1,26 +1,42 @@
 #include "setup.h"
 #include "requests.h"
 #include "io.h"
+#include "trace.h"
+#include "commands.h"
+#include "decompress.h"
 #include <iostream>
+#include <bcrypt.h>
 
 #define DRIVER_NAME "LumbrJackDriver"
 #define SYM_LINK_NAME "\\\\.\\LumbrJackDevSymLink"
 
 static void takeSetupAction(io::action curAction, const std::string* pDriverPath);
-static void takeIoAction(io::action curAction);
+static void takeIoAction(io::action curAction, const io::options* pOptions);
+static bool createSessionKey(const std::string& keyPath, LogConfig* pLogConfig);
 
 int main(int argc, char* argv[]) {
     std::string driverPath;
+    io::options options{};
 
-    if (argc != 2) {
+    if (argc < 2) {
         std::cout << "Please specify the location of the .sys file of the driver." << std::endl;
 
         return 0;
     }
+    else if (commands::isCommand(argv[1])) {
+
+        return commands::run(argc - 1, argv + 1);
+    }
     else {
         driverPath = argv[1];
     }
 
+    // all further arguments are logging, filter and trace options
+    if (!io::parseOptions(argc - 2, argv + 2, &options)) {
+
+        return 0;
+    }
+
     io::action curAction = io::action::START;
 
     while (curAction != io::action::EXIT) {
@@ -46,7 +62,11 @@ int main(int argc, char* argv[]) {
         case io::action::LOG_STATE:
         case io::action::LOG_START:
         case io::action::LOG_STOP:
-            takeIoAction(curAction);
+        case io::action::LIST_SOURCES:
+        case io::action::TOGGLE_SOURCE:
+        case io::action::READ_TRACE:
+        case io::action::INJECT_INPUT:
+            takeIoAction(curAction, &options);
             break;
         default:
             break;
@@ -121,7 +141,7 @@ static void takeSetupAction(io::action curAction, const std::string* pDriverPath
 }
 
 
-static void takeIoAction(io::action curAction) {
+static void takeIoAction(io::action curAction, const io::options* pOptions) {
     const HANDLE hDevice = CreateFileA(SYM_LINK_NAME, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, 0, OPEN_EXISTING, 0, 0);
 
     if (!hDevice || hDevice == INVALID_HANDLE_VALUE) {
@@ -132,6 +152,11 @@ static void takeIoAction(io::action curAction) {
     }
 
     bool isLogging = false;
+    USHORT sourceId = 0;
+    SourceList sourceList{};
+    std::vector<TraceRecord> traceRecords;
+    InjectReport injectReport{};
+    LogConfig logConfig = pOptions->logConfig;
 
     switch (curAction) {
     case io::action::LOG_STATE:
@@ -153,13 +178,35 @@ static void takeIoAction(io::action curAction) {
         break;
     case io::action::LOG_START:
         
-        if (requests::startLogging(hDevice)) {
+        // the filter is always sent, so a filter of a previous session does not persist
+        if (!requests::setFilter(hDevice, &pOptions->filterConfig)) {
+            std::cout << "Failed to set filter." << std::endl;
+
+            break;
+        }
+
+        if (!requests::setTrace(hDevice, &pOptions->traceConfig)) {
+            std::cout << "Failed to set trace." << std::endl;
+
+            break;
+        }
+
+        // every session is encrypted with a new key
+        if (logConfig.flags & LOG_FLAG_ENCRYPT && !createSessionKey(pOptions->keyPath, &logConfig)) {
+            std::cout << "Failed to create key file " << pOptions->keyPath << "." << std::endl;
+
+            break;
+        }
+
+        if (requests::startLogging(hDevice, &logConfig)) {
             std::cout << "Driver started logging." << std::endl;
         }
         else {
             std::cout << "Failed to start logging." << std::endl;
         }
 
+        SecureZeroMemory(logConfig.key, sizeof(logConfig.key));
+
         break;
     case io::action::LOG_STOP:
 
@@ -170,6 +217,79 @@ static void takeIoAction(io::action curAction) {
             std::cout << "Failed to stop logging." << std::endl;
         }
         
+        break;
+    case io::action::LIST_SOURCES:
+
+        if (requests::getSources(hDevice, &sourceList)) {
+            io::printSources(&sourceList);
+        }
+        else {
+            std::cout << "Failed to get sources." << std::endl;
+        }
+
+        break;
+    case io::action::READ_TRACE:
+
+        if (requests::readTrace(hDevice, &traceRecords)) {
+            trace::printRecords(&traceRecords);
+        }
+        else {
+            std::cout << "Failed to read trace." << std::endl;
+        }
+
+        break;
+    case io::action::INJECT_INPUT:
+
+        if (requests::injectInput(hDevice, &pOptions->injectConfig, &injectReport)) {
+            // times are in 100 ns units
+            std::cout << "Injected " << injectReport.generated << " events: " << injectReport.queued << " queued, " << injectReport.dropped << " dropped." << std::endl;
+            std::cout << "Rate: " << injectReport.achievedRate << " events per second in " << injectReport.injectTime / 10000 << " ms." << std::endl;
+
+            if (injectReport.drainTime) {
+                std::cout << "Logged after " << injectReport.drainTime / 10000 << " ms." << std::endl;
+            }
+            else {
+                std::cout << "Queues not drained in time." << std::endl;
+            }
+
+        }
+        else {
+            std::cout << "Failed to inject input. Injection needs a running session without --compact, --aggregate and --motion." << std::endl;
+        }
+
+        break;
+    case io::action::TOGGLE_SOURCE:
+
+        if (!requests::getSources(hDevice, &sourceList)) {
+            std::cout << "Failed to get sources." << std::endl;
+
+            break;
+        }
+
+        io::printSources(&sourceList);
+
+        if (!io::selectSource(&sourceId)) {
+            std::cout << "Invalid source ID." << std::endl;
+
+            break;
+        }
+
+        for (ULONG i = 0; i < sourceList.count && i < MAX_SOURCES; i++) {
+            
+            if (sourceList.sources[i].id != sourceId) continue;
+            
+            const bool isEnabled = !sourceList.sources[i].isEnabled;
+
+            if (requests::enableSource(hDevice, sourceId, isEnabled)) {
+                std::cout << "Source " << sourceId << (isEnabled ? " enabled." : " disabled.") << std::endl;
+            }
+            else {
+                std::cout << "Failed to change source." << std::endl;
+            }
+
+            break;
+        }
+
         break;
     default:
         break;
@@ -180,4 +300,16 @@ static void takeIoAction(io::action curAction) {
     CloseHandle(hDevice);
 
     return;
+}
+
+
+// Generates a random key for a logging session and saves it to the key file, so the logs can be decrypted later on.
+static bool createSessionKey(const std::string& keyPath, LogConfig* pLogConfig) {
+
+    if (!BCRYPT_SUCCESS(BCryptGenRandom(nullptr, pLogConfig->key, sizeof(pLogConfig->key), BCRYPT_USE_SYSTEM_PREFERRED_RNG))) {
+
+        return false;
+    }
+
+    return decompress::writeKeyFile(keyPath.c_str(), pLogConfig->key);
 }
\ No newline at end of file
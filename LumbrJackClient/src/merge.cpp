@@ -0,0 +1,414 @@
+#include "merge.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace merge {
+
+    const char* const csvHeader = "time,input,type,source,seq,code,flags,x,y,hold,repeat\n";
+
+    // Chunks held per input: the chunk that is merged and the chunks decoded ahead.
+    static constexpr size_t PREFETCH_CHUNKS = 3;
+    static constexpr size_t MIN_CHUNK_SIZE = 0x10000;
+    static constexpr size_t MAX_CHUNK_SIZE = 0x400000;
+    // Bytes of decoded events per byte of records, with some slack for mouse records that are split into several events.
+    static constexpr size_t EVENT_EXPANSION = 2;
+    // Lines are collected and written in blocks of about this size.
+    static constexpr size_t OUTPUT_BLOCK_SIZE = 0x100000;
+    // Key of inputs without events left, larger than any time.
+    static constexpr uint64_t END_KEY = UINT64_MAX;
+
+    enum slotState { EMPTY = 0, QUEUED, DECODING, READY };
+
+    struct Slot {
+        parser::Chunk chunk;
+        parser::ChunkResult result;
+        slotState state;
+    };
+
+    struct Input {
+        parser::Capture capture;
+        // A multiple of the record size of the input, so chunks start at record boundaries.
+        size_t chunkSize;
+        size_t chunkCount;
+        // Chunks handed to the decoding and chunks taken by the merge. Chunk n is decoded into slot n % PREFETCH_CHUNKS.
+        size_t scheduledCount;
+        size_t takenCount;
+        Slot slots[PREFETCH_CHUNKS];
+        // Slot that is merged and its next event, nullptr before the first chunk is taken.
+        Slot* pSlot;
+        size_t eventIndex;
+        // Absolute interrupt time at the end of the last chunk taken.
+        uint64_t time;
+        uint64_t invalidCount;
+    };
+
+    struct Job {
+        Input* pInput;
+        Slot* pSlot;
+    };
+
+    // Decoding jobs shared by the merging thread and the workers. Slot states are only changed under the lock.
+    // The jobs are the queued slots, so every input has at most PREFETCH_CHUNKS jobs, also without workers.
+    struct Pool {
+        std::mutex mutex;
+        std::condition_variable jobAdded;
+        std::condition_variable slotReady;
+        std::deque<Job> jobs;
+        bool isStopping;
+    };
+
+    // Tree of losers over the keys of the inputs. Node 0 holds the winner, nodes 1 to count - 1 the losers of their matches.
+    // The inputs are the leaves count to 2 * count - 1, so replacing the key of the winner replays a single path to the root.
+    struct LoserTree {
+        std::vector<size_t> nodes;
+        std::vector<uint64_t> keys;
+    };
+
+    static size_t getChunkSize(const Options* pOptions, size_t inputCount, uint32_t recordSize);
+    static void schedule(Pool* pPool, Input* pInput);
+    static void decode(Pool* pPool);
+    static bool takeEvent(Pool* pPool, Input* pInput);
+    static void buildTree(LoserTree* pTree);
+    static void replayTree(LoserTree* pTree, size_t input);
+    static bool isBefore(const LoserTree* pTree, size_t a, size_t b);
+    static void appendEvent(std::string* pLines, uint64_t time, size_t input, const parser::Event* pEvent);
+    static void appendNumber(std::string* pLines, int64_t value, bool isSigned);
+
+    void getDefaultOptions(Options* pOptions) {
+        pOptions->threads = 0;
+        pOptions->memoryLimit = 256000000;
+
+        return;
+    }
+
+
+    bool mergeFiles(const std::vector<std::string>& paths, const Options* pOptions, std::ostream& out, Result* pResult) {
+        const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        *pResult = Result{};
+        // inputs hold the mutable state of their slots, so they are not moved
+        std::unique_ptr<Input[]> inputs(new Input[paths.size()]());
+        size_t openCount = 0;
+        uint32_t recordSize = 0;
+
+        for (; openCount < paths.size(); openCount++) {
+            Input* const pInput = &inputs[openCount];
+
+            if (!parser::open(&pInput->capture, paths[openCount].c_str())) break;
+
+            if (pInput->capture.fmt != parser::BINARY) {
+                parser::close(&pInput->capture);
+                break;
+            }
+
+            const RecordFileHeader* const pHeader = &pInput->capture.header;
+            pResult->size += pInput->capture.file.size;
+            recordSize = std::max(recordSize, pHeader->recordSize);
+
+            if (!openCount || pHeader->startSystemTime < pResult->startSystemTime) {
+                pResult->startSystemTime = pHeader->startSystemTime;
+            }
+
+        }
+
+        if (openCount < paths.size()) {
+            pResult->failedPath = paths[openCount];
+
+            for (size_t i = 0; i < openCount; i++) {
+                parser::close(&inputs[i].capture);
+            }
+
+            return false;
+        }
+
+        const size_t chunkSize = getChunkSize(pOptions, paths.size(), recordSize);
+        unsigned int threads = pOptions->threads ? pOptions->threads : std::max(std::thread::hardware_concurrency(), 1u);
+        Pool pool{};
+        LoserTree tree{};
+        tree.keys.resize(paths.size(), END_KEY);
+
+        for (size_t i = 0; i < paths.size(); i++) {
+            Input* const pInput = &inputs[i];
+            const size_t recordsSize = pInput->capture.file.size - pInput->capture.dataOffset;
+            pInput->chunkSize = chunkSize / pInput->capture.header.recordSize * pInput->capture.header.recordSize;
+            pInput->chunkCount = (recordsSize + pInput->chunkSize - 1) / pInput->chunkSize;
+            pInput->time = pInput->capture.header.startTime;
+            std::lock_guard<std::mutex> lock(pool.mutex);
+            schedule(&pool, pInput);
+        }
+
+        // the merging thread decodes chunks itself while it waits, so it counts as a thread
+        std::vector<std::thread> workers;
+
+        for (unsigned int i = 1; i < threads; i++) {
+            workers.emplace_back(decode, &pool);
+        }
+
+        for (size_t i = 0; i < paths.size(); i++) {
+            Input* const pInput = &inputs[i];
+
+            if (takeEvent(&pool, pInput)) {
+                tree.keys[i] = pInput->capture.header.startSystemTime + pInput->pSlot->result.events[pInput->eventIndex].time;
+            }
+
+        }
+
+        buildTree(&tree);
+        std::string lines;
+        lines.reserve(OUTPUT_BLOCK_SIZE + 0x100);
+        lines += csvHeader;
+
+        while (!tree.nodes.empty() && tree.keys[tree.nodes[0]] != END_KEY) {
+            const size_t winner = tree.nodes[0];
+            Input* const pInput = &inputs[winner];
+            appendEvent(&lines, tree.keys[winner] - pResult->startSystemTime, winner, &pInput->pSlot->result.events[pInput->eventIndex]);
+            pResult->eventCount++;
+
+            if (lines.size() >= OUTPUT_BLOCK_SIZE) {
+                out.write(lines.data(), static_cast<std::streamsize>(lines.size()));
+                lines.clear();
+            }
+
+            pInput->eventIndex++;
+            tree.keys[winner] = END_KEY;
+
+            if (takeEvent(&pool, pInput)) {
+                tree.keys[winner] = pInput->capture.header.startSystemTime + pInput->pSlot->result.events[pInput->eventIndex].time;
+            }
+
+            replayTree(&tree, winner);
+        }
+
+        out.write(lines.data(), static_cast<std::streamsize>(lines.size()));
+
+        {
+            std::lock_guard<std::mutex> lock(pool.mutex);
+            pool.isStopping = true;
+        }
+
+        pool.jobAdded.notify_all();
+
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+
+        for (size_t i = 0; i < paths.size(); i++) {
+            pResult->invalidCount += inputs[i].invalidCount;
+            parser::close(&inputs[i].capture);
+        }
+
+        pResult->chunkSize = chunkSize;
+        pResult->threads = threads;
+        pResult->seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        return true;
+    }
+
+
+    // Chunks of all inputs that are held at a time have to fit into the memory limit as decoded events.
+    static size_t getChunkSize(const Options* pOptions, size_t inputCount, uint32_t recordSize) {
+        size_t chunkSize = pOptions->memoryLimit / (std::max<size_t>(inputCount, 1) * PREFETCH_CHUNKS * EVENT_EXPANSION);
+        chunkSize = std::min(std::max(chunkSize, MIN_CHUNK_SIZE), MAX_CHUNK_SIZE);
+
+        // at least a single record per chunk
+        return std::max<size_t>(chunkSize, recordSize);
+    }
+
+
+    // Hands the next chunks of an input to the decoding until all of its slots are in use. Has to be called with the lock of the pool.
+    static void schedule(Pool* pPool, Input* pInput) {
+        const size_t begin = pInput->capture.dataOffset;
+        const size_t end = pInput->capture.file.size;
+        bool isScheduled = false;
+
+        while (pInput->scheduledCount < pInput->chunkCount && pInput->scheduledCount - pInput->takenCount < PREFETCH_CHUNKS) {
+            Slot* const pSlot = &pInput->slots[pInput->scheduledCount % PREFETCH_CHUNKS];
+            const size_t chunkBegin = begin + pInput->scheduledCount * pInput->chunkSize;
+            // a truncated record at the end of the file is ignored by the parser
+            pSlot->chunk = parser::Chunk{ chunkBegin, std::min(chunkBegin + pInput->chunkSize, end) };
+            pSlot->state = QUEUED;
+            pPool->jobs.push_back(Job{ pInput, pSlot });
+            pInput->scheduledCount++;
+            isScheduled = true;
+        }
+
+        if (isScheduled) {
+            pPool->jobAdded.notify_all();
+        }
+
+        return;
+    }
+
+
+    // Decodes queued chunks until the pool is stopped.
+    static void decode(Pool* pPool) {
+        std::unique_lock<std::mutex> lock(pPool->mutex);
+
+        while (true) {
+            pPool->jobAdded.wait(lock, [pPool] { return pPool->isStopping || !pPool->jobs.empty(); });
+
+            if (pPool->isStopping) break;
+
+            const Job job = pPool->jobs.front();
+            pPool->jobs.pop_front();
+            job.pSlot->state = DECODING;
+            lock.unlock();
+            parser::parseChunk(&job.pInput->capture, &job.pSlot->chunk, &job.pSlot->result);
+            lock.lock();
+            job.pSlot->state = READY;
+            pPool->slotReady.notify_all();
+        }
+
+        return;
+    }
+
+
+    // Advances an input to its next event. Takes the next chunk once the events of the current one are merged.
+    // A chunk that no worker started yet is decoded by the calling thread, so the merge never waits behind the chunks of other inputs.
+    // Returns false once all events of the input are merged.
+    static bool takeEvent(Pool* pPool, Input* pInput) {
+
+        while (!pInput->pSlot || pInput->eventIndex >= pInput->pSlot->result.events.size()) {
+            std::unique_lock<std::mutex> lock(pPool->mutex);
+
+            // the merged chunk frees its slot for the next chunk
+            if (pInput->pSlot) {
+                pInput->pSlot->state = EMPTY;
+                pInput->pSlot = nullptr;
+                pInput->takenCount++;
+                schedule(pPool, pInput);
+            }
+
+            if (pInput->takenCount == pInput->chunkCount) return false;
+
+            Slot* const pSlot = &pInput->slots[pInput->takenCount % PREFETCH_CHUNKS];
+
+            if (pSlot->state == QUEUED) {
+                // taken over from the workers with its job
+                pPool->jobs.erase(std::find_if(pPool->jobs.begin(), pPool->jobs.end(), [pSlot](const Job& job) { return job.pSlot == pSlot; }));
+                pSlot->state = DECODING;
+                lock.unlock();
+                parser::parseChunk(&pInput->capture, &pSlot->chunk, &pSlot->result);
+                lock.lock();
+                pSlot->state = READY;
+            }
+            else {
+                pPool->slotReady.wait(lock, [pSlot] { return pSlot->state == READY; });
+            }
+
+            lock.unlock();
+            // the deltas of a chunk continue the time of the previous one
+            parser::resolveTimes(&pInput->capture, &pInput->time, &pSlot->result);
+            pInput->invalidCount += pSlot->result.invalidCount;
+            pInput->pSlot = pSlot;
+            pInput->eventIndex = 0;
+        }
+
+        return true;
+    }
+
+
+    static void buildTree(LoserTree* pTree) {
+        const size_t count = pTree->keys.size();
+        pTree->nodes.assign(count, 0);
+
+        if (!count) return;
+
+        // winners of the matches of the inner nodes, the leaves win their own matches
+        std::vector<size_t> winners(count, 0);
+
+        for (size_t node = count - 1; node > 0; node--) {
+            const size_t left = 2 * node < count ? winners[2 * node] : 2 * node - count;
+            const size_t right = 2 * node + 1 < count ? winners[2 * node + 1] : 2 * node + 1 - count;
+            const bool isLeftFirst = isBefore(pTree, left, right);
+            winners[node] = isLeftFirst ? left : right;
+            pTree->nodes[node] = isLeftFirst ? right : left;
+        }
+
+        pTree->nodes[0] = count > 1 ? winners[1] : 0;
+
+        return;
+    }
+
+
+    // Plays the matches on the path of an input to the root again after its key changed.
+    static void replayTree(LoserTree* pTree, size_t input) {
+        const size_t count = pTree->keys.size();
+        size_t winner = input;
+
+        for (size_t node = (input + count) / 2; node > 0; node /= 2) {
+
+            if (isBefore(pTree, pTree->nodes[node], winner)) {
+                std::swap(pTree->nodes[node], winner);
+            }
+
+        }
+
+        pTree->nodes[0] = winner;
+
+        return;
+    }
+
+
+    // Events with the same time are ordered by their input, so the merge is stable.
+    static bool isBefore(const LoserTree* pTree, size_t a, size_t b) {
+
+        return pTree->keys[a] < pTree->keys[b] || (pTree->keys[a] == pTree->keys[b] && a < b);
+    }
+
+
+    static void appendEvent(std::string* pLines, uint64_t time, size_t input, const parser::Event* pEvent) {
+        appendNumber(pLines, static_cast<int64_t>(time), false);
+        *pLines += ',';
+        appendNumber(pLines, static_cast<int64_t>(input), false);
+        *pLines += ',';
+        *pLines += parser::getTypeName(pEvent->type);
+        *pLines += ',';
+        appendNumber(pLines, pEvent->source, true);
+        *pLines += ',';
+        appendNumber(pLines, static_cast<int64_t>(pEvent->sequence), false);
+        *pLines += ',';
+        appendNumber(pLines, pEvent->code, true);
+        *pLines += ',';
+        appendNumber(pLines, pEvent->flags, true);
+        *pLines += ',';
+        appendNumber(pLines, pEvent->x, true);
+        *pLines += ',';
+        appendNumber(pLines, pEvent->y, true);
+        *pLines += ',';
+        appendNumber(pLines, pEvent->holdTime, true);
+        *pLines += ',';
+        appendNumber(pLines, pEvent->repeatCount, true);
+        *pLines += '\n';
+
+        return;
+    }
+
+
+    // Times, inputs and sequence numbers are unsigned 64 bit values.
+    static void appendNumber(std::string* pLines, int64_t value, bool isSigned) {
+        char digits[0x20];
+        size_t length = 0;
+        const bool isNegative = isSigned && value < 0;
+        uint64_t magnitude = isNegative ? 0 - static_cast<uint64_t>(value) : static_cast<uint64_t>(value);
+
+        do {
+            digits[length++] = static_cast<char>('0' + magnitude % 10);
+            magnitude /= 10;
+        } while (magnitude);
+
+        if (isNegative) {
+            digits[length++] = '-';
+        }
+
+        std::reverse(digits, digits + length);
+        pLines->append(digits, length);
+
+        return;
+    }
+
+}
\ No newline at end of file
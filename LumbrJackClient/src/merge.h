@@ -0,0 +1,76 @@
+#pragma once
+#include "parser.h"
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Streaming k-way merge of binary log files of many machines and sessions onto a single timeline.
+// The log files are memory mapped and split into chunks of records. Worker threads decode the next chunks of every input ahead of the merge,
+// while a loser tree picks the input with the earliest event. Only a bounded number of chunks per input is held at a time,
+// so memory depends on the number of inputs but not on their size.
+// Events are ordered by the system time of the capture, so sessions of different machines and boots can be merged.
+// Only the file mapping of the parser depends on the platform, so captures can be merged on any platform.
+namespace merge {
+
+	// Options of the merge.
+	struct Options {
+		// Number of threads including the merging thread. Zero for one per core.
+		unsigned int threads;
+		// Bytes of decoded chunks held at a time by all inputs. Inputs get at least a minimum chunk size, so many inputs may exceed it.
+		size_t memoryLimit;
+	};
+
+	// Statistics of a merge.
+	struct Result {
+		uint64_t eventCount;
+		// Records that could not be parsed.
+		uint64_t invalidCount;
+		// Bytes of all inputs.
+		uint64_t size;
+		// Bytes of a chunk of records.
+		size_t chunkSize;
+		unsigned int threads;
+		// System time (100 ns units since 1601-01-01 UTC) of the earliest start of all inputs. Times of the output are relative to it.
+		uint64_t startSystemTime;
+		// Wall time of mapping, decoding, merging and writing.
+		double seconds;
+		// Input that could not be mapped or is not an uncompressed binary log file.
+		std::string failedPath;
+	};
+
+	// Header line of the output.
+	extern const char* const csvHeader;
+
+	// Gets the default options: one thread per core and 256 MB of decoded chunks.
+	//
+	// Parameters:
+	//
+	// [out] pOptions:
+	// Contains the default options on return.
+	void getDefaultOptions(Options* pOptions);
+
+	// Merges binary log files by the time of their events and writes the events as comma separated values in time order.
+	// Events with the same time are written in the order of the inputs. Every line contains the index of its input,
+	// the source ID and the sequence number of the event (see parser::Event).
+	// Compressed or encrypted log files have to be decompressed first (see decompress.h).
+	//
+	// Parameters:
+	//
+	// [in] paths:
+	// Paths of the log files.
+	//
+	// [in] pOptions:
+	// Options of the merge.
+	//
+	// [out] out:
+	// Stream the header line and the events are written to.
+	//
+	// [out] pResult:
+	// Contains the statistics of the merge on return.
+	//
+	// Return:
+	// True on success, false if an input could not be mapped or is not a binary log file. Nothing is written in that case.
+	bool mergeFiles(const std::vector<std::string>& paths, const Options* pOptions, std::ostream& out, Result* pResult);
+
+}
\ No newline at end of file
@@ -0,0 +1,818 @@
+#include "parser.h"
+#include "../../LumbrJackDriver/src/lz.h"
+#include "../../LumbrJackDriver/src/cipher.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+#ifdef _WIN32
+// std::min and std::max are used
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace parser {
+
+    // Chunks per thread, so threads that finish early take over the remaining chunks.
+    static constexpr size_t CHUNKS_PER_THREAD = 4;
+    // Smallest chunk worth a thread.
+    static constexpr size_t MIN_CHUNK_SIZE = 0x100000;
+    // Bytes of a text log searched for a source ID to detect line formats.
+    static constexpr size_t DETECT_SIZE = 0x100;
+
+    // MOUSE_INPUT_DATA flags, see ntddmou.h.
+    static constexpr uint16_t MOUSE_MOVE_ABSOLUTE = 0x1;
+    static constexpr uint16_t MOUSE_WHEEL = 0x400;
+    static constexpr uint16_t MOUSE_HWHEEL = 0x800;
+    // Button down flags in the order of the button indices.
+    static constexpr uint16_t buttonDownFlags[] = { 0x1, 0x4, 0x10, 0x40, 0x100 };
+
+    struct Label {
+        const char* text;
+        size_t length;
+        eventType type;
+        uint16_t button;
+    };
+
+    // Line labels of formatMou of the driver.
+    static const Label mouseLabels[] = {
+        { "LEFT@X:", 7, BUTTON, 0 },
+        { "RIGHT@X:", 8, BUTTON, 1 },
+        { "MIDDLE@X:", 9, BUTTON, 2 },
+        { "X1@X:", 5, BUTTON, 3 },
+        { "X2@X:", 5, BUTTON, 4 },
+        { "WHEEL:", 6, WHEEL, 0 },
+        { "HWHEEL:", 7, HWHEEL, 0 },
+        { "POS@X:", 6, POSITION, 0 },
+        { "MOVE@X:", 7, MOVE, 0 }
+    };
+
+    static size_t findLineStart(const uint8_t* p, const uint8_t* end);
+    static void parseKeyStream(const uint8_t* p, const uint8_t* end, ChunkResult* pResult);
+    static void parseLines(const uint8_t* p, const uint8_t* end, ChunkResult* pResult);
+    static bool parseLine(const uint8_t** pP, const uint8_t* end, ChunkResult* pResult);
+    static bool parseKey(const uint8_t** pP, const uint8_t* end, Event* pEvent);
+    static bool parseMouse(const uint8_t** pP, const uint8_t* end, Event* pEvent);
+    static void parseRecords(const uint8_t* p, const uint8_t* end, size_t recordSize, ChunkResult* pResult);
+    static void addMouseEvents(const InputRecord* pRecord, uint64_t time, bool hasSequence, std::vector<Event>* pEvents);
+    static bool matches(const uint8_t* p, const uint8_t* end, const char* text, size_t length);
+    static bool parseUnsigned(const uint8_t** pP, const uint8_t* end, uint64_t max, uint64_t* pValue);
+    static bool parseSigned(const uint8_t** pP, const uint8_t* end, int32_t* pValue);
+    static bool parseSequence(const uint8_t** pP, const uint8_t* end, Event* pEvent);
+    static bool parseSource(const uint8_t** pP, const uint8_t* end, uint16_t* pSource);
+
+    bool map(MappedFile* pFile, const char* path) {
+        pFile->data = nullptr;
+        pFile->size = 0;
+
+#ifdef _WIN32
+        const HANDLE hFile = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+
+        if (hFile == INVALID_HANDLE_VALUE) {
+
+            return false;
+        }
+
+        LARGE_INTEGER size{};
+
+        if (!GetFileSizeEx(hFile, &size)) {
+            CloseHandle(hFile);
+
+            return false;
+        }
+
+        if (!size.QuadPart) {
+            CloseHandle(hFile);
+
+            return true;
+        }
+
+        const HANDLE hMapping = CreateFileMappingA(hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        CloseHandle(hFile);
+
+        if (!hMapping) {
+
+            return false;
+        }
+
+        // the view keeps the mapping alive
+        const void* const pView = MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0);
+        CloseHandle(hMapping);
+
+        if (!pView) {
+
+            return false;
+        }
+
+        pFile->data = static_cast<const uint8_t*>(pView);
+        pFile->size = static_cast<size_t>(size.QuadPart);
+#else
+        const int fd = ::open(path, O_RDONLY);
+
+        if (fd < 0) {
+
+            return false;
+        }
+
+        struct stat fileStat {};
+
+        if (fstat(fd, &fileStat) != 0) {
+            ::close(fd);
+
+            return false;
+        }
+
+        if (!fileStat.st_size) {
+            ::close(fd);
+
+            return true;
+        }
+
+        // the mapping stays valid after the file is closed
+        void* const pView = mmap(nullptr, static_cast<size_t>(fileStat.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+
+        if (pView == MAP_FAILED) {
+
+            return false;
+        }
+
+        madvise(pView, static_cast<size_t>(fileStat.st_size), MADV_SEQUENTIAL);
+        pFile->data = static_cast<const uint8_t*>(pView);
+        pFile->size = static_cast<size_t>(fileStat.st_size);
+#endif
+
+        return true;
+    }
+
+
+    void unmap(MappedFile* pFile) {
+
+        if (pFile->data) {
+#ifdef _WIN32
+            UnmapViewOfFile(pFile->data);
+#else
+            munmap(const_cast<uint8_t*>(pFile->data), pFile->size);
+#endif
+        }
+
+        pFile->data = nullptr;
+        pFile->size = 0;
+
+        return;
+    }
+
+
+    bool open(Capture* pCapture, const char* path) {
+
+        if (!map(&pCapture->file, path)) {
+
+            return false;
+        }
+
+        pCapture->header = RecordFileHeader{};
+        pCapture->dataOffset = 0;
+        pCapture->fmt = detectFormat(&pCapture->file, &pCapture->header, &pCapture->dataOffset);
+
+        if (pCapture->fmt == UNKNOWN) {
+            unmap(&pCapture->file);
+
+            return false;
+        }
+
+        return true;
+    }
+
+
+    void close(Capture* pCapture) {
+        unmap(&pCapture->file);
+
+        return;
+    }
+
+
+    // Binary log files start with the record header, compressed and encrypted files with their own magic.
+    // Text logs with lines contain a source ID in the first line, the characters of plain keyboard logs are never upper case.
+    format detectFormat(const MappedFile* pFile, RecordFileHeader* pHeader, size_t* pDataOffset) {
+        uint32_t magic = 0;
+
+        if (pFile->size >= sizeof(magic)) {
+            memcpy(&magic, pFile->data, sizeof(magic));
+        }
+
+        if (magic == RECORD_MAGIC) {
+
+            if (pFile->size < sizeof(RecordFileHeader)) return UNKNOWN;
+
+            memcpy(pHeader, pFile->data, sizeof(RecordFileHeader));
+
+            if (!RECORD_IS_SUPPORTED(pHeader) || pHeader->headerSize < sizeof(RecordFileHeader)
+                || pHeader->headerSize > pFile->size || !pHeader->timeResolution) {
+
+                return UNKNOWN;
+            }
+
+            *pDataOffset = pHeader->headerSize;
+
+            return BINARY;
+        }
+
+        if (magic == LZ_FILE_MAGIC || magic == CIPHER_FILE_MAGIC) return UNKNOWN;
+
+        const size_t size = std::min(pFile->size, DETECT_SIZE);
+        const uint8_t* const end = pFile->data + size;
+
+        for (const uint8_t* p = pFile->data; p + 4 <= end; p++) {
+
+            if (matches(p, end, "SRC:", 4)) return LINES;
+
+        }
+
+        return KEY_STREAM;
+    }
+
+
+    size_t findEnd(const Capture* pCapture, size_t begin, size_t end) {
+
+        if (pCapture->fmt == BINARY) {
+
+            return begin + (end - begin) / pCapture->header.recordSize * pCapture->header.recordSize;
+        }
+
+        if (pCapture->fmt != LINES) return end;
+
+        const uint8_t* const data = pCapture->file.data;
+
+        // the last "SRC:" followed by a complete source ID ends the last complete line
+        for (size_t i = end; i >= begin + 4; i--) {
+            const uint8_t* p = data + i - 4;
+            uint16_t source = 0;
+
+            if (*p == 'S' && parseSource(&p, data + end, &source)) {
+
+                return static_cast<size_t>(p - data);
+            }
+
+        }
+
+        return begin;
+    }
+
+
+    void split(const Capture* pCapture, size_t count, std::vector<Chunk>* pChunks) {
+        pChunks->clear();
+        const size_t begin = pCapture->dataOffset;
+        size_t end = pCapture->file.size;
+
+        if (pCapture->fmt == BINARY) {
+            // a truncated record at the end of the file is ignored
+            end = begin + (end - begin) / pCapture->header.recordSize * pCapture->header.recordSize;
+        }
+
+        const size_t size = end - begin;
+        count = std::max<size_t>(std::min(count, size / MIN_CHUNK_SIZE), 1);
+        size_t chunkBegin = begin;
+
+        for (size_t i = 1; i <= count; i++) {
+            size_t chunkEnd = begin + static_cast<size_t>(static_cast<double>(size) * i / count);
+
+            if (i == count) {
+                chunkEnd = end;
+            }
+            else if (pCapture->fmt == BINARY) {
+                chunkEnd -= (chunkEnd - begin) % pCapture->header.recordSize;
+            }
+            else if (pCapture->fmt == LINES) {
+                chunkEnd += findLineStart(pCapture->file.data + chunkEnd, pCapture->file.data + end);
+            }
+
+            // lines longer than a chunk leave empty chunks
+            chunkEnd = std::max(chunkEnd, chunkBegin);
+            pChunks->push_back(Chunk{ chunkBegin, chunkEnd });
+            chunkBegin = chunkEnd;
+        }
+
+        return;
+    }
+
+
+    void parseChunk(const Capture* pCapture, const Chunk* pChunk, ChunkResult* pResult) {
+        pResult->events.clear();
+        pResult->invalidCount = 0;
+        pResult->endTime = 0;
+        pResult->relativeCount = 0;
+        pResult->hasAbsoluteTime = false;
+        const uint8_t* const begin = pCapture->file.data + pChunk->begin;
+        const uint8_t* const end = pCapture->file.data + pChunk->end;
+
+        switch (pCapture->fmt) {
+        case KEY_STREAM:
+            parseKeyStream(begin, end, pResult);
+            break;
+        case LINES:
+            parseLines(begin, end, pResult);
+            break;
+        case BINARY:
+            parseRecords(begin, end, pCapture->header.recordSize, pResult);
+            break;
+        default:
+            break;
+        }
+
+        return;
+    }
+
+
+    void resolveTimes(const Capture* pCapture, uint64_t* pTime, ChunkResult* pResult) {
+
+        if (pCapture->fmt != BINARY) return;
+
+        const uint64_t startTime = pCapture->header.startTime;
+        Event* const events = pResult->events.data();
+
+        for (size_t i = 0; i < pResult->relativeCount; i++) {
+            events[i].time += *pTime;
+        }
+
+        // input captured before the file was opened is logged at the start time
+        for (size_t i = 0; i < pResult->events.size(); i++) {
+            events[i].time = events[i].time > startTime ? events[i].time - startTime : 0;
+        }
+
+        *pTime = pResult->hasAbsoluteTime ? pResult->endTime : *pTime + pResult->endTime;
+
+        return;
+    }
+
+
+    void runParallel(unsigned int threads, size_t count, const std::function<void(size_t, unsigned int)>& function) {
+        std::atomic<size_t> next{ 0 };
+
+        const auto work = [&](unsigned int thread) {
+
+            for (size_t i = next++; i < count; i = next++) {
+                function(i, thread);
+            }
+
+        };
+
+        // the calling thread is one of the workers
+        std::vector<std::thread> workers;
+
+        for (unsigned int i = 1; i < threads && i < count; i++) {
+            workers.emplace_back(work, i);
+        }
+
+        work(0);
+
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+
+        return;
+    }
+
+
+    bool parseFile(const char* path, unsigned int threads, Result* pResult) {
+        const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        Capture capture{};
+
+        if (!open(&capture, path)) {
+
+            return false;
+        }
+
+        if (!threads) {
+            threads = std::max(std::thread::hardware_concurrency(), 1u);
+        }
+
+        std::vector<Chunk> chunks;
+        split(&capture, static_cast<size_t>(threads) * CHUNKS_PER_THREAD, &chunks);
+        threads = static_cast<unsigned int>(std::min<size_t>(threads, chunks.size()));
+        std::vector<ChunkResult> chunkResults(chunks.size());
+        runParallel(threads, chunks.size(), [&](size_t i, unsigned int) {
+            parseChunk(&capture, &chunks[i], &chunkResults[i]);
+        });
+
+        size_t eventCount = 0;
+
+        for (const ChunkResult& chunkResult : chunkResults) {
+            eventCount += chunkResult.events.size();
+        }
+
+        pResult->fmt = capture.fmt;
+        pResult->events.clear();
+
+        if (chunkResults.size() > 1) {
+            pResult->events.reserve(eventCount);
+        }
+
+        pResult->invalidCount = 0;
+        pResult->size = capture.file.size;
+        pResult->threads = threads;
+        uint64_t time = capture.header.startTime;
+
+        for (ChunkResult& chunkResult : chunkResults) {
+            resolveTimes(&capture, &time, &chunkResult);
+
+            // the events of a single chunk are taken over without a copy
+            if (chunkResults.size() == 1) {
+                pResult->events.swap(chunkResult.events);
+            }
+            else {
+                pResult->events.insert(pResult->events.end(), chunkResult.events.begin(), chunkResult.events.end());
+            }
+
+            pResult->invalidCount += chunkResult.invalidCount;
+            // the merged events would double the memory otherwise
+            std::vector<Event>().swap(chunkResult.events);
+        }
+
+        close(&capture);
+        pResult->seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        return true;
+    }
+
+
+    const char* getTypeName(eventType type) {
+        static const char* const names[] = { "KEY", "BUTTON", "WHEEL", "HWHEEL", "MOVE", "POSITION" };
+
+        return type < MAX_EVENT_TYPE ? names[type] : "UNKNOWN";
+    }
+
+
+    // Lines end with "SRC:" followed by the source ID and a new line. "SRC:" is never part of a key or mouse line,
+    // while a new line alone can be the character of a key.
+    static size_t findLineStart(const uint8_t* p, const uint8_t* end) {
+        const uint8_t* const begin = p;
+
+        while (p < end) {
+            p = static_cast<const uint8_t*>(memchr(p, 'S', static_cast<size_t>(end - p)));
+
+            if (!p) break;
+
+            uint16_t source = 0;
+
+            if (matches(p, end, "SRC:", 4) && parseSource(&p, end, &source)) {
+
+                return static_cast<size_t>(p - begin);
+            }
+
+            p++;
+        }
+
+        return static_cast<size_t>(end - begin);
+    }
+
+
+    static void parseKeyStream(const uint8_t* p, const uint8_t* end, ChunkResult* pResult) {
+        pResult->events.resize(static_cast<size_t>(end - p));
+        Event* pEvent = pResult->events.data();
+
+        for (; p < end; p++, pEvent++) {
+            *pEvent = Event{};
+            pEvent->source = NO_SOURCE;
+            pEvent->code = *p;
+            pEvent->type = KEY;
+        }
+
+        return;
+    }
+
+
+    static void parseLines(const uint8_t* p, const uint8_t* end, ChunkResult* pResult) {
+
+        while (p < end) {
+            const uint8_t* const lineStart = p;
+
+            if (!parseLine(&p, end, pResult)) {
+                pResult->invalidCount++;
+                p = lineStart + std::max<size_t>(findLineStart(lineStart, end), 1);
+            }
+
+        }
+
+        return;
+    }
+
+
+    // Parses a line of formatKbd or formatMou of the driver.
+    static bool parseLine(const uint8_t** pP, const uint8_t* end, ChunkResult* pResult) {
+        Event event{};
+        const uint8_t* p = *pP;
+        bool isValid = false;
+
+        if (matches(p, end, "K:", 2)) {
+            p += 2;
+            isValid = parseKey(&p, end, &event);
+        }
+        else if (matches(p, end, "M:", 2)) {
+            p += 2;
+            isValid = parseMouse(&p, end, &event);
+        }
+        else if (*p >= 'A' && *p <= 'Z') {
+            isValid = parseMouse(&p, end, &event);
+        }
+        else {
+            isValid = parseKey(&p, end, &event);
+        }
+
+        if (!isValid) return false;
+
+        pResult->events.push_back(event);
+        *pP = p;
+
+        return true;
+    }
+
+
+    // Parses "c@HOLD:<ms>REPEAT:<count>SEQ:<n>SRC:<id>\n" of compact logs or "cSEQ:<n>SRC:<id>\n" of unified logs.
+    static bool parseKey(const uint8_t** pP, const uint8_t* end, Event* pEvent) {
+        const uint8_t* p = *pP;
+
+        if (p >= end) return false;
+
+        pEvent->type = KEY;
+        pEvent->code = *p++;
+
+        if (matches(p, end, "@HOLD:", 6)) {
+            p += 6;
+            uint64_t holdTime = 0;
+            uint64_t repeatCount = 0;
+
+            if (!parseUnsigned(&p, end, UINT32_MAX, &holdTime) || !matches(p, end, "REPEAT:", 7)) return false;
+
+            p += 7;
+
+            if (!parseUnsigned(&p, end, UINT32_MAX, &repeatCount)) return false;
+
+            pEvent->holdTime = static_cast<uint32_t>(holdTime);
+            pEvent->repeatCount = static_cast<uint32_t>(repeatCount);
+        }
+
+        if (!parseSequence(&p, end, pEvent) || !parseSource(&p, end, &pEvent->source)) return false;
+
+        *pP = p;
+
+        return true;
+    }
+
+
+    // Parses "<button>@X:<x>Y:<y>SEQ:<n>SRC:<id>\n", "[H]WHEEL:<rotation>SEQ:<n>SRC:<id>\n" or "POS|MOVE@X:<x>Y:<y>SEQ:<n>SRC:<id>\n".
+    static bool parseMouse(const uint8_t** pP, const uint8_t* end, Event* pEvent) {
+        const uint8_t* p = *pP;
+        const Label* pLabel = nullptr;
+
+        for (const Label& label : mouseLabels) {
+
+            if (matches(p, end, label.text, label.length)) {
+                pLabel = &label;
+                break;
+            }
+
+        }
+
+        if (!pLabel) return false;
+
+        p += pLabel->length;
+        pEvent->type = pLabel->type;
+        pEvent->code = pLabel->button;
+
+        if (!parseSigned(&p, end, &pEvent->x)) return false;
+
+        if (pLabel->type != WHEEL && pLabel->type != HWHEEL) {
+
+            if (!matches(p, end, "Y:", 2)) return false;
+
+            p += 2;
+
+            if (!parseSigned(&p, end, &pEvent->y)) return false;
+
+        }
+
+        if (!parseSequence(&p, end, pEvent) || !parseSource(&p, end, &pEvent->source)) return false;
+
+        *pP = p;
+
+        return true;
+    }
+
+
+    // Times before the first time record of a chunk are relative to its start, since the deltas of previous chunks are not known yet.
+    static void parseRecords(const uint8_t* p, const uint8_t* end, size_t recordSize, ChunkResult* pResult) {
+        std::vector<Event>* const pEvents = &pResult->events;
+        pEvents->reserve(static_cast<size_t>(end - p) / recordSize);
+        uint64_t time = 0;
+
+        for (; p + recordSize <= end; p += recordSize) {
+            // records of version 1 end before the sequence number
+            InputRecord record;
+            memcpy(&record, p, RECORD_SIZE_V1);
+            const bool hasSequence = recordSize >= sizeof(InputRecord);
+            record.sequence = 0;
+
+            if (hasSequence) {
+                memcpy(&record.sequence, p + offsetof(InputRecord, sequence), sizeof(record.sequence));
+            }
+
+            if (record.type == RECORD_TYPE_TIME) {
+
+                if (!pResult->hasAbsoluteTime) {
+                    pResult->hasAbsoluteTime = true;
+                    pResult->relativeCount = pEvents->size();
+                }
+
+                time = record.time.time;
+
+                continue;
+            }
+
+            time += record.timeDelta;
+
+            if (record.type == RECORD_TYPE_KBD) {
+                Event event{};
+                event.time = time;
+                event.holdTime = record.kbd.holdTime;
+                event.repeatCount = record.kbd.repeatCount;
+                event.source = record.source;
+                event.code = record.kbd.makeCode;
+                event.flags = record.kbd.flags;
+                event.type = KEY;
+                event.hasSequence = hasSequence;
+                event.sequence = record.sequence;
+                pEvents->push_back(event);
+            }
+            else if (record.type == RECORD_TYPE_MOU) {
+                addMouseEvents(&record, time, hasSequence, pEvents);
+            }
+            else {
+                pResult->invalidCount++;
+            }
+
+        }
+
+        if (!pResult->hasAbsoluteTime) {
+            pResult->relativeCount = pEvents->size();
+        }
+
+        pResult->endTime = time;
+
+        return;
+    }
+
+
+    // Splits a mouse record into events the way formatMou of the driver splits it into lines.
+    // Movement is only added without a button press. Absolute positions are added even without movement.
+    static void addMouseEvents(const InputRecord* pRecord, uint64_t time, bool hasSequence, std::vector<Event>* pEvents) {
+        const MouRecord* const pMou = &pRecord->mou;
+        Event event{};
+        event.time = time;
+        event.source = pRecord->source;
+        event.flags = pMou->flags;
+        event.x = pMou->lastX;
+        event.y = pMou->lastY;
+        event.hasSequence = hasSequence;
+        event.sequence = pRecord->sequence;
+        bool isButtonPressed = false;
+
+        for (uint16_t i = 0; i < sizeof(buttonDownFlags) / sizeof(buttonDownFlags[0]); i++) {
+
+            if (pMou->buttonFlags & buttonDownFlags[i]) {
+                event.type = BUTTON;
+                event.code = i;
+                pEvents->push_back(event);
+                isButtonPressed = true;
+            }
+
+        }
+
+        event.code = 0;
+
+        if (pMou->buttonFlags & (MOUSE_WHEEL | MOUSE_HWHEEL)) {
+            Event wheelEvent = event;
+            // wheel rotations are signed
+            wheelEvent.x = static_cast<int16_t>(pMou->buttonData);
+            wheelEvent.y = 0;
+
+            if (pMou->buttonFlags & MOUSE_WHEEL) {
+                wheelEvent.type = WHEEL;
+                pEvents->push_back(wheelEvent);
+            }
+
+            if (pMou->buttonFlags & MOUSE_HWHEEL) {
+                wheelEvent.type = HWHEEL;
+                pEvents->push_back(wheelEvent);
+            }
+
+        }
+
+        if (isButtonPressed) return;
+
+        if (pMou->flags & MOUSE_MOVE_ABSOLUTE) {
+            event.type = POSITION;
+            pEvents->push_back(event);
+        }
+        else if (pMou->lastX || pMou->lastY) {
+            event.type = MOVE;
+            pEvents->push_back(event);
+        }
+
+        return;
+    }
+
+
+    static bool matches(const uint8_t* p, const uint8_t* end, const char* text, size_t length) {
+
+        return static_cast<size_t>(end - p) >= length && !memcmp(p, text, length);
+    }
+
+
+    static bool parseUnsigned(const uint8_t** pP, const uint8_t* end, uint64_t max, uint64_t* pValue) {
+        const uint8_t* p = *pP;
+        uint64_t value = 0;
+
+        for (; p < end && *p >= '0' && *p <= '9'; p++) {
+            const uint64_t digit = static_cast<uint64_t>(*p - '0');
+
+            // checked before the multiplication, so values up to UINT64_MAX do not wrap
+            if (value > (max - digit) / 10) return false;
+
+            value = value * 10 + digit;
+        }
+
+        if (p == *pP) return false;
+
+        *pValue = value;
+        *pP = p;
+
+        return true;
+    }
+
+
+    static bool parseSigned(const uint8_t** pP, const uint8_t* end, int32_t* pValue) {
+        const uint8_t* p = *pP;
+        const bool isNegative = p < end && *p == '-';
+
+        if (isNegative) {
+            p++;
+        }
+
+        uint64_t value = 0;
+
+        if (!parseUnsigned(&p, end, static_cast<uint64_t>(INT32_MAX) + 1, &value)) return false;
+
+        if (!isNegative && value > INT32_MAX) return false;
+
+        *pValue = isNegative ? static_cast<int32_t>(0 - value) : static_cast<int32_t>(value);
+        *pP = p;
+
+        return true;
+    }
+
+
+    // Parses "SEQ:<n>" before the source ID. Lines of older drivers have no sequence number.
+    static bool parseSequence(const uint8_t** pP, const uint8_t* end, Event* pEvent) {
+        const uint8_t* p = *pP;
+
+        if (!matches(p, end, "SEQ:", 4)) {
+
+            return true;
+        }
+
+        p += 4;
+
+        if (!parseUnsigned(&p, end, UINT64_MAX, &pEvent->sequence)) return false;
+
+        pEvent->hasSequence = true;
+        *pP = p;
+
+        return true;
+    }
+
+
+    // Parses "SRC:<id>\n", the end of every line.
+    static bool parseSource(const uint8_t** pP, const uint8_t* end, uint16_t* pSource) {
+        const uint8_t* p = *pP;
+        uint64_t source = 0;
+
+        if (!matches(p, end, "SRC:", 4)) return false;
+
+        p += 4;
+
+        if (!parseUnsigned(&p, end, UINT16_MAX, &source) || p >= end || *p != '\n') return false;
+
+        *pSource = static_cast<uint16_t>(source);
+        *pP = p + 1;
+
+        return true;
+    }
+
+}
\ No newline at end of file
@@ -0,0 +1,264 @@
+#pragma once
+#include "../../LumbrJackDriver/src/record.h"
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// Parallel parser of captures. A capture is memory mapped and split into chunks at record or line boundaries.
+// The chunks are parsed on all cores and merged in capture order.
+// Parses binary log files and the text logs of the driver (kbd.log, mou.log and input.log) to events of a common layout.
+// Compressed or encrypted log files have to be decompressed first (see decompress.h).
+// Only the file mapping depends on the platform, so captures can be parsed on any platform.
+namespace parser {
+
+	// Formats of captures.
+	enum format {
+		UNKNOWN = 0,
+		// Plain keyboard log: one character per key without separators.
+		KEY_STREAM,
+		// Keyboard, mouse or unified log with one line per input. Every line ends with the sequence number and the source ID.
+		LINES,
+		// Binary log file (see record.h).
+		BINARY
+	};
+
+	// Types of events.
+	enum eventType : uint8_t { KEY = 0, BUTTON, WHEEL, HWHEEL, MOVE, POSITION, MAX_EVENT_TYPE };
+
+	// Source of events of logs without source IDs.
+	constexpr uint16_t NO_SOURCE = 0xFFFF;
+
+	// Input event of any capture format. Fields a format does not contain are zero.
+	struct Event {
+		// Ticks of RECORD_TIME_RESOLUTION since the start of the log file. Only binary log files contain times.
+		uint64_t time;
+		// Milliseconds a compacted key was held.
+		uint32_t holdTime;
+		uint32_t repeatCount;
+		// Position of buttons and movement. Rotation of wheels in x.
+		int32_t x;
+		int32_t y;
+		uint16_t source;
+		// Make code of keys in binary log files, character of keys in text logs, index of buttons (0 for left to 4 for X2).
+		uint16_t code;
+		// Keyboard flags of keys and mouse flags of mouse events in binary log files.
+		uint16_t flags;
+		eventType type;
+		// True if the capture contains the sequence number of the input: binary log files of version 2 and text lines with "SEQ:".
+		bool hasSequence;
+		// Number of the input among the logged input of its source (see record.h). All events of a mouse record or entry have the same number.
+		// Text logs only number input that has lines, so input without text does not leave a gap.
+		uint64_t sequence;
+	};
+
+	// Read only view of a file.
+	struct MappedFile {
+		const uint8_t* data;
+		size_t size;
+	};
+
+	// Mapped capture and its detected format.
+	struct Capture {
+		MappedFile file;
+		format fmt;
+		// Header of binary log files.
+		RecordFileHeader header;
+		// Offset of the first record or line.
+		size_t dataOffset;
+	};
+
+	// Range of a capture that starts and ends at record or line boundaries.
+	struct Chunk {
+		size_t begin;
+		size_t end;
+	};
+
+	// Events of a chunk.
+	struct ChunkResult {
+		std::vector<Event> events;
+		// Lines or records that could not be parsed.
+		uint64_t invalidCount;
+		// Absolute interrupt time at the end of the chunk if it contains a time record, otherwise the sum of its deltas.
+		uint64_t endTime;
+		// Events before the first time record. Their times are relative to the start of the chunk.
+		size_t relativeCount;
+		bool hasAbsoluteTime;
+	};
+
+	// Events of a whole capture.
+	struct Result {
+		format fmt;
+		std::vector<Event> events;
+		uint64_t invalidCount;
+		uint64_t size;
+		unsigned int threads;
+		// Wall time of mapping, parsing and merging.
+		double seconds;
+	};
+
+	// Maps a file read only. Empty files are mapped without data.
+	//
+	// Parameters:
+	//
+	// [out] pFile:
+	// Contains the view of the file on return.
+	//
+	// [in] path:
+	// Path of the file.
+	//
+	// Return:
+	// True on success, false if the file could not be opened or mapped.
+	bool map(MappedFile* pFile, const char* path);
+
+	// Unmaps a file mapped by map.
+	//
+	// Parameters:
+	//
+	// [in/out] pFile:
+	// Mapped file.
+	void unmap(MappedFile* pFile);
+
+	// Maps a capture and detects its format.
+	//
+	// Parameters:
+	//
+	// [out] pCapture:
+	// Capture to initialize. Has to be closed with close on success.
+	//
+	// [in] path:
+	// Path of the capture.
+	//
+	// Return:
+	// True on success, false if the file could not be mapped or its format is unknown.
+	bool open(Capture* pCapture, const char* path);
+
+	// Unmaps a capture.
+	//
+	// Parameters:
+	//
+	// [in/out] pCapture:
+	// Opened capture.
+	void close(Capture* pCapture);
+
+	// Detects the format of a mapped file.
+	//
+	// Parameters:
+	//
+	// [in] pFile:
+	// View of the file. Only the first bytes are read.
+	//
+	// [out] pHeader:
+	// Contains the header of binary log files on return.
+	//
+	// [out] pDataOffset:
+	// Contains the offset of the first record or line on return.
+	//
+	// Return:
+	// Format of the file, UNKNOWN for compressed, encrypted or invalid files.
+	format detectFormat(const MappedFile* pFile, RecordFileHeader* pHeader, size_t* pDataOffset);
+
+	// Gets the end of the last complete record or line of a range. Data that is still being written ends in a partial record or line.
+	//
+	// Parameters:
+	//
+	// [in] pCapture:
+	// Opened capture.
+	//
+	// [in] begin:
+	// Start of the range at a record or line boundary.
+	//
+	// [in] end:
+	// End of the range.
+	//
+	// Return:
+	// End of the last complete record or line, begin if the range contains none.
+	size_t findEnd(const Capture* pCapture, size_t begin, size_t end);
+
+	// Splits a capture into chunks of about the same size. Chunks of text logs are extended to the end of a line.
+	//
+	// Parameters:
+	//
+	// [in] pCapture:
+	// Opened capture.
+	//
+	// [in] count:
+	// Number of chunks to split into. Small captures are split into fewer chunks.
+	//
+	// [out] pChunks:
+	// Contains the chunks in capture order on return.
+	void split(const Capture* pCapture, size_t count, std::vector<Chunk>* pChunks);
+
+	// Parses the events of a chunk. Chunks of the same capture can be parsed concurrently.
+	//
+	// Parameters:
+	//
+	// [in] pCapture:
+	// Opened capture.
+	//
+	// [in] pChunk:
+	// Chunk returned by split.
+	//
+	// [out] pResult:
+	// Contains the events of the chunk on return. Times of binary log files still have to be resolved with resolveTimes.
+	void parseChunk(const Capture* pCapture, const Chunk* pChunk, ChunkResult* pResult);
+
+	// Makes the times of the events of a parsed chunk relative to the start of the log file.
+	// Has to be called for all chunks in capture order, since the deltas of a chunk continue the time of the previous one.
+	//
+	// Parameters:
+	//
+	// [in] pCapture:
+	// Opened capture.
+	//
+	// [in/out] pTime:
+	// Absolute interrupt time at the end of the previous chunk. Initialized with the start time of the header for the first chunk.
+	// Contains the time at the end of the chunk on return.
+	//
+	// [in/out] pResult:
+	// Parsed chunk.
+	void resolveTimes(const Capture* pCapture, uint64_t* pTime, ChunkResult* pResult);
+
+	// Calls a function for every index from zero to count on multiple threads. The calling thread is one of them.
+	//
+	// Parameters:
+	//
+	// [in] threads:
+	// Number of threads.
+	//
+	// [in] count:
+	// Number of indices.
+	//
+	// [in] function:
+	// Called with an index and the number of the thread, from zero to threads - 1. Indices are taken in ascending order.
+	void runParallel(unsigned int threads, size_t count, const std::function<void(size_t, unsigned int)>& function);
+
+	// Parses a capture on multiple threads.
+	//
+	// Parameters:
+	//
+	// [in] path:
+	// Path of the capture.
+	//
+	// [in] threads:
+	// Number of threads. Zero for one per core.
+	//
+	// [out] pResult:
+	// Contains the events in capture order and the statistics of the parse on return.
+	//
+	// Return:
+	// True on success, false if the file could not be mapped or its format is unknown.
+	bool parseFile(const char* path, unsigned int threads, Result* pResult);
+
+	// Gets the name of an event type.
+	//
+	// Parameters:
+	//
+	// [in] type:
+	// Event type.
+	//
+	// Return:
+	// Name of the type in upper case.
+	const char* getTypeName(eventType type);
+
+}
\ No newline at end of file
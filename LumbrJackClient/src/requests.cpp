@@ -1,6 +1,8 @@
 #include "requests.h"
 #include  "..\..\LumbrJackDriver\src\ioctl.h"
 #include <iostream>
+#include <algorithm>
+#include <cstddef>
 
 namespace requests {
 
@@ -12,7 +14,7 @@ namespace requests {
     }
 
 
-    bool startLogging(HANDLE hDevice) {
+    bool startLogging(HANDLE hDevice, const LogConfig* pLogConfig) {
         bool isLogging = false;
 
         if (!getLoggingState(hDevice, &isLogging)) return false;
@@ -23,7 +25,76 @@ namespace requests {
             return false;
         }
 
-        if (!DeviceIoControl(hDevice, IOCTL_LOG_START, nullptr, 0, nullptr, 0, nullptr, nullptr)) return false;
+        if (!DeviceIoControl(hDevice, IOCTL_LOG_START, const_cast<LogConfig*>(pLogConfig), sizeof(*pLogConfig), nullptr, 0, nullptr, nullptr)) return false;
+
+        return true;
+    }
+
+    bool setFilter(HANDLE hDevice, const FilterConfig* pFilterConfig) {
+        bool isLogging = false;
+
+        if (!getLoggingState(hDevice, &isLogging)) return false;
+
+        if (isLogging) {
+            std::cout << "Driver already logging." << std::endl;
+
+            return false;
+        }
+
+        if (!DeviceIoControl(hDevice, IOCTL_SET_FILTER, const_cast<FilterConfig*>(pFilterConfig), sizeof(*pFilterConfig), nullptr, 0, nullptr, nullptr)) return false;
+
+        return true;
+    }
+
+    bool getSources(HANDLE hDevice, SourceList* pSourceList) {
+
+        if (!DeviceIoControl(hDevice, IOCTL_GET_SOURCES, nullptr, 0, pSourceList, sizeof(*pSourceList), nullptr, nullptr)) return false;
+
+        return true;
+    }
+
+    bool enableSource(HANDLE hDevice, USHORT id, bool isEnabled) {
+        SourceSelection sourceSelection{ id, isEnabled };
+
+        if (!DeviceIoControl(hDevice, IOCTL_ENABLE_SOURCE, &sourceSelection, sizeof(sourceSelection), nullptr, 0, nullptr, nullptr)) return false;
+
+        return true;
+    }
+
+    bool setTrace(HANDLE hDevice, const TraceConfig* pTraceConfig) {
+
+        if (!DeviceIoControl(hDevice, IOCTL_SET_TRACE, const_cast<TraceConfig*>(pTraceConfig), sizeof(*pTraceConfig), nullptr, 0, nullptr, nullptr)) return false;
+
+        return true;
+    }
+
+    bool readTrace(HANDLE hDevice, std::vector<TraceRecord>* pRecords) {
+        const size_t maxCount = static_cast<size_t>(GetActiveProcessorCount(ALL_PROCESSOR_GROUPS)) * TRACE_RECORDS_PER_CPU;
+        std::vector<BYTE> buffer(offsetof(TraceSnapshot, records) + maxCount * sizeof(TraceRecord));
+        DWORD bytesReturned = 0;
+
+        if (!DeviceIoControl(hDevice, IOCTL_READ_TRACE, nullptr, 0, buffer.data(), static_cast<DWORD>(buffer.size()), &bytesReturned, nullptr)) return false;
+
+        const TraceSnapshot* const pTraceSnapshot = reinterpret_cast<const TraceSnapshot*>(buffer.data());
+        const size_t count = std::min<size_t>(pTraceSnapshot->count, maxCount);
+        pRecords->assign(pTraceSnapshot->records, pTraceSnapshot->records + count);
+
+        return true;
+    }
+
+    bool injectInput(HANDLE hDevice, const InjectConfig* pInjectConfig, InjectReport* pInjectReport) {
+        bool isLogging = false;
+
+        if (!getLoggingState(hDevice, &isLogging)) return false;
+
+        if (!isLogging) {
+            std::cout << "Driver not logging." << std::endl;
+
+            return false;
+        }
+
+        // the driver returns once the injected input is logged
+        if (!DeviceIoControl(hDevice, IOCTL_INJECT_INPUT, const_cast<InjectConfig*>(pInjectConfig), sizeof(*pInjectConfig), pInjectReport, sizeof(*pInjectReport), nullptr, nullptr)) return false;
 
         return true;
     }
@@ -1,5 +1,7 @@
 #pragma once
+#include "..\..\LumbrJackDriver\src\ioctl.h"
 #include <Windows.h>
+#include <vector>
 
 // Handles interaction with the driver.
 
@@ -25,9 +27,96 @@ namespace requests {
 	// [in] hDevice:
 	// Handle to the communication device of the driver.
 	//
+	// [in] pLogConfig:
+	// Configuration of the logging session.
+	//
+	// Return:
+	// True on succcess, false on failure.
+	bool startLogging(HANDLE hDevice, const LogConfig* pLogConfig);
+
+	// Sets the input filter of the driver. Only possible while the driver is not logging.
+	//
+	// Parameters:
+	// [in] hDevice:
+	// Handle to the communication device of the driver.
+	//
+	// [in] pFilterConfig:
+	// Configuration of the input filter.
+	//
+	// Return:
+	// True on succcess, false on failure.
+	bool setFilter(HANDLE hDevice, const FilterConfig* pFilterConfig);
+
+	// Gets the input sources the driver is attached to.
+	//
+	// Parameters:
+	// [in] hDevice:
+	// Handle to the communication device of the driver.
+	//
+	// [out] pSourceList:
+	// Contains the sources on return.
+	//
+	// Return:
+	// True on succcess, false on failure.
+	bool getSources(HANDLE hDevice, SourceList* pSourceList);
+
+	// Enables or disables capture of an input source.
+	//
+	// Parameters:
+	// [in] hDevice:
+	// Handle to the communication device of the driver.
+	//
+	// [in] id:
+	// ID of the source.
+	//
+	// [in] isEnabled:
+	// New state of the source.
+	//
+	// Return:
+	// True on succcess, false on failure.
+	bool enableSource(HANDLE hDevice, USHORT id, bool isEnabled);
+
+	// Sets the traced level and categories of the driver.
+	//
+	// Parameters:
+	// [in] hDevice:
+	// Handle to the communication device of the driver.
+	//
+	// [in] pTraceConfig:
+	// Configuration of the tracing.
+	//
+	// Return:
+	// True on succcess, false on failure.
+	bool setTrace(HANDLE hDevice, const TraceConfig* pTraceConfig);
+
+	// Reads the trace records of the driver.
+	//
+	// Parameters:
+	// [in] hDevice:
+	// Handle to the communication device of the driver.
+	//
+	// [out] pRecords:
+	// Contains the trace records of all processors on return.
+	//
+	// Return:
+	// True on succcess, false on failure.
+	bool readTrace(HANDLE hDevice, std::vector<TraceRecord>* pRecords);
+
+	// Injects synthetic input into the running logging session and waits until it is logged.
+	//
+	// Parameters:
+	// [in] hDevice:
+	// Handle to the communication device of the driver.
+	//
+	// [in] pInjectConfig:
+	// Number, rate and batch size of the input events.
+	//
+	// [out] pInjectReport:
+	// Contains the achieved rate, the drops and the times of the injection on return.
+	//
 	// Return:
 	// True on succcess, false on failure.
-	bool startLogging(HANDLE hDevice);
+	bool injectInput(HANDLE hDevice, const InjectConfig* pInjectConfig, InjectReport* pInjectReport);
 
 	// Stops logging in the driver.
 	//
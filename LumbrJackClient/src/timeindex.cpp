@@ -0,0 +1,223 @@
+#include "timeindex.h"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+
+namespace timeindex {
+
+    static bool findEntry(const char* path, uint64_t startTime, const Range* pRange, Entry* pEntry);
+    static bool readEntry(std::ifstream* pFile, const Header* pHeader, uint64_t index, Entry* pEntry);
+    static bool isBeforeRange(const Entry* pEntry, uint64_t startTime, const Range* pRange);
+    static uint64_t getFileSize(const char* path);
+
+    std::string getIndexPath(const char* path) {
+
+        return std::string(path) + ".idx";
+    }
+
+
+    bool build(const char* path, const uint8_t* key, Header* pHeader) {
+        // the record block is too large for the stack
+        decoder::Reader* const pReader = new decoder::Reader();
+
+        if (!decoder::open(pReader, path, key)) {
+            delete pReader;
+
+            return false;
+        }
+
+        const std::string indexPath = getIndexPath(path);
+        std::ofstream file(indexPath, std::ios::binary | std::ios::trunc);
+
+        if (!file) {
+            delete pReader;
+
+            return false;
+        }
+
+        *pHeader = Header{};
+        pHeader->magic = INDEX_MAGIC;
+        pHeader->version = INDEX_VERSION;
+        pHeader->headerSize = sizeof(Header);
+        pHeader->entrySize = sizeof(Entry);
+        pHeader->interval = INDEX_INTERVAL;
+        pHeader->logSize = getFileSize(path);
+        pHeader->startTime = pReader->header.startTime;
+        // rewritten with the counts once all entries are written
+        file.write(reinterpret_cast<const char*>(pHeader), sizeof(Header));
+
+        // records are read one by one, so the position of every record is known
+        decompress::Stream* const pStream = &pReader->stream;
+        uint64_t offset = pReader->header.headerSize;
+        uint64_t nextEntryOffset = offset;
+        uint64_t time = pReader->header.startTime;
+        uint64_t latestTime = 0;
+        uint64_t ordinal = 0;
+        // records of version 1 are shorter
+        const size_t recordSize = pReader->header.recordSize;
+        InputRecord record{};
+
+        while (true) {
+
+            if (offset >= nextEntryOffset) {
+                Entry entry{};
+                entry.time = time;
+                entry.latestTime = latestTime;
+                entry.ordinal = ordinal;
+                decompress::tell(pStream, &entry.position);
+                file.write(reinterpret_cast<const char*>(&entry), sizeof(entry));
+                pHeader->entryCount++;
+                nextEntryOffset = offset - offset % INDEX_INTERVAL + INDEX_INTERVAL;
+            }
+
+            if (decompress::read(pStream, &record, recordSize) != recordSize) break;
+
+            offset += recordSize;
+
+            if (record.type == RECORD_TYPE_TIME) {
+                time = record.time.time;
+
+                continue;
+            }
+
+            time += record.timeDelta;
+
+            if (record.type == RECORD_TYPE_KBD || record.type == RECORD_TYPE_MOU) {
+                latestTime = std::max(latestTime, time);
+                ordinal++;
+            }
+
+        }
+
+        pHeader->recordCount = ordinal;
+        file.seekp(0, std::ios::beg);
+        file.write(reinterpret_cast<const char*>(pHeader), sizeof(Header));
+        const bool isValid = !pStream->isCorrupt && static_cast<bool>(file);
+        delete pReader;
+        file.close();
+
+        // an index of a corrupt file would point into the corrupt block
+        if (!isValid) {
+            std::remove(indexPath.c_str());
+        }
+
+        return isValid;
+    }
+
+
+    bool extract(const char* path, const uint8_t* key, const Range* pRange, decoder::format fmt, std::ostream& out) {
+        // the record block is too large for the stack
+        decoder::Reader* const pReader = new decoder::Reader();
+
+        if (!decoder::open(pReader, path, key)) {
+            delete pReader;
+
+            return false;
+        }
+
+        const uint64_t startTime = pReader->header.startTime;
+        uint64_t ordinal = 0;
+        Entry entry{};
+
+        if (findEntry(path, startTime, pRange, &entry)) {
+
+            if (!decoder::seek(pReader, &entry.position, entry.time)) {
+                delete pReader;
+
+                return false;
+            }
+
+            ordinal = entry.ordinal;
+        }
+
+        if (fmt == decoder::format::CSV) {
+            out << decoder::csvHeader << '\n';
+        }
+
+        const InputRecord* pRecord = nullptr;
+        uint64_t time = 0;
+
+        while (decoder::next(pReader, &pRecord, &time)) {
+            const uint64_t relTime = time > startTime ? time - startTime : 0;
+            const uint64_t recordOrdinal = ordinal++;
+
+            // ordinals are in file order, times are not
+            if (recordOrdinal > pRange->lastRecord) break;
+
+            if (relTime < pRange->fromTime || relTime > pRange->toTime || recordOrdinal < pRange->firstRecord) continue;
+
+            out << decoder::formatRecord(pRecord, relTime, fmt) << '\n';
+        }
+
+        const bool isValid = !pReader->stream.isCorrupt;
+        delete pReader;
+
+        return isValid;
+    }
+
+
+    // Searches the index of a log file for the last entry before the range. Only the entries of the search are read.
+    // Returns false if there is no index or the index is stale.
+    static bool findEntry(const char* path, uint64_t startTime, const Range* pRange, Entry* pEntry) {
+        std::ifstream file(getIndexPath(path), std::ios::binary);
+        Header header{};
+
+        if (!file.read(reinterpret_cast<char*>(&header), sizeof(header))) {
+
+            return false;
+        }
+
+        if (header.magic != INDEX_MAGIC || header.version != INDEX_VERSION || header.headerSize < sizeof(Header) || header.entrySize != sizeof(Entry)
+            || !header.entryCount || header.startTime != startTime || header.logSize != getFileSize(path)) {
+
+            return false;
+        }
+
+        // the first entry is at the first record and always before the range
+        uint64_t low = 0;
+        uint64_t high = header.entryCount;
+
+        while (high - low > 1) {
+            const uint64_t mid = low + (high - low) / 2;
+
+            if (!readEntry(&file, &header, mid, pEntry)) {
+
+                return false;
+            }
+
+            if (isBeforeRange(pEntry, startTime, pRange)) {
+                low = mid;
+            }
+            else {
+                high = mid;
+            }
+
+        }
+
+        return readEntry(&file, &header, low, pEntry);
+    }
+
+
+    static bool readEntry(std::ifstream* pFile, const Header* pHeader, uint64_t index, Entry* pEntry) {
+        pFile->seekg(static_cast<std::streamoff>(pHeader->headerSize + index * pHeader->entrySize), std::ios::beg);
+
+        return static_cast<bool>(pFile->read(reinterpret_cast<char*>(pEntry), sizeof(Entry)));
+    }
+
+
+    // All records before an entry are outside of the range if the entry is before it.
+    static bool isBeforeRange(const Entry* pEntry, uint64_t startTime, const Range* pRange) {
+        // input captured before the file was opened is logged at the start time
+        const uint64_t relTime = pEntry->latestTime > startTime ? pEntry->latestTime - startTime : 0;
+
+        return relTime < pRange->fromTime || pEntry->ordinal <= pRange->firstRecord;
+    }
+
+
+    static uint64_t getFileSize(const char* path) {
+        std::ifstream file(path, std::ios::binary | std::ios::ate);
+
+        return file ? static_cast<uint64_t>(file.tellg()) : 0;
+    }
+
+}
\ No newline at end of file
@@ -0,0 +1,112 @@
+#pragma once
+#include "decoder.h"
+#include "decompress.h"
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+// Sidecar index of binary log files for extracting time or record ranges without reading the whole file.
+// The index of "input.bin" is "input.bin.idx". It maps the time and the ordinal of the records to positions in the log file
+// at fixed intervals of the decompressed data, so a range is found with a binary search over the index.
+// Ordinals number the keyboard and mouse records of a file from zero in file order. They are not the sequence numbers of the sources (SEQ).
+// Times are not strictly in file order, since the input of different processors is logged in the order it reached the queue.
+// Does not depend on Windows headers, so log files can be indexed on any platform.
+namespace timeindex {
+
+	// Magic of index files: "LJIX".
+	constexpr uint32_t INDEX_MAGIC = 0x58494A4C;
+	constexpr uint16_t INDEX_VERSION = 2;
+	// Bytes of decompressed data between two entries. One entry per block of compressed or encrypted files.
+	constexpr uint32_t INDEX_INTERVAL = LZ_BLOCK_SIZE;
+
+	// Header of an index file. Followed by the entries in file order.
+	struct Header {
+		uint32_t magic;
+		uint16_t version;
+		uint16_t headerSize;
+		uint32_t entrySize;
+		uint32_t interval;
+		// Size of the log file when it was indexed. The index of a log file of a different size is stale.
+		uint64_t logSize;
+		// Start time of the log file.
+		uint64_t startTime;
+		uint64_t entryCount;
+		// Keyboard and mouse records of the log file.
+		uint64_t recordCount;
+	};
+
+	// Position of the first record at or after an interval.
+	struct Entry {
+		// Absolute interrupt time of the last record before the position. The time the deltas after the position are relative to.
+		uint64_t time;
+		// Latest absolute interrupt time of all keyboard and mouse records before the position.
+		uint64_t latestTime;
+		// Number of keyboard and mouse records before the position, which is the ordinal of the first record after it.
+		uint64_t ordinal;
+		decompress::Position position;
+	};
+
+	// Range of records to extract. Records have to be within both the time and the sequence range.
+	struct Range {
+		// Ticks since the start of the log file, inclusive.
+		uint64_t fromTime;
+		uint64_t toTime;
+		// Ordinals of the records, inclusive.
+		uint64_t firstRecord;
+		uint64_t lastRecord;
+	};
+
+	// Gets the path of the index of a log file.
+	//
+	// Parameters:
+	//
+	// [in] path:
+	// Path of the log file.
+	//
+	// Return:
+	// Path of the index file.
+	std::string getIndexPath(const char* path);
+
+	// Reads a binary log file once and writes its index next to it. An existing index is overwritten.
+	//
+	// Parameters:
+	//
+	// [in] path:
+	// Path of the log file.
+	//
+	// [in] key:
+	// Key of CIPHER_KEY_SIZE bytes for encrypted files. Can be nullptr for files that are not encrypted.
+	//
+	// [out] pHeader:
+	// Contains the header of the written index on return.
+	//
+	// Return:
+	// True on success, false if the log file is invalid or corrupt or the index could not be written.
+	bool build(const char* path, const uint8_t* key, Header* pHeader);
+
+	// Decodes the records of a binary log file within a range and writes them line by line.
+	// Seeks to the range with the index of the log file. Without a valid index the file is read from the start.
+	// Records outside of the time range are skipped, reading stops at the first record after the range of ordinals.
+	//
+	// Parameters:
+	//
+	// [in] path:
+	// Path of the log file.
+	//
+	// [in] key:
+	// Key of CIPHER_KEY_SIZE bytes for encrypted files. Can be nullptr for files that are not encrypted.
+	//
+	// [in] pRange:
+	// Range of records to decode.
+	//
+	// [in] fmt:
+	// Output format. CSV output starts with a header line.
+	//
+	// [out] out:
+	// Stream the lines are written to.
+	//
+	// Return:
+	// True on success, false if the file could not be opened, is invalid or contains a corrupt block.
+	bool extract(const char* path, const uint8_t* key, const Range* pRange, decoder::format fmt, std::ostream& out);
+
+}
\ No newline at end of file
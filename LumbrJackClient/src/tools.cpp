@@ -0,0 +1,15 @@
+#include "commands.h"
+#include <iostream>
+
+// Entry point of the log tools on platforms the driver does not run on, e.g. for post-processing captures on Linux.
+// Runs the same commands as the client: lumbrjack-tools <command> ...
+int main(int argc, char* argv[]) {
+
+    if (argc < 2 || !commands::isCommand(argv[1])) {
+        std::cout << "Please specify a command: decode, decompress, keys, index, extract, gaps, parse, heatmap, histogram, export, query, merge or follow." << std::endl;
+
+        return 1;
+    }
+
+    return commands::run(argc - 1, argv + 1);
+}
\ No newline at end of file
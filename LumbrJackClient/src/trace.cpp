@@ -0,0 +1,91 @@
+#include "trace.h"
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+
+namespace trace {
+
+    static const char* const levelStrings[TRACE_LEVEL_MAX]{ "OFF", "ERROR", "WARNING", "INFO", "VERBOSE" };
+    static const char* const typeStrings[]{ "keyboard", "mouse" };
+
+    // KEY_BREAK, KEY_E0 and KEY_E1 of ntddkbd.h
+    static const ULONG keyBreak = 0x1;
+    static const ULONG keyE0 = 0x2;
+    static const ULONG keyE1 = 0x4;
+
+    static const char* getTypeString(ULONG type);
+
+    std::string formatRecord(const TraceRecord* pRecord, ULONGLONG startTime) {
+        std::ostringstream stream;
+        const ULONGLONG time = pRecord->time - startTime;
+        const char* const strLevel = pRecord->level < TRACE_LEVEL_MAX ? levelStrings[pRecord->level] : "?";
+
+        // interrupt time is in 100 ns units
+        stream << std::setw(8) << time / 10000 << '.' << std::setfill('0') << std::setw(4) << time % 10000 << std::setfill(' ')
+            << " CPU" << static_cast<unsigned int>(pRecord->cpu) << ' ' << strLevel << ' ';
+
+        switch (pRecord->point) {
+        case TRACE_POINT_KBD_INPUT:
+            stream << "Keyboard input: source " << pRecord->args[0] << " make code 0x" << std::hex << pRecord->args[1]
+                << (pRecord->args[2] & keyBreak ? " break" : " make") << (pRecord->args[2] & keyE0 ? " E0" : "") << (pRecord->args[2] & keyE1 ? " E1" : "")
+                << std::dec << " unit " << pRecord->args[3];
+            break;
+        case TRACE_POINT_MOU_INPUT:
+            stream << "Mouse input: source " << pRecord->args[0] << " buttons 0x" << std::hex << (pRecord->args[1] & 0xFFFF) << std::dec
+                << " data " << static_cast<SHORT>(pRecord->args[1] >> 16) << " x " << static_cast<LONG>(pRecord->args[2]) << " y " << static_cast<LONG>(pRecord->args[3]);
+            break;
+        case TRACE_POINT_FILTERED:
+            stream << "Filtered " << getTypeString(pRecord->args[0]) << " input: source " << pRecord->args[1];
+            break;
+        case TRACE_POINT_ALLOC_FAILED:
+            stream << "Allocation failed for " << getTypeString(pRecord->args[0]) << " input: source " << pRecord->args[1];
+            break;
+        case TRACE_POINT_ENQUEUE_FAILED:
+            stream << "Enqueue failed for " << getTypeString(pRecord->args[0]) << " input: source " << pRecord->args[1] << " status 0x" << std::hex << pRecord->args[2] << std::dec;
+            break;
+        case TRACE_POINT_DEVICE_REMOVED:
+            stream << "Device removed: source " << pRecord->args[0] << " type " << pRecord->args[1];
+            break;
+        case TRACE_POINT_READ_SKIPPED:
+            stream << "Read skipped with " << pRecord->args[2] << ' ' << getTypeString(pRecord->args[0]) << " inputs: source " << pRecord->args[1];
+            break;
+        default:
+            stream << "Unknown trace point " << pRecord->point;
+            break;
+        }
+
+        return stream.str();
+    }
+
+
+    void printRecords(std::vector<TraceRecord>* pRecords) {
+        
+        // records are ordered by processor, the sequence keeps the order of records with equal times on a processor
+        std::sort(pRecords->begin(), pRecords->end(), [](const TraceRecord& a, const TraceRecord& b) {
+
+            return a.time != b.time ? a.time < b.time : a.cpu != b.cpu ? a.cpu < b.cpu : a.sequence < b.sequence;
+        });
+
+        if (pRecords->empty()) {
+            std::cout << "No trace records." << std::endl;
+
+            return;
+        }
+
+        const ULONGLONG startTime = pRecords->front().time;
+
+        for (const TraceRecord& record : *pRecords) {
+            std::cout << formatRecord(&record, startTime) << std::endl;
+        }
+
+        return;
+    }
+
+
+    static const char* getTypeString(ULONG type) {
+
+        return type < sizeof(typeStrings) / sizeof(typeStrings[0]) ? typeStrings[type] : "unknown";
+    }
+
+}
\ No newline at end of file
@@ -0,0 +1,31 @@
+#pragma once
+#include "../../LumbrJackDriver/src/ioctl.h"
+#include <string>
+#include <vector>
+
+// Decodes the binary trace records of the driver.
+namespace trace {
+
+	// Formats a trace record as a line of text without a line break.
+	// 
+	// Parameters:
+	// 
+	// [in] pRecord:
+	// Record to format.
+	//
+	// [in] startTime:
+	// Interrupt time the time of the record is printed relative to.
+	//
+	// Return:
+	// The formatted record.
+	std::string formatRecord(const TraceRecord* pRecord, ULONGLONG startTime);
+
+	// Sorts trace records by time and prints them.
+	// 
+	// Parameters:
+	// 
+	// [in/out] pRecords:
+	// Records to print. Sorted by time on return.
+	void printRecords(std::vector<TraceRecord>* pRecords);
+
+}
\ No newline at end of file
@@ -2,9 +2,10 @@
 #include "debug.h"
 
 void initBlockingQueue(BlockingQueue* pBlockingQueue, LONG maxSize) {
-	KeInitializeSemaphore(&pBlockingQueue->semaphoreAdd, maxSize, maxSize);
-	KeInitializeSemaphore(&pBlockingQueue->semaphoreRemove, 0, maxSize);
-	KeInitializeSpinLock(&pBlockingQueue->spinLock);
+	platformInitSemaphore(&pBlockingQueue->semaphoreAdd, maxSize, maxSize);
+	// one more for the wake-up of a closed queue
+	platformInitSemaphore(&pBlockingQueue->semaphoreRemove, 0, maxSize + 1);
+	platformInitLock(&pBlockingQueue->spinLock);
 	InitializeListHead(&pBlockingQueue->head);
 	pBlockingQueue->size = 0;
 	pBlockingQueue->isWaiting = TRUE;
@@ -12,102 +13,127 @@ void initBlockingQueue(BlockingQueue* pBlockingQueue, LONG maxSize) {
 
 
 NTSTATUS addToBlockigQueue(BlockingQueue* pBlockingQueue, LIST_ENTRY* pListEntry) {
-	NTSTATUS ntStatus = STATUS_SUCCESS;
-	const KIRQL curIrql = KeGetCurrentIrql();
-
-	if (curIrql == DISPATCH_LEVEL) {
-		// timeout needs to be zero at IRQL >= DISPATCH_LEVEL
-		LARGE_INTEGER zeroTimeout = { .QuadPart = 0 };
-		ntStatus = KeWaitForSingleObject(&pBlockingQueue->semaphoreAdd, Executive, KernelMode, FALSE, &zeroTimeout);
-		
-		if (!NT_SUCCESS(ntStatus)) {
-			DBG_PRINTF("addToBlockigQueue: KeWaitForSingleObject failed: 0x%lx\n", ntStatus);
-
-			return ntStatus;
-		}
-		else if (ntStatus == STATUS_TIMEOUT) {
-			DBG_PRINT("addToBlockigQueue: KeWaitForSingleObject timeout\n");
-
-			return ntStatus;
-		}
-
-		KeAcquireSpinLockAtDpcLevel(&pBlockingQueue->spinLock);
-		InsertTailList(&pBlockingQueue->head, pListEntry);
-		pBlockingQueue->size++;
-		KeReleaseSpinLockFromDpcLevel(&pBlockingQueue->spinLock);
-
-		KeReleaseSemaphore(&pBlockingQueue->semaphoreRemove, 0, 1, FALSE);
+	const KIRQL curIrql = platformGetIrql();
+
+	if (curIrql > DISPATCH_LEVEL) {
+		DBG_PRINT("addToBlockigQueue: IRQL too high\n");
+
+		return STATUS_INVALID_DEVICE_STATE;
 	}
-	else if (curIrql < DISPATCH_LEVEL) {
-		ntStatus = KeWaitForSingleObject(&pBlockingQueue->semaphoreAdd, Executive, KernelMode, FALSE, NULL);
 
-		if (!NT_SUCCESS(ntStatus)) {
-			DBG_PRINTF("addToBlockigQueue: KeWaitForSingleObject failed: 0x%lx\n", ntStatus);
+	// only waits below DISPATCH_LEVEL, otherwise times out immediately if the queue is full
+	const NTSTATUS ntStatus = platformWaitSemaphore(&pBlockingQueue->semaphoreAdd, curIrql < DISPATCH_LEVEL);
 
-			return ntStatus;
-		}
+	if (!NT_SUCCESS(ntStatus)) {
+		DBG_PRINTF("addToBlockigQueue: platformWaitSemaphore failed: 0x%lx\n", ntStatus);
 
-		KeAcquireSpinLockRaiseToDpc(&pBlockingQueue->spinLock);
-		InsertTailList(&pBlockingQueue->head, pListEntry);
-		pBlockingQueue->size++;
-		KeReleaseSpinLock(&pBlockingQueue->spinLock, curIrql);
+		return ntStatus;
+	}
+	else if (ntStatus == STATUS_TIMEOUT) {
+		DBG_PRINT("addToBlockigQueue: platformWaitSemaphore timeout\n");
 
-		KeReleaseSemaphore(&pBlockingQueue->semaphoreRemove, 0, 1, FALSE);
+		return ntStatus;
 	}
-	else {
-		DBG_PRINT("addToBlockigQueue: IRQL too high\n");
+
+	const KIRQL oldIrql = platformAcquireLock(&pBlockingQueue->spinLock);
+
+	// checked under the lock, so no item is added after the consumer saw the end of the queue
+	if (!pBlockingQueue->isWaiting) {
+		platformReleaseLock(&pBlockingQueue->spinLock, oldIrql);
+		platformReleaseSemaphore(&pBlockingQueue->semaphoreAdd);
+		DBG_PRINT("addToBlockigQueue: Queue closed\n");
+
+		return STATUS_PIPE_CLOSING;
 	}
 
+	InsertTailList(&pBlockingQueue->head, pListEntry);
+	pBlockingQueue->size++;
+	platformReleaseLock(&pBlockingQueue->spinLock, oldIrql);
+
+	platformReleaseSemaphore(&pBlockingQueue->semaphoreRemove);
+
 	return ntStatus;
 }
 
 
 NTSTATUS removeFromBlockingQueue(BlockingQueue* pBlockingQueue, LIST_ENTRY** ppListEntry) {
-	NTSTATUS ntStatus = STATUS_SUCCESS;
-	const KIRQL curIrql = KeGetCurrentIrql();
+	const KIRQL curIrql = platformGetIrql();
 
-	if (curIrql == DISPATCH_LEVEL) {
-		// timeout needs to be zero at IRQL >= DISPATCH_LEVEL
-		LARGE_INTEGER zeroTimeout = { .QuadPart = 0 };
-		ntStatus = KeWaitForSingleObject(&pBlockingQueue->semaphoreRemove, Executive, KernelMode, FALSE, &zeroTimeout);
+	if (curIrql > DISPATCH_LEVEL) {
+		DBG_PRINT("removeFromBlockingQueue: IRQL too high\n");
 
-		if (!NT_SUCCESS(ntStatus)) {
-			DBG_PRINTF("removeFromBlockingQueue: KeWaitForSingleObject failed: 0x%lx\n", ntStatus);
+		return STATUS_INVALID_DEVICE_STATE;
+	}
 
-			return ntStatus;
-		}
-		else if (ntStatus == STATUS_TIMEOUT) {
-			DBG_PRINT("removeFromBlockingQueue: KeWaitForSingleObject timeout\n");
+	// only waits below DISPATCH_LEVEL, otherwise times out immediately if the queue is empty
+	const NTSTATUS ntStatus = platformWaitSemaphore(&pBlockingQueue->semaphoreRemove, curIrql < DISPATCH_LEVEL);
 
-			return ntStatus;
-		}
+	if (!NT_SUCCESS(ntStatus)) {
+		DBG_PRINTF("removeFromBlockingQueue: platformWaitSemaphore failed: 0x%lx\n", ntStatus);
 
-		KeAcquireSpinLockAtDpcLevel(&pBlockingQueue->spinLock);
-		*ppListEntry = RemoveHeadList(&pBlockingQueue->head);
-		pBlockingQueue->size--;
-		KeReleaseSpinLockFromDpcLevel(&pBlockingQueue->spinLock);
+		return ntStatus;
+	}
+	else if (ntStatus == STATUS_TIMEOUT) {
+		DBG_PRINT("removeFromBlockingQueue: platformWaitSemaphore timeout\n");
 
-		KeReleaseSemaphore(&pBlockingQueue->semaphoreAdd, 0, 1, FALSE);
+		return ntStatus;
 	}
-	else if (curIrql < DISPATCH_LEVEL) {
-		ntStatus = KeWaitForSingleObject(&pBlockingQueue->semaphoreRemove, Executive, KernelMode, FALSE, NULL);
 
-		if (!NT_SUCCESS(ntStatus)) {
-			DBG_PRINTF("removeFromBlockingQueue: KeWaitForSingleObject failed: 0x%lx\n", ntStatus);
+	const KIRQL oldIrql = platformAcquireLock(&pBlockingQueue->spinLock);
 
-			return ntStatus;
-		}
+	// only the wake-up of a closed queue is left
+	if (IsListEmpty(&pBlockingQueue->head)) {
+		platformReleaseLock(&pBlockingQueue->spinLock, oldIrql);
+		// kept for the next call, so the end of the queue is reported again
+		platformReleaseSemaphore(&pBlockingQueue->semaphoreRemove);
 
-		KeAcquireSpinLockRaiseToDpc(&pBlockingQueue->spinLock);
-		*ppListEntry = RemoveHeadList(&pBlockingQueue->head);
-		pBlockingQueue->size--;
-		KeReleaseSpinLock(&pBlockingQueue->spinLock, curIrql);
+		return STATUS_NO_MORE_ENTRIES;
+	}
+
+	*ppListEntry = RemoveHeadList(&pBlockingQueue->head);
+	pBlockingQueue->size--;
+	platformReleaseLock(&pBlockingQueue->spinLock, oldIrql);
 
-		KeReleaseSemaphore(&pBlockingQueue->semaphoreAdd, 0, 1, FALSE);
+	platformReleaseSemaphore(&pBlockingQueue->semaphoreAdd);
+
+	return ntStatus;
+}
+
+
+void openBlockingQueue(BlockingQueue* pBlockingQueue) {
+	const KIRQL oldIrql = platformAcquireLock(&pBlockingQueue->spinLock);
+
+	if (!pBlockingQueue->isWaiting) {
+		// takes back the wake-up of the close, which is available since closed queues do not wait
+		platformWaitSemaphore(&pBlockingQueue->semaphoreRemove, FALSE);
+		pBlockingQueue->isWaiting = TRUE;
 	}
-	else {
-		DBG_PRINT("removeFromBlockingQueue: IRQL too high\n");
+
+	platformReleaseLock(&pBlockingQueue->spinLock, oldIrql);
+
+	return;
+}
+
+
+void closeBlockingQueue(BlockingQueue* pBlockingQueue) {
+	const KIRQL oldIrql = platformAcquireLock(&pBlockingQueue->spinLock);
+	const BOOLEAN wasOpen = pBlockingQueue->isWaiting;
+	pBlockingQueue->isWaiting = FALSE;
+	platformReleaseLock(&pBlockingQueue->spinLock, oldIrql);
+
+	// wakes up the consumer once it removed all items
+	if (wasOpen) {
+		platformReleaseSemaphore(&pBlockingQueue->semaphoreRemove);
 	}
 
-	return ntStatus;
+	return;
+}
+
+
+ULONGLONG getBlockingQueueSize(BlockingQueue* pBlockingQueue) {
+	const KIRQL oldIrql = platformAcquireLock(&pBlockingQueue->spinLock);
+	const ULONGLONG size = pBlockingQueue->size;
+	platformReleaseLock(&pBlockingQueue->spinLock, oldIrql);
+
+	return size;
 }
\ No newline at end of file
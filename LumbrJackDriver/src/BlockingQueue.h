@@ -1,18 +1,25 @@
 #pragma once
-#include <ntddk.h>
+#include "platform.h"
 
 // Blocking queue implementation for producer-consumer problem when writing keyboard input to a file
+// Built on the platform layer, so it is part of the user mode build of the driver core.
+// A queue is closed to stop its consumer: closed queues reject new items, while the items already queued are still removed.
+// Once a closed queue is empty, removing fails with STATUS_NO_MORE_ENTRIES instead of waiting, so the consumer can not miss the end of the queue.
 
 typedef struct BlockingQueue {
-	KSEMAPHORE semaphoreAdd;
-	KSEMAPHORE semaphoreRemove;
-	KSPIN_LOCK spinLock;
+	PlatformSemaphore semaphoreAdd;
+	// Counts the items plus one while the queue is closed, so the consumer is woken up for the end of the queue.
+	PlatformSemaphore semaphoreRemove;
+	PlatformLock spinLock;
 	LIST_ENTRY head;
+	// Protected by the lock like the list.
 	ULONGLONG size;
+	// Cleared while the queue is closed. Protected by the lock like the list.
 	BOOLEAN isWaiting;
 }BlockingQueue;
 
-// Initializes the blocking queue.
+// Initializes the blocking queue. The queue is open.
+// Must not be called while the queue is in use, so queues that are reused are opened and closed instead.
 //
 // Parameters:
 // 
@@ -25,8 +32,9 @@ void initBlockingQueue(BlockingQueue* pBlockingQueue, LONG maxSize);
 
 // Adds an item to the blocking queue.
 // If the queue is full the calling thread will wait if IRQL < DISPTACH_LEVEL.
+// If the queue is closed it fails with STATUS_PIPE_CLOSING without adding the item.
 // For IRQL == DISPATCH_LEVEL the function times out immediately without adding the item.
-// For IRQL > DISPATCH_LEVEL it fails without adding the item.
+// For IRQL > DISPATCH_LEVEL it fails with STATUS_INVALID_DEVICE_STATE without adding the item.
 // This is due to limitations of KeWaitForSingleObject.
 // 
 // Parameters:
@@ -40,8 +48,9 @@ NTSTATUS addToBlockigQueue(BlockingQueue* pBlockingQueue, LIST_ENTRY* pListEntry
 
 // Removes an item from the blocking queue.
 // If the queue is empty the calling thread will wait if IRQL < DISPTACH_LEVEL.
+// If the queue is closed and empty it fails with STATUS_NO_MORE_ENTRIES immediately.
 // For IRQL == DISPATCH_LEVEL the function times out immediately without removing the item.
-// For IRQL > DISPATCH_LEVEL the function fails without removing the item.
+// For IRQL > DISPATCH_LEVEL the function fails with STATUS_INVALID_DEVICE_STATE without removing the item.
 // This is due to limitations of KeWaitForSingleObject.
 // 
 // Parameters:
@@ -53,3 +62,34 @@ NTSTATUS addToBlockigQueue(BlockingQueue* pBlockingQueue, LIST_ENTRY* pListEntry
 // Contains the Address of the ListEntry struct of the removed item on return.
 NTSTATUS removeFromBlockingQueue(BlockingQueue* pBlockingQueue, LIST_ENTRY** ppListEntry);
 
+
+
+// Opens a closed blocking queue, so items can be added again. Items left in the queue are kept.
+// Can be called at IRQL <= DISPATCH_LEVEL.
+//
+// Parameters:
+//
+// [in/out] pBlockingQueue:
+// Address of the blocking queue to open.
+void openBlockingQueue(BlockingQueue* pBlockingQueue);
+
+// Closes a blocking queue. Items that are added afterwards are rejected and a waiting consumer is woken up.
+// The consumer removes the items that are already queued and then gets STATUS_NO_MORE_ENTRIES.
+// Does not wait and can be called at IRQL <= DISPATCH_LEVEL. Closing a closed queue has no effect.
+//
+// Parameters:
+//
+// [in/out] pBlockingQueue:
+// Address of the blocking queue to close.
+void closeBlockingQueue(BlockingQueue* pBlockingQueue);
+
+// Gets the number of items in a blocking queue. Can be called at IRQL <= DISPATCH_LEVEL.
+//
+// Parameters:
+//
+// [in/out] pBlockingQueue:
+// Address of the blocking queue.
+//
+// Return:
+// Number of items at the time of the call.
+ULONGLONG getBlockingQueueSize(BlockingQueue* pBlockingQueue);
\ No newline at end of file
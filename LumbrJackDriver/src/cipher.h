@@ -0,0 +1,27 @@
+#pragma once
+// Encryption of log files with AES-256-GCM.
+// Only fixed size types are used, so the format is shared with the decryptor of the client.
+// All values are little endian.
+//
+// An encrypted file starts with a CipherFileHeader followed by blocks.
+// Every block consists of an LzBlockHeader (see lz.h), the encrypted data of the block and the authentication tag.
+// The additional data of a block is the file header followed by the block header, so the flags of the file and LZ_BLOCK_FINAL of the last block are authenticated.
+// Files without a final block are rejected, so truncation at a block boundary is detected like a modified block.
+// The 96 bit nonce of a block is the nonce prefix of the file followed by the 32 bit block index starting at zero.
+#include <stdint.h>
+
+// "LJBE"
+#define CIPHER_FILE_MAGIC 0x45424A4C
+#define CIPHER_KEY_SIZE 0x20
+#define CIPHER_NONCE_SIZE 0xC
+#define CIPHER_TAG_SIZE 0x10
+
+// The data of the blocks is compressed (see lz.h). Blocks with equal sizes in their header are stored uncompressed.
+#define CIPHER_FLAG_COMPRESSED 0x1
+
+typedef struct CipherFileHeader {
+	uint32_t magic;
+	uint32_t flags;
+	// Random per file, so a key can be reused for several files.
+	uint64_t noncePrefix;
+}CipherFileHeader;
\ No newline at end of file
@@ -0,0 +1,215 @@
+#include "compact.h"
+#include "record.h"
+
+static ULONG getKeyStateIndex(const KEYBOARD_INPUT_DATA* pKbdInputData);
+static void getKeyStateInput(ULONG index, PKEYBOARD_INPUT_DATA pKbdInputData);
+static BOOLEAN isModifier(const KEYBOARD_INPUT_DATA* pKbdInputData);
+
+void resetKbdCompaction(KbdCompaction* pKbdCompaction) {
+	RtlZeroMemory(pKbdCompaction, sizeof(KbdCompaction));
+
+	return;
+}
+
+
+BOOLEAN compactKbdInput(KbdCompaction* pKbdCompaction, PKEYBOARD_INPUT_DATA pKbdInputData, ULONGLONG time, ULONG* pRepeatCount, ULONGLONG* pHoldTime) {
+	KeyState* const pKeyState = &pKbdCompaction->keyStates[getKeyStateIndex(pKbdInputData)];
+	const BOOLEAN isPaired = !isModifier(pKbdInputData);
+	*pRepeatCount = 0;
+	*pHoldTime = 0;
+
+	if (!(pKbdInputData->Flags & KEY_BREAK)) {
+
+		// a make code of a held key is a typematic repeat
+		if (pKeyState->pressTime) {
+			pKeyState->repeatCount++;
+
+			return FALSE;
+		}
+
+		// interrupt time is never zero after boot, so zero marks a released key
+		pKeyState->pressTime = time ? time : 1;
+		pKeyState->repeatCount = 0;
+
+		// modifiers are logged when they are pressed, so they precede the keys they modify
+		return !isPaired;
+	}
+
+	if (pKeyState->pressTime) {
+		*pRepeatCount = pKeyState->repeatCount;
+		*pHoldTime = time - pKeyState->pressTime;
+		pKeyState->pressTime = 0;
+		pKeyState->repeatCount = 0;
+
+		// the flag tells pairs apart from presses, since the hold time of a pair can round down to zero
+		if (isPaired) {
+			pKbdInputData->Flags &= ~KEY_BREAK;
+			pKbdInputData->Flags |= RECORD_KBD_PAIRED;
+		}
+
+	}
+
+	return TRUE;
+}
+
+
+BOOLEAN flushKbdCompaction(KbdCompaction* pKbdCompaction, PKEYBOARD_INPUT_DATA pKbdInputData, ULONG* pRepeatCount, ULONGLONG* pPressTime) {
+	KeyState* pFirstKeyState = NULL;
+	ULONG firstIndex = 0;
+
+	for (ULONG i = 0; i < KEY_STATE_COUNT; i++) {
+		KeyState* const pKeyState = &pKbdCompaction->keyStates[i];
+
+		if (!pKeyState->pressTime) continue;
+
+		getKeyStateInput(i, pKbdInputData);
+
+		if (isModifier(pKbdInputData)) continue;
+
+		// the presses are taken in the order they happened
+		if (!pFirstKeyState || pKeyState->pressTime < pFirstKeyState->pressTime) {
+			pFirstKeyState = pKeyState;
+			firstIndex = i;
+		}
+
+	}
+
+	if (!pFirstKeyState) {
+		resetKbdCompaction(pKbdCompaction);
+
+		return FALSE;
+	}
+
+	RtlZeroMemory(pKbdInputData, sizeof(KEYBOARD_INPUT_DATA));
+	getKeyStateInput(firstIndex, pKbdInputData);
+	*pRepeatCount = pFirstKeyState->repeatCount;
+	*pPressTime = pFirstKeyState->pressTime;
+	pFirstKeyState->pressTime = 0;
+	pFirstKeyState->repeatCount = 0;
+
+	return TRUE;
+}
+
+
+void resetMouCoalescing(MouCoalescing* pMouCoalescing) {
+	RtlZeroMemory(pMouCoalescing, sizeof(MouCoalescing));
+
+	return;
+}
+
+
+BOOLEAN coalesceMouInput(MouCoalescing* pMouCoalescing, PMOUSE_INPUT_DATA pMouInputData, ULONGLONG time, ULONGLONG samplePeriod) {
+
+	if (pMouInputData->Flags & MOUSE_MOVE_ABSOLUTE) {
+		pMouCoalescing->x = pMouInputData->LastX;
+		pMouCoalescing->y = pMouInputData->LastY;
+		pMouCoalescing->hasMovement = TRUE;
+	}
+	else {
+
+		// accumulation starts over if the device switches from absolute to relative movement
+		if (pMouCoalescing->flags & MOUSE_MOVE_ABSOLUTE) {
+			pMouCoalescing->x = 0;
+			pMouCoalescing->y = 0;
+		}
+
+		pMouCoalescing->x += pMouInputData->LastX;
+		pMouCoalescing->y += pMouInputData->LastY;
+		pMouCoalescing->hasMovement = pMouCoalescing->x || pMouCoalescing->y;
+	}
+
+	pMouCoalescing->flags = pMouInputData->Flags;
+
+	// button and wheel changes are always emitted, pure movement at most once per sample period
+	if (!pMouInputData->ButtonFlags && (!pMouCoalescing->hasMovement || time - pMouCoalescing->lastTime < samplePeriod)) {
+
+		return FALSE;
+	}
+
+	pMouInputData->LastX = pMouCoalescing->x;
+	pMouInputData->LastY = pMouCoalescing->y;
+	pMouCoalescing->lastTime = time;
+	pMouCoalescing->hasMovement = FALSE;
+
+	if (!(pMouCoalescing->flags & MOUSE_MOVE_ABSOLUTE)) {
+		pMouCoalescing->x = 0;
+		pMouCoalescing->y = 0;
+	}
+
+	return TRUE;
+}
+
+
+BOOLEAN flushMouCoalescing(MouCoalescing* pMouCoalescing, PMOUSE_INPUT_DATA pMouInputData) {
+	const BOOLEAN hasMovement = pMouCoalescing->hasMovement;
+
+	if (hasMovement) {
+		RtlZeroMemory(pMouInputData, sizeof(MOUSE_INPUT_DATA));
+		pMouInputData->Flags = pMouCoalescing->flags;
+		pMouInputData->LastX = pMouCoalescing->x;
+		pMouInputData->LastY = pMouCoalescing->y;
+	}
+
+	resetMouCoalescing(pMouCoalescing);
+
+	return hasMovement;
+}
+
+
+static ULONG getKeyStateIndex(const KEYBOARD_INPUT_DATA* pKbdInputData) {
+	ULONG index = pKbdInputData->MakeCode & 0xFF;
+
+	if (pKbdInputData->Flags & KEY_E0) {
+		index += 0x100;
+	}
+	else if (pKbdInputData->Flags & KEY_E1) {
+		index += 0x200;
+	}
+
+	return index;
+}
+
+
+// Sets the make code and the prefix of a press from the index of its key state.
+static void getKeyStateInput(ULONG index, PKEYBOARD_INPUT_DATA pKbdInputData) {
+	pKbdInputData->MakeCode = (USHORT)(index & 0xFF);
+	pKbdInputData->Flags = KEY_MAKE;
+
+	if (index >= 0x200) {
+		pKbdInputData->Flags |= KEY_E1;
+	}
+	else if (index >= 0x100) {
+		pKbdInputData->Flags |= KEY_E0;
+	}
+
+	return;
+}
+
+
+// Keys that change the modifier state of the keymap of the client (see keymap.h) and the Windows keys.
+static BOOLEAN isModifier(const KEYBOARD_INPUT_DATA* pKbdInputData) {
+	BOOLEAN isModifierKey = FALSE;
+
+	switch (pKbdInputData->MakeCode) {
+	// control and alt, right control and AltGr with E0
+	case 0x1D:
+	case 0x38:
+	// shift, caps lock and num lock
+	case 0x2A:
+	case 0x36:
+	case 0x3A:
+	case 0x45:
+		// pause is the only E1 key and is sent as E1 1D 45
+		isModifierKey = !(pKbdInputData->Flags & KEY_E1);
+		break;
+	// Windows keys
+	case 0x5B:
+	case 0x5C:
+		isModifierKey = (pKbdInputData->Flags & KEY_E0) != 0;
+		break;
+	default:
+		break;
+	}
+
+	return isModifierKey;
+}
\ No newline at end of file
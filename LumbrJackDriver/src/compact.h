@@ -0,0 +1,134 @@
+#pragma once
+#include "platform.h"
+
+// Compaction of input data before it is added to the blocking queues.
+// Every input device has its own compaction or coalescing state in the extension of its filter device (see device.h),
+// so the input of one device never completes or absorbs the input of another one.
+// All functions expect calls from the completion routines, which are serialized per device by the read semaphore of the device.
+// Therefore the compaction state is not protected by a lock. A zeroed state is a reset state.
+
+typedef struct KeyState {
+	ULONGLONG pressTime;
+	ULONG repeatCount;
+}KeyState;
+
+// One state per make code for each of the prefixes none, E0 and E1.
+#define KEY_STATE_COUNT (0x100 * 3)
+
+// Compaction state of a keyboard.
+typedef struct KbdCompaction {
+	KeyState keyStates[KEY_STATE_COUNT];
+}KbdCompaction;
+
+// Coalescing state of a mouse.
+typedef struct MouCoalescing {
+	LONG x;
+	LONG y;
+	USHORT flags;
+	BOOLEAN hasMovement;
+	ULONGLONG lastTime;
+}MouCoalescing;
+
+// Resets the compaction state of a keyboard. Keys that are currently held are forgotten.
+// Should be called before logging is started.
+//
+// Parameters:
+//
+// [out] pKbdCompaction:
+// Address of the compaction state.
+void resetKbdCompaction(KbdCompaction* pKbdCompaction);
+
+// Compacts keyboard input data.
+// A key press and its typematic repeats are collapsed and paired with the key release into a single record marked with RECORD_KBD_PAIRED.
+// Modifier keys (shift, control, alt, AltGr, Windows, caps lock and num lock) are not paired, so they stay in order with the keys they modify:
+// their press is passed through, their repeats are collapsed and their release carries the repeat count and hold time.
+// Releases of keys that were pressed before the compaction state was reset are passed through unpaired.
+//
+// Parameters:
+//
+// [in/out] pKbdCompaction:
+// Address of the compaction state of the keyboard the input comes from.
+//
+// [in/out] pKbdInputData:
+// Address of the keyboard input data to compact.
+// For a paired record it contains the make code without KEY_BREAK and with RECORD_KBD_PAIRED on return.
+//
+// [in] time:
+// Interrupt time of the input in 100 ns units.
+//
+// [out] pRepeatCount:
+// Contains the number of typematic repeats of the key on return.
+//
+// [out] pHoldTime:
+// Contains the time between key press and release in 100 ns units on return. Zero for presses and for releases of keys pressed before the reset.
+//
+// Return:
+// TRUE if a record is complete and should be logged, FALSE if the input was absorbed.
+BOOLEAN compactKbdInput(KbdCompaction* pKbdCompaction, PKEYBOARD_INPUT_DATA pKbdInputData, ULONGLONG time, ULONG* pRepeatCount, ULONGLONG* pHoldTime);
+
+// Takes the first pressed of the held keys whose press was absorbed, so it is logged before logging stops.
+// Held modifiers were logged when they were pressed and are only forgotten. The compaction state is reset once no key is left.
+//
+// Parameters:
+//
+// [in/out] pKbdCompaction:
+// Address of the compaction state of the keyboard.
+//
+// [out] pKbdInputData:
+// Contains the make code and the prefix of the press on return if a key was taken.
+//
+// [out] pRepeatCount:
+// Contains the number of typematic repeats of the key so far on return.
+//
+// [out] pPressTime:
+// Contains the interrupt time of the press in 100 ns units on return.
+//
+// Return:
+// TRUE if a key was taken, FALSE if no held key is left. Has to be called until it returns FALSE.
+BOOLEAN flushKbdCompaction(KbdCompaction* pKbdCompaction, PKEYBOARD_INPUT_DATA pKbdInputData, ULONG* pRepeatCount, ULONGLONG* pPressTime);
+
+// Resets the coalescing state of a mouse. Movement that has not been emitted yet is discarded.
+// Should be called before logging is started.
+//
+// Parameters:
+//
+// [out] pMouCoalescing:
+// Address of the coalescing state.
+void resetMouCoalescing(MouCoalescing* pMouCoalescing);
+
+// Coalesces mouse input, so the number of records is bounded by the sample rate regardless of the polling rate of the device.
+// Relative movement is accumulated, absolute positions (MOUSE_MOVE_ABSOLUTE) replace each other.
+// The movement is emitted with the next button or wheel change or once the sample period has passed since the last record.
+//
+// Parameters:
+//
+// [in/out] pMouCoalescing:
+// Address of the coalescing state of the mouse the input comes from.
+//
+// [in/out] pMouInputData:
+// Address of the mouse input data to coalesce.
+// For an emitted record it contains the accumulated movement or the last absolute position on return.
+//
+// [in] time:
+// Interrupt time of the input in 100 ns units.
+//
+// [in] samplePeriod:
+// Minimum time between two records of pure movement in 100 ns units.
+//
+// Return:
+// TRUE if a record should be logged, FALSE if the input was absorbed.
+BOOLEAN coalesceMouInput(MouCoalescing* pMouCoalescing, PMOUSE_INPUT_DATA pMouInputData, ULONGLONG time, ULONGLONG samplePeriod);
+
+// Takes the movement that was absorbed and not emitted yet, so it is logged before logging stops, and resets the coalescing state.
+//
+// Parameters:
+//
+// [in/out] pMouCoalescing:
+// Address of the coalescing state of the mouse.
+//
+// [out] pMouInputData:
+// Contains the accumulated movement or the last absolute position on return if there is one.
+//
+// Return:
+// TRUE if there was movement to log, FALSE otherwise.
+BOOLEAN flushMouCoalescing(MouCoalescing* pMouCoalescing, PMOUSE_INPUT_DATA pMouInputData);
\ No newline at end of file
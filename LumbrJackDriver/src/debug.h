@@ -1,10 +1,14 @@
 #pragma once
-#include <ntddk.h>
+#include "platform.h"
 
 // Tags for dynamic memory allocations.
 #define LOG_THREAD_DATA_TAG 'LTHD'
 #define KBD_LIST_DATA_TAG 'KBLD'
 #define MOU_LIST_DATA_TAG 'MOLD'
+#define SOURCE_NAME_DATA_TAG 'SRND'
+#define REMOVE_LOCK_TAG 'RMLK'
+#define TRACE_BUFFER_DATA_TAG 'TRBD'
+#define LOG_BUFFER_DATA_TAG 'LGBD'
 
 #define DBG_PRINT(f) KdPrintEx((DPFLTR_IHVDRIVER_ID, 0, f))
 #define DBG_PRINTF(f, x) KdPrintEx((DPFLTR_IHVDRIVER_ID, 0, f, x))
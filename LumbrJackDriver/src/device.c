@@ -0,0 +1,373 @@
+#include "device.h"
+#include "source.h"
+#include "debug.h"
+#include "platform.h"
+#include <initguid.h>
+#include <wdmguid.h>
+#include <Ntddkbd.h>
+#include <Ntddmou.h>
+
+extern POBJECT_TYPE* IoDriverObjectType;
+
+NTSTATUS NTAPI ObReferenceObjectByName(PUNICODE_STRING ObjectName, ULONG Attributes, PACCESS_STATE AccessState, ACCESS_MASK DesiredAccess, POBJECT_TYPE ObjectType, KPROCESSOR_MODE AccessMode, PVOID ParseContext, PVOID* Object);
+
+static UNICODE_STRING kbdDriverName = RTL_CONSTANT_STRING(L"\\Driver\\kbdclass");
+static UNICODE_STRING mouDriverName = RTL_CONSTANT_STRING(L"\\Driver\\mouclass");
+
+// Interval of the checks on unload if removals of class devices are done, in 100 ns units.
+#define REMOVAL_POLL 10000ull
+// Interval of the checks on flushes if completion routines are done with their input, in 100 ns units.
+#define PROCESSING_POLL 1000ull
+
+static FAST_MUTEX deviceMutex;
+static PVOID kbdNotificationEntry;
+static PVOID mouNotificationEntry;
+
+static BOOLEAN isAttached(PDRIVER_OBJECT pDriverObject, PDEVICE_OBJECT pClassDevice);
+static NTSTATUS attachFilterDevice(PDRIVER_OBJECT pDriverObject, PDEVICE_OBJECT pClassDevice, ULONG deviceType);
+static void deleteFilterDevice(PDEVICE_OBJECT pFltDevObject);
+static NTSTATUS onDeviceArrival(PVOID pNotificationStructure, PVOID pContext);
+static void queryDeviceName(PDEVICE_OBJECT pDevice, WCHAR* name, size_t length);
+
+void initFilterDevices() {
+	ExInitializeFastMutex(&deviceMutex);
+
+	return;
+}
+
+
+NTSTATUS attachFilterDevices(PDRIVER_OBJECT pDriverObject, ULONG deviceType) {
+	const PUNICODE_STRING pDriverName = deviceType == FILE_DEVICE_KEYBOARD ? &kbdDriverName : &mouDriverName;
+	PDRIVER_OBJECT targetDriverObject = NULL;
+	NTSTATUS ntStatus = ObReferenceObjectByName(pDriverName, OBJ_CASE_INSENSITIVE, NULL, 0, *IoDriverObjectType, KernelMode, NULL, (PVOID*)&targetDriverObject);
+
+	if (!NT_SUCCESS(ntStatus)) {
+		DBG_PRINTF("attachFilterDevices: ObReferenceObjectByName failed: 0x%lx\n", ntStatus);
+
+		return ntStatus;
+	}
+
+	ExAcquireFastMutex(&deviceMutex);
+
+	// the class driver is referenced while its device list is walked
+	for (PDEVICE_OBJECT pCurDeviceObject = targetDriverObject->DeviceObject; pCurDeviceObject; pCurDeviceObject = pCurDeviceObject->NextDevice) {
+
+		if (isAttached(pDriverObject, pCurDeviceObject)) continue;
+
+		// the device is retried on the next arrival, e.g. once a source is free again
+		const NTSTATUS ntStatusAttach = attachFilterDevice(pDriverObject, pCurDeviceObject, deviceType);
+
+		if (!NT_SUCCESS(ntStatusAttach)) {
+			DBG_PRINTF("attachFilterDevices: attachFilterDevice failed: 0x%lx\n", ntStatusAttach);
+		}
+
+	}
+
+	ExReleaseFastMutex(&deviceMutex);
+	ObfDereferenceObject(targetDriverObject);
+
+	return ntStatus;
+}
+
+
+BOOLEAN markFilterDeviceRemoved(PDEVICE_OBJECT pFltDevObject) {
+	FltDevExtension* const pFltDevExtension = (FltDevExtension*)pFltDevObject->DeviceExtension;
+	ExAcquireFastMutex(&deviceMutex);
+	const BOOLEAN isMarked = !pFltDevExtension->isRemoved;
+	pFltDevExtension->isRemoved = TRUE;
+	ExReleaseFastMutex(&deviceMutex);
+
+	return isMarked;
+}
+
+
+void detachFilterDevice(PDEVICE_OBJECT pFltDevObject) {
+	ExAcquireFastMutex(&deviceMutex);
+	deleteFilterDevice(pFltDevObject);
+	ExReleaseFastMutex(&deviceMutex);
+
+	return;
+}
+
+
+void resetFilterDevices(PDRIVER_OBJECT pDriverObject) {
+	ExAcquireFastMutex(&deviceMutex);
+
+	for (PDEVICE_OBJECT pCurDevice = pDriverObject->DeviceObject; pCurDevice; pCurDevice = pCurDevice->NextDevice) {
+
+		// the communication device has no extension
+		if (!pCurDevice->DeviceExtension) continue;
+
+		FltDevExtension* const pFltDevExtension = (FltDevExtension*)pCurDevice->DeviceExtension;
+
+		if (pFltDevExtension->type == FILE_DEVICE_KEYBOARD) {
+			resetKbdCompaction(&pFltDevExtension->kbdCompaction);
+		}
+		else {
+			resetMouCoalescing(&pFltDevExtension->mouCoalescing);
+		}
+
+	}
+
+	ExReleaseFastMutex(&deviceMutex);
+
+	return;
+}
+
+
+void flushFilterDevices(PDRIVER_OBJECT pDriverObject, const InputSession* pKbdSession, const InputSession* pMouSession) {
+	// completion routines count themselves before they read the logging state, so every routine that missed its switch is waited for
+	platformMemoryBarrier();
+	ExAcquireFastMutex(&deviceMutex);
+
+	for (PDEVICE_OBJECT pCurDevice = pDriverObject->DeviceObject; pCurDevice; pCurDevice = pCurDevice->NextDevice) {
+
+		// the communication device has no extension
+		if (!pCurDevice->DeviceExtension) continue;
+
+		FltDevExtension* const pFltDevExtension = (FltDevExtension*)pCurDevice->DeviceExtension;
+
+		while (InterlockedCompareExchange(&pFltDevExtension->processingCount, 0, 0)) {
+			platformDelay(PROCESSING_POLL);
+		}
+
+		if (pFltDevExtension->type == FILE_DEVICE_KEYBOARD && pKbdSession) {
+			InputSession session = *pKbdSession;
+			session.pKbdCompaction = &pFltDevExtension->kbdCompaction;
+			flushKbdInput(pFltDevExtension->sourceId, &session);
+		}
+		else if (pFltDevExtension->type == FILE_DEVICE_MOUSE && pMouSession) {
+			InputSession session = *pMouSession;
+			session.pMouCoalescing = &pFltDevExtension->mouCoalescing;
+			flushMouInput(pFltDevExtension->sourceId, &session);
+		}
+
+	}
+
+	ExReleaseFastMutex(&deviceMutex);
+
+	return;
+}
+
+
+void detachFilterDevices(PDRIVER_OBJECT pDriverObject) {
+
+	for (;;) {
+		PDEVICE_OBJECT pFltDevObject = NULL;
+		BOOLEAN isRemovalPending = FALSE;
+		ExAcquireFastMutex(&deviceMutex);
+
+		for (PDEVICE_OBJECT pCurDevice = pDriverObject->DeviceObject; pCurDevice; pCurDevice = pCurDevice->NextDevice) {
+
+			// the communication device has no extension
+			if (!pCurDevice->DeviceExtension) continue;
+
+			FltDevExtension* const pFltDevExtension = (FltDevExtension*)pCurDevice->DeviceExtension;
+
+			// devices of removed class devices are deleted by the removal
+			if (pFltDevExtension->isRemoved || !NT_SUCCESS(IoAcquireRemoveLock(&pFltDevExtension->removeLock, pDriverObject))) {
+				isRemovalPending = TRUE;
+
+				continue;
+			}
+
+			pFltDevExtension->isRemoved = TRUE;
+			pFltDevObject = pCurDevice;
+
+			break;
+		}
+
+		ExReleaseFastMutex(&deviceMutex);
+
+		if (pFltDevObject) {
+			// the mutex is not held while waiting, so removals that complete the pending reads can mark their devices
+			IoReleaseRemoveLockAndWait(&((FltDevExtension*)pFltDevObject->DeviceExtension)->removeLock, pDriverObject);
+			detachFilterDevice(pFltDevObject);
+		}
+		else if (isRemovalPending) {
+			platformDelay(REMOVAL_POLL);
+		}
+		else {
+			break;
+		}
+
+	}
+
+	return;
+}
+
+
+NTSTATUS registerDeviceNotifications(PDRIVER_OBJECT pDriverObject) {
+	NTSTATUS ntStatus = IoRegisterPlugPlayNotification(EventCategoryDeviceInterfaceChange, 0, (PVOID)&GUID_DEVINTERFACE_KEYBOARD, pDriverObject, onDeviceArrival, pDriverObject, &kbdNotificationEntry);
+
+	if (!NT_SUCCESS(ntStatus)) {
+		DBG_PRINTF("registerDeviceNotifications: IoRegisterPlugPlayNotification failed for keyboards: 0x%lx\n", ntStatus);
+
+		return ntStatus;
+	}
+
+	ntStatus = IoRegisterPlugPlayNotification(EventCategoryDeviceInterfaceChange, 0, (PVOID)&GUID_DEVINTERFACE_MOUSE, pDriverObject, onDeviceArrival, pDriverObject, &mouNotificationEntry);
+
+	if (!NT_SUCCESS(ntStatus)) {
+		DBG_PRINTF("registerDeviceNotifications: IoRegisterPlugPlayNotification failed for mice: 0x%lx\n", ntStatus);
+	}
+
+	return ntStatus;
+}
+
+
+void unregisterDeviceNotifications() {
+	
+	if (kbdNotificationEntry) {
+		IoUnregisterPlugPlayNotificationEx(kbdNotificationEntry);
+		kbdNotificationEntry = NULL;
+	}
+
+	if (mouNotificationEntry) {
+		IoUnregisterPlugPlayNotificationEx(mouNotificationEntry);
+		mouNotificationEntry = NULL;
+	}
+
+	return;
+}
+
+
+// Checks if one of the filter devices of the driver was created for a class device.
+// Has to be called with the device mutex held.
+static BOOLEAN isAttached(PDRIVER_OBJECT pDriverObject, PDEVICE_OBJECT pClassDevice) {
+
+	for (PDEVICE_OBJECT pCurDevice = pDriverObject->DeviceObject; pCurDevice; pCurDevice = pCurDevice->NextDevice) {
+
+		if (pCurDevice->DeviceExtension && ((FltDevExtension*)pCurDevice->DeviceExtension)->pClassDevice == pClassDevice) return TRUE;
+
+	}
+
+	return FALSE;
+}
+
+
+// Has to be called with the device mutex held.
+static NTSTATUS attachFilterDevice(PDRIVER_OBJECT pDriverObject, PDEVICE_OBJECT pClassDevice, ULONG deviceType) {
+	PDEVICE_OBJECT pFltDevObject = NULL;
+	NTSTATUS ntStatus = IoCreateDevice(pDriverObject, sizeof(FltDevExtension), NULL, deviceType, FILE_DEVICE_SECURE_OPEN, FALSE, &pFltDevObject);
+
+	if (NT_SUCCESS(ntStatus)) {
+		DBG_PRINT("attachFilterDevice: Device created\n");
+	}
+	else {
+		DBG_PRINTF("attachFilterDevice: IoCreateDevice failed: 0x%lx\n", ntStatus);
+
+		return ntStatus;
+	}
+
+	FltDevExtension* const pFltDevExtension = (FltDevExtension*)pFltDevObject->DeviceExtension;
+	RtlZeroMemory(pFltDevExtension, sizeof(FltDevExtension));
+	pFltDevExtension->type = (CSHORT)deviceType;
+	pFltDevExtension->pClassDevice = pClassDevice;
+	IoInitializeRemoveLock(&pFltDevExtension->removeLock, REMOVE_LOCK_TAG, 0, 0);
+	KeInitializeSemaphore(&pFltDevExtension->readSemaphore, 1, 1);
+	WCHAR name[SOURCE_NAME_LENGTH] = { 0 };
+	queryDeviceName(pClassDevice, name, ARRAYSIZE(name));
+	ntStatus = addSource(name, (USHORT)deviceType, &pFltDevExtension->sourceId);
+
+	if (NT_SUCCESS(ntStatus)) {
+		DBG_PRINTF("attachFilterDevice: Source %hu added\n", pFltDevExtension->sourceId);
+	}
+	else {
+		DBG_PRINTF("attachFilterDevice: addSource failed: 0x%lx\n", ntStatus);
+		IoDeleteDevice(pFltDevObject);
+
+		return ntStatus;
+	}
+
+	ntStatus = IoAttachDeviceToDeviceStackSafe(pFltDevObject, pClassDevice, &pFltDevExtension->pTargetDevice);
+
+	if (NT_SUCCESS(ntStatus)) {
+		DBG_PRINT("attachFilterDevice: Device attached\n");
+	}
+	else {
+		DBG_PRINTF("attachFilterDevice: IoAttachDeviceToDeviceStackSafe failed: 0x%lx\n", ntStatus);
+		removeSource(pFltDevExtension->sourceId);
+		IoDeleteDevice(pFltDevObject);
+
+		return ntStatus;
+	}
+
+	pFltDevObject->Flags |= DO_BUFFERED_IO | (pFltDevExtension->pTargetDevice->Flags & DO_POWER_PAGABLE);
+	pFltDevObject->Flags &= ~DO_DEVICE_INITIALIZING;
+
+	return ntStatus;
+}
+
+
+// Has to be called with the device mutex held.
+static void deleteFilterDevice(PDEVICE_OBJECT pFltDevObject) {
+	const FltDevExtension* const pFltDevExtension = (FltDevExtension*)pFltDevObject->DeviceExtension;
+
+	if (pFltDevExtension->pTargetDevice) {
+		IoDetachDevice(pFltDevExtension->pTargetDevice);
+		DBG_PRINT("deleteFilterDevice: Device detached\n");
+	}
+
+	removeSource(pFltDevExtension->sourceId);
+	IoDeleteDevice(pFltDevObject);
+	DBG_PRINT("deleteFilterDevice: Device deleted\n");
+
+	return;
+}
+
+
+// Called at PASSIVE_LEVEL for every new keyboard or mouse interface.
+// The class device of the interface is not passed, so the device list of the class driver is searched for new devices.
+static NTSTATUS onDeviceArrival(PVOID pNotificationStructure, PVOID pContext) {
+	const PDEVICE_INTERFACE_CHANGE_NOTIFICATION pNotification = (PDEVICE_INTERFACE_CHANGE_NOTIFICATION)pNotificationStructure;
+	const PDRIVER_OBJECT pDriverObject = (PDRIVER_OBJECT)pContext;
+
+	if (!IsEqualGUID(&pNotification->Event, &GUID_DEVICE_INTERFACE_ARRIVAL)) return STATUS_SUCCESS;
+
+	NTSTATUS ntStatus = STATUS_SUCCESS;
+
+	if (IsEqualGUID(&pNotification->InterfaceClassGuid, &GUID_DEVINTERFACE_KEYBOARD)) {
+		ntStatus = attachFilterDevices(pDriverObject, FILE_DEVICE_KEYBOARD);
+	}
+	else if (IsEqualGUID(&pNotification->InterfaceClassGuid, &GUID_DEVINTERFACE_MOUSE)) {
+		ntStatus = attachFilterDevices(pDriverObject, FILE_DEVICE_MOUSE);
+	}
+
+	if (!NT_SUCCESS(ntStatus)) {
+		DBG_PRINTF("onDeviceArrival: attachFilterDevices failed: 0x%lx\n", ntStatus);
+	}
+
+	// failures of the callback are ignored by the system
+	return STATUS_SUCCESS;
+}
+
+
+// Copies the object name of a class device, e.g. \Device\KeyboardClass0. Names that do not fit are truncated.
+// Unnamed devices and devices whose name can not be queried keep the empty string and are only told apart by their source ID.
+static void queryDeviceName(PDEVICE_OBJECT pDevice, WCHAR* name, size_t length) {
+	const ULONG size = sizeof(OBJECT_NAME_INFORMATION) + length * sizeof(WCHAR);
+	const POBJECT_NAME_INFORMATION pNameInfo = (POBJECT_NAME_INFORMATION)ExAllocatePool2(POOL_FLAG_PAGED, size, SOURCE_NAME_DATA_TAG);
+
+	if (!pNameInfo) {
+		DBG_PRINT("queryDeviceName: ExAllocatePool2 failed\n");
+
+		return;
+	}
+
+	ULONG returnLength = 0;
+	const NTSTATUS ntStatus = ObQueryNameString(pDevice, pNameInfo, size, &returnLength);
+
+	if (NT_SUCCESS(ntStatus)) {
+		const size_t nameLength = min(pNameInfo->Name.Length / sizeof(WCHAR), length - 1);
+		RtlCopyMemory(name, pNameInfo->Name.Buffer, nameLength * sizeof(WCHAR));
+		name[nameLength] = L'\0';
+	}
+	else {
+		DBG_PRINTF("queryDeviceName: ObQueryNameString failed: 0x%lx\n", ntStatus);
+	}
+
+	ExFreePoolWithTag(pNameInfo, SOURCE_NAME_DATA_TAG);
+
+	return;
+}
\ No newline at end of file
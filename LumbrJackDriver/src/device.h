@@ -0,0 +1,118 @@
+#pragma once
+#include "compact.h"
+#include "input.h"
+#include <ntddk.h>
+
+// Attaching and detaching of the filter devices.
+// Filter devices are attached to the class devices of kbdclass and mouclass when the driver is loaded and whenever a keyboard or mouse arrives.
+// They are detached when their class device is removed or the driver is unloaded.
+// Attaching and detaching is serialized by a mutex, so it has to be done at PASSIVE_LEVEL.
+
+// Device extension of the filter devices.
+typedef struct FltDevExtension {
+	// FILE_DEVICE_KEYBOARD or FILE_DEVICE_MOUSE.
+	CSHORT type;
+	USHORT sourceId;
+	// Class device the filter device was created for.
+	PDEVICE_OBJECT pClassDevice;
+	// Device the filter device is attached to. Either the class device or the top of its stack.
+	PDEVICE_OBJECT pTargetDevice;
+	// Held by pending read requests, so the device is not deleted before they complete.
+	IO_REMOVE_LOCK removeLock;
+	// Held while a read request of the device is pending, so its completion routines are serialized.
+	KSEMAPHORE readSemaphore;
+	// Completion routines processing input of the device. The semaphore is held for the whole pending read, so flushFilterDevices waits for this instead.
+	volatile LONG processingCount;
+	// Set under the device mutex by the path that deletes the device: the removal of its class device or the unload of the driver.
+	BOOLEAN isRemoved;
+	// State of the input processing of the device for compact logs or coalesced motion. Reset by resetFilterDevices.
+	union {
+		KbdCompaction kbdCompaction;
+		MouCoalescing mouCoalescing;
+	};
+}FltDevExtension;
+
+// Initializes the device mutex. Has to be called before any other function.
+void initFilterDevices();
+
+// Attaches filter devices to all devices of kbdclass or mouclass that do not have one yet.
+// Devices that can not be attached, e.g. because all sources are used, are passed by and retried on the next call.
+//
+// Parameters:
+//
+// [in] pDriverObject:
+// Address of the driver object of the current driver.
+//
+// [in] deviceType:
+// FILE_DEVICE_KEYBOARD for kbdclass or FILE_DEVICE_MOUSE for mouclass.
+//
+// Return:
+// STATUS_SUCCESS or an appropriate NTSTATUS value if the class driver was not found.
+NTSTATUS attachFilterDevices(PDRIVER_OBJECT pDriverObject, ULONG deviceType);
+
+// Marks a filter device as removed when its class device is removed, so it is not deleted by the unload of the driver as well.
+//
+// Parameters:
+//
+// [in] pFltDevObject:
+// Address of the filter device.
+//
+// Return:
+// TRUE if the caller has to detach the device, FALSE if the unload already marked it and deletes it once the remove lock is released.
+BOOLEAN markFilterDeviceRemoved(PDEVICE_OBJECT pFltDevObject);
+
+// Detaches and deletes a filter device marked by markFilterDeviceRemoved and removes its source.
+// The caller has to wait for the remove lock of the device first, so no read request is pending.
+//
+// Parameters:
+//
+// [in] pFltDevObject:
+// Address of the filter device.
+void detachFilterDevice(PDEVICE_OBJECT pFltDevObject);
+
+// Resets the compaction and coalescing state of all filter devices. Has to be called before logging is started.
+//
+// Parameters:
+//
+// [in] pDriverObject:
+// Address of the driver object of the current driver.
+void resetFilterDevices(PDRIVER_OBJECT pDriverObject);
+
+// Adds the presses of held keys absorbed by the compaction state of all keyboards and the movement absorbed by the coalescing state of all mice
+// to the queues of the sessions, so they are logged before logging stops.
+// Has to be called after logging was switched off and before the logging threads are stopped. Waits for completion routines that still process input.
+//
+// Parameters:
+//
+// [in] pDriverObject:
+// Address of the driver object of the current driver.
+//
+// [in] pKbdSession:
+// Address of the session of keyboard input without device state. NULL if keyboard input is not queued.
+//
+// [in] pMouSession:
+// Address of the session of mouse input without device state. NULL if mouse input is not queued.
+void flushFilterDevices(PDRIVER_OBJECT pDriverObject, const InputSession* pKbdSession, const InputSession* pMouSession);
+
+// Detaches and deletes all filter devices. Waits for all pending read requests and for removals of class devices in progress.
+//
+// Parameters:
+//
+// [in] pDriverObject:
+// Address of the driver object of the current driver.
+void detachFilterDevices(PDRIVER_OBJECT pDriverObject);
+
+// Registers for keyboard and mouse arrival notifications. Filter devices are attached to arriving devices.
+// Has to be called before the class devices are walked by attachFilterDevices, so devices arriving in between are not missed.
+//
+// Parameters:
+//
+// [in] pDriverObject:
+// Address of the driver object of the current driver.
+//
+// Return:
+// An appropriate NTSTATUS value.
+NTSTATUS registerDeviceNotifications(PDRIVER_OBJECT pDriverObject);
+
+// Unregisters the arrival notifications. Has to be called before the filter devices are detached on unload.
+void unregisterDeviceNotifications();
\ No newline at end of file
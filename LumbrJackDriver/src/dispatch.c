@@ -1,6 +1,14 @@
 #include "dispatch.h"
 #include "debug.h"
 #include "ioctl.h"
+#include "compact.h"
+#include "stats.h"
+#include "filter.h"
+#include "source.h"
+#include "device.h"
+#include "input.h"
+#include "trace.h"
+#include "inject.h"
 
 NTSTATUS LmbPassThrough(PDEVICE_OBJECT pDeviceObject, PIRP pIrp) {
 	const PIO_STACK_LOCATION pStackLocation = IoGetCurrentIrpStackLocation(pIrp);
@@ -15,13 +23,16 @@ NTSTATUS LmbPassThrough(PDEVICE_OBJECT pDeviceObject, PIRP pIrp) {
 	case IRP_MJ_CLEANUP:
 		DBG_PRINT("LmbPassThrough: Case IRP_MJ_CLEANUP\n");
 		break;
+	case IRP_MJ_POWER:
+		DBG_PRINT("LmbPassThrough: Case IRP_MJ_POWER\n");
+		break;
 	default:
 		DBG_PRINTF("LmbPassThrough: Unknown case 0x%lx\n", pStackLocation->MajorFunction);
 		break;
 	}
 
 	if (pDeviceObject->DeviceExtension) {
-		const PDEVICE_OBJECT pTargetDevice = ((PDEVOBJ_EXTENSION)pDeviceObject->DeviceExtension)->DeviceObject;
+		const PDEVICE_OBJECT pTargetDevice = ((FltDevExtension*)pDeviceObject->DeviceExtension)->pTargetDevice;
 
 		// if current device is attached to a lower level device, its driver needs to be called
 		if (pTargetDevice) {
@@ -46,12 +57,75 @@ NTSTATUS LmbPassThrough(PDEVICE_OBJECT pDeviceObject, PIRP pIrp) {
 }
 
 
+NTSTATUS LmbDispatchPnp(PDEVICE_OBJECT pDeviceObject, PIRP pIrp) {
+	
+	// the communication device is not part of a device stack
+	if (!pDeviceObject->DeviceExtension) {
+		const NTSTATUS ntStatus = pIrp->IoStatus.Status;
+		IofCompleteRequest(pIrp, IO_NO_INCREMENT);
+
+		return ntStatus;
+	}
+
+	FltDevExtension* const pFltDevExtension = (FltDevExtension*)pDeviceObject->DeviceExtension;
+	const PDEVICE_OBJECT pTargetDevice = pFltDevExtension->pTargetDevice;
+	const UCHAR minorFunction = IoGetCurrentIrpStackLocation(pIrp)->MinorFunction;
+	NTSTATUS ntStatus = IoAcquireRemoveLock(&pFltDevExtension->removeLock, pIrp);
+
+	if (!NT_SUCCESS(ntStatus)) {
+		DBG_PRINTF("LmbDispatchPnp: IoAcquireRemoveLock failed: 0x%lx\n", ntStatus);
+
+		// the unload waits for the pending reads, which the lower drivers only complete while they process the removal
+		if (minorFunction == IRP_MN_REMOVE_DEVICE) {
+			IoSkipCurrentIrpStackLocation(pIrp);
+
+			return IoCallDriver(pTargetDevice, pIrp);
+		}
+
+		pIrp->IoStatus.Status = ntStatus;
+		IofCompleteRequest(pIrp, IO_NO_INCREMENT);
+
+		return ntStatus;
+	}
+
+	// the device is deleted either here or by the unload of the driver
+	const BOOLEAN isMarked = minorFunction == IRP_MN_REMOVE_DEVICE && markFilterDeviceRemoved(pDeviceObject);
+	IoSkipCurrentIrpStackLocation(pIrp);
+	ntStatus = IoCallDriver(pTargetDevice, pIrp);
+
+	if (isMarked) {
+		TRACE(TRACE_INFO, TRACE_CAT_DEVICE, TRACE_POINT_DEVICE_REMOVED, pFltDevExtension->sourceId, pFltDevExtension->type, 0, 0);
+		// pending read requests are completed by the lower drivers while they process the removal
+		IoReleaseRemoveLockAndWait(&pFltDevExtension->removeLock, pIrp);
+		detachFilterDevice(pDeviceObject);
+	}
+	else {
+		// the device may be deleted by the unload as soon as the lock is released
+		IoReleaseRemoveLock(&pFltDevExtension->removeLock, pIrp);
+	}
+
+	return ntStatus;
+}
+
+
 BOOLEAN isLogging;
 
-static NTSTATUS dispatchDevCtlLogStart(PDEVICE_OBJECT pDeviceObject);
-static NTSTATUS dispatchDevCtlLogStop();
+static NTSTATUS dispatchDevCtlLogStart(PDEVICE_OBJECT pDeviceObject, PIRP pIrp);
+static NTSTATUS dispatchDevCtlLogStop(PDEVICE_OBJECT pDeviceObject);
+static NTSTATUS dispatchDevCtlSetFilter(PIRP pIrp);
+static NTSTATUS dispatchDevCtlGetSources(PIRP pIrp);
+static NTSTATUS dispatchDevCtlEnableSource(PIRP pIrp);
+static NTSTATUS dispatchDevCtlSetTrace(PIRP pIrp);
+static NTSTATUS dispatchDevCtlInjectInput(PDEVICE_OBJECT pDeviceObject, PIRP pIrp);
 
 NTSTATUS LmbDispatchDeviceControl(PDEVICE_OBJECT pDeviceObject, PIRP pIrp) {
+
+	// only the communication device handles the IO control codes of the driver, requests to filter devices are meant for the class devices
+	if (pDeviceObject->DeviceExtension) {
+
+		return LmbPassThrough(pDeviceObject, pIrp);
+	}
+
 	const PIO_STACK_LOCATION pStackLocation = IoGetCurrentIrpStackLocation(pIrp);
 	
 	if (pStackLocation->MajorFunction != IRP_MJ_DEVICE_CONTROL) {
@@ -75,7 +149,7 @@ NTSTATUS LmbDispatchDeviceControl(PDEVICE_OBJECT pDeviceObject, PIRP pIrp) {
 		DBG_PRINTF("LmbDispatchDeviceControl: Sent log state: %hhu\n", isLogging);
 		break;
 	case IOCTL_LOG_START:
-		ntStatus = dispatchDevCtlLogStart(pDeviceObject);
+		ntStatus = dispatchDevCtlLogStart(pDeviceObject, pIrp);
 
 		if (!NT_SUCCESS(ntStatus)) {
 			DBG_PRINTF("LmbDispatchDeviceControl: dispatchDevCtlLogStart failed: 0x%lx\n", ntStatus);
@@ -84,7 +158,7 @@ NTSTATUS LmbDispatchDeviceControl(PDEVICE_OBJECT pDeviceObject, PIRP pIrp) {
 		pIrp->IoStatus.Information = 0;
 		break;
 	case IOCTL_LOG_STOP:
-		ntStatus = dispatchDevCtlLogStop();
+		ntStatus = dispatchDevCtlLogStop(pDeviceObject);
 
 		if (!NT_SUCCESS(ntStatus)) {
 			DBG_PRINTF("LmbDispatchDeviceControl: dispatchDevCtlLogStop failed: 0x%lx\n", ntStatus);
@@ -92,6 +166,59 @@ NTSTATUS LmbDispatchDeviceControl(PDEVICE_OBJECT pDeviceObject, PIRP pIrp) {
 
 		pIrp->IoStatus.Information = 0;
 		break;
+	case IOCTL_SET_FILTER:
+		ntStatus = dispatchDevCtlSetFilter(pIrp);
+
+		if (!NT_SUCCESS(ntStatus)) {
+			DBG_PRINTF("LmbDispatchDeviceControl: dispatchDevCtlSetFilter failed: 0x%lx\n", ntStatus);
+		}
+
+		pIrp->IoStatus.Information = 0;
+		break;
+	case IOCTL_GET_SOURCES:
+		ntStatus = dispatchDevCtlGetSources(pIrp);
+
+		if (!NT_SUCCESS(ntStatus)) {
+			DBG_PRINTF("LmbDispatchDeviceControl: dispatchDevCtlGetSources failed: 0x%lx\n", ntStatus);
+		}
+
+		// dispatchDevCtlGetSources sets the information
+		break;
+	case IOCTL_SET_TRACE:
+		ntStatus = dispatchDevCtlSetTrace(pIrp);
+
+		if (!NT_SUCCESS(ntStatus)) {
+			DBG_PRINTF("LmbDispatchDeviceControl: dispatchDevCtlSetTrace failed: 0x%lx\n", ntStatus);
+		}
+
+		pIrp->IoStatus.Information = 0;
+		break;
+	case IOCTL_READ_TRACE:
+		pIrp->IoStatus.Information = readTrace((TraceSnapshot*)pIrp->AssociatedIrp.SystemBuffer, pStackLocation->Parameters.DeviceIoControl.OutputBufferLength);
+
+		if (!pIrp->IoStatus.Information) {
+			ntStatus = STATUS_BUFFER_TOO_SMALL;
+		}
+
+		break;
+	case IOCTL_ENABLE_SOURCE:
+		ntStatus = dispatchDevCtlEnableSource(pIrp);
+
+		if (!NT_SUCCESS(ntStatus)) {
+			DBG_PRINTF("LmbDispatchDeviceControl: dispatchDevCtlEnableSource failed: 0x%lx\n", ntStatus);
+		}
+
+		pIrp->IoStatus.Information = 0;
+		break;
+	case IOCTL_INJECT_INPUT:
+		ntStatus = dispatchDevCtlInjectInput(pDeviceObject, pIrp);
+
+		if (!NT_SUCCESS(ntStatus)) {
+			DBG_PRINTF("LmbDispatchDeviceControl: dispatchDevCtlInjectInput failed: 0x%lx\n", ntStatus);
+		}
+
+		// dispatchDevCtlInjectInput sets the information
+		break;
 	default:
 		ntStatus = STATUS_INVALID_PARAMETER;
 	}
@@ -103,39 +230,37 @@ NTSTATUS LmbDispatchDeviceControl(PDEVICE_OBJECT pDeviceObject, PIRP pIrp) {
 }
 
 
-KSEMAPHORE readSemaphores[LOG_MAX];
+// Minimum time between two records of pure movement of the current session in 100 ns units.
+static ULONGLONG samplePeriod;
 
 static NTSTATUS completeKbdRead(PDEVICE_OBJECT DeviceObject, PIRP Irp, PVOID Context);
 static NTSTATUS completeMouRead(PDEVICE_OBJECT DeviceObject, PIRP Irp, PVOID Context);
+static NTSTATUS completeSkippedRead(PDEVICE_OBJECT DeviceObject, PIRP Irp, PVOID Context);
 
 NTSTATUS LmbDispatchRead(PDEVICE_OBJECT pDeviceObject, PIRP pIrp) {
 	
-	if (!pDeviceObject->DeviceExtension) {
-		DBG_PRINT("LmbDispatchRead: No device extension\n");
-
-		return STATUS_INVALID_PARAMETER;
-	}
-
-	const PDEVICE_OBJECT pTargetDevice = ((PDEVOBJ_EXTENSION)pDeviceObject->DeviceExtension)->DeviceObject;
-
-	if (!pTargetDevice) {
+	// the request is completed by the driver that returns its status
+	if (!pDeviceObject->DeviceExtension || !((FltDevExtension*)pDeviceObject->DeviceExtension)->pTargetDevice) {
 		DBG_PRINT("LmbDispatchRead: No target device\n");
+		pIrp->IoStatus.Information = 0;
+		pIrp->IoStatus.Status = STATUS_INVALID_DEVICE_REQUEST;
+		IofCompleteRequest(pIrp, IO_NO_INCREMENT);
 
-		return STATUS_INVALID_PARAMETER;
+		return STATUS_INVALID_DEVICE_REQUEST;
 	}
 
-	CSHORT devType = ((PDEVOBJ_EXTENSION)pDeviceObject->DeviceExtension)->Type;
+	FltDevExtension* const pFltDevExtension = (FltDevExtension*)pDeviceObject->DeviceExtension;
+	const PDEVICE_OBJECT pTargetDevice = pFltDevExtension->pTargetDevice;
+
+	CSHORT devType = pFltDevExtension->type;
 	PIO_COMPLETION_ROUTINE pIoCompletionRoutine = NULL;
-	LogType logType = LOG_KBD;
 
 	switch (devType) {
 	case FILE_DEVICE_KEYBOARD:
 		pIoCompletionRoutine = completeKbdRead;
-		logType = LOG_KBD;
 		break;
 	case FILE_DEVICE_MOUSE:
 		pIoCompletionRoutine = completeMouRead;
-		logType = LOG_MOU;
 		break;
 	default:
 		DBG_PRINT("LmbDispatchRead: Unknown device type\n");
@@ -144,7 +269,7 @@ NTSTATUS LmbDispatchRead(PDEVICE_OBJECT pDeviceObject, PIRP pIrp) {
 
 	// timeout needs to be zero at IRQL >= DISPATCH_LEVEL
 	LARGE_INTEGER zeroTimeout = { .QuadPart = 0 };
-	const NTSTATUS ntStatus = KeWaitForSingleObject(&readSemaphores[logType], Executive, KernelMode, FALSE, &zeroTimeout);
+	NTSTATUS ntStatus = KeWaitForSingleObject(&pFltDevExtension->readSemaphore, Executive, KernelMode, FALSE, &zeroTimeout);
 
 	if (!NT_SUCCESS(ntStatus)) {
 		DBG_PRINTF("dispatchKbdRead: KeWaitForSingleObject failed: 0x%lx\n", ntStatus);
@@ -153,19 +278,57 @@ NTSTATUS LmbDispatchRead(PDEVICE_OBJECT pDeviceObject, PIRP pIrp) {
 	}
 	else if (ntStatus == STATUS_TIMEOUT) {
 		DBG_PRINT("dispatchKbdRead: KeWaitForSingleObject timeout\n");
+
+		// the input of the read is not logged, but it still takes its sequence numbers, so the loss shows up in the log file
+		if (isLogging && NT_SUCCESS(IoAcquireRemoveLock(&pFltDevExtension->removeLock, pIrp))) {
+			IoCopyCurrentIrpStackLocationToNext(pIrp);
+			IoSetCompletionRoutine(pIrp, completeSkippedRead, pFltDevExtension, TRUE, TRUE, TRUE);
+
+			return IoCallDriver(pTargetDevice, pIrp);
+		}
+
 		IoSkipCurrentIrpStackLocation(pIrp);
 
 		return IoCallDriver(pTargetDevice, pIrp);
 	}
 
+	// released by the completion routine, so the device is not deleted while the request is pending
+	ntStatus = IoAcquireRemoveLock(&pFltDevExtension->removeLock, pIrp);
+
+	if (!NT_SUCCESS(ntStatus)) {
+		DBG_PRINTF("LmbDispatchRead: IoAcquireRemoveLock failed: 0x%lx\n", ntStatus);
+		KeReleaseSemaphore(&pFltDevExtension->readSemaphore, 0, 1, FALSE);
+		pIrp->IoStatus.Information = 0;
+		pIrp->IoStatus.Status = ntStatus;
+		IofCompleteRequest(pIrp, IO_NO_INCREMENT);
+
+		return ntStatus;
+	}
+
 	IoCopyCurrentIrpStackLocationToNext(pIrp);
-	IoSetCompletionRoutine(pIrp, pIoCompletionRoutine, NULL, TRUE, TRUE, TRUE);
+	IoSetCompletionRoutine(pIrp, pIoCompletionRoutine, pFltDevExtension, TRUE, TRUE, TRUE);
 
 	return IoCallDriver(pTargetDevice, pIrp);
 }
 
 
-static NTSTATUS dispatchDevCtlLogStart(PDEVICE_OBJECT pDeviceObject) {
+void flushPendingInput(PDRIVER_OBJECT pDriverObject) {
+	// summaries have no queues, and queues without a logging thread are closed
+	const LogType kbdThreadType = getLogThreadType(LOG_KBD);
+	const LogType mouThreadType = getLogThreadType(LOG_MOU);
+	const InputSession kbdSession = { logConfig.flags, &isLogging, &inputQueues[kbdThreadType], samplePeriod, NULL, NULL };
+	const InputSession mouSession = { logConfig.flags, &isLogging, &inputQueues[mouThreadType], samplePeriod, NULL, NULL };
+	flushFilterDevices(pDriverObject, pLogThreads[kbdThreadType] ? &kbdSession : NULL, pLogThreads[mouThreadType] ? &mouSession : NULL);
+
+	return;
+}
+
+
+static NTSTATUS dispatchDevCtlLogStart(PDEVICE_OBJECT pDeviceObject, PIRP pIrp) {
+
+	// the running session has to be stopped first, an aggregate session only runs the statistics thread
+	if (isLogging || pStatsThread) return STATUS_DEVICE_BUSY;
+
 	LARGE_INTEGER zeroTimeout = { .QuadPart = 0 };
 	NTSTATUS ntStatus = STATUS_SUCCESS;
 	
@@ -190,9 +353,42 @@ static NTSTATUS dispatchDevCtlLogStart(PDEVICE_OBJECT pDeviceObject) {
 
 	}
 
-	isLogging = TRUE;
+	const PIO_STACK_LOCATION pStackLocation = IoGetCurrentIrpStackLocation(pIrp);
+
+	// configuration is optional and may be shorter than the current structure, missing members are zero
+	const ULONG configSize = (ULONG)min(pStackLocation->Parameters.DeviceIoControl.InputBufferLength, sizeof(LogConfig));
+	RtlZeroMemory(&logConfig, sizeof(LogConfig));
+	RtlCopyMemory(&logConfig, pIrp->AssociatedIrp.SystemBuffer, configSize);
+	// the system buffer may contain a key
+	RtlSecureZeroMemory(pIrp->AssociatedIrp.SystemBuffer, configSize);
+
+	resetSequences();
+	resetFilterDevices(pDeviceObject->DriverObject);
+	// sample period in 100 ns units
+	samplePeriod = 10000000ull / (logConfig.motionRate ? logConfig.motionRate : 100);
+
+	// only the summaries are logged, so no logging threads are needed
+	if (logConfig.flags & LOG_FLAG_AGGREGATE) {
+		ntStatus = startStatsThread(pDeviceObject->DriverObject, logConfig.aggregateInterval ? logConfig.aggregateInterval : 60000);
+
+		if (!NT_SUCCESS(ntStatus)) {
+			DBG_PRINTF("dispatchDevCtlLogStart: startStatsThread failed: 0x%lx\n", ntStatus);
+
+			return ntStatus;
+		}
+
+		isLogging = TRUE;
+
+		return ntStatus;
+	}
+
+	const BOOLEAN isUnified = getLogThreadType(LOG_KBD) == LOG_ALL;
 
 	for (int i = 0; i < LOG_MAX; i++) {
+
+		// either one thread per input type or a single thread for all input
+		if (isUnified != (i == LOG_ALL)) continue;
+
 		ntStatus = startLogThread(pDeviceObject->DriverObject, i);
 
 		if (NT_SUCCESS(ntStatus)) {
@@ -206,15 +402,31 @@ static NTSTATUS dispatchDevCtlLogStart(PDEVICE_OBJECT pDeviceObject) {
 
 	}
 
+	// set last, so completion routines only queue input once the queues are open and their threads run
+	isLogging = TRUE;
+
 	return ntStatus;
 }
 
 
-static NTSTATUS dispatchDevCtlLogStop() {
+static NTSTATUS dispatchDevCtlLogStop(PDEVICE_OBJECT pDeviceObject) {
 	isLogging = FALSE;
+	flushPendingInput(pDeviceObject->DriverObject);
 	NTSTATUS ntStatus = STATUS_SUCCESS;
 
+	if (pStatsThread) {
+		ntStatus = stopStatsThread();
+
+		if (!NT_SUCCESS(ntStatus)) {
+			DBG_PRINTF("dispatchDevCtlLogStop: stopStatsThread failed: 0x%lx\n", ntStatus);
+		}
+
+	}
+
 	for (int i = 0; i < LOG_MAX; i++) {
+
+		if (!pLogThreads[i]) continue;
+
 		ntStatus = stopLogThread(i);
 
 		if (NT_SUCCESS(ntStatus)) {
@@ -226,49 +438,116 @@ static NTSTATUS dispatchDevCtlLogStop() {
 
 	}
 
+	// the logging threads import the key when they start, so it is not needed anymore
+	RtlSecureZeroMemory(logConfig.key, sizeof(logConfig.key));
+
 	return ntStatus;
 }
 
 
-static NTSTATUS completeKbdRead(PDEVICE_OBJECT pDeviceObject, PIRP pIrp, PVOID pContext) {
-	UNREFERENCED_PARAMETER(pDeviceObject);
-	UNREFERENCED_PARAMETER(pContext);
+static NTSTATUS dispatchDevCtlSetFilter(PIRP pIrp) {
+	
+	// the completion routines read the filter without a lock
+	if (isLogging) return STATUS_DEVICE_BUSY;
 
-	const size_t countData = pIrp->IoStatus.Information / sizeof(KEYBOARD_INPUT_DATA);
+	const PIO_STACK_LOCATION pStackLocation = IoGetCurrentIrpStackLocation(pIrp);
 
-	for (size_t i = 0; i < countData; i++) {
+	if (pStackLocation->Parameters.DeviceIoControl.InputBufferLength < sizeof(FilterConfig)) return STATUS_BUFFER_TOO_SMALL;
 
-		if (!isLogging) break;
+	return setInputFilter((const FilterConfig*)pIrp->AssociatedIrp.SystemBuffer);
+}
 
-		const PKEYBOARD_INPUT_DATA pKbdInputData = (PKEYBOARD_INPUT_DATA)pIrp->AssociatedIrp.SystemBuffer;
 
-		if (!pKbdInputData) {
-			DBG_PRINT("completeKbdRead: No data\n");
+static NTSTATUS dispatchDevCtlGetSources(PIRP pIrp) {
+	const PIO_STACK_LOCATION pStackLocation = IoGetCurrentIrpStackLocation(pIrp);
+	pIrp->IoStatus.Information = 0;
 
-			continue;
-		}
+	if (pStackLocation->Parameters.DeviceIoControl.OutputBufferLength < sizeof(SourceList)) return STATUS_BUFFER_TOO_SMALL;
 
-		logKbdToDbg(pKbdInputData);
+	getSources((SourceList*)pIrp->AssociatedIrp.SystemBuffer);
+	pIrp->IoStatus.Information = sizeof(SourceList);
 
-		KbdDataEntry* const pKbdDataEntry = (KbdDataEntry*)ExAllocatePool2(POOL_FLAG_NON_PAGED, sizeof(KbdDataEntry), KBD_LIST_DATA_TAG);
+	return STATUS_SUCCESS;
+}
 
-		if (!pKbdDataEntry) {
-			DBG_PRINT("completeKbdRead: ExAllocatePool2 failed\n");
 
-			continue;
-		}
+static NTSTATUS dispatchDevCtlEnableSource(PIRP pIrp) {
+	const PIO_STACK_LOCATION pStackLocation = IoGetCurrentIrpStackLocation(pIrp);
 
-		pKbdDataEntry->data = *pKbdInputData;
-		const NTSTATUS ntStatus = addToBlockigQueue(&inputQueues[LOG_KBD], &pKbdDataEntry->list);
+	if (pStackLocation->Parameters.DeviceIoControl.InputBufferLength < sizeof(SourceSelection)) return STATUS_BUFFER_TOO_SMALL;
 
-		if (ntStatus != STATUS_SUCCESS) {
-			DBG_PRINTF("completeKbdRead: addBlockigQueue failed: 0x%lx\n", ntStatus);
+	return enableSource((const SourceSelection*)pIrp->AssociatedIrp.SystemBuffer);
+}
 
-			ExFreePoolWithTag(pKbdDataEntry, KBD_LIST_DATA_TAG);
-		}
 
+static NTSTATUS dispatchDevCtlSetTrace(PIRP pIrp) {
+	const PIO_STACK_LOCATION pStackLocation = IoGetCurrentIrpStackLocation(pIrp);
+
+	if (pStackLocation->Parameters.DeviceIoControl.InputBufferLength < sizeof(TraceConfig)) return STATUS_BUFFER_TOO_SMALL;
+
+	return setTraceConfig((const TraceConfig*)pIrp->AssociatedIrp.SystemBuffer);
+}
+
+
+// Set while input is injected, so only one injection runs at a time.
+static volatile LONG isInjecting;
+// Name of the source of injected input. Sized like the names in the source table.
+static const WCHAR injectSourceName[SOURCE_NAME_LENGTH] = L"\\Device\\LumbrJackInject";
+
+static NTSTATUS dispatchDevCtlInjectInput(PDEVICE_OBJECT pDeviceObject, PIRP pIrp) {
+	const PIO_STACK_LOCATION pStackLocation = IoGetCurrentIrpStackLocation(pIrp);
+	pIrp->IoStatus.Information = 0;
+
+	if (pStackLocation->Parameters.DeviceIoControl.InputBufferLength < sizeof(InjectConfig)) return STATUS_BUFFER_TOO_SMALL;
+
+	if (pStackLocation->Parameters.DeviceIoControl.OutputBufferLength < sizeof(InjectReport)) return STATUS_BUFFER_TOO_SMALL;
+
+	// injected input has no device with compaction or coalescing state and summaries are not queued
+	if (!isLogging || logConfig.flags & (LOG_FLAG_AGGREGATE | LOG_FLAG_COMPACT | LOG_FLAG_MOTION)) return STATUS_INVALID_DEVICE_STATE;
+
+	if (InterlockedExchange(&isInjecting, TRUE)) return STATUS_DEVICE_BUSY;
+
+	Injection injection = { 0 };
+	injection.config = *(const InjectConfig*)pIrp->AssociatedIrp.SystemBuffer;
+	// the injected input gets its own sequence numbers and rate limits
+	NTSTATUS ntStatus = addSource(injectSourceName, FILE_DEVICE_UNKNOWN, &injection.sourceId);
+
+	if (!NT_SUCCESS(ntStatus)) {
+		DBG_PRINTF("dispatchDevCtlInjectInput: addSource failed: 0x%lx\n", ntStatus);
+		InterlockedExchange(&isInjecting, FALSE);
+
+		return ntStatus;
 	}
 
+	injection.kbdSession = (InputSession){ logConfig.flags, &isLogging, &inputQueues[getLogThreadType(LOG_KBD)], 0, NULL, NULL };
+	injection.mouSession = (InputSession){ logConfig.flags, &isLogging, &inputQueues[getLogThreadType(LOG_MOU)], 0, NULL, NULL };
+	ntStatus = injectInput(pDeviceObject->DriverObject, &injection);
+	removeSource(injection.sourceId);
+	InterlockedExchange(&isInjecting, FALSE);
+
+	if (!NT_SUCCESS(ntStatus)) {
+		DBG_PRINTF("dispatchDevCtlInjectInput: injectInput failed: 0x%lx\n", ntStatus);
+
+		return ntStatus;
+	}
+
+	*(InjectReport*)pIrp->AssociatedIrp.SystemBuffer = injection.report;
+	pIrp->IoStatus.Information = sizeof(InjectReport);
+
+	return STATUS_SUCCESS;
+}
+
+
+static NTSTATUS completeKbdRead(PDEVICE_OBJECT pDeviceObject, PIRP pIrp, PVOID pContext) {
+	UNREFERENCED_PARAMETER(pDeviceObject);
+
+	FltDevExtension* const pFltDevExtension = (FltDevExtension*)pContext;
+	const InputSession session = { logConfig.flags, &isLogging, &inputQueues[getLogThreadType(LOG_KBD)], samplePeriod, &pFltDevExtension->kbdCompaction, NULL };
+	// counted before the logging state is read, so a flush waits for the input
+	InterlockedIncrement(&pFltDevExtension->processingCount);
+	processKbdInput((PKEYBOARD_INPUT_DATA)pIrp->AssociatedIrp.SystemBuffer, pIrp->IoStatus.Information / sizeof(KEYBOARD_INPUT_DATA), pFltDevExtension->sourceId, &session);
+	InterlockedDecrement(&pFltDevExtension->processingCount);
+
 	NTSTATUS ntStatus = pIrp->IoStatus.Status;
 
 	if (pIrp->PendingReturned) {
@@ -277,7 +556,8 @@ static NTSTATUS completeKbdRead(PDEVICE_OBJECT pDeviceObject, PIRP pIrp, PVOID p
 	}
 
 	// finish read operation
-	KeReleaseSemaphore(&readSemaphores[LOG_KBD], 0, 1, FALSE);
+	KeReleaseSemaphore(&pFltDevExtension->readSemaphore, 0, 1, FALSE);
+	IoReleaseRemoveLock(&pFltDevExtension->removeLock, pIrp);
 
 	return ntStatus;
 }
@@ -285,46 +565,44 @@ static NTSTATUS completeKbdRead(PDEVICE_OBJECT pDeviceObject, PIRP pIrp, PVOID p
 
 static NTSTATUS completeMouRead(PDEVICE_OBJECT pDeviceObject, PIRP pIrp, PVOID pContext) {
 	UNREFERENCED_PARAMETER(pDeviceObject);
-	UNREFERENCED_PARAMETER(pContext);
-
-	const size_t countData = pIrp->IoStatus.Information / sizeof(MOUSE_INPUT_DATA);
-
-	for (size_t i = 0; i < countData; i++) {
-
-		if (!isLogging) break;
-
-		const PMOUSE_INPUT_DATA pMouInputData = (PMOUSE_INPUT_DATA)pIrp->AssociatedIrp.SystemBuffer + i;
-
-		if (!pMouInputData) {
-			DBG_PRINT("completeMouRead: No data\n");
 
-			continue;
-		}
-
-		// just log button clicks, no cursor movements
-		if (pMouInputData->ButtonFlags) {
-			logMouToDbg(pMouInputData);
+	FltDevExtension* const pFltDevExtension = (FltDevExtension*)pContext;
+	const InputSession session = { logConfig.flags, &isLogging, &inputQueues[getLogThreadType(LOG_MOU)], samplePeriod, NULL, &pFltDevExtension->mouCoalescing };
+	// counted before the logging state is read, so a flush waits for the input
+	InterlockedIncrement(&pFltDevExtension->processingCount);
+	processMouInput((PMOUSE_INPUT_DATA)pIrp->AssociatedIrp.SystemBuffer, pIrp->IoStatus.Information / sizeof(MOUSE_INPUT_DATA), pFltDevExtension->sourceId, &session);
+	InterlockedDecrement(&pFltDevExtension->processingCount);
 
-			MouDataEntry* const pMouDataEntry = (MouDataEntry*)ExAllocatePool2(POOL_FLAG_NON_PAGED, sizeof(MouDataEntry), MOU_LIST_DATA_TAG);
+	NTSTATUS ntStatus = pIrp->IoStatus.Status;
 
-			if (!pMouDataEntry) {
-				DBG_PRINT("completeMouRead: ExAllocatePool2 failed\n");
+	if (pIrp->PendingReturned) {
+		IoMarkIrpPending(pIrp);
+		ntStatus = STATUS_PENDING;
+	}
 
-				continue;
-			}
+	// finish read operation
+	KeReleaseSemaphore(&pFltDevExtension->readSemaphore, 0, 1, FALSE);
+	IoReleaseRemoveLock(&pFltDevExtension->removeLock, pIrp);
 
-			pMouDataEntry->data = *pMouInputData;
-			const NTSTATUS ntStatus = addToBlockigQueue(&inputQueues[LOG_MOU], &pMouDataEntry->list);
+	return ntStatus;
+}
 
-			if (ntStatus != STATUS_SUCCESS) {
-				DBG_PRINTF("completeMouRead: addBlockigQueue failed: 0x%lx\n", ntStatus);
 
-				ExFreePoolWithTag(pMouDataEntry, MOU_LIST_DATA_TAG);
-			}
+// Completes a read that was passed through without logging, because a read of the same device was completed at the same time.
+static NTSTATUS completeSkippedRead(PDEVICE_OBJECT pDeviceObject, PIRP pIrp, PVOID pContext) {
+	UNREFERENCED_PARAMETER(pDeviceObject);
 
-		}
+	FltDevExtension* const pFltDevExtension = (FltDevExtension*)pContext;
+	const USHORT sourceId = pFltDevExtension->sourceId;
 
-	}	
+	if (pFltDevExtension->type == FILE_DEVICE_KEYBOARD) {
+		const InputSession session = { logConfig.flags, &isLogging, &inputQueues[getLogThreadType(LOG_KBD)], 0, NULL, NULL };
+		skipKbdInput((PKEYBOARD_INPUT_DATA)pIrp->AssociatedIrp.SystemBuffer, pIrp->IoStatus.Information / sizeof(KEYBOARD_INPUT_DATA), sourceId, &session);
+	}
+	else {
+		const InputSession session = { logConfig.flags, &isLogging, &inputQueues[getLogThreadType(LOG_MOU)], 0, NULL, NULL };
+		skipMouInput((PMOUSE_INPUT_DATA)pIrp->AssociatedIrp.SystemBuffer, pIrp->IoStatus.Information / sizeof(MOUSE_INPUT_DATA), sourceId, &session);
+	}
 
 	NTSTATUS ntStatus = pIrp->IoStatus.Status;
 
@@ -333,8 +611,7 @@ static NTSTATUS completeMouRead(PDEVICE_OBJECT pDeviceObject, PIRP pIrp, PVOID p
 		ntStatus = STATUS_PENDING;
 	}
 
-	// finish read operation
-	KeReleaseSemaphore(&readSemaphores[LOG_MOU], 0, 1, FALSE);
+	IoReleaseRemoveLock(&pFltDevExtension->removeLock, pIrp);
 
 	return ntStatus;
 }
\ No newline at end of file
@@ -6,8 +6,6 @@
 
 // Indicates if logging of keypresses is switched on or off.
 extern BOOLEAN isLogging;
-// Semaphores to check if read opreation has finished.
-extern KSEMAPHORE readSemaphores[LOG_MAX];
 
 // Finishes a request or passes it through to the next driver in the stack.
 //
@@ -22,6 +20,20 @@ extern KSEMAPHORE readSemaphores[LOG_MAX];
 // An appropriate NTSTATUS value.
 NTSTATUS LmbPassThrough(PDEVICE_OBJECT pDeviceObject, PIRP pIrp);
 
+// Passes a plug and play request to the next driver in the stack.
+// Detaches and deletes the filter device when its device is removed.
+//
+// Parameters:
+// [in] pDeviceObject:
+// Caller-supplied pointer to a DEVICE_OBJECT structure.
+//
+// [in/out] pIrp:
+// Address of the IRP describing the requested I/O operation.
+// 
+// Return:
+// An appropriate NTSTATUS value.
+NTSTATUS LmbDispatchPnp(PDEVICE_OBJECT pDeviceObject, PIRP pIrp);
+
 // Finishes an device control request from the client application indicated by the IOCTL code.
 // Either returns the current logging state, or switches the logging on or off.
 //
@@ -48,3 +60,11 @@ NTSTATUS LmbDispatchDeviceControl(PDEVICE_OBJECT pDeviceObject, PIRP pIrp);
 // Return:
 // An appropriate NTSTATUS value.
 NTSTATUS LmbDispatchRead(PDEVICE_OBJECT pDeviceObject, PIRP pIrp);
+
+// Logs the presses of held keys and the movement that the filter devices absorbed for compact logs or coalesced motion and did not log yet.
+// Has to be called after logging was switched off and before the logging threads are stopped.
+//
+// Parameters:
+// [in] pDriverObject:
+// Address of the driver object of the current driver.
+void flushPendingInput(PDRIVER_OBJECT pDriverObject);
@@ -2,18 +2,17 @@
 #include "dispatch.h"
 #include "BlockingQueue.h"
 #include "log.h"
+#include "stats.h"
+#include "source.h"
+#include "device.h"
+#include "trace.h"
 #include <ntddk.h>
 
-extern POBJECT_TYPE* IoDriverObjectType;
-
 static UNICODE_STRING symLink = RTL_CONSTANT_STRING(L"\\??\\LumbrJackDevSymLink");
 
-NTSTATUS NTAPI ObReferenceObjectByName(PUNICODE_STRING ObjectName, ULONG Attributes, PACCESS_STATE AccessState, ACCESS_MASK DesiredAccess, POBJECT_TYPE ObjectType, KPROCESSOR_MODE AccessMode, PVOID ParseContext, PVOID* Object);
-
 static void unload(PDRIVER_OBJECT pDriverObject);
 static NTSTATUS cleanupDevices(PDRIVER_OBJECT pDriverObject);
 static NTSTATUS setupCommunicationDevice(PDRIVER_OBJECT pDriverObject);
-static NTSTATUS setupFilterDevices(PDRIVER_OBJECT pDriverObject, PUNICODE_STRING pDriverName, ULONG deviceType);
 static void setMajorFunctions(PDRIVER_OBJECT pDriverObject);
 
 NTSTATUS DriverEntry(PDRIVER_OBJECT pDriverObject, PUNICODE_STRING pRegistryPath) {
@@ -22,6 +21,8 @@ NTSTATUS DriverEntry(PDRIVER_OBJECT pDriverObject, PUNICODE_STRING pRegistryPath
 	DBG_PRINT("------------------------\n");
 
 	pDriverObject->DriverUnload = unload;
+	initSources();
+	initFilterDevices();
 	NTSTATUS ntStatus = setupCommunicationDevice(pDriverObject);
 
 	if (!NT_SUCCESS(ntStatus)) {
@@ -35,37 +36,60 @@ NTSTATUS DriverEntry(PDRIVER_OBJECT pDriverObject, PUNICODE_STRING pRegistryPath
 		return ntStatus;
 	}
 
-	UNICODE_STRING kbdDriverName = RTL_CONSTANT_STRING(L"\\Driver\\kbdclass");
-	ntStatus = setupFilterDevices(pDriverObject, &kbdDriverName, FILE_DEVICE_KEYBOARD);
+	initInputQueues();
+	// filter devices receive requests as soon as they are attached
+	setMajorFunctions(pDriverObject);
+
+	// registered before the class devices are walked, so devices that arrive in between are not missed
+	// the walks and the arrivals skip class devices that already have a filter device
+	ntStatus = registerDeviceNotifications(pDriverObject);
 
 	if (!NT_SUCCESS(ntStatus)) {
-		DBG_PRINTF("DriverEntry: setupFilterDevices failed for keyboard driver: 0x%lx\n", ntStatus);
+		DBG_PRINTF("DriverEntry: registerDeviceNotifications failed: 0x%lx\n", ntStatus);
+		unregisterDeviceNotifications();
 		const NTSTATUS ntStatusCleanup = cleanupDevices(pDriverObject);
 
 		if (!NT_SUCCESS(ntStatusCleanup)) {
-			DBG_PRINTF("DriverEntry: setupFilterDevices failed: 0x%lx\n", ntStatusCleanup);
+			DBG_PRINTF("DriverEntry: cleanupDevices failed: 0x%lx\n", ntStatusCleanup);
 		}
 
 		return ntStatus;
 	}
 
-	UNICODE_STRING mouDriverName = RTL_CONSTANT_STRING(L"\\Driver\\mouclass");
-	ntStatus = setupFilterDevices(pDriverObject, &mouDriverName, FILE_DEVICE_MOUSE);
+	ntStatus = attachFilterDevices(pDriverObject, FILE_DEVICE_KEYBOARD);
 
 	if (!NT_SUCCESS(ntStatus)) {
-		DBG_PRINTF("DriverEntry: setupFilterDevices failed for mouse driver: 0x%lx\n", ntStatus);
+		DBG_PRINTF("DriverEntry: attachFilterDevices failed for keyboard driver: 0x%lx\n", ntStatus);
+		unregisterDeviceNotifications();
 		const NTSTATUS ntStatusCleanup = cleanupDevices(pDriverObject);
 
 		if (!NT_SUCCESS(ntStatusCleanup)) {
-			DBG_PRINTF("DriverEntry: setupFilterDevices failed: 0x%lx\n", ntStatusCleanup);
+			DBG_PRINTF("DriverEntry: cleanupDevices failed: 0x%lx\n", ntStatusCleanup);
 		}
 
 		return ntStatus;
 	}
 
-	KeInitializeSemaphore(&readSemaphores[LOG_KBD], 1, 1);
-	KeInitializeSemaphore(&readSemaphores[LOG_MOU], 1, 1);
-	setMajorFunctions(pDriverObject);
+	ntStatus = attachFilterDevices(pDriverObject, FILE_DEVICE_MOUSE);
+
+	if (!NT_SUCCESS(ntStatus)) {
+		DBG_PRINTF("DriverEntry: attachFilterDevices failed for mouse driver: 0x%lx\n", ntStatus);
+		unregisterDeviceNotifications();
+		const NTSTATUS ntStatusCleanup = cleanupDevices(pDriverObject);
+
+		if (!NT_SUCCESS(ntStatusCleanup)) {
+			DBG_PRINTF("DriverEntry: cleanupDevices failed: 0x%lx\n", ntStatusCleanup);
+		}
+
+		return ntStatus;
+	}
+
+	ntStatus = initTrace();
+
+	// the driver works without tracing
+	if (!NT_SUCCESS(ntStatus)) {
+		DBG_PRINTF("DriverEntry: initTrace failed: 0x%lx\n", ntStatus);
+	}
 
 	DBG_PRINT("DriverEntry: Driver loaded\n");
 
@@ -74,10 +98,23 @@ NTSTATUS DriverEntry(PDRIVER_OBJECT pDriverObject, PUNICODE_STRING pRegistryPath
 
 
 static void unload(PDRIVER_OBJECT pDriverObject) {
-	// stop logging if still running
+	// no devices are attached anymore
+	unregisterDeviceNotifications();
+
+	// stop logging if still running, the absorbed input is logged by the threads before they exit
 	isLogging = FALSE;
+	flushPendingInput(pDriverObject);
 	NTSTATUS ntStatus = STATUS_SUCCESS;
 
+	if (pStatsThread) {
+		ntStatus = stopStatsThread();
+
+		if (!NT_SUCCESS(ntStatus)) {
+			DBG_PRINTF("unload: stopStatsThread failed: 0x%lx\n", ntStatus);
+		}
+
+	}
+
 	// stop all threads
 	for (int i = 0; i < LOG_MAX; i++) {
 
@@ -95,21 +132,15 @@ static void unload(PDRIVER_OBJECT pDriverObject) {
 
 	}
 
+	// waits for the pending read requests of all filter devices
 	ntStatus = cleanupDevices(pDriverObject);
 
 	if (!NT_SUCCESS(ntStatus)) {
 		DBG_PRINTF("unload: cleanupDevices failed: 0x%lx\n", ntStatus);
 	}
 
-	// wait for all read operations to finish
-	for (int i = 0; i < LOG_MAX; i++) {
-		ntStatus = KeWaitForSingleObject(&readSemaphores[i], Executive, KernelMode, FALSE, NULL);
-
-		if (!NT_SUCCESS(ntStatus)) {
-			DBG_PRINTF2("unload: KeWaitForSingleObject failed for read semaphore %d: 0x%lx\n", i, ntStatus);
-		}
-
-	}
+	// no trace point is executed anymore
+	freeTrace();
 
 	DBG_PRINT("unload: Driver unloaded\n");
 	DBG_PRINT("------------------------\n");
@@ -133,21 +164,14 @@ static NTSTATUS cleanupDevices(PDRIVER_OBJECT pDriverObject) {
 		}
 	}
 
+	// waits for pending read requests of the filter devices
+	detachFilterDevices(pDriverObject);
+
+	// only the communication device is left
 	PDEVICE_OBJECT pCurDevice = pDriverObject->DeviceObject;
 
 	while (pCurDevice) {
 		const PDEVICE_OBJECT pNextDevice = pCurDevice->NextDevice;
-
-		if (pCurDevice->DeviceExtension) {
-			const PDEVICE_OBJECT pTargetDevice = ((PDEVOBJ_EXTENSION)pCurDevice->DeviceExtension)->DeviceObject;
-
-			if (pTargetDevice) {
-				IoDetachDevice(pTargetDevice);
-				DBG_PRINT("cleanupDevices: Device detached\n");
-			}
-
-		}
-
 		IoDeleteDevice(pCurDevice);
 		DBG_PRINT("cleanupDevices: Device deleted\n");
 		pCurDevice = pNextDevice;
@@ -186,65 +210,16 @@ static NTSTATUS setupCommunicationDevice(PDRIVER_OBJECT pDriverObject) {
 }
 
 
-// setup filter devices
-static NTSTATUS setupFilterDevices(PDRIVER_OBJECT pDriverObject, PUNICODE_STRING pDriverName, ULONG deviceType) {
-	PDRIVER_OBJECT targetDriverObject = NULL;
-	NTSTATUS ntStatus = ObReferenceObjectByName(pDriverName, OBJ_CASE_INSENSITIVE, NULL, 0, *IoDriverObjectType, KernelMode, NULL, &targetDriverObject);
-
-	if (!NT_SUCCESS(ntStatus)) {
-		DBG_PRINTF("setupFilterDevices: ObReferenceObjectByName failed: 0x%lx\n", ntStatus);
-
-		return ntStatus;
-	}
-
-	PDEVICE_OBJECT pCurDeviceObject = targetDriverObject->DeviceObject;
-	ObfDereferenceObject(targetDriverObject);
-
-	while (pCurDeviceObject) {
-		PDEVICE_OBJECT pFltDevObject = NULL;
-		ntStatus = IoCreateDevice(pDriverObject, sizeof(DEVOBJ_EXTENSION), NULL, deviceType, FILE_DEVICE_SECURE_OPEN, FALSE, &pFltDevObject);
-
-		if (NT_SUCCESS(ntStatus)) {
-			DBG_PRINT("setupFilterDevices: Device created\n");
-		}
-		else {
-			DBG_PRINTF("setupFilterDevices: IoCreateDevice failed: 0x%lx\n", ntStatus);
-			pCurDeviceObject = pCurDeviceObject->NextDevice;
-
-			continue;
-		}
-
-		RtlZeroMemory(pFltDevObject->DeviceExtension, sizeof(DEVOBJ_EXTENSION));
-		((PDEVOBJ_EXTENSION)pFltDevObject->DeviceExtension)->Type = (CSHORT)deviceType;
-		ntStatus = IoAttachDeviceToDeviceStackSafe(pFltDevObject, pCurDeviceObject, &((PDEVOBJ_EXTENSION)pFltDevObject->DeviceExtension)->DeviceObject);
-
-		if (NT_SUCCESS(ntStatus)) {
-			DBG_PRINT("setupFilterDevices: Device attached\n");
-		}
-		else {
-			DBG_PRINTF("setupFilterDevices: IoAttachDeviceToDeviceStackSafe failed: 0x%lx\n", ntStatus);
-			IoDeleteDevice(pFltDevObject);
-			pCurDeviceObject = pCurDeviceObject->NextDevice;
-
-			continue;
-		}
+// A filter driver has to pass all requests it does not handle to the devices below, e.g. IRP_MJ_INTERNAL_DEVICE_CONTROL of the port drivers.
+static void setMajorFunctions(PDRIVER_OBJECT pDriverObject) {
 
-		pFltDevObject->Flags |= DO_BUFFERED_IO;
-		pFltDevObject->Flags &= ~DO_DEVICE_INITIALIZING;
-		pCurDeviceObject = pCurDeviceObject->NextDevice;
+	for (int i = 0; i <= IRP_MJ_MAXIMUM_FUNCTION; i++) {
+		pDriverObject->MajorFunction[i] = LmbPassThrough;
 	}
 
-	return ntStatus;
-}
-
-
-static void setMajorFunctions(PDRIVER_OBJECT pDriverObject) {
-	
-	pDriverObject->MajorFunction[IRP_MJ_CREATE] = LmbPassThrough;
-	pDriverObject->MajorFunction[IRP_MJ_CLOSE] = LmbPassThrough;
-	pDriverObject->MajorFunction[IRP_MJ_CLOSE] = LmbPassThrough;
 	pDriverObject->MajorFunction[IRP_MJ_DEVICE_CONTROL] = LmbDispatchDeviceControl;
 	pDriverObject->MajorFunction[IRP_MJ_READ] = LmbDispatchRead;
+	pDriverObject->MajorFunction[IRP_MJ_PNP] = LmbDispatchPnp;
 
 	return;
 }
\ No newline at end of file
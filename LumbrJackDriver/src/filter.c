@@ -0,0 +1,122 @@
+#include "filter.h"
+
+// Tokens are scaled by the number of 100 ns units per second, so refilling is a single multiplication.
+#define TOKEN_SCALE 10000000ull
+
+typedef struct TokenBucket {
+	ULONGLONG rate;
+	ULONGLONG capacity;
+	ULONGLONG tokens;
+	ULONGLONG lastTime;
+}TokenBucket;
+
+typedef struct InputFilter {
+	ULONG flags;
+	UCHAR scanCodes[0x20];
+	USHORT buttonMask;
+	// rates are limited per source
+	TokenBucket kbdBuckets[MAX_SOURCES];
+	TokenBucket mouBuckets[MAX_SOURCES];
+}InputFilter;
+
+static InputFilter inputFilter;
+
+static void initTokenBucket(TokenBucket* pTokenBucket, ULONG rate, ULONG burst);
+static BOOLEAN takeToken(TokenBucket* pTokenBucket, ULONGLONG time);
+
+NTSTATUS setInputFilter(const FilterConfig* pFilterConfig) {
+
+	if (pFilterConfig->rangeCount > FILTER_MAX_RANGES) return STATUS_INVALID_PARAMETER;
+
+	for (ULONG i = 0; i < pFilterConfig->rangeCount; i++) {
+		const ScanCodeRange* const pRange = &pFilterConfig->ranges[i];
+
+		if (pRange->first > pRange->last || pRange->last >= sizeof(inputFilter.scanCodes) * 8) return STATUS_INVALID_PARAMETER;
+
+	}
+
+	inputFilter.flags = pFilterConfig->flags;
+	inputFilter.buttonMask = pFilterConfig->buttonMask;
+	RtlCopyMemory(inputFilter.scanCodes, pFilterConfig->scanCodeSet, sizeof(inputFilter.scanCodes));
+
+	// ranges are merged into the bitmap, so checking a make code is a single bit test
+	for (ULONG i = 0; i < pFilterConfig->rangeCount; i++) {
+
+		for (ULONG code = pFilterConfig->ranges[i].first; code <= pFilterConfig->ranges[i].last; code++) {
+			inputFilter.scanCodes[code / 8] |= (UCHAR)(1 << code % 8);
+		}
+
+	}
+
+	for (USHORT id = 0; id < MAX_SOURCES; id++) {
+		initTokenBucket(&inputFilter.kbdBuckets[id], pFilterConfig->kbdRate, pFilterConfig->kbdBurst);
+		initTokenBucket(&inputFilter.mouBuckets[id], pFilterConfig->mouRate, pFilterConfig->mouBurst);
+	}
+
+	return STATUS_SUCCESS;
+}
+
+
+BOOLEAN filterKbdInput(const KEYBOARD_INPUT_DATA* pKbdInputData, USHORT sourceId, ULONGLONG time) {
+	const ULONG flags = inputFilter.flags;
+
+	if (flags & (pKbdInputData->Flags & KEY_BREAK ? FILTER_FLAG_NO_BREAK : FILTER_FLAG_NO_MAKE)) return FALSE;
+
+	if (flags & FILTER_FLAG_SCAN_CODES) {
+		const USHORT code = pKbdInputData->MakeCode;
+
+		if (code >= sizeof(inputFilter.scanCodes) * 8 || !(inputFilter.scanCodes[code / 8] & 1 << code % 8)) return FALSE;
+
+	}
+
+	return sourceId < MAX_SOURCES && takeToken(&inputFilter.kbdBuckets[sourceId], time);
+}
+
+
+BOOLEAN filterMouInput(const MOUSE_INPUT_DATA* pMouInputData, USHORT sourceId, ULONGLONG time) {
+	const ULONG flags = inputFilter.flags;
+
+	if (pMouInputData->ButtonFlags) {
+
+		if (flags & FILTER_FLAG_BUTTONS && !(pMouInputData->ButtonFlags & inputFilter.buttonMask)) return FALSE;
+
+	}
+	else if (flags & FILTER_FLAG_NO_MOVEMENT) return FALSE;
+
+	return sourceId < MAX_SOURCES && takeToken(&inputFilter.mouBuckets[sourceId], time);
+}
+
+
+static void initTokenBucket(TokenBucket* pTokenBucket, ULONG rate, ULONG burst) {
+	pTokenBucket->rate = rate;
+	pTokenBucket->capacity = (burst ? burst : rate) * TOKEN_SCALE;
+	// the bucket starts full
+	pTokenBucket->tokens = pTokenBucket->capacity;
+	pTokenBucket->lastTime = 0;
+
+	return;
+}
+
+
+static BOOLEAN takeToken(TokenBucket* pTokenBucket, ULONGLONG time) {
+
+	// unlimited
+	if (!pTokenBucket->rate) return TRUE;
+
+	const ULONGLONG elapsed = pTokenBucket->lastTime ? time - pTokenBucket->lastTime : 0;
+	pTokenBucket->lastTime = time;
+
+	// a full refill is checked first, so the multiplication can not overflow after long idle times
+	if (elapsed >= pTokenBucket->capacity / pTokenBucket->rate) {
+		pTokenBucket->tokens = pTokenBucket->capacity;
+	}
+	else {
+		pTokenBucket->tokens = min(pTokenBucket->tokens + elapsed * pTokenBucket->rate, pTokenBucket->capacity);
+	}
+
+	if (pTokenBucket->tokens < TOKEN_SCALE) return FALSE;
+
+	pTokenBucket->tokens -= TOKEN_SCALE;
+
+	return TRUE;
+}
\ No newline at end of file
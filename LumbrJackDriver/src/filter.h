@@ -0,0 +1,54 @@
+#pragma once
+#include "ioctl.h"
+#include "platform.h"
+
+// Early filtering of input in the completion routines, before any allocation or lock.
+// The filter configuration is compiled into a bitmap and token buckets when it is set.
+// The filter can only be set while not logging, so it does not change while input is filtered.
+// The filter functions expect calls from the completion routines, which are serialized per device by the read semaphore of the device.
+// The token buckets belong to the source of a device, so they are not protected by a lock.
+
+// Compiles and sets the input filter.
+//
+// Parameters:
+//
+// [in] pFilterConfig:
+// Address of the filter configuration.
+//
+// Return:
+// STATUS_INVALID_PARAMETER for invalid scan code ranges, otherwise STATUS_SUCCESS.
+NTSTATUS setInputFilter(const FilterConfig* pFilterConfig);
+
+// Checks if keyboard input passes the filter. Takes a token of the keyboard rate limit of the source if it passes.
+//
+// Parameters:
+//
+// [in] pKbdInputData:
+// Address of the keyboard input to check.
+//
+// [in] sourceId:
+// ID of the source of the input.
+//
+// [in] time:
+// Interrupt time of the input in 100 ns units.
+//
+// Return:
+// TRUE if the input passes, FALSE if it should be dropped.
+BOOLEAN filterKbdInput(const KEYBOARD_INPUT_DATA* pKbdInputData, USHORT sourceId, ULONGLONG time);
+
+// Checks if mouse input passes the filter. Takes a token of the mouse rate limit of the source if it passes.
+//
+// Parameters:
+//
+// [in] pMouInputData:
+// Address of the mouse input to check.
+//
+// [in] sourceId:
+// ID of the source of the input.
+//
+// [in] time:
+// Interrupt time of the input in 100 ns units.
+//
+// Return:
+// TRUE if the input passes, FALSE if it should be dropped.
+BOOLEAN filterMouInput(const MOUSE_INPUT_DATA* pMouInputData, USHORT sourceId, ULONGLONG time);
\ No newline at end of file
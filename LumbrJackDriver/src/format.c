@@ -0,0 +1,229 @@
+#include "format.h"
+
+// Scan code to ascii lookup array
+// Unshifted keys of the german keyboard layout. Characters above 0x7F are in Windows-1252.
+// Modifiers are not applied, raw scan codes (LOG_FLAG_RAW) can be decoded with any layout by the client.
+static const char scanToAscii[0x80] = {
+	0,  0x1B, // ESC
+	'1', '2', '3', '4', '5', '6', '7', '8', '9', '0', '\xDF', '\xB4', '\b',
+	 '\t', 'q', 'w', 'e', 'r', 't', 'z', 'u', 'i', 'o', 'p', '\xFC', '+', '\n', 0, // CTRL
+	'a', 's', 'd', 'f', 'g', 'h', 'j', 'k', 'l', '\xF6', '\xE4', '^',  0, // LSHIFT
+	'#', 'y', 'x', 'c', 'v', 'b', 'n', 'm', ',', '.', '-',
+	0, // RSHIFT
+	'*', // Keypad *
+	0, // ALT
+	' ',
+	0,  /* Caps lock */
+	0,  /* 59 - F1 key ... > */
+	0,   0,   0,   0,   0,   0,   0,   0,
+	0,  /* < ... F10 */
+	0,  /* 69 - Num lock*/
+	0,  /* Scroll Lock */
+	0,  /* Home key */
+	0,  /* Up Arrow */
+	0,  /* Page Up */
+  '-',
+	0,  /* Left Arrow */
+	0,
+	0,  /* Right Arrow */
+  '+',
+	0,  /* 79 - End key*/
+	0,  /* Down Arrow */
+	0,  /* Page Down */
+	0,  /* Insert Key */
+	0,  /* Delete Key */
+	0,   0,
+	'<',
+	0,  /* F11 Key */
+	0,  /* F12 Key */
+	0,  /* All other keys are undefined */
+};
+
+static ULONGLONG getLineSequence(const LineSequences* pSequences, USHORT source, ULONGLONG sequence);
+static void skipLine(LineSequences* pSequences, USHORT source);
+
+NTSTATUS formatKbd(const KbdDataEntry* pKbdDataEntry, LineSequences* pSequences, ULONG flags, BOOLEAN isTagged, char* buffer, size_t size) {
+	const KEYBOARD_INPUT_DATA* const pKbdInputData = &pKbdDataEntry->data;
+	buffer[0] = '\0';
+	const char key = (pKbdInputData->Flags & KEY_BREAK || pKbdInputData->MakeCode >= sizeof(scanToAscii)) ? 0 : scanToAscii[pKbdInputData->MakeCode];
+
+	if (!key) {
+		skipLine(pSequences, pKbdDataEntry->source);
+
+		return STATUS_SUCCESS;
+	}
+
+	const char* const tag = isTagged ? "K:" : "";
+	const ULONGLONG sequence = getLineSequence(pSequences, pKbdDataEntry->source, pKbdDataEntry->sequence);
+
+	if (flags & LOG_FLAG_COMPACT) {
+
+		return RtlStringCbPrintfA(buffer, size, "%s%c%s%llu%s%lu%s%llu%s%hu%c", tag, key, "@HOLD:", pKbdDataEntry->holdTime / 10000, "REPEAT:", pKbdDataEntry->repeatCount,
+			"SEQ:", sequence, "SRC:", pKbdDataEntry->source, '\n');
+	}
+
+	if (isTagged) {
+
+		return RtlStringCbPrintfA(buffer, size, "%s%c%s%llu%s%hu%c", tag, key, "SEQ:", sequence, "SRC:", pKbdDataEntry->source, '\n');
+	}
+
+	return RtlStringCbPrintfA(buffer, size, "%c", key);
+}
+
+
+NTSTATUS formatMou(const MouDataEntry* pMouDataEntry, LineSequences* pSequences, ULONG flags, BOOLEAN isTagged, char* buffer, size_t size) {
+	static const USHORT buttonDownFlags[] = { MOUSE_LEFT_BUTTON_DOWN, MOUSE_RIGHT_BUTTON_DOWN, MOUSE_MIDDLE_BUTTON_DOWN, MOUSE_BUTTON_4_DOWN, MOUSE_BUTTON_5_DOWN };
+	static const char* const buttonLabels[] = { "LEFT@X:", "RIGHT@X:", "MIDDLE@X:", "X1@X:", "X2@X:" };
+
+	const MOUSE_INPUT_DATA* const pMouInputData = &pMouDataEntry->data;
+	buffer[0] = '\0';
+	const char* const tag = isTagged ? "M:" : "";
+	char source[0x30] = { 0 };
+	const ULONGLONG sequence = getLineSequence(pSequences, pMouDataEntry->source, pMouDataEntry->sequence);
+	NTSTATUS ntStatus = RtlStringCbPrintfA(source, sizeof(source), "%s%llu%s%hu", "SEQ:", sequence, "SRC:", pMouDataEntry->source);
+	char* pEnd = buffer;
+	size_t remaining = size;
+
+	for (size_t i = 0; i < ARRAYSIZE(buttonDownFlags) && NT_SUCCESS(ntStatus); i++) {
+
+		if (pMouInputData->ButtonFlags & buttonDownFlags[i]) {
+			ntStatus = RtlStringCbPrintfExA(pEnd, remaining, &pEnd, &remaining, 0, "%s%s%ld%s%ld%s%c", tag, buttonLabels[i], pMouInputData->LastX, "Y:", pMouInputData->LastY, source, '\n');
+		}
+
+	}
+
+	const BOOLEAN isButtonPressed = pEnd != buffer;
+
+	if (NT_SUCCESS(ntStatus) && pMouInputData->ButtonFlags & MOUSE_WHEEL) {
+		ntStatus = RtlStringCbPrintfExA(pEnd, remaining, &pEnd, &remaining, 0, "%s%s%hd%s%c", tag, "WHEEL:", (SHORT)pMouInputData->ButtonData, source, '\n');
+	}
+
+	if (NT_SUCCESS(ntStatus) && pMouInputData->ButtonFlags & MOUSE_HWHEEL) {
+		ntStatus = RtlStringCbPrintfExA(pEnd, remaining, &pEnd, &remaining, 0, "%s%s%hd%s%c", tag, "HWHEEL:", (SHORT)pMouInputData->ButtonData, source, '\n');
+	}
+
+	if (NT_SUCCESS(ntStatus) && flags & LOG_FLAG_MOTION && !isButtonPressed) {
+
+		// absolute positions are logged even without movement, since they are the current position of the cursor
+		if (pMouInputData->Flags & MOUSE_MOVE_ABSOLUTE) {
+			ntStatus = RtlStringCbPrintfExA(pEnd, remaining, &pEnd, &remaining, 0, "%s%s%ld%s%ld%s%c", tag, "POS@X:", pMouInputData->LastX, "Y:", pMouInputData->LastY, source, '\n');
+		}
+		else if (pMouInputData->LastX || pMouInputData->LastY) {
+			ntStatus = RtlStringCbPrintfExA(pEnd, remaining, &pEnd, &remaining, 0, "%s%s%ld%s%ld%s%c", tag, "MOVE@X:", pMouInputData->LastX, "Y:", pMouInputData->LastY, source, '\n');
+		}
+
+	}
+
+	if (NT_SUCCESS(ntStatus) && pEnd == buffer) {
+		skipLine(pSequences, pMouDataEntry->source);
+	}
+
+	return ntStatus;
+}
+
+
+ULONG formatKbdRaw(const KbdDataEntry* pKbdDataEntry, ULONG flags, UCHAR* buffer) {
+	const KEYBOARD_INPUT_DATA* const pKbdInputData = &pKbdDataEntry->data;
+
+	if (pKbdInputData->MakeCode > 0x7F) {
+
+		return 0;
+	}
+
+	ULONG size = 0;
+	const UCHAR prefix = pKbdInputData->Flags & KEY_E0 ? 0xE0 : pKbdInputData->Flags & KEY_E1 ? 0xE1 : 0;
+
+	if (prefix) {
+		buffer[size++] = prefix;
+	}
+
+	buffer[size++] = (UCHAR)pKbdInputData->MakeCode | (pKbdInputData->Flags & KEY_BREAK ? 0x80 : 0);
+
+	if (flags & LOG_FLAG_COMPACT) {
+
+		if (prefix) {
+			buffer[size++] = prefix;
+		}
+
+		buffer[size++] = (UCHAR)pKbdInputData->MakeCode | 0x80;
+	}
+
+	return size;
+}
+
+
+NTSTATUS encodeRecords(const DataEntry* pDataEntry, ULONGLONG* pLastTime, InputRecord* records, ULONG* pCount) {
+	const LogType type = pDataEntry->type;
+	const ULONGLONG time = pDataEntry->time;
+	*pCount = 0;
+
+	if (type != LOG_KBD && type != LOG_MOU) {
+
+		return STATUS_INVALID_PARAMETER;
+	}
+
+	RtlZeroMemory(records, RECORDS_PER_ENTRY * sizeof(InputRecord));
+	ULONG count = 0;
+
+	if (time < *pLastTime || time - *pLastTime > MAXULONG) {
+		records[count].type = RECORD_TYPE_TIME;
+		records[count].time.time = time;
+		count++;
+		*pLastTime = time;
+	}
+
+	records[count].timeDelta = (uint32_t)(time - *pLastTime);
+	records[count].source = pDataEntry->source;
+	records[count].sequence = pDataEntry->sequence;
+	*pLastTime = time;
+
+	if (type == LOG_KBD) {
+		const KbdDataEntry* const pKbdDataEntry = CONTAINING_RECORD(pDataEntry, KbdDataEntry, list);
+		KbdRecord* const pKbdRecord = &records[count].kbd;
+		records[count].type = RECORD_TYPE_KBD;
+		pKbdRecord->unitId = pKbdDataEntry->data.UnitId;
+		pKbdRecord->makeCode = pKbdDataEntry->data.MakeCode;
+		pKbdRecord->flags = pKbdDataEntry->data.Flags;
+		pKbdRecord->repeatCount = (uint16_t)min(pKbdDataEntry->repeatCount, MAXUSHORT);
+		pKbdRecord->extraInformation = (uint32_t)pKbdDataEntry->data.ExtraInformation;
+		pKbdRecord->holdTime = (uint32_t)min(pKbdDataEntry->holdTime / 10000, MAXULONG);
+	}
+	else {
+		const MouDataEntry* const pMouDataEntry = CONTAINING_RECORD(pDataEntry, MouDataEntry, list);
+		MouRecord* const pMouRecord = &records[count].mou;
+		records[count].type = RECORD_TYPE_MOU;
+		pMouRecord->unitId = pMouDataEntry->data.UnitId;
+		pMouRecord->flags = pMouDataEntry->data.Flags;
+		pMouRecord->buttonFlags = pMouDataEntry->data.ButtonFlags;
+		pMouRecord->buttonData = pMouDataEntry->data.ButtonData;
+		pMouRecord->lastX = (int32_t)pMouDataEntry->data.LastX;
+		pMouRecord->lastY = (int32_t)pMouDataEntry->data.LastY;
+	}
+
+	*pCount = count + 1;
+
+	return STATUS_SUCCESS;
+}
+
+
+// Gets the sequence number of the lines of an entry: its sequence number without the input of the source that had no lines.
+static ULONGLONG getLineSequence(const LineSequences* pSequences, USHORT source, ULONGLONG sequence) {
+
+	if (source >= MAX_SOURCES) {
+
+		return sequence;
+	}
+
+	return sequence - pSequences->skipped[source];
+}
+
+
+// Counts input of a source that has no lines, so it does not leave a gap.
+static void skipLine(LineSequences* pSequences, USHORT source) {
+
+	if (source < MAX_SOURCES) {
+		pSequences->skipped[source]++;
+	}
+
+	return;
+}
\ No newline at end of file
@@ -0,0 +1,120 @@
+#pragma once
+#include "input.h"
+#include "record.h"
+
+// Formatters of the entries of the blocking queues for the log files.
+// They only write into the buffers of the caller and take the LOG_FLAG_* flags of the session, so they do not depend on the logging threads.
+// Built on the platform layer, so they are part of the user mode build of the driver core.
+
+// Maximum number of bytes of a key formatted by formatKbdRaw.
+#define KBD_RAW_MAX_SIZE 4
+// Maximum number of records of an entry encoded by encodeRecords.
+#define RECORDS_PER_ENTRY 2
+
+// Sequence numbers of the lines of a text log.
+// Text logs have no lines for key releases and other input without text, so input is numbered among the input of its source that has lines.
+// Only input lost on the way to the file leaves a gap. Has to be zeroed when logging is started, like the sequence numbers of the sources.
+typedef struct LineSequences {
+	// Input per source that had no lines so far.
+	ULONGLONG skipped[MAX_SOURCES];
+}LineSequences;
+
+// Formats keyboard input data to a string.
+// Key breaks and keys without ascii representation result in an empty string.
+// Tagged strings are prefixed by "K:" and terminated by a new line.
+// Compacted input is terminated by a new line and contains the hold time in milliseconds and the repeat count.
+// Strings terminated by a new line contain the sequence number and the source ID before the new line.
+//
+// Parameters:
+//
+// [in] pKbdDataEntry:
+// Address of the entry to format.
+//
+// [in/out] pSequences:
+// Sequence numbers of the lines of the log.
+//
+// [in] flags:
+// LOG_FLAG_* flags of the session.
+//
+// [in] isTagged:
+// Prefixes the string with the input type for logs of all input.
+//
+// [out] buffer:
+// Contains the null terminated string on return.
+//
+// [in] size:
+// Size of the buffer in bytes.
+//
+// Return:
+// An appropriate NTSTATUS value.
+NTSTATUS formatKbd(const KbdDataEntry* pKbdDataEntry, LineSequences* pSequences, ULONG flags, BOOLEAN isTagged, char* buffer, size_t size);
+
+// Formats mouse input data to a string with one line per button press and wheel rotation.
+// Button releases are not formatted. Movement is only formatted if motion is logged and no button was pressed.
+// Tagged lines are prefixed by "M:". Every line contains the sequence number and the source ID before the new line.
+// All lines of an entry have the same sequence number.
+//
+// Parameters:
+//
+// [in] pMouDataEntry:
+// Address of the entry to format.
+//
+// [in/out] pSequences:
+// Sequence numbers of the lines of the log.
+//
+// [in] flags:
+// LOG_FLAG_* flags of the session.
+//
+// [in] isTagged:
+// Prefixes the lines with the input type for logs of all input.
+//
+// [out] buffer:
+// Contains the null terminated string on return.
+//
+// [in] size:
+// Size of the buffer in bytes.
+//
+// Return:
+// An appropriate NTSTATUS value.
+NTSTATUS formatMou(const MouDataEntry* pMouDataEntry, LineSequences* pSequences, ULONG flags, BOOLEAN isTagged, char* buffer, size_t size);
+
+// Formats a key as scan code set 1 bytes: an E0 or E1 prefix if flagged, followed by the make code with bit 7 set for breaks.
+// Compacted keystrokes have no break of their own and are formatted as a make directly followed by its break.
+// Make codes above 0x7F result in no bytes.
+//
+// Parameters:
+//
+// [in] pKbdDataEntry:
+// Address of the entry to format.
+//
+// [in] flags:
+// LOG_FLAG_* flags of the session.
+//
+// [out] buffer:
+// Contains the bytes on return. Has to hold KBD_RAW_MAX_SIZE bytes.
+//
+// Return:
+// Number of bytes written to the buffer.
+ULONG formatKbdRaw(const KbdDataEntry* pKbdDataEntry, ULONG flags, UCHAR* buffer);
+
+// Encodes a keyboard or mouse entry as binary record preceded by a time record if necessary.
+// Entries of the queues are not ordered strictly by time, since keyboard and mouse input is completed concurrently.
+// Deltas that are negative or do not fit into 32 bits therefore reset the time with an absolute time record.
+//
+// Parameters:
+//
+// [in] pDataEntry:
+// Address of the head of a KbdDataEntry or MouDataEntry.
+//
+// [in/out] pLastTime:
+// Interrupt time of the last record or the start time of the file. Contains the time of the entry on return.
+//
+// [out] records:
+// Contains the records on return. Has to hold RECORDS_PER_ENTRY records.
+//
+// [out] pCount:
+// Contains the number of records on return.
+//
+// Return:
+// STATUS_INVALID_PARAMETER for an unknown entry type, otherwise STATUS_SUCCESS.
+NTSTATUS encodeRecords(const DataEntry* pDataEntry, ULONGLONG* pLastTime, InputRecord* records, ULONG* pCount);
\ No newline at end of file
@@ -0,0 +1,167 @@
+#include "inject.h"
+#include "debug.h"
+
+// Time the queues get to be drained after the last input event, in 100 ns units.
+#define INJECT_DRAIN_TIMEOUT 300000000ull
+// Interval of the checks if the queues are drained, in 100 ns units.
+#define INJECT_DRAIN_POLL 10000ull
+
+static ULONG injectKbdInput(Injection* pInjection, ULONG index, ULONG count);
+static ULONG injectMouInput(Injection* pInjection, ULONG index, ULONG count);
+static BOOLEAN isDrained(const Injection* pInjection);
+
+void runInjection(Injection* pInjection) {
+	const InjectConfig* const pConfig = &pInjection->config;
+	InjectReport* const pReport = &pInjection->report;
+	RtlZeroMemory(pReport, sizeof(InjectReport));
+
+	const ULONG batch = pConfig->batch ? min(pConfig->batch, INJECT_MAX_BATCH) : 1;
+	const ULONGLONG startTime = platformQueryTime();
+	ULONG kbdIndex = 0;
+	ULONG mouIndex = 0;
+
+	while (kbdIndex < pConfig->kbdCount || mouIndex < pConfig->mouCount) {
+
+		if (!*pInjection->kbdSession.pIsLogging) break;
+
+		// due time of the next batch, so the rate is kept on average even if the delays are coarser than a batch
+		if (pConfig->rate) {
+			const ULONGLONG dueTime = startTime + pReport->generated * 10000000ull / pConfig->rate;
+			const ULONGLONG time = platformQueryTime();
+
+			if (time < dueTime) {
+				platformDelay(dueTime - time);
+			}
+
+		}
+
+		// the input types are interleaved in the ratio of their counts
+		const BOOLEAN isKbd = mouIndex >= pConfig->mouCount || (kbdIndex < pConfig->kbdCount && (ULONGLONG)kbdIndex * pConfig->mouCount <= (ULONGLONG)mouIndex * pConfig->kbdCount);
+		ULONG count = 0;
+		ULONG queued = 0;
+		// processed like the input of a completed read
+		const KIRQL oldIrql = platformRaiseIrql(DISPATCH_LEVEL);
+
+		if (isKbd) {
+			count = min(batch, pConfig->kbdCount - kbdIndex);
+			queued = injectKbdInput(pInjection, kbdIndex, count);
+			kbdIndex += count;
+		}
+		else {
+			count = min(batch, pConfig->mouCount - mouIndex);
+			queued = injectMouInput(pInjection, mouIndex, count);
+			mouIndex += count;
+		}
+
+		platformLowerIrql(oldIrql);
+		pReport->generated += count;
+		pReport->queued += queued;
+	}
+
+	const ULONGLONG injectEndTime = platformQueryTime();
+	pReport->dropped = pReport->generated - pReport->queued;
+	pReport->injectTime = injectEndTime - startTime;
+
+	if (pReport->injectTime) {
+		pReport->achievedRate = (ULONG)min(pReport->generated * 10000000ull / pReport->injectTime, MAXULONG);
+	}
+
+	// the logging threads may still be writing the input of other sources, so the drain time is an upper bound
+	ULONGLONG time = injectEndTime;
+
+	while (!isDrained(pInjection)) {
+
+		if (time - injectEndTime >= INJECT_DRAIN_TIMEOUT) {
+			DBG_PRINT("runInjection: Queues not drained\n");
+
+			return;
+		}
+
+		platformDelay(INJECT_DRAIN_POLL);
+		time = platformQueryTime();
+	}
+
+	pReport->drainTime = time - startTime;
+
+	return;
+}
+
+
+static ULONG injectKbdInput(Injection* pInjection, ULONG index, ULONG count) {
+	KEYBOARD_INPUT_DATA kbdInputData[INJECT_MAX_BATCH];
+	RtlZeroMemory(kbdInputData, sizeof(kbdInputData));
+
+	for (ULONG i = 0; i < count; i++) {
+		const ULONG curIndex = index + i;
+		// Q to P in scan code set 1
+		kbdInputData[i].MakeCode = (USHORT)(0x10 + curIndex / 2 % 10);
+		kbdInputData[i].Flags = curIndex % 2 ? KEY_BREAK : KEY_MAKE;
+		kbdInputData[i].ExtraInformation = curIndex;
+	}
+
+	return processKbdInput(kbdInputData, count, pInjection->sourceId, &pInjection->kbdSession);
+}
+
+
+static ULONG injectMouInput(Injection* pInjection, ULONG index, ULONG count) {
+	MOUSE_INPUT_DATA mouInputData[INJECT_MAX_BATCH];
+	RtlZeroMemory(mouInputData, sizeof(mouInputData));
+
+	for (ULONG i = 0; i < count; i++) {
+		const ULONG curIndex = index + i;
+		mouInputData[i].Flags = MOUSE_MOVE_RELATIVE;
+		mouInputData[i].ButtonFlags = curIndex % 2 ? MOUSE_LEFT_BUTTON_UP : MOUSE_LEFT_BUTTON_DOWN;
+		mouInputData[i].LastX = 1;
+		mouInputData[i].ExtraInformation = curIndex;
+	}
+
+	return processMouInput(mouInputData, count, pInjection->sourceId, &pInjection->mouSession);
+}
+
+
+static BOOLEAN isDrained(const Injection* pInjection) {
+
+	return !getBlockingQueueSize(pInjection->kbdSession.pQueue) && !getBlockingQueueSize(pInjection->mouSession.pQueue);
+}
+
+
+#ifndef LMB_USER_MODE
+
+static void injectStartRoutine(PVOID pStartContext);
+
+NTSTATUS injectInput(PDRIVER_OBJECT pDriverObject, Injection* pInjection) {
+	HANDLE hInjectThread = NULL;
+	OBJECT_ATTRIBUTES threadAttributes = { 0 };
+	InitializeObjectAttributes(&threadAttributes, NULL, 0, NULL, NULL);
+	NTSTATUS ntStatus = IoCreateSystemThread(pDriverObject, &hInjectThread, DELETE | SYNCHRONIZE, &threadAttributes, NULL, NULL, injectStartRoutine, pInjection);
+
+	if (!NT_SUCCESS(ntStatus)) {
+		DBG_PRINTF("injectInput: IoCreateSystemThread failed: 0x%lx\n", ntStatus);
+
+		return ntStatus;
+	}
+
+	// the injection is owned by the caller, so the thread is waited for by its handle without taking a reference
+	ntStatus = ZwWaitForSingleObject(hInjectThread, FALSE, NULL);
+
+	if (!NT_SUCCESS(ntStatus)) {
+		DBG_PRINTF("injectInput: ZwWaitForSingleObject failed: 0x%lx\n", ntStatus);
+	}
+
+	const NTSTATUS ntStatusClose = ZwClose(hInjectThread);
+
+	if (!NT_SUCCESS(ntStatusClose)) {
+		DBG_PRINTF("injectInput: ZwClose failed: 0x%lx\n", ntStatusClose);
+	}
+
+	return ntStatus;
+}
+
+
+static void injectStartRoutine(PVOID pStartContext) {
+	runInjection((Injection*)pStartContext);
+
+	return;
+}
+
+#endif // LMB_USER_MODE
\ No newline at end of file
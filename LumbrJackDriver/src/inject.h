@@ -0,0 +1,44 @@
+#pragma once
+#include "input.h"
+#include "ioctl.h"
+#include "platform.h"
+
+// Injection of synthetic input for throughput tests of the deployed driver (IOCTL_INJECT_INPUT).
+// The input is passed to the same input processing as the input of completed reads, at DISPATCH_LEVEL like a completion routine.
+// So it takes the path of real input through the filters, the blocking queues, the logging threads and the file system.
+// The compaction and coalescing state belongs to the filter devices, so input can not be injected into compacted or coalesced sessions.
+
+// Injection run by a worker thread.
+typedef struct Injection {
+	InjectConfig config;
+	// Source of the injected input. Separate from the input devices, so their sequence numbers and rate limits are not affected.
+	USHORT sourceId;
+	InputSession kbdSession;
+	InputSession mouSession;
+	InjectReport report;
+}Injection;
+
+// Injects the input of an injection and waits for the queues of its sessions to be drained.
+// Stops early if logging is switched off. Has to be called at PASSIVE_LEVEL.
+// Keyboard input alternates presses and releases of the keys Q to P, mouse input alternates left button presses and releases with a movement by one.
+// The extra information of every input event is its index per input type.
+//
+// Parameters:
+//
+// [in/out] pInjection:
+// Address of the injection. Contains the report on return.
+void runInjection(Injection* pInjection);
+
+// Runs an injection on a system thread of the driver and waits for it to finish. Has to be called at PASSIVE_LEVEL.
+//
+// Parameters:
+//
+// [in] pDriverObject:
+// Address of the driver object.
+//
+// [in/out] pInjection:
+// Address of the injection. Contains the report on return.
+//
+// Return:
+// An appropriate NTSTATUS value.
+NTSTATUS injectInput(PDRIVER_OBJECT pDriverObject, Injection* pInjection);
\ No newline at end of file
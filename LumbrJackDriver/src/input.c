@@ -0,0 +1,288 @@
+#include "input.h"
+#include "debug.h"
+#include "compact.h"
+#include "stats.h"
+#include "filter.h"
+#include "source.h"
+#include "trace.h"
+
+static BOOLEAN queueKbdInput(const KEYBOARD_INPUT_DATA* pKbdInputData, ULONGLONG time, ULONG repeatCount, ULONGLONG holdTime, USHORT sourceId, const InputSession* pSession);
+static BOOLEAN queueMouInput(const MOUSE_INPUT_DATA* pMouInputData, ULONGLONG time, USHORT sourceId, const InputSession* pSession);
+
+ULONG processKbdInput(const KEYBOARD_INPUT_DATA* pKbdInputData, size_t count, USHORT sourceId, const InputSession* pSession) {
+
+	if (!pKbdInputData) {
+
+		return 0;
+	}
+
+	const ULONG flags = pSession->flags;
+	// input of disabled sources is rejected as a whole
+	const BOOLEAN isEnabled = isSourceEnabled(sourceId);
+	ULONG queued = 0;
+
+	for (size_t i = 0; i < count; i++) {
+
+		if (!*pSession->pIsLogging || !isEnabled) break;
+
+		const KEYBOARD_INPUT_DATA* const pCurInputData = &pKbdInputData[i];
+		const ULONGLONG time = platformQueryTime();
+		TRACE(TRACE_VERBOSE, TRACE_CAT_KBD, TRACE_POINT_KBD_INPUT, sourceId, pCurInputData->MakeCode, pCurInputData->Flags, pCurInputData->UnitId);
+
+		// filtered input is dropped before any further processing
+		if (!filterKbdInput(pCurInputData, sourceId, time)) {
+			TRACE(TRACE_VERBOSE, TRACE_CAT_KBD, TRACE_POINT_FILTERED, LOG_KBD, sourceId, 0, 0);
+
+			continue;
+		}
+
+		// only the summaries are logged, so the input does not need to be queued
+		if (flags & LOG_FLAG_AGGREGATE) {
+			countKbdInput(pCurInputData);
+
+			continue;
+		}
+
+		KEYBOARD_INPUT_DATA kbdInputData = *pCurInputData;
+		ULONG repeatCount = 0;
+		ULONGLONG holdTime = 0;
+
+		// absorbed input does not need to be queued
+		if (flags & LOG_FLAG_COMPACT && !compactKbdInput(pSession->pKbdCompaction, &kbdInputData, time, &repeatCount, &holdTime)) continue;
+
+		if (!queueKbdInput(&kbdInputData, time, repeatCount, holdTime, sourceId, pSession)) continue;
+
+		queued++;
+	}
+
+	return queued;
+}
+
+
+ULONG processMouInput(const MOUSE_INPUT_DATA* pMouInputData, size_t count, USHORT sourceId, const InputSession* pSession) {
+
+	if (!pMouInputData) {
+
+		return 0;
+	}
+
+	const ULONG flags = pSession->flags;
+	// input of disabled sources is rejected as a whole
+	const BOOLEAN isEnabled = isSourceEnabled(sourceId);
+	ULONG queued = 0;
+
+	for (size_t i = 0; i < count; i++) {
+
+		if (!*pSession->pIsLogging || !isEnabled) break;
+
+		const MOUSE_INPUT_DATA* const pCurInputData = &pMouInputData[i];
+		const ULONGLONG time = platformQueryTime();
+		TRACE(TRACE_VERBOSE, TRACE_CAT_MOU, TRACE_POINT_MOU_INPUT, sourceId, pCurInputData->ButtonFlags | (ULONG)pCurInputData->ButtonData << 16, pCurInputData->LastX, pCurInputData->LastY);
+
+		// filtered input is dropped before any further processing
+		if (!filterMouInput(pCurInputData, sourceId, time)) {
+			TRACE(TRACE_VERBOSE, TRACE_CAT_MOU, TRACE_POINT_FILTERED, LOG_MOU, sourceId, 0, 0);
+
+			continue;
+		}
+
+		// only the summaries are logged, so the input does not need to be queued
+		if (flags & LOG_FLAG_AGGREGATE) {
+			countMouInput(pCurInputData);
+
+			continue;
+		}
+
+		MOUSE_INPUT_DATA mouInputData = *pCurInputData;
+
+		if (flags & LOG_FLAG_MOTION) {
+
+			// absorbed movement does not need to be queued
+			if (!coalesceMouInput(pSession->pMouCoalescing, &mouInputData, time, pSession->samplePeriod)) continue;
+
+		}
+		// just log button and wheel changes, no cursor movements
+		else if (!mouInputData.ButtonFlags) continue;
+
+		if (!queueMouInput(&mouInputData, time, sourceId, pSession)) continue;
+
+		queued++;
+	}
+
+	return queued;
+}
+
+
+ULONG flushKbdInput(USHORT sourceId, const InputSession* pSession) {
+	const ULONG flags = pSession->flags;
+
+	// presses are only absorbed for compact logs
+	if (!(flags & LOG_FLAG_COMPACT) || flags & LOG_FLAG_AGGREGATE || !isSourceEnabled(sourceId)) {
+
+		return 0;
+	}
+
+	KEYBOARD_INPUT_DATA kbdInputData = { 0 };
+	ULONG repeatCount = 0;
+	ULONGLONG pressTime = 0;
+	ULONG queued = 0;
+
+	// the presses are logged with their own time, the hold time is only known with the release
+	while (flushKbdCompaction(pSession->pKbdCompaction, &kbdInputData, &repeatCount, &pressTime)) {
+
+		if (!queueKbdInput(&kbdInputData, pressTime, repeatCount, 0, sourceId, pSession)) continue;
+
+		queued++;
+	}
+
+	return queued;
+}
+
+
+ULONG flushMouInput(USHORT sourceId, const InputSession* pSession) {
+	const ULONG flags = pSession->flags;
+
+	// movement is only coalesced for motion logs
+	if (!(flags & LOG_FLAG_MOTION) || flags & LOG_FLAG_AGGREGATE || !isSourceEnabled(sourceId)) {
+
+		return 0;
+	}
+
+	MOUSE_INPUT_DATA mouInputData = { 0 };
+
+	if (!flushMouCoalescing(pSession->pMouCoalescing, &mouInputData)) return 0;
+
+	return queueMouInput(&mouInputData, platformQueryTime(), sourceId, pSession) ? 1 : 0;
+}
+
+
+ULONG skipKbdInput(const KEYBOARD_INPUT_DATA* pKbdInputData, size_t count, USHORT sourceId, const InputSession* pSession) {
+	const ULONG flags = pSession->flags;
+
+	if (!pKbdInputData || !*pSession->pIsLogging || !isSourceEnabled(sourceId) || flags & LOG_FLAG_AGGREGATE) {
+
+		return 0;
+	}
+
+	ULONG skipped = 0;
+
+	for (size_t i = 0; i < count; i++) {
+
+		if (!(flags & LOG_FLAG_COMPACT) || pKbdInputData[i].Flags & KEY_BREAK) {
+			skipped++;
+		}
+
+	}
+
+	if (skipped) {
+		TRACE(TRACE_WARNING, TRACE_CAT_QUEUE, TRACE_POINT_READ_SKIPPED, LOG_KBD, sourceId, skipped, 0);
+		skipSequences(sourceId, skipped);
+	}
+
+	return skipped;
+}
+
+
+ULONG skipMouInput(const MOUSE_INPUT_DATA* pMouInputData, size_t count, USHORT sourceId, const InputSession* pSession) {
+	const ULONG flags = pSession->flags;
+
+	if (!pMouInputData || !*pSession->pIsLogging || !isSourceEnabled(sourceId) || flags & LOG_FLAG_AGGREGATE) {
+
+		return 0;
+	}
+
+	ULONG skipped = 0;
+
+	for (size_t i = 0; i < count; i++) {
+
+		// just button and wheel changes are logged without motion
+		if (flags & LOG_FLAG_MOTION || pMouInputData[i].ButtonFlags) {
+			skipped++;
+		}
+
+	}
+
+	if (skipped) {
+		TRACE(TRACE_WARNING, TRACE_CAT_QUEUE, TRACE_POINT_READ_SKIPPED, LOG_MOU, sourceId, skipped, 0);
+		skipSequences(sourceId, skipped);
+	}
+
+	return skipped;
+}
+
+
+void freeDataEntry(DataEntry* pDataEntry) {
+
+	if (pDataEntry->type == LOG_KBD) {
+		platformFree(CONTAINING_RECORD(pDataEntry, KbdDataEntry, list), KBD_LIST_DATA_TAG);
+	}
+	else {
+		platformFree(CONTAINING_RECORD(pDataEntry, MouDataEntry, list), MOU_LIST_DATA_TAG);
+	}
+
+	return;
+}
+
+
+// Adds keyboard input to the queue of the session with the next sequence number of its source.
+static BOOLEAN queueKbdInput(const KEYBOARD_INPUT_DATA* pKbdInputData, ULONGLONG time, ULONG repeatCount, ULONGLONG holdTime, USHORT sourceId, const InputSession* pSession) {
+	// taken before the allocation, so input that is dropped from here on leaves a gap in the log file
+	const ULONGLONG sequence = takeSequence(sourceId);
+	KbdDataEntry* const pKbdDataEntry = (KbdDataEntry*)platformAllocate(sizeof(KbdDataEntry), KBD_LIST_DATA_TAG);
+
+	if (!pKbdDataEntry) {
+		TRACE(TRACE_ERROR, TRACE_CAT_QUEUE, TRACE_POINT_ALLOC_FAILED, LOG_KBD, sourceId, 0, 0);
+
+		return FALSE;
+	}
+
+	pKbdDataEntry->type = LOG_KBD;
+	pKbdDataEntry->source = sourceId;
+	pKbdDataEntry->time = time;
+	pKbdDataEntry->sequence = sequence;
+	pKbdDataEntry->data = *pKbdInputData;
+	pKbdDataEntry->repeatCount = repeatCount;
+	pKbdDataEntry->holdTime = holdTime;
+	const NTSTATUS ntStatus = addToBlockigQueue(pSession->pQueue, &pKbdDataEntry->list);
+
+	if (ntStatus != STATUS_SUCCESS) {
+		TRACE(TRACE_ERROR, TRACE_CAT_QUEUE, TRACE_POINT_ENQUEUE_FAILED, LOG_KBD, sourceId, ntStatus, 0);
+
+		platformFree(pKbdDataEntry, KBD_LIST_DATA_TAG);
+
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+
+// Adds mouse input to the queue of the session with the next sequence number of its source.
+static BOOLEAN queueMouInput(const MOUSE_INPUT_DATA* pMouInputData, ULONGLONG time, USHORT sourceId, const InputSession* pSession) {
+	// taken before the allocation, so input that is dropped from here on leaves a gap in the log file
+	const ULONGLONG sequence = takeSequence(sourceId);
+	MouDataEntry* const pMouDataEntry = (MouDataEntry*)platformAllocate(sizeof(MouDataEntry), MOU_LIST_DATA_TAG);
+
+	if (!pMouDataEntry) {
+		TRACE(TRACE_ERROR, TRACE_CAT_QUEUE, TRACE_POINT_ALLOC_FAILED, LOG_MOU, sourceId, 0, 0);
+
+		return FALSE;
+	}
+
+	pMouDataEntry->type = LOG_MOU;
+	pMouDataEntry->source = sourceId;
+	pMouDataEntry->time = time;
+	pMouDataEntry->sequence = sequence;
+	pMouDataEntry->data = *pMouInputData;
+	const NTSTATUS ntStatus = addToBlockigQueue(pSession->pQueue, &pMouDataEntry->list);
+
+	if (ntStatus != STATUS_SUCCESS) {
+		TRACE(TRACE_ERROR, TRACE_CAT_QUEUE, TRACE_POINT_ENQUEUE_FAILED, LOG_MOU, sourceId, ntStatus, 0);
+
+		platformFree(pMouDataEntry, MOU_LIST_DATA_TAG);
+
+		return FALSE;
+	}
+
+	return TRUE;
+}
\ No newline at end of file
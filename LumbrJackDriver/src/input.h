@@ -0,0 +1,190 @@
+#pragma once
+#include "BlockingQueue.h"
+#include "compact.h"
+#include "ioctl.h"
+#include "platform.h"
+
+// Processing of the input of completed reads, from the filters to the blocking queues.
+// The completion routines only unpack their requests and pass the input with the configuration of the session.
+// Built on the platform layer, so it is part of the user mode build of the driver core.
+// The functions expect calls from the completion routines, which are serialized per device by the read semaphore of the device.
+
+// LOG_ALL is not an input type but the type of the thread logging all input to a single file.
+typedef enum LogType {
+	LOG_KBD, LOG_MOU, LOG_ALL, LOG_MAX
+}LogType;
+
+// Common head of all entries of the blocking queues.
+// Lets the logging thread of LOG_ALL determine the type of an entry.
+// The time is the interrupt time of the capture.
+// The sequence number is taken from the source of the input (see source.h).
+typedef struct DataEntry {
+	LIST_ENTRY list;
+	LogType type;
+	USHORT source;
+	ULONGLONG time;
+	ULONGLONG sequence;
+}DataEntry;
+
+// Structure for a doubly linked list containing KEYBOARD_INPUT_DATA for the blocking queue.
+// The repeat count and hold time are only set for compacted input.
+typedef struct KbdDataEntry {
+	LIST_ENTRY list;
+	LogType type;
+	USHORT source;
+	ULONGLONG time;
+	ULONGLONG sequence;
+	KEYBOARD_INPUT_DATA data;
+	ULONG repeatCount;
+	ULONGLONG holdTime;
+}KbdDataEntry;
+
+// Structure for a doubly linked list containing MOUSE_INPUT_DATA for the blocking queue.
+typedef struct MouDataEntry {
+	LIST_ENTRY list;
+	LogType type;
+	USHORT source;
+	ULONGLONG time;
+	ULONGLONG sequence;
+	MOUSE_INPUT_DATA data;
+}MouDataEntry;
+
+// Configuration of the input processing for the current logging session and the device the input comes from.
+typedef struct InputSession {
+	// LOG_FLAG_* flags of the logging configuration.
+	ULONG flags;
+	// Read before every input, so the processing stops as soon as logging is switched off.
+	const volatile BOOLEAN* pIsLogging;
+	// Queue of the logging thread of the input type.
+	BlockingQueue* pQueue;
+	// Minimum time between two records of pure movement in 100 ns units for LOG_FLAG_MOTION.
+	ULONGLONG samplePeriod;
+	// State of the keyboard for LOG_FLAG_COMPACT or of the mouse for LOG_FLAG_MOTION. Only needed for its input type.
+	KbdCompaction* pKbdCompaction;
+	MouCoalescing* pMouCoalescing;
+}InputSession;
+
+// Filters, counts or compacts keyboard input and adds the input to log to the queue of the session.
+// Can be called at IRQL <= DISPATCH_LEVEL.
+//
+// Parameters:
+//
+// [in] pKbdInputData:
+// Address of the first KEYBOARD_INPUT_DATA structure of the read.
+//
+// [in] count:
+// Number of structures.
+//
+// [in] sourceId:
+// ID of the source of the input.
+//
+// [in] pSession:
+// Address of the configuration of the session.
+//
+// Return:
+// Number of entries added to the queue.
+ULONG processKbdInput(const KEYBOARD_INPUT_DATA* pKbdInputData, size_t count, USHORT sourceId, const InputSession* pSession);
+
+// Filters, counts or coalesces mouse input and adds the input to log to the queue of the session.
+// Can be called at IRQL <= DISPATCH_LEVEL.
+//
+// Parameters:
+//
+// [in] pMouInputData:
+// Address of the first MOUSE_INPUT_DATA structure of the read.
+//
+// [in] count:
+// Number of structures.
+//
+// [in] sourceId:
+// ID of the source of the input.
+//
+// [in] pSession:
+// Address of the configuration of the session.
+//
+// Return:
+// Number of entries added to the queue.
+ULONG processMouInput(const MOUSE_INPUT_DATA* pMouInputData, size_t count, USHORT sourceId, const InputSession* pSession);
+
+// Adds the presses of the keys a keyboard holds whose presses were absorbed for LOG_FLAG_COMPACT to the queue of the session, so they are not lost when logging stops.
+// Has to be called after logging was switched off and before the logging threads are stopped, once no completion routine processes input of the device.
+//
+// Parameters:
+//
+// [in] sourceId:
+// ID of the source of the keyboard.
+//
+// [in] pSession:
+// Address of the configuration of the session with the compaction state of the keyboard.
+//
+// Return:
+// Number of entries added to the queue.
+ULONG flushKbdInput(USHORT sourceId, const InputSession* pSession);
+
+// Adds the movement a mouse absorbed for LOG_FLAG_MOTION to the queue of the session, so it is not lost when logging stops.
+// Has to be called after logging was switched off and before the logging threads are stopped, once no completion routine processes input of the device.
+//
+// Parameters:
+//
+// [in] sourceId:
+// ID of the source of the mouse.
+//
+// [in] pSession:
+// Address of the configuration of the session with the coalescing state of the mouse.
+//
+// Return:
+// Number of entries added to the queue.
+ULONG flushMouInput(USHORT sourceId, const InputSession* pSession);
+
+// Skips the sequence numbers of keyboard input that is passed through without processing, so the loss shows up in the log file.
+// The filters and the compaction state can not be used concurrently, so the sequence numbers are skipped for all input that could have been logged.
+// Compacted keys are logged once per release, so only releases are counted for compact logs.
+// Can be called at IRQL <= DISPATCH_LEVEL.
+//
+// Parameters:
+//
+// [in] pKbdInputData:
+// Address of the first KEYBOARD_INPUT_DATA structure of the read.
+//
+// [in] count:
+// Number of structures.
+//
+// [in] sourceId:
+// ID of the source of the input.
+//
+// [in] pSession:
+// Address of the configuration of the session.
+//
+// Return:
+// Number of skipped sequence numbers.
+ULONG skipKbdInput(const KEYBOARD_INPUT_DATA* pKbdInputData, size_t count, USHORT sourceId, const InputSession* pSession);
+
+// Skips the sequence numbers of mouse input that is passed through without processing, so the loss shows up in the log file.
+// Movement is only counted if motion is logged.
+// Can be called at IRQL <= DISPATCH_LEVEL.
+//
+// Parameters:
+//
+// [in] pMouInputData:
+// Address of the first MOUSE_INPUT_DATA structure of the read.
+//
+// [in] count:
+// Number of structures.
+//
+// [in] sourceId:
+// ID of the source of the input.
+//
+// [in] pSession:
+// Address of the configuration of the session.
+//
+// Return:
+// Number of skipped sequence numbers.
+ULONG skipMouInput(const MOUSE_INPUT_DATA* pMouInputData, size_t count, USHORT sourceId, const InputSession* pSession);
+
+// Frees an entry of a blocking queue with the tag of its type.
+//
+// Parameters:
+//
+// [in] pDataEntry:
+// Address of the head of a KbdDataEntry or MouDataEntry.
+void freeDataEntry(DataEntry* pDataEntry);
\ No newline at end of file
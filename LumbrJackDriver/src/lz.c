@@ -0,0 +1,128 @@
+#include "lz.h"
+#include <string.h>
+
+#define LZ_MIN_MATCH 4
+// The last bytes of a block are always literals.
+#define LZ_LAST_LITERALS 5
+// The last match has to start at least this many bytes before the end of a block.
+#define LZ_MATCH_FIND_LIMIT 12
+// Every 64 misses the search step grows by one byte to skip incompressible data quickly.
+#define LZ_SKIP_TRIGGER 6
+
+static uint32_t read32(const uint8_t* p);
+static uint32_t hash32(uint32_t value);
+static uint8_t* writeLength(uint8_t* op, size_t length);
+
+size_t lzCompress(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstCapacity, uint16_t* hashTable) {
+
+	if (srcSize > LZ_BLOCK_SIZE || dstCapacity < LZ_MAX_COMPRESSED_SIZE(srcSize)) {
+
+		return 0;
+	}
+
+	const uint8_t* const end = src + srcSize;
+	const uint8_t* ip = src;
+	const uint8_t* anchor = src;
+	uint8_t* op = dst;
+
+	if (srcSize >= LZ_MATCH_FIND_LIMIT) {
+		const uint8_t* const matchLimit = end - LZ_LAST_LITERALS;
+		const uint8_t* const findLimit = end - LZ_MATCH_FIND_LIMIT;
+		// entries of unused slots point to the start of the block and are rejected by the comparison
+		memset(hashTable, 0, LZ_HASH_TABLE_SIZE);
+		size_t misses = 0;
+		ip++;
+
+		while (ip <= findLimit) {
+			const uint32_t sequence = read32(ip);
+			const uint32_t h = hash32(sequence);
+			const uint8_t* ref = src + hashTable[h];
+			hashTable[h] = (uint16_t)(ip - src);
+
+			if (ref >= ip || read32(ref) != sequence) {
+				ip += 1 + (misses++ >> LZ_SKIP_TRIGGER);
+
+				continue;
+			}
+
+			misses = 0;
+
+			while (ip > anchor && ref > src && ip[-1] == ref[-1]) {
+				ip--;
+				ref--;
+			}
+
+			const uint8_t* matchEnd = ip + LZ_MIN_MATCH;
+			const uint8_t* refEnd = ref + LZ_MIN_MATCH;
+
+			while (matchEnd < matchLimit && *matchEnd == *refEnd) {
+				matchEnd++;
+				refEnd++;
+			}
+
+			const size_t literalLength = (size_t)(ip - anchor);
+			const size_t matchLength = (size_t)(matchEnd - ip) - LZ_MIN_MATCH;
+			const uint16_t offset = (uint16_t)(ip - ref);
+
+			uint8_t* const token = op++;
+			*token = (uint8_t)((literalLength < 0xF ? literalLength : 0xF) << 4 | (matchLength < 0xF ? matchLength : 0xF));
+
+			if (literalLength >= 0xF) {
+				op = writeLength(op, literalLength - 0xF);
+			}
+
+			memcpy(op, anchor, literalLength);
+			op += literalLength;
+			*op++ = (uint8_t)offset;
+			*op++ = (uint8_t)(offset >> 8);
+
+			if (matchLength >= 0xF) {
+				op = writeLength(op, matchLength - 0xF);
+			}
+
+			ip = matchEnd;
+			anchor = ip;
+		}
+
+	}
+
+	const size_t literalLength = (size_t)(end - anchor);
+	*op++ = (uint8_t)((literalLength < 0xF ? literalLength : 0xF) << 4);
+
+	if (literalLength >= 0xF) {
+		op = writeLength(op, literalLength - 0xF);
+	}
+
+	memcpy(op, anchor, literalLength);
+	op += literalLength;
+
+	return (size_t)(op - dst);
+}
+
+
+static uint32_t read32(const uint8_t* p) {
+	uint32_t value = 0;
+	memcpy(&value, p, sizeof(value));
+
+	return value;
+}
+
+
+static uint32_t hash32(uint32_t value) {
+
+	return (value * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+
+// Writes the remainder of a length that does not fit into the four bits of the token.
+static uint8_t* writeLength(uint8_t* op, size_t length) {
+
+	while (length >= 0xFF) {
+		*op++ = 0xFF;
+		length -= 0xFF;
+	}
+
+	*op++ = (uint8_t)length;
+
+	return op;
+}
\ No newline at end of file
@@ -0,0 +1,58 @@
+#pragma once
+// Block compression of log files in the LZ4 block format.
+// Only fixed size types are used, so the format is shared with the decompressor of the client.
+// All values are little endian.
+#include <stddef.h>
+#include <stdint.h>
+
+// "LJBZ"
+#define LZ_FILE_MAGIC 0x5A424A4C
+// Maximum uncompressed size of a block. Match offsets of a block fit into 16 bits.
+#define LZ_BLOCK_SIZE 0x10000
+// Worst case size of a compressed block of srcSize bytes.
+#define LZ_MAX_COMPRESSED_SIZE(srcSize) ((srcSize) + (srcSize) / 0xFF + 0x10)
+#define LZ_HASH_BITS 12
+// Size of the hash table passed to lzCompress in bytes.
+#define LZ_HASH_TABLE_SIZE (sizeof(uint16_t) << LZ_HASH_BITS)
+// Set in the uncompressedSize of the last block of a file, which can be empty. The size is in the bits below.
+#define LZ_BLOCK_FINAL 0x80000000
+
+// Every block of a compressed file starts with this header after the file magic.
+// A block with equal sizes apart from LZ_BLOCK_FINAL is stored uncompressed.
+// Files of a crashed writer end without a final block.
+typedef struct LzBlockHeader {
+	uint32_t uncompressedSize;
+	uint32_t compressedSize;
+}LzBlockHeader;
+
+#ifdef __cplusplus
+// The client compresses columns of exported captures with the same compressor.
+extern "C" {
+#endif // __cplusplus
+
+// Compresses a block.
+//
+// Parameters:
+//
+// [in] src:
+// Data to compress.
+//
+// [in] srcSize:
+// Size of the data. At most LZ_BLOCK_SIZE.
+//
+// [out] dst:
+// Buffer that receives the compressed data.
+//
+// [in] dstCapacity:
+// Size of the buffer. At least LZ_MAX_COMPRESSED_SIZE(srcSize).
+//
+// [in/out] hashTable:
+// Scratch buffer of LZ_HASH_TABLE_SIZE bytes.
+//
+// Return:
+// Size of the compressed data. Zero on invalid sizes.
+size_t lzCompress(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstCapacity, uint16_t* hashTable);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
\ No newline at end of file
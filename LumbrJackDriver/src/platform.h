@@ -0,0 +1,308 @@
+#pragma once
+// Thin platform layer of the portable driver core: the blocking queues, the input processing of the completion routines,
+// the filters, the compaction, the source table and the formatters of the log files.
+// The kernel build maps the layer to the executive. The user mode build (LMB_USER_MODE) maps it to pthreads (see posix.h),
+// so the core can be built and tested on Linux.
+#ifdef LMB_USER_MODE
+#include "posix.h"
+#else
+#include <ntddk.h>
+#include <Ntddkbd.h>
+#include <Ntddmou.h>
+#include <ntstrsafe.h>
+
+typedef KSPIN_LOCK PlatformLock;
+typedef KSEMAPHORE PlatformSemaphore;
+typedef HANDLE PlatformFile;
+#endif // LMB_USER_MODE
+
+// The kernel build inlines the layer, the user mode build links it from posix.c.
+#ifdef LMB_USER_MODE
+#define PLATFORM_API
+#else
+#define PLATFORM_API FORCEINLINE
+#endif // LMB_USER_MODE
+
+// Initializes a lock.
+//
+// Parameters:
+//
+// [out] pLock:
+// Contains an initialized lock on return.
+PLATFORM_API void platformInitLock(PlatformLock* pLock);
+
+// Acquires a lock and raises the IRQL to DISPATCH_LEVEL.
+//
+// Parameters:
+//
+// [in/out] pLock:
+// Address of the lock.
+//
+// Return:
+// The IRQL before the lock was acquired. Has to be passed to platformReleaseLock.
+PLATFORM_API KIRQL platformAcquireLock(PlatformLock* pLock);
+
+// Releases a lock and restores the IRQL.
+//
+// Parameters:
+//
+// [in/out] pLock:
+// Address of the lock.
+//
+// [in] oldIrql:
+// IRQL returned by platformAcquireLock.
+PLATFORM_API void platformReleaseLock(PlatformLock* pLock, KIRQL oldIrql);
+
+// Initializes a semaphore.
+//
+// Parameters:
+//
+// [out] pSemaphore:
+// Contains an initialized semaphore on return.
+//
+// [in] count:
+// Initial count.
+//
+// [in] limit:
+// Maximum count.
+PLATFORM_API void platformInitSemaphore(PlatformSemaphore* pSemaphore, LONG count, LONG limit);
+
+// Decrements the count of a semaphore.
+//
+// Parameters:
+//
+// [in/out] pSemaphore:
+// Address of the semaphore.
+//
+// [in] isBlocking:
+// Waits while the count is zero if TRUE. Has to be FALSE at IRQL >= DISPATCH_LEVEL.
+//
+// Return:
+// STATUS_TIMEOUT if the count is zero and isBlocking is FALSE, otherwise an appropriate NTSTATUS value.
+PLATFORM_API NTSTATUS platformWaitSemaphore(PlatformSemaphore* pSemaphore, BOOLEAN isBlocking);
+
+// Increments the count of a semaphore and wakes a waiting thread.
+//
+// Parameters:
+//
+// [in/out] pSemaphore:
+// Address of the semaphore.
+PLATFORM_API void platformReleaseSemaphore(PlatformSemaphore* pSemaphore);
+
+// Gets the IRQL of the calling thread. Simulated in user mode (see posix.h).
+//
+// Return:
+// The current IRQL.
+PLATFORM_API KIRQL platformGetIrql();
+
+// Raises the IRQL of the calling thread, e.g. to DISPATCH_LEVEL to process input like a completion routine.
+//
+// Parameters:
+//
+// [in] newIrql:
+// IRQL to raise to. Has to be greater than or equal to the current IRQL.
+//
+// Return:
+// The IRQL before it was raised. Has to be passed to platformLowerIrql.
+PLATFORM_API KIRQL platformRaiseIrql(KIRQL newIrql);
+
+// Lowers the IRQL of the calling thread again.
+//
+// Parameters:
+//
+// [in] oldIrql:
+// IRQL returned by platformRaiseIrql.
+PLATFORM_API void platformLowerIrql(KIRQL oldIrql);
+
+// Lets the calling thread wait for an interval. Has to be called at PASSIVE_LEVEL.
+//
+// Parameters:
+//
+// [in] interval:
+// Interval in 100 ns units.
+PLATFORM_API void platformDelay(ULONGLONG interval);
+
+// Allocates zeroed non paged memory. Can be called at IRQL <= DISPATCH_LEVEL.
+//
+// Parameters:
+//
+// [in] size:
+// Size of the allocation in bytes.
+//
+// [in] tag:
+// Pool tag of the allocation (see debug.h).
+//
+// Return:
+// Address of the memory or NULL if the allocation failed.
+PLATFORM_API PVOID platformAllocate(SIZE_T size, ULONG tag);
+
+// Frees memory allocated by platformAllocate.
+//
+// Parameters:
+//
+// [in] pMemory:
+// Address of the memory.
+//
+// [in] tag:
+// Pool tag passed to platformAllocate.
+PLATFORM_API void platformFree(PVOID pMemory, ULONG tag);
+
+// Gets the interrupt time, which is the time input is stamped with.
+//
+// Return:
+// Monotonic time in 100 ns units.
+PLATFORM_API ULONGLONG platformQueryTime();
+
+// Gets the number of active processors, e.g. to allocate per-processor buffers. Simulated in user mode (see posix.h).
+//
+// Return:
+// Number of active processors in all processor groups.
+PLATFORM_API ULONG platformGetProcessorCount();
+
+// Gets the number of the processor the calling thread runs on. Simulated in user mode (see posix.h).
+//
+// Return:
+// Number of the processor across all processor groups, lower than platformGetProcessorCount unless processors were added.
+PLATFORM_API ULONG platformGetCurrentProcessor();
+
+// Orders all memory accesses before the barrier before all memory accesses after it, also for other processors.
+PLATFORM_API void platformMemoryBarrier();
+
+// Writes data to a file at the current position. Has to be called at PASSIVE_LEVEL.
+//
+// Parameters:
+//
+// [in] hFile:
+// File opened for writing.
+//
+// [in] data:
+// Address of the data.
+//
+// [in] size:
+// Size of the data in bytes.
+//
+// Return:
+// An appropriate NTSTATUS value.
+PLATFORM_API NTSTATUS platformWriteFile(PlatformFile hFile, const void* data, ULONG size);
+
+#ifndef LMB_USER_MODE
+
+FORCEINLINE void platformInitLock(PlatformLock* pLock) {
+	KeInitializeSpinLock(pLock);
+
+	return;
+}
+
+
+FORCEINLINE KIRQL platformAcquireLock(PlatformLock* pLock) {
+	KIRQL oldIrql = PASSIVE_LEVEL;
+	KeAcquireSpinLock(pLock, &oldIrql);
+
+	return oldIrql;
+}
+
+
+FORCEINLINE void platformReleaseLock(PlatformLock* pLock, KIRQL oldIrql) {
+	KeReleaseSpinLock(pLock, oldIrql);
+
+	return;
+}
+
+
+FORCEINLINE void platformInitSemaphore(PlatformSemaphore* pSemaphore, LONG count, LONG limit) {
+	KeInitializeSemaphore(pSemaphore, count, limit);
+
+	return;
+}
+
+
+FORCEINLINE NTSTATUS platformWaitSemaphore(PlatformSemaphore* pSemaphore, BOOLEAN isBlocking) {
+	// timeout needs to be zero at IRQL >= DISPATCH_LEVEL
+	LARGE_INTEGER zeroTimeout = { .QuadPart = 0 };
+
+	return KeWaitForSingleObject(pSemaphore, Executive, KernelMode, FALSE, isBlocking ? NULL : &zeroTimeout);
+}
+
+
+FORCEINLINE void platformReleaseSemaphore(PlatformSemaphore* pSemaphore) {
+	KeReleaseSemaphore(pSemaphore, 0, 1, FALSE);
+
+	return;
+}
+
+
+FORCEINLINE KIRQL platformGetIrql() {
+
+	return KeGetCurrentIrql();
+}
+
+
+FORCEINLINE KIRQL platformRaiseIrql(KIRQL newIrql) {
+	KIRQL oldIrql = PASSIVE_LEVEL;
+	KeRaiseIrql(newIrql, &oldIrql);
+
+	return oldIrql;
+}
+
+
+FORCEINLINE void platformLowerIrql(KIRQL oldIrql) {
+	KeLowerIrql(oldIrql);
+
+	return;
+}
+
+
+FORCEINLINE void platformDelay(ULONGLONG interval) {
+	// negative intervals are relative
+	LARGE_INTEGER delay = { .QuadPart = -(LONGLONG)interval };
+	KeDelayExecutionThread(KernelMode, FALSE, &delay);
+
+	return;
+}
+
+
+FORCEINLINE PVOID platformAllocate(SIZE_T size, ULONG tag) {
+
+	return ExAllocatePool2(POOL_FLAG_NON_PAGED, size, tag);
+}
+
+
+FORCEINLINE void platformFree(PVOID pMemory, ULONG tag) {
+	ExFreePoolWithTag(pMemory, tag);
+
+	return;
+}
+
+
+FORCEINLINE ULONGLONG platformQueryTime() {
+
+	return KeQueryInterruptTime();
+}
+
+
+FORCEINLINE ULONG platformGetProcessorCount() {
+
+	return KeQueryActiveProcessorCountEx(ALL_PROCESSOR_GROUPS);
+}
+
+
+FORCEINLINE ULONG platformGetCurrentProcessor() {
+
+	return KeGetCurrentProcessorNumberEx(NULL);
+}
+
+
+FORCEINLINE void platformMemoryBarrier() {
+	KeMemoryBarrier();
+
+	return;
+}
+
+
+FORCEINLINE NTSTATUS platformWriteFile(PlatformFile hFile, const void* data, ULONG size) {
+	IO_STATUS_BLOCK ioStatusBlock = { 0 };
+
+	return ZwWriteFile(hFile, NULL, NULL, NULL, &ioStatusBlock, (PVOID)data, size, NULL, NULL);
+}
+
+#endif // LMB_USER_MODE
\ No newline at end of file
@@ -0,0 +1,310 @@
+#include "platform.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+// IRQL simulated per thread. Threads start at PASSIVE_LEVEL.
+static _Thread_local KIRQL simulatedIrql = PASSIVE_LEVEL;
+// Interrupt time set by the tests. Zero for the monotonic clock.
+static volatile ULONGLONG simulatedTime;
+// Processor count set by the tests. Zero for the processors of the machine.
+static volatile ULONG simulatedProcessorCount;
+// Processor simulated per thread.
+static _Thread_local ULONG simulatedProcessor;
+// Calls of platformAllocate for the benchmarks.
+static volatile ULONGLONG allocationCount;
+
+void setSimulatedIrql(KIRQL irql) {
+	simulatedIrql = irql;
+
+	return;
+}
+
+
+void setSimulatedTime(ULONGLONG time) {
+	__atomic_store_n(&simulatedTime, time, __ATOMIC_SEQ_CST);
+
+	return;
+}
+
+
+void setSimulatedProcessorCount(ULONG count) {
+	__atomic_store_n(&simulatedProcessorCount, count, __ATOMIC_SEQ_CST);
+
+	return;
+}
+
+
+void setSimulatedProcessor(ULONG processor) {
+	simulatedProcessor = processor;
+
+	return;
+}
+
+
+ULONGLONG getAllocationCount() {
+
+	return __atomic_load_n(&allocationCount, __ATOMIC_RELAXED);
+}
+
+
+void platformInitLock(PlatformLock* pLock) {
+	pthread_mutex_init(pLock, NULL);
+
+	return;
+}
+
+
+KIRQL platformAcquireLock(PlatformLock* pLock) {
+	pthread_mutex_lock(pLock);
+	const KIRQL oldIrql = simulatedIrql;
+	simulatedIrql = DISPATCH_LEVEL;
+
+	return oldIrql;
+}
+
+
+void platformReleaseLock(PlatformLock* pLock, KIRQL oldIrql) {
+	simulatedIrql = oldIrql;
+	pthread_mutex_unlock(pLock);
+
+	return;
+}
+
+
+void platformInitSemaphore(PlatformSemaphore* pSemaphore, LONG count, LONG limit) {
+	pthread_mutex_init(&pSemaphore->mutex, NULL);
+	pthread_cond_init(&pSemaphore->condition, NULL);
+	pSemaphore->count = count;
+	pSemaphore->limit = limit;
+
+	return;
+}
+
+
+NTSTATUS platformWaitSemaphore(PlatformSemaphore* pSemaphore, BOOLEAN isBlocking) {
+	pthread_mutex_lock(&pSemaphore->mutex);
+
+	while (!pSemaphore->count) {
+
+		if (!isBlocking) {
+			pthread_mutex_unlock(&pSemaphore->mutex);
+
+			return STATUS_TIMEOUT;
+		}
+
+		pthread_cond_wait(&pSemaphore->condition, &pSemaphore->mutex);
+	}
+
+	pSemaphore->count--;
+	pthread_mutex_unlock(&pSemaphore->mutex);
+
+	return STATUS_SUCCESS;
+}
+
+
+// Releasing a semaphore above its limit raises an exception in the kernel, so it is treated as a bug of the caller.
+void platformReleaseSemaphore(PlatformSemaphore* pSemaphore) {
+	pthread_mutex_lock(&pSemaphore->mutex);
+
+	if (pSemaphore->count >= pSemaphore->limit) {
+		fprintf(stderr, "platformReleaseSemaphore: Limit of %ld exceeded\n", pSemaphore->limit);
+		abort();
+	}
+
+	pSemaphore->count++;
+	pthread_cond_signal(&pSemaphore->condition);
+	pthread_mutex_unlock(&pSemaphore->mutex);
+
+	return;
+}
+
+
+KIRQL platformGetIrql() {
+
+	return simulatedIrql;
+}
+
+
+KIRQL platformRaiseIrql(KIRQL newIrql) {
+	const KIRQL oldIrql = simulatedIrql;
+	simulatedIrql = newIrql;
+
+	return oldIrql;
+}
+
+
+void platformLowerIrql(KIRQL oldIrql) {
+	simulatedIrql = oldIrql;
+
+	return;
+}
+
+
+void platformDelay(ULONGLONG interval) {
+
+	// simulated time passes without waiting
+	if (__atomic_load_n(&simulatedTime, __ATOMIC_SEQ_CST)) {
+		__atomic_add_fetch(&simulatedTime, interval, __ATOMIC_SEQ_CST);
+
+		return;
+	}
+
+	const struct timespec delay = { (time_t)(interval / 10000000), (long)(interval % 10000000 * 100) };
+	nanosleep(&delay, NULL);
+
+	return;
+}
+
+
+PVOID platformAllocate(SIZE_T size, ULONG tag) {
+	UNREFERENCED_PARAMETER(tag);
+
+	__atomic_add_fetch(&allocationCount, 1, __ATOMIC_RELAXED);
+
+	return calloc(1, size);
+}
+
+
+void platformFree(PVOID pMemory, ULONG tag) {
+	UNREFERENCED_PARAMETER(tag);
+
+	free(pMemory);
+
+	return;
+}
+
+
+ULONGLONG platformQueryTime() {
+	const ULONGLONG time = __atomic_load_n(&simulatedTime, __ATOMIC_SEQ_CST);
+
+	if (time) {
+
+		return time;
+	}
+
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (ULONGLONG)now.tv_sec * 10000000 + (ULONGLONG)now.tv_nsec / 100;
+}
+
+
+ULONG platformGetProcessorCount() {
+	const ULONG count = __atomic_load_n(&simulatedProcessorCount, __ATOMIC_SEQ_CST);
+
+	if (count) {
+
+		return count;
+	}
+
+	const long processors = sysconf(_SC_NPROCESSORS_CONF);
+
+	return processors > 0 ? (ULONG)processors : 1;
+}
+
+
+ULONG platformGetCurrentProcessor() {
+
+	return simulatedProcessor;
+}
+
+
+void platformMemoryBarrier() {
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+	return;
+}
+
+
+NTSTATUS platformWriteFile(PlatformFile hFile, const void* data, ULONG size) {
+	const char* pCur = (const char*)data;
+	size_t remaining = size;
+
+	while (remaining) {
+		const ssize_t written = write(hFile, pCur, remaining);
+
+		if (written < 0) {
+
+			return STATUS_UNSUCCESSFUL;
+		}
+
+		pCur += written;
+		remaining -= (size_t)written;
+	}
+
+	return STATUS_SUCCESS;
+}
+
+
+NTSTATUS RtlStringCbPrintfA(char* dest, size_t size, const char* format, ...) {
+
+	if (!size) {
+
+		return STATUS_INVALID_PARAMETER;
+	}
+
+	va_list args;
+	va_start(args, format);
+	const int length = vsnprintf(dest, size, format, args);
+	va_end(args);
+
+	if (length < 0) {
+		dest[0] = '\0';
+
+		return STATUS_INVALID_PARAMETER;
+	}
+
+	return (size_t)length < size ? STATUS_SUCCESS : STATUS_BUFFER_OVERFLOW;
+}
+
+
+NTSTATUS RtlStringCbPrintfExA(char* dest, size_t size, char** ppDestEnd, size_t* pRemaining, ULONG flags, const char* format, ...) {
+	UNREFERENCED_PARAMETER(flags);
+
+	if (!size) {
+
+		return STATUS_INVALID_PARAMETER;
+	}
+
+	va_list args;
+	va_start(args, format);
+	const int length = vsnprintf(dest, size, format, args);
+	va_end(args);
+
+	if (length < 0) {
+		dest[0] = '\0';
+
+		return STATUS_INVALID_PARAMETER;
+	}
+
+	// the end points to the terminating null, also if the string was truncated
+	const size_t written = min((size_t)length, size - 1);
+
+	if (ppDestEnd) {
+		*ppDestEnd = dest + written;
+	}
+
+	if (pRemaining) {
+		*pRemaining = size - written;
+	}
+
+	return (size_t)length < size ? STATUS_SUCCESS : STATUS_BUFFER_OVERFLOW;
+}
+
+
+NTSTATUS RtlStringCbLengthA(const char* str, size_t maxSize, size_t* pLength) {
+	const size_t length = strnlen(str, maxSize);
+
+	if (length == maxSize) {
+
+		return STATUS_INVALID_PARAMETER;
+	}
+
+	if (pLength) {
+		*pLength = length;
+	}
+
+	return STATUS_SUCCESS;
+}
\ No newline at end of file
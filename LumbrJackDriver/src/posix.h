@@ -0,0 +1,226 @@
+#pragma once
+// Kernel types, status codes and runtime functions for the user mode build of the driver core (see platform.h).
+// Only defines what the portable sources use. Types have the sizes of the kernel types on 64 bit Linux,
+// except LONG and ULONG, which are as wide as long, so the format strings of the driver are valid on both platforms.
+#include <pthread.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+typedef unsigned char UCHAR, BOOLEAN, *PUCHAR;
+typedef char CHAR;
+typedef short SHORT, CSHORT;
+typedef unsigned short USHORT, *PUSHORT, WCHAR;
+typedef long LONG;
+typedef unsigned long ULONG, *PULONG;
+typedef long long LONGLONG, LONG64;
+typedef unsigned long long ULONGLONG;
+typedef size_t SIZE_T;
+typedef void* PVOID;
+typedef int32_t NTSTATUS;
+typedef UCHAR KIRQL;
+
+#define TRUE 1
+#define FALSE 0
+
+#define NT_SUCCESS(s) ((NTSTATUS)(s) >= 0)
+#define STATUS_SUCCESS ((NTSTATUS)0x00000000)
+#define STATUS_TIMEOUT ((NTSTATUS)0x00000102)
+#define STATUS_NO_MORE_ENTRIES ((NTSTATUS)0x8000001A)
+#define STATUS_BUFFER_OVERFLOW ((NTSTATUS)0x80000005)
+#define STATUS_UNSUCCESSFUL ((NTSTATUS)0xC0000001)
+#define STATUS_INVALID_PARAMETER ((NTSTATUS)0xC000000D)
+#define STATUS_INSUFFICIENT_RESOURCES ((NTSTATUS)0xC000009A)
+#define STATUS_PIPE_CLOSING ((NTSTATUS)0xC00000B1)
+#define STATUS_MEMORY_NOT_ALLOCATED ((NTSTATUS)0xC00000A0)
+#define STATUS_INVALID_DEVICE_STATE ((NTSTATUS)0xC0000184)
+#define STATUS_NOT_FOUND ((NTSTATUS)0xC0000225)
+
+#define PASSIVE_LEVEL 0
+#define APC_LEVEL 1
+#define DISPATCH_LEVEL 2
+
+#define MAXUSHORT 0xffff
+#define MAXULONG 0xffffffffUL
+
+#define ARRAYSIZE(a) (sizeof(a) / sizeof((a)[0]))
+#define UNREFERENCED_PARAMETER(p) ((void)(p))
+#define FIELD_OFFSET(type, field) ((LONG)offsetof(type, field))
+#define CONTAINING_RECORD(address, type, field) ((type*)((char*)(address) - offsetof(type, field)))
+
+#ifndef min
+#define min(a, b) ((a) < (b) ? (a) : (b))
+#endif // min
+
+#define RtlZeroMemory(destination, length) memset((destination), 0, (length))
+#define RtlCopyMemory(destination, source, length) memcpy((destination), (source), (length))
+
+// Debug output of the driver is not printed.
+#define KdPrintEx(args) ((void)0)
+
+#define FILE_DEVICE_KEYBOARD 0x0000000b
+#define FILE_DEVICE_MOUSE 0x0000000f
+#define FILE_DEVICE_UNKNOWN 0x00000022
+#define METHOD_BUFFERED 0
+#define FILE_READ_DATA 0x0001
+#define FILE_WRITE_DATA 0x0002
+#define CTL_CODE(deviceType, function, method, access) (((deviceType) << 16) | ((access) << 14) | ((function) << 2) | (method))
+
+// Interlocked operations are sequentially consistent like on Windows.
+#define InterlockedIncrement(pAddend) __atomic_add_fetch((pAddend), 1, __ATOMIC_SEQ_CST)
+#define InterlockedDecrement(pAddend) __atomic_sub_fetch((pAddend), 1, __ATOMIC_SEQ_CST)
+#define InterlockedIncrement64(pAddend) __atomic_add_fetch((pAddend), 1, __ATOMIC_SEQ_CST)
+#define InterlockedExchange(pTarget, value) __atomic_exchange_n((pTarget), (value), __ATOMIC_SEQ_CST)
+#define InterlockedExchange64(pTarget, value) __atomic_exchange_n((pTarget), (value), __ATOMIC_SEQ_CST)
+#define InterlockedExchangeAdd64(pAddend, value) __atomic_fetch_add((pAddend), (value), __ATOMIC_SEQ_CST)
+#define InterlockedCompareExchange(pDestination, exchange, comparand) \
+	__extension__({ __typeof__(+*(pDestination)) expected = (comparand); __atomic_compare_exchange_n((pDestination), &expected, (exchange), 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST); expected; })
+
+typedef struct _LIST_ENTRY {
+	struct _LIST_ENTRY* Flink;
+	struct _LIST_ENTRY* Blink;
+}LIST_ENTRY, *PLIST_ENTRY;
+
+static inline void InitializeListHead(PLIST_ENTRY pListHead) {
+	pListHead->Flink = pListHead;
+	pListHead->Blink = pListHead;
+
+	return;
+}
+
+
+static inline BOOLEAN IsListEmpty(const LIST_ENTRY* pListHead) {
+
+	return pListHead->Flink == pListHead;
+}
+
+
+static inline void InsertTailList(PLIST_ENTRY pListHead, PLIST_ENTRY pEntry) {
+	PLIST_ENTRY const pBlink = pListHead->Blink;
+	pEntry->Flink = pListHead;
+	pEntry->Blink = pBlink;
+	pBlink->Flink = pEntry;
+	pListHead->Blink = pEntry;
+
+	return;
+}
+
+
+static inline PLIST_ENTRY RemoveHeadList(PLIST_ENTRY pListHead) {
+	PLIST_ENTRY const pEntry = pListHead->Flink;
+	PLIST_ENTRY const pFlink = pEntry->Flink;
+	pListHead->Flink = pFlink;
+	pFlink->Blink = pListHead;
+
+	return pEntry;
+}
+
+// Keyboard input of Ntddkbd.h.
+#define KEY_MAKE 0
+#define KEY_BREAK 1
+#define KEY_E0 2
+#define KEY_E1 4
+
+typedef struct _KEYBOARD_INPUT_DATA {
+	USHORT UnitId;
+	USHORT MakeCode;
+	USHORT Flags;
+	USHORT Reserved;
+	ULONG ExtraInformation;
+}KEYBOARD_INPUT_DATA, *PKEYBOARD_INPUT_DATA;
+
+// Mouse input of Ntddmou.h.
+#define MOUSE_MOVE_RELATIVE 0
+#define MOUSE_MOVE_ABSOLUTE 1
+#define MOUSE_VIRTUAL_DESKTOP 0x02
+#define MOUSE_LEFT_BUTTON_DOWN 0x0001
+#define MOUSE_LEFT_BUTTON_UP 0x0002
+#define MOUSE_RIGHT_BUTTON_DOWN 0x0004
+#define MOUSE_RIGHT_BUTTON_UP 0x0008
+#define MOUSE_MIDDLE_BUTTON_DOWN 0x0010
+#define MOUSE_MIDDLE_BUTTON_UP 0x0020
+#define MOUSE_BUTTON_4_DOWN 0x0040
+#define MOUSE_BUTTON_4_UP 0x0080
+#define MOUSE_BUTTON_5_DOWN 0x0100
+#define MOUSE_BUTTON_5_UP 0x0200
+#define MOUSE_WHEEL 0x0400
+#define MOUSE_HWHEEL 0x0800
+
+typedef struct _MOUSE_INPUT_DATA {
+	USHORT UnitId;
+	USHORT Flags;
+	union {
+		ULONG Buttons;
+		struct {
+			USHORT ButtonFlags;
+			USHORT ButtonData;
+		};
+	};
+	ULONG RawButtons;
+	LONG LastX;
+	LONG LastY;
+	ULONG ExtraInformation;
+}MOUSE_INPUT_DATA, *PMOUSE_INPUT_DATA;
+
+// String functions of ntstrsafe.h. Truncated strings are terminated and fail with STATUS_BUFFER_OVERFLOW.
+NTSTATUS RtlStringCbPrintfA(char* dest, size_t size, const char* format, ...) __attribute__((format(printf, 3, 4)));
+NTSTATUS RtlStringCbPrintfExA(char* dest, size_t size, char** ppDestEnd, size_t* pRemaining, ULONG flags, const char* format, ...) __attribute__((format(printf, 6, 7)));
+NTSTATUS RtlStringCbLengthA(const char* str, size_t maxSize, size_t* pLength);
+
+// Synchronization objects of the platform layer.
+typedef pthread_mutex_t PlatformLock;
+
+typedef struct PlatformSemaphore {
+	pthread_mutex_t mutex;
+	pthread_cond_t condition;
+	LONG count;
+	LONG limit;
+}PlatformSemaphore;
+
+// File descriptor.
+typedef int PlatformFile;
+
+// Objects of the kernel headers the shared headers declare functions with. Defined by the device stack simulator (see test/sim).
+typedef struct _KTHREAD* PKTHREAD;
+typedef struct _DRIVER_OBJECT* PDRIVER_OBJECT;
+
+// Sets the IRQL the calling thread simulates, e.g. DISPATCH_LEVEL to run code like a completion routine.
+// Threads start at PASSIVE_LEVEL. Acquiring a lock raises the simulated IRQL to DISPATCH_LEVEL until it is released.
+//
+// Parameters:
+//
+// [in] irql:
+// The simulated IRQL.
+void setSimulatedIrql(KIRQL irql);
+
+// Sets the interrupt time returned by platformQueryTime, so tests get reproducible times.
+// While the time is set, platformDelay advances it instead of waiting.
+//
+// Parameters:
+//
+// [in] time:
+// Interrupt time in 100 ns units. Zero returns to the monotonic clock.
+void setSimulatedTime(ULONGLONG time);
+
+// Sets the number of processors returned by platformGetProcessorCount, so per-processor buffers can be tested on any machine.
+//
+// Parameters:
+//
+// [in] count:
+// Number of simulated processors. Zero returns to the number of processors of the machine.
+void setSimulatedProcessorCount(ULONG count);
+
+// Sets the processor the calling thread simulates to run on. Threads start on processor 0.
+//
+// Parameters:
+//
+// [in] processor:
+// Number of the simulated processor.
+void setSimulatedProcessor(ULONG processor);
+
+// Gets the number of calls of platformAllocate since the start of the process, so benchmarks can report allocations per operation.
+//
+// Return:
+// Number of allocations, including failed ones.
+ULONGLONG getAllocationCount();
\ No newline at end of file
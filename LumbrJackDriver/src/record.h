@@ -0,0 +1,83 @@
+#pragma once
+// Binary log format shared by the driver and the decoder of the client.
+// Only fixed size types are used, so the decoder builds on any platform.
+// All values are little endian.
+#include <stdint.h>
+
+// "LJRB"
+#define RECORD_MAGIC 0x42524A4C
+#define RECORD_VERSION 2
+// Size of the records of version 1, which end before the sequence number.
+#define RECORD_SIZE_V1 24
+// Checks the version and record size of a file header. Records of version 1 are read into the first bytes of an InputRecord.
+#define RECORD_IS_SUPPORTED(pHeader) (((pHeader)->version == 1 && (pHeader)->recordSize == RECORD_SIZE_V1) \
+	|| ((pHeader)->version == RECORD_VERSION && (pHeader)->recordSize == sizeof(InputRecord)))
+// Ticks per second of all times.
+#define RECORD_TIME_RESOLUTION 10000000
+
+// Record types.
+#define RECORD_TYPE_KBD 1
+#define RECORD_TYPE_MOU 2
+// Sets the absolute time for the following deltas. Written if a delta does not fit into 32 bits.
+#define RECORD_TYPE_TIME 3
+
+// Header at the beginning of a binary log file.
+typedef struct RecordFileHeader {
+	uint32_t magic;
+	uint16_t version;
+	uint16_t headerSize;
+	// Size of a single record in bytes.
+	uint32_t recordSize;
+	uint32_t timeResolution;
+	// Interrupt time the first delta is relative to.
+	uint64_t startTime;
+	// System time (100 ns units since 1601-01-01 UTC) at the start time.
+	uint64_t startSystemTime;
+}RecordFileHeader;
+
+// Flag of KbdRecord for a compacted keystroke (LOG_FLAG_COMPACT): a make paired with its break and logged at the time of the break.
+// Set by the driver in the flags of KEYBOARD_INPUT_DATA, which do not use the bit.
+#define RECORD_KBD_PAIRED 0x8000
+
+// Raw KEYBOARD_INPUT_DATA. The repeat count and hold time are only set for compacted input.
+typedef struct KbdRecord {
+	uint16_t unitId;
+	uint16_t makeCode;
+	uint16_t flags;
+	uint16_t repeatCount;
+	uint32_t extraInformation;
+	// Milliseconds.
+	uint32_t holdTime;
+}KbdRecord;
+
+// Raw MOUSE_INPUT_DATA.
+typedef struct MouRecord {
+	uint16_t unitId;
+	uint16_t flags;
+	uint16_t buttonFlags;
+	uint16_t buttonData;
+	int32_t lastX;
+	int32_t lastY;
+}MouRecord;
+
+typedef struct TimeRecord {
+	uint64_t time;
+	uint64_t reserved;
+}TimeRecord;
+
+// Fixed size record following the file header.
+typedef struct InputRecord {
+	// Ticks since the previous record or the start time.
+	uint32_t timeDelta;
+	uint8_t type;
+	uint8_t reserved;
+	uint16_t source;
+	union {
+		KbdRecord kbd;
+		MouRecord mou;
+		TimeRecord time;
+	};
+	// Number of the input among the logged input of the source, counted from zero at the start of logging.
+	// Gaps are input that was lost on the way to the file. Zero for time records.
+	uint64_t sequence;
+}InputRecord;
\ No newline at end of file
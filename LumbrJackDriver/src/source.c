@@ -0,0 +1,143 @@
+#include "source.h"
+#include "debug.h"
+
+typedef struct Source {
+	BOOLEAN isUsed;
+	volatile BOOLEAN isEnabled;
+	USHORT type;
+	WCHAR name[SOURCE_NAME_LENGTH];
+	volatile LONG64 sequence;
+}Source;
+
+static Source sources[MAX_SOURCES];
+static PlatformLock sourceLock;
+
+void initSources() {
+	RtlZeroMemory(sources, sizeof(sources));
+	platformInitLock(&sourceLock);
+
+	return;
+}
+
+
+NTSTATUS addSource(const WCHAR* name, USHORT type, USHORT* pSourceId) {
+	const KIRQL oldIrql = platformAcquireLock(&sourceLock);
+
+	USHORT id = 0;
+
+	while (id < MAX_SOURCES && sources[id].isUsed) {
+		id++;
+	}
+
+	if (id == MAX_SOURCES) {
+		platformReleaseLock(&sourceLock, oldIrql);
+
+		return STATUS_INSUFFICIENT_RESOURCES;
+	}
+
+	sources[id].type = type;
+	RtlCopyMemory(sources[id].name, name, sizeof(sources[id].name));
+	sources[id].isEnabled = TRUE;
+	sources[id].isUsed = TRUE;
+	// the sequence of a reused ID keeps running, so records of the new device do not look like a restart or reordered input of the removed one
+
+	platformReleaseLock(&sourceLock, oldIrql);
+
+	*pSourceId = id;
+	DBG_PRINTF2("addSource: Added source %hu: %ls\n", id, name);
+
+	return STATUS_SUCCESS;
+}
+
+
+void removeSource(USHORT sourceId) {
+
+	if (sourceId >= MAX_SOURCES) return;
+
+	const KIRQL oldIrql = platformAcquireLock(&sourceLock);
+
+	sources[sourceId].isEnabled = FALSE;
+	sources[sourceId].isUsed = FALSE;
+
+	platformReleaseLock(&sourceLock, oldIrql);
+
+	return;
+}
+
+
+BOOLEAN isSourceEnabled(USHORT sourceId) {
+
+	// unused sources are never enabled, so the lock is not needed
+	return sourceId < MAX_SOURCES && sources[sourceId].isEnabled;
+}
+
+
+NTSTATUS enableSource(const SourceSelection* pSourceSelection) {
+
+	if (pSourceSelection->id >= MAX_SOURCES) return STATUS_NOT_FOUND;
+
+	NTSTATUS ntStatus = STATUS_SUCCESS;
+	const KIRQL oldIrql = platformAcquireLock(&sourceLock);
+
+	if (sources[pSourceSelection->id].isUsed) {
+		sources[pSourceSelection->id].isEnabled = pSourceSelection->isEnabled ? TRUE : FALSE;
+	}
+	else {
+		ntStatus = STATUS_NOT_FOUND;
+	}
+
+	platformReleaseLock(&sourceLock, oldIrql);
+
+	return ntStatus;
+}
+
+
+void getSources(SourceList* pSourceList) {
+	RtlZeroMemory(pSourceList, sizeof(SourceList));
+
+	const KIRQL oldIrql = platformAcquireLock(&sourceLock);
+
+	for (USHORT id = 0; id < MAX_SOURCES; id++) {
+
+		if (!sources[id].isUsed) continue;
+
+		SourceInfo* const pSourceInfo = &pSourceList->sources[pSourceList->count];
+		pSourceInfo->id = id;
+		pSourceInfo->type = sources[id].type;
+		pSourceInfo->isEnabled = sources[id].isEnabled;
+		RtlCopyMemory(pSourceInfo->name, sources[id].name, sizeof(pSourceInfo->name));
+		pSourceList->count++;
+	}
+
+	platformReleaseLock(&sourceLock, oldIrql);
+
+	return;
+}
+
+
+void resetSequences() {
+
+	for (USHORT id = 0; id < MAX_SOURCES; id++) {
+		InterlockedExchange64(&sources[id].sequence, 0);
+	}
+
+	return;
+}
+
+
+ULONGLONG takeSequence(USHORT sourceId) {
+
+	if (sourceId >= MAX_SOURCES) return 0;
+
+	return (ULONGLONG)InterlockedIncrement64(&sources[sourceId].sequence) - 1;
+}
+
+
+void skipSequences(USHORT sourceId, ULONG count) {
+
+	if (sourceId >= MAX_SOURCES || !count) return;
+
+	InterlockedExchangeAdd64(&sources[sourceId].sequence, count);
+
+	return;
+}
\ No newline at end of file
@@ -0,0 +1,96 @@
+#pragma once
+#include "ioctl.h"
+#include "platform.h"
+
+// Table of the input devices the filter devices are attached to.
+// Every filter device gets a source ID, which is the index of its entry in the table.
+// The table is protected by a spin lock. Only the enabled state is read without the lock by the completion routines.
+// Every source numbers its logged input, so input that is lost on the way to the log file leaves a gap in the sequence numbers.
+// Sequence numbers are atomic, since a source can be completed concurrently by a read and a skipped read.
+// They only start over at zero when logging is started. A device that gets the ID of a removed one continues its sequence.
+
+// Initializes the source table. Has to be called before any other function.
+void initSources();
+
+// Adds an input device to the source table. New sources are enabled.
+// Can be called at IRQL <= DISPATCH_LEVEL.
+//
+// Parameters:
+//
+// [in] name:
+// Name of the input device of SOURCE_NAME_LENGTH characters including the terminating null.
+//
+// [in] type:
+// FILE_DEVICE_KEYBOARD or FILE_DEVICE_MOUSE, FILE_DEVICE_UNKNOWN for injected input.
+//
+// [out] pSourceId:
+// Contains the ID of the new source on return.
+//
+// Return:
+// STATUS_INSUFFICIENT_RESOURCES if the table is full, otherwise STATUS_SUCCESS.
+NTSTATUS addSource(const WCHAR* name, USHORT type, USHORT* pSourceId);
+
+// Removes a source from the source table. The ID can be reused afterwards.
+//
+// Parameters:
+//
+// [in] sourceId:
+// ID of the source to remove.
+void removeSource(USHORT sourceId);
+
+// Checks if input of a source should be captured.
+//
+// Parameters:
+//
+// [in] sourceId:
+// ID of the source.
+//
+// Return:
+// TRUE if the source exists and is enabled, otherwise FALSE.
+BOOLEAN isSourceEnabled(USHORT sourceId);
+
+// Enables or disables capture of a source.
+//
+// Parameters:
+//
+// [in] pSourceSelection:
+// Address of the ID and the new state of the source.
+//
+// Return:
+// STATUS_NOT_FOUND if the source does not exist, otherwise STATUS_SUCCESS.
+NTSTATUS enableSource(const SourceSelection* pSourceSelection);
+
+// Copies the source table.
+//
+// Parameters:
+//
+// [out] pSourceList:
+// Contains all current sources on return.
+void getSources(SourceList* pSourceList);
+
+// Resets the sequence numbers of all sources to zero. Should be called before logging is started.
+void resetSequences();
+
+// Takes the next sequence number of a source.
+// Can be called at IRQL <= DISPATCH_LEVEL.
+//
+// Parameters:
+//
+// [in] sourceId:
+// ID of the source.
+//
+// Return:
+// The sequence number for the next input of the source.
+ULONGLONG takeSequence(USHORT sourceId);
+
+// Skips sequence numbers of a source for input that is not logged, so it shows up as a gap in the log file.
+// Can be called at IRQL <= DISPATCH_LEVEL.
+//
+// Parameters:
+//
+// [in] sourceId:
+// ID of the source.
+//
+// [in] count:
+// Number of sequence numbers to skip.
+void skipSequences(USHORT sourceId, ULONG count);
\ No newline at end of file
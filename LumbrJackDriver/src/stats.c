@@ -0,0 +1,266 @@
+#include "stats.h"
+#include "debug.h"
+
+// Classes of keys by their position on the keyboard, independent of the layout.
+typedef enum KeyClass {
+	KEY_CLASS_LETTER, KEY_CLASS_DIGIT, KEY_CLASS_WHITESPACE, KEY_CLASS_EDIT, KEY_CLASS_MODIFIER, KEY_CLASS_NAVIGATION, KEY_CLASS_FUNCTION, KEY_CLASS_OTHER, KEY_CLASS_MAX
+}KeyClass;
+
+typedef enum MouseButton {
+	BUTTON_LEFT, BUTTON_RIGHT, BUTTON_MIDDLE, BUTTON_X1, BUTTON_X2, BUTTON_MAX
+}MouseButton;
+
+// Counters are updated with interlocked operations since keyboard and mouse input is completed concurrently.
+typedef struct InputStats {
+	volatile LONG keyPresses[KEY_CLASS_MAX];
+	volatile LONG buttonPresses[BUTTON_MAX];
+	volatile LONG wheelRotations;
+	volatile LONG kbdEvents;
+	volatile LONG mouEvents;
+}InputStats;
+
+static InputStats inputStats;
+
+static KeyClass getKeyClass(const KEYBOARD_INPUT_DATA* pKbdInputData);
+
+#ifndef LMB_USER_MODE
+PKTHREAD pStatsThread;
+
+static KEVENT stopEvent;
+static ULONG statsInterval;
+static UNICODE_STRING statsLogFileName = RTL_CONSTANT_STRING(L"\\DosDevices\\C:\\stats.log");
+
+static const char* const keyClassLabels[KEY_CLASS_MAX] = { "L", "D", "S", "E", "M", "N", "F", "O" };
+static const char* const buttonLabels[BUTTON_MAX] = { "L", "R", "M", "X1", "X2" };
+
+static void statsStartRoutine(PVOID pStartContext);
+static NTSTATUS logStatsToFile(HANDLE hFile, ULONG intervalIndex);
+#endif // LMB_USER_MODE
+
+void countKbdInput(const KEYBOARD_INPUT_DATA* pKbdInputData) {
+	InterlockedIncrement(&inputStats.kbdEvents);
+
+	if (pKbdInputData->Flags & KEY_BREAK) return;
+
+	InterlockedIncrement(&inputStats.keyPresses[getKeyClass(pKbdInputData)]);
+
+	return;
+}
+
+
+void countMouInput(const MOUSE_INPUT_DATA* pMouInputData) {
+	InterlockedIncrement(&inputStats.mouEvents);
+
+	static const USHORT buttonDownFlags[BUTTON_MAX] = { MOUSE_LEFT_BUTTON_DOWN, MOUSE_RIGHT_BUTTON_DOWN, MOUSE_MIDDLE_BUTTON_DOWN, MOUSE_BUTTON_4_DOWN, MOUSE_BUTTON_5_DOWN };
+
+	for (int i = 0; i < BUTTON_MAX; i++) {
+
+		if (pMouInputData->ButtonFlags & buttonDownFlags[i]) {
+			InterlockedIncrement(&inputStats.buttonPresses[i]);
+		}
+
+	}
+
+	if (pMouInputData->ButtonFlags & (MOUSE_WHEEL | MOUSE_HWHEEL)) {
+		InterlockedIncrement(&inputStats.wheelRotations);
+	}
+
+	return;
+}
+
+
+static KeyClass getKeyClass(const KEYBOARD_INPUT_DATA* pKbdInputData) {
+	const USHORT makeCode = pKbdInputData->MakeCode;
+
+	if (pKbdInputData->Flags & KEY_E0) {
+
+		// right ctrl, right alt and windows keys
+		if (makeCode == 0x1D || makeCode == 0x38 || makeCode == 0x5B || makeCode == 0x5C) return KEY_CLASS_MODIFIER;
+		// delete
+		if (makeCode == 0x53) return KEY_CLASS_EDIT;
+		// home, arrows, page up/down, end and insert
+		if (makeCode >= 0x47 && makeCode <= 0x52) return KEY_CLASS_NAVIGATION;
+		// keypad enter
+		if (makeCode == 0x1C) return KEY_CLASS_WHITESPACE;
+
+		return KEY_CLASS_OTHER;
+	}
+
+	if (makeCode >= 0x02 && makeCode <= 0x0B) return KEY_CLASS_DIGIT;
+	if ((makeCode >= 0x10 && makeCode <= 0x19) || (makeCode >= 0x1E && makeCode <= 0x26) || (makeCode >= 0x2C && makeCode <= 0x32)) return KEY_CLASS_LETTER;
+	// tab, enter and space
+	if (makeCode == 0x0F || makeCode == 0x1C || makeCode == 0x39) return KEY_CLASS_WHITESPACE;
+	// backspace
+	if (makeCode == 0x0E) return KEY_CLASS_EDIT;
+	// ctrl, shifts, alt and caps lock
+	if (makeCode == 0x1D || makeCode == 0x2A || makeCode == 0x36 || makeCode == 0x38 || makeCode == 0x3A) return KEY_CLASS_MODIFIER;
+	// F1 to F10, F11 and F12
+	if ((makeCode >= 0x3B && makeCode <= 0x44) || makeCode == 0x57 || makeCode == 0x58) return KEY_CLASS_FUNCTION;
+
+	return KEY_CLASS_OTHER;
+}
+
+
+#ifndef LMB_USER_MODE
+
+NTSTATUS startStatsThread(PDRIVER_OBJECT pDriverObject, ULONG interval) {
+
+	if (pStatsThread) {
+		DBG_PRINT("startStatsThread: Thread still referenced\n");
+
+		return STATUS_THREAD_ALREADY_IN_SESSION;
+	}
+
+	RtlZeroMemory((PVOID)&inputStats, sizeof(inputStats));
+	KeInitializeEvent(&stopEvent, NotificationEvent, FALSE);
+	statsInterval = interval;
+
+	HANDLE hStatsThread = NULL;
+	OBJECT_ATTRIBUTES threadAttributes = { 0 };
+	InitializeObjectAttributes(&threadAttributes, NULL, 0, NULL, NULL);
+	NTSTATUS ntStatus = IoCreateSystemThread(pDriverObject, &hStatsThread, DELETE | SYNCHRONIZE, &threadAttributes, NULL, NULL, statsStartRoutine, NULL);
+
+	if (!NT_SUCCESS(ntStatus)) {
+		DBG_PRINTF("startStatsThread: IoCreateSystemThread failed: 0x%lx\n", ntStatus);
+
+		return ntStatus;
+	}
+
+	ntStatus = ObReferenceObjectByHandle(hStatsThread, SYNCHRONIZE, NULL, KernelMode, &pStatsThread, NULL);
+
+	if (!NT_SUCCESS(ntStatus)) {
+		DBG_PRINTF("startStatsThread: ObReferenceObjectByHandle failed: 0x%lx\n", ntStatus);
+	}
+
+	ntStatus = ZwClose(hStatsThread);
+
+	if (!NT_SUCCESS(ntStatus)) {
+		DBG_PRINTF("startStatsThread: ZwClose failed: 0x%lx\n", ntStatus);
+	}
+
+	return ntStatus;
+}
+
+
+NTSTATUS stopStatsThread() {
+
+	if (!pStatsThread) {
+		DBG_PRINT("stopStatsThread: Thread not referenced\n");
+
+		return STATUS_THREAD_NOT_IN_SESSION;
+	}
+
+	KeSetEvent(&stopEvent, 0, FALSE);
+	const NTSTATUS ntStatus = KeWaitForSingleObject(pStatsThread, Executive, KernelMode, FALSE, NULL);
+
+	if (!NT_SUCCESS(ntStatus)) {
+		DBG_PRINTF("stopStatsThread: KeWaitForSingleObject failed: 0x%lx\n", ntStatus);
+	}
+
+	ObfDereferenceObject(pStatsThread);
+	pStatsThread = NULL;
+
+	return ntStatus;
+}
+
+
+static void statsStartRoutine(PVOID pStartContext) {
+	UNREFERENCED_PARAMETER(pStartContext);
+
+	HANDLE hStatsFile = NULL;
+	OBJECT_ATTRIBUTES fileAttributes;
+	InitializeObjectAttributes(&fileAttributes, &statsLogFileName, OBJ_CASE_INSENSITIVE | OBJ_KERNEL_HANDLE, NULL, NULL);
+	IO_STATUS_BLOCK ioStatusBlock = { 0 };
+	NTSTATUS ntStatus = ZwCreateFile(&hStatsFile, FILE_WRITE_DATA, &fileAttributes, &ioStatusBlock, NULL, FILE_ATTRIBUTE_NORMAL, 0, FILE_OVERWRITE_IF, FILE_SYNCHRONOUS_IO_NONALERT, NULL, 0);
+
+	if (!NT_SUCCESS(ntStatus)) {
+		DBG_PRINTF("statsStartRoutine: ZwCreateFile failed: 0x%lx\n", ntStatus);
+
+		return;
+	}
+
+	// the summaries are due at multiples of the interval after the start, in 100 ns units of the interrupt time,
+	// so the time taken to log a summary does not delay the following ones
+	const ULONGLONG startTime = platformQueryTime();
+	const ULONGLONG intervalTime = (ULONGLONG)statsInterval * 10000;
+	ULONG intervalIndex = 0;
+	BOOLEAN isStopping = FALSE;
+
+	// log a summary after every interval and a final one for the input since the last summary
+	while (!isStopping) {
+		const ULONGLONG dueTime = startTime + (intervalIndex + 1) * intervalTime;
+		const ULONGLONG currentTime = platformQueryTime();
+		// relative timeout, zero if the summary is already due
+		LARGE_INTEGER timeout = { .QuadPart = currentTime < dueTime ? -(LONGLONG)(dueTime - currentTime) : 0 };
+		ntStatus = KeWaitForSingleObject(&stopEvent, Executive, KernelMode, FALSE, &timeout);
+
+		if (!NT_SUCCESS(ntStatus)) {
+			DBG_PRINTF("statsStartRoutine: KeWaitForSingleObject failed: 0x%lx\n", ntStatus);
+		}
+
+		isStopping = ntStatus != STATUS_TIMEOUT;
+		ntStatus = logStatsToFile(hStatsFile, intervalIndex);
+
+		if (!NT_SUCCESS(ntStatus)) {
+			DBG_PRINTF("statsStartRoutine: logStatsToFile failed: 0x%lx\n", ntStatus);
+		}
+
+		intervalIndex++;
+	}
+
+	ntStatus = ZwClose(hStatsFile);
+
+	if (!NT_SUCCESS(ntStatus)) {
+		DBG_PRINTF("statsStartRoutine: ZwClose failed: 0x%lx\n", ntStatus);
+	}
+
+	return;
+}
+
+
+// Takes the current counters and writes them as a single line to the file.
+// Format: "T:<index>KEYS:L=1,D=2,...CLICKS:L=1,R=0,...WHEEL:0EVENTS:K=3,M=42"
+static NTSTATUS logStatsToFile(HANDLE hFile, ULONG intervalIndex) {
+	char buffer[0x200] = { 0 };
+	char* pEnd = buffer;
+	size_t remaining = sizeof(buffer);
+
+	NTSTATUS ntStatus = RtlStringCbPrintfExA(pEnd, remaining, &pEnd, &remaining, 0, "%s%lu%s", "T:", intervalIndex, "KEYS:");
+
+	for (int i = 0; i < KEY_CLASS_MAX && NT_SUCCESS(ntStatus); i++) {
+		const LONG count = InterlockedExchange(&inputStats.keyPresses[i], 0);
+		ntStatus = RtlStringCbPrintfExA(pEnd, remaining, &pEnd, &remaining, 0, "%s%s%s%ld", i ? "," : "", keyClassLabels[i], "=", count);
+	}
+
+	if (NT_SUCCESS(ntStatus)) {
+		ntStatus = RtlStringCbPrintfExA(pEnd, remaining, &pEnd, &remaining, 0, "%s", "CLICKS:");
+	}
+
+	for (int i = 0; i < BUTTON_MAX && NT_SUCCESS(ntStatus); i++) {
+		const LONG count = InterlockedExchange(&inputStats.buttonPresses[i], 0);
+		ntStatus = RtlStringCbPrintfExA(pEnd, remaining, &pEnd, &remaining, 0, "%s%s%s%ld", i ? "," : "", buttonLabels[i], "=", count);
+	}
+
+	if (NT_SUCCESS(ntStatus)) {
+		const LONG wheelRotations = InterlockedExchange(&inputStats.wheelRotations, 0);
+		const LONG kbdEvents = InterlockedExchange(&inputStats.kbdEvents, 0);
+		const LONG mouEvents = InterlockedExchange(&inputStats.mouEvents, 0);
+		ntStatus = RtlStringCbPrintfExA(pEnd, remaining, &pEnd, &remaining, 0, "%s%ld%s%ld%s%ld%c", "WHEEL:", wheelRotations, "EVENTS:K=", kbdEvents, ",M=", mouEvents, '\n');
+	}
+
+	if (!NT_SUCCESS(ntStatus)) {
+		DBG_PRINTF("logStatsToFile: RtlStringCbPrintfExA failed: 0x%lx\n", ntStatus);
+
+		return ntStatus;
+	}
+
+	ntStatus = platformWriteFile(hFile, buffer, (ULONG)(pEnd - buffer));
+
+	if (!NT_SUCCESS(ntStatus)) {
+		DBG_PRINTF("logStatsToFile: platformWriteFile failed: 0x%lx\n", ntStatus);
+	}
+
+	return ntStatus;
+}
+
+#endif // LMB_USER_MODE
\ No newline at end of file
@@ -0,0 +1,48 @@
+#pragma once
+#include "platform.h"
+
+// Aggregated logging of input statistics instead of single input events.
+// The completion routines count input and a statistics thread logs one summary per interval.
+// Only the counters are part of the user mode build of the driver core. The thread is declared for the device stack simulator, which provides a stand-in.
+
+// Counts a keyboard input by the class of the key. Only key presses are counted.
+// Can be called at IRQL <= DISPATCH_LEVEL.
+//
+// Parameters:
+//
+// [in] pKbdInputData:
+// Address of the KEYBOARD_INPUT_DATA stucture to count.
+void countKbdInput(const KEYBOARD_INPUT_DATA* pKbdInputData);
+
+// Counts a mouse input by its button presses and wheel rotations.
+// Can be called at IRQL <= DISPATCH_LEVEL.
+//
+// Parameters:
+//
+// [in] pMouInputData:
+// Address of the MOUSE_INPUT_DATA stucture to count.
+void countMouInput(const MOUSE_INPUT_DATA* pMouInputData);
+
+// Statistics thread object.
+extern PKTHREAD pStatsThread;
+
+// Starts the statistics thread that logs a summary of the counted input per interval.
+// The driver will not unload before this thread has not finished.
+//
+// Parameters:
+//
+// [in] pDriverObject:
+// Address of the driver object of the current driver.
+//
+// [in] interval:
+// Interval of the summaries in milliseconds.
+//
+// Return:
+// An appropriate NTSTATUS value.
+NTSTATUS startStatsThread(PDRIVER_OBJECT pDriverObject, ULONG interval);
+
+// Stops the statistics thread. The input counted since the last summary is logged before the thread finishes.
+//
+// Return:
+// An appropriate NTSTATUS value.
+NTSTATUS stopStatsThread();
\ No newline at end of file
@@ -0,0 +1,122 @@
+#include "trace.h"
+#include "debug.h"
+
+#define TRACE_INDEX_MASK (TRACE_RECORDS_PER_CPU - 1)
+
+typedef struct TraceBuffer {
+	volatile LONG head;
+	TraceRecord records[TRACE_RECORDS_PER_CPU];
+}TraceBuffer;
+
+volatile LONG traceMasks[TRACE_LEVEL_MAX];
+
+static TraceBuffer* pTraceBuffers;
+static ULONG traceBufferCount;
+
+NTSTATUS initTrace() {
+	traceBufferCount = platformGetProcessorCount();
+	pTraceBuffers = (TraceBuffer*)platformAllocate(sizeof(TraceBuffer) * traceBufferCount, TRACE_BUFFER_DATA_TAG);
+
+	if (!pTraceBuffers) {
+		traceBufferCount = 0;
+
+		return STATUS_INSUFFICIENT_RESOURCES;
+	}
+
+	const TraceConfig traceConfig = { TRACE_ERROR, TRACE_CAT_ALL };
+
+	return setTraceConfig(&traceConfig);
+}
+
+
+void freeTrace() {
+
+	for (int i = 0; i < TRACE_LEVEL_MAX; i++) {
+		traceMasks[i] = 0;
+	}
+
+	if (pTraceBuffers) {
+		platformFree(pTraceBuffers, TRACE_BUFFER_DATA_TAG);
+		pTraceBuffers = NULL;
+	}
+
+	traceBufferCount = 0;
+
+	return;
+}
+
+
+NTSTATUS setTraceConfig(const TraceConfig* pTraceConfig) {
+	
+	if (pTraceConfig->level >= TRACE_LEVEL_MAX) return STATUS_INVALID_PARAMETER;
+
+	// the buffers are checked here, so writeTrace does not need to
+	const LONG categories = pTraceBuffers ? (LONG)(pTraceConfig->categories & TRACE_CAT_ALL) : 0;
+
+	for (ULONG i = 0; i < TRACE_LEVEL_MAX; i++) {
+		InterlockedExchange(&traceMasks[i], i && i <= pTraceConfig->level ? categories : 0);
+	}
+
+	return STATUS_SUCCESS;
+}
+
+
+void writeTrace(USHORT point, UCHAR level, ULONG a0, ULONG a1, ULONG a2, ULONG a3) {
+	const ULONG cpu = platformGetCurrentProcessor();
+
+	// processors added after the buffers were allocated are not traced
+	if (cpu >= traceBufferCount) return;
+
+	TraceBuffer* const pTraceBuffer = &pTraceBuffers[cpu];
+	// the head is incremented atomically, since the thread can be preempted by a trace point on the same processor
+	const LONG sequence = InterlockedIncrement(&pTraceBuffer->head);
+	volatile TraceRecord* const pTraceRecord = &pTraceBuffer->records[(ULONG)(sequence - 1) & TRACE_INDEX_MASK];
+
+	// the sequence is cleared before and written after the payload, so readers can detect records that are being written.
+	// Both exchanges are full barriers, so the payload stores can neither move before the clearing nor after the new sequence.
+	InterlockedExchange((volatile LONG*)&pTraceRecord->sequence, 0);
+	pTraceRecord->time = platformQueryTime();
+	pTraceRecord->point = point;
+	pTraceRecord->level = level;
+	pTraceRecord->cpu = (UCHAR)cpu;
+	pTraceRecord->args[0] = a0;
+	pTraceRecord->args[1] = a1;
+	pTraceRecord->args[2] = a2;
+	pTraceRecord->args[3] = a3;
+	InterlockedExchange((volatile LONG*)&pTraceRecord->sequence, sequence);
+
+	return;
+}
+
+
+ULONG readTrace(TraceSnapshot* pTraceSnapshot, ULONG size) {
+	
+	if (size < FIELD_OFFSET(TraceSnapshot, records)) return 0;
+
+	const ULONG maxCount = (size - FIELD_OFFSET(TraceSnapshot, records)) / sizeof(TraceRecord);
+	pTraceSnapshot->count = 0;
+
+	for (ULONG cpu = 0; cpu < traceBufferCount; cpu++) {
+
+		for (ULONG i = 0; i < TRACE_RECORDS_PER_CPU && pTraceSnapshot->count < maxCount; i++) {
+			const volatile TraceRecord* const pTraceRecord = &pTraceBuffers[cpu].records[i];
+			const ULONG sequence = pTraceRecord->sequence;
+
+			if (!sequence) continue;
+
+			// the barriers keep the copy between the two reads of the sequence, so a record that matches both was not written meanwhile
+			platformMemoryBarrier();
+			TraceRecord* const pCopy = &pTraceSnapshot->records[pTraceSnapshot->count];
+			RtlCopyMemory(pCopy, (const void*)pTraceRecord, sizeof(TraceRecord));
+			platformMemoryBarrier();
+
+			// skip records that were overwritten while copying
+			if (pCopy->sequence != sequence || pTraceRecord->sequence != sequence) continue;
+
+			pTraceSnapshot->count++;
+		}
+
+	}
+
+	return FIELD_OFFSET(TraceSnapshot, records) + pTraceSnapshot->count * sizeof(TraceRecord);
+}
\ No newline at end of file
@@ -0,0 +1,78 @@
+#pragma once
+#include "ioctl.h"
+#include "platform.h"
+
+// Binary tracing into per-processor ring buffers.
+// A trace point compiles to nothing if its level is above TRACE_COMPILED_LEVEL.
+// Otherwise it costs a single branch while its level and category are disabled at runtime.
+// Enabled trace points store a fixed-size record into the ring buffer of the current processor.
+// The buffers are read with IOCTL_READ_TRACE and decoded by the client.
+
+// Highest level that is compiled into the driver.
+#ifndef TRACE_COMPILED_LEVEL
+#ifdef DBG
+#define TRACE_COMPILED_LEVEL TRACE_VERBOSE
+#else
+#define TRACE_COMPILED_LEVEL TRACE_INFO
+#endif // DBG
+#endif // TRACE_COMPILED_LEVEL
+
+// Enabled categories per level. Set by setTraceConfig.
+extern volatile LONG traceMasks[TRACE_LEVEL_MAX];
+
+// Writes a trace record if the level is compiled in and enabled for the category.
+#define TRACE(level, category, point, a0, a1, a2, a3) \
+	do { \
+		if ((level) <= TRACE_COMPILED_LEVEL && traceMasks[level] & (category)) { \
+			writeTrace((point), (level), (ULONG)(a0), (ULONG)(a1), (ULONG)(a2), (ULONG)(a3)); \
+		} \
+	} while (0)
+
+// Allocates the ring buffers for all active processors. Errors are traced for all categories afterwards.
+// Tracing stays disabled if the allocation fails.
+//
+// Return:
+// An appropriate NTSTATUS value.
+NTSTATUS initTrace();
+
+// Disables tracing and frees the ring buffers. No trace point may be executing.
+void freeTrace();
+
+// Sets the traced level and categories.
+//
+// Parameters:
+//
+// [in] pTraceConfig:
+// Address of the trace configuration.
+//
+// Return:
+// STATUS_INVALID_PARAMETER for an invalid level, otherwise STATUS_SUCCESS.
+NTSTATUS setTraceConfig(const TraceConfig* pTraceConfig);
+
+// Writes a trace record to the ring buffer of the current processor. Use the TRACE macro instead.
+//
+// Parameters:
+//
+// [in] point:
+// Trace point of the record.
+//
+// [in] level:
+// Level of the trace point.
+//
+// [in] a0, a1, a2, a3:
+// Arguments of the trace point.
+void writeTrace(USHORT point, UCHAR level, ULONG a0, ULONG a1, ULONG a2, ULONG a3);
+
+// Copies the valid records of all ring buffers. Records that are overwritten while copying are skipped.
+//
+// Parameters:
+//
+// [out] pTraceSnapshot:
+// Address of the buffer receiving the records.
+//
+// [in] size:
+// Size of the buffer in bytes.
+//
+// Return:
+// Number of bytes written to the buffer.
+ULONG readTrace(TraceSnapshot* pTraceSnapshot, ULONG size);
\ No newline at end of file
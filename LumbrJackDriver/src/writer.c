@@ -0,0 +1,309 @@
+#include "writer.h"
+#include "debug.h"
+#include "lz.h"
+
+static NTSTATUS initCipher(LogWriter* pWriter, const UCHAR* key);
+static NTSTATUS writeToFile(HANDLE hFile, const void* data, ULONG size);
+static NTSTATUS flushBlock(LogWriter* pWriter, BOOLEAN isFinal);
+static void freeLogWriter(LogWriter* pWriter);
+static NTSTATUS sealBlock(LogWriter* pWriter, const LzBlockHeader* pHeader, const UCHAR* data);
+
+NTSTATUS initLogWriter(LogWriter* pWriter, HANDLE hFile, BOOLEAN isCompressed, const UCHAR* key) {
+	RtlZeroMemory(pWriter, sizeof(LogWriter));
+	pWriter->hFile = hFile;
+
+	if (!isCompressed && !key) {
+
+		return STATUS_SUCCESS;
+	}
+
+	// the buffers are only used by the logging thread at passive level
+	pWriter->buffer = (PUCHAR)ExAllocatePool2(POOL_FLAG_PAGED, LZ_BLOCK_SIZE, LOG_BUFFER_DATA_TAG);
+
+	if (!pWriter->buffer) {
+		DBG_PRINT("initLogWriter: ExAllocatePool2 failed\n");
+
+		return STATUS_MEMORY_NOT_ALLOCATED;
+	}
+
+	if (isCompressed) {
+		pWriter->compressed = (PUCHAR)ExAllocatePool2(POOL_FLAG_PAGED, LZ_MAX_COMPRESSED_SIZE(LZ_BLOCK_SIZE), LOG_BUFFER_DATA_TAG);
+		pWriter->hashTable = ExAllocatePool2(POOL_FLAG_PAGED, LZ_HASH_TABLE_SIZE, LOG_BUFFER_DATA_TAG);
+
+		if (!pWriter->compressed || !pWriter->hashTable) {
+			DBG_PRINT("initLogWriter: ExAllocatePool2 failed\n");
+			freeLogWriter(pWriter);
+
+			return STATUS_MEMORY_NOT_ALLOCATED;
+		}
+
+	}
+
+	NTSTATUS ntStatus = STATUS_SUCCESS;
+
+	if (!key) {
+		const ULONG magic = LZ_FILE_MAGIC;
+		ntStatus = writeToFile(hFile, &magic, sizeof(magic));
+	}
+	else {
+		ntStatus = initCipher(pWriter, key);
+
+		if (!NT_SUCCESS(ntStatus)) {
+			DBG_PRINTF("initLogWriter: initCipher failed: 0x%lx\n", ntStatus);
+			freeLogWriter(pWriter);
+
+			return ntStatus;
+		}
+
+		pWriter->cipherHeader.magic = CIPHER_FILE_MAGIC;
+		pWriter->cipherHeader.flags = isCompressed ? CIPHER_FLAG_COMPRESSED : 0;
+		ntStatus = writeToFile(hFile, &pWriter->cipherHeader, sizeof(pWriter->cipherHeader));
+	}
+
+	// a file without its header gets no final block either
+	if (!NT_SUCCESS(ntStatus)) {
+		freeLogWriter(pWriter);
+	}
+
+	return ntStatus;
+}
+
+
+NTSTATUS writeLog(LogWriter* pWriter, const void* data, ULONG size) {
+
+	if (!pWriter->buffer) {
+
+		return writeToFile(pWriter->hFile, data, size);
+	}
+
+	const UCHAR* pData = (const UCHAR*)data;
+
+	while (size) {
+		const ULONG chunkSize = min(size, LZ_BLOCK_SIZE - pWriter->size);
+		RtlCopyMemory(pWriter->buffer + pWriter->size, pData, chunkSize);
+		pWriter->size += chunkSize;
+		pData += chunkSize;
+		size -= chunkSize;
+
+		if (pWriter->size == LZ_BLOCK_SIZE) {
+			const NTSTATUS ntStatus = flushBlock(pWriter, FALSE);
+
+			// the rest of the data is not written after a failed block, so the caller sees the first error
+			if (!NT_SUCCESS(ntStatus)) {
+				DBG_PRINTF("writeLog: flushBlock failed: 0x%lx\n", ntStatus);
+
+				return ntStatus;
+			}
+
+		}
+
+	}
+
+	return STATUS_SUCCESS;
+}
+
+
+NTSTATUS closeLogWriter(LogWriter* pWriter) {
+	NTSTATUS ntStatus = STATUS_SUCCESS;
+
+	if (pWriter->buffer) {
+		ntStatus = flushBlock(pWriter, TRUE);
+	}
+
+	freeLogWriter(pWriter);
+
+	return ntStatus;
+}
+
+
+// Frees the buffers and keys of a writer without writing buffered data.
+static void freeLogWriter(LogWriter* pWriter) {
+
+	if (pWriter->buffer) {
+		// plain input should not linger in freed pool
+		RtlSecureZeroMemory(pWriter->buffer, LZ_BLOCK_SIZE);
+		ExFreePoolWithTag(pWriter->buffer, LOG_BUFFER_DATA_TAG);
+		pWriter->buffer = NULL;
+	}
+
+	if (pWriter->compressed) {
+		RtlSecureZeroMemory(pWriter->compressed, LZ_MAX_COMPRESSED_SIZE(LZ_BLOCK_SIZE));
+		ExFreePoolWithTag(pWriter->compressed, LOG_BUFFER_DATA_TAG);
+		pWriter->compressed = NULL;
+	}
+
+	if (pWriter->hashTable) {
+		ExFreePoolWithTag(pWriter->hashTable, LOG_BUFFER_DATA_TAG);
+		pWriter->hashTable = NULL;
+	}
+
+	if (pWriter->sealed) {
+		ExFreePoolWithTag(pWriter->sealed, LOG_BUFFER_DATA_TAG);
+		pWriter->sealed = NULL;
+	}
+
+	if (pWriter->hKey) {
+		BCryptDestroyKey(pWriter->hKey);
+		pWriter->hKey = NULL;
+	}
+
+	if (pWriter->hAlgorithm) {
+		BCryptCloseAlgorithmProvider(pWriter->hAlgorithm, 0);
+		pWriter->hAlgorithm = NULL;
+	}
+
+	return;
+}
+
+
+// Opens AES in GCM mode, imports the key and draws a random nonce prefix.
+static NTSTATUS initCipher(LogWriter* pWriter, const UCHAR* key) {
+	pWriter->sealed = (PUCHAR)ExAllocatePool2(POOL_FLAG_PAGED, LZ_MAX_COMPRESSED_SIZE(LZ_BLOCK_SIZE) + CIPHER_TAG_SIZE, LOG_BUFFER_DATA_TAG);
+
+	if (!pWriter->sealed) {
+		DBG_PRINT("initCipher: ExAllocatePool2 failed\n");
+
+		return STATUS_MEMORY_NOT_ALLOCATED;
+	}
+
+	NTSTATUS ntStatus = BCryptOpenAlgorithmProvider(&pWriter->hAlgorithm, BCRYPT_AES_ALGORITHM, NULL, 0);
+
+	if (!NT_SUCCESS(ntStatus)) {
+		DBG_PRINTF("initCipher: BCryptOpenAlgorithmProvider failed: 0x%lx\n", ntStatus);
+
+		return ntStatus;
+	}
+
+	ntStatus = BCryptSetProperty(pWriter->hAlgorithm, BCRYPT_CHAINING_MODE, (PUCHAR)BCRYPT_CHAIN_MODE_GCM, sizeof(BCRYPT_CHAIN_MODE_GCM), 0);
+
+	if (!NT_SUCCESS(ntStatus)) {
+		DBG_PRINTF("initCipher: BCryptSetProperty failed: 0x%lx\n", ntStatus);
+
+		return ntStatus;
+	}
+
+	ntStatus = BCryptGenerateSymmetricKey(pWriter->hAlgorithm, &pWriter->hKey, NULL, 0, (PUCHAR)key, CIPHER_KEY_SIZE, 0);
+
+	if (!NT_SUCCESS(ntStatus)) {
+		DBG_PRINTF("initCipher: BCryptGenerateSymmetricKey failed: 0x%lx\n", ntStatus);
+
+		return ntStatus;
+	}
+
+	ntStatus = BCryptGenRandom(NULL, (PUCHAR)&pWriter->cipherHeader.noncePrefix, sizeof(pWriter->cipherHeader.noncePrefix), BCRYPT_USE_SYSTEM_PREFERRED_RNG);
+
+	if (!NT_SUCCESS(ntStatus)) {
+		DBG_PRINTF("initCipher: BCryptGenRandom failed: 0x%lx\n", ntStatus);
+	}
+
+	return ntStatus;
+}
+
+
+static NTSTATUS writeToFile(HANDLE hFile, const void* data, ULONG size) {
+
+	if (!size) {
+
+		return STATUS_SUCCESS;
+	}
+
+	const NTSTATUS ntStatus = platformWriteFile(hFile, data, size);
+
+	if (!NT_SUCCESS(ntStatus)) {
+		DBG_PRINTF("writeToFile: platformWriteFile failed: 0x%lx\n", ntStatus);
+	}
+
+	return ntStatus;
+}
+
+
+// Compresses and encrypts the buffered data and writes it with its block header.
+// Blocks that do not shrink are stored uncompressed. The final block is written even if it is empty.
+//
+// Parameters:
+//
+// [in/out] pWriter:
+// Initialized writer.
+//
+// [in] isFinal:
+// Marks the block as the last one of the file with LZ_BLOCK_FINAL.
+//
+// Return:
+// STATUS_SUCCESS on success, error code on failure.
+static NTSTATUS flushBlock(LogWriter* pWriter, BOOLEAN isFinal) {
+	const ULONG size = pWriter->size;
+
+	if (!size && !isFinal) {
+
+		return STATUS_SUCCESS;
+	}
+
+	LzBlockHeader header = { 0 };
+	header.uncompressedSize = isFinal ? size | LZ_BLOCK_FINAL : size;
+	header.compressedSize = size;
+	const UCHAR* block = pWriter->buffer;
+	pWriter->size = 0;
+
+	if (pWriter->compressed && size) {
+		const size_t compressedSize = lzCompress(pWriter->buffer, size, pWriter->compressed, LZ_MAX_COMPRESSED_SIZE(LZ_BLOCK_SIZE), (uint16_t*)pWriter->hashTable);
+
+		if (compressedSize && compressedSize < size) {
+			header.compressedSize = (uint32_t)compressedSize;
+			block = pWriter->compressed;
+		}
+
+	}
+
+	ULONG blockSize = header.compressedSize;
+	NTSTATUS ntStatus = STATUS_SUCCESS;
+
+	if (pWriter->hKey) {
+		ntStatus = sealBlock(pWriter, &header, block);
+
+		if (!NT_SUCCESS(ntStatus)) {
+			DBG_PRINTF("flushBlock: sealBlock failed: 0x%lx\n", ntStatus);
+
+			return ntStatus;
+		}
+
+		block = pWriter->sealed;
+		blockSize += CIPHER_TAG_SIZE;
+	}
+
+	ntStatus = writeToFile(pWriter->hFile, &header, sizeof(header));
+
+	if (!NT_SUCCESS(ntStatus)) {
+
+		return ntStatus;
+	}
+
+	return writeToFile(pWriter->hFile, block, blockSize);
+}
+
+
+// Encrypts a block to the sealed buffer and appends the tag.
+// The file header and the block header are authenticated, including CIPHER_FLAG_COMPRESSED and LZ_BLOCK_FINAL.
+static NTSTATUS sealBlock(LogWriter* pWriter, const LzBlockHeader* pHeader, const UCHAR* data) {
+	UCHAR nonce[CIPHER_NONCE_SIZE] = { 0 };
+	RtlCopyMemory(nonce, &pWriter->cipherHeader.noncePrefix, sizeof(pWriter->cipherHeader.noncePrefix));
+	RtlCopyMemory(nonce + sizeof(pWriter->cipherHeader.noncePrefix), &pWriter->blockIndex, sizeof(pWriter->blockIndex));
+	UCHAR authData[sizeof(CipherFileHeader) + sizeof(LzBlockHeader)] = { 0 };
+	RtlCopyMemory(authData, &pWriter->cipherHeader, sizeof(CipherFileHeader));
+	RtlCopyMemory(authData + sizeof(CipherFileHeader), pHeader, sizeof(LzBlockHeader));
+
+	BCRYPT_AUTHENTICATED_CIPHER_MODE_INFO authInfo;
+	BCRYPT_INIT_AUTH_MODE_INFO(authInfo);
+	authInfo.pbNonce = nonce;
+	authInfo.cbNonce = sizeof(nonce);
+	authInfo.pbAuthData = authData;
+	authInfo.cbAuthData = sizeof(authData);
+	authInfo.pbTag = pWriter->sealed + pHeader->compressedSize;
+	authInfo.cbTag = CIPHER_TAG_SIZE;
+
+	ULONG resultSize = 0;
+	const NTSTATUS ntStatus = BCryptEncrypt(pWriter->hKey, (PUCHAR)data, pHeader->compressedSize, &authInfo, NULL, 0, pWriter->sealed, pHeader->compressedSize, &resultSize, 0);
+	// a nonce is never used twice, even if encryption failed
+	pWriter->blockIndex++;
+
+	return ntStatus;
+}
\ No newline at end of file
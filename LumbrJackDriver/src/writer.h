@@ -0,0 +1,79 @@
+#pragma once
+#include "platform.h"
+#include "cipher.h"
+#include <bcrypt.h>
+
+// Output of a logging thread to a file.
+// Uncompressed output is written through on every call.
+// Compressed or encrypted output is buffered and written in blocks of LZ_BLOCK_SIZE once a block is full.
+// Blocks are compressed (see lz.h) and then encrypted with AES-256-GCM (see cipher.h).
+// Encryption uses CNG, which selects AES-NI and PCLMULQDQ if the processor supports them.
+// A writer is only used by the thread that owns it and is not protected by a lock.
+typedef struct LogWriter {
+	HANDLE hFile;
+	// Only allocated for compressed or encrypted output.
+	PUCHAR buffer;
+	ULONG size;
+	// Only allocated for compressed output.
+	PUCHAR compressed;
+	PVOID hashTable;
+	// Only allocated for encrypted output. Holds the encrypted block followed by its tag.
+	PUCHAR sealed;
+	BCRYPT_ALG_HANDLE hAlgorithm;
+	BCRYPT_KEY_HANDLE hKey;
+	// Header of an encrypted file, authenticated with every block.
+	CipherFileHeader cipherHeader;
+	ULONG blockIndex;
+}LogWriter;
+
+// Initializes a writer and writes the file header for compressed or encrypted output.
+// Has to be called at IRQL PASSIVE_LEVEL.
+//
+// Parameters:
+//
+// [out] pWriter:
+// Writer to initialize.
+//
+// [in] hFile:
+// Handle to the opened file. Stays owned by the caller.
+//
+// [in] isCompressed:
+// Determines if the output is compressed.
+//
+// [in] key:
+// AES-256 key of CIPHER_KEY_SIZE bytes the output is encrypted with. NULL for unencrypted output.
+// The key is only used during the call and can be wiped afterwards.
+//
+// Return:
+// STATUS_SUCCESS on success, error code on failure.
+NTSTATUS initLogWriter(LogWriter* pWriter, HANDLE hFile, BOOLEAN isCompressed, const UCHAR* key);
+
+// Writes data to the file of a writer.
+// Has to be called at IRQL PASSIVE_LEVEL.
+//
+// Parameters:
+//
+// [in/out] pWriter:
+// Initialized writer.
+//
+// [in] data:
+// Data to write.
+//
+// [in] size:
+// Size of the data in bytes.
+//
+// Return:
+// STATUS_SUCCESS on success, error code of the first block that could not be written on failure. The data after that block is dropped.
+NTSTATUS writeLog(LogWriter* pWriter, const void* data, ULONG size);
+
+// Writes buffered data as the final block, marked with LZ_BLOCK_FINAL even if it is empty, and frees the buffers and keys of a writer.
+// Has to be called at IRQL PASSIVE_LEVEL.
+//
+// Parameters:
+//
+// [in/out] pWriter:
+// Initialized writer.
+//
+// Return:
+// STATUS_SUCCESS on success, error code on failure.
+NTSTATUS closeLogWriter(LogWriter* pWriter);
\ No newline at end of file
@@ -0,0 +1,253 @@
+extern "C" {
+#include "../src/format.h"
+#include "test.h"
+}
+#include "analytics.h"
+#include "parser.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <vector>
+
+// Heatmaps and histograms of the analytics of the client (analytics.h) on a fixed binary capture:
+// the vector implementation, split into chunks on several threads, against a scalar reference computed from the parsed events in capture order.
+// Covers clicks on and outside of the bounds, intervals beyond the last bin, times going back and windows without input.
+
+namespace {
+
+    constexpr const char* CAPTURE_PATH = "analytics.bin";
+    constexpr uint64_t START_TIME = 50000000;
+    // Chunks of the parser are at least 1 MiB, so the capture is split into several of them.
+    constexpr size_t RECORD_COUNT = 0x30000;
+
+    // Writes the fixed record set: key presses and releases, clicks of one or two buttons, movement without buttons,
+    // pauses over several windows and records that go back in time.
+    void writeCapture(size_t recordCount) {
+        RecordFileHeader header{};
+        header.magic = RECORD_MAGIC;
+        header.version = RECORD_VERSION;
+        header.headerSize = sizeof(RecordFileHeader);
+        header.recordSize = sizeof(InputRecord);
+        header.timeResolution = RECORD_TIME_RESOLUTION;
+        header.startTime = START_TIME;
+        std::ofstream file(CAPTURE_PATH, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        uint64_t time = START_TIME;
+        uint32_t state = 11;
+
+        for (size_t i = 0; i < recordCount; i++) {
+            state = state * 1664525 + 1013904223;
+            const uint32_t choice = state >> 24;
+            InputRecord record{};
+            record.source = 1;
+            record.sequence = i;
+
+            if (choice < 0x4) {
+                // back in time, the interval is zero
+                InputRecord timeRecord{};
+                timeRecord.type = RECORD_TYPE_TIME;
+                time -= (state >> 8 & 0xFF) * 10000;
+                timeRecord.time.time = time;
+                file.write(reinterpret_cast<const char*>(&timeRecord), sizeof(timeRecord));
+            }
+            else if (choice < 0x8) {
+                // windows without input before the record
+                record.timeDelta = (state >> 8 & 0x3) * RECORD_TIME_RESOLUTION * 2 + 1;
+            }
+            else {
+                record.timeDelta = (state >> 8 & 0x3FFF) * 200;
+            }
+
+            time += record.timeDelta;
+
+            if (choice & 1) {
+                record.type = RECORD_TYPE_KBD;
+                record.kbd.makeCode = static_cast<uint16_t>(0x10 + (choice >> 1) % 0x20);
+                record.kbd.flags = choice & 2 ? KEY_BREAK : KEY_MAKE;
+            }
+            else {
+                record.type = RECORD_TYPE_MOU;
+                record.source = 2;
+                record.mou.flags = MOUSE_MOVE_ABSOLUTE;
+                record.mou.buttonFlags = static_cast<uint16_t>(choice % 6 == 0 ? 0 : choice % 6 == 2 ? MOUSE_LEFT_BUTTON_DOWN | MOUSE_RIGHT_BUTTON_DOWN : MOUSE_LEFT_BUTTON_DOWN);
+                // some positions are on and outside of the bounds of the heatmap
+                const int32_t edges[] = { -1, 0, 0xFFFF, 0x10000, 0x8000 };
+                record.mou.lastX = choice % 7 == 0 ? edges[(state >> 4) % 5] : static_cast<int32_t>(state >> 4 & 0xFFFF);
+                record.mou.lastY = choice % 11 == 0 ? edges[(state >> 12) % 5] : static_cast<int32_t>(state >> 14 & 0xFFFF);
+            }
+
+            file.write(reinterpret_cast<const char*>(&record), sizeof(record));
+        }
+
+        return;
+    }
+
+
+    // Bins intervals of key presses or clicks like the analytics, one value at a time.
+    void addInterval(uint64_t interval, const analytics::Options* pOptions, analytics::Histogram* pHistogram) {
+        const float value = static_cast<float>(interval) * (1000.0f / RECORD_TIME_RESOLUTION);
+        const float maxBin = static_cast<float>(pOptions->binCount - 1);
+        pHistogram->bins[static_cast<int32_t>(std::min(value * static_cast<float>(1.0 / pOptions->binWidth), maxBin))]++;
+        pHistogram->count++;
+
+        return;
+    }
+
+
+    // Intervals and rates of the times of key presses or clicks in capture order.
+    // Consecutive events in the same window are counted together, windows without events are not counted.
+    void addTimes(const std::vector<uint64_t>& times, const analytics::Options* pOptions, analytics::Histogram* pIntervals, analytics::Histogram* pRates) {
+        pIntervals->bins.assign(pOptions->binCount, 0);
+        pRates->bins.assign(pOptions->binCount, 0);
+
+        for (size_t i = 1; i < times.size(); i++) {
+            addInterval(times[i] > times[i - 1] ? times[i] - times[i - 1] : 0, pOptions, pIntervals);
+        }
+
+        for (size_t i = 0; i < times.size();) {
+            size_t end = i + 1;
+
+            while (end < times.size() && times[end] / pOptions->window == times[i] / pOptions->window) {
+                end++;
+            }
+
+            pRates->bins[std::min<size_t>(end - i, pOptions->binCount - 1)]++;
+            pRates->count++;
+            i = end;
+        }
+
+        return;
+    }
+
+
+    // Computes the report from the events of a single threaded parse with the scalar formulas of the analytics.
+    void analyzeScalar(const analytics::Options* pOptions, analytics::Report* pReport) {
+        parser::Result result{};
+        CHECK(parser::parseFile(CAPTURE_PATH, 1, &result));
+        *pReport = analytics::Report{};
+        pReport->heatmap.assign(static_cast<size_t>(pOptions->width) * pOptions->height, 0);
+        const float scaleX = static_cast<float>(static_cast<double>(pOptions->width) / (static_cast<double>(pOptions->maxX) - pOptions->minX + 1.0));
+        const float scaleY = static_cast<float>(static_cast<double>(pOptions->height) / (static_cast<double>(pOptions->maxY) - pOptions->minY + 1.0));
+        std::vector<uint64_t> keyTimes;
+        std::vector<uint64_t> clickTimes;
+
+        for (const parser::Event& event : result.events) {
+
+            if (event.type == parser::KEY && !(event.flags & KEY_BREAK)) {
+                pReport->keys++;
+                keyTimes.push_back(event.time);
+            }
+
+            if (event.type != parser::BUTTON) continue;
+
+            pReport->clicks++;
+            clickTimes.push_back(event.time);
+
+            if (event.x < pOptions->minX || event.x > pOptions->maxX || event.y < pOptions->minY || event.y > pOptions->maxY) {
+                pReport->outside++;
+
+                continue;
+            }
+
+            const int32_t column = static_cast<int32_t>(std::min(static_cast<float>(event.x - pOptions->minX) * scaleX, static_cast<float>(pOptions->width - 1)));
+            const int32_t row = static_cast<int32_t>(std::min(static_cast<float>(event.y - pOptions->minY) * scaleY, static_cast<float>(pOptions->height - 1)));
+            pReport->heatmap[static_cast<size_t>(row) * pOptions->width + static_cast<size_t>(column)]++;
+        }
+
+        addTimes(keyTimes, pOptions, &pReport->keyIntervals, &pReport->keyRates);
+        addTimes(clickTimes, pOptions, &pReport->clickIntervals, &pReport->clickRates);
+
+        return;
+    }
+
+
+    bool isEqual(const analytics::Histogram& histogram, const analytics::Histogram& expected) {
+
+        return histogram.bins == expected.bins && histogram.count == expected.count;
+    }
+
+
+    // Analyzes the capture with several thread counts, so it is split into chunks of different sizes, and compares the results with the reference.
+    void checkReport(const analytics::Options& options) {
+        analytics::Report expected{};
+        analyzeScalar(&options, &expected);
+
+        for (unsigned int threads : { 1u, 2u, 3u, 8u }) {
+            analytics::Options threadOptions = options;
+            threadOptions.threads = threads;
+            analytics::Report report{};
+            CHECK(analytics::analyze(CAPTURE_PATH, &threadOptions, &report));
+            CHECK(report.fmt == parser::BINARY && report.hasTimes && report.invalidCount == 0);
+            CHECK(report.keys == expected.keys && report.clicks == expected.clicks && report.outside == expected.outside);
+            CHECK(report.heatmap == expected.heatmap);
+            CHECK(isEqual(report.keyIntervals, expected.keyIntervals));
+            CHECK(isEqual(report.clickIntervals, expected.clickIntervals));
+            CHECK(isEqual(report.keyRates, expected.keyRates));
+            CHECK(isEqual(report.clickRates, expected.clickRates));
+        }
+
+        return;
+    }
+
+
+    void testDefaultOptions() {
+        writeCapture(RECORD_COUNT);
+        analytics::Options options{};
+        analytics::getDefaultOptions(&options);
+        checkReport(options);
+
+        return;
+    }
+
+
+    // Cells that are not powers of two, bounds that cut through the clicks, intervals beyond the last bin and short windows,
+    // many of which have no input.
+    void testOtherOptions() {
+        writeCapture(RECORD_COUNT);
+        analytics::Options options{};
+        analytics::getDefaultOptions(&options);
+        options.width = 7;
+        options.height = 5;
+        options.minX = -100;
+        options.minY = 0x1000;
+        options.maxX = 0x9000;
+        options.maxY = 0xFFFF;
+        options.binWidth = 0.3;
+        options.binCount = 11;
+        options.window = RECORD_TIME_RESOLUTION / 100;
+        checkReport(options);
+
+        return;
+    }
+
+
+    // A capture without records and captures with fewer records than the vector implementation handles at a time.
+    void testSmallCaptures() {
+        analytics::Options options{};
+        analytics::getDefaultOptions(&options);
+
+        for (size_t recordCount : { 0, 1, 3, 5 }) {
+            writeCapture(recordCount);
+            checkReport(options);
+        }
+
+        writeCapture(0);
+        analytics::Report report{};
+        CHECK(analytics::analyze(CAPTURE_PATH, &options, &report));
+        CHECK(report.keys == 0 && report.clicks == 0 && report.keyRates.count == 0 && report.clickIntervals.count == 0);
+
+        return;
+    }
+
+}
+
+
+int main() {
+    RUN_TEST(testDefaultOptions);
+    RUN_TEST(testOtherOptions);
+    RUN_TEST(testSmallCaptures);
+    std::remove(CAPTURE_PATH);
+
+    return failedChecks ? EXIT_FAILURE : EXIT_SUCCESS;
+}
\ No newline at end of file
@@ -0,0 +1,493 @@
+extern "C" {
+#include "../src/format.h"
+#include "../src/input.h"
+#include "../src/lz.h"
+#include "../src/source.h"
+#include "../src/debug.h"
+}
+#include "decompress.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+// Microbenchmarks of the hot paths of the driver on the user mode build of the driver core:
+// the blocking queue with one to eight producers, the allocation of the queue entries, the input processing of the completion routines,
+// the formatters of the logging threads, per entry versus batched file writes and the block compression of LOG_FLAG_COMPRESS.
+// lumbrjack-bench [--filter=<substring>] [--min-time=<milliseconds>] [--json]
+// Every benchmark is repeated until it ran for the minimum time. Prints ns/op, ops/s and allocations/op per benchmark,
+// as a table or with --json as machine-readable JSON, so changes to a hot path can be compared before and after.
+
+namespace {
+
+    struct Benchmark {
+        const char* name;
+        // Runs the operation of the benchmark a number of times.
+        void (*run)(uint64_t iterations, uint64_t arg);
+        uint64_t arg;
+    };
+
+    struct Result {
+        const char* name;
+        uint64_t iterations;
+        double nsPerOp;
+        double opsPerSecond;
+        double allocationsPerOp;
+    };
+
+    // Size of the blocking queues of the driver.
+    constexpr LONG QUEUE_SIZE = 0x10;
+    // Maximum number of input events per read of the input processing benchmarks.
+    constexpr size_t READ_SIZE = 0x10;
+
+    BlockingQueue queue;
+    volatile BOOLEAN isLogging;
+    USHORT kbdSourceId;
+    USHORT mouSourceId;
+    // Unlinked temporary file of the write benchmarks.
+    int fd = -1;
+    LineSequences lineSequences;
+
+}
+
+static void runQueue(uint64_t iterations, uint64_t producers);
+static void produce(LIST_ENTRY* entries, uint64_t count);
+static void runAllocation(uint64_t iterations, uint64_t arg);
+static void runKbdInput(uint64_t iterations, uint64_t arg);
+static void runMouInput(uint64_t iterations, uint64_t arg);
+static void drainQueue();
+static void runKbdFormat(uint64_t iterations, uint64_t flags);
+static void runMouFormat(uint64_t iterations, uint64_t flags);
+static void runEncode(uint64_t iterations, uint64_t arg);
+static void runWrite(uint64_t iterations, uint64_t batchSize);
+static std::vector<uint8_t> makeLzBlock(bool isRandom);
+static void runLzCompress(uint64_t iterations, uint64_t isRandom);
+static void runLzDecompress(uint64_t iterations, uint64_t arg);
+static Result measure(const Benchmark* pBenchmark, uint64_t minTime);
+static void writeJson(const std::vector<Result>& results, std::ostream& out);
+static void writeTable(const std::vector<Result>& results, std::ostream& out);
+
+static const Benchmark benchmarks[] = {
+    { "queue/producers:1", runQueue, 1 },
+    { "queue/producers:2", runQueue, 2 },
+    { "queue/producers:4", runQueue, 4 },
+    { "queue/producers:8", runQueue, 8 },
+    { "alloc/entry", runAllocation, 0 },
+    { "input/kbd", runKbdInput, 0 },
+    { "input/mou", runMouInput, 0 },
+    { "format/kbd", runKbdFormat, 0 },
+    { "format/kbd_compact", runKbdFormat, LOG_FLAG_COMPACT },
+    { "format/mou", runMouFormat, 0 },
+    { "format/mou_motion", runMouFormat, LOG_FLAG_MOTION },
+    { "format/binary", runEncode, 0 },
+    { "write/per_entry", runWrite, 0 },
+    { "write/batched", runWrite, LZ_BLOCK_SIZE },
+    { "lz/compress_records", runLzCompress, 0 },
+    { "lz/compress_random", runLzCompress, 1 },
+    { "lz/decompress_records", runLzDecompress, 0 }
+};
+
+int main(int argc, char* argv[]) {
+    std::string filter;
+    uint64_t minTime = 500;
+    bool isJson = false;
+
+    for (int i = 1; i < argc; i++) {
+        const std::string option = argv[i];
+
+        if (option.compare(0, 9, "--filter=") == 0) {
+            filter = option.substr(9);
+        }
+        else if (option.compare(0, 11, "--min-time=") == 0) {
+            const std::string value = option.substr(11);
+
+            if (value.empty() || value.find_first_not_of("1234567890") != std::string::npos || !(minTime = std::stoull(value))) {
+                std::cout << "Invalid value: " << option << std::endl;
+
+                return 1;
+            }
+
+        }
+        else if (option == "--json") {
+            isJson = true;
+        }
+        else {
+            std::cout << "Unknown option: " << option << std::endl;
+
+            return 1;
+        }
+
+    }
+
+    char path[] = "/tmp/lumbrjack-bench-XXXXXX";
+    fd = mkstemp(path);
+
+    if (fd < 0) {
+        std::cout << "Failed to create a temporary file." << std::endl;
+
+        return 1;
+    }
+
+    unlink(path);
+
+    WCHAR kbdName[SOURCE_NAME_LENGTH] = { 'K', 'B', 'D' };
+    WCHAR mouName[SOURCE_NAME_LENGTH] = { 'M', 'O', 'U' };
+    initSources();
+    addSource(kbdName, FILE_DEVICE_KEYBOARD, &kbdSourceId);
+    addSource(mouName, FILE_DEVICE_MOUSE, &mouSourceId);
+    isLogging = TRUE;
+
+    std::vector<Result> results;
+
+    for (const Benchmark& benchmark : benchmarks) {
+
+        if (std::string(benchmark.name).find(filter) == std::string::npos) continue;
+
+        results.push_back(measure(&benchmark, minTime));
+    }
+
+    close(fd);
+
+    if (isJson) {
+        writeJson(results, std::cout);
+    }
+    else {
+        writeTable(results, std::cout);
+    }
+
+    return 0;
+}
+
+
+// Passes entries from producer threads through a blocking queue of the size of the driver to the calling thread.
+// An operation is an entry added and removed.
+static void runQueue(uint64_t iterations, uint64_t producers) {
+    initBlockingQueue(&queue, QUEUE_SIZE);
+    // the entries outlive the producers, which finish while their last entries are still queued
+    std::vector<LIST_ENTRY> entries(producers * (QUEUE_SIZE + 1));
+    std::vector<std::thread> threads;
+
+    for (uint64_t i = 0; i < producers; i++) {
+        threads.emplace_back(produce, &entries[i * (QUEUE_SIZE + 1)], iterations / producers + (i < iterations % producers ? 1 : 0));
+    }
+
+    for (uint64_t i = 0; i < iterations; i++) {
+        LIST_ENTRY* pListEntry = nullptr;
+        removeFromBlockingQueue(&queue, &pListEntry);
+    }
+
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    return;
+}
+
+
+// Adds QUEUE_SIZE + 1 entries to the queue in turn.
+// An entry is only reused after more entries than fit into the queue were added after it, so it has been removed.
+static void produce(LIST_ENTRY* entries, uint64_t count) {
+
+    for (uint64_t i = 0; i < count; i++) {
+        addToBlockigQueue(&queue, &entries[i % (QUEUE_SIZE + 1)]);
+    }
+
+    return;
+}
+
+
+// Allocates and frees a queue entry like the completion routines and the logging threads.
+static void runAllocation(uint64_t iterations, uint64_t arg) {
+    UNREFERENCED_PARAMETER(arg);
+
+    for (uint64_t i = 0; i < iterations; i++) {
+        KbdDataEntry* const pKbdDataEntry = static_cast<KbdDataEntry*>(platformAllocate(sizeof(KbdDataEntry), KBD_LIST_DATA_TAG));
+        // touches the entry like the completion routines
+        pKbdDataEntry->time = i;
+        platformFree(pKbdDataEntry, KBD_LIST_DATA_TAG);
+    }
+
+    return;
+}
+
+
+// Processes reads of keyboard input like completeKbdRead and removes the entries like the logging thread.
+// An operation is a single input event.
+static void runKbdInput(uint64_t iterations, uint64_t arg) {
+    UNREFERENCED_PARAMETER(arg);
+
+    initBlockingQueue(&queue, READ_SIZE);
+    const InputSession session = { 0, &isLogging, &queue, 0, nullptr, nullptr };
+    KEYBOARD_INPUT_DATA input[READ_SIZE] = {};
+
+    for (size_t i = 0; i < READ_SIZE; i++) {
+        input[i].MakeCode = static_cast<USHORT>(0x10 + i / 2);
+        input[i].Flags = i % 2 ? KEY_BREAK : KEY_MAKE;
+    }
+
+    for (uint64_t i = 0; i < iterations; i += READ_SIZE) {
+        processKbdInput(input, static_cast<size_t>(std::min<uint64_t>(READ_SIZE, iterations - i)), kbdSourceId, &session);
+        drainQueue();
+    }
+
+    return;
+}
+
+
+// Processes reads of mouse clicks like completeMouRead and removes the entries like the logging thread.
+// An operation is a single input event.
+static void runMouInput(uint64_t iterations, uint64_t arg) {
+    UNREFERENCED_PARAMETER(arg);
+
+    initBlockingQueue(&queue, READ_SIZE);
+    const InputSession session = { 0, &isLogging, &queue, 0, nullptr, nullptr };
+    MOUSE_INPUT_DATA input[READ_SIZE] = {};
+
+    for (size_t i = 0; i < READ_SIZE; i++) {
+        input[i].ButtonFlags = i % 2 ? MOUSE_LEFT_BUTTON_UP : MOUSE_LEFT_BUTTON_DOWN;
+        input[i].LastX = static_cast<LONG>(i);
+    }
+
+    for (uint64_t i = 0; i < iterations; i += READ_SIZE) {
+        processMouInput(input, static_cast<size_t>(std::min<uint64_t>(READ_SIZE, iterations - i)), mouSourceId, &session);
+        drainQueue();
+    }
+
+    return;
+}
+
+
+static void drainQueue() {
+
+    while (queue.size) {
+        LIST_ENTRY* pListEntry = nullptr;
+        removeFromBlockingQueue(&queue, &pListEntry);
+        freeDataEntry(CONTAINING_RECORD(pListEntry, DataEntry, list));
+    }
+
+    return;
+}
+
+
+// Formats keyboard input like logKbdToFile.
+static void runKbdFormat(uint64_t iterations, uint64_t flags) {
+    KbdDataEntry kbdDataEntry = {};
+    kbdDataEntry.type = LOG_KBD;
+    kbdDataEntry.time = 1;
+    kbdDataEntry.repeatCount = 3;
+    kbdDataEntry.holdTime = 1000000;
+    char buffer[0x60];
+
+    for (uint64_t i = 0; i < iterations; i++) {
+        kbdDataEntry.data.MakeCode = static_cast<USHORT>(0x10 + i % 0x20);
+        formatKbd(&kbdDataEntry, &lineSequences, static_cast<ULONG>(flags), FALSE, buffer, sizeof(buffer));
+    }
+
+    return;
+}
+
+
+// Formats mouse clicks or movement like logMouToFile.
+static void runMouFormat(uint64_t iterations, uint64_t flags) {
+    MouDataEntry mouDataEntry = {};
+    mouDataEntry.type = LOG_MOU;
+    mouDataEntry.time = 1;
+    mouDataEntry.data.ButtonFlags = flags & LOG_FLAG_MOTION ? 0 : MOUSE_LEFT_BUTTON_DOWN;
+    char buffer[0x100];
+
+    for (uint64_t i = 0; i < iterations; i++) {
+        mouDataEntry.data.LastX = static_cast<LONG>(i % 0x800);
+        mouDataEntry.data.LastY = -static_cast<LONG>(i % 0x400);
+        formatMou(&mouDataEntry, &lineSequences, static_cast<ULONG>(flags), FALSE, buffer, sizeof(buffer));
+    }
+
+    return;
+}
+
+
+// Encodes keyboard input to records like logBinToFile.
+static void runEncode(uint64_t iterations, uint64_t arg) {
+    UNREFERENCED_PARAMETER(arg);
+
+    KbdDataEntry kbdDataEntry = {};
+    kbdDataEntry.type = LOG_KBD;
+    InputRecord records[RECORDS_PER_ENTRY];
+    ULONGLONG lastTime = 0;
+
+    for (uint64_t i = 0; i < iterations; i++) {
+        ULONG count = 0;
+        kbdDataEntry.time = i + 1;
+        kbdDataEntry.sequence = i;
+        encodeRecords(reinterpret_cast<DataEntry*>(&kbdDataEntry), &lastTime, records, &count);
+    }
+
+    return;
+}
+
+
+// Writes a line of a text log per operation, either directly like uncompressed output or through a buffer of batchSize bytes.
+static void runWrite(uint64_t iterations, uint64_t batchSize) {
+    static const char line[] = "K:aSEQ:0SRC:0\n";
+    const ULONG lineSize = sizeof(line) - 1;
+    std::vector<UCHAR> buffer(batchSize);
+    ULONG size = 0;
+    lseek(fd, 0, SEEK_SET);
+
+    for (uint64_t i = 0; i < iterations; i++) {
+
+        if (!batchSize) {
+            platformWriteFile(fd, line, lineSize);
+
+            continue;
+        }
+
+        if (size + lineSize > batchSize) {
+            platformWriteFile(fd, buffer.data(), size);
+            size = 0;
+        }
+
+        memcpy(buffer.data() + size, line, lineSize);
+        size += lineSize;
+    }
+
+    if (size) {
+        platformWriteFile(fd, buffer.data(), size);
+    }
+
+    return;
+}
+
+
+// Fills a block of LZ_BLOCK_SIZE bytes with binary records of keyboard input like logBinToFile or with random, incompressible data.
+static std::vector<uint8_t> makeLzBlock(bool isRandom) {
+    std::vector<uint8_t> block(LZ_BLOCK_SIZE);
+
+    if (isRandom) {
+        uint32_t state = 0x12345678;
+
+        for (uint8_t& byte : block) {
+            state = state * 1664525 + 1013904223;
+            byte = static_cast<uint8_t>(state >> 24);
+        }
+
+        return block;
+    }
+
+    KbdDataEntry kbdDataEntry = {};
+    kbdDataEntry.type = LOG_KBD;
+    InputRecord records[RECORDS_PER_ENTRY];
+    ULONGLONG lastTime = 0;
+    size_t size = 0;
+
+    for (uint64_t i = 0; size < block.size(); i++) {
+        ULONG count = 0;
+        kbdDataEntry.time = i * 1000;
+        kbdDataEntry.sequence = i;
+        kbdDataEntry.data.MakeCode = static_cast<USHORT>(0x10 + i % 0x20);
+        kbdDataEntry.data.Flags = i % 2 ? KEY_BREAK : KEY_MAKE;
+        encodeRecords(reinterpret_cast<DataEntry*>(&kbdDataEntry), &lastTime, records, &count);
+        const size_t recordsSize = std::min(count * sizeof(InputRecord), block.size() - size);
+        memcpy(block.data() + size, records, recordsSize);
+        size += recordsSize;
+    }
+
+    return block;
+}
+
+
+// Compresses a full block per operation like the writer of LOG_FLAG_COMPRESS.
+static void runLzCompress(uint64_t iterations, uint64_t isRandom) {
+    const std::vector<uint8_t> block = makeLzBlock(isRandom != 0);
+    std::vector<uint8_t> compressed(LZ_MAX_COMPRESSED_SIZE(LZ_BLOCK_SIZE));
+    std::vector<uint16_t> hashTable(LZ_HASH_TABLE_SIZE / sizeof(uint16_t));
+
+    for (uint64_t i = 0; i < iterations; i++) {
+        lzCompress(block.data(), block.size(), compressed.data(), compressed.size(), hashTable.data());
+    }
+
+    return;
+}
+
+
+// Decompresses a full block of binary records per operation like the client reading a compressed log.
+static void runLzDecompress(uint64_t iterations, uint64_t arg) {
+    UNREFERENCED_PARAMETER(arg);
+
+    const std::vector<uint8_t> block = makeLzBlock(false);
+    std::vector<uint8_t> compressed(LZ_MAX_COMPRESSED_SIZE(LZ_BLOCK_SIZE));
+    std::vector<uint16_t> hashTable(LZ_HASH_TABLE_SIZE / sizeof(uint16_t));
+    const size_t compressedSize = lzCompress(block.data(), block.size(), compressed.data(), compressed.size(), hashTable.data());
+    std::vector<uint8_t> decompressed(block.size());
+
+    for (uint64_t i = 0; i < iterations; i++) {
+        decompress::decompressBlock(compressed.data(), compressedSize, decompressed.data(), decompressed.size());
+    }
+
+    return;
+}
+
+
+// Runs a benchmark with growing iteration counts until a run takes the minimum time.
+static Result measure(const Benchmark* pBenchmark, uint64_t minTime) {
+    const std::chrono::duration<double> minDuration = std::chrono::milliseconds(minTime);
+    uint64_t iterations = 1;
+
+    while (true) {
+        const ULONGLONG allocations = getAllocationCount();
+        const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        pBenchmark->run(iterations, pBenchmark->arg);
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        if (elapsed >= minDuration || iterations >= 1000000000000ull) {
+            const double seconds = elapsed.count();
+            const double count = static_cast<double>(iterations);
+
+            return Result{ pBenchmark->name, iterations, seconds * 1e9 / count, seconds > 0.0 ? count / seconds : 0.0,
+                static_cast<double>(getAllocationCount() - allocations) / count };
+        }
+
+        // aims 40 % above the minimum time, so most benchmarks only need a single more run
+        const double factor = elapsed.count() > 0.0 ? 1.4 * minDuration.count() / elapsed.count() : 100.0;
+        iterations = std::max(iterations * 2, static_cast<uint64_t>(static_cast<double>(iterations) * std::min(factor, 100.0)));
+    }
+
+}
+
+
+static void writeJson(const std::vector<Result>& results, std::ostream& out) {
+    out << "{\n  \"context\": {\n    \"num_cpus\": " << std::thread::hardware_concurrency() << ",\n    \"queue_size\": " << QUEUE_SIZE
+        << "\n  },\n  \"benchmarks\": [";
+
+    for (size_t i = 0; i < results.size(); i++) {
+        const Result* const pResult = &results[i];
+        out << (i ? ",\n" : "\n") << "    {\n      \"name\": \"" << pResult->name << "\",\n      \"iterations\": " << pResult->iterations
+            << ",\n      \"ns_per_op\": " << pResult->nsPerOp << ",\n      \"ops_per_second\": " << pResult->opsPerSecond
+            << ",\n      \"allocations_per_op\": " << pResult->allocationsPerOp << "\n    }";
+    }
+
+    out << "\n  ]\n}" << std::endl;
+
+    return;
+}
+
+
+static void writeTable(const std::vector<Result>& results, std::ostream& out) {
+    out << std::left << std::setw(24) << "Benchmark" << std::right << std::setw(14) << "Iterations" << std::setw(14) << "ns/op"
+        << std::setw(16) << "ops/s" << std::setw(12) << "allocs/op" << '\n';
+
+    for (const Result& result : results) {
+        out << std::left << std::setw(24) << result.name << std::right << std::setw(14) << result.iterations << std::fixed << std::setprecision(1)
+            << std::setw(14) << result.nsPerOp << std::setw(16) << std::setprecision(0) << result.opsPerSecond << std::setprecision(2)
+            << std::setw(12) << result.allocationsPerOp << std::defaultfloat << '\n';
+    }
+
+    out << std::flush;
+
+    return;
+}
\ No newline at end of file
@@ -0,0 +1,277 @@
+extern "C" {
+#include "../src/lz.h"
+#include "../src/cipher.h"
+#include "test.h"
+}
+#include "decompress.h"
+#include "gcm.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+// Tests of the encryption of LOG_FLAG_ENCRYPT: the known answer tests of the GCM implementations of the client
+// and encrypted log files written like the writer of the driver (writer.c), read back by the decompressor of the client.
+// Modified, reordered and truncated files have to be rejected.
+
+namespace {
+
+    constexpr const char* LOG_PATH = "cipher.bin";
+    constexpr uint64_t NONCE_PREFIX = 0x1122334455667788;
+
+    // Lines of a text log.
+    std::vector<uint8_t> textData(size_t size) {
+        static const char lines[] = "K:aSRC:1\nM:LDSRC:2\nK:[SHIFT]SRC:1\n";
+        std::vector<uint8_t> data(size);
+
+        for (size_t i = 0; i < size; i++) {
+            data[i] = static_cast<uint8_t>(lines[i % (sizeof(lines) - 1)]);
+        }
+
+        return data;
+    }
+
+
+    std::vector<uint8_t> makeKey(uint8_t seed) {
+        std::vector<uint8_t> key(CIPHER_KEY_SIZE);
+
+        for (size_t i = 0; i < key.size(); i++) {
+            key[i] = static_cast<uint8_t>(seed + i * 11);
+        }
+
+        return key;
+    }
+
+
+    // Writes the data to an encrypted log file like the writer of the driver: full blocks while logging and the remainder as the final block on close.
+    // Every block is compressed if it gets smaller, then encrypted with the file header and its block header as additional data.
+    //
+    // Return:
+    // Offsets of the blocks in the file followed by the size of the file.
+    std::vector<size_t> writeLog(const std::vector<uint8_t>& data, bool isCompressed, const std::vector<uint8_t>& key) {
+        gcm::Context context{};
+        gcm::init(&context, key.data(), true);
+        std::vector<uint16_t> hashTable(LZ_HASH_TABLE_SIZE / sizeof(uint16_t));
+
+        CipherFileHeader fileHeader{};
+        fileHeader.magic = CIPHER_FILE_MAGIC;
+        fileHeader.flags = isCompressed ? CIPHER_FLAG_COMPRESSED : 0;
+        fileHeader.noncePrefix = NONCE_PREFIX;
+        std::ofstream file(LOG_PATH, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(&fileHeader), sizeof(fileHeader));
+        std::vector<size_t> offsets;
+        size_t offset = sizeof(fileHeader);
+
+        for (uint32_t blockIndex = 0; offsets.empty() || offsets.size() <= data.size() / LZ_BLOCK_SIZE; blockIndex++) {
+            const size_t start = blockIndex * static_cast<size_t>(LZ_BLOCK_SIZE);
+            const size_t size = std::min(data.size() - start, static_cast<size_t>(LZ_BLOCK_SIZE));
+            const bool isFinal = start + LZ_BLOCK_SIZE > data.size();
+            std::vector<uint8_t> block(data.begin() + start, data.begin() + start + size);
+
+            if (isCompressed && size) {
+                std::vector<uint8_t> compressed(LZ_MAX_COMPRESSED_SIZE(LZ_BLOCK_SIZE));
+                const size_t compressedSize = lzCompress(block.data(), size, compressed.data(), compressed.size(), hashTable.data());
+
+                if (compressedSize && compressedSize < size) {
+                    compressed.resize(compressedSize);
+                    block.swap(compressed);
+                }
+
+            }
+
+            LzBlockHeader header{};
+            header.uncompressedSize = static_cast<uint32_t>(size) | (isFinal ? LZ_BLOCK_FINAL : 0);
+            header.compressedSize = static_cast<uint32_t>(block.size());
+            uint8_t nonce[CIPHER_NONCE_SIZE]{};
+            memcpy(nonce, &fileHeader.noncePrefix, sizeof(fileHeader.noncePrefix));
+            memcpy(nonce + sizeof(fileHeader.noncePrefix), &blockIndex, sizeof(blockIndex));
+            uint8_t authData[sizeof(fileHeader) + sizeof(header)];
+            memcpy(authData, &fileHeader, sizeof(fileHeader));
+            memcpy(authData + sizeof(fileHeader), &header, sizeof(header));
+            uint8_t tag[CIPHER_TAG_SIZE]{};
+            gcm::encrypt(&context, nonce, authData, sizeof(authData), block.data(), block.data(), block.size(), tag);
+
+            file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            file.write(reinterpret_cast<const char*>(block.data()), static_cast<std::streamsize>(block.size()));
+            file.write(reinterpret_cast<const char*>(tag), sizeof(tag));
+            offsets.push_back(offset);
+            offset += sizeof(header) + block.size() + sizeof(tag);
+        }
+
+        offsets.push_back(offset);
+
+        return offsets;
+    }
+
+
+    std::vector<uint8_t> readFile() {
+        std::ifstream file(LOG_PATH, std::ios::binary);
+
+        return std::vector<uint8_t>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+
+
+    void writeFile(const std::vector<uint8_t>& bytes) {
+        std::ofstream file(LOG_PATH, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+
+        return;
+    }
+
+
+    // Reads the log file with the decompressor of the client.
+    std::vector<uint8_t> readLog(const std::vector<uint8_t>& key, bool* pIsCorrupt) {
+        // the stream is too large for the stack
+        decompress::Stream* const pStream = new decompress::Stream();
+        CHECK(decompress::open(pStream, LOG_PATH, key.data()));
+        CHECK(pStream->isEncrypted);
+        std::vector<uint8_t> data;
+        uint8_t buffer[0x1000];
+        size_t size = 0;
+
+        while ((size = decompress::read(pStream, buffer, sizeof(buffer))) > 0) {
+            data.insert(data.end(), buffer, buffer + size);
+        }
+
+        *pIsCorrupt = pStream->isCorrupt;
+        delete pStream;
+
+        return data;
+    }
+
+
+    // Checks that reading stops with isCorrupt after the first blockCount blocks of the data.
+    void checkRejected(const std::vector<uint8_t>& data, const std::vector<uint8_t>& key, size_t blockCount) {
+        bool isCorrupt = false;
+        const std::vector<uint8_t> read = readLog(key, &isCorrupt);
+        CHECK(isCorrupt);
+        CHECK(read.size() == std::min(data.size(), blockCount * LZ_BLOCK_SIZE));
+        CHECK(std::equal(read.begin(), read.end(), data.begin()));
+
+        return;
+    }
+
+
+    // Known answer tests of the GCM specification with the table based and, if supported, the accelerated implementation.
+    void testKnownAnswers() {
+        CHECK(gcm::selfTest());
+
+        return;
+    }
+
+
+    // Empty files, files of exactly one block and files with a partial final block, compressed and uncompressed.
+    void testRoundTrip() {
+        const std::vector<uint8_t> key = makeKey(1);
+
+        for (bool isCompressed : { false, true }) {
+
+            for (size_t size : { 0, 1, 0x123, LZ_BLOCK_SIZE, 2 * LZ_BLOCK_SIZE + 0x4567 }) {
+                const std::vector<uint8_t> data = textData(size);
+                const std::vector<size_t> offsets = writeLog(data, isCompressed, key);
+                // a file of full blocks ends with an empty final block
+                CHECK(offsets.size() == size / LZ_BLOCK_SIZE + 2);
+                bool isCorrupt = true;
+                CHECK(readLog(key, &isCorrupt) == data);
+                CHECK(!isCorrupt);
+            }
+
+        }
+
+        return;
+    }
+
+
+    // Modified data, headers and tags, a modified file header, reordered blocks and a wrong key fail authentication at the affected block.
+    void testTamper() {
+        const std::vector<uint8_t> key = makeKey(2);
+        const std::vector<uint8_t> data = textData(2 * LZ_BLOCK_SIZE + 0x4567);
+        const std::vector<size_t> offsets = writeLog(data, true, key);
+        CHECK(offsets.size() == 4);
+        const std::vector<uint8_t> original = readFile();
+
+        // a bit of the data of the second block, of its compressed size and of the tag of the final block
+        const size_t tamperedOffsets[] = { offsets[1] + sizeof(LzBlockHeader) + 5, offsets[1] + offsetof(LzBlockHeader, compressedSize), offsets[3] - 1 };
+        const size_t tamperedBlocks[] = { 1, 1, 2 };
+
+        for (size_t i = 0; i < sizeof(tamperedOffsets) / sizeof(tamperedOffsets[0]); i++) {
+            std::vector<uint8_t> bytes = original;
+            bytes[tamperedOffsets[i]] ^= 1;
+            writeFile(bytes);
+            checkRejected(data, key, tamperedBlocks[i]);
+        }
+
+        // the final flag removed, so the file looks like it continues
+        std::vector<uint8_t> bytes = original;
+        bytes[offsets[2] + offsetof(LzBlockHeader, uncompressedSize) + 3] &= 0x7F;
+        writeFile(bytes);
+        checkRejected(data, key, 2);
+
+        // the compressed flag of the file header cleared, so the compressed blocks would be read as they are
+        bytes = original;
+        bytes[offsetof(CipherFileHeader, flags)] ^= CIPHER_FLAG_COMPRESSED;
+        writeFile(bytes);
+        checkRejected(data, key, 0);
+
+        // the first two blocks swapped
+        bytes.assign(original.begin(), original.begin() + offsets[0]);
+        bytes.insert(bytes.end(), original.begin() + offsets[1], original.begin() + offsets[2]);
+        bytes.insert(bytes.end(), original.begin() + offsets[0], original.begin() + offsets[1]);
+        bytes.insert(bytes.end(), original.begin() + offsets[2], original.end());
+        writeFile(bytes);
+        checkRejected(data, key, 0);
+
+        writeLog(data, true, key);
+        checkRejected(data, makeKey(3), 0);
+
+        return;
+    }
+
+
+    // Files cut off at a block boundary are rejected like files cut off within a block.
+    void testTruncated() {
+        const std::vector<uint8_t> key = makeKey(4);
+
+        for (size_t size : { 0x123, LZ_BLOCK_SIZE, 2 * LZ_BLOCK_SIZE + 0x4567 }) {
+            const std::vector<uint8_t> data = textData(size);
+            const std::vector<size_t> offsets = writeLog(data, true, key);
+            const std::vector<uint8_t> original = readFile();
+
+            // the final block dropped
+            writeFile(std::vector<uint8_t>(original.begin(), original.begin() + offsets[offsets.size() - 2]));
+            checkRejected(data, key, offsets.size() - 2);
+
+            // the final block cut off in its header and in its tag
+            writeFile(std::vector<uint8_t>(original.begin(), original.begin() + offsets[offsets.size() - 2] + sizeof(LzBlockHeader) - 1));
+            checkRejected(data, key, offsets.size() - 2);
+            writeFile(std::vector<uint8_t>(original.begin(), original.end() - 1));
+            checkRejected(data, key, offsets.size() - 2);
+        }
+
+        // a block appended after the final block, even a correctly authenticated one
+        const std::vector<uint8_t> data = textData(0x123);
+        writeLog(data, true, key);
+        std::vector<uint8_t> bytes = readFile();
+        const std::vector<size_t> offsets = writeLog(textData(LZ_BLOCK_SIZE + 1), true, key);
+        const std::vector<uint8_t> longer = readFile();
+        bytes.insert(bytes.end(), longer.begin() + offsets[1], longer.end());
+        writeFile(bytes);
+        checkRejected(data, key, 1);
+
+        return;
+    }
+
+}
+
+
+int main() {
+    RUN_TEST(testKnownAnswers);
+    RUN_TEST(testRoundTrip);
+    RUN_TEST(testTamper);
+    RUN_TEST(testTruncated);
+    std::remove(LOG_PATH);
+
+    return failedChecks ? EXIT_FAILURE : EXIT_SUCCESS;
+}
\ No newline at end of file
@@ -0,0 +1,234 @@
+extern "C" {
+#include "../src/format.h"
+#include "test.h"
+}
+#include "columns.h"
+#include "parser.h"
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Columnar export of the client (columns.h): binary captures and text logs are exported and queried,
+// and the values of all columns, including source IDs and sequence numbers, are compared with the events of the parser.
+
+namespace {
+
+    constexpr const char* BINARY_PATH = "columns.bin";
+    constexpr const char* TEXT_PATH = "columns.log";
+    constexpr const char* COLUMN_PATH = "columns.ljc";
+    constexpr uint64_t START_TIME = 50000000;
+    // Records of the binary capture. Mouse records with two buttons have two events, so the events fill several chunks.
+    constexpr size_t RECORD_COUNT = 3 * columns::CHUNK_EVENTS;
+    constexpr const char* ALL_COLUMNS = "time,type,code,flags,x,y,source,seq";
+
+    // Writes a keyboard and a mouse interleaved with their own sequence numbers, gaps of lost input, times that go back
+    // and sequence numbers beyond 63 bits for the mouse.
+    void writeBinary() {
+        RecordFileHeader header{};
+        header.magic = RECORD_MAGIC;
+        header.version = RECORD_VERSION;
+        header.headerSize = sizeof(RecordFileHeader);
+        header.recordSize = sizeof(InputRecord);
+        header.timeResolution = RECORD_TIME_RESOLUTION;
+        header.startTime = START_TIME;
+        std::ofstream file(BINARY_PATH, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        uint64_t sequences[] = { 0, 0x7FFFFFFFFFFFFF00 };
+        uint64_t time = START_TIME;
+        uint32_t state = 5;
+
+        for (size_t i = 0; i < RECORD_COUNT; i++) {
+            state = state * 1664525 + 1013904223;
+            const uint32_t choice = state >> 24;
+            const size_t device = choice & 1;
+            InputRecord record{};
+
+            if (choice < 0x4) {
+                InputRecord timeRecord{};
+                timeRecord.type = RECORD_TYPE_TIME;
+                time -= 100000;
+                timeRecord.time.time = time;
+                file.write(reinterpret_cast<const char*>(&timeRecord), sizeof(timeRecord));
+            }
+            else {
+                record.timeDelta = state >> 8 & 0xFFFF;
+                time += record.timeDelta;
+            }
+
+            // lost input, the mouse loses none before 2^63
+            if (choice >= 0xF8 && (!device || sequences[device] >= 1ull << 63)) {
+                sequences[device] += choice & 0x7;
+            }
+
+            record.source = static_cast<uint16_t>(device ? 0x101 : 1);
+            record.sequence = sequences[device]++;
+
+            if (device) {
+                record.type = RECORD_TYPE_MOU;
+                record.mou.flags = choice & 2 ? MOUSE_MOVE_ABSOLUTE : 0;
+                record.mou.buttonFlags = static_cast<uint16_t>(choice & 4 ? MOUSE_LEFT_BUTTON_DOWN | MOUSE_RIGHT_BUTTON_DOWN : choice & 8 ? MOUSE_LEFT_BUTTON_UP : 0);
+                record.mou.lastX = static_cast<int32_t>(state >> 4 & 0xFFFF) - 0x100;
+                record.mou.lastY = static_cast<int32_t>(state >> 12 & 0xFFFF) - 0x100;
+            }
+            else {
+                record.type = RECORD_TYPE_KBD;
+                record.kbd.makeCode = static_cast<uint16_t>(0x10 + (choice >> 1) % 0x20);
+                record.kbd.flags = choice & 2 ? KEY_BREAK : KEY_MAKE;
+            }
+
+            file.write(reinterpret_cast<const char*>(&record), sizeof(record));
+        }
+
+        return;
+    }
+
+
+    // Formats the events of the parser that match the filter with the columns of the mask in file order.
+    std::string formatEvents(const char* path, const columns::Filter* pFilter, uint32_t columnMask) {
+        parser::Result result{};
+        CHECK(parser::parseFile(path, 1, &result));
+        std::ostringstream out;
+        const char* const names[] = { "time", "type", "code", "flags", "x", "y", "source", "seq" };
+        std::string line;
+
+        for (uint32_t col = 0; col < columns::MAX_COLUMN; col++) {
+
+            if (columnMask & 1u << col) {
+                line += line.empty() ? "" : ",";
+                line += names[col];
+            }
+
+        }
+
+        out << line << '\n';
+
+        for (const parser::Event& event : result.events) {
+
+            if (!(pFilter->typeMask >> event.type & 1) || event.time < pFilter->fromTime || event.time > pFilter->toTime
+                || event.x < pFilter->minX || event.x > pFilter->maxX || event.y < pFilter->minY || event.y > pFilter->maxY) {
+
+                continue;
+            }
+
+            std::stringstream values;
+            values << event.time << ',' << parser::getTypeName(event.type) << ',' << event.code << ',' << event.flags << ','
+                << event.x << ',' << event.y << ',' << event.source << ',' << event.sequence;
+            bool isFirst = true;
+            std::string value;
+
+            for (uint32_t col = 0; std::getline(values, value, ','); col++) {
+
+                if (!(columnMask & 1u << col)) continue;
+
+                out << (isFirst ? "" : ",") << value;
+                isFirst = false;
+            }
+
+            out << '\n';
+        }
+
+        return out.str();
+    }
+
+
+    std::string query(const columns::Filter* pFilter, uint32_t columnMask, columns::ScanStats* pStats) {
+        std::ostringstream out;
+        CHECK(columns::scan(COLUMN_PATH, pFilter, columnMask, out, pStats));
+
+        return out.str();
+    }
+
+
+    // All columns of all events come back in capture order, also with several threads.
+    void testBinaryRoundTrip() {
+        writeBinary();
+        columns::Filter filter{};
+        columns::getDefaultFilter(&filter);
+        uint32_t columnMask = 0;
+        CHECK(columns::parseColumns(ALL_COLUMNS, &columnMask));
+        const std::string expected = formatEvents(BINARY_PATH, &filter, columnMask);
+
+        for (unsigned int threads : { 1u, 4u }) {
+            columns::ExportStats exportStats{};
+            CHECK(columns::exportFile(BINARY_PATH, COLUMN_PATH, threads, &exportStats));
+            CHECK(exportStats.chunkCount > 3 && exportStats.eventCount > RECORD_COUNT);
+            columns::ScanStats scanStats{};
+            CHECK(query(&filter, columnMask, &scanStats) == expected);
+            CHECK(scanStats.matchCount == exportStats.eventCount && scanStats.skippedCount == 0);
+        }
+
+        // sequence numbers beyond 63 bits are written unsigned
+        CHECK(expected.find(",257,9223372036854775808\n") != std::string::npos);
+
+        return;
+    }
+
+
+    // Filters on the type, the time and the region with a subset of the columns, so only some columns are decoded.
+    void testBinaryQuery() {
+        writeBinary();
+        columns::ExportStats exportStats{};
+        CHECK(columns::exportFile(BINARY_PATH, COLUMN_PATH, 2, &exportStats));
+        columns::Filter filter{};
+        columns::getDefaultFilter(&filter);
+        CHECK(columns::parseTypes("button,move", &filter.typeMask));
+        filter.minX = 0;
+        filter.maxX = 0x7FFF;
+        filter.minY = -0x80;
+        filter.maxY = 0x8000;
+        uint32_t columnMask = 0;
+        CHECK(columns::parseColumns("time,x,source,seq", &columnMask));
+        columns::ScanStats scanStats{};
+        CHECK(query(&filter, columnMask, &scanStats) == formatEvents(BINARY_PATH, &filter, columnMask));
+
+        // the events of the first chunk are before the time range, so its columns are not read
+        parser::Result result{};
+        CHECK(parser::parseFile(BINARY_PATH, 1, &result));
+        filter.fromTime = result.events[columns::CHUNK_EVENTS * 3 / 2].time;
+        filter.toTime = filter.fromTime + 0x1000000;
+        CHECK(query(&filter, columnMask, &scanStats) == formatEvents(BINARY_PATH, &filter, columnMask));
+        CHECK(scanStats.skippedCount >= 1);
+
+        // only counted
+        const std::string counted = query(&filter, 0, &scanStats);
+        CHECK(counted.empty() && scanStats.matchCount > 0);
+
+        return;
+    }
+
+
+    // Lines of text logs have a source ID and a sequence number only if the driver wrote them.
+    void testTextRoundTrip() {
+        std::ofstream file(TEXT_PATH, std::ios::binary | std::ios::trunc);
+        file << "K:aSEQ:5SRC:1\nM:LEFT@X:10Y:20SEQ:18446744073709551615SRC:2\nK:bSRC:3\nK:c\n";
+        file.close();
+        columns::Filter filter{};
+        columns::getDefaultFilter(&filter);
+        uint32_t columnMask = 0;
+        CHECK(columns::parseColumns(ALL_COLUMNS, &columnMask));
+        columns::ExportStats exportStats{};
+        CHECK(columns::exportFile(TEXT_PATH, COLUMN_PATH, 1, &exportStats));
+        columns::ScanStats scanStats{};
+        const std::string lines = query(&filter, columnMask, &scanStats);
+        CHECK(lines == formatEvents(TEXT_PATH, &filter, columnMask));
+        CHECK(lines.find(",10,20,2,18446744073709551615\n") != std::string::npos);
+
+        return;
+    }
+
+}
+
+
+int main() {
+    RUN_TEST(testBinaryRoundTrip);
+    RUN_TEST(testBinaryQuery);
+    RUN_TEST(testTextRoundTrip);
+    std::remove(BINARY_PATH);
+    std::remove(TEXT_PATH);
+    std::remove(COLUMN_PATH);
+
+    return failedChecks ? EXIT_FAILURE : EXIT_SUCCESS;
+}
\ No newline at end of file
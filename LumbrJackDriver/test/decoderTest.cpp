@@ -0,0 +1,243 @@
+extern "C" {
+#include "../src/format.h"
+#include "test.h"
+}
+#include "decoder.h"
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <vector>
+
+// Round trip tests of binary log files: records encoded by the driver (encodeRecords) are read back by the decoder of the client.
+// Covers version 1 and 2 files, truncated trailing records and invalid headers.
+
+namespace {
+
+    constexpr const char* LOG_PATH = "decoder.bin";
+    constexpr ULONGLONG START_TIME = 50000000;
+
+    // Input of a log file and the time it was captured at.
+    struct Input {
+        bool isKbd;
+        ULONGLONG time;
+        USHORT code;
+        LONG x;
+    };
+
+    // Times go backwards and jump by more than 32 bits, so the file contains time records.
+    const Input inputs[] = {
+        { true, START_TIME + 100, 0x1E, 0 },
+        { false, START_TIME + 300, 0, -7 },
+        { false, START_TIME + 200, 0, 12 },
+        { true, START_TIME + 0x200000000ull + 5, 0x30, 0 },
+        { true, START_TIME + 0x200000000ull + 5, 0x2E, 0 },
+    };
+
+    RecordFileHeader makeHeader(uint16_t version, uint32_t recordSize) {
+        RecordFileHeader header{};
+        header.magic = RECORD_MAGIC;
+        header.version = version;
+        header.headerSize = sizeof(RecordFileHeader);
+        header.recordSize = recordSize;
+        header.timeResolution = RECORD_TIME_RESOLUTION;
+        header.startTime = START_TIME;
+
+        return header;
+    }
+
+
+    // Encodes the inputs like the logging thread of a binary log.
+    std::vector<InputRecord> encodeInputs() {
+        std::vector<InputRecord> records;
+        ULONGLONG lastTime = START_TIME;
+        ULONGLONG sequences[2] = {};
+
+        for (const Input& input : inputs) {
+            KbdDataEntry kbdDataEntry{};
+            MouDataEntry mouDataEntry{};
+            DataEntry* pDataEntry = nullptr;
+
+            if (input.isKbd) {
+                kbdDataEntry.type = LOG_KBD;
+                kbdDataEntry.source = 1;
+                kbdDataEntry.time = input.time;
+                kbdDataEntry.sequence = sequences[0]++;
+                kbdDataEntry.data.MakeCode = input.code;
+                pDataEntry = reinterpret_cast<DataEntry*>(&kbdDataEntry);
+            }
+            else {
+                mouDataEntry.type = LOG_MOU;
+                mouDataEntry.source = 2;
+                mouDataEntry.time = input.time;
+                mouDataEntry.sequence = sequences[1]++;
+                mouDataEntry.data.LastX = input.x;
+                pDataEntry = reinterpret_cast<DataEntry*>(&mouDataEntry);
+            }
+
+            InputRecord entryRecords[RECORDS_PER_ENTRY];
+            ULONG count = 0;
+            CHECK_STATUS(encodeRecords(pDataEntry, &lastTime, entryRecords, &count), STATUS_SUCCESS);
+            records.insert(records.end(), entryRecords, entryRecords + count);
+        }
+
+        return records;
+    }
+
+
+    // Writes a log file with the first recordSize bytes of every record, followed by extra bytes.
+    void writeLog(const RecordFileHeader& header, const std::vector<InputRecord>& records, size_t extraSize) {
+        std::ofstream file(LOG_PATH, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+        for (const InputRecord& record : records) {
+            file.write(reinterpret_cast<const char*>(&record), header.recordSize);
+        }
+
+        const std::vector<char> extra(extraSize, '\x5A');
+        file.write(extra.data(), static_cast<std::streamsize>(extra.size()));
+
+        return;
+    }
+
+
+    // Decodes the log file and compares the records with the inputs. Sequence numbers are only kept by version 2.
+    void checkDecoded(bool hasSequences) {
+        // the record block is too large for the stack
+        decoder::Reader* const pReader = new decoder::Reader();
+        CHECK(decoder::open(pReader, LOG_PATH, nullptr));
+        const InputRecord* pRecord = nullptr;
+        uint64_t time = 0;
+        ULONGLONG sequences[2] = {};
+        size_t count = 0;
+
+        while (decoder::next(pReader, &pRecord, &time)) {
+
+            if (count >= sizeof(inputs) / sizeof(inputs[0])) {
+                count++;
+
+                break;
+            }
+
+            const Input& input = inputs[count++];
+            const ULONGLONG sequence = sequences[input.isKbd ? 0 : 1]++;
+            CHECK(time == input.time);
+            CHECK(pRecord->sequence == (hasSequences ? sequence : 0));
+
+            if (input.isKbd) {
+                CHECK(pRecord->type == RECORD_TYPE_KBD && pRecord->source == 1 && pRecord->kbd.makeCode == input.code);
+            }
+            else {
+                CHECK(pRecord->type == RECORD_TYPE_MOU && pRecord->source == 2 && pRecord->mou.lastX == input.x);
+            }
+
+        }
+
+        CHECK(count == sizeof(inputs) / sizeof(inputs[0]));
+        CHECK(!pReader->stream.isCorrupt);
+        delete pReader;
+
+        return;
+    }
+
+
+    void testVersion2() {
+        const std::vector<InputRecord> records = encodeInputs();
+        // one time record for the time going backwards and one for the delta above 32 bits
+        CHECK(records.size() == sizeof(inputs) / sizeof(inputs[0]) + 2);
+        writeLog(makeHeader(RECORD_VERSION, sizeof(InputRecord)), records, 0);
+        checkDecoded(true);
+
+        // header fields of newer minor revisions are skipped
+        RecordFileHeader header = makeHeader(RECORD_VERSION, sizeof(InputRecord));
+        header.headerSize = sizeof(RecordFileHeader) + 8;
+        std::ofstream file(LOG_PATH, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write("\0\0\0\0\0\0\0\0", 8);
+        file.write(reinterpret_cast<const char*>(records.data()), static_cast<std::streamsize>(records.size() * sizeof(InputRecord)));
+        file.close();
+        checkDecoded(true);
+
+        return;
+    }
+
+
+    // Records of version 1 end before the sequence number.
+    void testVersion1() {
+        writeLog(makeHeader(1, RECORD_SIZE_V1), encodeInputs(), 0);
+        checkDecoded(false);
+
+        return;
+    }
+
+
+    // A record cut off at the end of the file, e.g. by a crash while writing, is ignored.
+    void testTruncated() {
+        writeLog(makeHeader(RECORD_VERSION, sizeof(InputRecord)), encodeInputs(), sizeof(InputRecord) - 1);
+        checkDecoded(true);
+        writeLog(makeHeader(1, RECORD_SIZE_V1), encodeInputs(), RECORD_SIZE_V1 / 2);
+        checkDecoded(false);
+
+        return;
+    }
+
+
+    bool canOpen() {
+        // the record block is too large for the stack
+        decoder::Reader* const pReader = new decoder::Reader();
+        const bool isOpen = decoder::open(pReader, LOG_PATH, nullptr);
+        delete pReader;
+
+        return isOpen;
+    }
+
+
+    void testBadHeader() {
+        const std::vector<InputRecord> records = encodeInputs();
+        writeLog(makeHeader(RECORD_VERSION, sizeof(InputRecord)), records, 0);
+        CHECK(canOpen());
+
+        RecordFileHeader header = makeHeader(RECORD_VERSION, sizeof(InputRecord));
+        header.magic = 0x12345678;
+        writeLog(header, records, 0);
+        CHECK(!canOpen());
+
+        // unknown versions and record sizes that do not match the version
+        writeLog(makeHeader(RECORD_VERSION + 1, sizeof(InputRecord)), records, 0);
+        CHECK(!canOpen());
+        writeLog(makeHeader(RECORD_VERSION, RECORD_SIZE_V1), records, 0);
+        CHECK(!canOpen());
+        writeLog(makeHeader(1, sizeof(InputRecord)), records, 0);
+        CHECK(!canOpen());
+
+        header = makeHeader(RECORD_VERSION, sizeof(InputRecord));
+        header.headerSize = sizeof(RecordFileHeader) - 1;
+        writeLog(header, records, 0);
+        CHECK(!canOpen());
+
+        header = makeHeader(RECORD_VERSION, sizeof(InputRecord));
+        header.timeResolution = 0;
+        writeLog(header, records, 0);
+        CHECK(!canOpen());
+
+        // a header cut off at the end of the file
+        std::ofstream file(LOG_PATH, std::ios::binary | std::ios::trunc);
+        header = makeHeader(RECORD_VERSION, sizeof(InputRecord));
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header) - 1);
+        file.close();
+        CHECK(!canOpen());
+
+        return;
+    }
+
+}
+
+
+int main() {
+    RUN_TEST(testVersion2);
+    RUN_TEST(testVersion1);
+    RUN_TEST(testTruncated);
+    RUN_TEST(testBadHeader);
+    std::remove(LOG_PATH);
+
+    return failedChecks ? EXIT_FAILURE : EXIT_SUCCESS;
+}
\ No newline at end of file
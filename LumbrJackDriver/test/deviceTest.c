@@ -0,0 +1,646 @@
+#include "test.h"
+#include <sim.h>
+#include "../src/source.h"
+#include "../src/stats.h"
+#include <sched.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+// Tests of the device handling of the driver in the device stack simulator (see sim/sim.h):
+// attaching to existing and arriving class devices, forwarding of all requests, logging of forwarded reads and injected input,
+// detaching on removal with pending reads and on unload, and the limit of the source table. Every test ends with all objects of the simulation freed.
+// Prints the cost of attaching a filter device and of forwarding a read through it.
+
+#define KBD_DEVICES 0x80
+#define MOU_DEVICES 0x80
+#define MAX_DEVICES 0x200
+#define TIMED_READS 0x40000
+#define INJECTED_INPUT 0x1000
+#define INJECT_RATE 20000
+// Time the unload routine gets to start waiting for the pending reads, in microseconds.
+#define UNLOAD_DELAY 10000
+
+static PDEVICE_OBJECT devices[MAX_DEVICES];
+static ULONG deviceCount;
+// IOCTL_GET_SOURCES copies the whole table, so it does not fit on the stack of the test comfortably.
+static SourceList sourceList;
+static SourceList sourcesBefore;
+
+static long long getNanoseconds() {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return now.tv_sec * 1000000000ll + now.tv_nsec;
+}
+
+
+static void addDevices(ULONG kbdCount, ULONG mouCount) {
+
+	for (ULONG i = 0; i < kbdCount + mouCount && deviceCount < MAX_DEVICES; i++) {
+		const PDEVICE_OBJECT pClassDevice = addClassDevice(i < kbdCount ? FILE_DEVICE_KEYBOARD : FILE_DEVICE_MOUSE);
+		CHECK(pClassDevice);
+
+		if (pClassDevice) {
+			devices[deviceCount++] = pClassDevice;
+		}
+
+	}
+
+	return;
+}
+
+
+static void removeDevices() {
+
+	while (deviceCount) {
+		removeClassDevice(devices[--deviceCount]);
+	}
+
+	return;
+}
+
+
+// Sends input to every device once and checks that it arrived intact.
+static ULONG sendInputRound(ULONG count) {
+	SimCounters before = { 0 };
+	getSimCounters(&before);
+	ULONG sent = 0;
+
+	for (ULONG i = 0; i < deviceCount; i++) {
+		sent += sendInput(devices[i], count);
+	}
+
+	SimCounters after = { 0 };
+	getSimCounters(&after);
+	CHECK(sent == deviceCount * count);
+	CHECK(after.deliveredInput - before.deliveredInput == sent);
+
+	return sent;
+}
+
+
+// Counts the records of a trace point in the trace buffers of the driver.
+static ULONG countTraceRecords(PDEVICE_OBJECT pComDevice, USHORT point) {
+	const ULONG size = FIELD_OFFSET(TraceSnapshot, records) + 0x100 * sizeof(TraceRecord);
+	TraceSnapshot* const pTraceSnapshot = (TraceSnapshot*)malloc(size);
+
+	if (!pTraceSnapshot) return 0;
+
+	ULONG count = 0;
+	CHECK_STATUS(sendRequest(pComDevice, IRP_MJ_DEVICE_CONTROL, 0, IOCTL_READ_TRACE, pTraceSnapshot, 0, size), STATUS_SUCCESS);
+
+	for (ULONG i = 0; i < pTraceSnapshot->count; i++) {
+
+		if (pTraceSnapshot->records[i].point == point) {
+			count++;
+		}
+
+	}
+
+	free(pTraceSnapshot);
+
+	return count;
+}
+
+
+static BOOLEAN isFiltered(PDRIVER_OBJECT pDriverObject, PDEVICE_OBJECT pClassDevice) {
+
+	return IoGetAttachedDevice(pClassDevice)->DriverObject == pDriverObject;
+}
+
+
+static ULONG countFiltered(PDRIVER_OBJECT pDriverObject) {
+	ULONG count = 0;
+
+	for (ULONG i = 0; i < deviceCount; i++) {
+
+		if (isFiltered(pDriverObject, devices[i])) {
+			count++;
+		}
+
+	}
+
+	return count;
+}
+
+
+// The communication device is the only device of the driver without an extension.
+static PDEVICE_OBJECT getComDevice(PDRIVER_OBJECT pDriverObject) {
+
+	for (PDEVICE_OBJECT pCurDevice = pDriverObject->DeviceObject; pCurDevice; pCurDevice = pCurDevice->NextDevice) {
+
+		if (!pCurDevice->DeviceExtension) return pCurDevice;
+
+	}
+
+	return NULL;
+}
+
+
+static ULONG getSourceCount(PDRIVER_OBJECT pDriverObject) {
+	RtlZeroMemory(&sourceList, sizeof(sourceList));
+	CHECK_STATUS(sendRequest(getComDevice(pDriverObject), IRP_MJ_DEVICE_CONTROL, 0, IOCTL_GET_SOURCES, &sourceList, 0, sizeof(sourceList)), STATUS_SUCCESS);
+
+	return sourceList.count;
+}
+
+
+// Takes a sequence number of every source, so the sum grows by the number of sources with every call.
+static ULONGLONG takeSequences(PDRIVER_OBJECT pDriverObject) {
+	ULONGLONG sum = 0;
+	getSourceCount(pDriverObject);
+
+	for (ULONG i = 0; i < sourceList.count; i++) {
+		sum += takeSequence(sourceList.sources[i].id);
+	}
+
+	return sum;
+}
+
+
+static void unloadRoutine(PVOID pStartContext) {
+	unloadDriver((PDRIVER_OBJECT)pStartContext);
+
+	return;
+}
+
+
+// The unload routine waits for the reads pending in the filter devices, so input is sent until it returns.
+// The raw input thread stops reading first, since filter devices that are detached fail new reads.
+static void unloadWithInput(PDRIVER_OBJECT pDriverObject) {
+	setReading(FALSE);
+	PKTHREAD pUnloadThread = NULL;
+	CHECK_STATUS(createThread(unloadRoutine, pDriverObject, &pUnloadThread), STATUS_SUCCESS);
+
+	if (!pUnloadThread) return;
+
+	LARGE_INTEGER zeroTimeout = { .QuadPart = 0 };
+
+	while (KeWaitForSingleObject(pUnloadThread, Executive, KernelMode, FALSE, &zeroTimeout) == STATUS_TIMEOUT) {
+
+		for (ULONG i = 0; i < deviceCount; i++) {
+			sendInput(devices[i], 1);
+		}
+
+		sched_yield();
+	}
+
+	ObfDereferenceObject(pUnloadThread);
+	setReading(TRUE);
+
+	return;
+}
+
+
+static void checkTeardown() {
+	SimCounters simCounters = { 0 };
+	getSimCounters(&simCounters);
+	CHECK(!simCounters.devices);
+	CHECK(!simCounters.irps);
+	CHECK(!simCounters.references);
+	CHECK(!simCounters.allocations);
+	CHECK(!simCounters.corruptedInput);
+	CHECK(!simCounters.unmarkedReads);
+
+	return;
+}
+
+
+static void testLoad() {
+	addDevices(4, 4);
+	PDRIVER_OBJECT pDriverObject = NULL;
+	CHECK_STATUS(loadDriver(&pDriverObject), STATUS_SUCCESS);
+
+	if (!pDriverObject) return;
+
+	CHECK(countFiltered(pDriverObject) == deviceCount);
+	CHECK(getSourceCount(pDriverObject) == deviceCount);
+	// the first reads were sent before the filter devices were attached
+	sendInputRound(2);
+	sendInputRound(SIM_READ_LENGTH);
+	unloadWithInput(pDriverObject);
+
+	for (ULONG i = 0; i < deviceCount; i++) {
+		CHECK(IoGetAttachedDevice(devices[i]) == devices[i]);
+	}
+
+	removeDevices();
+	checkTeardown();
+
+	return;
+}
+
+
+static void testPassThrough() {
+	PDRIVER_OBJECT pDriverObject = NULL;
+	CHECK_STATUS(loadDriver(&pDriverObject), STATUS_SUCCESS);
+
+	if (!pDriverObject) return;
+
+	addDevices(1, 1);
+	CHECK(countFiltered(pDriverObject) == deviceCount);
+
+	for (ULONG i = 0; i < deviceCount; i++) {
+
+		for (UCHAR major = 0; major <= IRP_MJ_MAXIMUM_FUNCTION; major++) {
+
+			// reads stay pending and removals delete the device
+			if (major == IRP_MJ_READ || major == IRP_MJ_PNP) continue;
+
+			const ULONG received = getReceivedRequests(devices[i], major);
+			// IO control codes of the driver are meant for the communication device
+			CHECK_STATUS(sendRequest(devices[i], major, 0, IOCTL_SEND_LOG_STATE, NULL, 0, 0), STATUS_SUCCESS);
+			CHECK(getReceivedRequests(devices[i], major) == received + 1);
+		}
+
+		const ULONG received = getReceivedRequests(devices[i], IRP_MJ_PNP);
+		CHECK_STATUS(sendRequest(devices[i], IRP_MJ_PNP, IRP_MN_START_DEVICE, 0, NULL, 0, 0), STATUS_SUCCESS);
+		CHECK(getReceivedRequests(devices[i], IRP_MJ_PNP) == received + 1);
+	}
+
+	const PDEVICE_OBJECT pComDevice = getComDevice(pDriverObject);
+	CHECK_STATUS(sendRequest(pComDevice, IRP_MJ_CREATE, 0, 0, NULL, 0, 0), STATUS_SUCCESS);
+	CHECK_STATUS(sendRequest(pComDevice, IRP_MJ_READ, 0, 0, NULL, 0, 0), STATUS_INVALID_DEVICE_REQUEST);
+	BOOLEAN isLogging = TRUE;
+	CHECK_STATUS(sendRequest(pComDevice, IRP_MJ_DEVICE_CONTROL, 0, IOCTL_SEND_LOG_STATE, &isLogging, 0, sizeof(isLogging)), STATUS_SUCCESS);
+	CHECK(!isLogging);
+	CHECK_STATUS(sendRequest(pComDevice, IRP_MJ_CLEANUP, 0, 0, NULL, 0, 0), STATUS_SUCCESS);
+	CHECK_STATUS(sendRequest(pComDevice, IRP_MJ_CLOSE, 0, 0, NULL, 0, 0), STATUS_SUCCESS);
+	sendInputRound(1);
+	unloadWithInput(pDriverObject);
+	removeDevices();
+	checkTeardown();
+
+	return;
+}
+
+
+// Gets the ID of the source of the list that is not in the current source table.
+static USHORT findRemovedSource(PDRIVER_OBJECT pDriverObject, const SourceList* pBefore) {
+	getSourceCount(pDriverObject);
+
+	for (ULONG i = 0; i < pBefore->count; i++) {
+		BOOLEAN isFound = FALSE;
+
+		for (ULONG j = 0; j < sourceList.count; j++) {
+			isFound |= sourceList.sources[j].id == pBefore->sources[i].id;
+		}
+
+		if (!isFound) return pBefore->sources[i].id;
+
+	}
+
+	return MAX_SOURCES;
+}
+
+
+// A device that existed when the driver was loaded and devices that arrive later are attached. A removed device has a read pending in its class device,
+// which holds the remove lock of its filter device. The removal only returns after the class device failed the read and the remove lock was drained.
+// The next arriving device gets the ID of the removed one and continues its sequence numbers.
+static void testRemoval() {
+	addDevices(1, 0);
+	PDRIVER_OBJECT pDriverObject = NULL;
+	CHECK_STATUS(loadDriver(&pDriverObject), STATUS_SUCCESS);
+
+	if (!pDriverObject) return;
+
+	addDevices(1, 1);
+	CHECK(countFiltered(pDriverObject) == 3);
+	CHECK(getSourceCount(pDriverObject) == 3);
+	sendInputRound(1);
+	sourcesBefore = sourceList;
+	const ULONGLONG sequencesBefore = takeSequences(pDriverObject);
+
+	SimCounters before = { 0 };
+	getSimCounters(&before);
+	const PDEVICE_OBJECT pRemovedDevice = devices[1];
+	devices[1] = devices[--deviceCount];
+	removeClassDevice(pRemovedDevice);
+	SimCounters after = { 0 };
+	getSimCounters(&after);
+	CHECK(after.failedReads - before.failedReads == 1);
+	CHECK(after.devices == before.devices - 2);
+	CHECK(countFiltered(pDriverObject) == 2);
+	CHECK(getSourceCount(pDriverObject) == 2);
+	const USHORT removedId = findRemovedSource(pDriverObject, &sourcesBefore);
+	CHECK(removedId < MAX_SOURCES);
+	sendInputRound(1);
+
+	addDevices(0, 1);
+	CHECK(countFiltered(pDriverObject) == 3);
+	CHECK(getSourceCount(pDriverObject) == 3);
+	CHECK(findRemovedSource(pDriverObject, &sourcesBefore) == MAX_SOURCES);
+	// every source took one sequence number before, the new device continues after the one taken by the removed device
+	CHECK(takeSequences(pDriverObject) == sequencesBefore + 3);
+	sendInputRound(1);
+	unloadWithInput(pDriverObject);
+	removeDevices();
+	checkTeardown();
+
+	return;
+}
+
+
+// Class devices are removed while the unload routine waits for the reads pending in their filter devices, which only the removals complete.
+// Every filter device is deleted exactly once, either by the removal of its class device or by the unload.
+static void testRemovalDuringUnload() {
+	addDevices(2, 2);
+	PDRIVER_OBJECT pDriverObject = NULL;
+	CHECK_STATUS(loadDriver(&pDriverObject), STATUS_SUCCESS);
+
+	if (!pDriverObject) return;
+
+	sendInputRound(1);
+	setReading(FALSE);
+	PKTHREAD pUnloadThread = NULL;
+	CHECK_STATUS(createThread(unloadRoutine, pDriverObject, &pUnloadThread), STATUS_SUCCESS);
+
+	if (!pUnloadThread) return;
+
+	usleep(UNLOAD_DELAY);
+	removeDevices();
+	CHECK_STATUS(KeWaitForSingleObject(pUnloadThread, Executive, KernelMode, FALSE, NULL), STATUS_SUCCESS);
+	ObfDereferenceObject(pUnloadThread);
+	setReading(TRUE);
+	checkTeardown();
+
+	return;
+}
+
+
+static void testLogging() {
+	PDRIVER_OBJECT pDriverObject = NULL;
+	CHECK_STATUS(loadDriver(&pDriverObject), STATUS_SUCCESS);
+
+	if (!pDriverObject) return;
+
+	addDevices(2, 2);
+	const PDEVICE_OBJECT pComDevice = getComDevice(pDriverObject);
+	// skipped reads are traced as warnings
+	TraceConfig traceConfig = { TRACE_WARNING, TRACE_CAT_QUEUE };
+	CHECK_STATUS(sendRequest(pComDevice, IRP_MJ_DEVICE_CONTROL, 0, IOCTL_SET_TRACE, &traceConfig, sizeof(traceConfig), 0), STATUS_SUCCESS);
+	LogConfig logConfig = { 0 };
+	CHECK_STATUS(sendRequest(pComDevice, IRP_MJ_DEVICE_CONTROL, 0, IOCTL_LOG_START, &logConfig, sizeof(logConfig), 0), STATUS_SUCCESS);
+	const ULONGLONG loggedBefore = getLoggedEntries(LOG_KBD) + getLoggedEntries(LOG_MOU);
+	// reads sent before logging started are passed through without taking sequence numbers
+	sendInputRound(1);
+	const ULONGLONG sequencesBefore = takeSequences(pDriverObject);
+	ULONG sent = 0;
+
+	// every device has its own read semaphore, so the pending reads of several keyboards and mice are all logged
+	for (int i = 0; i < 0x40; i++) {
+		sent += sendInputRound(1 + i % SIM_READ_LENGTH);
+	}
+
+	CHECK(takeSequences(pDriverObject) - sequencesBefore - deviceCount == sent);
+	CHECK(!countTraceRecords(pComDevice, TRACE_POINT_READ_SKIPPED));
+	CHECK_STATUS(sendRequest(pComDevice, IRP_MJ_DEVICE_CONTROL, 0, IOCTL_LOG_STOP, NULL, 0, 0), STATUS_SUCCESS);
+	const ULONGLONG logged = getLoggedEntries(LOG_KBD) + getLoggedEntries(LOG_MOU) - loggedBefore;
+	// the queues drop input that does not fit at DISPATCH_LEVEL
+	CHECK(logged && logged <= sent + deviceCount);
+	sendInputRound(1);
+	unloadWithInput(pDriverObject);
+	removeDevices();
+	checkTeardown();
+
+	return;
+}
+
+
+// Keys that are held when a compact log is stopped are logged by the stop, although their presses were absorbed by the compaction.
+static void testCompactStop() {
+	PDRIVER_OBJECT pDriverObject = NULL;
+	CHECK_STATUS(loadDriver(&pDriverObject), STATUS_SUCCESS);
+
+	if (!pDriverObject) return;
+
+	addDevices(3, 0);
+	const PDEVICE_OBJECT pComDevice = getComDevice(pDriverObject);
+	LogConfig logConfig = { 0 };
+	logConfig.flags = LOG_FLAG_COMPACT;
+	CHECK_STATUS(sendRequest(pComDevice, IRP_MJ_DEVICE_CONTROL, 0, IOCTL_LOG_START, &logConfig, sizeof(logConfig), 0), STATUS_SUCCESS);
+	const ULONGLONG loggedBefore = getLoggedEntries(LOG_KBD);
+	// every keyboard presses its key, then releases it and presses it again
+	sendInputRound(1);
+	sendInputRound(2);
+	CHECK_STATUS(sendRequest(pComDevice, IRP_MJ_DEVICE_CONTROL, 0, IOCTL_LOG_STOP, NULL, 0, 0), STATUS_SUCCESS);
+	CHECK(getLoggedEntries(LOG_KBD) - loggedBefore == 2 * deviceCount);
+	unloadWithInput(pDriverObject);
+	removeDevices();
+	checkTeardown();
+
+	return;
+}
+
+
+// A session can only be started while no other session is running, also if it only aggregates statistics.
+static void testSessions() {
+	PDRIVER_OBJECT pDriverObject = NULL;
+	CHECK_STATUS(loadDriver(&pDriverObject), STATUS_SUCCESS);
+
+	if (!pDriverObject) return;
+
+	const PDEVICE_OBJECT pComDevice = getComDevice(pDriverObject);
+	LogConfig logConfig = { 0 };
+	CHECK_STATUS(sendRequest(pComDevice, IRP_MJ_DEVICE_CONTROL, 0, IOCTL_LOG_START, &logConfig, sizeof(logConfig), 0), STATUS_SUCCESS);
+	CHECK_STATUS(sendRequest(pComDevice, IRP_MJ_DEVICE_CONTROL, 0, IOCTL_LOG_START, &logConfig, sizeof(logConfig), 0), STATUS_DEVICE_BUSY);
+	CHECK_STATUS(sendRequest(pComDevice, IRP_MJ_DEVICE_CONTROL, 0, IOCTL_LOG_STOP, NULL, 0, 0), STATUS_SUCCESS);
+
+	logConfig.flags = LOG_FLAG_AGGREGATE;
+	CHECK_STATUS(sendRequest(pComDevice, IRP_MJ_DEVICE_CONTROL, 0, IOCTL_LOG_START, &logConfig, sizeof(logConfig), 0), STATUS_SUCCESS);
+	logConfig.flags = 0;
+	CHECK_STATUS(sendRequest(pComDevice, IRP_MJ_DEVICE_CONTROL, 0, IOCTL_LOG_START, &logConfig, sizeof(logConfig), 0), STATUS_DEVICE_BUSY);
+	CHECK_STATUS(sendRequest(pComDevice, IRP_MJ_DEVICE_CONTROL, 0, IOCTL_LOG_STOP, NULL, 0, 0), STATUS_SUCCESS);
+	CHECK(!pStatsThread);
+
+	CHECK_STATUS(sendRequest(pComDevice, IRP_MJ_DEVICE_CONTROL, 0, IOCTL_LOG_START, &logConfig, sizeof(logConfig), 0), STATUS_SUCCESS);
+	CHECK_STATUS(sendRequest(pComDevice, IRP_MJ_DEVICE_CONTROL, 0, IOCTL_LOG_STOP, NULL, 0, 0), STATUS_SUCCESS);
+	unloadWithInput(pDriverObject);
+	checkTeardown();
+
+	return;
+}
+
+
+// Hundreds of devices arrive and leave while the driver is loaded, until the source table is full.
+static void testHotplug() {
+	PDRIVER_OBJECT pDriverObject = NULL;
+	CHECK_STATUS(loadDriver(&pDriverObject), STATUS_SUCCESS);
+
+	if (!pDriverObject) return;
+
+	long long start = getNanoseconds();
+	addDevices(KBD_DEVICES, MOU_DEVICES);
+	const long long arrival = (getNanoseconds() - start) / deviceCount;
+	CHECK(countFiltered(pDriverObject) == deviceCount);
+	CHECK(getSourceCount(pDriverObject) == MAX_SOURCES);
+	sendInputRound(1);
+
+	// a device beyond the source table is passed by, but its input still arrives
+	addDevices(1, 0);
+	const PDEVICE_OBJECT pPassedDevice = devices[deviceCount - 1];
+	CHECK(!isFiltered(pDriverObject, pPassedDevice));
+	sendInputRound(SIM_READ_LENGTH);
+
+	// every other device leaves and its filter device and source go with it
+	ULONG keptCount = 0;
+
+	for (ULONG i = 0; i < deviceCount; i++) {
+
+		if (i % 2 && devices[i] != pPassedDevice) {
+			removeClassDevice(devices[i]);
+		}
+		else {
+			devices[keptCount++] = devices[i];
+		}
+
+	}
+
+	deviceCount = keptCount;
+	CHECK(getSourceCount(pDriverObject) == MAX_SOURCES / 2);
+	sendInputRound(1);
+
+	// the passed device is attached with the next arrival
+	start = getNanoseconds();
+	addDevices(KBD_DEVICES / 2, MOU_DEVICES / 2);
+	const long long reuse = (getNanoseconds() - start) / ((KBD_DEVICES + MOU_DEVICES) / 2);
+	CHECK(getSourceCount(pDriverObject) == MAX_SOURCES);
+	CHECK(countFiltered(pDriverObject) == MAX_SOURCES);
+	sendInputRound(2);
+	unloadWithInput(pDriverObject);
+	removeDevices();
+	checkTeardown();
+	printf("Arrival: %lld ns per device, %lld ns with reused sources\n", arrival, reuse);
+
+	return;
+}
+
+
+// IOCTL_INJECT_INPUT reads the configuration from the system buffer and writes the report to it.
+typedef union InjectBuffer {
+	InjectConfig config;
+	InjectReport report;
+}InjectBuffer;
+
+static NTSTATUS sendInjection(PDEVICE_OBJECT pComDevice, const InjectConfig* pConfig, InjectReport* pReport) {
+	InjectBuffer injectBuffer = { .config = *pConfig };
+	const NTSTATUS ntStatus = sendRequest(pComDevice, IRP_MJ_DEVICE_CONTROL, 0, IOCTL_INJECT_INPUT, &injectBuffer, sizeof(InjectConfig), sizeof(InjectReport));
+	*pReport = injectBuffer.report;
+
+	return ntStatus;
+}
+
+
+// Injected input takes the path of real input to the logging threads under a source of its own.
+static void testInjection() {
+	PDRIVER_OBJECT pDriverObject = NULL;
+	CHECK_STATUS(loadDriver(&pDriverObject), STATUS_SUCCESS);
+
+	if (!pDriverObject) return;
+
+	addDevices(1, 1);
+	const PDEVICE_OBJECT pComDevice = getComDevice(pDriverObject);
+	const ULONG sourceCount = getSourceCount(pDriverObject);
+	InjectConfig config = { INJECTED_INPUT, INJECTED_INPUT, 0, 0x10 };
+	InjectReport report = { 0 };
+	// input is only injected into running sessions without shared compaction state
+	CHECK_STATUS(sendInjection(pComDevice, &config, &report), STATUS_INVALID_DEVICE_STATE);
+	LogConfig logConfig = { .flags = LOG_FLAG_COMPACT };
+	CHECK_STATUS(sendRequest(pComDevice, IRP_MJ_DEVICE_CONTROL, 0, IOCTL_LOG_START, &logConfig, sizeof(logConfig), 0), STATUS_SUCCESS);
+	CHECK_STATUS(sendInjection(pComDevice, &config, &report), STATUS_INVALID_DEVICE_STATE);
+	CHECK_STATUS(sendRequest(pComDevice, IRP_MJ_DEVICE_CONTROL, 0, IOCTL_LOG_STOP, NULL, 0, 0), STATUS_SUCCESS);
+
+	logConfig.flags = 0;
+	CHECK_STATUS(sendRequest(pComDevice, IRP_MJ_DEVICE_CONTROL, 0, IOCTL_LOG_START, &logConfig, sizeof(logConfig), 0), STATUS_SUCCESS);
+	const ULONGLONG loggedBefore = getLoggedEntries(LOG_KBD) + getLoggedEntries(LOG_MOU);
+	CHECK_STATUS(sendInjection(pComDevice, &config, &report), STATUS_SUCCESS);
+	CHECK(report.generated == 2 * INJECTED_INPUT && report.queued + report.dropped == report.generated);
+	// the logging threads take the input while it is injected
+	CHECK(report.queued && report.drainTime >= report.injectTime);
+	const ULONGLONG queued = report.queued;
+	const ULONG unpacedRate = report.achievedRate;
+
+	// the rate is kept on average, so it is not exceeded over the whole injection
+	config.mouCount = 0;
+	config.rate = INJECT_RATE;
+	config.batch = 1;
+	CHECK_STATUS(sendInjection(pComDevice, &config, &report), STATUS_SUCCESS);
+	CHECK(report.generated == INJECTED_INPUT);
+	CHECK(report.injectTime >= (INJECTED_INPUT - 1) * 10000000ull / INJECT_RATE);
+	CHECK(report.achievedRate <= INJECTED_INPUT * 10000000ull / ((INJECTED_INPUT - 1) * 10000000ull / INJECT_RATE));
+
+	CHECK_STATUS(sendRequest(pComDevice, IRP_MJ_DEVICE_CONTROL, 0, IOCTL_LOG_STOP, NULL, 0, 0), STATUS_SUCCESS);
+	// the class devices did not send input, so all logged input was injected
+	CHECK(getLoggedEntries(LOG_KBD) + getLoggedEntries(LOG_MOU) - loggedBefore == queued + report.queued);
+	// the source of the injected input is removed afterwards
+	CHECK(getSourceCount(pDriverObject) == sourceCount);
+	unloadWithInput(pDriverObject);
+	removeDevices();
+	checkTeardown();
+	printf("Inject: %lu input events per second\n", (unsigned long)unpacedRate);
+
+	return;
+}
+
+
+static long long timeReads() {
+	const long long start = getNanoseconds();
+
+	for (ULONG i = 0; i < TIMED_READS; i++) {
+		sendInput(devices[i % deviceCount], 1);
+	}
+
+	return (getNanoseconds() - start) / TIMED_READS;
+}
+
+
+// Cost of attaching to existing devices and of forwarding a read through a stack with and without the filter device.
+// One device more than the source table holds is passed by without failing the driver.
+static void testCost() {
+	addDevices(KBD_DEVICES, MOU_DEVICES + 1);
+	const long long unfiltered = timeReads();
+	PDRIVER_OBJECT pDriverObject = NULL;
+	const long long start = getNanoseconds();
+	CHECK_STATUS(loadDriver(&pDriverObject), STATUS_SUCCESS);
+	const long long setup = (getNanoseconds() - start) / deviceCount;
+
+	if (!pDriverObject) return;
+
+	CHECK(countFiltered(pDriverObject) == MAX_SOURCES);
+	sendInputRound(1);
+	const long long filtered = timeReads();
+	const PDEVICE_OBJECT pComDevice = getComDevice(pDriverObject);
+	LogConfig logConfig = { 0 };
+	CHECK_STATUS(sendRequest(pComDevice, IRP_MJ_DEVICE_CONTROL, 0, IOCTL_LOG_START, &logConfig, sizeof(logConfig), 0), STATUS_SUCCESS);
+	sendInputRound(1);
+	const long long logging = timeReads();
+	CHECK_STATUS(sendRequest(pComDevice, IRP_MJ_DEVICE_CONTROL, 0, IOCTL_LOG_STOP, NULL, 0, 0), STATUS_SUCCESS);
+	unloadWithInput(pDriverObject);
+	removeDevices();
+	checkTeardown();
+	printf("Setup: %lld ns per device in DriverEntry\n", setup);
+	printf("Read: %lld ns without filter, %lld ns filtered, %lld ns logging\n", unfiltered, filtered, logging);
+
+	return;
+}
+
+
+int main() {
+	// a hang fails the test instead of blocking the test run
+	alarm(120);
+	initSimulation();
+
+	RUN_TEST(testLoad);
+	RUN_TEST(testPassThrough);
+	RUN_TEST(testRemoval);
+	RUN_TEST(testRemovalDuringUnload);
+	RUN_TEST(testLogging);
+	RUN_TEST(testCompactStop);
+	RUN_TEST(testSessions);
+	RUN_TEST(testHotplug);
+	RUN_TEST(testInjection);
+	RUN_TEST(testCost);
+
+	return failedChecks ? EXIT_FAILURE : EXIT_SUCCESS;
+}
\ No newline at end of file
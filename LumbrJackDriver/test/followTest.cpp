@@ -0,0 +1,261 @@
+extern "C" {
+#include "../src/format.h"
+#include "../src/lz.h"
+#include "test.h"
+}
+#include "follow.h"
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+// Follow mode of the client (follow.h): logs that are appended to, also with partial records and lines, truncated, overwritten in place
+// and rotated are followed across updates and runs, and failed updates and saves report the reason of the system.
+
+namespace {
+
+    constexpr const char* LOG_PATH = "follow.bin";
+    constexpr const char* ROTATED_PATH = "follow.bin.1";
+    constexpr const char* TEXT_PATH = "follow.log";
+    constexpr const char* COMPRESSED_PATH = "follow.lz";
+    constexpr const char* DIRECTORY_PATH = "follow.dir";
+    constexpr const char* MISSING_PATH = "follow.missing/follow.bin";
+    constexpr uint32_t TIME_DELTA = 1000;
+
+    // Keyboard record with the sequence number and a make code derived from it.
+    std::string makeRecord(uint64_t sequence) {
+        InputRecord record{};
+        record.type = RECORD_TYPE_KBD;
+        record.timeDelta = TIME_DELTA;
+        record.source = 1;
+        record.sequence = sequence;
+        record.kbd.makeCode = static_cast<uint16_t>(0x10 + sequence % 0x20);
+        record.kbd.flags = KEY_MAKE;
+
+        return std::string(reinterpret_cast<const char*>(&record), sizeof(record));
+    }
+
+
+    // Records with the sequence numbers from first to first + count - 1, after a header that starts at the given time.
+    std::string makeLog(uint64_t startTime, uint64_t first, size_t count) {
+        RecordFileHeader header{};
+        header.magic = RECORD_MAGIC;
+        header.version = RECORD_VERSION;
+        header.headerSize = sizeof(RecordFileHeader);
+        header.recordSize = sizeof(InputRecord);
+        header.timeResolution = RECORD_TIME_RESOLUTION;
+        header.startTime = startTime;
+        std::string data(reinterpret_cast<const char*>(&header), sizeof(header));
+
+        for (size_t i = 0; i < count; i++) {
+            data += makeRecord(first + i);
+        }
+
+        return data;
+    }
+
+
+    // Writes the data in place of the file or appends it. A truncated file keeps its identity.
+    void write(const char* path, const std::string& data, bool isAppended) {
+        std::ofstream file(path, std::ios::binary | (isAppended ? std::ios::app : std::ios::trunc));
+        file.write(data.data(), static_cast<std::streamsize>(data.size()));
+
+        return;
+    }
+
+
+    // Updates a follower whose file changed and returns the sequence numbers of the events.
+    std::vector<uint64_t> update(follow::Follower* pFollower, follow::Update* pUpdate) {
+        CHECK(follow::hasChanged(pFollower));
+        CHECK(follow::update(pFollower, pUpdate));
+        CHECK(pFollower->lastFailure == follow::NO_FAILURE);
+        std::vector<uint64_t> sequences;
+
+        for (const parser::Event& event : pUpdate->events) {
+            sequences.push_back(event.sequence);
+        }
+
+        return sequences;
+    }
+
+
+    std::vector<uint64_t> makeSequences(uint64_t first, size_t count) {
+        std::vector<uint64_t> sequences;
+
+        for (size_t i = 0; i < count; i++) {
+            sequences.push_back(first + i);
+        }
+
+        return sequences;
+    }
+
+
+    void removeFiles() {
+
+        for (const char* path : { LOG_PATH, ROTATED_PATH, TEXT_PATH, COMPRESSED_PATH }) {
+            std::remove(path);
+            std::remove(follow::getCheckpointPath(path).c_str());
+        }
+
+        rmdir(DIRECTORY_PATH);
+
+        return;
+    }
+
+
+    // Data appended in parts is parsed up to the last complete record or line, and a follower continues at its saved checkpoint.
+    void testAppend() {
+        removeFiles();
+        follow::Follower follower{};
+        follow::open(&follower, LOG_PATH, true);
+        follow::Update update{};
+
+        // the file is not created yet
+        CHECK(!follow::hasChanged(&follower));
+        CHECK(follow::update(&follower, &update) && update.events.empty());
+
+        write(LOG_PATH, makeLog(0, 0, 10), false);
+        CHECK(::update(&follower, &update) == makeSequences(0, 10) && !update.isReset);
+        CHECK(!follow::hasChanged(&follower));
+
+        // half of a record is parsed with its second half
+        const std::string record = makeRecord(15);
+        write(LOG_PATH, makeLog(0, 10, 5).substr(sizeof(RecordFileHeader)) + record.substr(0, 16), true);
+        CHECK(::update(&follower, &update) == makeSequences(10, 5));
+        CHECK(follower.checkpoint.offset == sizeof(RecordFileHeader) + 15 * sizeof(InputRecord));
+        write(LOG_PATH, record.substr(16) + makeLog(0, 16, 4).substr(sizeof(RecordFileHeader)), true);
+        CHECK(::update(&follower, &update) == makeSequences(15, 5));
+        const uint64_t lastTime = update.events.back().time;
+        CHECK(lastTime == 20 * TIME_DELTA);
+        CHECK(follow::save(&follower));
+        follow::close(&follower);
+
+        // the next run continues at the checkpoint and with its time
+        write(LOG_PATH, makeLog(0, 20, 3).substr(sizeof(RecordFileHeader)), true);
+        follow::open(&follower, LOG_PATH, false);
+        CHECK(::update(&follower, &update) == makeSequences(20, 3) && !update.isReset);
+        CHECK(update.events.front().time == lastTime + TIME_DELTA);
+        CHECK(follower.checkpoint.eventCount == 23 && follower.checkpoint.resetCount == 0);
+        follow::close(&follower);
+
+        // a partial line of a text log
+        follow::open(&follower, TEXT_PATH, true);
+        write(TEXT_PATH, "K:aSEQ:0SRC:1\nK:bSEQ:", false);
+        CHECK(::update(&follower, &update) == makeSequences(0, 1));
+        write(TEXT_PATH, "1SRC:1\nK:cSEQ:2SRC:1\n", true);
+        CHECK(::update(&follower, &update) == makeSequences(1, 2));
+        follow::close(&follower);
+
+        return;
+    }
+
+
+    // A truncated file is detected by its size and a file overwritten in place with more data by its fingerprint.
+    void testTruncation() {
+        removeFiles();
+        follow::Follower follower{};
+        follow::open(&follower, LOG_PATH, true);
+        follow::Update update{};
+        write(LOG_PATH, makeLog(0, 0, 10), false);
+        CHECK(::update(&follower, &update) == makeSequences(0, 10));
+        const uint64_t fileId = follower.checkpoint.fileId;
+
+        write(LOG_PATH, makeLog(0, 100, 3), false);
+        CHECK(::update(&follower, &update) == makeSequences(100, 3) && update.isReset);
+        CHECK(follower.checkpoint.resetCount == 1);
+
+        // the file is larger than before, only its first record differs
+        write(LOG_PATH, makeLog(0, 200, 5), false);
+        CHECK(::update(&follower, &update) == makeSequences(200, 5) && update.isReset);
+        CHECK(follower.checkpoint.resetCount == 2 && follower.checkpoint.fileId == fileId);
+        CHECK(follower.checkpoint.offset == sizeof(RecordFileHeader) + 5 * sizeof(InputRecord));
+        follow::close(&follower);
+
+        return;
+    }
+
+
+    // A rotated file is detected by its identity and read to its end before the new file. A file rotated while it was not followed is followed from its start.
+    void testRotation() {
+        removeFiles();
+        follow::Follower follower{};
+        follow::open(&follower, LOG_PATH, true);
+        follow::Update update{};
+        write(LOG_PATH, makeLog(0, 0, 5), false);
+        CHECK(::update(&follower, &update) == makeSequences(0, 5));
+        const uint64_t fileId = follower.checkpoint.fileId;
+
+        write(LOG_PATH, makeLog(0, 5, 3).substr(sizeof(RecordFileHeader)), true);
+        CHECK(std::rename(LOG_PATH, ROTATED_PATH) == 0);
+        write(LOG_PATH, makeLog(0, 100, 2), false);
+        std::vector<uint64_t> expected = makeSequences(5, 3);
+        expected.push_back(100);
+        expected.push_back(101);
+        CHECK(::update(&follower, &update) == expected && update.isReset);
+        CHECK(follower.checkpoint.fileId != fileId && follower.checkpoint.resetCount == 1);
+        CHECK(follow::save(&follower));
+        follow::close(&follower);
+
+        write(LOG_PATH, makeLog(0, 102, 1).substr(sizeof(RecordFileHeader)), true);
+        CHECK(std::rename(LOG_PATH, ROTATED_PATH) == 0);
+        write(LOG_PATH, makeLog(0, 300, 2), false);
+        follow::open(&follower, LOG_PATH, false);
+        CHECK(::update(&follower, &update) == makeSequences(300, 2) && update.isReset);
+        CHECK(follower.checkpoint.resetCount == 2);
+        follow::close(&follower);
+
+        return;
+    }
+
+
+    // Failed updates and saves keep their reason and the error of the system, and a later update that succeeds clears them.
+    void testFailures() {
+        removeFiles();
+        follow::Follower follower{};
+        follow::Update update{};
+
+        CHECK(mkdir(DIRECTORY_PATH, 0700) == 0);
+        follow::open(&follower, DIRECTORY_PATH, true);
+        CHECK(!follow::update(&follower, &update));
+        CHECK(follower.lastFailure == follow::READ_FAILED && follower.systemError == EISDIR);
+        CHECK(follow::getFailureMessage(&follower).find("(" + std::to_string(EISDIR) + ")") != std::string::npos);
+        follow::close(&follower);
+
+        std::string data(0x40, '\0');
+        const uint32_t magic = LZ_FILE_MAGIC;
+        data.replace(0, sizeof(magic), reinterpret_cast<const char*>(&magic), sizeof(magic));
+        write(COMPRESSED_PATH, data, false);
+        follow::open(&follower, COMPRESSED_PATH, true);
+        CHECK(!follow::update(&follower, &update));
+        CHECK(follower.lastFailure == follow::UNSUPPORTED_FORMAT && follower.systemError == 0);
+        CHECK(follow::getFailureMessage(&follower).find("compressed") != std::string::npos);
+
+        write(COMPRESSED_PATH, makeLog(0, 0, 2), false);
+        CHECK(::update(&follower, &update) == makeSequences(0, 2));
+        CHECK(follow::getFailureMessage(&follower) == "No failure");
+        follow::close(&follower);
+
+        follow::open(&follower, MISSING_PATH, true);
+        CHECK(!follow::save(&follower));
+        CHECK(follower.lastFailure == follow::SAVE_FAILED && follower.systemError == ENOENT);
+        follow::close(&follower);
+
+        return;
+    }
+
+}
+
+
+int main() {
+    RUN_TEST(testAppend);
+    RUN_TEST(testTruncation);
+    RUN_TEST(testRotation);
+    RUN_TEST(testFailures);
+    removeFiles();
+
+    return failedChecks ? EXIT_FAILURE : EXIT_SUCCESS;
+}
\ No newline at end of file
@@ -0,0 +1,234 @@
+#include "test.h"
+#include "../src/format.h"
+#include <stdlib.h>
+
+// Unit tests of the formatters of the log files.
+
+// Numbered from zero for every test.
+static LineSequences lineSequences;
+
+static KbdDataEntry makeKbdEntry(USHORT makeCode, USHORT flags) {
+	KbdDataEntry entry;
+	RtlZeroMemory(&entry, sizeof(entry));
+	entry.type = LOG_KBD;
+	entry.source = 3;
+	entry.time = 1000;
+	entry.data.MakeCode = makeCode;
+	entry.data.Flags = flags;
+
+	return entry;
+}
+
+
+static MouDataEntry makeMouEntry(USHORT buttonFlags, SHORT buttonData, LONG x, LONG y) {
+	MouDataEntry entry;
+	RtlZeroMemory(&entry, sizeof(entry));
+	entry.type = LOG_MOU;
+	entry.source = 1;
+	entry.time = 1000;
+	entry.data.ButtonFlags = buttonFlags;
+	entry.data.ButtonData = (USHORT)buttonData;
+	entry.data.LastX = x;
+	entry.data.LastY = y;
+
+	return entry;
+}
+
+
+static void testFormatKbd() {
+	char buffer[0x60];
+	RtlZeroMemory(&lineSequences, sizeof(lineSequences));
+	KbdDataEntry entry = makeKbdEntry(0x1E, KEY_MAKE);
+
+	CHECK_STATUS(formatKbd(&entry, &lineSequences, 0, FALSE, buffer, sizeof(buffer)), STATUS_SUCCESS);
+	CHECK_STRING(buffer, "a");
+	CHECK_STATUS(formatKbd(&entry, &lineSequences, LOG_FLAG_UNIFIED, TRUE, buffer, sizeof(buffer)), STATUS_SUCCESS);
+	CHECK_STRING(buffer, "K:aSEQ:0SRC:3\n");
+
+	entry.repeatCount = 4;
+	// 250 ms in 100 ns units
+	entry.holdTime = 2500000;
+	CHECK_STATUS(formatKbd(&entry, &lineSequences, LOG_FLAG_COMPACT, FALSE, buffer, sizeof(buffer)), STATUS_SUCCESS);
+	CHECK_STRING(buffer, "a@HOLD:250REPEAT:4SEQ:0SRC:3\n");
+
+	// breaks and keys without a character are not logged
+	entry = makeKbdEntry(0x1E, KEY_BREAK);
+	CHECK_STATUS(formatKbd(&entry, &lineSequences, 0, FALSE, buffer, sizeof(buffer)), STATUS_SUCCESS);
+	CHECK_STRING(buffer, "");
+	entry = makeKbdEntry(0x3B, KEY_MAKE);
+	CHECK_STATUS(formatKbd(&entry, &lineSequences, 0, FALSE, buffer, sizeof(buffer)), STATUS_SUCCESS);
+	CHECK_STRING(buffer, "");
+	entry = makeKbdEntry(0x80, KEY_MAKE);
+	CHECK_STATUS(formatKbd(&entry, &lineSequences, 0, FALSE, buffer, sizeof(buffer)), STATUS_SUCCESS);
+	CHECK_STRING(buffer, "");
+
+	// truncated strings are terminated
+	entry = makeKbdEntry(0x1E, KEY_MAKE);
+	entry.sequence = 3;
+	CHECK_STATUS(formatKbd(&entry, &lineSequences, 0, TRUE, buffer, 4), STATUS_BUFFER_OVERFLOW);
+	CHECK_STRING(buffer, "K:a");
+
+	return;
+}
+
+
+static void testFormatMou() {
+	char buffer[0x100];
+	RtlZeroMemory(&lineSequences, sizeof(lineSequences));
+	MouDataEntry entry = makeMouEntry(MOUSE_LEFT_BUTTON_DOWN | MOUSE_BUTTON_5_DOWN, 0, 10, -5);
+
+	CHECK_STATUS(formatMou(&entry, &lineSequences, 0, FALSE, buffer, sizeof(buffer)), STATUS_SUCCESS);
+	CHECK_STRING(buffer, "LEFT@X:10Y:-5SEQ:0SRC:1\nX2@X:10Y:-5SEQ:0SRC:1\n");
+	CHECK_STATUS(formatMou(&entry, &lineSequences, LOG_FLAG_UNIFIED, TRUE, buffer, sizeof(buffer)), STATUS_SUCCESS);
+	CHECK_STRING(buffer, "M:LEFT@X:10Y:-5SEQ:0SRC:1\nM:X2@X:10Y:-5SEQ:0SRC:1\n");
+
+	entry = makeMouEntry(MOUSE_WHEEL, -120, 0, 0);
+	CHECK_STATUS(formatMou(&entry, &lineSequences, 0, FALSE, buffer, sizeof(buffer)), STATUS_SUCCESS);
+	CHECK_STRING(buffer, "WHEEL:-120SEQ:0SRC:1\n");
+	entry = makeMouEntry(MOUSE_HWHEEL, 240, 0, 0);
+	CHECK_STATUS(formatMou(&entry, &lineSequences, 0, FALSE, buffer, sizeof(buffer)), STATUS_SUCCESS);
+	CHECK_STRING(buffer, "HWHEEL:240SEQ:0SRC:1\n");
+
+	// releases are not logged
+	entry = makeMouEntry(MOUSE_LEFT_BUTTON_UP, 0, 10, -5);
+	CHECK_STATUS(formatMou(&entry, &lineSequences, 0, FALSE, buffer, sizeof(buffer)), STATUS_SUCCESS);
+	CHECK_STRING(buffer, "");
+
+	// movement is only logged with motion
+	entry = makeMouEntry(0, 0, 3, 4);
+	entry.sequence = 2;
+	CHECK_STATUS(formatMou(&entry, &lineSequences, 0, FALSE, buffer, sizeof(buffer)), STATUS_SUCCESS);
+	CHECK_STRING(buffer, "");
+	CHECK_STATUS(formatMou(&entry, &lineSequences, LOG_FLAG_MOTION, FALSE, buffer, sizeof(buffer)), STATUS_SUCCESS);
+	CHECK_STRING(buffer, "MOVE@X:3Y:4SEQ:0SRC:1\n");
+	entry.data.Flags = MOUSE_MOVE_ABSOLUTE;
+	entry.data.LastX = 0;
+	entry.data.LastY = 0;
+	CHECK_STATUS(formatMou(&entry, &lineSequences, LOG_FLAG_MOTION, FALSE, buffer, sizeof(buffer)), STATUS_SUCCESS);
+	CHECK_STRING(buffer, "POS@X:0Y:0SEQ:0SRC:1\n");
+
+	return;
+}
+
+
+// Input without lines does not leave a gap in the sequence numbers of the lines, input that never reached the log does.
+static void testLineSequences() {
+	char buffer[0x100];
+	RtlZeroMemory(&lineSequences, sizeof(lineSequences));
+	KbdDataEntry kbdEntry = makeKbdEntry(0x1E, KEY_MAKE);
+	MouDataEntry mouEntry = makeMouEntry(MOUSE_LEFT_BUTTON_DOWN, 0, 1, 2);
+
+	CHECK_STATUS(formatKbd(&kbdEntry, &lineSequences, 0, TRUE, buffer, sizeof(buffer)), STATUS_SUCCESS);
+	CHECK_STRING(buffer, "K:aSEQ:0SRC:3\n");
+	kbdEntry.sequence = 1;
+	kbdEntry.data.Flags = KEY_BREAK;
+	CHECK_STATUS(formatKbd(&kbdEntry, &lineSequences, 0, TRUE, buffer, sizeof(buffer)), STATUS_SUCCESS);
+	CHECK_STRING(buffer, "");
+	kbdEntry.sequence = 2;
+	kbdEntry.data.Flags = KEY_MAKE;
+	CHECK_STATUS(formatKbd(&kbdEntry, &lineSequences, 0, TRUE, buffer, sizeof(buffer)), STATUS_SUCCESS);
+	CHECK_STRING(buffer, "K:aSEQ:1SRC:3\n");
+
+	// the input with sequence number 3 was lost
+	kbdEntry.sequence = 4;
+	CHECK_STATUS(formatKbd(&kbdEntry, &lineSequences, 0, TRUE, buffer, sizeof(buffer)), STATUS_SUCCESS);
+	CHECK_STRING(buffer, "K:aSEQ:3SRC:3\n");
+
+	// sources are numbered on their own
+	CHECK_STATUS(formatMou(&mouEntry, &lineSequences, 0, TRUE, buffer, sizeof(buffer)), STATUS_SUCCESS);
+	CHECK_STRING(buffer, "M:LEFT@X:1Y:2SEQ:0SRC:1\n");
+	mouEntry.sequence = 1;
+	mouEntry.data.ButtonFlags = MOUSE_LEFT_BUTTON_UP;
+	CHECK_STATUS(formatMou(&mouEntry, &lineSequences, 0, TRUE, buffer, sizeof(buffer)), STATUS_SUCCESS);
+	CHECK_STRING(buffer, "");
+	mouEntry.sequence = 2;
+	mouEntry.data.ButtonFlags = MOUSE_RIGHT_BUTTON_DOWN | MOUSE_WHEEL;
+	mouEntry.data.ButtonData = 120;
+	CHECK_STATUS(formatMou(&mouEntry, &lineSequences, 0, TRUE, buffer, sizeof(buffer)), STATUS_SUCCESS);
+	CHECK_STRING(buffer, "M:RIGHT@X:1Y:2SEQ:1SRC:1\nM:WHEEL:120SEQ:1SRC:1\n");
+
+	// input that could not be formatted is lost
+	kbdEntry.sequence = 5;
+	CHECK_STATUS(formatKbd(&kbdEntry, &lineSequences, 0, TRUE, buffer, 4), STATUS_BUFFER_OVERFLOW);
+	kbdEntry.sequence = 6;
+	CHECK_STATUS(formatKbd(&kbdEntry, &lineSequences, 0, TRUE, buffer, sizeof(buffer)), STATUS_SUCCESS);
+	CHECK_STRING(buffer, "K:aSEQ:5SRC:3\n");
+
+	return;
+}
+
+
+static void testFormatKbdRaw() {
+	UCHAR buffer[KBD_RAW_MAX_SIZE];
+	KbdDataEntry entry = makeKbdEntry(0x1E, KEY_MAKE);
+
+	CHECK(formatKbdRaw(&entry, 0, buffer) == 1 && buffer[0] == 0x1E);
+	entry.data.Flags = KEY_BREAK;
+	CHECK(formatKbdRaw(&entry, 0, buffer) == 1 && buffer[0] == 0x9E);
+	entry.data.Flags = KEY_E0 | KEY_BREAK;
+	CHECK(formatKbdRaw(&entry, 0, buffer) == 2 && buffer[0] == 0xE0 && buffer[1] == 0x9E);
+
+	// compacted keys are a make directly followed by its break
+	entry.data.Flags = KEY_E1;
+	CHECK(formatKbdRaw(&entry, LOG_FLAG_COMPACT, buffer) == 4 && buffer[0] == 0xE1 && buffer[1] == 0x1E && buffer[2] == 0xE1 && buffer[3] == 0x9E);
+
+	entry = makeKbdEntry(0x80, KEY_MAKE);
+	CHECK(!formatKbdRaw(&entry, 0, buffer));
+
+	return;
+}
+
+
+static void testEncodeRecords() {
+	InputRecord records[RECORDS_PER_ENTRY];
+	ULONG count = 0;
+	ULONGLONG lastTime = 500;
+	KbdDataEntry kbdEntry = makeKbdEntry(0x1E, KEY_E0);
+	kbdEntry.sequence = 7;
+	kbdEntry.repeatCount = 0x12345;
+	kbdEntry.holdTime = 2500000;
+
+	CHECK_STATUS(encodeRecords((DataEntry*)&kbdEntry, &lastTime, records, &count), STATUS_SUCCESS);
+	CHECK(count == 1);
+	CHECK(records[0].type == RECORD_TYPE_KBD && records[0].timeDelta == 500 && records[0].source == 3 && records[0].sequence == 7);
+	CHECK(records[0].kbd.makeCode == 0x1E && records[0].kbd.flags == KEY_E0 && records[0].kbd.holdTime == 250);
+	// the repeat count saturates
+	CHECK(records[0].kbd.repeatCount == MAXUSHORT);
+	CHECK(lastTime == 1000);
+
+	// input completed out of order resets the time
+	MouDataEntry mouEntry = makeMouEntry(MOUSE_RIGHT_BUTTON_DOWN, 0, -7, 9);
+	mouEntry.time = 900;
+	mouEntry.sequence = 2;
+	CHECK_STATUS(encodeRecords((DataEntry*)&mouEntry, &lastTime, records, &count), STATUS_SUCCESS);
+	CHECK(count == 2);
+	CHECK(records[0].type == RECORD_TYPE_TIME && records[0].time.time == 900 && !records[0].sequence);
+	CHECK(records[1].type == RECORD_TYPE_MOU && !records[1].timeDelta && records[1].source == 1 && records[1].sequence == 2);
+	CHECK(records[1].mou.buttonFlags == MOUSE_RIGHT_BUTTON_DOWN && records[1].mou.lastX == -7 && records[1].mou.lastY == 9);
+
+	// deltas that do not fit into 32 bits reset the time
+	mouEntry.time = 900 + 0x100000000ull;
+	CHECK_STATUS(encodeRecords((DataEntry*)&mouEntry, &lastTime, records, &count), STATUS_SUCCESS);
+	CHECK(count == 2 && records[0].type == RECORD_TYPE_TIME && records[0].time.time == mouEntry.time);
+	mouEntry.time += MAXULONG;
+	CHECK_STATUS(encodeRecords((DataEntry*)&mouEntry, &lastTime, records, &count), STATUS_SUCCESS);
+	CHECK(count == 1 && records[0].timeDelta == MAXULONG);
+
+	mouEntry.type = LOG_ALL;
+	mouEntry.time = lastTime;
+	CHECK_STATUS(encodeRecords((DataEntry*)&mouEntry, &lastTime, records, &count), STATUS_INVALID_PARAMETER);
+	CHECK(!count);
+
+	return;
+}
+
+
+int main() {
+	RUN_TEST(testFormatKbd);
+	RUN_TEST(testFormatMou);
+	RUN_TEST(testLineSequences);
+	RUN_TEST(testFormatKbdRaw);
+	RUN_TEST(testEncodeRecords);
+
+	return failedChecks ? EXIT_FAILURE : EXIT_SUCCESS;
+}
\ No newline at end of file
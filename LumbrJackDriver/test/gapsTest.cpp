@@ -0,0 +1,231 @@
+extern "C" {
+#include "../src/format.h"
+#include "test.h"
+}
+#include "gaps.h"
+#include "parser.h"
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Loss detection by sequence numbers: text logs formatted by the driver (formatKbd and formatMou) and binary log files encoded by it (encodeRecords)
+// are parsed and checked for gaps by the client.
+
+namespace {
+
+    constexpr const char* TEXT_PATH = "gaps.log";
+    constexpr const char* BINARY_PATH = "gaps.bin";
+    constexpr ULONGLONG START_TIME = 50000000;
+
+    // Input of a log file. Lost input has a sequence number, but is not written.
+    struct Input {
+        bool isKbd;
+        USHORT source;
+        // Make code or button flags.
+        USHORT code;
+        USHORT flags;
+        bool isLost;
+    };
+
+    // The keyboard releases its keys and the mouse presses two buttons at once and releases them, which has no lines in text logs.
+    // Both lose input on the way to the file.
+    const Input inputs[] = {
+        { true, 1, 0x1E, KEY_MAKE, false },
+        { false, 2, MOUSE_LEFT_BUTTON_DOWN | MOUSE_RIGHT_BUTTON_DOWN, 0, false },
+        { true, 1, 0x1E, KEY_BREAK, false },
+        { true, 1, 0x30, KEY_MAKE, true },
+        { false, 2, MOUSE_LEFT_BUTTON_UP | MOUSE_RIGHT_BUTTON_UP, 0, false },
+        { true, 1, 0x30, KEY_BREAK, false },
+        { false, 2, MOUSE_LEFT_BUTTON_DOWN, 0, true },
+        { false, 2, MOUSE_LEFT_BUTTON_DOWN, 0, true },
+        { true, 1, 0x2E, KEY_MAKE, false },
+        { false, 2, MOUSE_MIDDLE_BUTTON_DOWN, 0, false },
+    };
+
+    // Builds the entries of the inputs with the sequence numbers of their sources.
+    void makeEntries(std::vector<KbdDataEntry>* pKbdEntries, std::vector<MouDataEntry>* pMouEntries) {
+        ULONGLONG sequences[3] = {};
+
+        for (const Input& input : inputs) {
+            KbdDataEntry kbdDataEntry{};
+            MouDataEntry mouDataEntry{};
+
+            if (input.isKbd) {
+                kbdDataEntry.type = LOG_KBD;
+                kbdDataEntry.source = input.source;
+                kbdDataEntry.time = START_TIME + pKbdEntries->size();
+                kbdDataEntry.sequence = sequences[input.source]++;
+                kbdDataEntry.data.MakeCode = input.code;
+                kbdDataEntry.data.Flags = input.flags;
+            }
+            else {
+                mouDataEntry.type = LOG_MOU;
+                mouDataEntry.source = input.source;
+                mouDataEntry.time = START_TIME + pKbdEntries->size();
+                mouDataEntry.sequence = sequences[input.source]++;
+                mouDataEntry.data.ButtonFlags = input.code;
+            }
+
+            pKbdEntries->push_back(kbdDataEntry);
+            pMouEntries->push_back(mouDataEntry);
+        }
+
+        return;
+    }
+
+
+    // Writes the inputs that are not lost to a unified text log like the logging thread.
+    void writeText() {
+        std::vector<KbdDataEntry> kbdEntries;
+        std::vector<MouDataEntry> mouEntries;
+        makeEntries(&kbdEntries, &mouEntries);
+        LineSequences sequences{};
+        std::ofstream file(TEXT_PATH, std::ios::binary | std::ios::trunc);
+
+        for (size_t i = 0; i < sizeof(inputs) / sizeof(inputs[0]); i++) {
+
+            if (inputs[i].isLost) continue;
+
+            char buffer[0x200];
+
+            if (inputs[i].isKbd) {
+                CHECK_STATUS(formatKbd(&kbdEntries[i], &sequences, 0, TRUE, buffer, sizeof(buffer)), STATUS_SUCCESS);
+            }
+            else {
+                CHECK_STATUS(formatMou(&mouEntries[i], &sequences, 0, TRUE, buffer, sizeof(buffer)), STATUS_SUCCESS);
+            }
+
+            file << buffer;
+        }
+
+        return;
+    }
+
+
+    // Writes the inputs that are not lost to a binary log file like the logging thread.
+    void writeBinary() {
+        std::vector<KbdDataEntry> kbdEntries;
+        std::vector<MouDataEntry> mouEntries;
+        makeEntries(&kbdEntries, &mouEntries);
+        RecordFileHeader header{};
+        header.magic = RECORD_MAGIC;
+        header.version = RECORD_VERSION;
+        header.headerSize = sizeof(RecordFileHeader);
+        header.recordSize = sizeof(InputRecord);
+        header.timeResolution = RECORD_TIME_RESOLUTION;
+        header.startTime = START_TIME;
+        std::ofstream file(BINARY_PATH, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        ULONGLONG lastTime = START_TIME;
+
+        for (size_t i = 0; i < sizeof(inputs) / sizeof(inputs[0]); i++) {
+
+            if (inputs[i].isLost) continue;
+
+            const DataEntry* const pDataEntry = inputs[i].isKbd ? reinterpret_cast<const DataEntry*>(&kbdEntries[i]) : reinterpret_cast<const DataEntry*>(&mouEntries[i]);
+            InputRecord records[RECORDS_PER_ENTRY];
+            ULONG count = 0;
+            CHECK_STATUS(encodeRecords(pDataEntry, &lastTime, records, &count), STATUS_SUCCESS);
+            file.write(reinterpret_cast<const char*>(records), static_cast<std::streamsize>(count * sizeof(InputRecord)));
+        }
+
+        return;
+    }
+
+
+    // Lines carry the sequence numbers of the text log. Lines of a mouse entry share one. Key releases have no lines and leave no gap.
+    void testParseLines() {
+        writeText();
+        parser::Result result{};
+        CHECK(parser::parseFile(TEXT_PATH, 1, &result));
+        CHECK(result.fmt == parser::LINES && result.invalidCount == 0);
+        const uint64_t expected[][2] = { { 1, 0 }, { 2, 0 }, { 2, 0 }, { 1, 2 }, { 2, 3 } };
+        CHECK(result.events.size() == sizeof(expected) / sizeof(expected[0]));
+
+        for (size_t i = 0; i < result.events.size() && i < sizeof(expected) / sizeof(expected[0]); i++) {
+            CHECK(result.events[i].hasSequence);
+            CHECK(result.events[i].source == expected[i][0] && result.events[i].sequence == expected[i][1]);
+        }
+
+        // lines of older drivers have no sequence number
+        std::ofstream file(TEXT_PATH, std::ios::binary | std::ios::trunc);
+        file << "K:aSRC:1\nM:LEFT@X:0Y:0SRC:2\n";
+        file.close();
+        CHECK(parser::parseFile(TEXT_PATH, 1, &result));
+        CHECK(result.events.size() == 2 && result.invalidCount == 0);
+
+        for (const parser::Event& event : result.events) {
+            CHECK(!event.hasSequence && event.sequence == 0);
+        }
+
+        // sequence numbers beyond 64 bits are invalid
+        file.open(TEXT_PATH, std::ios::binary | std::ios::trunc);
+        file << "K:aSEQ:18446744073709551615SRC:1\nK:aSEQ:18446744073709551616SRC:1\n";
+        file.close();
+        CHECK(parser::parseFile(TEXT_PATH, 1, &result));
+        CHECK(result.events.size() == 1 && result.invalidCount == 1 && result.events[0].sequence == UINT64_MAX);
+
+        return;
+    }
+
+
+    void testTextGaps() {
+        writeText();
+        std::ostringstream out;
+        gaps::Report report{};
+        CHECK(gaps::check(TEXT_PATH, nullptr, out, &report));
+        CHECK(report.hasSequences);
+        CHECK(report.recordCount == 4 && report.lostCount == 3 && report.gapCount == 2);
+        CHECK(report.sources.size() == 2);
+        // both lines of the first mouse entry are one record
+        const gaps::SourceReport& kbd = report.sources[1];
+        const gaps::SourceReport& mou = report.sources[2];
+        CHECK(kbd.recordCount == 2 && kbd.lostCount == 1 && kbd.gapCount == 1 && !kbd.reorderedCount && !kbd.restartCount);
+        CHECK(mou.recordCount == 2 && mou.lostCount == 2 && mou.gapCount == 1 && !mou.reorderedCount && !mou.restartCount);
+        CHECK_STRING(out.str().c_str(), "SRC:1 lost 1 (sequence 1) before record 2\nSRC:2 lost 2 (sequence 1 to 2) before record 3\n");
+
+        // the lost button presses keep their numbers, while the button release before them has no line and no number
+        std::ifstream file(TEXT_PATH, std::ios::binary);
+        const std::string lines((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        CHECK(lines.find("M:MIDDLE@X:0Y:0SEQ:3SRC:2\n") != std::string::npos);
+
+        return;
+    }
+
+
+    // Binary records carry the sequence numbers of the sources, also of input without text.
+    void testBinaryGaps() {
+        writeBinary();
+        parser::Result result{};
+        CHECK(parser::parseFile(BINARY_PATH, 1, &result));
+        CHECK(result.fmt == parser::BINARY && !result.events.empty());
+
+        for (const parser::Event& event : result.events) {
+            CHECK(event.hasSequence);
+        }
+
+        std::ostringstream out;
+        gaps::Report report{};
+        CHECK(gaps::check(BINARY_PATH, nullptr, out, &report));
+        CHECK(report.hasSequences);
+        CHECK(report.recordCount == 7 && report.lostCount == 3 && report.gapCount == 2);
+        CHECK(report.sources[1].lostCount == 1 && report.sources[2].lostCount == 2 && report.sources[2].gapCount == 1);
+
+        return;
+    }
+
+}
+
+
+int main() {
+    RUN_TEST(testParseLines);
+    RUN_TEST(testTextGaps);
+    RUN_TEST(testBinaryGaps);
+    std::remove(TEXT_PATH);
+    std::remove(BINARY_PATH);
+
+    return failedChecks ? EXIT_FAILURE : EXIT_SUCCESS;
+}
\ No newline at end of file
@@ -0,0 +1,401 @@
+#include "test.h"
+#include "../src/input.h"
+#include "../src/compact.h"
+#include "../src/filter.h"
+#include "../src/source.h"
+#include "../src/inject.h"
+#include <stdlib.h>
+
+// Unit tests of the input processing of the completion routines.
+
+#define QUEUE_SIZE 0x10
+
+static BlockingQueue queue;
+static volatile BOOLEAN isLogging;
+static USHORT kbdSourceId;
+static USHORT mouSourceId;
+// State of the devices of the sources, like in the extensions of the filter devices.
+static KbdCompaction kbdCompaction;
+static MouCoalescing mouCoalescing;
+
+static void startSession() {
+	const FilterConfig filterConfig = { 0 };
+	CHECK_STATUS(setInputFilter(&filterConfig), STATUS_SUCCESS);
+	resetSequences();
+	resetKbdCompaction(&kbdCompaction);
+	resetMouCoalescing(&mouCoalescing);
+	initBlockingQueue(&queue, QUEUE_SIZE);
+	isLogging = TRUE;
+	setSimulatedTime(1000);
+
+	return;
+}
+
+
+// Removes all entries from the queue and returns the last one. The other entries are freed.
+static DataEntry* drainQueue(ULONG* pCount) {
+	DataEntry* pLastEntry = NULL;
+	LIST_ENTRY* pListEntry = NULL;
+	*pCount = 0;
+
+	while (queue.size) {
+		CHECK_STATUS(removeFromBlockingQueue(&queue, &pListEntry), STATUS_SUCCESS);
+
+		if (pLastEntry) {
+			freeDataEntry(pLastEntry);
+		}
+
+		pLastEntry = CONTAINING_RECORD(pListEntry, DataEntry, list);
+		(*pCount)++;
+	}
+
+	return pLastEntry;
+}
+
+
+static void testSequences() {
+	startSession();
+	const InputSession session = { 0, &isLogging, &queue, 0, NULL, NULL };
+	const KEYBOARD_INPUT_DATA input[] = { { 0, 0x1E, KEY_MAKE, 0, 0 }, { 0, 0x1E, KEY_BREAK, 0, 0 } };
+
+	CHECK(processKbdInput(input, ARRAYSIZE(input), kbdSourceId, &session) == 2);
+	LIST_ENTRY* pListEntry = NULL;
+
+	for (ULONGLONG sequence = 0; sequence < ARRAYSIZE(input); sequence++) {
+		CHECK_STATUS(removeFromBlockingQueue(&queue, &pListEntry), STATUS_SUCCESS);
+		KbdDataEntry* const pKbdDataEntry = CONTAINING_RECORD(pListEntry, KbdDataEntry, list);
+		CHECK(pKbdDataEntry->type == LOG_KBD && pKbdDataEntry->source == kbdSourceId && pKbdDataEntry->time == 1000);
+		CHECK(pKbdDataEntry->sequence == sequence && pKbdDataEntry->data.Flags == input[sequence].Flags);
+		freeDataEntry((DataEntry*)pKbdDataEntry);
+	}
+
+	CHECK(takeSequence(kbdSourceId) == 2);
+
+	return;
+}
+
+
+static void testCompaction() {
+	startSession();
+	const InputSession session = { LOG_FLAG_COMPACT, &isLogging, &queue, 0, &kbdCompaction, NULL };
+	const KEYBOARD_INPUT_DATA press[] = { { 0, 0x1E, KEY_MAKE, 0, 0 }, { 0, 0x1E, KEY_MAKE, 0, 0 }, { 0, 0x1E, KEY_MAKE, 0, 0 } };
+	const KEYBOARD_INPUT_DATA release = { 0, 0x1E, KEY_BREAK, 0, 0 };
+
+	CHECK(!processKbdInput(press, ARRAYSIZE(press), kbdSourceId, &session));
+	setSimulatedTime(1000 + 2500000);
+	CHECK(processKbdInput(&release, 1, kbdSourceId, &session) == 1);
+
+	ULONG count = 0;
+	KbdDataEntry* const pKbdDataEntry = (KbdDataEntry*)drainQueue(&count);
+	CHECK(count == 1);
+	CHECK(pKbdDataEntry->data.MakeCode == 0x1E && !(pKbdDataEntry->data.Flags & KEY_BREAK));
+	CHECK(pKbdDataEntry->repeatCount == 2 && pKbdDataEntry->holdTime == 2500000 && !pKbdDataEntry->sequence);
+	freeDataEntry((DataEntry*)pKbdDataEntry);
+
+	return;
+}
+
+
+static void testFilter() {
+	startSession();
+	FilterConfig filterConfig = { 0 };
+	filterConfig.flags = FILTER_FLAG_NO_BREAK;
+	CHECK_STATUS(setInputFilter(&filterConfig), STATUS_SUCCESS);
+	const InputSession session = { 0, &isLogging, &queue, 0, NULL, NULL };
+	const KEYBOARD_INPUT_DATA input[] = { { 0, 0x1E, KEY_MAKE, 0, 0 }, { 0, 0x1E, KEY_BREAK, 0, 0 }, { 0, 0x30, KEY_MAKE, 0, 0 } };
+
+	CHECK(processKbdInput(input, ARRAYSIZE(input), kbdSourceId, &session) == 2);
+
+	// filtered input is not logged, so it does not take a sequence number
+	ULONG count = 0;
+	KbdDataEntry* const pKbdDataEntry = (KbdDataEntry*)drainQueue(&count);
+	CHECK(count == 2 && pKbdDataEntry->data.MakeCode == 0x30 && pKbdDataEntry->sequence == 1);
+	freeDataEntry((DataEntry*)pKbdDataEntry);
+
+	return;
+}
+
+
+static void testStopped() {
+	startSession();
+	const InputSession session = { 0, &isLogging, &queue, 0, NULL, NULL };
+	const KEYBOARD_INPUT_DATA input = { 0, 0x1E, KEY_MAKE, 0, 0 };
+	const SourceSelection disable = { kbdSourceId, FALSE };
+	const SourceSelection enable = { kbdSourceId, TRUE };
+
+	CHECK_STATUS(enableSource(&disable), STATUS_SUCCESS);
+	CHECK(!processKbdInput(&input, 1, kbdSourceId, &session));
+	CHECK(!skipKbdInput(&input, 1, kbdSourceId, &session));
+	CHECK_STATUS(enableSource(&enable), STATUS_SUCCESS);
+
+	isLogging = FALSE;
+	CHECK(!processKbdInput(&input, 1, kbdSourceId, &session));
+	CHECK(!skipKbdInput(&input, 1, kbdSourceId, &session));
+	CHECK(!queue.size && !takeSequence(kbdSourceId));
+
+	// aggregated input is only counted
+	isLogging = TRUE;
+	const InputSession aggregateSession = { LOG_FLAG_AGGREGATE, &isLogging, &queue, 0, NULL, NULL };
+	CHECK(!processKbdInput(&input, 1, kbdSourceId, &aggregateSession));
+	CHECK(!queue.size);
+
+	return;
+}
+
+
+static void testFullQueue() {
+	startSession();
+	const InputSession session = { 0, &isLogging, &queue, 0, NULL, NULL };
+	KEYBOARD_INPUT_DATA input[QUEUE_SIZE + 2];
+
+	for (size_t i = 0; i < ARRAYSIZE(input); i++) {
+		const KEYBOARD_INPUT_DATA kbdInputData = { 0, 0x1E, KEY_MAKE, 0, 0 };
+		input[i] = kbdInputData;
+	}
+
+	// completion routines can not wait for the logging thread
+	setSimulatedIrql(DISPATCH_LEVEL);
+	CHECK(processKbdInput(input, ARRAYSIZE(input), kbdSourceId, &session) == QUEUE_SIZE);
+	setSimulatedIrql(PASSIVE_LEVEL);
+
+	// dropped input leaves a gap
+	ULONG count = 0;
+	DataEntry* const pDataEntry = drainQueue(&count);
+	CHECK(count == QUEUE_SIZE && pDataEntry->sequence == QUEUE_SIZE - 1);
+	CHECK(takeSequence(kbdSourceId) == QUEUE_SIZE + 2);
+	freeDataEntry(pDataEntry);
+
+	return;
+}
+
+
+static void testSkip() {
+	startSession();
+	const KEYBOARD_INPUT_DATA input[] = { { 0, 0x1E, KEY_MAKE, 0, 0 }, { 0, 0x1E, KEY_BREAK, 0, 0 }, { 0, 0x30, KEY_MAKE, 0, 0 } };
+	const InputSession session = { 0, &isLogging, &queue, 0, NULL, NULL };
+	const InputSession compactSession = { LOG_FLAG_COMPACT, &isLogging, &queue, 0, &kbdCompaction, NULL };
+
+	CHECK(skipKbdInput(input, ARRAYSIZE(input), kbdSourceId, &session) == 3);
+	// compacted keys are logged once per release
+	CHECK(skipKbdInput(input, ARRAYSIZE(input), kbdSourceId, &compactSession) == 1);
+	CHECK(takeSequence(kbdSourceId) == 4);
+
+	const MOUSE_INPUT_DATA move = { .LastX = 1 };
+	const MOUSE_INPUT_DATA click = { .ButtonFlags = MOUSE_LEFT_BUTTON_DOWN };
+	const InputSession motionSession = { LOG_FLAG_MOTION, &isLogging, &queue, 0, NULL, &mouCoalescing };
+	CHECK(!skipMouInput(&move, 1, mouSourceId, &session));
+	CHECK(skipMouInput(&click, 1, mouSourceId, &session) == 1);
+	CHECK(skipMouInput(&move, 1, mouSourceId, &motionSession) == 1);
+	CHECK(takeSequence(mouSourceId) == 2);
+
+	return;
+}
+
+
+static void testMouse() {
+	startSession();
+	const InputSession session = { 0, &isLogging, &queue, 0, NULL, NULL };
+	MOUSE_INPUT_DATA input[3];
+	RtlZeroMemory(input, sizeof(input));
+	input[0].LastX = 5;
+	input[1].ButtonFlags = MOUSE_WHEEL;
+	input[1].ButtonData = 120;
+	input[2].LastY = -5;
+
+	// movement is only logged with motion
+	CHECK(processMouInput(input, ARRAYSIZE(input), mouSourceId, &session) == 1);
+	ULONG count = 0;
+	MouDataEntry* const pMouDataEntry = (MouDataEntry*)drainQueue(&count);
+	CHECK(count == 1 && pMouDataEntry->type == LOG_MOU && pMouDataEntry->source == mouSourceId);
+	CHECK(pMouDataEntry->data.ButtonFlags == MOUSE_WHEEL && !pMouDataEntry->sequence);
+	freeDataEntry((DataEntry*)pMouDataEntry);
+
+	return;
+}
+
+
+// Every device has its own compaction and coalescing state, so the input of one device does not complete or absorb the input of another one.
+static void testDeviceState() {
+	startSession();
+	static KbdCompaction otherKbdCompaction;
+	static MouCoalescing otherMouCoalescing;
+	resetKbdCompaction(&otherKbdCompaction);
+	resetMouCoalescing(&otherMouCoalescing);
+	const InputSession session = { LOG_FLAG_COMPACT | LOG_FLAG_MOTION, &isLogging, &queue, 10000, &kbdCompaction, &mouCoalescing };
+	const InputSession otherSession = { LOG_FLAG_COMPACT | LOG_FLAG_MOTION, &isLogging, &queue, 10000, &otherKbdCompaction, &otherMouCoalescing };
+	const KEYBOARD_INPUT_DATA press = { 0, 0x1E, KEY_MAKE, 0, 0 };
+	const KEYBOARD_INPUT_DATA release = { 0, 0x1E, KEY_BREAK, 0, 0 };
+
+	// the release of the key on the other keyboard is passed through unpaired
+	CHECK(!processKbdInput(&press, 1, kbdSourceId, &session));
+	setSimulatedTime(2000);
+	CHECK(processKbdInput(&release, 1, kbdSourceId, &otherSession) == 1);
+	ULONG count = 0;
+	KbdDataEntry* pKbdDataEntry = (KbdDataEntry*)drainQueue(&count);
+	CHECK(count == 1 && pKbdDataEntry->data.Flags & KEY_BREAK && !pKbdDataEntry->holdTime);
+	freeDataEntry((DataEntry*)pKbdDataEntry);
+
+	setSimulatedTime(3000);
+	CHECK(processKbdInput(&release, 1, kbdSourceId, &session) == 1);
+	pKbdDataEntry = (KbdDataEntry*)drainQueue(&count);
+	CHECK(count == 1 && !(pKbdDataEntry->data.Flags & KEY_BREAK) && pKbdDataEntry->holdTime == 2000);
+	freeDataEntry((DataEntry*)pKbdDataEntry);
+
+	// movement of the other mouse is not accumulated into the movement emitted with the click
+	const MOUSE_INPUT_DATA move = { .LastX = 3 };
+	const MOUSE_INPUT_DATA otherMove = { .LastX = 4 };
+	const MOUSE_INPUT_DATA click = { .ButtonFlags = MOUSE_LEFT_BUTTON_DOWN };
+	CHECK(!processMouInput(&move, 1, mouSourceId, &session));
+	CHECK(!processMouInput(&otherMove, 1, mouSourceId, &otherSession));
+	CHECK(processMouInput(&click, 1, mouSourceId, &session) == 1);
+	MouDataEntry* const pMouDataEntry = (MouDataEntry*)drainQueue(&count);
+	CHECK(count == 1 && pMouDataEntry->data.ButtonFlags == MOUSE_LEFT_BUTTON_DOWN && pMouDataEntry->data.LastX == 3);
+	freeDataEntry((DataEntry*)pMouDataEntry);
+
+	return;
+}
+
+
+// Presses of held keys absorbed by the compaction when logging stops are logged once by the flush, in the order and with the time of the presses.
+// Held modifiers were logged with their press.
+static void testFlushKeys() {
+	startSession();
+	const InputSession session = { LOG_FLAG_COMPACT, &isLogging, &queue, 0, &kbdCompaction, NULL };
+	const KEYBOARD_INPUT_DATA arrow = { 0, 0x48, KEY_E0 | KEY_MAKE, 0, 0 };
+	const KEYBOARD_INPUT_DATA shift = { 0, 0x2A, KEY_MAKE, 0, 0 };
+	const KEYBOARD_INPUT_DATA key = { 0, 0x1E, KEY_MAKE, 0, 0 };
+	CHECK(!processKbdInput(&arrow, 1, kbdSourceId, &session));
+	setSimulatedTime(2000);
+	CHECK(processKbdInput(&shift, 1, kbdSourceId, &session) == 1);
+	setSimulatedTime(3000);
+	CHECK(!processKbdInput(&key, 1, kbdSourceId, &session));
+	setSimulatedTime(4000);
+	CHECK(!processKbdInput(&arrow, 1, kbdSourceId, &session));
+
+	isLogging = FALSE;
+	CHECK(flushKbdInput(kbdSourceId, &session) == 2);
+	CHECK(!flushKbdInput(kbdSourceId, &session));
+	LIST_ENTRY* pListEntry = NULL;
+	CHECK_STATUS(removeFromBlockingQueue(&queue, &pListEntry), STATUS_SUCCESS);
+	KbdDataEntry* pKbdDataEntry = CONTAINING_RECORD(pListEntry, KbdDataEntry, list);
+	CHECK(pKbdDataEntry->data.MakeCode == 0x2A && !pKbdDataEntry->sequence);
+	freeDataEntry((DataEntry*)pKbdDataEntry);
+	CHECK_STATUS(removeFromBlockingQueue(&queue, &pListEntry), STATUS_SUCCESS);
+	pKbdDataEntry = CONTAINING_RECORD(pListEntry, KbdDataEntry, list);
+	CHECK(pKbdDataEntry->data.MakeCode == 0x48 && pKbdDataEntry->data.Flags == (KEY_E0 | KEY_MAKE) && pKbdDataEntry->time == 1000);
+	CHECK(pKbdDataEntry->repeatCount == 1 && !pKbdDataEntry->holdTime && pKbdDataEntry->sequence == 1);
+	freeDataEntry((DataEntry*)pKbdDataEntry);
+	ULONG count = 0;
+	pKbdDataEntry = (KbdDataEntry*)drainQueue(&count);
+	CHECK(count == 1 && pKbdDataEntry->data.MakeCode == 0x1E && pKbdDataEntry->data.Flags == KEY_MAKE && pKbdDataEntry->time == 3000);
+	CHECK(!pKbdDataEntry->repeatCount && pKbdDataEntry->sequence == 2);
+	freeDataEntry((DataEntry*)pKbdDataEntry);
+
+	// the compaction state is reset, so the release of the shift key is passed through unpaired
+	isLogging = TRUE;
+	const KEYBOARD_INPUT_DATA shiftRelease = { 0, 0x2A, KEY_BREAK, 0, 0 };
+	CHECK(processKbdInput(&shiftRelease, 1, kbdSourceId, &session) == 1);
+	pKbdDataEntry = (KbdDataEntry*)drainQueue(&count);
+	CHECK(count == 1 && !pKbdDataEntry->holdTime);
+	freeDataEntry((DataEntry*)pKbdDataEntry);
+
+	// held keys are only flushed for compact logs
+	CHECK(!processKbdInput(&key, 1, kbdSourceId, &session));
+	const InputSession plainSession = { 0, &isLogging, &queue, 0, &kbdCompaction, NULL };
+	CHECK(!flushKbdInput(kbdSourceId, &plainSession) && !queue.size);
+
+	return;
+}
+
+
+// Movement absorbed by the coalescing when logging stops is logged once by the flush, absolute movement with its last position.
+static void testFlushMotion() {
+	startSession();
+	const InputSession session = { LOG_FLAG_MOTION, &isLogging, &queue, 10000, NULL, &mouCoalescing };
+	const MOUSE_INPUT_DATA moves[] = { { .LastX = 3, .LastY = -2 }, { .LastX = 4, .LastY = -1 } };
+	CHECK(!processMouInput(moves, ARRAYSIZE(moves), mouSourceId, &session));
+
+	isLogging = FALSE;
+	CHECK(flushMouInput(mouSourceId, &session) == 1);
+	CHECK(!flushMouInput(mouSourceId, &session));
+	ULONG count = 0;
+	MouDataEntry* pMouDataEntry = (MouDataEntry*)drainQueue(&count);
+	CHECK(count == 1 && pMouDataEntry->data.LastX == 7 && pMouDataEntry->data.LastY == -3 && !pMouDataEntry->data.ButtonFlags && !pMouDataEntry->sequence);
+	freeDataEntry((DataEntry*)pMouDataEntry);
+
+	isLogging = TRUE;
+	const MOUSE_INPUT_DATA positions[] = { { .Flags = MOUSE_MOVE_ABSOLUTE, .LastX = 100, .LastY = 200 }, { .Flags = MOUSE_MOVE_ABSOLUTE, .LastX = 300, .LastY = 400 } };
+	CHECK(!processMouInput(positions, ARRAYSIZE(positions), mouSourceId, &session));
+	isLogging = FALSE;
+	CHECK(flushMouInput(mouSourceId, &session) == 1);
+	pMouDataEntry = (MouDataEntry*)drainQueue(&count);
+	CHECK(count == 1 && pMouDataEntry->data.Flags & MOUSE_MOVE_ABSOLUTE && pMouDataEntry->data.LastX == 300 && pMouDataEntry->data.LastY == 400);
+	freeDataEntry((DataEntry*)pMouDataEntry);
+
+	// movement is not coalesced without motion
+	isLogging = TRUE;
+	CHECK(!processMouInput(moves, 1, mouSourceId, &session));
+	const InputSession buttonSession = { 0, &isLogging, &queue, 10000, NULL, &mouCoalescing };
+	CHECK(!flushMouInput(mouSourceId, &buttonSession) && !queue.size);
+
+	return;
+}
+
+
+// The queue has no consumer, so the injection runs into the limit of the queue and the drain times out in simulated time.
+static void testInjection() {
+	startSession();
+	Injection injection = { .config = { 20, 10, 1000, 4 }, .sourceId = kbdSourceId, .kbdSession = { 0, &isLogging, &queue }, .mouSession = { 0, &isLogging, &queue } };
+
+	runInjection(&injection);
+	const InjectReport* const pReport = &injection.report;
+	CHECK(pReport->generated == 30 && pReport->queued == QUEUE_SIZE && pReport->dropped == 30 - QUEUE_SIZE);
+	// paced per batch, the last batch of two mouse events is due after 28 events
+	CHECK(pReport->injectTime == 28 * 10000000ull / 1000 && pReport->achievedRate == 30 * 1000 / 28);
+	CHECK(!pReport->drainTime);
+
+	// the input types are interleaved in the ratio of their counts, starting with a keyboard batch
+	LIST_ENTRY* pListEntry = NULL;
+	CHECK_STATUS(removeFromBlockingQueue(&queue, &pListEntry), STATUS_SUCCESS);
+	KbdDataEntry* const pKbdDataEntry = CONTAINING_RECORD(pListEntry, KbdDataEntry, list);
+	CHECK(pKbdDataEntry->type == LOG_KBD && pKbdDataEntry->data.MakeCode == 0x10 && pKbdDataEntry->data.Flags == KEY_MAKE);
+	freeDataEntry((DataEntry*)pKbdDataEntry);
+	ULONG count = 0;
+	DataEntry* const pDataEntry = drainQueue(&count);
+	CHECK(count == QUEUE_SIZE - 1 && pDataEntry->type == LOG_KBD && ((KbdDataEntry*)pDataEntry)->data.ExtraInformation == 11);
+	freeDataEntry(pDataEntry);
+
+	// nothing is injected once logging is stopped
+	isLogging = FALSE;
+	runInjection(&injection);
+	CHECK(!pReport->generated && !queue.size);
+
+	return;
+}
+
+
+int main() {
+	WCHAR kbdName[SOURCE_NAME_LENGTH] = { 'K', 'B', 'D' };
+	WCHAR mouName[SOURCE_NAME_LENGTH] = { 'M', 'O', 'U' };
+	initSources();
+
+	if (addSource(kbdName, FILE_DEVICE_KEYBOARD, &kbdSourceId) != STATUS_SUCCESS || addSource(mouName, FILE_DEVICE_MOUSE, &mouSourceId) != STATUS_SUCCESS) {
+		fprintf(stderr, "addSource failed\n");
+
+		return EXIT_FAILURE;
+	}
+
+	RUN_TEST(testSequences);
+	RUN_TEST(testCompaction);
+	RUN_TEST(testFilter);
+	RUN_TEST(testStopped);
+	RUN_TEST(testFullQueue);
+	RUN_TEST(testSkip);
+	RUN_TEST(testMouse);
+	RUN_TEST(testDeviceState);
+	RUN_TEST(testFlushKeys);
+	RUN_TEST(testFlushMotion);
+	RUN_TEST(testInjection);
+
+	return failedChecks ? EXIT_FAILURE : EXIT_SUCCESS;
+}
\ No newline at end of file
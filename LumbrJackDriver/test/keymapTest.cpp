@@ -0,0 +1,215 @@
+extern "C" {
+#include "../src/compact.h"
+#include "test.h"
+}
+#include "keymap.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// Tests of the keymap of the client (keymap.h) on keyboard input compacted by the driver (compactKbdInput):
+// compacted keystrokes converted to scan codes keep held modifiers in front of the keys they modify,
+// and the scalar, SSSE3 and AVX2 implementations produce the same text for a fixed corpus with modifiers, prefixes and locks.
+
+namespace {
+
+    constexpr uint8_t LSHIFT = 0x2A;
+    constexpr uint8_t RSHIFT = 0x36;
+    constexpr uint8_t CTRL = 0x1D;
+    constexpr uint8_t ALT = 0x38;
+    constexpr uint8_t CAPS_LOCK = 0x3A;
+    constexpr uint8_t NUM_LOCK = 0x45;
+
+    // Raw input of a keyboard.
+    struct Key {
+        uint8_t code;
+        USHORT flags;
+    };
+
+    // Passes the input through the compaction of the driver and converts the logged records to scan codes like the decoder of the client.
+    // Every input gets its own time, except for the inputs at the given indices, which get the time of the input before them.
+    std::vector<uint8_t> compact(const std::vector<Key>& keys, const std::vector<size_t>& sameTimes) {
+        static KbdCompaction kbdCompaction;
+        resetKbdCompaction(&kbdCompaction);
+        std::vector<uint8_t> codes;
+        ULONGLONG time = 1000;
+
+        for (size_t i = 0; i < keys.size(); i++) {
+            KEYBOARD_INPUT_DATA kbdInputData{};
+            kbdInputData.MakeCode = keys[i].code;
+            kbdInputData.Flags = keys[i].flags;
+            ULONG repeatCount = 0;
+            ULONGLONG holdTime = 0;
+
+            if (std::find(sameTimes.begin(), sameTimes.end(), i) == sameTimes.end()) {
+                time += 20000;
+            }
+
+            if (!compactKbdInput(&kbdCompaction, &kbdInputData, time, &repeatCount, &holdTime)) continue;
+
+            KbdRecord record{};
+            record.makeCode = kbdInputData.MakeCode;
+            record.flags = kbdInputData.Flags;
+            record.repeatCount = static_cast<uint16_t>(repeatCount);
+            record.holdTime = static_cast<uint32_t>(holdTime / 10000);
+            uint8_t recordCodes[4]{};
+            const size_t count = keymap::fromRecord(&record, recordCodes);
+            codes.insert(codes.end(), recordCodes, recordCodes + count);
+        }
+
+        return codes;
+    }
+
+
+    std::string translate(keymap::layout lay, const std::vector<uint8_t>& codes, keymap::implementation impl) {
+        keymap::State state{};
+        std::string text;
+        keymap::translate(lay, &state, codes.data(), codes.size(), &text, impl);
+
+        return text;
+    }
+
+
+    // Scan codes of a pseudo random mix of letters, digits, held and locked modifiers, E0 and numpad keys and pauses.
+    // Runs of plain letters are long enough for the vector implementations.
+    std::vector<uint8_t> makeCorpus() {
+        static const uint8_t heldModifiers[] = { LSHIFT, RSHIFT, ALT };
+        bool isHeld[sizeof(heldModifiers)] = {};
+        std::vector<uint8_t> codes;
+        uint32_t state = 7;
+
+        for (int i = 0; i < 0x4000; i++) {
+            state = state * 1664525 + 1013904223;
+            const uint32_t choice = state >> 24;
+
+            if (choice < 0xC) {
+                // shift and AltGr stay held for the following keys, on layouts without AltGr the right alt key suppresses them
+                const size_t index = choice % 3;
+
+                if (index == 2) {
+                    codes.push_back(0xE0);
+                }
+
+                codes.push_back(static_cast<uint8_t>(heldModifiers[index] | (isHeld[index] ? 0x80 : 0)));
+                isHeld[index] = !isHeld[index];
+            }
+            else if (choice < 0x10) {
+                // control and alt are released right away
+                const uint8_t code = choice & 1 ? CTRL : ALT;
+                codes.insert(codes.end(), { code, static_cast<uint8_t>(code | 0x80) });
+            }
+            else if (choice < 0x14) {
+                codes.push_back(choice & 1 ? CAPS_LOCK : NUM_LOCK);
+                codes.push_back(static_cast<uint8_t>((choice & 1 ? CAPS_LOCK : NUM_LOCK) | 0x80));
+            }
+            else if (choice < 0x18) {
+                // divide and enter of the numpad and the arrow keys
+                const uint8_t code = static_cast<uint8_t>(choice & 1 ? 0x35 : 0x48);
+                codes.insert(codes.end(), { 0xE0, code, 0xE0, static_cast<uint8_t>(code | 0x80) });
+            }
+            else if (choice < 0x20) {
+                // numpad 7 to decimal separator
+                const uint8_t code = static_cast<uint8_t>(0x47 + choice % 0xD);
+                codes.insert(codes.end(), { code, static_cast<uint8_t>(code | 0x80) });
+            }
+            else if (choice == 0x20) {
+                codes.insert(codes.end(), { 0xE1, 0x1D, 0x45, 0xE1, 0x9D, 0xC5 });
+            }
+            else {
+                // letters, digits and punctuation of the main block and the ISO key
+                const uint8_t code = static_cast<uint8_t>(choice % 5 ? 0x02 + choice % 0x38 : 0x56);
+                codes.insert(codes.end(), { code, static_cast<uint8_t>(code | 0x80) });
+            }
+
+        }
+
+        return codes;
+    }
+
+
+    // Pairs are recognized by their flag, also with a hold time that rounded down to zero, and by the hold time of older drivers.
+    void testFromRecord() {
+        struct {
+            uint16_t flags;
+            uint32_t holdTime;
+            std::vector<uint8_t> codes;
+        } const cases[] = {
+            { RECORD_KBD_PAIRED, 0, { 0x1E, 0x9E } },
+            { 0, 150, { 0x1E, 0x9E } },
+            { 0, 0, { 0x1E } },
+            { KEY_BREAK, 150, { 0x9E } },
+            { RECORD_KBD_PAIRED | KEY_E0, 3, { 0xE0, 0x1E, 0xE0, 0x9E } },
+        };
+
+        for (const auto& c : cases) {
+            KbdRecord record{};
+            record.makeCode = 0x1E;
+            record.flags = c.flags;
+            record.holdTime = c.holdTime;
+            uint8_t codes[4]{};
+            const size_t count = keymap::fromRecord(&record, codes);
+            CHECK(std::vector<uint8_t>(codes, codes + count) == c.codes);
+        }
+
+        return;
+    }
+
+
+    // Held shift and AltGr keys repeat and are released after the keys they modify.
+    // Their presses are logged when they happen, so the keys are decoded with the modifiers held.
+    void testCompactedOrder() {
+        const std::vector<Key> keys = {
+            { LSHIFT, KEY_MAKE }, { LSHIFT, KEY_MAKE }, { 0x23, KEY_MAKE }, { 0x23, KEY_BREAK }, { LSHIFT, KEY_MAKE }, { LSHIFT, KEY_BREAK },
+            { 0x12, KEY_MAKE }, { 0x12, KEY_BREAK }, { 0x26, KEY_MAKE }, { 0x26, KEY_MAKE }, { 0x26, KEY_BREAK }, { 0x26, KEY_MAKE }, { 0x26, KEY_BREAK },
+            { 0x18, KEY_MAKE }, { 0x18, KEY_BREAK },
+            { 0x39, KEY_MAKE }, { 0x39, KEY_BREAK },
+            { RSHIFT, KEY_MAKE }, { 0x11, KEY_MAKE }, { 0x11, KEY_BREAK }, { RSHIFT, KEY_BREAK }, { 0x18, KEY_MAKE }, { 0x18, KEY_BREAK },
+            { ALT, KEY_E0 | KEY_MAKE }, { ALT, KEY_E0 | KEY_MAKE }, { 0x10, KEY_MAKE }, { 0x10, KEY_BREAK }, { ALT, KEY_E0 | KEY_BREAK },
+        };
+        // the release of the last o comes with its press, so its hold time is zero
+        const std::vector<uint8_t> codes = compact(keys, { 22 });
+
+        CHECK_STRING(translate(keymap::US, codes, keymap::SCALAR).c_str(), "Hello Wo");
+        CHECK_STRING(translate(keymap::DE, codes, keymap::SCALAR).c_str(), "Hello Wo@");
+
+        return;
+    }
+
+
+    // The implementations agree on every layout, also if the scan codes are split into calls that end within prefixes and pauses.
+    void testImplementations() {
+        const std::vector<uint8_t> codes = makeCorpus();
+
+        for (int lay = 0; lay < keymap::MAX_LAYOUT; lay++) {
+            const std::string expected = translate(static_cast<keymap::layout>(lay), codes, keymap::SCALAR);
+            CHECK(expected.size() > codes.size() / 8);
+
+            for (keymap::implementation impl : { keymap::SSSE3, keymap::AVX2 }) {
+                CHECK(translate(static_cast<keymap::layout>(lay), codes, impl) == expected);
+                keymap::State state{};
+                std::string text;
+
+                for (size_t offset = 0, size = 1; offset < codes.size(); offset += size, size = size % 0x61 + 7) {
+                    keymap::translate(static_cast<keymap::layout>(lay), &state, codes.data() + offset, std::min(size, codes.size() - offset), &text, impl);
+                }
+
+                CHECK(text == expected);
+            }
+
+        }
+
+        return;
+    }
+
+}
+
+
+int main() {
+    RUN_TEST(testFromRecord);
+    RUN_TEST(testCompactedOrder);
+    RUN_TEST(testImplementations);
+
+    return failedChecks ? EXIT_FAILURE : EXIT_SUCCESS;
+}
\ No newline at end of file
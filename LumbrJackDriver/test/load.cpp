@@ -0,0 +1,484 @@
+extern "C" {
+#include "../src/compact.h"
+#include "../src/filter.h"
+#include "../src/format.h"
+#include "../src/input.h"
+#include "../src/source.h"
+}
+#include "decoder.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+
+// Load generator and replay harness of the capture pipeline of the driver on the user mode build of the driver core.
+// A producer thread completes reads like completeKbdRead and completeMouRead at DISPATCH_LEVEL, a consumer thread empties the queue
+// like the logging thread. The reads are synthetic input at a fixed rate or the input of a binary log file at its recorded times:
+// lumbrjack-load [--kbd | --replay=<file>] [--rate=<events per second>] [--batch=<events per read>] [--burst=<reads>] [--seconds=<seconds>]
+// [--speed=<factor>] [--queue=<entries>] [--delay=<microseconds>] [--compact] [--motion] [--motion-rate=<records per second>] [--binary] [--output=<file>]
+// Prints the offered and sustained rates, the input dropped at the queue and the latency from capture to the log file.
+
+namespace {
+
+    struct Options {
+        // Synthetic keyboard input instead of mouse input.
+        bool isKbd;
+        const char* replayPath;
+        uint64_t rate;
+        uint64_t batch;
+        // Reads completed back to back. The pause after a burst keeps the average rate.
+        uint64_t burst;
+        uint64_t seconds;
+        // Factor of the replay speed. Zero replays as fast as possible.
+        double speed;
+        uint64_t queueSize;
+        // Time the consumer spends per entry in addition to formatting, e.g. to simulate a slow disk.
+        uint64_t delay;
+        // Maximum number of movement records per second with motion.
+        uint64_t motionRate;
+        bool isBinary;
+        const char* outputPath;
+        ULONG flags;
+    };
+
+    // Input of a single completed read.
+    struct Read {
+        std::chrono::steady_clock::time_point due;
+        bool isKbd;
+        std::vector<KEYBOARD_INPUT_DATA> kbd;
+        std::vector<MOUSE_INPUT_DATA> mou;
+    };
+
+    struct Counters {
+        uint64_t offered;
+        uint64_t reads;
+        uint64_t queued;
+        // Reads completed after their due time.
+        uint64_t lateReads;
+    };
+
+    BlockingQueue queue;
+    volatile BOOLEAN isLogging;
+    USHORT kbdSourceId;
+    USHORT mouSourceId;
+    // State of the simulated keyboard and mouse, like in the extensions of their filter devices.
+    KbdCompaction kbdCompaction;
+    MouCoalescing mouCoalescing;
+
+}
+
+static bool parseOptions(int argc, char* argv[], Options* pOptions);
+static bool parseNumber(const std::string& value, uint64_t* pNumber);
+static void produceSynthetic(const Options* pOptions, Counters* pCounters);
+static bool produceReplay(const Options* pOptions, Counters* pCounters);
+static void completeRead(const Read* pRead, const InputSession* pSession, Counters* pCounters);
+static void consume(const Options* pOptions, int fd, std::vector<uint64_t>* pLatencies);
+static double getPercentile(const std::vector<uint64_t>& sorted, double percentile);
+
+int main(int argc, char* argv[]) {
+    Options options{};
+
+    if (!parseOptions(argc, argv, &options)) {
+
+        return 1;
+    }
+
+    int fd = -1;
+
+    if (options.outputPath) {
+        fd = open(options.outputPath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+        if (fd < 0) {
+            std::cout << "Failed to open " << options.outputPath << std::endl;
+
+            return 1;
+        }
+
+    }
+
+    WCHAR kbdName[SOURCE_NAME_LENGTH] = { 'K', 'B', 'D' };
+    WCHAR mouName[SOURCE_NAME_LENGTH] = { 'M', 'O', 'U' };
+    initSources();
+    addSource(kbdName, FILE_DEVICE_KEYBOARD, &kbdSourceId);
+    addSource(mouName, FILE_DEVICE_MOUSE, &mouSourceId);
+    resetSequences();
+    resetKbdCompaction(&kbdCompaction);
+    resetMouCoalescing(&mouCoalescing);
+    initBlockingQueue(&queue, static_cast<LONG>(options.queueSize));
+    isLogging = TRUE;
+
+    std::vector<uint64_t> latencies;
+    Counters counters{};
+    bool isValid = true;
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::thread consumer(consume, &options, fd, &latencies);
+
+    if (options.replayPath) {
+        isValid = produceReplay(&options, &counters);
+    }
+    else {
+        produceSynthetic(&options, &counters);
+    }
+
+    const std::chrono::steady_clock::time_point produced = std::chrono::steady_clock::now();
+    // the consumer logs the entries left in the queue like a stopped logging thread
+    closeBlockingQueue(&queue);
+    consumer.join();
+    const std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+    if (fd >= 0) {
+        close(fd);
+    }
+
+    if (!isValid) {
+        std::cout << "Failed to replay " << options.replayPath << ". Encrypted log files have to be decompressed first." << std::endl;
+
+        return 1;
+    }
+
+    // every logged input took a sequence number, so the numbers missing in the queue were dropped
+    const uint64_t taken = takeSequence(kbdSourceId) + takeSequence(mouSourceId);
+    const uint64_t logged = latencies.size();
+    const uint64_t dropped = taken - logged;
+    const uint64_t absorbed = counters.offered - taken;
+    const double produceSeconds = std::chrono::duration<double>(produced - start).count();
+    const double seconds = std::chrono::duration<double>(end - start).count();
+
+    std::cout << "Offered: " << counters.offered << " events in " << counters.reads << " reads in " << produceSeconds << " s ("
+        << (produceSeconds > 0.0 ? counters.offered / produceSeconds : 0.0) << " events/s), late reads: " << counters.lateReads << std::endl;
+    std::cout << "Logged: " << logged << " in " << seconds << " s (" << (seconds > 0.0 ? logged / seconds : 0.0) << " events/s)" << std::endl;
+    std::cout << "Dropped: " << dropped << " (" << (taken ? 100.0 * dropped / taken : 0.0) << " %) Filtered or compacted: " << absorbed << std::endl;
+
+    std::sort(latencies.begin(), latencies.end());
+    std::cout << "Latency (us): p50 " << getPercentile(latencies, 0.5) << " p90 " << getPercentile(latencies, 0.9) << " p99 "
+        << getPercentile(latencies, 0.99) << " p99.9 " << getPercentile(latencies, 0.999) << " max " << getPercentile(latencies, 1.0) << std::endl;
+
+    return 0;
+}
+
+
+static bool parseOptions(int argc, char* argv[], Options* pOptions) {
+    pOptions->rate = 8000;
+    pOptions->batch = 16;
+    pOptions->burst = 1;
+    pOptions->seconds = 5;
+    pOptions->speed = 1.0;
+    pOptions->queueSize = 0x10;
+    pOptions->motionRate = 100;
+
+    for (int i = 1; i < argc; i++) {
+        const std::string option = argv[i];
+        bool isValid = true;
+
+        if (option == "--kbd") {
+            pOptions->isKbd = true;
+        }
+        else if (option.compare(0, 9, "--replay=") == 0) {
+            pOptions->replayPath = argv[i] + 9;
+        }
+        else if (option.compare(0, 7, "--rate=") == 0) {
+            isValid = parseNumber(option.substr(7), &pOptions->rate) && pOptions->rate;
+        }
+        else if (option.compare(0, 8, "--batch=") == 0) {
+            isValid = parseNumber(option.substr(8), &pOptions->batch) && pOptions->batch && pOptions->batch <= 0x1000;
+        }
+        else if (option.compare(0, 8, "--burst=") == 0) {
+            isValid = parseNumber(option.substr(8), &pOptions->burst) && pOptions->burst;
+        }
+        else if (option.compare(0, 10, "--seconds=") == 0) {
+            isValid = parseNumber(option.substr(10), &pOptions->seconds) && pOptions->seconds;
+        }
+        else if (option.compare(0, 8, "--speed=") == 0) {
+            char* end = nullptr;
+            pOptions->speed = std::strtod(argv[i] + 8, &end);
+            isValid = end != argv[i] + 8 && !*end && pOptions->speed >= 0.0;
+        }
+        else if (option.compare(0, 8, "--queue=") == 0) {
+            isValid = parseNumber(option.substr(8), &pOptions->queueSize) && pOptions->queueSize && pOptions->queueSize <= 0x100000;
+        }
+        else if (option.compare(0, 8, "--delay=") == 0) {
+            isValid = parseNumber(option.substr(8), &pOptions->delay);
+        }
+        else if (option == "--compact") {
+            pOptions->flags |= LOG_FLAG_COMPACT;
+        }
+        else if (option == "--motion") {
+            pOptions->flags |= LOG_FLAG_MOTION;
+        }
+        else if (option.compare(0, 14, "--motion-rate=") == 0) {
+            isValid = parseNumber(option.substr(14), &pOptions->motionRate) && pOptions->motionRate && pOptions->motionRate <= RECORD_TIME_RESOLUTION;
+            pOptions->flags |= LOG_FLAG_MOTION;
+        }
+        else if (option == "--binary") {
+            pOptions->isBinary = true;
+        }
+        else if (option.compare(0, 9, "--output=") == 0) {
+            pOptions->outputPath = argv[i] + 9;
+        }
+        else {
+            std::cout << "Unknown option: " << option << std::endl;
+
+            return false;
+        }
+
+        if (!isValid) {
+            std::cout << "Invalid value: " << option << std::endl;
+
+            return false;
+        }
+
+    }
+
+    return true;
+}
+
+
+static bool parseNumber(const std::string& value, uint64_t* pNumber) {
+
+    if (value.empty() || value.find_first_not_of("1234567890") != std::string::npos) {
+
+        return false;
+    }
+
+    *pNumber = std::stoull(value);
+
+    return true;
+}
+
+
+// Completes reads of synthetic input at the rate of the options.
+// Keyboard input alternates presses and releases of the letter keys, mouse input moves diagonally and clicks every 1000 events.
+static void produceSynthetic(const Options* pOptions, Counters* pCounters) {
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    const std::chrono::steady_clock::time_point end = start + std::chrono::seconds(pOptions->seconds);
+    const std::chrono::duration<double> readPeriod(static_cast<double>(pOptions->batch) / static_cast<double>(pOptions->rate));
+    const InputSession session = { pOptions->flags, &isLogging, &queue, RECORD_TIME_RESOLUTION / pOptions->motionRate, &kbdCompaction, &mouCoalescing };
+    Read read{};
+    read.isKbd = pOptions->isKbd;
+    read.kbd.resize(pOptions->isKbd ? pOptions->batch : 0);
+    read.mou.resize(pOptions->isKbd ? 0 : pOptions->batch);
+    uint64_t event = 0;
+
+    for (uint64_t i = 0; ; i++) {
+        // the first read of a burst is due after the burst period
+        const uint64_t burstStart = i - i % pOptions->burst;
+        read.due = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(readPeriod * static_cast<double>(burstStart));
+
+        if (read.due >= end) break;
+
+        for (uint64_t j = 0; j < pOptions->batch; j++, event++) {
+
+            if (pOptions->isKbd) {
+                KEYBOARD_INPUT_DATA* const pKbdInputData = &read.kbd[j];
+                pKbdInputData->MakeCode = static_cast<USHORT>(0x10 + event / 2 % 0x20);
+                pKbdInputData->Flags = event % 2 ? KEY_BREAK : KEY_MAKE;
+            }
+            else {
+                MOUSE_INPUT_DATA* const pMouInputData = &read.mou[j];
+                pMouInputData->ButtonFlags = event % 1000 == 0 ? MOUSE_LEFT_BUTTON_DOWN : event % 1000 == 1 ? MOUSE_LEFT_BUTTON_UP : 0;
+                pMouInputData->LastX = 1;
+                pMouInputData->LastY = -1;
+            }
+
+        }
+
+        completeRead(&read, &session, pCounters);
+    }
+
+    return;
+}
+
+
+// Completes reads of the input of a binary log file at the recorded times scaled by the speed of the options.
+// Consecutive records of the same type are batched up to the batch size and completed at the time of the last record.
+static bool produceReplay(const Options* pOptions, Counters* pCounters) {
+    decoder::Reader* const pReader = new decoder::Reader();
+
+    if (!decoder::open(pReader, pOptions->replayPath, nullptr)) {
+        delete pReader;
+
+        return false;
+    }
+
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    const InputSession session = { pOptions->flags, &isLogging, &queue, RECORD_TIME_RESOLUTION / pOptions->motionRate, &kbdCompaction, &mouCoalescing };
+    const InputRecord* pRecord = nullptr;
+    uint64_t time = 0;
+    uint64_t firstTime = 0;
+    Read read{};
+
+    while (decoder::next(pReader, &pRecord, &time)) {
+        const bool isKbd = pRecord->type == RECORD_TYPE_KBD;
+
+        if (!pCounters->offered && read.kbd.empty() && read.mou.empty()) {
+            firstTime = time;
+        }
+
+        if ((read.kbd.size() + read.mou.size() && read.isKbd != isKbd) || read.kbd.size() + read.mou.size() == pOptions->batch) {
+            completeRead(&read, &session, pCounters);
+            read.kbd.clear();
+            read.mou.clear();
+        }
+
+        read.isKbd = isKbd;
+
+        if (isKbd) {
+            KEYBOARD_INPUT_DATA kbdInputData{};
+            kbdInputData.UnitId = pRecord->kbd.unitId;
+            kbdInputData.MakeCode = pRecord->kbd.makeCode;
+            kbdInputData.Flags = pRecord->kbd.flags;
+            kbdInputData.ExtraInformation = pRecord->kbd.extraInformation;
+            read.kbd.push_back(kbdInputData);
+        }
+        else {
+            MOUSE_INPUT_DATA mouInputData{};
+            mouInputData.UnitId = pRecord->mou.unitId;
+            mouInputData.Flags = pRecord->mou.flags;
+            mouInputData.ButtonFlags = pRecord->mou.buttonFlags;
+            mouInputData.ButtonData = pRecord->mou.buttonData;
+            mouInputData.LastX = pRecord->mou.lastX;
+            mouInputData.LastY = pRecord->mou.lastY;
+            read.mou.push_back(mouInputData);
+        }
+
+        // records that went back in time are due immediately
+        const uint64_t elapsed = time > firstTime ? time - firstTime : 0;
+        const double offset = pOptions->speed > 0.0 ? static_cast<double>(elapsed) / RECORD_TIME_RESOLUTION / pOptions->speed : 0.0;
+        read.due = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(offset));
+    }
+
+    if (read.kbd.size() + read.mou.size()) {
+        completeRead(&read, &session, pCounters);
+    }
+
+    delete pReader;
+
+    return true;
+}
+
+
+// Waits for the due time of a read and passes its input to the input processing like the completion routines.
+static void completeRead(const Read* pRead, const InputSession* pSession, Counters* pCounters) {
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+
+    if (pRead->due > now) {
+        std::this_thread::sleep_until(pRead->due);
+    }
+    // reads more than 1 ms behind their due time are late
+    else if (now - pRead->due > std::chrono::milliseconds(1)) {
+        pCounters->lateReads++;
+    }
+
+    // completion routines run at DISPATCH_LEVEL and can not wait for the consumer
+    setSimulatedIrql(DISPATCH_LEVEL);
+
+    if (pRead->isKbd) {
+        pCounters->queued += processKbdInput(pRead->kbd.data(), pRead->kbd.size(), kbdSourceId, pSession);
+        pCounters->offered += pRead->kbd.size();
+    }
+    else {
+        pCounters->queued += processMouInput(pRead->mou.data(), pRead->mou.size(), mouSourceId, pSession);
+        pCounters->offered += pRead->mou.size();
+    }
+
+    setSimulatedIrql(PASSIVE_LEVEL);
+    pCounters->reads++;
+
+    return;
+}
+
+
+// Empties the queue like the logging thread until it is closed and empty.
+// Every entry is formatted like a text or binary log file and optionally written. The latency is taken after the write.
+static void consume(const Options* pOptions, int fd, std::vector<uint64_t>* pLatencies) {
+    char buffer[0x200];
+    LineSequences sequences{};
+    InputRecord records[RECORDS_PER_ENTRY];
+    ULONGLONG lastTime = 0;
+
+    // binary log files start with the header writeBinHeader of the driver writes, the first delta is relative to its start time
+    if (pOptions->isBinary) {
+        RecordFileHeader header{};
+        header.magic = RECORD_MAGIC;
+        header.version = RECORD_VERSION;
+        header.headerSize = sizeof(RecordFileHeader);
+        header.recordSize = sizeof(InputRecord);
+        header.timeResolution = RECORD_TIME_RESOLUTION;
+        header.startTime = platformQueryTime();
+        // system times count 100 ns units since 1601-01-01 UTC like KeQuerySystemTimePrecise
+        const std::chrono::system_clock::duration sinceEpoch = std::chrono::system_clock::now().time_since_epoch();
+        header.startSystemTime = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(sinceEpoch).count()) * 10 + 116444736000000000;
+        lastTime = header.startTime;
+
+        if (fd >= 0) {
+            platformWriteFile(fd, &header, sizeof(header));
+        }
+
+    }
+
+    while (true) {
+        LIST_ENTRY* pListEntry = nullptr;
+        const NTSTATUS ntStatus = removeFromBlockingQueue(&queue, &pListEntry);
+
+        if (ntStatus == STATUS_NO_MORE_ENTRIES) break;
+
+        if (ntStatus != STATUS_SUCCESS) continue;
+
+        DataEntry* const pDataEntry = CONTAINING_RECORD(pListEntry, DataEntry, list);
+
+        const void* data = buffer;
+        size_t size = 0;
+
+        if (pOptions->isBinary) {
+            ULONG count = 0;
+            encodeRecords(pDataEntry, &lastTime, records, &count);
+            data = records;
+            size = count * sizeof(InputRecord);
+        }
+        else {
+
+            if (pDataEntry->type == LOG_KBD) {
+                formatKbd(reinterpret_cast<KbdDataEntry*>(pDataEntry), &sequences, pOptions->flags, TRUE, buffer, sizeof(buffer));
+            }
+            else {
+                formatMou(reinterpret_cast<MouDataEntry*>(pDataEntry), &sequences, pOptions->flags, TRUE, buffer, sizeof(buffer));
+            }
+
+            size = strlen(buffer);
+        }
+
+        if (fd >= 0 && size) {
+            platformWriteFile(fd, data, static_cast<ULONG>(size));
+        }
+
+        if (pOptions->delay) {
+            std::this_thread::sleep_for(std::chrono::microseconds(pOptions->delay));
+        }
+
+        pLatencies->push_back(platformQueryTime() - pDataEntry->time);
+        freeDataEntry(pDataEntry);
+    }
+
+    return;
+}
+
+
+// Gets a percentile of sorted latencies in microseconds.
+static double getPercentile(const std::vector<uint64_t>& sorted, double percentile) {
+
+    if (sorted.empty()) {
+
+        return 0.0;
+    }
+
+    const size_t index = static_cast<size_t>(std::ceil(percentile * static_cast<double>(sorted.size())));
+
+    return static_cast<double>(sorted[index ? index - 1 : 0]) / 10.0;
+}
\ No newline at end of file
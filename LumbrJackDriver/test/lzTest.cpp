@@ -0,0 +1,264 @@
+extern "C" {
+#include "../src/lz.h"
+#include "test.h"
+}
+#include "decompress.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+// Round trip tests of the block compression of LOG_FLAG_COMPRESS: blocks compressed by the driver (lzCompress) are read back by the decompressor of the client.
+// Covers incompressible data, blocks of exactly LZ_BLOCK_SIZE bytes and corrupt block headers.
+
+namespace {
+
+    constexpr const char* LOG_PATH = "lz.bin";
+
+    std::vector<uint8_t> randomData(size_t size, uint32_t seed) {
+        std::vector<uint8_t> data(size);
+        uint32_t state = seed;
+
+        for (uint8_t& byte : data) {
+            state = state * 1664525 + 1013904223;
+            byte = static_cast<uint8_t>(state >> 24);
+        }
+
+        return data;
+    }
+
+
+    // Lines of a text log, so most of the data is repeated.
+    std::vector<uint8_t> textData(size_t size) {
+        static const char lines[] = "K:aSRC:1\nK:bSRC:1\nM:LDSRC:2\nK:[ENTER]SRC:1\n";
+        std::vector<uint8_t> data(size);
+
+        for (size_t i = 0; i < size; i++) {
+            data[i] = static_cast<uint8_t>(lines[i % (sizeof(lines) - 1)]);
+        }
+
+        return data;
+    }
+
+
+    std::vector<uint8_t> compress(const std::vector<uint8_t>& data) {
+        std::vector<uint8_t> compressed(LZ_MAX_COMPRESSED_SIZE(data.size()));
+        std::vector<uint16_t> hashTable(LZ_HASH_TABLE_SIZE / sizeof(uint16_t));
+        const size_t size = lzCompress(data.data(), data.size(), compressed.data(), compressed.size(), hashTable.data());
+        CHECK(size && size <= compressed.size());
+        compressed.resize(size);
+
+        return compressed;
+    }
+
+
+    // Compresses the data and decompresses it again.
+    void checkRoundTrip(const std::vector<uint8_t>& data) {
+        const std::vector<uint8_t> compressed = compress(data);
+        std::vector<uint8_t> decompressed(data.size());
+        CHECK(decompress::decompressBlock(compressed.data(), compressed.size(), decompressed.data(), decompressed.size()));
+        CHECK(decompressed == data);
+
+        // blocks have to decompress to exactly the size of their header
+        if (!data.empty()) {
+            std::vector<uint8_t> larger(data.size() + 1);
+            CHECK(!decompress::decompressBlock(compressed.data(), compressed.size(), larger.data(), larger.size()));
+            CHECK(!decompress::decompressBlock(compressed.data(), compressed.size(), decompressed.data(), decompressed.size() - 1));
+        }
+
+        return;
+    }
+
+
+    // Writes the data to a compressed log file in blocks of at most LZ_BLOCK_SIZE bytes like the writer of the driver.
+    // Blocks that do not get smaller are stored uncompressed. The last block is marked with LZ_BLOCK_FINAL.
+    std::vector<LzBlockHeader> writeLog(const std::vector<uint8_t>& data) {
+        std::ofstream file(LOG_PATH, std::ios::binary | std::ios::trunc);
+        const uint32_t magic = LZ_FILE_MAGIC;
+        file.write(reinterpret_cast<const char*>(&magic), sizeof(magic));
+        std::vector<LzBlockHeader> headers;
+
+        for (size_t offset = 0; offset < data.size(); offset += LZ_BLOCK_SIZE) {
+            const std::vector<uint8_t> block(data.begin() + offset, data.begin() + std::min(offset + LZ_BLOCK_SIZE, data.size()));
+            std::vector<uint8_t> compressed = compress(block);
+
+            if (compressed.size() >= block.size()) {
+                compressed = block;
+            }
+
+            const uint32_t finalFlag = offset + block.size() == data.size() ? LZ_BLOCK_FINAL : 0;
+            const LzBlockHeader header = { static_cast<uint32_t>(block.size()) | finalFlag, static_cast<uint32_t>(compressed.size()) };
+            file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            file.write(reinterpret_cast<const char*>(compressed.data()), static_cast<std::streamsize>(compressed.size()));
+            headers.push_back(header);
+        }
+
+        return headers;
+    }
+
+
+    // Keeps the first bytes of the log file, like a file of a writer that crashed.
+    void cutLog(size_t size) {
+        std::ifstream in(LOG_PATH, std::ios::binary);
+        std::vector<char> data(size);
+        in.read(data.data(), static_cast<std::streamsize>(size));
+        in.close();
+        std::ofstream out(LOG_PATH, std::ios::binary | std::ios::trunc);
+        out.write(data.data(), static_cast<std::streamsize>(size));
+
+        return;
+    }
+
+
+    // Reads the log file with the decompressor of the client.
+    std::vector<uint8_t> readLog(bool* pIsCorrupt) {
+        // the stream is too large for the stack
+        decompress::Stream* const pStream = new decompress::Stream();
+        CHECK(decompress::open(pStream, LOG_PATH, nullptr));
+        CHECK(pStream->isCompressed);
+        std::vector<uint8_t> data;
+        uint8_t buffer[0x1000];
+        size_t size = 0;
+
+        while ((size = decompress::read(pStream, buffer, sizeof(buffer))) > 0) {
+            data.insert(data.end(), buffer, buffer + size);
+        }
+
+        *pIsCorrupt = pStream->isCorrupt;
+        delete pStream;
+
+        return data;
+    }
+
+
+    void checkLog(const std::vector<uint8_t>& data) {
+        writeLog(data);
+        bool isCorrupt = true;
+        CHECK(readLog(&isCorrupt) == data);
+        CHECK(!isCorrupt);
+
+        return;
+    }
+
+
+    // Random data does not compress, but stays below the worst case size and is stored uncompressed in log files.
+    void testIncompressible() {
+        const std::vector<uint8_t> data = randomData(LZ_BLOCK_SIZE, 1);
+        const std::vector<uint8_t> compressed = compress(data);
+        CHECK(compressed.size() >= data.size() && compressed.size() <= LZ_MAX_COMPRESSED_SIZE(data.size()));
+        checkRoundTrip(data);
+
+        const std::vector<LzBlockHeader> headers = writeLog(data);
+        CHECK(headers.size() == 1 && headers[0].uncompressedSize == (LZ_BLOCK_SIZE | LZ_BLOCK_FINAL) && headers[0].compressedSize == LZ_BLOCK_SIZE);
+        checkLog(data);
+
+        // short blocks that end before the first match can be searched
+        for (size_t size : { 1, 4, 11, 12, 13, 17 }) {
+            checkRoundTrip(randomData(size, static_cast<uint32_t>(size)));
+        }
+
+        return;
+    }
+
+
+    // Blocks of exactly LZ_BLOCK_SIZE bytes keep all match offsets within 16 bits. Larger blocks are rejected.
+    void testFullBlock() {
+        const std::vector<uint8_t> text = textData(LZ_BLOCK_SIZE);
+        checkRoundTrip(text);
+        CHECK(compress(text).size() < text.size() / 4);
+        checkRoundTrip(std::vector<uint8_t>(LZ_BLOCK_SIZE, 0));
+
+        // a single match of half the block far back
+        std::vector<uint8_t> repeated = randomData(LZ_BLOCK_SIZE, 2);
+        memcpy(repeated.data() + LZ_BLOCK_SIZE / 2, repeated.data(), LZ_BLOCK_SIZE / 2);
+        checkRoundTrip(repeated);
+
+        std::vector<uint8_t> compressed(LZ_MAX_COMPRESSED_SIZE(LZ_BLOCK_SIZE + 1));
+        std::vector<uint16_t> hashTable(LZ_HASH_TABLE_SIZE / sizeof(uint16_t));
+        const std::vector<uint8_t> large = textData(LZ_BLOCK_SIZE + 1);
+        CHECK(lzCompress(large.data(), large.size(), compressed.data(), compressed.size(), hashTable.data()) == 0);
+        CHECK(lzCompress(text.data(), text.size(), compressed.data(), LZ_MAX_COMPRESSED_SIZE(LZ_BLOCK_SIZE) - 1, hashTable.data()) == 0);
+
+        // files of exactly one and two full blocks and a partial last block
+        checkLog(text);
+        std::vector<uint8_t> data = textData(2 * LZ_BLOCK_SIZE);
+        const std::vector<uint8_t> random = randomData(LZ_BLOCK_SIZE, 3);
+        data.insert(data.end(), random.begin(), random.end());
+        data.resize(data.size() + 0x123, 0x20);
+        const std::vector<LzBlockHeader> headers = writeLog(data);
+        CHECK(headers.size() == 4 && headers[2].uncompressedSize == LZ_BLOCK_SIZE && headers[3].uncompressedSize == (0x123 | LZ_BLOCK_FINAL));
+        checkLog(data);
+
+        return;
+    }
+
+
+    // Reading stops with isCorrupt at a block with an invalid header. The data of the blocks before is read.
+    void testCorruptHeader() {
+        std::vector<uint8_t> data = textData(LZ_BLOCK_SIZE);
+        const std::vector<uint8_t> second = randomData(LZ_BLOCK_SIZE / 2, 4);
+        data.insert(data.end(), second.begin(), second.end());
+        const std::vector<uint8_t> firstBlock(data.begin(), data.begin() + LZ_BLOCK_SIZE);
+        const std::vector<LzBlockHeader> headers = writeLog(data);
+        CHECK(headers.size() == 2);
+        const std::streamoff secondOffset = static_cast<std::streamoff>(sizeof(uint32_t) + sizeof(LzBlockHeader) + headers[0].compressedSize);
+
+        const LzBlockHeader corruptHeaders[] = {
+            // only the final block can be empty
+            { 0, 0 },
+            { 0, headers[1].compressedSize },
+            { LZ_BLOCK_SIZE + 1, headers[1].compressedSize },
+            { headers[1].uncompressedSize, static_cast<uint32_t>(LZ_MAX_COMPRESSED_SIZE(LZ_BLOCK_SIZE) + 1) },
+            // sizes that do not match the data: beyond the end of the file, stored data decompressed and a wrong uncompressed size
+            { headers[1].uncompressedSize, headers[1].compressedSize + 1 },
+            { headers[1].uncompressedSize, headers[1].compressedSize - 1 },
+            { headers[1].uncompressedSize - 1, headers[1].compressedSize },
+        };
+
+        for (const LzBlockHeader& corruptHeader : corruptHeaders) {
+            writeLog(data);
+            std::fstream file(LOG_PATH, std::ios::binary | std::ios::in | std::ios::out);
+            file.seekp(secondOffset);
+            file.write(reinterpret_cast<const char*>(&corruptHeader), sizeof(corruptHeader));
+            file.close();
+
+            bool isCorrupt = false;
+            CHECK(readLog(&isCorrupt) == firstBlock);
+            CHECK(isCorrupt);
+        }
+
+        // blocks after the final block
+        writeLog(firstBlock);
+        const std::vector<uint8_t> appended = compress(second);
+        const LzBlockHeader appendedHeader = { static_cast<uint32_t>(second.size()), static_cast<uint32_t>(appended.size()) };
+        std::ofstream file(LOG_PATH, std::ios::binary | std::ios::app);
+        file.write(reinterpret_cast<const char*>(&appendedHeader), sizeof(appendedHeader));
+        file.write(reinterpret_cast<const char*>(appended.data()), static_cast<std::streamsize>(appended.size()));
+        file.close();
+        bool isCorrupt = false;
+        CHECK(readLog(&isCorrupt) == firstBlock);
+        CHECK(isCorrupt);
+
+        // compressed files are not authenticated, so a file without a final block that ends in a cut off header is read like a truncated record
+        writeLog(data);
+        cutLog(static_cast<size_t>(secondOffset) + sizeof(LzBlockHeader) - 1);
+        isCorrupt = true;
+        CHECK(readLog(&isCorrupt) == firstBlock);
+        CHECK(!isCorrupt);
+
+        return;
+    }
+
+}
+
+
+int main() {
+    RUN_TEST(testIncompressible);
+    RUN_TEST(testFullBlock);
+    RUN_TEST(testCorruptHeader);
+    std::remove(LOG_PATH);
+
+    return failedChecks ? EXIT_FAILURE : EXIT_SUCCESS;
+}
\ No newline at end of file
@@ -0,0 +1,274 @@
+extern "C" {
+#include "../src/format.h"
+#include "test.h"
+}
+#include "merge.h"
+#include "parser.h"
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Merge of binary log files of the client (merge.h): interleaved inputs with many equal times are merged in chunks on several threads,
+// and the output is checked for global time order, the order of the inputs for equal times and against a merge of the parsed events.
+
+namespace {
+
+    constexpr uint64_t START_SYSTEM_TIME = 133000000000000000;
+    // Granularity of the deltas and the starts of the inputs, so events of different inputs often have the same time.
+    constexpr uint64_t TICK = 1000;
+
+    // Input of the merge.
+    struct Input {
+        std::string path;
+        // Ticks of TICK between the start system time of the first input and the input.
+        uint64_t start;
+        size_t recordCount;
+        // Ticks of TICK between the records are taken from 0 to maxStep.
+        uint32_t maxStep;
+        // The times of the records go back after every backInterval-th record, never if zero.
+        size_t backInterval;
+    };
+
+    // Fields of a line of the output.
+    struct Line {
+        uint64_t time;
+        size_t input;
+        uint64_t source;
+        uint64_t sequence;
+    };
+
+    // Writes the records of an input. Its start time is unrelated to the other inputs.
+    void writeInput(const Input& input, size_t index) {
+        RecordFileHeader header{};
+        header.magic = RECORD_MAGIC;
+        header.version = RECORD_VERSION;
+        header.headerSize = sizeof(RecordFileHeader);
+        header.recordSize = sizeof(InputRecord);
+        header.timeResolution = RECORD_TIME_RESOLUTION;
+        header.startTime = 50000000 + index * 7777777;
+        header.startSystemTime = START_SYSTEM_TIME + input.start * TICK;
+        std::ofstream file(input.path, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        uint64_t time = header.startTime;
+        uint32_t state = static_cast<uint32_t>(index) + 1;
+
+        for (size_t i = 0; i < input.recordCount; i++) {
+            state = state * 1664525 + 1013904223;
+            InputRecord record{};
+            record.source = static_cast<uint16_t>(index * 2 + 1 + (state >> 31));
+            record.sequence = i;
+
+            if (input.backInterval && i % input.backInterval == input.backInterval - 1) {
+                InputRecord timeRecord{};
+                timeRecord.type = RECORD_TYPE_TIME;
+                time -= 5 * TICK;
+                timeRecord.time.time = time;
+                file.write(reinterpret_cast<const char*>(&timeRecord), sizeof(timeRecord));
+            }
+            else {
+                record.timeDelta = static_cast<uint32_t>((state >> 8) % (input.maxStep + 1) * TICK);
+                time += record.timeDelta;
+            }
+
+            if (state >> 30 & 1) {
+                record.type = RECORD_TYPE_MOU;
+                record.mou.buttonFlags = state >> 29 & 1 ? MOUSE_LEFT_BUTTON_DOWN : 0;
+                record.mou.lastX = static_cast<int32_t>(state >> 4 & 0xFF) - 0x80;
+                record.mou.lastY = static_cast<int32_t>(state >> 12 & 0xFF) - 0x80;
+            }
+            else {
+                record.type = RECORD_TYPE_KBD;
+                record.kbd.makeCode = static_cast<uint16_t>(0x10 + (state >> 16) % 0x20);
+                record.kbd.flags = state >> 29 & 1 ? KEY_BREAK : KEY_MAKE;
+            }
+
+            file.write(reinterpret_cast<const char*>(&record), sizeof(record));
+        }
+
+        return;
+    }
+
+
+    std::vector<std::string> writeInputs(const std::vector<Input>& inputs) {
+        std::vector<std::string> paths;
+
+        for (size_t i = 0; i < inputs.size(); i++) {
+            writeInput(inputs[i], i);
+            paths.push_back(inputs[i].path);
+        }
+
+        return paths;
+    }
+
+
+    // Merges the parsed events of the inputs by taking the earliest event at the heads of the inputs, the first input for equal times.
+    std::string mergeEvents(const std::vector<Input>& inputs, const std::vector<std::string>& paths) {
+        std::vector<parser::Result> results(paths.size());
+
+        for (size_t i = 0; i < paths.size(); i++) {
+            CHECK(parser::parseFile(paths[i].c_str(), 1, &results[i]));
+        }
+
+        std::vector<size_t> heads(paths.size(), 0);
+        std::ostringstream out;
+        out << merge::csvHeader;
+
+        while (true) {
+            size_t winner = paths.size();
+            uint64_t winnerTime = 0;
+
+            for (size_t i = 0; i < paths.size(); i++) {
+
+                if (heads[i] == results[i].events.size()) continue;
+
+                const uint64_t time = inputs[i].start * TICK + results[i].events[heads[i]].time;
+
+                if (winner == paths.size() || time < winnerTime) {
+                    winner = i;
+                    winnerTime = time;
+                }
+
+            }
+
+            if (winner == paths.size()) break;
+
+            const parser::Event& event = results[winner].events[heads[winner]++];
+            out << winnerTime << ',' << winner << ',' << parser::getTypeName(event.type) << ',' << event.source << ',' << event.sequence << ','
+                << event.code << ',' << event.flags << ',' << event.x << ',' << event.y << ',' << event.holdTime << ',' << event.repeatCount << '\n';
+        }
+
+        return out.str();
+    }
+
+
+    // Merges the inputs in chunks of the minimum size.
+    std::string mergeInputs(const std::vector<std::string>& paths, unsigned int threads, merge::Result* pResult) {
+        merge::Options options{};
+        merge::getDefaultOptions(&options);
+        options.threads = threads;
+        options.memoryLimit = 1;
+        std::ostringstream out;
+        CHECK(merge::mergeFiles(paths, &options, out, pResult));
+
+        return out.str();
+    }
+
+
+    std::vector<Line> parseLines(const std::string& output) {
+        std::istringstream in(output);
+        std::string text;
+        std::getline(in, text);
+        CHECK(text + '\n' == merge::csvHeader);
+        std::vector<Line> lines;
+
+        while (std::getline(in, text)) {
+            std::istringstream fields(text);
+            std::string type;
+            Line line{};
+            char separator = 0;
+            fields >> line.time >> separator >> line.input >> separator;
+            std::getline(fields, type, ',');
+            fields >> line.source >> separator >> line.sequence;
+            CHECK(static_cast<bool>(fields));
+            lines.push_back(line);
+        }
+
+        return lines;
+    }
+
+
+    // Checks that the lines are ordered by time, then by input, and that the events of every input keep their order.
+    // Returns the number of lines with the time of the line before them, but another input.
+    size_t checkOrder(const std::vector<Line>& lines, size_t inputCount) {
+        std::vector<uint64_t> nextSequences(inputCount, 0);
+        size_t tieCount = 0;
+
+        for (size_t i = 0; i < lines.size(); i++) {
+
+            if (i) {
+                CHECK(lines[i - 1].time < lines[i].time || (lines[i - 1].time == lines[i].time && lines[i - 1].input <= lines[i].input));
+                tieCount += lines[i - 1].time == lines[i].time && lines[i - 1].input != lines[i].input;
+            }
+
+            // mouse records with a click have two events with the same sequence number
+            CHECK(lines[i].input < inputCount && (lines[i].source - 1) / 2 == lines[i].input);
+            CHECK(lines[i].sequence + 1 >= nextSequences[lines[i].input]);
+            nextSequences[lines[i].input] = lines[i].sequence + 1;
+        }
+
+        return tieCount;
+    }
+
+
+    // Inputs with ascending times are merged into ascending times in chunks of several records.
+    void testOrder() {
+        const std::vector<Input> inputs = {
+            { "merge0.bin", 0, 6000, 3, 0 }, { "merge1.bin", 1, 2500, 8, 0 }, { "merge2.bin", 2, 7000, 2, 0 }, { "merge3.bin", 3, 100, 200, 0 }, { "merge4.bin", 4, 4000, 4, 0 },
+        };
+        const std::vector<std::string> paths = writeInputs(inputs);
+        merge::Result result{};
+        const std::string output = mergeInputs(paths, 1, &result);
+        const std::vector<Line> lines = parseLines(output);
+        CHECK(result.eventCount == lines.size() && result.chunkSize < 4000 * sizeof(InputRecord) && result.invalidCount == 0);
+        CHECK(result.startSystemTime == START_SYSTEM_TIME);
+        CHECK(checkOrder(lines, inputs.size()) > 1000);
+        CHECK(output == mergeEvents(inputs, paths));
+
+        return;
+    }
+
+
+    // Inputs that start at the same time with many events at the same time, also within the inputs: the loser tree takes the first input
+    // for every tie, so the events of an input follow each other until the next input has an earlier event.
+    void testStability() {
+        const std::vector<Input> inputs = {
+            { "merge0.bin", 0, 5000, 1, 0 }, { "merge1.bin", 0, 5000, 1, 0 }, { "merge2.bin", 0, 5000, 1, 0 }, { "merge3.bin", 0, 3000, 0, 0 },
+        };
+        const std::vector<std::string> paths = writeInputs(inputs);
+
+        for (unsigned int threads : { 1u, 4u }) {
+            merge::Result result{};
+            const std::string output = mergeInputs(paths, threads, &result);
+            CHECK(checkOrder(parseLines(output), inputs.size()) > 1000);
+            CHECK(output == mergeEvents(inputs, paths));
+        }
+
+        return;
+    }
+
+
+    // Inputs whose times go back, an input without records and more inputs than threads give the same output with any number of threads.
+    void testThreads() {
+        const std::vector<Input> inputs = {
+            { "merge0.bin", 0, 9000, 3, 500 }, { "merge1.bin", 3, 0, 1, 0 }, { "merge2.bin", 2, 3000, 9, 0 }, { "merge3.bin", 5, 5000, 2, 77 },
+            { "merge4.bin", 1, 1, 1, 0 }, { "merge5.bin", 0, 7000, 1, 0 }, { "merge6.bin", 9, 4500, 5, 1000 },
+        };
+        const std::vector<std::string> paths = writeInputs(inputs);
+        const std::string expected = mergeEvents(inputs, paths);
+
+        for (unsigned int threads : { 1u, 2u, 3u, 8u }) {
+            merge::Result result{};
+            CHECK(mergeInputs(paths, threads, &result) == expected);
+            CHECK(result.threads == threads);
+        }
+
+        return;
+    }
+
+}
+
+
+int main() {
+    RUN_TEST(testOrder);
+    RUN_TEST(testStability);
+    RUN_TEST(testThreads);
+
+    for (int i = 0; i < 7; i++) {
+        std::remove(("merge" + std::to_string(i) + ".bin").c_str());
+    }
+
+    return failedChecks ? EXIT_FAILURE : EXIT_SUCCESS;
+}
\ No newline at end of file
@@ -0,0 +1,163 @@
+#include "test.h"
+#include "../src/BlockingQueue.h"
+#include <pthread.h>
+#include <stdlib.h>
+
+// Unit tests of the blocking queue on the user mode platform layer.
+
+typedef struct TestEntry {
+	LIST_ENTRY list;
+	ULONG value;
+}TestEntry;
+
+#define THREAD_ENTRIES 100000
+
+static void testOrder() {
+	BlockingQueue queue;
+	initBlockingQueue(&queue, 4);
+	TestEntry entries[3];
+
+	for (ULONG i = 0; i < 3; i++) {
+		entries[i].value = i;
+		CHECK_STATUS(addToBlockigQueue(&queue, &entries[i].list), STATUS_SUCCESS);
+	}
+
+	CHECK(queue.size == 3);
+
+	for (ULONG i = 0; i < 3; i++) {
+		LIST_ENTRY* pListEntry = NULL;
+		CHECK_STATUS(removeFromBlockingQueue(&queue, &pListEntry), STATUS_SUCCESS);
+		CHECK(pListEntry && CONTAINING_RECORD(pListEntry, TestEntry, list)->value == i);
+	}
+
+	CHECK(queue.size == 0);
+	CHECK(IsListEmpty(&queue.head));
+
+	return;
+}
+
+
+// Completion routines run at DISPATCH_LEVEL, so they must never wait for a full queue.
+static void testDispatchLevel() {
+	BlockingQueue queue;
+	initBlockingQueue(&queue, 2);
+	TestEntry entries[3];
+	setSimulatedIrql(DISPATCH_LEVEL);
+
+	CHECK_STATUS(addToBlockigQueue(&queue, &entries[0].list), STATUS_SUCCESS);
+	CHECK_STATUS(addToBlockigQueue(&queue, &entries[1].list), STATUS_SUCCESS);
+	CHECK_STATUS(addToBlockigQueue(&queue, &entries[2].list), STATUS_TIMEOUT);
+	CHECK(queue.size == 2);
+
+	LIST_ENTRY* pListEntry = NULL;
+	CHECK_STATUS(removeFromBlockingQueue(&queue, &pListEntry), STATUS_SUCCESS);
+	CHECK(pListEntry == &entries[0].list);
+	CHECK_STATUS(removeFromBlockingQueue(&queue, &pListEntry), STATUS_SUCCESS);
+	CHECK(pListEntry == &entries[1].list);
+	pListEntry = NULL;
+	CHECK_STATUS(removeFromBlockingQueue(&queue, &pListEntry), STATUS_TIMEOUT);
+	CHECK(!pListEntry);
+
+	setSimulatedIrql(DISPATCH_LEVEL + 1);
+	CHECK_STATUS(addToBlockigQueue(&queue, &entries[2].list), STATUS_INVALID_DEVICE_STATE);
+	CHECK_STATUS(removeFromBlockingQueue(&queue, &pListEntry), STATUS_INVALID_DEVICE_STATE);
+	CHECK(queue.size == 0);
+
+	setSimulatedIrql(PASSIVE_LEVEL);
+
+	return;
+}
+
+
+// A closed queue rejects new entries, hands out the entries left and then reports its end without waiting.
+static void testClose() {
+	BlockingQueue queue;
+	initBlockingQueue(&queue, 2);
+	TestEntry entries[3];
+	LIST_ENTRY* pListEntry = NULL;
+
+	CHECK_STATUS(addToBlockigQueue(&queue, &entries[0].list), STATUS_SUCCESS);
+	CHECK_STATUS(addToBlockigQueue(&queue, &entries[1].list), STATUS_SUCCESS);
+	// the wake-up of a full queue does not exceed the limit of the semaphore
+	closeBlockingQueue(&queue);
+	closeBlockingQueue(&queue);
+	CHECK_STATUS(removeFromBlockingQueue(&queue, &pListEntry), STATUS_SUCCESS);
+	CHECK(pListEntry == &entries[0].list);
+	CHECK_STATUS(addToBlockigQueue(&queue, &entries[2].list), STATUS_PIPE_CLOSING);
+	CHECK_STATUS(removeFromBlockingQueue(&queue, &pListEntry), STATUS_SUCCESS);
+	CHECK(pListEntry == &entries[1].list);
+	CHECK_STATUS(removeFromBlockingQueue(&queue, &pListEntry), STATUS_NO_MORE_ENTRIES);
+	CHECK_STATUS(removeFromBlockingQueue(&queue, &pListEntry), STATUS_NO_MORE_ENTRIES);
+	CHECK(queue.size == 0);
+
+	// a reopened queue waits again
+	openBlockingQueue(&queue);
+	openBlockingQueue(&queue);
+	setSimulatedIrql(DISPATCH_LEVEL);
+	CHECK_STATUS(removeFromBlockingQueue(&queue, &pListEntry), STATUS_TIMEOUT);
+	CHECK_STATUS(addToBlockigQueue(&queue, &entries[2].list), STATUS_SUCCESS);
+	CHECK_STATUS(removeFromBlockingQueue(&queue, &pListEntry), STATUS_SUCCESS);
+	CHECK(pListEntry == &entries[2].list);
+	CHECK_STATUS(removeFromBlockingQueue(&queue, &pListEntry), STATUS_TIMEOUT);
+	setSimulatedIrql(PASSIVE_LEVEL);
+
+	return;
+}
+
+
+static void* produce(void* pContext) {
+	BlockingQueue* const pQueue = (BlockingQueue*)pContext;
+	TestEntry* const entries = (TestEntry*)malloc(THREAD_ENTRIES * sizeof(TestEntry));
+
+	for (ULONG i = 0; i < THREAD_ENTRIES; i++) {
+		entries[i].value = i;
+
+		// waits while the queue is full
+		if (addToBlockigQueue(pQueue, &entries[i].list) != STATUS_SUCCESS) {
+			failedChecks++;
+		}
+
+	}
+
+	return entries;
+}
+
+
+// A producer that is faster than the queue is large blocks until the consumer catches up. No entry is lost or reordered.
+static void testBlocking() {
+	BlockingQueue queue;
+	initBlockingQueue(&queue, 0x10);
+	pthread_t producer;
+	CHECK(!pthread_create(&producer, NULL, produce, &queue));
+
+	ULONG mismatches = 0;
+
+	for (ULONG i = 0; i < THREAD_ENTRIES; i++) {
+		LIST_ENTRY* pListEntry = NULL;
+
+		// waits while the queue is empty
+		if (removeFromBlockingQueue(&queue, &pListEntry) != STATUS_SUCCESS || CONTAINING_RECORD(pListEntry, TestEntry, list)->value != i) {
+			mismatches++;
+		}
+
+	}
+
+	void* entries = NULL;
+	pthread_join(producer, &entries);
+	free(entries);
+
+	CHECK(!mismatches);
+	CHECK(queue.size == 0);
+
+	return;
+}
+
+
+int main() {
+	RUN_TEST(testOrder);
+	RUN_TEST(testDispatchLevel);
+	RUN_TEST(testClose);
+	RUN_TEST(testBlocking);
+
+	return failedChecks ? EXIT_FAILURE : EXIT_SUCCESS;
+}
\ No newline at end of file
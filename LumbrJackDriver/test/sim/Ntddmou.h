@@ -0,0 +1,5 @@
+#pragma once
+// Mouse definitions of the device stack simulator. The input data is defined by posix.h.
+#include <ntddk.h>
+
+DEFINE_GUID(GUID_DEVINTERFACE_MOUSE, 0x378de44c, 0x56ef, 0x11d1, 0xbc, 0x8c, 0x00, 0xa0, 0xc9, 0x14, 0x05, 0xdd);
\ No newline at end of file
@@ -0,0 +1,2 @@
+#pragma once
+// GUIDs of the device stack simulator are defined wherever they are used (see DEFINE_GUID in ntddk.h).
\ No newline at end of file
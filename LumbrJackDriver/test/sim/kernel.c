@@ -0,0 +1,737 @@
+#include "kernel.h"
+#include <wdmguid.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define MAX_DRIVERS 0x4
+#define MAX_NOTIFICATIONS 0x4
+
+SimCounters simCounters;
+
+// Device object with the parts the object manager hides from drivers.
+typedef struct SimDevice {
+	DEVICE_OBJECT device;
+	DEVOBJ_EXTENSION deviceObjectExtension;
+	// Set by IoDeleteDevice while another device is attached. The device is freed once it is detached.
+	BOOLEAN isDeletePending;
+	USHORT nameLength;
+	WCHAR name[SIM_NAME_LENGTH];
+	// The device extension follows.
+	ULONGLONG extension[];
+}SimDevice;
+
+typedef struct SimDriver {
+	DRIVER_OBJECT driver;
+	WCHAR name[SIM_NAME_LENGTH];
+}SimDriver;
+
+typedef struct Notification {
+	GUID interfaceClassGuid;
+	PDRIVER_NOTIFICATION_CALLBACK_ROUTINE pCallbackRoutine;
+	PVOID pContext;
+	BOOLEAN isUsed;
+}Notification;
+
+// Protects the device lists of the drivers, the device stacks, the named drivers and the notifications, like the I/O database lock.
+// Drivers walk their device lists without it, so they have to serialize the walks with their own changes of the lists.
+static pthread_mutex_t databaseLock = PTHREAD_MUTEX_INITIALIZER;
+static PDRIVER_OBJECT drivers[MAX_DRIVERS];
+static Notification notifications[MAX_NOTIFICATIONS];
+static struct _OBJECT_TYPE* driverObjectType;
+POBJECT_TYPE* IoDriverObjectType = &driverObjectType;
+
+static NTSTATUS dispatchInvalidDeviceRequest(PDEVICE_OBJECT pDeviceObject, PIRP pIrp);
+static void freeDevice(SimDevice* pSimDevice);
+static void* runThread(void* pContext);
+
+void bugCheck(const char* function, const char* message) {
+	fprintf(stderr, "%s: %s\n", function, message);
+	abort();
+
+	return;
+}
+
+
+void initName(PUNICODE_STRING pName, WCHAR* buffer, USHORT length, const char* name) {
+	USHORT i = 0;
+
+	for (; name[i] && i < length - 1; i++) {
+		buffer[i] = (WCHAR)(UCHAR)name[i];
+	}
+
+	buffer[i] = L'\0';
+	pName->Buffer = buffer;
+	pName->Length = (USHORT)(i * sizeof(WCHAR));
+	pName->MaximumLength = (USHORT)(length * sizeof(WCHAR));
+
+	return;
+}
+
+
+PDRIVER_OBJECT createDriverObject(const char* name) {
+	SimDriver* const pSimDriver = (SimDriver*)calloc(1, sizeof(SimDriver));
+
+	if (!pSimDriver) {
+
+		return NULL;
+	}
+
+	const PDRIVER_OBJECT pDriverObject = &pSimDriver->driver;
+	initName(&pDriverObject->DriverName, pSimDriver->name, ARRAYSIZE(pSimDriver->name), name);
+
+	for (int i = 0; i <= IRP_MJ_MAXIMUM_FUNCTION; i++) {
+		pDriverObject->MajorFunction[i] = dispatchInvalidDeviceRequest;
+	}
+
+	pthread_mutex_lock(&databaseLock);
+
+	for (int i = 0; i < MAX_DRIVERS; i++) {
+
+		if (drivers[i]) continue;
+
+		drivers[i] = pDriverObject;
+		pthread_mutex_unlock(&databaseLock);
+
+		return pDriverObject;
+	}
+
+	pthread_mutex_unlock(&databaseLock);
+	free(pSimDriver);
+
+	return NULL;
+}
+
+
+void deleteDriverObject(PDRIVER_OBJECT pDriverObject) {
+
+	if (pDriverObject->DeviceObject) {
+		fprintf(stderr, "deleteDriverObject: Driver still has devices\n");
+
+		return;
+	}
+
+	pthread_mutex_lock(&databaseLock);
+
+	for (int i = 0; i < MAX_DRIVERS; i++) {
+
+		if (drivers[i] == pDriverObject) {
+			drivers[i] = NULL;
+		}
+
+	}
+
+	pthread_mutex_unlock(&databaseLock);
+	free(CONTAINING_RECORD(pDriverObject, SimDriver, driver));
+
+	return;
+}
+
+
+void notifyInterfaceArrival(const GUID* pInterfaceClassGuid) {
+	DEVICE_INTERFACE_CHANGE_NOTIFICATION notification = { 0 };
+	notification.Version = 1;
+	notification.Size = sizeof(notification);
+	notification.Event = GUID_DEVICE_INTERFACE_ARRIVAL;
+	notification.InterfaceClassGuid = *pInterfaceClassGuid;
+
+	for (int i = 0; i < MAX_NOTIFICATIONS; i++) {
+		pthread_mutex_lock(&databaseLock);
+		const Notification registration = notifications[i];
+		pthread_mutex_unlock(&databaseLock);
+
+		// the callbacks attach devices, so they are called without the lock
+		if (registration.isUsed && IsEqualGUID(&registration.interfaceClassGuid, pInterfaceClassGuid)) {
+			registration.pCallbackRoutine(&notification, registration.pContext);
+		}
+
+	}
+
+	return;
+}
+
+
+PVOID ExAllocatePool2(ULONGLONG flags, SIZE_T size, ULONG tag) {
+	UNREFERENCED_PARAMETER(flags);
+
+	const PVOID pMemory = platformAllocate(size, tag);
+
+	if (pMemory) {
+		__atomic_add_fetch(&simCounters.allocations, 1, __ATOMIC_RELAXED);
+	}
+
+	return pMemory;
+}
+
+
+void ExFreePoolWithTag(PVOID pMemory, ULONG tag) {
+	__atomic_sub_fetch(&simCounters.allocations, 1, __ATOMIC_RELAXED);
+	platformFree(pMemory, tag);
+
+	return;
+}
+
+
+void KeInitializeSemaphore(PKSEMAPHORE pSemaphore, LONG count, LONG limit) {
+	pSemaphore->Header.Type = SemaphoreObject;
+	platformInitSemaphore(&pSemaphore->semaphore, count, limit);
+
+	return;
+}
+
+
+// The previous count is not used by the driver.
+LONG KeReleaseSemaphore(PKSEMAPHORE pSemaphore, KPRIORITY increment, LONG adjustment, BOOLEAN wait) {
+	UNREFERENCED_PARAMETER(increment);
+	UNREFERENCED_PARAMETER(wait);
+
+	if (adjustment != 1) {
+		bugCheck("KeReleaseSemaphore", "Only adjustments of one are simulated");
+	}
+
+	platformReleaseSemaphore(&pSemaphore->semaphore);
+
+	return 0;
+}
+
+
+NTSTATUS KeWaitForSingleObject(PVOID pObject, KWAIT_REASON waitReason, KPROCESSOR_MODE waitMode, BOOLEAN alertable, PLARGE_INTEGER pTimeout) {
+	UNREFERENCED_PARAMETER(waitReason);
+	UNREFERENCED_PARAMETER(waitMode);
+	UNREFERENCED_PARAMETER(alertable);
+
+	if (pTimeout && pTimeout->QuadPart) {
+		bugCheck("KeWaitForSingleObject", "Only infinite and zero timeouts are simulated");
+	}
+
+	const BOOLEAN isBlocking = !pTimeout;
+
+	switch (((DISPATCHER_HEADER*)pObject)->Type) {
+	case SemaphoreObject:
+
+		return platformWaitSemaphore(&((PKSEMAPHORE)pObject)->semaphore, isBlocking);
+	case ThreadObject:
+	{
+		const PKTHREAD pThread = (PKTHREAD)pObject;
+
+		if (!isBlocking) {
+
+			return __atomic_load_n(&pThread->isTerminated, __ATOMIC_ACQUIRE) ? STATUS_SUCCESS : STATUS_TIMEOUT;
+		}
+
+		if (!pThread->isJoined) {
+			pthread_join(pThread->thread, NULL);
+			pThread->isJoined = TRUE;
+		}
+
+		return STATUS_SUCCESS;
+	}
+	default:
+		bugCheck("KeWaitForSingleObject", "Unknown dispatcher object");
+	}
+
+	return STATUS_UNSUCCESSFUL;
+}
+
+
+NTSTATUS createThread(void (*pStartRoutine)(PVOID), PVOID pStartContext, PKTHREAD* ppThread) {
+	const PKTHREAD pThread = (PKTHREAD)calloc(1, sizeof(KTHREAD));
+
+	if (!pThread) {
+
+		return STATUS_INSUFFICIENT_RESOURCES;
+	}
+
+	pThread->Header.Type = ThreadObject;
+	pThread->pStartRoutine = pStartRoutine;
+	pThread->pStartContext = pStartContext;
+
+	if (pthread_create(&pThread->thread, NULL, runThread, pThread)) {
+		free(pThread);
+
+		return STATUS_INSUFFICIENT_RESOURCES;
+	}
+
+	*ppThread = pThread;
+
+	return STATUS_SUCCESS;
+}
+
+
+void ExInitializeFastMutex(FAST_MUTEX* pFastMutex) {
+	pthread_mutex_init(pFastMutex, NULL);
+
+	return;
+}
+
+
+void ExAcquireFastMutex(FAST_MUTEX* pFastMutex) {
+	pthread_mutex_lock(pFastMutex);
+
+	return;
+}
+
+
+void ExReleaseFastMutex(FAST_MUTEX* pFastMutex) {
+	pthread_mutex_unlock(pFastMutex);
+
+	return;
+}
+
+
+PIRP IoAllocateIrp(CCHAR stackSize, BOOLEAN chargeQuota) {
+	UNREFERENCED_PARAMETER(chargeQuota);
+
+	const PIRP pIrp = (PIRP)calloc(1, sizeof(IRP) + stackSize * sizeof(IO_STACK_LOCATION));
+
+	if (!pIrp) {
+
+		return NULL;
+	}
+
+	pIrp->StackCount = stackSize;
+	pIrp->CurrentLocation = stackSize + 1;
+	pIrp->Tail.Overlay.CurrentStackLocation = (PIO_STACK_LOCATION)(pIrp + 1) + stackSize;
+	__atomic_add_fetch(&simCounters.irps, 1, __ATOMIC_RELAXED);
+
+	return pIrp;
+}
+
+
+void IoFreeIrp(PIRP pIrp) {
+	__atomic_sub_fetch(&simCounters.irps, 1, __ATOMIC_RELAXED);
+	free(pIrp);
+
+	return;
+}
+
+
+NTSTATUS IoCallDriver(PDEVICE_OBJECT pDeviceObject, PIRP pIrp) {
+	IoSetNextIrpStackLocation(pIrp);
+
+	if (pIrp->CurrentLocation <= 0) {
+		bugCheck("IoCallDriver", "No stack location left");
+	}
+
+	const PIO_STACK_LOCATION pStackLocation = IoGetCurrentIrpStackLocation(pIrp);
+	pStackLocation->DeviceObject = pDeviceObject;
+
+	return pDeviceObject->DriverObject->MajorFunction[pStackLocation->MajorFunction](pDeviceObject, pIrp);
+}
+
+
+// Calls the completion routines from the current stack location up. Every request of the simulation has an owner,
+// whose completion routine at the top of the stack returns STATUS_MORE_PROCESSING_REQUIRED and frees the request.
+void IofCompleteRequest(PIRP pIrp, CCHAR priorityBoost) {
+	UNREFERENCED_PARAMETER(priorityBoost);
+
+	if (pIrp->IoStatus.Status == STATUS_PENDING) {
+		bugCheck("IofCompleteRequest", "Request completed with STATUS_PENDING");
+	}
+
+	if (pIrp->CurrentLocation > pIrp->StackCount) {
+		bugCheck("IofCompleteRequest", "Request completed twice");
+	}
+
+	while (pIrp->CurrentLocation <= pIrp->StackCount) {
+		const PIO_STACK_LOCATION pStackLocation = IoGetCurrentIrpStackLocation(pIrp);
+		pIrp->PendingReturned = (pStackLocation->Control & SL_PENDING_RETURNED) != 0;
+		UCHAR invokeFlag = SL_INVOKE_ON_SUCCESS;
+
+		if (!NT_SUCCESS(pIrp->IoStatus.Status)) {
+			invokeFlag = pIrp->Cancel ? SL_INVOKE_ON_CANCEL : SL_INVOKE_ON_ERROR;
+		}
+
+		const PIO_COMPLETION_ROUTINE pCompletionRoutine = pStackLocation->Control & invokeFlag ? pStackLocation->CompletionRoutine : NULL;
+		const PVOID pContext = pStackLocation->Context;
+		IoSkipCurrentIrpStackLocation(pIrp);
+		const BOOLEAN isOwned = pIrp->CurrentLocation <= pIrp->StackCount;
+
+		if (pCompletionRoutine) {
+			// the routine gets the device of the driver that set it
+			const PDEVICE_OBJECT pDeviceObject = isOwned ? IoGetCurrentIrpStackLocation(pIrp)->DeviceObject : NULL;
+
+			if (pCompletionRoutine(pDeviceObject, pIrp, pContext) == STATUS_MORE_PROCESSING_REQUIRED) return;
+
+		}
+		else if (pIrp->PendingReturned && isOwned) {
+			IoMarkIrpPending(pIrp);
+		}
+
+	}
+
+	bugCheck("IofCompleteRequest", "Request without owner completed");
+
+	return;
+}
+
+
+NTSTATUS IoCreateDevice(PDRIVER_OBJECT pDriverObject, ULONG deviceExtensionSize, PUNICODE_STRING pDeviceName, ULONG deviceType, ULONG deviceCharacteristics, BOOLEAN exclusive, PDEVICE_OBJECT* ppDeviceObject) {
+	UNREFERENCED_PARAMETER(deviceCharacteristics);
+	UNREFERENCED_PARAMETER(exclusive);
+
+	SimDevice* const pSimDevice = (SimDevice*)calloc(1, sizeof(SimDevice) + deviceExtensionSize);
+
+	if (!pSimDevice) {
+
+		return STATUS_INSUFFICIENT_RESOURCES;
+	}
+
+	const PDEVICE_OBJECT pDeviceObject = &pSimDevice->device;
+	pDeviceObject->DriverObject = pDriverObject;
+	pDeviceObject->Flags = DO_DEVICE_INITIALIZING;
+	pDeviceObject->DeviceExtension = deviceExtensionSize ? pSimDevice->extension : NULL;
+	pDeviceObject->DeviceType = deviceType;
+	pDeviceObject->StackSize = 1;
+	pDeviceObject->DeviceObjectExtension = &pSimDevice->deviceObjectExtension;
+	pSimDevice->deviceObjectExtension.DeviceObject = pDeviceObject;
+
+	if (pDeviceName) {
+		pSimDevice->nameLength = (USHORT)min(pDeviceName->Length / sizeof(WCHAR), ARRAYSIZE(pSimDevice->name));
+		RtlCopyMemory(pSimDevice->name, pDeviceName->Buffer, pSimDevice->nameLength * sizeof(WCHAR));
+	}
+
+	pthread_mutex_lock(&databaseLock);
+	pDeviceObject->NextDevice = pDriverObject->DeviceObject;
+	pDriverObject->DeviceObject = pDeviceObject;
+	pthread_mutex_unlock(&databaseLock);
+
+	__atomic_add_fetch(&simCounters.devices, 1, __ATOMIC_RELAXED);
+	*ppDeviceObject = pDeviceObject;
+
+	return STATUS_SUCCESS;
+}
+
+
+void IoDeleteDevice(PDEVICE_OBJECT pDeviceObject) {
+	SimDevice* const pSimDevice = CONTAINING_RECORD(pDeviceObject, SimDevice, device);
+	pthread_mutex_lock(&databaseLock);
+
+	if (pDeviceObject->DeviceObjectExtension->AttachedTo) {
+		bugCheck("IoDeleteDevice", "Device is still attached");
+	}
+
+	PDEVICE_OBJECT* ppCurDevice = &pDeviceObject->DriverObject->DeviceObject;
+
+	while (*ppCurDevice != pDeviceObject) {
+
+		if (!*ppCurDevice) {
+			bugCheck("IoDeleteDevice", "Device is not in the device list of its driver");
+		}
+
+		ppCurDevice = &(*ppCurDevice)->NextDevice;
+	}
+
+	*ppCurDevice = pDeviceObject->NextDevice;
+	const BOOLEAN isAttachedTo = pDeviceObject->AttachedDevice != NULL;
+	pSimDevice->isDeletePending = isAttachedTo;
+	pthread_mutex_unlock(&databaseLock);
+
+	if (!isAttachedTo) {
+		freeDevice(pSimDevice);
+	}
+
+	return;
+}
+
+
+NTSTATUS IoAttachDeviceToDeviceStackSafe(PDEVICE_OBJECT pSourceDevice, PDEVICE_OBJECT pTargetDevice, PDEVICE_OBJECT* ppAttachedToDeviceObject) {
+	pthread_mutex_lock(&databaseLock);
+	PDEVICE_OBJECT pTopDevice = pTargetDevice;
+
+	while (pTopDevice->AttachedDevice) {
+		pTopDevice = pTopDevice->AttachedDevice;
+	}
+
+	if (CONTAINING_RECORD(pTopDevice, SimDevice, device)->isDeletePending) {
+		pthread_mutex_unlock(&databaseLock);
+		*ppAttachedToDeviceObject = NULL;
+
+		return STATUS_DELETE_PENDING;
+	}
+
+	*ppAttachedToDeviceObject = pTopDevice;
+	pSourceDevice->StackSize = pTopDevice->StackSize + 1;
+	pSourceDevice->DeviceObjectExtension->AttachedTo = pTopDevice;
+	pTopDevice->AttachedDevice = pSourceDevice;
+	pthread_mutex_unlock(&databaseLock);
+
+	return STATUS_SUCCESS;
+}
+
+
+void IoDetachDevice(PDEVICE_OBJECT pTargetDevice) {
+	SimDevice* const pSimTargetDevice = CONTAINING_RECORD(pTargetDevice, SimDevice, device);
+	pthread_mutex_lock(&databaseLock);
+	const PDEVICE_OBJECT pAttachedDevice = pTargetDevice->AttachedDevice;
+
+	if (!pAttachedDevice) {
+		bugCheck("IoDetachDevice", "No device attached");
+	}
+
+	pAttachedDevice->DeviceObjectExtension->AttachedTo = NULL;
+	pTargetDevice->AttachedDevice = NULL;
+	const BOOLEAN isDeleted = pSimTargetDevice->isDeletePending;
+	pthread_mutex_unlock(&databaseLock);
+
+	if (isDeleted) {
+		freeDevice(pSimTargetDevice);
+	}
+
+	return;
+}
+
+
+PDEVICE_OBJECT IoGetAttachedDevice(PDEVICE_OBJECT pDeviceObject) {
+	pthread_mutex_lock(&databaseLock);
+	PDEVICE_OBJECT pTopDevice = pDeviceObject;
+
+	while (pTopDevice->AttachedDevice) {
+		pTopDevice = pTopDevice->AttachedDevice;
+	}
+
+	pthread_mutex_unlock(&databaseLock);
+
+	return pTopDevice;
+}
+
+
+// Symbolic links are not resolved by the simulation.
+NTSTATUS IoCreateSymbolicLink(PUNICODE_STRING pSymbolicLinkName, PUNICODE_STRING pDeviceName) {
+	UNREFERENCED_PARAMETER(pSymbolicLinkName);
+	UNREFERENCED_PARAMETER(pDeviceName);
+
+	return STATUS_SUCCESS;
+}
+
+
+NTSTATUS IoDeleteSymbolicLink(PUNICODE_STRING pSymbolicLinkName) {
+	UNREFERENCED_PARAMETER(pSymbolicLinkName);
+
+	return STATUS_SUCCESS;
+}
+
+
+void IoInitializeRemoveLock(PIO_REMOVE_LOCK pLock, ULONG allocateTag, ULONG maxLockedMinutes, ULONG highWatermark) {
+	UNREFERENCED_PARAMETER(allocateTag);
+	UNREFERENCED_PARAMETER(maxLockedMinutes);
+	UNREFERENCED_PARAMETER(highWatermark);
+
+	pthread_mutex_init(&pLock->mutex, NULL);
+	pthread_cond_init(&pLock->condition, NULL);
+	pLock->ioCount = 1;
+	pLock->isRemoved = FALSE;
+
+	return;
+}
+
+
+NTSTATUS IoAcquireRemoveLock(PIO_REMOVE_LOCK pLock, PVOID pTag) {
+	UNREFERENCED_PARAMETER(pTag);
+
+	pthread_mutex_lock(&pLock->mutex);
+
+	if (pLock->isRemoved) {
+		pthread_mutex_unlock(&pLock->mutex);
+
+		return STATUS_DELETE_PENDING;
+	}
+
+	pLock->ioCount++;
+	pthread_mutex_unlock(&pLock->mutex);
+
+	return STATUS_SUCCESS;
+}
+
+
+void IoReleaseRemoveLock(PIO_REMOVE_LOCK pLock, PVOID pTag) {
+	UNREFERENCED_PARAMETER(pTag);
+
+	pthread_mutex_lock(&pLock->mutex);
+
+	if (--pLock->ioCount < 0) {
+		bugCheck("IoReleaseRemoveLock", "Lock released more often than acquired");
+	}
+
+	if (!pLock->ioCount) {
+		pthread_cond_broadcast(&pLock->condition);
+	}
+
+	pthread_mutex_unlock(&pLock->mutex);
+
+	return;
+}
+
+
+// Releases the acquisition of the caller and the initial count of the owner, then waits until all other acquisitions are released.
+void IoReleaseRemoveLockAndWait(PIO_REMOVE_LOCK pLock, PVOID pTag) {
+	UNREFERENCED_PARAMETER(pTag);
+
+	pthread_mutex_lock(&pLock->mutex);
+	pLock->isRemoved = TRUE;
+	pLock->ioCount -= 2;
+
+	if (pLock->ioCount < 0) {
+		bugCheck("IoReleaseRemoveLockAndWait", "Lock not acquired by the caller");
+	}
+
+	while (pLock->ioCount) {
+		pthread_cond_wait(&pLock->condition, &pLock->mutex);
+	}
+
+	pthread_mutex_unlock(&pLock->mutex);
+
+	return;
+}
+
+
+NTSTATUS NTAPI ObReferenceObjectByName(PUNICODE_STRING pObjectName, ULONG attributes, PACCESS_STATE pAccessState, ACCESS_MASK desiredAccess, POBJECT_TYPE pObjectType, KPROCESSOR_MODE accessMode, PVOID pParseContext, PVOID* ppObject) {
+	UNREFERENCED_PARAMETER(attributes);
+	UNREFERENCED_PARAMETER(pAccessState);
+	UNREFERENCED_PARAMETER(desiredAccess);
+	UNREFERENCED_PARAMETER(pObjectType);
+	UNREFERENCED_PARAMETER(accessMode);
+	UNREFERENCED_PARAMETER(pParseContext);
+
+	pthread_mutex_lock(&databaseLock);
+
+	for (int i = 0; i < MAX_DRIVERS; i++) {
+
+		if (!drivers[i] || drivers[i]->DriverName.Length != pObjectName->Length) continue;
+
+		BOOLEAN isEqual = TRUE;
+
+		// names are case insensitive
+		for (USHORT j = 0; j < pObjectName->Length / sizeof(WCHAR); j++) {
+			isEqual &= (drivers[i]->DriverName.Buffer[j] | 0x20) == (pObjectName->Buffer[j] | 0x20);
+		}
+
+		if (!isEqual) continue;
+
+		__atomic_add_fetch(&simCounters.references, 1, __ATOMIC_RELAXED);
+		*ppObject = drivers[i];
+		pthread_mutex_unlock(&databaseLock);
+
+		return STATUS_SUCCESS;
+	}
+
+	pthread_mutex_unlock(&databaseLock);
+
+	return STATUS_OBJECT_NAME_NOT_FOUND;
+}
+
+
+// Driver objects are only counted, thread objects are freed.
+void ObfDereferenceObject(PVOID pObject) {
+	pthread_mutex_lock(&databaseLock);
+
+	for (int i = 0; i < MAX_DRIVERS; i++) {
+
+		if (drivers[i] == pObject) {
+			__atomic_sub_fetch(&simCounters.references, 1, __ATOMIC_RELAXED);
+			pthread_mutex_unlock(&databaseLock);
+
+			return;
+		}
+
+	}
+
+	pthread_mutex_unlock(&databaseLock);
+	const PKTHREAD pThread = (PKTHREAD)pObject;
+
+	if (pThread->Header.Type != ThreadObject) {
+		bugCheck("ObfDereferenceObject", "Object was not referenced");
+	}
+
+	if (!pThread->isJoined) {
+		pthread_detach(pThread->thread);
+	}
+
+	free(pThread);
+
+	return;
+}
+
+
+// The name follows the structure, like on Windows.
+NTSTATUS ObQueryNameString(PVOID pObject, POBJECT_NAME_INFORMATION pObjectNameInfo, ULONG length, PULONG pReturnLength) {
+	const SimDevice* const pSimDevice = CONTAINING_RECORD((PDEVICE_OBJECT)pObject, SimDevice, device);
+	const ULONG size = (ULONG)(sizeof(OBJECT_NAME_INFORMATION) + (pSimDevice->nameLength + 1) * sizeof(WCHAR));
+	*pReturnLength = size;
+
+	if (length < size) {
+
+		return STATUS_BUFFER_TOO_SMALL;
+	}
+
+	pObjectNameInfo->Name.Buffer = (PWCH)(pObjectNameInfo + 1);
+	pObjectNameInfo->Name.Length = (USHORT)(pSimDevice->nameLength * sizeof(WCHAR));
+	pObjectNameInfo->Name.MaximumLength = (USHORT)(pObjectNameInfo->Name.Length + sizeof(WCHAR));
+	RtlCopyMemory(pObjectNameInfo->Name.Buffer, pSimDevice->name, pObjectNameInfo->Name.Length);
+	pObjectNameInfo->Name.Buffer[pSimDevice->nameLength] = L'\0';
+
+	return STATUS_SUCCESS;
+}
+
+
+NTSTATUS IoRegisterPlugPlayNotification(IO_NOTIFICATION_EVENT_CATEGORY eventCategory, ULONG eventCategoryFlags, PVOID pEventCategoryData, PDRIVER_OBJECT pDriverObject, PDRIVER_NOTIFICATION_CALLBACK_ROUTINE pCallbackRoutine, PVOID pContext, PVOID* ppNotificationEntry) {
+	UNREFERENCED_PARAMETER(eventCategory);
+	UNREFERENCED_PARAMETER(eventCategoryFlags);
+	UNREFERENCED_PARAMETER(pDriverObject);
+
+	pthread_mutex_lock(&databaseLock);
+
+	for (int i = 0; i < MAX_NOTIFICATIONS; i++) {
+
+		if (notifications[i].isUsed) continue;
+
+		notifications[i].interfaceClassGuid = *(const GUID*)pEventCategoryData;
+		notifications[i].pCallbackRoutine = pCallbackRoutine;
+		notifications[i].pContext = pContext;
+		notifications[i].isUsed = TRUE;
+		pthread_mutex_unlock(&databaseLock);
+		*ppNotificationEntry = &notifications[i];
+
+		return STATUS_SUCCESS;
+	}
+
+	pthread_mutex_unlock(&databaseLock);
+
+	return STATUS_INSUFFICIENT_RESOURCES;
+}
+
+
+NTSTATUS IoUnregisterPlugPlayNotificationEx(PVOID pNotificationEntry) {
+	pthread_mutex_lock(&databaseLock);
+	((Notification*)pNotificationEntry)->isUsed = FALSE;
+	pthread_mutex_unlock(&databaseLock);
+
+	return STATUS_SUCCESS;
+}
+
+
+static NTSTATUS dispatchInvalidDeviceRequest(PDEVICE_OBJECT pDeviceObject, PIRP pIrp) {
+	UNREFERENCED_PARAMETER(pDeviceObject);
+
+	pIrp->IoStatus.Status = STATUS_INVALID_DEVICE_REQUEST;
+	pIrp->IoStatus.Information = 0;
+	IofCompleteRequest(pIrp, IO_NO_INCREMENT);
+
+	return STATUS_INVALID_DEVICE_REQUEST;
+}
+
+
+static void freeDevice(SimDevice* pSimDevice) {
+	__atomic_sub_fetch(&simCounters.devices, 1, __ATOMIC_RELAXED);
+	free(pSimDevice);
+
+	return;
+}
+
+
+static void* runThread(void* pContext) {
+	const PKTHREAD pThread = (PKTHREAD)pContext;
+	pThread->pStartRoutine(pThread->pStartContext);
+	__atomic_store_n(&pThread->isTerminated, TRUE, __ATOMIC_RELEASE);
+
+	return NULL;
+}
\ No newline at end of file
@@ -0,0 +1,63 @@
+#pragma once
+#include "sim.h"
+
+// Parts of the simulated kernel that are used by the simulation (sim.c), but not by drivers.
+
+#define SIM_NAME_LENGTH 0x40
+
+extern SimCounters simCounters;
+
+// Aborts the simulation for misuse of the kernel API that would bug check the system.
+//
+// Parameters:
+//
+// [in] function:
+// Name of the kernel function.
+//
+// [in] message:
+// Description of the misuse.
+void bugCheck(const char* function, const char* message);
+
+// Initializes a string with the UTF-16 version of an ASCII name.
+//
+// Parameters:
+//
+// [out] pName:
+// Contains the initialized string on return.
+//
+// [out] buffer:
+// Buffer of the string.
+//
+// [in] length:
+// Length of the buffer in characters. Longer names are truncated.
+//
+// [in] name:
+// ASCII name.
+void initName(PUNICODE_STRING pName, WCHAR* buffer, USHORT length, const char* name);
+
+// Creates a driver object that can be referenced by name. All major functions fail with STATUS_INVALID_DEVICE_REQUEST.
+//
+// Parameters:
+//
+// [in] name:
+// Name of the driver object, e.g. "\Driver\kbdclass".
+//
+// Return:
+// Address of the driver object or NULL if it could not be created.
+PDRIVER_OBJECT createDriverObject(const char* name);
+
+// Deletes a driver object. Driver objects that still have devices are kept and reported.
+//
+// Parameters:
+//
+// [in] pDriverObject:
+// Address of the driver object.
+void deleteDriverObject(PDRIVER_OBJECT pDriverObject);
+
+// Calls the callbacks registered for arrivals of an interface class, like the plug and play manager does for a new device.
+//
+// Parameters:
+//
+// [in] pInterfaceClassGuid:
+// GUID of the interface class of the new device.
+void notifyInterfaceArrival(const GUID* pInterfaceClassGuid);
\ No newline at end of file
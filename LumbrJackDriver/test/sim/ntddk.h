@@ -0,0 +1,349 @@
+#pragma once
+// Kernel API of the device stack simulator. Stands in for the WDK headers, so the filter devices, the dispatch routines
+// and the driver entry (device.c, dispatch.c and entry.c) are built unchanged in user mode on top of the driver core (see posix.h).
+// Models the object manager, the I/O manager and the plug and play manager as far as the driver uses them:
+// device objects and their stacks, IRPs with stack locations and completion routines, remove locks and dispatcher objects.
+// Misuse that would bug check the system, e.g. calling a driver with no stack location left, aborts the simulation.
+// The stand-in class drivers and the control functions of the simulation are declared in sim.h.
+#include "posix.h"
+
+typedef char CCHAR;
+typedef uintptr_t ULONG_PTR;
+typedef PVOID HANDLE;
+typedef ULONG ACCESS_MASK;
+typedef LONG KPRIORITY;
+typedef UCHAR KPROCESSOR_MODE;
+typedef WCHAR* PWCH;
+
+#define NTAPI
+#define KernelMode 0
+#define OBJ_CASE_INSENSITIVE 0x00000040
+
+#define STATUS_PENDING ((NTSTATUS)0x00000103)
+#define STATUS_DEVICE_BUSY ((NTSTATUS)0x80000011)
+#define STATUS_INVALID_DEVICE_REQUEST ((NTSTATUS)0xC0000010)
+#define STATUS_MORE_PROCESSING_REQUIRED ((NTSTATUS)0xC0000016)
+#define STATUS_BUFFER_TOO_SMALL ((NTSTATUS)0xC0000023)
+#define STATUS_OBJECT_NAME_NOT_FOUND ((NTSTATUS)0xC0000034)
+#define STATUS_DELETE_PENDING ((NTSTATUS)0xC0000056)
+#define STATUS_DEVICE_DATA_ERROR ((NTSTATUS)0xC000009C)
+#define STATUS_NOT_SUPPORTED ((NTSTATUS)0xC00000BB)
+
+typedef union _LARGE_INTEGER {
+	LONGLONG QuadPart;
+}LARGE_INTEGER, *PLARGE_INTEGER;
+
+typedef struct _UNICODE_STRING {
+	USHORT Length;
+	USHORT MaximumLength;
+	PWCH Buffer;
+}UNICODE_STRING, *PUNICODE_STRING;
+
+// Wide string literals are UTF-16, since the simulation is built with -fshort-wchar.
+#define RTL_CONSTANT_STRING(s) { sizeof(s) - sizeof((s)[0]), sizeof(s), (PWCH)(s) }
+
+static inline void RtlSecureZeroMemory(PVOID pDestination, SIZE_T length) {
+	volatile UCHAR* pCur = (volatile UCHAR*)pDestination;
+
+	while (length--) {
+		*pCur++ = 0;
+	}
+
+	return;
+}
+
+// GUIDs are defined in every translation unit, so initguid.h is not needed.
+typedef struct _GUID {
+	uint32_t Data1;
+	uint16_t Data2;
+	uint16_t Data3;
+	uint8_t Data4[8];
+}GUID;
+
+#define DEFINE_GUID(name, l, w1, w2, b1, b2, b3, b4, b5, b6, b7, b8) \
+	static const GUID name __attribute__((unused)) = { l, w1, w2, { b1, b2, b3, b4, b5, b6, b7, b8 } }
+#define IsEqualGUID(pGuid1, pGuid2) (!memcmp((pGuid1), (pGuid2), sizeof(GUID)))
+
+// Memory of ExAllocatePool2 is allocated by the platform layer and counted by the simulation.
+#define POOL_FLAG_NON_PAGED 0x0000000000000040ull
+#define POOL_FLAG_PAGED 0x0000000000000100ull
+
+PVOID ExAllocatePool2(ULONGLONG flags, SIZE_T size, ULONG tag);
+void ExFreePoolWithTag(PVOID pMemory, ULONG tag);
+
+// Dispatcher objects. Waits support no timeout or a zero timeout, like the driver uses them.
+typedef enum _KOBJECTS {
+	SemaphoreObject = 5, ThreadObject = 6
+}KOBJECTS;
+
+typedef enum _KWAIT_REASON {
+	Executive
+}KWAIT_REASON;
+
+typedef struct _DISPATCHER_HEADER {
+	KOBJECTS Type;
+}DISPATCHER_HEADER;
+
+typedef struct _KSEMAPHORE {
+	DISPATCHER_HEADER Header;
+	PlatformSemaphore semaphore;
+}KSEMAPHORE, *PKSEMAPHORE;
+
+typedef struct _KTHREAD {
+	DISPATCHER_HEADER Header;
+	pthread_t thread;
+	void (*pStartRoutine)(PVOID pStartContext);
+	PVOID pStartContext;
+	// Set when the start routine returned.
+	BOOLEAN isTerminated;
+	BOOLEAN isJoined;
+}KTHREAD, *PKTHREAD;
+
+void KeInitializeSemaphore(PKSEMAPHORE pSemaphore, LONG count, LONG limit);
+LONG KeReleaseSemaphore(PKSEMAPHORE pSemaphore, KPRIORITY increment, LONG adjustment, BOOLEAN wait);
+NTSTATUS KeWaitForSingleObject(PVOID pObject, KWAIT_REASON waitReason, KPROCESSOR_MODE waitMode, BOOLEAN alertable, PLARGE_INTEGER pTimeout);
+
+typedef pthread_mutex_t FAST_MUTEX;
+
+void ExInitializeFastMutex(FAST_MUTEX* pFastMutex);
+void ExAcquireFastMutex(FAST_MUTEX* pFastMutex);
+void ExReleaseFastMutex(FAST_MUTEX* pFastMutex);
+
+// Major and minor functions of the requests the simulation sends.
+#define IRP_MJ_CREATE 0x00
+#define IRP_MJ_CLOSE 0x02
+#define IRP_MJ_READ 0x03
+#define IRP_MJ_DEVICE_CONTROL 0x0e
+#define IRP_MJ_INTERNAL_DEVICE_CONTROL 0x0f
+#define IRP_MJ_CLEANUP 0x12
+#define IRP_MJ_POWER 0x16
+#define IRP_MJ_PNP 0x1b
+#define IRP_MJ_MAXIMUM_FUNCTION 0x1b
+
+#define IRP_MN_START_DEVICE 0x00
+#define IRP_MN_REMOVE_DEVICE 0x02
+
+#define DO_BUFFERED_IO 0x00000004
+#define DO_DEVICE_INITIALIZING 0x00000080
+#define DO_POWER_PAGABLE 0x00002000
+#define FILE_DEVICE_SECURE_OPEN 0x00000100
+#define IO_NO_INCREMENT 0
+
+struct _DEVICE_OBJECT;
+struct _DRIVER_OBJECT;
+struct _IRP;
+
+typedef NTSTATUS DRIVER_DISPATCH(struct _DEVICE_OBJECT* pDeviceObject, struct _IRP* pIrp);
+typedef DRIVER_DISPATCH* PDRIVER_DISPATCH;
+typedef void DRIVER_UNLOAD(struct _DRIVER_OBJECT* pDriverObject);
+typedef DRIVER_UNLOAD* PDRIVER_UNLOAD;
+typedef NTSTATUS IO_COMPLETION_ROUTINE(struct _DEVICE_OBJECT* pDeviceObject, struct _IRP* pIrp, PVOID pContext);
+typedef IO_COMPLETION_ROUTINE* PIO_COMPLETION_ROUTINE;
+
+// Unset major functions fail requests with STATUS_INVALID_DEVICE_REQUEST like on Windows.
+typedef struct _DRIVER_OBJECT {
+	// Devices of the driver. New devices are inserted at the head.
+	struct _DEVICE_OBJECT* DeviceObject;
+	UNICODE_STRING DriverName;
+	PDRIVER_UNLOAD DriverUnload;
+	PDRIVER_DISPATCH MajorFunction[IRP_MJ_MAXIMUM_FUNCTION + 1];
+}DRIVER_OBJECT, *PDRIVER_OBJECT;
+
+typedef struct _DEVOBJ_EXTENSION {
+	struct _DEVICE_OBJECT* DeviceObject;
+	// Device this device is attached to.
+	struct _DEVICE_OBJECT* AttachedTo;
+}DEVOBJ_EXTENSION, *PDEVOBJ_EXTENSION;
+
+typedef struct _DEVICE_OBJECT {
+	PDRIVER_OBJECT DriverObject;
+	struct _DEVICE_OBJECT* NextDevice;
+	// Device attached to this device.
+	struct _DEVICE_OBJECT* AttachedDevice;
+	ULONG Flags;
+	// NULL if the device was created without an extension.
+	PVOID DeviceExtension;
+	ULONG DeviceType;
+	// Number of stack locations requests to this device need.
+	CCHAR StackSize;
+	PDEVOBJ_EXTENSION DeviceObjectExtension;
+}DEVICE_OBJECT, *PDEVICE_OBJECT;
+
+typedef struct _IO_STATUS_BLOCK {
+	NTSTATUS Status;
+	ULONG_PTR Information;
+}IO_STATUS_BLOCK, *PIO_STATUS_BLOCK;
+
+#define SL_PENDING_RETURNED 0x01
+#define SL_INVOKE_ON_CANCEL 0x20
+#define SL_INVOKE_ON_SUCCESS 0x40
+#define SL_INVOKE_ON_ERROR 0x80
+
+typedef struct _IO_STACK_LOCATION {
+	UCHAR MajorFunction;
+	UCHAR MinorFunction;
+	UCHAR Flags;
+	UCHAR Control;
+	union {
+		struct {
+			ULONG Length;
+		}Read;
+		struct {
+			ULONG OutputBufferLength;
+			ULONG InputBufferLength;
+			ULONG IoControlCode;
+		}DeviceIoControl;
+	}Parameters;
+	PDEVICE_OBJECT DeviceObject;
+	// Set by the driver above, called when the request is completed up to this location.
+	PIO_COMPLETION_ROUTINE CompletionRoutine;
+	PVOID Context;
+}IO_STACK_LOCATION, *PIO_STACK_LOCATION;
+
+// The stack locations follow the IRP. Location StackCount - 1 is used by the first driver called.
+typedef struct _IRP {
+	IO_STATUS_BLOCK IoStatus;
+	union {
+		PVOID SystemBuffer;
+	}AssociatedIrp;
+	BOOLEAN PendingReturned;
+	BOOLEAN Cancel;
+	CCHAR StackCount;
+	// One based index of the current stack location. StackCount + 1 before the first driver is called.
+	CCHAR CurrentLocation;
+	struct {
+		struct {
+			// Lets the owner of a pending request queue it.
+			LIST_ENTRY ListEntry;
+			PIO_STACK_LOCATION CurrentStackLocation;
+		}Overlay;
+	}Tail;
+}IRP, *PIRP;
+
+static inline PIO_STACK_LOCATION IoGetCurrentIrpStackLocation(PIRP pIrp) {
+
+	return pIrp->Tail.Overlay.CurrentStackLocation;
+}
+
+
+static inline PIO_STACK_LOCATION IoGetNextIrpStackLocation(PIRP pIrp) {
+
+	return pIrp->Tail.Overlay.CurrentStackLocation - 1;
+}
+
+
+static inline void IoSetNextIrpStackLocation(PIRP pIrp) {
+	pIrp->CurrentLocation--;
+	pIrp->Tail.Overlay.CurrentStackLocation--;
+
+	return;
+}
+
+
+static inline void IoSkipCurrentIrpStackLocation(PIRP pIrp) {
+	pIrp->CurrentLocation++;
+	pIrp->Tail.Overlay.CurrentStackLocation++;
+
+	return;
+}
+
+
+// The completion routine of the current location is not copied.
+static inline void IoCopyCurrentIrpStackLocationToNext(PIRP pIrp) {
+	const PIO_STACK_LOCATION pStackLocation = IoGetCurrentIrpStackLocation(pIrp);
+	const PIO_STACK_LOCATION pNextStackLocation = IoGetNextIrpStackLocation(pIrp);
+	RtlCopyMemory(pNextStackLocation, pStackLocation, offsetof(IO_STACK_LOCATION, CompletionRoutine));
+	pNextStackLocation->Control = 0;
+
+	return;
+}
+
+
+static inline void IoSetCompletionRoutine(PIRP pIrp, PIO_COMPLETION_ROUTINE pCompletionRoutine, PVOID pContext, BOOLEAN invokeOnSuccess, BOOLEAN invokeOnError, BOOLEAN invokeOnCancel) {
+	const PIO_STACK_LOCATION pNextStackLocation = IoGetNextIrpStackLocation(pIrp);
+	pNextStackLocation->CompletionRoutine = pCompletionRoutine;
+	pNextStackLocation->Context = pContext;
+	pNextStackLocation->Control = 0;
+
+	if (invokeOnSuccess) {
+		pNextStackLocation->Control |= SL_INVOKE_ON_SUCCESS;
+	}
+
+	if (invokeOnError) {
+		pNextStackLocation->Control |= SL_INVOKE_ON_ERROR;
+	}
+
+	if (invokeOnCancel) {
+		pNextStackLocation->Control |= SL_INVOKE_ON_CANCEL;
+	}
+
+	return;
+}
+
+
+static inline void IoMarkIrpPending(PIRP pIrp) {
+	IoGetCurrentIrpStackLocation(pIrp)->Control |= SL_PENDING_RETURNED;
+
+	return;
+}
+
+
+PIRP IoAllocateIrp(CCHAR stackSize, BOOLEAN chargeQuota);
+void IoFreeIrp(PIRP pIrp);
+NTSTATUS IoCallDriver(PDEVICE_OBJECT pDeviceObject, PIRP pIrp);
+void IofCompleteRequest(PIRP pIrp, CCHAR priorityBoost);
+
+NTSTATUS IoCreateDevice(PDRIVER_OBJECT pDriverObject, ULONG deviceExtensionSize, PUNICODE_STRING pDeviceName, ULONG deviceType, ULONG deviceCharacteristics, BOOLEAN exclusive, PDEVICE_OBJECT* ppDeviceObject);
+// Devices that are still attached to are deleted when they are detached.
+void IoDeleteDevice(PDEVICE_OBJECT pDeviceObject);
+NTSTATUS IoAttachDeviceToDeviceStackSafe(PDEVICE_OBJECT pSourceDevice, PDEVICE_OBJECT pTargetDevice, PDEVICE_OBJECT* ppAttachedToDeviceObject);
+void IoDetachDevice(PDEVICE_OBJECT pTargetDevice);
+PDEVICE_OBJECT IoGetAttachedDevice(PDEVICE_OBJECT pDeviceObject);
+NTSTATUS IoCreateSymbolicLink(PUNICODE_STRING pSymbolicLinkName, PUNICODE_STRING pDeviceName);
+NTSTATUS IoDeleteSymbolicLink(PUNICODE_STRING pSymbolicLinkName);
+
+typedef struct _IO_REMOVE_LOCK {
+	pthread_mutex_t mutex;
+	pthread_cond_t condition;
+	// Starts at one for the owner of the lock.
+	LONG ioCount;
+	BOOLEAN isRemoved;
+}IO_REMOVE_LOCK, *PIO_REMOVE_LOCK;
+
+void IoInitializeRemoveLock(PIO_REMOVE_LOCK pLock, ULONG allocateTag, ULONG maxLockedMinutes, ULONG highWatermark);
+NTSTATUS IoAcquireRemoveLock(PIO_REMOVE_LOCK pLock, PVOID pTag);
+void IoReleaseRemoveLock(PIO_REMOVE_LOCK pLock, PVOID pTag);
+void IoReleaseRemoveLockAndWait(PIO_REMOVE_LOCK pLock, PVOID pTag);
+
+// Object manager. Only driver objects can be referenced by name and only device objects have names.
+typedef struct _OBJECT_TYPE* POBJECT_TYPE;
+typedef struct _ACCESS_STATE* PACCESS_STATE;
+
+typedef struct _OBJECT_NAME_INFORMATION {
+	UNICODE_STRING Name;
+}OBJECT_NAME_INFORMATION, *POBJECT_NAME_INFORMATION;
+
+extern POBJECT_TYPE* IoDriverObjectType;
+
+NTSTATUS NTAPI ObReferenceObjectByName(PUNICODE_STRING pObjectName, ULONG attributes, PACCESS_STATE pAccessState, ACCESS_MASK desiredAccess, POBJECT_TYPE pObjectType, KPROCESSOR_MODE accessMode, PVOID pParseContext, PVOID* ppObject);
+void ObfDereferenceObject(PVOID pObject);
+NTSTATUS ObQueryNameString(PVOID pObject, POBJECT_NAME_INFORMATION pObjectNameInfo, ULONG length, PULONG pReturnLength);
+
+// Plug and play notifications. Only arrivals of device interfaces are sent.
+typedef enum _IO_NOTIFICATION_EVENT_CATEGORY {
+	EventCategoryDeviceInterfaceChange = 2
+}IO_NOTIFICATION_EVENT_CATEGORY;
+
+typedef NTSTATUS DRIVER_NOTIFICATION_CALLBACK_ROUTINE(PVOID pNotificationStructure, PVOID pContext);
+typedef DRIVER_NOTIFICATION_CALLBACK_ROUTINE* PDRIVER_NOTIFICATION_CALLBACK_ROUTINE;
+
+typedef struct _DEVICE_INTERFACE_CHANGE_NOTIFICATION {
+	USHORT Version;
+	USHORT Size;
+	GUID Event;
+	GUID InterfaceClassGuid;
+	PUNICODE_STRING SymbolicLinkName;
+}DEVICE_INTERFACE_CHANGE_NOTIFICATION, *PDEVICE_INTERFACE_CHANGE_NOTIFICATION;
+
+NTSTATUS IoRegisterPlugPlayNotification(IO_NOTIFICATION_EVENT_CATEGORY eventCategory, ULONG eventCategoryFlags, PVOID pEventCategoryData, PDRIVER_OBJECT pDriverObject, PDRIVER_NOTIFICATION_CALLBACK_ROUTINE pCallbackRoutine, PVOID pContext, PVOID* ppNotificationEntry);
+NTSTATUS IoUnregisterPlugPlayNotificationEx(PVOID pNotificationEntry);
\ No newline at end of file
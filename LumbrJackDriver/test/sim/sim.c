@@ -0,0 +1,414 @@
+#include "kernel.h"
+#include <Ntddkbd.h>
+#include <Ntddmou.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Device extension of the class devices.
+typedef struct ClassDevExtension {
+	pthread_mutex_t lock;
+	// Reads waiting for input, queued by their list entry.
+	LIST_ENTRY pendingReads;
+	BOOLEAN isRemoved;
+	// Input is numbered in ExtraInformation, so the raw input thread can check it.
+	ULONG sentInput;
+	ULONG receivedInput;
+	ULONG receivedRequests[IRP_MJ_MAXIMUM_FUNCTION + 1];
+}ClassDevExtension;
+
+// Owner of a request sent by sendRequest.
+typedef struct Request {
+	BOOLEAN isCompleted;
+	NTSTATUS status;
+}Request;
+
+static PDRIVER_OBJECT pKbdClassDriver;
+static PDRIVER_OBJECT pMouClassDriver;
+static ULONG kbdUnits;
+static ULONG mouUnits;
+static volatile BOOLEAN isReading = TRUE;
+
+static NTSTATUS dispatchClassRead(PDEVICE_OBJECT pDeviceObject, PIRP pIrp);
+static NTSTATUS dispatchClassPnp(PDEVICE_OBJECT pDeviceObject, PIRP pIrp);
+static NTSTATUS dispatchClassRequest(PDEVICE_OBJECT pDeviceObject, PIRP pIrp);
+static PIRP allocateRequest(PDEVICE_OBJECT pTopDevice, UCHAR majorFunction, UCHAR minorFunction, PVOID buffer);
+static void sendRead(PDEVICE_OBJECT pClassDevice);
+static NTSTATUS completeRead(PDEVICE_OBJECT pDeviceObject, PIRP pIrp, PVOID pContext);
+static NTSTATUS completeRequest(PDEVICE_OBJECT pDeviceObject, PIRP pIrp, PVOID pContext);
+static BOOLEAN isExpectedInput(const PDEVICE_OBJECT pClassDevice, const PIRP pIrp, ULONG index, ULONG number);
+
+void initSimulation() {
+	pKbdClassDriver = createDriverObject("\\Driver\\kbdclass");
+	pMouClassDriver = createDriverObject("\\Driver\\mouclass");
+
+	if (!pKbdClassDriver || !pMouClassDriver) {
+		bugCheck("initSimulation", "Class drivers not created");
+	}
+
+	for (int i = 0; i <= IRP_MJ_MAXIMUM_FUNCTION; i++) {
+		pKbdClassDriver->MajorFunction[i] = dispatchClassRequest;
+		pMouClassDriver->MajorFunction[i] = dispatchClassRequest;
+	}
+
+	pKbdClassDriver->MajorFunction[IRP_MJ_READ] = dispatchClassRead;
+	pMouClassDriver->MajorFunction[IRP_MJ_READ] = dispatchClassRead;
+	pKbdClassDriver->MajorFunction[IRP_MJ_PNP] = dispatchClassPnp;
+	pMouClassDriver->MajorFunction[IRP_MJ_PNP] = dispatchClassPnp;
+
+	return;
+}
+
+
+NTSTATUS loadDriver(PDRIVER_OBJECT* ppDriverObject) {
+	const PDRIVER_OBJECT pDriverObject = createDriverObject("\\Driver\\LumbrJack");
+
+	if (!pDriverObject) {
+
+		return STATUS_INSUFFICIENT_RESOURCES;
+	}
+
+	UNICODE_STRING registryPath = RTL_CONSTANT_STRING(L"\\Registry\\Machine\\System\\CurrentControlSet\\Services\\LumbrJack");
+	const NTSTATUS ntStatus = DriverEntry(pDriverObject, &registryPath);
+
+	if (!NT_SUCCESS(ntStatus)) {
+		deleteDriverObject(pDriverObject);
+
+		return ntStatus;
+	}
+
+	*ppDriverObject = pDriverObject;
+
+	return ntStatus;
+}
+
+
+void unloadDriver(PDRIVER_OBJECT pDriverObject) {
+	pDriverObject->DriverUnload(pDriverObject);
+	deleteDriverObject(pDriverObject);
+
+	return;
+}
+
+
+PDEVICE_OBJECT addClassDevice(ULONG deviceType) {
+	const BOOLEAN isKeyboard = deviceType == FILE_DEVICE_KEYBOARD;
+	char asciiName[SIM_NAME_LENGTH] = { 0 };
+	snprintf(asciiName, sizeof(asciiName), isKeyboard ? "\\Device\\KeyboardClass%lu" : "\\Device\\PointerClass%lu", isKeyboard ? kbdUnits++ : mouUnits++);
+	WCHAR buffer[SIM_NAME_LENGTH] = { 0 };
+	UNICODE_STRING name = { 0 };
+	initName(&name, buffer, ARRAYSIZE(buffer), asciiName);
+	PDEVICE_OBJECT pClassDevice = NULL;
+
+	if (!NT_SUCCESS(IoCreateDevice(isKeyboard ? pKbdClassDriver : pMouClassDriver, sizeof(ClassDevExtension), &name, deviceType, 0, FALSE, &pClassDevice))) {
+
+		return NULL;
+	}
+
+	ClassDevExtension* const pClassDevExtension = (ClassDevExtension*)pClassDevice->DeviceExtension;
+	pthread_mutex_init(&pClassDevExtension->lock, NULL);
+	InitializeListHead(&pClassDevExtension->pendingReads);
+	pClassDevice->Flags &= ~DO_DEVICE_INITIALIZING;
+	notifyInterfaceArrival(isKeyboard ? &GUID_DEVINTERFACE_KEYBOARD : &GUID_DEVINTERFACE_MOUSE);
+
+	// the raw input thread opens the device once its interface arrived
+	sendRequest(pClassDevice, IRP_MJ_CREATE, 0, 0, NULL, 0, 0);
+	sendRead(pClassDevice);
+
+	return pClassDevice;
+}
+
+
+void removeClassDevice(PDEVICE_OBJECT pClassDevice) {
+	sendRequest(pClassDevice, IRP_MJ_PNP, IRP_MN_REMOVE_DEVICE, 0, NULL, 0, 0);
+
+	return;
+}
+
+
+ULONG sendInput(PDEVICE_OBJECT pClassDevice, ULONG count) {
+	ClassDevExtension* const pClassDevExtension = (ClassDevExtension*)pClassDevice->DeviceExtension;
+	pthread_mutex_lock(&pClassDevExtension->lock);
+
+	if (IsListEmpty(&pClassDevExtension->pendingReads)) {
+		pthread_mutex_unlock(&pClassDevExtension->lock);
+
+		return 0;
+	}
+
+	const PIRP pIrp = CONTAINING_RECORD(RemoveHeadList(&pClassDevExtension->pendingReads), IRP, Tail.Overlay.ListEntry);
+	const BOOLEAN isKeyboard = pClassDevice->DeviceType == FILE_DEVICE_KEYBOARD;
+	const ULONG size = isKeyboard ? sizeof(KEYBOARD_INPUT_DATA) : sizeof(MOUSE_INPUT_DATA);
+	count = min(count, IoGetCurrentIrpStackLocation(pIrp)->Parameters.Read.Length / size);
+	const ULONG first = pClassDevExtension->sentInput;
+	pClassDevExtension->sentInput += count;
+	pthread_mutex_unlock(&pClassDevExtension->lock);
+
+	for (ULONG i = 0; i < count; i++) {
+		const ULONG number = first + i;
+
+		if (isKeyboard) {
+			KEYBOARD_INPUT_DATA* const pKbdInputData = (KEYBOARD_INPUT_DATA*)pIrp->AssociatedIrp.SystemBuffer + i;
+			pKbdInputData->MakeCode = 0x1e;
+			pKbdInputData->Flags = number % 2 ? KEY_BREAK : KEY_MAKE;
+			pKbdInputData->ExtraInformation = number;
+		}
+		else {
+			MOUSE_INPUT_DATA* const pMouInputData = (MOUSE_INPUT_DATA*)pIrp->AssociatedIrp.SystemBuffer + i;
+			pMouInputData->ButtonFlags = number % 2 ? MOUSE_LEFT_BUTTON_UP : MOUSE_LEFT_BUTTON_DOWN;
+			pMouInputData->ExtraInformation = number;
+		}
+
+	}
+
+	pIrp->IoStatus.Status = STATUS_SUCCESS;
+	pIrp->IoStatus.Information = count * size;
+	// reads are completed from the service callback of the port driver
+	const KIRQL oldIrql = platformGetIrql();
+	setSimulatedIrql(DISPATCH_LEVEL);
+	IofCompleteRequest(pIrp, IO_NO_INCREMENT);
+	setSimulatedIrql(oldIrql);
+
+	return count;
+}
+
+
+NTSTATUS sendRequest(PDEVICE_OBJECT pDeviceObject, UCHAR majorFunction, UCHAR minorFunction, ULONG ioControlCode, PVOID buffer, ULONG inputLength, ULONG outputLength) {
+	const PIRP pIrp = allocateRequest(IoGetAttachedDevice(pDeviceObject), majorFunction, minorFunction, buffer);
+
+	if (!pIrp) {
+
+		return STATUS_INSUFFICIENT_RESOURCES;
+	}
+
+	const PIO_STACK_LOCATION pStackLocation = IoGetNextIrpStackLocation(pIrp);
+	pStackLocation->Parameters.DeviceIoControl.IoControlCode = ioControlCode;
+	pStackLocation->Parameters.DeviceIoControl.InputBufferLength = inputLength;
+	pStackLocation->Parameters.DeviceIoControl.OutputBufferLength = outputLength;
+	Request request = { 0 };
+	IoSetCompletionRoutine(pIrp, completeRequest, &request, TRUE, TRUE, TRUE);
+	IoCallDriver(IoGetAttachedDevice(pDeviceObject), pIrp);
+
+	// only reads are pending in the simulation
+	if (!request.isCompleted) {
+		bugCheck("sendRequest", "Request not completed");
+	}
+
+	return request.status;
+}
+
+
+void setReading(BOOLEAN isReadingNext) {
+	__atomic_store_n(&isReading, isReadingNext, __ATOMIC_SEQ_CST);
+
+	return;
+}
+
+
+ULONG getReceivedRequests(PDEVICE_OBJECT pClassDevice, UCHAR majorFunction) {
+	ClassDevExtension* const pClassDevExtension = (ClassDevExtension*)pClassDevice->DeviceExtension;
+	pthread_mutex_lock(&pClassDevExtension->lock);
+	const ULONG count = pClassDevExtension->receivedRequests[majorFunction];
+	pthread_mutex_unlock(&pClassDevExtension->lock);
+
+	return count;
+}
+
+
+void getSimCounters(SimCounters* pSimCounters) {
+	pSimCounters->devices = __atomic_load_n(&simCounters.devices, __ATOMIC_SEQ_CST);
+	pSimCounters->irps = __atomic_load_n(&simCounters.irps, __ATOMIC_SEQ_CST);
+	pSimCounters->references = __atomic_load_n(&simCounters.references, __ATOMIC_SEQ_CST);
+	pSimCounters->allocations = __atomic_load_n(&simCounters.allocations, __ATOMIC_SEQ_CST);
+	pSimCounters->deliveredInput = __atomic_load_n(&simCounters.deliveredInput, __ATOMIC_SEQ_CST);
+	pSimCounters->corruptedInput = __atomic_load_n(&simCounters.corruptedInput, __ATOMIC_SEQ_CST);
+	pSimCounters->failedReads = __atomic_load_n(&simCounters.failedReads, __ATOMIC_SEQ_CST);
+	pSimCounters->unmarkedReads = __atomic_load_n(&simCounters.unmarkedReads, __ATOMIC_SEQ_CST);
+
+	return;
+}
+
+
+// Reads wait until input is sent to the device or the device is removed.
+static NTSTATUS dispatchClassRead(PDEVICE_OBJECT pDeviceObject, PIRP pIrp) {
+	ClassDevExtension* const pClassDevExtension = (ClassDevExtension*)pDeviceObject->DeviceExtension;
+	pthread_mutex_lock(&pClassDevExtension->lock);
+	pClassDevExtension->receivedRequests[IRP_MJ_READ]++;
+
+	if (pClassDevExtension->isRemoved) {
+		pthread_mutex_unlock(&pClassDevExtension->lock);
+		pIrp->IoStatus.Status = STATUS_DELETE_PENDING;
+		pIrp->IoStatus.Information = 0;
+		IofCompleteRequest(pIrp, IO_NO_INCREMENT);
+
+		return STATUS_DELETE_PENDING;
+	}
+
+	IoMarkIrpPending(pIrp);
+	InsertTailList(&pClassDevExtension->pendingReads, &pIrp->Tail.Overlay.ListEntry);
+	pthread_mutex_unlock(&pClassDevExtension->lock);
+
+	return STATUS_PENDING;
+}
+
+
+// Completes the pending reads and deletes the device on removal. The device stays until the devices above are detached.
+static NTSTATUS dispatchClassPnp(PDEVICE_OBJECT pDeviceObject, PIRP pIrp) {
+	ClassDevExtension* const pClassDevExtension = (ClassDevExtension*)pDeviceObject->DeviceExtension;
+	const BOOLEAN isRemoval = IoGetCurrentIrpStackLocation(pIrp)->MinorFunction == IRP_MN_REMOVE_DEVICE;
+	LIST_ENTRY pendingReads;
+	InitializeListHead(&pendingReads);
+	pthread_mutex_lock(&pClassDevExtension->lock);
+	pClassDevExtension->receivedRequests[IRP_MJ_PNP]++;
+
+	if (isRemoval) {
+		pClassDevExtension->isRemoved = TRUE;
+
+		while (!IsListEmpty(&pClassDevExtension->pendingReads)) {
+			InsertTailList(&pendingReads, RemoveHeadList(&pClassDevExtension->pendingReads));
+		}
+
+	}
+
+	pthread_mutex_unlock(&pClassDevExtension->lock);
+
+	while (!IsListEmpty(&pendingReads)) {
+		const PIRP pReadIrp = CONTAINING_RECORD(RemoveHeadList(&pendingReads), IRP, Tail.Overlay.ListEntry);
+		pReadIrp->IoStatus.Status = STATUS_DELETE_PENDING;
+		pReadIrp->IoStatus.Information = 0;
+		IofCompleteRequest(pReadIrp, IO_NO_INCREMENT);
+	}
+
+	pIrp->IoStatus.Status = STATUS_SUCCESS;
+	IofCompleteRequest(pIrp, IO_NO_INCREMENT);
+
+	if (isRemoval) {
+		IoDeleteDevice(pDeviceObject);
+	}
+
+	return STATUS_SUCCESS;
+}
+
+
+static NTSTATUS dispatchClassRequest(PDEVICE_OBJECT pDeviceObject, PIRP pIrp) {
+	ClassDevExtension* const pClassDevExtension = (ClassDevExtension*)pDeviceObject->DeviceExtension;
+	pthread_mutex_lock(&pClassDevExtension->lock);
+	pClassDevExtension->receivedRequests[IoGetCurrentIrpStackLocation(pIrp)->MajorFunction]++;
+	pthread_mutex_unlock(&pClassDevExtension->lock);
+	pIrp->IoStatus.Status = STATUS_SUCCESS;
+	pIrp->IoStatus.Information = 0;
+	IofCompleteRequest(pIrp, IO_NO_INCREMENT);
+
+	return STATUS_SUCCESS;
+}
+
+
+// The request gets a stack location for its owner above the stack, so the owner is notified by a completion routine.
+static PIRP allocateRequest(PDEVICE_OBJECT pTopDevice, UCHAR majorFunction, UCHAR minorFunction, PVOID buffer) {
+	const PIRP pIrp = IoAllocateIrp(pTopDevice->StackSize + 1, FALSE);
+
+	if (!pIrp) {
+
+		return NULL;
+	}
+
+	IoSetNextIrpStackLocation(pIrp);
+	const PIO_STACK_LOCATION pStackLocation = IoGetNextIrpStackLocation(pIrp);
+	pStackLocation->MajorFunction = majorFunction;
+	pStackLocation->MinorFunction = minorFunction;
+	pIrp->AssociatedIrp.SystemBuffer = buffer;
+	// plug and play requests that are not handled keep their status
+	pIrp->IoStatus.Status = STATUS_NOT_SUPPORTED;
+
+	return pIrp;
+}
+
+
+// Sends a read of the raw input thread to the top of the stack of a class device.
+static void sendRead(PDEVICE_OBJECT pClassDevice) {
+	const ULONG length = SIM_READ_LENGTH * (pClassDevice->DeviceType == FILE_DEVICE_KEYBOARD ? sizeof(KEYBOARD_INPUT_DATA) : sizeof(MOUSE_INPUT_DATA));
+	const PDEVICE_OBJECT pTopDevice = IoGetAttachedDevice(pClassDevice);
+	const PIRP pIrp = allocateRequest(pTopDevice, IRP_MJ_READ, 0, calloc(1, length));
+
+	if (!pIrp) {
+		bugCheck("sendRead", "Read not allocated");
+	}
+
+	IoGetNextIrpStackLocation(pIrp)->Parameters.Read.Length = length;
+	IoSetCompletionRoutine(pIrp, completeRead, pClassDevice, TRUE, TRUE, TRUE);
+	IoCallDriver(pTopDevice, pIrp);
+
+	return;
+}
+
+
+// Checks the input of a read and sends the next one, like the raw input thread.
+static NTSTATUS completeRead(PDEVICE_OBJECT pDeviceObject, PIRP pIrp, PVOID pContext) {
+	UNREFERENCED_PARAMETER(pDeviceObject);
+
+	const PDEVICE_OBJECT pClassDevice = (PDEVICE_OBJECT)pContext;
+	const BOOLEAN isSuccess = NT_SUCCESS(pIrp->IoStatus.Status);
+
+	if (isSuccess) {
+		ClassDevExtension* const pClassDevExtension = (ClassDevExtension*)pClassDevice->DeviceExtension;
+		const ULONG size = pClassDevice->DeviceType == FILE_DEVICE_KEYBOARD ? sizeof(KEYBOARD_INPUT_DATA) : sizeof(MOUSE_INPUT_DATA);
+		const ULONG count = (ULONG)(pIrp->IoStatus.Information / size);
+
+		// successful reads are always pending in the class device
+		if (!pIrp->PendingReturned) {
+			__atomic_add_fetch(&simCounters.unmarkedReads, 1, __ATOMIC_RELAXED);
+		}
+
+		for (ULONG i = 0; i < count; i++) {
+
+			if (isExpectedInput(pClassDevice, pIrp, i, pClassDevExtension->receivedInput)) {
+				pClassDevExtension->receivedInput++;
+				__atomic_add_fetch(&simCounters.deliveredInput, 1, __ATOMIC_RELAXED);
+			}
+			else {
+				__atomic_add_fetch(&simCounters.corruptedInput, 1, __ATOMIC_RELAXED);
+			}
+
+		}
+
+	}
+	else {
+		__atomic_add_fetch(&simCounters.failedReads, 1, __ATOMIC_RELAXED);
+	}
+
+	free(pIrp->AssociatedIrp.SystemBuffer);
+	IoFreeIrp(pIrp);
+
+	// failed reads are not repeated, e.g. for a removed device
+	if (isSuccess && __atomic_load_n(&isReading, __ATOMIC_SEQ_CST)) {
+		sendRead(pClassDevice);
+	}
+
+	return STATUS_MORE_PROCESSING_REQUIRED;
+}
+
+
+static NTSTATUS completeRequest(PDEVICE_OBJECT pDeviceObject, PIRP pIrp, PVOID pContext) {
+	UNREFERENCED_PARAMETER(pDeviceObject);
+
+	Request* const pRequest = (Request*)pContext;
+	pRequest->status = pIrp->IoStatus.Status;
+	pRequest->isCompleted = TRUE;
+	IoFreeIrp(pIrp);
+
+	return STATUS_MORE_PROCESSING_REQUIRED;
+}
+
+
+// Input passes the filter devices unchanged and in the order it was sent.
+static BOOLEAN isExpectedInput(const PDEVICE_OBJECT pClassDevice, const PIRP pIrp, ULONG index, ULONG number) {
+
+	if (pClassDevice->DeviceType == FILE_DEVICE_KEYBOARD) {
+		const KEYBOARD_INPUT_DATA* const pKbdInputData = (const KEYBOARD_INPUT_DATA*)pIrp->AssociatedIrp.SystemBuffer + index;
+
+		return pKbdInputData->ExtraInformation == number && pKbdInputData->MakeCode == 0x1e && pKbdInputData->Flags == (number % 2 ? KEY_BREAK : KEY_MAKE);
+	}
+
+	const MOUSE_INPUT_DATA* const pMouInputData = (const MOUSE_INPUT_DATA*)pIrp->AssociatedIrp.SystemBuffer + index;
+
+	return pMouInputData->ExtraInformation == number && pMouInputData->ButtonFlags == (number % 2 ? MOUSE_LEFT_BUTTON_UP : MOUSE_LEFT_BUTTON_DOWN);
+}
\ No newline at end of file
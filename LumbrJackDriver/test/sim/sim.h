@@ -0,0 +1,179 @@
+#pragma once
+#include <ntddk.h>
+#include "../../src/input.h"
+
+// Device stack simulator. Loads the driver into a simulated system with stand-in class drivers for keyboards and mice.
+// The class devices complete read requests with generated input, like kbdclass and mouclass when input arrives.
+// The raw input thread is simulated as well: it keeps one read pending on every class device through the top of its stack,
+// checks that the input arrives intact and sends the next read from the completion of the last one.
+// The logging threads and the statistics thread are replaced by stand-ins that count the entries of the blocking queues.
+
+// Number of input structures a read of the raw input thread can hold.
+#define SIM_READ_LENGTH 0x10
+
+// Counters of the simulation. Objects are counted while they exist, so all of them are zero after a clean teardown.
+typedef struct SimCounters {
+	// Device objects of all drivers, including the class devices.
+	LONG devices;
+	LONG irps;
+	// References of ObReferenceObjectByName.
+	LONG references;
+	// Allocations of ExAllocatePool2.
+	LONG allocations;
+	// Input the raw input thread received intact.
+	ULONGLONG deliveredInput;
+	// Input that arrived out of order, twice or altered.
+	ULONGLONG corruptedInput;
+	// Reads that were completed with an error, e.g. because their device was removed.
+	ULONGLONG failedReads;
+	// Reads that were pending in the class device, but did not return as pending to the raw input thread (see IoMarkIrpPending).
+	ULONGLONG unmarkedReads;
+}SimCounters;
+
+// Entry point of the driver (entry.c).
+NTSTATUS DriverEntry(PDRIVER_OBJECT pDriverObject, PUNICODE_STRING pRegistryPath);
+
+// Creates the class drivers. Has to be called before any other function.
+void initSimulation();
+
+// Creates the driver object of the filter driver and calls its entry point.
+//
+// Parameters:
+//
+// [out] ppDriverObject:
+// Contains the address of the driver object on return. Valid if the driver was loaded.
+//
+// Return:
+// Status returned by DriverEntry.
+NTSTATUS loadDriver(PDRIVER_OBJECT* ppDriverObject);
+
+// Calls the unload routine of the filter driver and deletes its driver object.
+// The unload routine waits for the reads pending in the filter devices, so another thread has to complete them (see sendInput).
+//
+// Parameters:
+//
+// [in] pDriverObject:
+// Address of the driver object of the filter driver.
+void unloadDriver(PDRIVER_OBJECT pDriverObject);
+
+// Creates a class device of kbdclass or mouclass, notifies the arrival of its interface and starts the raw input thread reading from it.
+//
+// Parameters:
+//
+// [in] deviceType:
+// FILE_DEVICE_KEYBOARD or FILE_DEVICE_MOUSE.
+//
+// Return:
+// Address of the class device or NULL if it could not be created.
+PDEVICE_OBJECT addClassDevice(ULONG deviceType);
+
+// Sends IRP_MN_REMOVE_DEVICE to the top of the stack of a class device.
+// The class device completes its pending reads with STATUS_DELETE_PENDING and deletes itself.
+//
+// Parameters:
+//
+// [in] pClassDevice:
+// Address of the class device. Invalid on return.
+void removeClassDevice(PDEVICE_OBJECT pClassDevice);
+
+// Completes the oldest pending read of a class device with generated input, which passes through all devices of the stack.
+// Keyboards alternate between make and break codes, mice between left button presses and releases.
+//
+// Parameters:
+//
+// [in] pClassDevice:
+// Address of the class device.
+//
+// [in] count:
+// Number of input structures. At most SIM_READ_LENGTH.
+//
+// Return:
+// Number of input structures completed. Zero if no read was pending.
+ULONG sendInput(PDEVICE_OBJECT pClassDevice, ULONG count);
+
+// Sends a request to the top of the stack of a device and waits until it is completed.
+//
+// Parameters:
+//
+// [in] pDeviceObject:
+// Address of the device.
+//
+// [in] majorFunction:
+// IRP_MJ_* code of the request.
+//
+// [in] minorFunction:
+// IRP_MN_* code for plug and play requests, otherwise zero.
+//
+// [in] ioControlCode:
+// IOCTL code for device control requests, otherwise zero.
+//
+// [in/out] buffer:
+// System buffer of the request. May be NULL.
+//
+// [in] inputLength:
+// Size of the input in the buffer.
+//
+// [in] outputLength:
+// Size of the buffer for the output.
+//
+// Return:
+// Status of the completed request.
+NTSTATUS sendRequest(PDEVICE_OBJECT pDeviceObject, UCHAR majorFunction, UCHAR minorFunction, ULONG ioControlCode, PVOID buffer, ULONG inputLength, ULONG outputLength);
+
+// Lets the raw input thread stop sending reads, e.g. before unloading the driver.
+//
+// Parameters:
+//
+// [in] isReading:
+// TRUE to send the next read whenever a read completes.
+void setReading(BOOLEAN isReading);
+
+// Gets the number of requests a class device received.
+//
+// Parameters:
+//
+// [in] pClassDevice:
+// Address of the class device.
+//
+// [in] majorFunction:
+// IRP_MJ_* code of the requests.
+//
+// Return:
+// Number of requests.
+ULONG getReceivedRequests(PDEVICE_OBJECT pClassDevice, UCHAR majorFunction);
+
+// Gets the current counters of the simulation.
+//
+// Parameters:
+//
+// [out] pSimCounters:
+// Contains the counters on return.
+void getSimCounters(SimCounters* pSimCounters);
+
+// Gets the number of entries the stand-ins of the logging threads took from the blocking queues since the start of the simulation.
+//
+// Parameters:
+//
+// [in] inputType:
+// LOG_KBD or LOG_MOU.
+//
+// Return:
+// Number of entries.
+ULONGLONG getLoggedEntries(LogType inputType);
+
+// Creates a thread object running a routine.
+//
+// Parameters:
+//
+// [in] pStartRoutine:
+// Routine of the thread.
+//
+// [in] pStartContext:
+// Argument of the routine.
+//
+// [out] ppThread:
+// Contains the address of the thread object on return. Has to be released with ObfDereferenceObject after waiting for the thread.
+//
+// Return:
+// An appropriate NTSTATUS value.
+NTSTATUS createThread(void (*pStartRoutine)(PVOID), PVOID pStartContext, PKTHREAD* ppThread);
\ No newline at end of file
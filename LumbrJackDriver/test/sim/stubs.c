@@ -0,0 +1,143 @@
+#include "sim.h"
+#include "../../src/log.h"
+#include "../../src/stats.h"
+#include "../../src/inject.h"
+
+// Stand-ins of the parts of the driver that need files or system threads (log.c, stats.c and the thread of inject.c).
+// The logging threads take the entries from the blocking queues like the real ones, but only count them.
+
+PKTHREAD pLogThreads[LOG_MAX];
+
+BlockingQueue inputQueues[LOG_MAX];
+
+LogConfig logConfig;
+
+PKTHREAD pStatsThread;
+
+// Entries taken from the queues per input type. Only written by the logging threads.
+static volatile ULONGLONG loggedEntries[LOG_MAX];
+
+static void logStartRoutine(PVOID pStartContext);
+static void injectStartRoutine(PVOID pStartContext);
+
+void initInputQueues() {
+
+	for (int i = 0; i < LOG_MAX; i++) {
+		initBlockingQueue(&inputQueues[i], 0x10);
+		// opened by the logging thread of the type
+		closeBlockingQueue(&inputQueues[i]);
+	}
+
+	return;
+}
+
+
+LogType getLogThreadType(LogType inputType) {
+
+	if (logConfig.flags & (LOG_FLAG_UNIFIED | LOG_FLAG_BINARY)) {
+
+		return LOG_ALL;
+	}
+
+	return inputType;
+}
+
+
+NTSTATUS startLogThread(PDRIVER_OBJECT pDriverObject, LogType type) {
+	UNREFERENCED_PARAMETER(pDriverObject);
+
+	if (pLogThreads[type]) {
+
+		return STATUS_INVALID_DEVICE_STATE;
+	}
+
+	openBlockingQueue(&inputQueues[type]);
+	const NTSTATUS ntStatus = createThread(logStartRoutine, &inputQueues[type], &pLogThreads[type]);
+
+	if (!NT_SUCCESS(ntStatus)) {
+		closeBlockingQueue(&inputQueues[type]);
+	}
+
+	return ntStatus;
+}
+
+
+NTSTATUS stopLogThread(LogType type) {
+
+	if (!pLogThreads[type]) {
+
+		return STATUS_INVALID_DEVICE_STATE;
+	}
+
+	closeBlockingQueue(&inputQueues[type]);
+	const NTSTATUS ntStatus = KeWaitForSingleObject(pLogThreads[type], Executive, KernelMode, FALSE, NULL);
+	ObfDereferenceObject(pLogThreads[type]);
+	pLogThreads[type] = NULL;
+
+	return ntStatus;
+}
+
+
+// Aggregated logging needs the file system, so the statistics thread is only marked as running.
+NTSTATUS startStatsThread(PDRIVER_OBJECT pDriverObject, ULONG interval) {
+	UNREFERENCED_PARAMETER(pDriverObject);
+	UNREFERENCED_PARAMETER(interval);
+
+	static KTHREAD statsThread;
+	pStatsThread = &statsThread;
+
+	return STATUS_SUCCESS;
+}
+
+
+NTSTATUS stopStatsThread() {
+	pStatsThread = NULL;
+
+	return STATUS_SUCCESS;
+}
+
+
+NTSTATUS injectInput(PDRIVER_OBJECT pDriverObject, Injection* pInjection) {
+	UNREFERENCED_PARAMETER(pDriverObject);
+
+	PKTHREAD pInjectThread = NULL;
+	NTSTATUS ntStatus = createThread(injectStartRoutine, pInjection, &pInjectThread);
+
+	if (!NT_SUCCESS(ntStatus)) {
+
+		return ntStatus;
+	}
+
+	ntStatus = KeWaitForSingleObject(pInjectThread, Executive, KernelMode, FALSE, NULL);
+	ObfDereferenceObject(pInjectThread);
+
+	return ntStatus;
+}
+
+
+ULONGLONG getLoggedEntries(LogType inputType) {
+
+	return __atomic_load_n(&loggedEntries[inputType], __ATOMIC_SEQ_CST);
+}
+
+
+static void logStartRoutine(PVOID pStartContext) {
+	BlockingQueue* const pBlockingQueue = (BlockingQueue*)pStartContext;
+	LIST_ENTRY* pListEntry = NULL;
+
+	// the queue is closed and empty once the thread is stopped
+	while (removeFromBlockingQueue(pBlockingQueue, &pListEntry) == STATUS_SUCCESS) {
+		DataEntry* const pDataEntry = CONTAINING_RECORD(pListEntry, DataEntry, list);
+		__atomic_add_fetch(&loggedEntries[pDataEntry->type], 1, __ATOMIC_SEQ_CST);
+		freeDataEntry(pDataEntry);
+	}
+
+	return;
+}
+
+
+static void injectStartRoutine(PVOID pStartContext) {
+	runInjection((Injection*)pStartContext);
+
+	return;
+}
\ No newline at end of file
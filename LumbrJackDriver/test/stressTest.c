@@ -0,0 +1,465 @@
+#include "test.h"
+#include "../src/BlockingQueue.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+// Concurrency tests of the blocking queue and the shutdown protocol of the logging threads:
+// producers are completion routines, the consumer is a logging thread and the closer is stopLogThread.
+// testInterleavings explores all orders of the queue operations of small sessions, testStress runs sessions with real threads and random timing.
+// Both check that no entry is lost, delivered twice or reordered per producer, and that the consumer ends once the queue is closed.
+// Meant to be run under ThreadSanitizer as well (LUMBRJACK_SANITIZE_THREAD). Takes an optional seed: lumbrjack_stress_test [<seed>]
+
+typedef enum EntryState {
+	ENTRY_NEW, ENTRY_QUEUED, ENTRY_REJECTED, ENTRY_DELIVERED
+}EntryState;
+
+#define MODEL_PRODUCERS 2
+#define MODEL_ENTRIES 2
+// the producers, the consumer and the closer
+#define MODEL_ACTORS (MODEL_PRODUCERS + 2)
+#define MODEL_CONSUMER MODEL_PRODUCERS
+#define MODEL_CLOSER (MODEL_PRODUCERS + 1)
+#define MODEL_MAX_STEPS 0x20
+
+typedef struct ModelEntry {
+	LIST_ENTRY list;
+	ULONG producer;
+	ULONG index;
+}ModelEntry;
+
+// State of a session of the queue operations. Every operation is a single call of the queue, executed without waiting.
+// An operation that would wait is not enabled in the current state.
+typedef struct Model {
+	BlockingQueue queue;
+	ModelEntry entries[MODEL_PRODUCERS][MODEL_ENTRIES];
+	EntryState states[MODEL_PRODUCERS][MODEL_ENTRIES];
+	ULONG added[MODEL_PRODUCERS];
+	ULONG delivered[MODEL_PRODUCERS];
+	BOOLEAN isClosed;
+	BOOLEAN isConsumerDone;
+	ULONG violations;
+}Model;
+
+typedef enum StepResult {
+	STEP_DONE, STEP_DISABLED, STEP_EXECUTED
+}StepResult;
+
+// Size of the queue of the explored sessions.
+static LONG modelQueueSize;
+static ULONGLONG exploredSchedules;
+
+static BOOLEAN isActorDone(const Model* pModel, int actor) {
+
+	if (actor < MODEL_PRODUCERS) {
+
+		return pModel->added[actor] == MODEL_ENTRIES;
+	}
+
+	return actor == MODEL_CONSUMER ? pModel->isConsumerDone : pModel->isClosed;
+}
+
+
+// Executes the next operation of an actor.
+// Producer 0 waits for space like a producer below DISPATCH_LEVEL, producer 1 drops its entry if the queue is full like a completion routine.
+static StepResult step(Model* pModel, int actor) {
+
+	if (isActorDone(pModel, actor)) {
+
+		return STEP_DONE;
+	}
+
+	// no operation waits, so the model decides which ones are enabled
+	setSimulatedIrql(DISPATCH_LEVEL);
+	StepResult result = STEP_EXECUTED;
+
+	if (actor < MODEL_PRODUCERS) {
+		const ULONG index = pModel->added[actor];
+		ModelEntry* const pEntry = &pModel->entries[actor][index];
+		pEntry->producer = actor;
+		pEntry->index = index;
+		const NTSTATUS ntStatus = addToBlockigQueue(&pModel->queue, &pEntry->list);
+
+		if (ntStatus == STATUS_TIMEOUT && !actor) {
+			result = STEP_DISABLED;
+		}
+		else {
+
+			// nothing is added to a closed queue
+			if (ntStatus == STATUS_SUCCESS && pModel->isClosed) {
+				pModel->violations++;
+			}
+
+			pModel->states[actor][index] = ntStatus == STATUS_SUCCESS ? ENTRY_QUEUED : ENTRY_REJECTED;
+			pModel->added[actor]++;
+		}
+
+	}
+	else if (actor == MODEL_CONSUMER) {
+		LIST_ENTRY* pListEntry = NULL;
+		const NTSTATUS ntStatus = removeFromBlockingQueue(&pModel->queue, &pListEntry);
+
+		if (ntStatus == STATUS_TIMEOUT) {
+
+			// the consumer would wait forever on a closed queue
+			if (pModel->isClosed) {
+				pModel->violations++;
+			}
+
+			result = STEP_DISABLED;
+		}
+		else if (ntStatus == STATUS_NO_MORE_ENTRIES) {
+
+			if (!pModel->isClosed) {
+				pModel->violations++;
+			}
+
+			pModel->isConsumerDone = TRUE;
+		}
+		else {
+			const ModelEntry* const pEntry = CONTAINING_RECORD(pListEntry, ModelEntry, list);
+
+			// delivered once, in the order of its producer; dropped entries leave gaps
+			if (pModel->states[pEntry->producer][pEntry->index] != ENTRY_QUEUED || pEntry->index < pModel->delivered[pEntry->producer]) {
+				pModel->violations++;
+			}
+
+			pModel->states[pEntry->producer][pEntry->index] = ENTRY_DELIVERED;
+			pModel->delivered[pEntry->producer] = pEntry->index + 1;
+		}
+
+	}
+	else {
+		closeBlockingQueue(&pModel->queue);
+		pModel->isClosed = TRUE;
+	}
+
+	setSimulatedIrql(PASSIVE_LEVEL);
+
+	return result;
+}
+
+
+// Runs a schedule on a new session. Returns FALSE if an operation of the schedule is not enabled.
+static BOOLEAN replay(Model* pModel, const int* schedule, int length) {
+	RtlZeroMemory(pModel, sizeof(Model));
+	initBlockingQueue(&pModel->queue, modelQueueSize);
+
+	for (int i = 0; i < length; i++) {
+
+		if (step(pModel, schedule[i]) != STEP_EXECUTED) {
+
+			return FALSE;
+		}
+
+	}
+
+	return TRUE;
+}
+
+
+static void printSchedule(const char* problem, const int* schedule, int length) {
+	fprintf(stderr, "%s with queue size %ld after:", problem, modelQueueSize);
+
+	for (int i = 0; i < length; i++) {
+		fprintf(stderr, " %s", schedule[i] < MODEL_PRODUCERS ? (schedule[i] ? "P1" : "P0") : schedule[i] == MODEL_CONSUMER ? "C" : "X");
+	}
+
+	fprintf(stderr, "\n");
+
+	return;
+}
+
+
+// Explores all extensions of a schedule depth first. Every path is replayed from a new session, so the queue needs no snapshots.
+static void explore(Model* pModel, int* schedule, int length) {
+	replay(pModel, schedule, length);
+
+	if (pModel->violations) {
+		printSchedule("Violation", schedule, length);
+		failedChecks++;
+
+		return;
+	}
+
+	BOOLEAN isDone = TRUE;
+
+	for (int actor = 0; actor < MODEL_ACTORS; actor++) {
+		isDone &= isActorDone(pModel, actor);
+	}
+
+	if (isDone) {
+
+		// every entry was rejected or delivered, none is left in the queue
+		for (int producer = 0; producer < MODEL_PRODUCERS; producer++) {
+
+			for (int index = 0; index < MODEL_ENTRIES; index++) {
+
+				if (pModel->states[producer][index] != ENTRY_REJECTED && pModel->states[producer][index] != ENTRY_DELIVERED) {
+					printSchedule("Lost entry", schedule, length);
+					failedChecks++;
+				}
+
+			}
+
+		}
+
+		exploredSchedules++;
+
+		return;
+	}
+
+	if (length == MODEL_MAX_STEPS) {
+		printSchedule("Unbounded session", schedule, length);
+		failedChecks++;
+
+		return;
+	}
+
+	BOOLEAN isEnabled = FALSE;
+
+	for (int actor = 0; actor < MODEL_ACTORS; actor++) {
+		schedule[length] = actor;
+
+		if (!replay(pModel, schedule, length + 1)) continue;
+
+		isEnabled = TRUE;
+		explore(pModel, schedule, length + 1);
+	}
+
+	// the remaining actors wait for each other
+	if (!isEnabled) {
+		printSchedule("Deadlock", schedule, length);
+		failedChecks++;
+	}
+
+	return;
+}
+
+
+static void testInterleavings() {
+	// the model is too large for the stack of the recursion
+	Model* const pModel = (Model*)malloc(sizeof(Model));
+	int schedule[MODEL_MAX_STEPS];
+
+	for (modelQueueSize = 1; modelQueueSize <= 3; modelQueueSize++) {
+		exploredSchedules = 0;
+		explore(pModel, schedule, 0);
+		printf("Queue size %ld: %llu schedules\n", modelQueueSize, exploredSchedules);
+		CHECK(exploredSchedules);
+	}
+
+	free(pModel);
+
+	return;
+}
+
+
+#define STRESS_PRODUCERS 4
+#define STRESS_SESSIONS 200
+#define STRESS_QUEUE_SIZE 0x10
+#define ENTRY_MAGIC 0x4C4D4245
+// Maximum time from closing the queue until the consumer ended.
+#define MAX_SHUTDOWN_NS 1000000000ll
+
+typedef struct StressEntry {
+	LIST_ENTRY list;
+	ULONG producer;
+	ULONGLONG sequence;
+	// Cleared when the entry is freed, so an entry that is freed twice is detected.
+	ULONG magic;
+}StressEntry;
+
+static BlockingQueue stressQueue;
+static volatile BOOLEAN isProducing;
+// Counters of the threads. Only accessed atomically, since failedChecks is not thread safe.
+static ULONGLONG acceptedCount;
+static ULONGLONG deliveredCount;
+static ULONGLONG freedCount;
+static ULONGLONG violationCount;
+
+static void pauseRandomly(unsigned int* pSeed) {
+	const int choice = rand_r(pSeed) % 8;
+
+	if (!choice) {
+		const struct timespec duration = { 0, rand_r(pSeed) % 20000 };
+		nanosleep(&duration, NULL);
+	}
+	else if (choice == 1) {
+		sched_yield();
+	}
+
+	return;
+}
+
+
+static void freeEntry(StressEntry* pEntry) {
+
+	if (pEntry->magic != ENTRY_MAGIC) {
+		__atomic_add_fetch(&violationCount, 1, __ATOMIC_RELAXED);
+
+		return;
+	}
+
+	pEntry->magic = 0;
+	platformFree(pEntry, 0);
+	__atomic_add_fetch(&freedCount, 1, __ATOMIC_RELAXED);
+
+	return;
+}
+
+
+typedef struct ProducerContext {
+	ULONG producer;
+	unsigned int seed;
+}ProducerContext;
+
+// Adds entries at random IRQL until the test ends, across all sessions like the completion routines of an attached device.
+static void* produceStress(void* pContext) {
+	ProducerContext* const pProducerContext = (ProducerContext*)pContext;
+	ULONGLONG sequence = 0;
+
+	while (__atomic_load_n(&isProducing, __ATOMIC_ACQUIRE)) {
+		StressEntry* const pEntry = (StressEntry*)platformAllocate(sizeof(StressEntry), 0);
+		pEntry->producer = pProducerContext->producer;
+		pEntry->sequence = sequence++;
+		pEntry->magic = ENTRY_MAGIC;
+		setSimulatedIrql(rand_r(&pProducerContext->seed) % 2 ? DISPATCH_LEVEL : PASSIVE_LEVEL);
+		const NTSTATUS ntStatus = addToBlockigQueue(&stressQueue, &pEntry->list);
+		setSimulatedIrql(PASSIVE_LEVEL);
+
+		if (ntStatus == STATUS_SUCCESS) {
+			__atomic_add_fetch(&acceptedCount, 1, __ATOMIC_RELAXED);
+		}
+		else {
+			freeEntry(pEntry);
+		}
+
+		pauseRandomly(&pProducerContext->seed);
+	}
+
+	return NULL;
+}
+
+
+typedef struct ConsumerContext {
+	unsigned int seed;
+	// Sequence number of the last delivered entry plus one per producer.
+	ULONGLONG nextSequences[STRESS_PRODUCERS];
+}ConsumerContext;
+
+// Removes entries like a logging thread until the queue is closed and empty.
+static void* consumeStress(void* pContext) {
+	ConsumerContext* const pConsumerContext = (ConsumerContext*)pContext;
+
+	while (TRUE) {
+		LIST_ENTRY* pListEntry = NULL;
+		const NTSTATUS ntStatus = removeFromBlockingQueue(&stressQueue, &pListEntry);
+
+		if (ntStatus == STATUS_NO_MORE_ENTRIES) break;
+
+		if (ntStatus != STATUS_SUCCESS) {
+			__atomic_add_fetch(&violationCount, 1, __ATOMIC_RELAXED);
+
+			continue;
+		}
+
+		StressEntry* const pEntry = CONTAINING_RECORD(pListEntry, StressEntry, list);
+		ULONGLONG* const pNextSequence = &pConsumerContext->nextSequences[pEntry->producer];
+
+		// rejected entries leave gaps, but the order of a producer is kept
+		if (pEntry->sequence < *pNextSequence) {
+			__atomic_add_fetch(&violationCount, 1, __ATOMIC_RELAXED);
+		}
+
+		*pNextSequence = pEntry->sequence + 1;
+		__atomic_add_fetch(&deliveredCount, 1, __ATOMIC_RELAXED);
+		freeEntry(pEntry);
+		pauseRandomly(&pConsumerContext->seed);
+	}
+
+	return NULL;
+}
+
+
+static long long getNanoseconds() {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return now.tv_sec * 1000000000ll + now.tv_nsec;
+}
+
+
+// Starts and stops logging sessions like dispatchDevCtlLogStart and dispatchDevCtlLogStop while producers keep adding entries.
+static void testStress(unsigned int seed) {
+	const ULONGLONG allocations = getAllocationCount();
+	initBlockingQueue(&stressQueue, STRESS_QUEUE_SIZE);
+	closeBlockingQueue(&stressQueue);
+	isProducing = TRUE;
+
+	pthread_t producers[STRESS_PRODUCERS];
+	ProducerContext producerContexts[STRESS_PRODUCERS];
+
+	for (ULONG i = 0; i < STRESS_PRODUCERS; i++) {
+		producerContexts[i].producer = i;
+		producerContexts[i].seed = seed + i + 1;
+		CHECK(!pthread_create(&producers[i], NULL, produceStress, &producerContexts[i]));
+	}
+
+	ConsumerContext consumerContext = { 0 };
+	consumerContext.seed = seed;
+	long long maxShutdown = 0;
+
+	for (int session = 0; session < STRESS_SESSIONS; session++) {
+		openBlockingQueue(&stressQueue);
+		pthread_t consumer;
+		CHECK(!pthread_create(&consumer, NULL, consumeStress, &consumerContext));
+
+		const struct timespec duration = { 0, rand_r(&seed) % 2000000 };
+		nanosleep(&duration, NULL);
+
+		const long long closeTime = getNanoseconds();
+		closeBlockingQueue(&stressQueue);
+		pthread_join(consumer, NULL);
+		const long long shutdown = getNanoseconds() - closeTime;
+
+		if (shutdown > maxShutdown) {
+			maxShutdown = shutdown;
+		}
+
+	}
+
+	__atomic_store_n(&isProducing, FALSE, __ATOMIC_RELEASE);
+
+	for (ULONG i = 0; i < STRESS_PRODUCERS; i++) {
+		pthread_join(producers[i], NULL);
+	}
+
+	printf("Stress: %llu entries delivered in %d sessions, longest shutdown %lld us\n", deliveredCount, STRESS_SESSIONS, maxShutdown / 1000);
+	CHECK(!violationCount);
+	// every entry that was accepted by an open queue was delivered before the queue was opened again
+	CHECK(acceptedCount == deliveredCount);
+	CHECK(freedCount == getAllocationCount() - allocations);
+	CHECK(maxShutdown < MAX_SHUTDOWN_NS);
+
+	return;
+}
+
+
+int main(int argc, char* argv[]) {
+	const unsigned int seed = argc > 1 ? (unsigned int)strtoul(argv[1], NULL, 0) : 1;
+	// a hang fails the test instead of blocking the test run
+	alarm(120);
+
+	RUN_TEST(testInterleavings);
+	printf("Seed: %u\n", seed);
+	testStress(seed);
+
+	if (failedChecks) {
+		fprintf(stderr, "testStress failed\n");
+	}
+
+	return failedChecks ? EXIT_FAILURE : EXIT_SUCCESS;
+}
\ No newline at end of file
@@ -0,0 +1,42 @@
+#pragma once
+// Minimal checks for the unit tests of the driver core.
+// A failed check is reported with its location and counted in failedChecks, and the test continues.
+#include <stdio.h>
+
+#define CHECK(condition) \
+	do { \
+		if (!(condition)) { \
+			fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+			failedChecks++; \
+		} \
+	} while (0)
+
+#define CHECK_STATUS(ntStatus, expected) \
+	do { \
+		const NTSTATUS actual = (ntStatus); \
+		if (actual != (expected)) { \
+			fprintf(stderr, "%s:%d: %s returned 0x%08x instead of 0x%08x\n", __FILE__, __LINE__, #ntStatus, (unsigned int)actual, (unsigned int)(expected)); \
+			failedChecks++; \
+		} \
+	} while (0)
+
+#define CHECK_STRING(actual, expected) \
+	do { \
+		if (strcmp((actual), (expected))) { \
+			fprintf(stderr, "%s:%d: \"%s\" instead of \"%s\"\n", __FILE__, __LINE__, (actual), (expected)); \
+			failedChecks++; \
+		} \
+	} while (0)
+
+// Runs a test function and prints its name if it fails.
+#define RUN_TEST(test) \
+	do { \
+		const int failedBefore = failedChecks; \
+		test(); \
+		if (failedChecks != failedBefore) { \
+			fprintf(stderr, "%s failed\n", #test); \
+		} \
+	} while (0)
+
+// Failed checks of the test executable.
+static int failedChecks;
\ No newline at end of file
@@ -0,0 +1,361 @@
+extern "C" {
+#include "../src/format.h"
+#include "../src/lz.h"
+#include "test.h"
+}
+#include "decoder.h"
+#include "timeindex.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Sidecar index of binary log files (timeindex.h): an index is built over generated plain and compressed log files,
+// its entries are seeked to, and ranges that start and end at the boundaries of the entries are extracted
+// and compared with a linear scan of the generated records.
+
+namespace {
+
+    constexpr const char* PLAIN_PATH = "timeindex.bin";
+    constexpr const char* COMPRESSED_PATH = "timeindex.lz.bin";
+    constexpr uint64_t START_TIME = 50000000;
+    // Records between two entries of the index.
+    constexpr uint64_t RECORDS_PER_INTERVAL = timeindex::INDEX_INTERVAL / sizeof(InputRecord);
+    constexpr uint64_t RECORD_COUNT = 3 * RECORDS_PER_INTERVAL + 500;
+    // Ticks between two records.
+    constexpr uint64_t RECORD_INTERVAL = 1000;
+    // Every LATE_INTERVAL-th record after the first entry is logged LATE_TIME ticks after it happened, behind the records of the following entry.
+    constexpr uint64_t LATE_INTERVAL = 701;
+    constexpr uint64_t LATE_TIME = (RECORDS_PER_INTERVAL + 100) * RECORD_INTERVAL;
+    // Ticks without input before the record IDLE_RECORD, more than a delta can hold.
+    constexpr uint64_t IDLE_TIME = 0x200000000;
+    constexpr uint64_t IDLE_RECORD = 3 * RECORDS_PER_INTERVAL - 100;
+
+    constexpr timeindex::Range ALL = { 0, UINT64_MAX, 0, UINT64_MAX };
+
+    // Keyboard or mouse record of a generated log file.
+    struct Record {
+        InputRecord record;
+        // Absolute interrupt time.
+        uint64_t time;
+    };
+
+    // Records in file order. Their times ascend, except for the late records.
+    // Besides every LATE_INTERVAL-th record, the last record before every entry is late, so the entries are after records of later times.
+    std::vector<Record> makeRecords() {
+        std::vector<Record> records;
+        uint64_t time = START_TIME;
+        uint64_t lastTime = START_TIME;
+        // offset after the last record in the decompressed data, records that go back in time or follow the idle time come after a time record
+        uint64_t offset = sizeof(RecordFileHeader);
+
+        for (uint64_t i = 0; i < RECORD_COUNT; i++) {
+            time += i == IDLE_RECORD ? IDLE_TIME : RECORD_INTERVAL;
+            const uint64_t lateTime = time - LATE_TIME;
+            const uint64_t lateOffset = offset + (lateTime < lastTime ? 2 : 1) * sizeof(InputRecord);
+            const bool isLate = i > RECORDS_PER_INTERVAL + 100 && (i % LATE_INTERVAL == LATE_INTERVAL - 1 || lateOffset % timeindex::INDEX_INTERVAL == 0);
+            Record record{};
+            record.time = isLate ? lateTime : time;
+            record.record.source = static_cast<uint16_t>(1 + i % 2);
+            record.record.sequence = i / 2;
+            offset += (record.time < lastTime || record.time - lastTime > UINT32_MAX ? 2 : 1) * sizeof(InputRecord);
+            lastTime = record.time;
+
+            if (i % 2) {
+                record.record.type = RECORD_TYPE_MOU;
+                record.record.mou.lastX = static_cast<int32_t>(i % 7) - 3;
+                record.record.mou.lastY = static_cast<int32_t>(i % 5) - 2;
+            }
+            else {
+                record.record.type = RECORD_TYPE_KBD;
+                record.record.kbd.makeCode = static_cast<uint16_t>(0x10 + i % 0x20);
+                record.record.kbd.flags = i % 4 ? KEY_BREAK : KEY_MAKE;
+            }
+
+            records.push_back(record);
+        }
+
+        return records;
+    }
+
+
+    // Encodes the records like the logging thread: the file header, then the records with time records before backward or large deltas.
+    std::vector<uint8_t> encode(const std::vector<Record>& records) {
+        RecordFileHeader header{};
+        header.magic = RECORD_MAGIC;
+        header.version = RECORD_VERSION;
+        header.headerSize = sizeof(RecordFileHeader);
+        header.recordSize = sizeof(InputRecord);
+        header.timeResolution = RECORD_TIME_RESOLUTION;
+        header.startTime = START_TIME;
+        std::vector<uint8_t> data(reinterpret_cast<const uint8_t*>(&header), reinterpret_cast<const uint8_t*>(&header) + sizeof(header));
+        uint64_t lastTime = START_TIME;
+
+        for (const Record& record : records) {
+            InputRecord inputRecord = record.record;
+
+            if (record.time < lastTime || record.time - lastTime > UINT32_MAX) {
+                InputRecord timeRecord{};
+                timeRecord.type = RECORD_TYPE_TIME;
+                timeRecord.time.time = record.time;
+                data.insert(data.end(), reinterpret_cast<const uint8_t*>(&timeRecord), reinterpret_cast<const uint8_t*>(&timeRecord) + sizeof(timeRecord));
+                lastTime = record.time;
+            }
+
+            inputRecord.timeDelta = static_cast<uint32_t>(record.time - lastTime);
+            lastTime = record.time;
+            data.insert(data.end(), reinterpret_cast<const uint8_t*>(&inputRecord), reinterpret_cast<const uint8_t*>(&inputRecord) + sizeof(inputRecord));
+        }
+
+        return data;
+    }
+
+
+    void writePlain(const std::vector<uint8_t>& data) {
+        std::ofstream file(PLAIN_PATH, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+
+        return;
+    }
+
+
+    // Writes the data in compressed blocks of LZ_BLOCK_SIZE bytes like the writer of the driver.
+    void writeCompressed(const std::vector<uint8_t>& data) {
+        std::ofstream file(COMPRESSED_PATH, std::ios::binary | std::ios::trunc);
+        const uint32_t magic = LZ_FILE_MAGIC;
+        file.write(reinterpret_cast<const char*>(&magic), sizeof(magic));
+        std::vector<uint16_t> hashTable(LZ_HASH_TABLE_SIZE / sizeof(uint16_t));
+
+        for (size_t offset = 0; offset < data.size(); offset += LZ_BLOCK_SIZE) {
+            const size_t size = std::min<size_t>(LZ_BLOCK_SIZE, data.size() - offset);
+            std::vector<uint8_t> compressed(LZ_MAX_COMPRESSED_SIZE(size));
+            const size_t compressedSize = lzCompress(data.data() + offset, size, compressed.data(), compressed.size(), hashTable.data());
+            CHECK(compressedSize && compressedSize < size);
+            const uint32_t finalFlag = offset + size == data.size() ? LZ_BLOCK_FINAL : 0;
+            const LzBlockHeader header = { static_cast<uint32_t>(size) | finalFlag, static_cast<uint32_t>(compressedSize) };
+            file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            file.write(reinterpret_cast<const char*>(compressed.data()), static_cast<std::streamsize>(compressedSize));
+        }
+
+        return;
+    }
+
+
+    // Decodes the records within a range by a linear scan.
+    std::string scan(const std::vector<Record>& records, const timeindex::Range* pRange, decoder::format fmt) {
+        std::ostringstream out;
+
+        if (fmt == decoder::format::CSV) {
+            out << decoder::csvHeader << '\n';
+        }
+
+        for (uint64_t ordinal = 0; ordinal < records.size(); ordinal++) {
+            const uint64_t relTime = records[ordinal].time - START_TIME;
+
+            if (relTime < pRange->fromTime || relTime > pRange->toTime || ordinal < pRange->firstRecord || ordinal > pRange->lastRecord) continue;
+
+            out << decoder::formatRecord(&records[ordinal].record, relTime, fmt) << '\n';
+        }
+
+        return out.str();
+    }
+
+
+    std::string extract(const char* path, const timeindex::Range* pRange, decoder::format fmt) {
+        std::ostringstream out;
+        CHECK(timeindex::extract(path, nullptr, pRange, fmt, out));
+
+        return out.str();
+    }
+
+
+    // Extracts a range from both files with and without their index and compares it with the linear scan.
+    void checkRange(const std::vector<Record>& records, const timeindex::Range& range) {
+        for (decoder::format fmt : { decoder::format::TEXT, decoder::format::CSV }) {
+            const std::string expected = scan(records, &range, fmt);
+
+            for (const char* path : { PLAIN_PATH, COMPRESSED_PATH }) {
+                timeindex::Header header{};
+                CHECK(timeindex::build(path, nullptr, &header));
+                CHECK(extract(path, &range, fmt) == expected);
+                std::remove(timeindex::getIndexPath(path).c_str());
+                CHECK(extract(path, &range, fmt) == expected);
+            }
+
+        }
+
+        return;
+    }
+
+
+    // Writes both log files of the records.
+    std::vector<Record> writeLogs() {
+        const std::vector<Record> records = makeRecords();
+        const std::vector<uint8_t> data = encode(records);
+        writePlain(data);
+        writeCompressed(data);
+
+        return records;
+    }
+
+
+    // Builds the index of a log file and reads its entries.
+    std::vector<timeindex::Entry> readEntries(const char* path) {
+        timeindex::Header header{};
+        CHECK(timeindex::build(path, nullptr, &header));
+        CHECK(header.recordCount == RECORD_COUNT && header.startTime == START_TIME);
+        std::vector<timeindex::Entry> entries(header.entryCount);
+        std::ifstream file(timeindex::getIndexPath(path), std::ios::binary);
+        file.seekg(header.headerSize, std::ios::beg);
+        CHECK(static_cast<bool>(file.read(reinterpret_cast<char*>(entries.data()), static_cast<std::streamsize>(entries.size() * sizeof(timeindex::Entry)))));
+
+        return entries;
+    }
+
+
+    // The records after every entry are the records with its ordinal, read at its time.
+    // The latest time of an entry is the maximum of the times before it, also if the record before it was late.
+    void testSeek() {
+        const std::vector<Record> records = writeLogs();
+
+        for (const char* path : { PLAIN_PATH, COMPRESSED_PATH }) {
+            const std::vector<timeindex::Entry> entries = readEntries(path);
+            CHECK(entries.size() > RECORD_COUNT / RECORDS_PER_INTERVAL && entries[0].ordinal == 0);
+            decoder::Reader* const pReader = new decoder::Reader();
+            CHECK(decoder::open(pReader, path, nullptr));
+            size_t lateCount = 0;
+
+            for (size_t i = 0; i < entries.size(); i++) {
+                const timeindex::Entry& entry = entries[i];
+                CHECK(i == 0 || entry.ordinal > entries[i - 1].ordinal);
+                uint64_t latestTime = 0;
+
+                for (uint64_t ordinal = 0; ordinal < entry.ordinal && ordinal < records.size(); ordinal++) {
+                    latestTime = std::max(latestTime, records[ordinal].time);
+                }
+
+                CHECK(entry.latestTime == latestTime);
+                lateCount += entry.time < entry.latestTime;
+                CHECK(decoder::seek(pReader, &entry.position, entry.time));
+                const InputRecord* pRecord = nullptr;
+                uint64_t time = 0;
+
+                if (entry.ordinal == RECORD_COUNT) {
+                    CHECK(!decoder::next(pReader, &pRecord, &time));
+
+                    continue;
+                }
+
+                CHECK(decoder::next(pReader, &pRecord, &time));
+                CHECK(time == records[entry.ordinal].time);
+                CHECK(pRecord->sequence == records[entry.ordinal].record.sequence && pRecord->source == records[entry.ordinal].record.source);
+            }
+
+            CHECK(lateCount == entries.size() - 2);
+            delete pReader;
+        }
+
+        return;
+    }
+
+
+    // Ranges of ordinals that start and end at the first records after the entries, just before and just after them.
+    void testRecordBoundaries() {
+        const std::vector<Record> records = writeLogs();
+        checkRange(records, ALL);
+
+        for (const timeindex::Entry& entry : readEntries(PLAIN_PATH)) {
+            const uint64_t boundary = entry.ordinal;
+
+            for (uint64_t first : { boundary, boundary + 1, boundary ? boundary - 1 : 0 }) {
+                checkRange(records, { 0, UINT64_MAX, first, first });
+                checkRange(records, { 0, UINT64_MAX, first, first + RECORDS_PER_INTERVAL });
+            }
+
+        }
+
+        // the last record, ranges after it and an inverted range
+        checkRange(records, { 0, UINT64_MAX, RECORD_COUNT - 1, UINT64_MAX });
+        checkRange(records, { 0, UINT64_MAX, RECORD_COUNT, UINT64_MAX });
+        checkRange(records, { 0, UINT64_MAX, 10, 9 });
+
+        return;
+    }
+
+
+    // Time ranges that start and end at the times of the records around the entries.
+    // The late records before the entries happened before the records of the entries before them, and the records after the idle time are far behind them.
+    void testTimeBoundaries() {
+        const std::vector<Record> records = writeLogs();
+
+        for (const timeindex::Entry& entry : readEntries(PLAIN_PATH)) {
+
+            for (uint64_t ordinal : { entry.ordinal, entry.ordinal - 1 }) {
+
+                if (ordinal >= RECORD_COUNT) continue;
+
+                const uint64_t relTime = records[ordinal].time - START_TIME;
+                checkRange(records, { relTime, relTime, 0, UINT64_MAX });
+                checkRange(records, { relTime, relTime + RECORD_INTERVAL, ordinal ? ordinal - 1 : 0, UINT64_MAX });
+                checkRange(records, { relTime + 1, relTime + LATE_TIME, 0, UINT64_MAX });
+                checkRange(records, { relTime - 1, UINT64_MAX, 0, UINT64_MAX });
+            }
+
+        }
+
+        for (uint64_t ordinal = 4 * LATE_INTERVAL - 1; ordinal < RECORD_COUNT; ordinal += LATE_INTERVAL) {
+            const uint64_t relTime = records[ordinal].time - START_TIME;
+            checkRange(records, { relTime, relTime, 0, UINT64_MAX });
+            checkRange(records, { relTime, relTime + RECORD_INTERVAL, ordinal - 10, UINT64_MAX });
+        }
+
+        // within the idle time, after the last record and an inverted range
+        const uint64_t idleTime = records[IDLE_RECORD - 1].time - START_TIME + RECORD_INTERVAL;
+        checkRange(records, { idleTime, idleTime + IDLE_TIME / 2, 0, UINT64_MAX });
+        checkRange(records, { records.back().time - START_TIME + 1, UINT64_MAX, 0, UINT64_MAX });
+        checkRange(records, { 2000, 1000, 0, UINT64_MAX });
+
+        return;
+    }
+
+
+    // An index of a log file that has grown since is not used.
+    void testStaleIndex() {
+        std::vector<Record> records = writeLogs();
+        timeindex::Header header{};
+        CHECK(timeindex::build(PLAIN_PATH, nullptr, &header));
+        Record record = records.back();
+        record.time += RECORD_INTERVAL;
+        record.record.timeDelta = RECORD_INTERVAL;
+        record.record.sequence++;
+        records.push_back(record);
+        std::ofstream file(PLAIN_PATH, std::ios::binary | std::ios::app);
+        file.write(reinterpret_cast<const char*>(&record.record), sizeof(record.record));
+        file.close();
+
+        const timeindex::Range range = { 0, UINT64_MAX, RECORD_COUNT - RECORDS_PER_INTERVAL, UINT64_MAX };
+        CHECK(extract(PLAIN_PATH, &range, decoder::format::TEXT) == scan(records, &range, decoder::format::TEXT));
+
+        return;
+    }
+
+}
+
+
+int main() {
+    RUN_TEST(testSeek);
+    RUN_TEST(testRecordBoundaries);
+    RUN_TEST(testTimeBoundaries);
+    RUN_TEST(testStaleIndex);
+
+    for (const char* path : { PLAIN_PATH, COMPRESSED_PATH }) {
+        std::remove(path);
+        std::remove(timeindex::getIndexPath(path).c_str());
+    }
+
+    return failedChecks ? EXIT_FAILURE : EXIT_SUCCESS;
+}
\ No newline at end of file
@@ -0,0 +1,205 @@
+extern "C" {
+#include "../src/trace.h"
+#include "test.h"
+}
+#include "../../LumbrJackClient/src/trace.h"
+#include <atomic>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+// Tests of the per-processor ring buffers of the driver (trace.c) on the user mode build of the driver core.
+// The snapshots are decoded with the trace decoder of the client, like the output of IOCTL_READ_TRACE.
+
+namespace {
+
+    constexpr ULONG PROCESSOR_COUNT = 2;
+    // Records written to processor 0, so its ring wraps.
+    constexpr ULONG WRAPPED_COUNT = TRACE_RECORDS_PER_CPU + 0x10;
+    constexpr ULONG PARTIAL_COUNT = 5;
+    constexpr ULONGLONG START_TIME = 10000000;
+
+    std::vector<uint8_t> snapshotBuffer(ULONG recordCount) {
+
+        return std::vector<uint8_t>(FIELD_OFFSET(TraceSnapshot, records) + recordCount * sizeof(TraceRecord));
+    }
+
+
+    // Takes a snapshot of all records.
+    std::vector<TraceRecord> snapshot() {
+        std::vector<uint8_t> buffer = snapshotBuffer(PROCESSOR_COUNT * TRACE_RECORDS_PER_CPU);
+        TraceSnapshot* const pSnapshot = reinterpret_cast<TraceSnapshot*>(buffer.data());
+        const ULONG size = readTrace(pSnapshot, static_cast<ULONG>(buffer.size()));
+        CHECK(size == FIELD_OFFSET(TraceSnapshot, records) + pSnapshot->count * sizeof(TraceRecord));
+
+        return std::vector<TraceRecord>(pSnapshot->records, pSnapshot->records + pSnapshot->count);
+    }
+
+
+    // Fills the ring of processor 0 past its end and a few records of processor 1 at increasing times.
+    void testWrap() {
+        const TraceConfig traceConfig = { TRACE_INFO, TRACE_CAT_ALL };
+        CHECK_STATUS(setTraceConfig(&traceConfig), STATUS_SUCCESS);
+        ULONGLONG time = START_TIME;
+
+        for (ULONG i = 0; i < WRAPPED_COUNT; i++) {
+            setSimulatedTime(time++);
+            TRACE(TRACE_INFO, TRACE_CAT_KBD, TRACE_POINT_KBD_INPUT, 1, i, KEY_BREAK, 0);
+        }
+
+        setSimulatedProcessor(1);
+
+        for (ULONG i = 0; i < PARTIAL_COUNT; i++) {
+            setSimulatedTime(time++);
+            TRACE(TRACE_WARNING, TRACE_CAT_MOU, TRACE_POINT_MOU_INPUT, 2, MOUSE_LEFT_BUTTON_DOWN, i, -static_cast<LONG>(i));
+        }
+
+        setSimulatedProcessor(0);
+        setSimulatedTime(0);
+
+        const std::vector<TraceRecord> records = snapshot();
+        CHECK(records.size() == TRACE_RECORDS_PER_CPU + PARTIAL_COUNT);
+
+        ULONG kbdCount = 0;
+        ULONG mouCount = 0;
+
+        for (const TraceRecord& record : records) {
+
+            if (record.cpu == 0) {
+                // the oldest records were overwritten, the remaining ones keep their sequence numbers and arguments
+                CHECK(record.sequence > WRAPPED_COUNT - TRACE_RECORDS_PER_CPU && record.sequence <= WRAPPED_COUNT);
+                CHECK(record.point == TRACE_POINT_KBD_INPUT && record.level == TRACE_INFO);
+                CHECK(record.args[1] == record.sequence - 1 && record.time == START_TIME + record.sequence - 1);
+                kbdCount++;
+            }
+            else {
+                CHECK(record.cpu == 1 && record.sequence >= 1 && record.sequence <= PARTIAL_COUNT);
+                CHECK(record.point == TRACE_POINT_MOU_INPUT && record.level == TRACE_WARNING);
+                CHECK(record.args[2] == record.sequence - 1);
+                mouCount++;
+            }
+
+        }
+
+        CHECK(kbdCount == TRACE_RECORDS_PER_CPU && mouCount == PARTIAL_COUNT);
+
+        return;
+    }
+
+
+    // Decodes the snapshot with the decoder of the client.
+    void testDecode() {
+        std::vector<TraceRecord> records = snapshot();
+        trace::printRecords(&records);
+
+        for (size_t i = 1; i < records.size(); i++) {
+            CHECK(records[i - 1].time < records[i].time);
+        }
+
+        // the records of processor 1 are the latest
+        const TraceRecord& first = records.front();
+        const TraceRecord& last = records.back();
+        CHECK_STRING(trace::formatRecord(&first, first.time).c_str(), "       0.0000 CPU0 INFO Keyboard input: source 1 make code 0x10 break unit 0");
+        CHECK_STRING(trace::formatRecord(&last, first.time).c_str(),
+            "       0.1028 CPU1 WARNING Mouse input: source 2 buttons 0x1 data 0 x 4 y -4");
+
+        return;
+    }
+
+
+    // Levels and categories that are not enabled are not written.
+    void testConfig() {
+        const size_t countBefore = snapshot().size();
+
+        const TraceConfig invalidConfig = { TRACE_LEVEL_MAX, TRACE_CAT_ALL };
+        CHECK_STATUS(setTraceConfig(&invalidConfig), STATUS_INVALID_PARAMETER);
+
+        const TraceConfig traceConfig = { TRACE_ERROR, TRACE_CAT_KBD };
+        CHECK_STATUS(setTraceConfig(&traceConfig), STATUS_SUCCESS);
+        setSimulatedProcessor(1);
+        TRACE(TRACE_WARNING, TRACE_CAT_KBD, TRACE_POINT_FILTERED, 0, 1, 0, 0);
+        TRACE(TRACE_ERROR, TRACE_CAT_MOU, TRACE_POINT_ALLOC_FAILED, 1, 2, 0, 0);
+        CHECK(snapshot().size() == countBefore);
+
+        TRACE(TRACE_ERROR, TRACE_CAT_KBD, TRACE_POINT_ALLOC_FAILED, 0, 1, 0, 0);
+        CHECK(snapshot().size() == countBefore + 1);
+
+        // processors added after the buffers were allocated are not traced
+        setSimulatedProcessor(PROCESSOR_COUNT);
+        TRACE(TRACE_ERROR, TRACE_CAT_KBD, TRACE_POINT_ALLOC_FAILED, 0, 1, 0, 0);
+        CHECK(snapshot().size() == countBefore + 1);
+        setSimulatedProcessor(0);
+
+        return;
+    }
+
+
+    // Buffers too small for all records receive as many as fit.
+    void testSmallBuffer() {
+        std::vector<uint8_t> buffer = snapshotBuffer(3);
+        TraceSnapshot* const pSnapshot = reinterpret_cast<TraceSnapshot*>(buffer.data());
+        CHECK(readTrace(pSnapshot, static_cast<ULONG>(buffer.size())) == buffer.size());
+        CHECK(pSnapshot->count == 3);
+        CHECK(readTrace(pSnapshot, FIELD_OFFSET(TraceSnapshot, records) - 1) == 0);
+
+        return;
+    }
+
+
+    // Snapshots taken while the ring is overwritten contain no torn records.
+    void testConcurrentRead() {
+        const TraceConfig traceConfig = { TRACE_INFO, TRACE_CAT_ALL };
+        CHECK_STATUS(setTraceConfig(&traceConfig), STATUS_SUCCESS);
+        std::atomic<bool> isStopped{ false };
+
+        // the writer preempts nothing, but it runs on the processor of the reader like a trace point at DISPATCH_LEVEL
+        std::thread writer([&isStopped]() {
+
+            for (ULONG i = 0; !isStopped.load(); i++) {
+                TRACE(TRACE_INFO, TRACE_CAT_QUEUE, TRACE_POINT_READ_SKIPPED, i, i, i, i);
+            }
+
+            return;
+        });
+
+        for (int i = 0; i < 200; i++) {
+
+            for (const TraceRecord& record : snapshot()) {
+
+                if (record.point == TRACE_POINT_READ_SKIPPED) {
+                    CHECK(record.args[0] == record.args[1] && record.args[1] == record.args[2] && record.args[2] == record.args[3]);
+                }
+
+            }
+
+        }
+
+        isStopped.store(true);
+        writer.join();
+
+        return;
+    }
+
+}
+
+
+int main() {
+    setSimulatedProcessorCount(PROCESSOR_COUNT);
+
+    if (initTrace() != STATUS_SUCCESS) {
+        fprintf(stderr, "initTrace failed\n");
+
+        return EXIT_FAILURE;
+    }
+
+    RUN_TEST(testWrap);
+    RUN_TEST(testDecode);
+    RUN_TEST(testConfig);
+    RUN_TEST(testSmallBuffer);
+    RUN_TEST(testConcurrentRead);
+
+    freeTrace();
+    CHECK(snapshot().empty());
+
+    return failedChecks ? EXIT_FAILURE : EXIT_SUCCESS;
+}
\ No newline at end of file